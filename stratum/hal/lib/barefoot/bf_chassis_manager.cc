@@ -18,7 +18,9 @@
 #include <map>
 #include <memory>
 #include <utility>
+#include <vector>
 
+#include "gflags/gflags.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
@@ -36,6 +38,8 @@
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
 
+DECLARE_int32(port_counters_sampling_interval_ms);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -59,7 +63,15 @@ BFChassisManager::BFChassisManager(PhalInterface* phal_interface,
       bf_pal_interface_(bf_pal_interface),
       unit_to_node_id_(),
       node_id_to_unit_(),
-      node_id_to_port_id_to_port_state_() {}
+      node_id_to_port_id_to_port_state_(),
+      port_counters_sampler_(PortCountersSampler::CreateInstance(
+          [this](std::vector<PortCountersSampler::Sample>* samples) {
+            return SweepPortCounters(samples);
+          },
+          [this](uint64 node_id, uint32 port_id,
+                 const PortCounters& counters) {
+            SendPortCountersGnmiEvent(node_id, port_id, counters);
+          })) {}
 
 BFChassisManager::~BFChassisManager() = default;
 
@@ -345,6 +357,12 @@ BFChassisManager::~BFChassisManager() = default;
       node_id_to_port_id_to_singleton_port_key;
   xcvr_port_key_to_xcvr_state_ = xcvr_port_key_to_xcvr_state;
   initialized_ = true;
+  // The sampler thread blocks on chassis_lock until this push is over.
+  if (FLAGS_port_counters_sampling_interval_ms > 0) {
+    APPEND_STATUS_IF_ERROR(
+        status, port_counters_sampler_->Start(absl::Milliseconds(
+                    FLAGS_port_counters_sampling_interval_ms)));
+  }
 
   return status;
 }
@@ -627,6 +645,49 @@ void BFChassisManager::SendPortOperStateGnmiEvent(
   }
 }
 
+::util::Status BFChassisManager::SweepPortCounters(
+    std::vector<PortCountersSampler::Sample>* samples) {
+  {
+    absl::ReaderMutexLock l(&gnmi_event_lock_);
+    if (!gnmi_event_writer_) return ::util::OkStatus();
+  }
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (!initialized_) return ::util::OkStatus();
+  ::util::Status status = ::util::OkStatus();
+  // The SDE has no bulk counters read, so the ports are read one by one, all
+  // under the same lock.
+  for (const auto& e : node_id_to_port_id_to_port_config_) {
+    uint64 node_id = e.first;
+    const int* unit = gtl::FindOrNull(node_id_to_unit_, node_id);
+    if (unit == nullptr) continue;
+    for (const auto& entry : e.second) {
+      // Skip the ports which failed to be added.
+      if (entry.second.admin_state == ADMIN_STATE_UNKNOWN) continue;
+      PortCountersSampler::Sample sample{node_id, entry.first, {}};
+      ::util::Status error = bf_pal_interface_->PortAllStatsGet(
+          *unit, entry.first, &sample.counters);
+      if (!error.ok()) {
+        APPEND_STATUS_IF_ERROR(status, error);
+        continue;
+      }
+      samples->push_back(std::move(sample));
+    }
+  }
+
+  return status;
+}
+
+void BFChassisManager::SendPortCountersGnmiEvent(
+    uint64 node_id, uint32 port_id, const PortCounters& counters) {
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  if (!gnmi_event_writer_->Write(GnmiEventPtr(
+          new PortCountersChangedEvent(node_id, port_id, counters)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
 void BFChassisManager::ReadPortStatusChangeEvents() {
   PortStatusChangeEvent event;
   while (true) {
@@ -861,7 +922,9 @@ void BFChassisManager::CleanupInternalState() {
   }
   // It is fine to release the chassis lock here (it is actually needed to call
   // UnregisterEventWriters or there would be a deadlock). Because initialized_
-  // is set to true, RegisterEventWriters cannot be called.
+  // is set to true, RegisterEventWriters cannot be called. The counters
+  // sampler takes the chassis lock as well, so it is stopped first.
+  APPEND_STATUS_IF_ERROR(status, port_counters_sampler_->Stop());
   APPEND_STATUS_IF_ERROR(status, UnregisterEventWriters());
   {
     absl::WriterMutexLock l(&chassis_lock);
@@ -19,10 +19,12 @@
 #include <map>
 #include <memory>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "stratum/hal/lib/barefoot/bf_pal_interface.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/phal_interface.h"
+#include "stratum/hal/lib/common/port_counters_sampler.h"
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/glue/integral_types.h"
@@ -138,6 +140,18 @@ class BFChassisManager {
                                   PortState new_state)
       LOCKS_EXCLUDED(gnmi_event_lock_);
 
+  // Reads the counters of all the configured ports for the port counters
+  // sampler. Called from the sampler thread.
+  ::util::Status SweepPortCounters(
+      std::vector<PortCountersSampler::Sample>* samples)
+      LOCKS_EXCLUDED(chassis_lock, gnmi_event_lock_);
+
+  // Forward the new counters of a port through the registered
+  // ChannelWriter<GnmiEventPtr> object.
+  void SendPortCountersGnmiEvent(uint64 node_id, uint32 port_id,
+                                 const PortCounters& counters)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
   // Thread function for reading and processing port state events.
   void ReadPortStatusChangeEvents() LOCKS_EXCLUDED(chassis_lock);
 
@@ -225,6 +239,10 @@ class BFChassisManager {
   std::map<PortKey, HwState> xcvr_port_key_to_xcvr_state_
       GUARDED_BY(chassis_lock);
 
+  // Periodically reads the port counters and reports the changed ones as
+  // PortCountersChangedEvent. Started on the first config push.
+  std::unique_ptr<PortCountersSampler> port_counters_sampler_;
+
   friend class BFChassisManagerTest;
 };
 
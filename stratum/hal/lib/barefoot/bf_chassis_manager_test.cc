@@ -16,6 +16,7 @@
 #include "stratum/hal/lib/barefoot/bf_chassis_manager.h"
 
 #include "absl/time/clock.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/integral_types.h"
@@ -39,6 +40,8 @@ using ::testing::SetArgPointee;
 using ::testing::HasSubstr;
 using ::stratum::test_utils::EqualsProto;
 
+DECLARE_int32(port_counters_sampling_interval_ms);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -112,7 +115,10 @@ class ChassisConfigBuilder {
 
 class BFChassisManagerTest : public ::testing::Test {
  protected:
-  BFChassisManagerTest() { }
+  BFChassisManagerTest() {
+    // The port counters sampler is not under test here.
+    FLAGS_port_counters_sampling_interval_ms = 0;
+  }
 
   void SetUp() override {
     phal_mock_ = absl::make_unique<PhalMock>();
@@ -42,12 +42,16 @@ BFSwitch::BFSwitch(PhalInterface* phal_interface,
     : phal_interface_(CHECK_NOTNULL(phal_interface)),
       bf_chassis_manager_(CHECK_NOTNULL(bf_chassis_manager)),
       unit_to_pi_node_(unit_to_pi_node),
-      node_id_to_pi_node_() {
+      node_id_to_pi_node_(),
+      unit_executor_() {
+  std::vector<int> units;
   for (const auto& entry : unit_to_pi_node_) {
     CHECK_GE(entry.first, 0) << "Invalid unit number " << entry.first << ".";
     CHECK_NE(entry.second, nullptr)
         << "Detected null PINode for unit " << entry.first << ".";
+    units.push_back(entry.first);
   }
+  unit_executor_ = UnitExecutor::CreateInstance(units);
 }
 
 BFSwitch::~BFSwitch() {}
@@ -59,13 +63,31 @@ BFSwitch::~BFSwitch() {}
   ASSIGN_OR_RETURN(const auto& node_id_to_unit,
                    bf_chassis_manager_->GetNodeIdToUnitMap());
   node_id_to_pi_node_.clear();
+  std::map<int, uint64> unit_to_node_id;
+  std::map<int, bool> unit_to_pushed;
+  std::vector<int> units;
   for (const auto& entry : node_id_to_unit) {
-    uint64 node_id = entry.first;
-    int unit = entry.second;
-    ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromUnit(unit));
-    RETURN_IF_ERROR(pi_node->PushChassisConfig(config, node_id));
-    node_id_to_pi_node_[node_id] = pi_node;
+    RETURN_IF_ERROR(GetPINodeFromUnit(entry.second).status());
+    unit_to_node_id[entry.second] = entry.first;
+    unit_to_pushed[entry.second] = false;
+    units.push_back(entry.second);
   }
+  // Push the config to all the nodes concurrently, each on the thread of its
+  // unit. Only the nodes which took the config are added to
+  // node_id_to_pi_node_, even if some other node failed.
+  ::util::Status status = unit_executor_->RunOnUnits(
+      units, [&](int unit) -> ::util::Status {
+        RETURN_IF_ERROR(unit_to_pi_node_.at(unit)->PushChassisConfig(
+            config, unit_to_node_id.at(unit)));
+        unit_to_pushed.at(unit) = true;
+        return ::util::OkStatus();
+      });
+  for (const auto& entry : unit_to_pushed) {
+    if (!entry.second) continue;
+    node_id_to_pi_node_[unit_to_node_id[entry.first]] =
+        unit_to_pi_node_.at(entry.first);
+  }
+  RETURN_IF_ERROR(status);
 
   LOG(INFO) << "Chassis config pushed successfully.";
 
@@ -79,10 +101,14 @@ BFSwitch::~BFSwitch() {}
 
 ::util::Status BFSwitch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
-  absl::WriterMutexLock l(&chassis_lock);
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
   RETURN_IF_ERROR(pi_node->PushForwardingPipelineConfig(config));
-  RETURN_IF_ERROR(bf_chassis_manager_->ReplayPortsConfig(node_id));
+  {
+    // Only the port replay needs exclusive access to the chassis, so that
+    // the pipeline of the other nodes can be programmed at the same time.
+    absl::WriterMutexLock l(&chassis_lock);
+    RETURN_IF_ERROR(bf_chassis_manager_->ReplayPortsConfig(node_id));
+  }
 
   LOG(INFO) << "P4-based forwarding pipeline config pushed successfully to "
             << "node with ID " << node_id << ".";
@@ -92,10 +118,14 @@ BFSwitch::~BFSwitch() {}
 
 ::util::Status BFSwitch::SaveForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
-  absl::WriterMutexLock l(&chassis_lock);
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
   RETURN_IF_ERROR(pi_node->SaveForwardingPipelineConfig(config));
-  RETURN_IF_ERROR(bf_chassis_manager_->ReplayPortsConfig(node_id));
+  {
+    // Only the port replay needs exclusive access to the chassis, so that
+    // the pipeline of the other nodes can be programmed at the same time.
+    absl::WriterMutexLock l(&chassis_lock);
+    RETURN_IF_ERROR(bf_chassis_manager_->ReplayPortsConfig(node_id));
+  }
 
   LOG(INFO) << "P4-based forwarding pipeline config saved successfully to "
             << "node with ID " << node_id << ".";
@@ -120,7 +150,9 @@ BFSwitch::~BFSwitch() {}
 }
 
 ::util::Status BFSwitch::Shutdown() {
-  ::util::Status status = ::util::OkStatus();
+  // Shutdown all the nodes concurrently and then the chassis manager.
+  ::util::Status status = unit_executor_->RunOnAllUnits(
+      [this](int unit) { return unit_to_pi_node_.at(unit)->Shutdown(); });
   APPEND_STATUS_IF_ERROR(status, bf_chassis_manager_->Shutdown());
   return status;
 }
@@ -247,6 +279,7 @@ std::unique_ptr<BFSwitch> BFSwitch::CreateInstance(
 
 ::util::StatusOr<PINode*> BFSwitch::GetPINodeFromNodeId(
     uint64 node_id) const {
+  absl::ReaderMutexLock l(&chassis_lock);
   PINode* pi_node = gtl::FindPtrOrNull(node_id_to_pi_node_, node_id);
   if (pi_node == nullptr) {
     return MAKE_ERROR(ERR_INVALID_PARAM)
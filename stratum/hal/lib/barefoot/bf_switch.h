@@ -25,6 +25,7 @@
 #include "stratum/hal/lib/pi/pi_node.h"
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/unit_executor.h"
 #include "absl/synchronization/mutex.h"
 
 namespace stratum {
@@ -99,8 +100,11 @@ class BFSwitch : public SwitchInterface {
   ::util::StatusOr<pi::PINode*> GetPINodeFromUnit(int unit) const;
 
   // Helper to get PINode pointer from node id or return error indicating
-  // invalid/unknown/uninitialized node.
-  ::util::StatusOr<pi::PINode*> GetPINodeFromNodeId(uint64 node_id) const;
+  // invalid/unknown/uninitialized node. Holds chassis_lock only for the
+  // duration of the lookup, so the calls to different nodes never wait for
+  // each other.
+  ::util::StatusOr<pi::PINode*> GetPINodeFromNodeId(uint64 node_id) const
+      LOCKS_EXCLUDED(chassis_lock);
 
   // Pointer to a PhalInterface implementation. The pointer has been also
   // passed to a few managers for accessing HW. Note that there is only one
@@ -122,6 +126,10 @@ class BFSwitch : public SwitchInterface {
   // At any point of time this map will contain a keys the ids of the nodes
   // which had a successful config push.
   std::map<uint64, pi::PINode*> node_id_to_pi_node_;  //  pointers not owned
+
+  // Runs the chassis-level operations (config push, shutdown) on all the nodes
+  // concurrently, with one thread per unit in unit_to_pi_node_.
+  std::unique_ptr<UnitExecutor> unit_executor_;
 };
 
 }  // namespace barefoot
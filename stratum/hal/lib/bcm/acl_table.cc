@@ -63,12 +63,13 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 ::util::StatusOr<int> AclTable::BcmAclId(
     const ::p4::v1::TableEntry& entry) const {
   // Search for the entry.
-  const auto iter = bcm_acl_id_map_.find(entry);
+  std::string match_key = MatchKey(entry);
+  const auto iter = bcm_acl_id_map_.find(match_key);
   if (iter != bcm_acl_id_map_.end()) {
     return iter->second;
   }
   // Check if the table entry exists.
-  if (!HasEntry(entry)) {
+  if (!HasMatchKey(match_key)) {
     return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
            << TableStr()
            << " does not contain TableEntry: " << entry.ShortDebugString()
@@ -82,14 +83,13 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 
 ::util::Status AclTable::DryRunInsertEntry(
     const ::p4::v1::TableEntry& entry) const {
-  const auto result = entries_.find(entry);
+  return DryRunInsertEntryWithKey(MatchKey(entry), entry);
+}
+
+::util::Status AclTable::DryRunInsertEntryWithKey(
+    const std::string& match_key, const ::p4::v1::TableEntry& entry) const {
   // Duplicate entry check.
-  if (result != entries_.end()) {
-    return MAKE_ERROR(ERR_ENTRY_EXISTS)
-           << TableStr()
-           << " contains duplicate of TableEntry: " << entry.ShortDebugString()
-           << ". Matching TableEntry: " << result->ShortDebugString() << ".";
-  }
+  RETURN_IF_ERROR(BcmFlowTable::DryRunInsertEntryWithKey(match_key, entry));
   // Table capacity check.
   if (EntryCount() == max_entries_) {
     return MAKE_ERROR(ERR_TABLE_FULL) << TableStr() << " is full.";
@@ -107,7 +107,7 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
              << "> from TableEntry: " << entry.ShortDebugString() << ".";
     }
   }
-  return BcmFlowTable::DryRunInsertEntry(entry);
+  return ::util::OkStatus();
 }
 
 ::util::Status AclTable::InsertEntry(const ::p4::v1::TableEntry& entry,
@@ -119,20 +119,22 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 
 ::util::Status AclTable::SetBcmAclId(const ::p4::v1::TableEntry& entry,
                                      int bcm_acl_id) {
-  if (!HasEntry(entry)) {
+  std::string match_key = MatchKey(entry);
+  if (!HasMatchKey(match_key)) {
     return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
            << TableStr()
            << " does not contain TableEntry: " << entry.ShortDebugString()
            << ".";
   }
-  auto iter = bcm_acl_id_map_.find(entry);
+  auto iter = bcm_acl_id_map_.find(match_key);
   if (iter != bcm_acl_id_map_.end()) {
     return MAKE_ERROR(ERR_INTERNAL)
            << "Unexpected scenario in " << TableStr()
            << ": Leftover Bcm ACL ID <" << iter->second
            << "> found for TableEntry: " << entry.ShortDebugString() << ".";
   }
-  bcm_acl_id_map_[entry] = bcm_acl_id;
+  bcm_acl_id_map_[match_key] = bcm_acl_id;
+  changed_keys_.insert(match_key);
   return ::util::OkStatus();
 }
 
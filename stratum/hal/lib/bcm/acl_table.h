@@ -19,6 +19,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_ACL_TABLE_H_
 #define STRATUM_HAL_LIB_BCM_ACL_TABLE_H_
 
+#include <string>
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
@@ -141,8 +142,9 @@ class AclTable : public BcmFlowTable {
   // Returns ERR_NO_RESOURCE if the table is full.
   // Returns ERR_INVALID_PARAM if the entry contains an unsupported match field.
   util::Status InsertEntry(const ::p4::v1::TableEntry& entry) override {
-    RETURN_IF_ERROR(DryRunInsertEntry(entry));
-    return BcmFlowTable::InsertEntry(entry);
+    std::string match_key = MatchKey(entry);
+    RETURN_IF_ERROR(DryRunInsertEntryWithKey(match_key, entry));
+    return InsertEntryWithKey(std::move(match_key), entry);
   }
 
   // Performs a dry-run of InsertEntry. Returns an error if the entry cannot be
@@ -156,19 +158,6 @@ class AclTable : public BcmFlowTable {
   // Returns ERR_NO_RESOURCE if the table is full.
   util::Status InsertEntry(const ::p4::v1::TableEntry& entry, int bcm_acl_id);
 
-  // Attempts to modify an existing entry in this table. Returns the original
-  // entry on success.
-  // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
-  // Returns an error if the entry cannot be added.
-  util::StatusOr<p4::v1::TableEntry> ModifyEntry(
-      const ::p4::v1::TableEntry& entry) override {
-    // Remove the entry, but don't remove the record in bcm_acl_id_map_.
-    ASSIGN_OR_RETURN(p4::v1::TableEntry old_entry,
-                     BcmFlowTable::DeleteEntry(entry));
-    entries_.insert(entry);
-    return old_entry;
-  }
-
   // Attempts to set the Bcm ACL ID for an entry in this table.
   // Returns ERR_ENTRY_NOT_FOUND if the entry is not found.
   util::Status SetBcmAclId(const ::p4::v1::TableEntry& entry, int bcm_acl_id);
@@ -177,12 +166,27 @@ class AclTable : public BcmFlowTable {
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   util::StatusOr<p4::v1::TableEntry> DeleteEntry(
       const ::p4::v1::TableEntry& entry) override {
+    std::string match_key = MatchKey(entry);
     // We aren't interested in the return for erase since it's possible nobody
     // ever set the associated Bcm ACL ID.
-    bcm_acl_id_map_.erase(entry);
-    return BcmFlowTable::DeleteEntry(entry);
+    bcm_acl_id_map_.erase(match_key);
+    return DeleteEntryWithKey(match_key, entry);
   }
 
+  // Returns the BCM ACL ID mapped to the given match key, or -1 if there is
+  // none.
+  int BcmAclIdForMatchKey(const std::string& match_key) const {
+    auto iter = bcm_acl_id_map_.find(match_key);
+    return iter == bcm_acl_id_map_.end() ? -1 : iter->second;
+  }
+
+ protected:
+  // Performs the ACL specific insertion checks (duplicates, table capacity and
+  // match fields) for an entry with a precomputed match key.
+  util::Status DryRunInsertEntryWithKey(const std::string& match_key,
+                                        const ::p4::v1::TableEntry& entry)
+      const;
+
  private:
   //***************************************************************************
   //  Members
@@ -205,10 +209,8 @@ class AclTable : public BcmFlowTable {
   // The set of match field IDs in this table that use UDFs. This is a subset of
   // match_fields_.
   absl::flat_hash_set<uint32> udf_match_fields_;
-  // Mapping from entries to their respective Bcm ACL IDs.
-  absl::flat_hash_map<::p4::v1::TableEntry, uint32,
-  TableEntryHash, TableEntryEqual>
-      bcm_acl_id_map_;
+  // Mapping from entry match keys to their respective Bcm ACL IDs.
+  absl::flat_hash_map<std::string, uint32> bcm_acl_id_map_;
   // Stores const conditions
   absl::flat_hash_map<P4HeaderType, bool,
   EnumHash<P4HeaderType>> const_conditions_;
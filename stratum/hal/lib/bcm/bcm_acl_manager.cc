@@ -27,12 +27,21 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_join.h"
+#include "absl/time/time.h"
 #include "stratum/glue/gtl/map_util.h"
 
 DEFINE_string(bcm_hardware_specs_file,
               "/opt/watchtower/share/bcm_hardware_specs.pb.txt",
               "Path to the file containing the Broadcom hardware map proto.");
 
+DEFINE_int32(acl_stats_collection_interval_ms, 1000,
+             "Interval in ms at which the direct counters of all the ACL flows "
+             "are collected from hardware in the background. If 0, the "
+             "counters are read from hardware flow by flow on each read.");
+DEFINE_int32(acl_stats_max_staleness_ms, 5000,
+             "Max age in ms of the collected ACL flow counters served to the "
+             "reads. Older counters are collected again before being served.");
+
 namespace stratum {
 namespace hal {
 namespace bcm {
@@ -104,7 +113,9 @@ BcmAclManager::BcmAclManager(BcmChassisRoInterface* bcm_chassis_ro_interface,
       p4_table_mapper_(p4_table_mapper),
       node_id_(0),
       unit_(unit),
-      chip_hardware_description_() {}
+      chip_hardware_description_(),
+      bcm_acl_stats_collector_(BcmAclStatsCollector::CreateInstance(
+          bcm_table_manager, bcm_sdk_interface, unit)) {}
 
 BcmAclManager::BcmAclManager()
     : initialized_(false),
@@ -146,6 +157,10 @@ BcmAclManager::~BcmAclManager() {}
   RETURN_IF_ERROR_WITH_APPEND(OneTimeSetup())
       << "Failed to configure ACL hardware for node " << node_id
       << " (unit: " << unit_ << "): " << config.ShortDebugString() << ".";
+  if (FLAGS_acl_stats_collection_interval_ms > 0) {
+    RETURN_IF_ERROR(bcm_acl_stats_collector_->Start(
+        absl::Milliseconds(FLAGS_acl_stats_collection_interval_ms)));
+  }
   return ::util::OkStatus();
 }
 
@@ -239,7 +254,9 @@ BcmAclManager::~BcmAclManager() {}
 }
 
 ::util::Status BcmAclManager::Shutdown() {
-  // TODO(unknown): Implement if needed.
+  if (bcm_acl_stats_collector_ != nullptr) {
+    RETURN_IF_ERROR(bcm_acl_stats_collector_->Stop());
+  }
   return ::util::OkStatus();
 }
 
@@ -305,9 +322,16 @@ BcmAclManager::~BcmAclManager() {}
   ASSIGN_OR_RETURN(const AclTable* table,
                    bcm_table_manager_->GetReadOnlyAclTable(entry.table_id()));
   ASSIGN_OR_RETURN(int bcm_acl_id, table->BcmAclId(entry));
+  // The readers of the older snapshots must stop trusting the ID before it can
+  // be given to another flow.
+  bcm_table_manager_->ReleaseBcmAclId(bcm_acl_id);
   RETURN_IF_ERROR_WITH_APPEND(
       bcm_sdk_interface_->RemoveAclFlow(unit_, bcm_acl_id))
       << "Failed to delete table entry: " << entry.ShortDebugString() << ".";
+  // The ID may be reused by a new flow, which must not get the old counters.
+  if (bcm_acl_stats_collector_ != nullptr) {
+    bcm_acl_stats_collector_->Invalidate(bcm_acl_id);
+  }
   RETURN_IF_ERROR(bcm_table_manager_->DeleteTableEntry(entry));
   return ::util::OkStatus();
 }
@@ -342,7 +366,36 @@ BcmAclManager::~BcmAclManager() {}
                    bcm_table_manager_->GetReadOnlyAclTable(entry.table_id()));
   ASSIGN_OR_RETURN(int bcm_acl_id, table->BcmAclId(entry));
 
+  return GetBcmAclStats(bcm_acl_id, entry, counter);
+}
+
+::util::Status BcmAclManager::GetBcmAclStats(
+    int bcm_acl_id, const ::p4::v1::TableEntry& entry,
+    ::p4::v1::CounterData* counter) const {
+  if (counter == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null counter.";
+  }
+  if (bcm_acl_id < 0) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "No BcmAclId associated with table entry: "
+           << entry.ShortDebugString() << ".";
+  }
+
+  // Serve the counters from the background collector if it is running. Fall
+  // back to reading the flow from hardware if the collector has no counters
+  // for it.
   BcmAclStats stats;
+  if (bcm_acl_stats_collector_ != nullptr &&
+      bcm_acl_stats_collector_->IsRunning() &&
+      bcm_acl_stats_collector_
+          ->GetStats(bcm_acl_id,
+                     absl::Milliseconds(FLAGS_acl_stats_max_staleness_ms),
+                     &stats)
+          .ok()) {
+    counter->set_byte_count(static_cast<int64>(stats.total().bytes()));
+    counter->set_packet_count(static_cast<int64>(stats.total().packets()));
+    return ::util::OkStatus();
+  }
   RETURN_IF_ERROR_WITH_APPEND(
       bcm_sdk_interface_->GetAclStats(unit_, bcm_acl_id, &stats))
       << "Failed to obtain stats for table entry from hardware: "
@@ -24,6 +24,7 @@
 
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/bcm/bcm_acl_stats_collector.h"
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_interface.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
 #include "stratum/hal/lib/bcm/bcm_table_manager.h"
@@ -91,6 +92,15 @@ class BcmAclManager {
   virtual ::util::Status GetTableEntryStats(
       const ::p4::v1::TableEntry& entry, ::p4::v1::CounterData* counter) const;
 
+  // Get the stats of the ACL table entry with the given BCM ACL ID. The stats
+  // are served by the background stats collector if it is running, and are
+  // read from hardware otherwise. Unlike GetTableEntryStats(), this method
+  // does not access the BcmTableManager, so it can be called without holding
+  // the node lock. The entry is only used for error reporting.
+  virtual ::util::Status GetBcmAclStats(int bcm_acl_id,
+                                        const ::p4::v1::TableEntry& entry,
+                                        ::p4::v1::CounterData* counter) const;
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BcmAclManager> CreateInstance(
       BcmChassisRoInterface* bcm_chassis_ro_interface,
@@ -180,6 +190,10 @@ class BcmAclManager {
 
   // Hardware description of the current chip.
   BcmHardwareSpecs::ChipModelSpec chip_hardware_description_;
+
+  // Collects the direct counters of the ACL flows in the background. Started
+  // on PushChassisConfig() if FLAGS_acl_stats_collection_interval_ms > 0.
+  std::unique_ptr<BcmAclStatsCollector> bcm_acl_stats_collector_;
 };
 
 }  // namespace bcm
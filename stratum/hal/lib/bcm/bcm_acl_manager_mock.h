@@ -50,6 +50,10 @@ class BcmAclManagerMock : public BcmAclManager {
   MOCK_CONST_METHOD2(GetTableEntryStats,
                      ::util::Status(const ::p4::v1::TableEntry& entry,
                                     ::p4::v1::CounterData* counter));
+  MOCK_CONST_METHOD3(GetBcmAclStats,
+                     ::util::Status(int bcm_acl_id,
+                                    const ::p4::v1::TableEntry& entry,
+                                    ::p4::v1::CounterData* counter));
 };
 
 }  // namespace bcm
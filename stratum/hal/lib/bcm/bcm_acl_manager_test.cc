@@ -43,6 +43,7 @@
 #include "stratum/public/proto/p4_annotation.pb.h"
 
 DECLARE_string(bcm_hardware_specs_file);
+DECLARE_int32(acl_stats_collection_interval_ms);
 DECLARE_string(test_tmpdir);
 
 namespace stratum {
@@ -60,6 +61,7 @@ using ::testing::AnyNumber;
 using ::testing::AtLeast;
 using ::testing::Contains;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::IsEmpty;
@@ -515,6 +517,9 @@ const std::map<int, BcmAclTable> SetStage(
 class BcmAclManagerTest : public ::testing::Test {
  protected:
   BcmAclManagerTest() {
+    // Stats are read from the SDK mock flow by flow, unless a test starts the
+    // background collector.
+    FLAGS_acl_stats_collection_interval_ms = 0;
     FLAGS_bcm_hardware_specs_file =
         FLAGS_test_tmpdir + "/bcm_hardware_specs.pb.txt";
     CHECK_OK(WriteStringToFile(kDefaultBcmHardwareSpecsText,
@@ -1707,6 +1712,51 @@ TEST_F(BcmAclManagerTest, TestGetTableEntryStats) {
   EXPECT_TRUE(ProtoEqual(expected, received));
 }
 
+// Stats should be served by the background collector, which reads all the
+// flows of a physical table in one batch, once it is started.
+TEST_F(BcmAclManagerTest, TestGetTableEntryStatsFromCollector) {
+  // Perform the initial configuration.
+  ASSERT_OK(SetUpDefaultTables());
+  ::p4::v1::TableEntry entry =
+      BuildSimpleEntry(*DefaultP4TablesVector().begin(), 0);
+  EXPECT_CALL(*bcm_table_manager_mock_, FillBcmFlowEntry(_, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, InsertAclFlow(_, _, _, _)).WillOnce(Return(100));
+  EXPECT_OK(bcm_acl_manager_->InsertTableEntry(entry));
+  bcm_table_manager_->PublishReadSnapshot();
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadSnapshot())
+      .WillRepeatedly(Invoke(bcm_table_manager_.get(),
+                             &BcmTableManager::GetReadSnapshot));
+
+  // Start the collector. The long interval makes sure the counters are only
+  // synced on demand.
+  FLAGS_acl_stats_collection_interval_ms = 3600 * 1000;
+  ChassisConfig config;
+  config.add_nodes()->set_id(kNodeId);
+  EXPECT_CALL(*bcm_sdk_mock_, InitAclHardware(kUnit))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetAclControl(kUnit, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(bcm_acl_manager_->PushChassisConfig(config, kNodeId));
+
+  BcmAclStats stats;
+  stats.mutable_total()->set_bytes(1024);
+  stats.mutable_total()->set_packets(8);
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(100), _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<BcmAclStats>{stats}),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStats(_, _, _)).Times(0);
+  ::p4::v1::CounterData expected;
+  expected.set_byte_count(1024);
+  expected.set_packet_count(8);
+  for (int i = 0; i < 2; ++i) {
+    ::p4::v1::CounterData received;
+    EXPECT_OK(bcm_acl_manager_->GetTableEntryStats(entry, &received));
+    EXPECT_TRUE(ProtoEqual(expected, received));
+  }
+  EXPECT_OK(bcm_acl_manager_->Shutdown());
+}
+
 // Stats retrieval should fail if the flow lookup fails.
 TEST_F(BcmAclManagerTest, TestGetTableEntryStatsLookupFailure) {
   // Perform the initial configuration.
@@ -0,0 +1,256 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_acl_stats_collector.h"
+
+#include <map>
+#include <utility>
+
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+constexpr int BcmAclStatsCollector::kMaxBcmAclId;
+
+BcmAclStatsCollector::BcmAclStatsCollector(BcmTableManager* bcm_table_manager,
+                                           BcmSdkInterface* bcm_sdk_interface,
+                                           int unit)
+    : collector_thread_id_(),
+      running_(false),
+      shutdown_(false),
+      interval_(absl::ZeroDuration()),
+      last_sync_start_(absl::InfinitePast()),
+      counters_(),
+      sync_in_progress_(false),
+      pending_invalidations_(),
+      bcm_table_manager_(ABSL_DIE_IF_NULL(bcm_table_manager)),
+      bcm_sdk_interface_(ABSL_DIE_IF_NULL(bcm_sdk_interface)),
+      unit_(unit) {}
+
+BcmAclStatsCollector::~BcmAclStatsCollector() { Stop().IgnoreError(); }
+
+std::unique_ptr<BcmAclStatsCollector> BcmAclStatsCollector::CreateInstance(
+    BcmTableManager* bcm_table_manager, BcmSdkInterface* bcm_sdk_interface,
+    int unit) {
+  return absl::WrapUnique(
+      new BcmAclStatsCollector(bcm_table_manager, bcm_sdk_interface, unit));
+}
+
+::util::Status BcmAclStatsCollector::Start(absl::Duration interval) {
+  CHECK_RETURN_IF_FALSE(interval > absl::ZeroDuration())
+      << "Invalid ACL stats collection interval " << interval << ".";
+  absl::MutexLock l(&thread_lock_);
+  if (running_) return ::util::OkStatus();
+  interval_ = interval;
+  shutdown_ = false;
+  int ret = pthread_create(&collector_thread_id_, nullptr,
+                           &BcmAclStatsCollector::CollectorThreadFunc, this);
+  if (ret != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to spawn ACL stats collector thread for unit " << unit_
+           << ". Err: " << ret << ".";
+  }
+  running_ = true;
+  LOG(INFO) << "ACL stats collector started for unit " << unit_
+            << " with an interval of " << interval << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmAclStatsCollector::Stop() {
+  pthread_t tid;
+  {
+    absl::MutexLock l(&thread_lock_);
+    if (!running_) return ::util::OkStatus();
+    shutdown_ = true;
+    tid = collector_thread_id_;
+    thread_cond_var_.SignalAll();
+  }
+  // The thread takes thread_lock_, so it is joined without holding it.
+  ::util::Status status = ::util::OkStatus();
+  if (pthread_join(tid, nullptr) != 0) {
+    status = MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to join ACL stats collector thread for unit " << unit_
+             << ".";
+  }
+  {
+    absl::MutexLock l(&thread_lock_);
+    running_ = false;
+  }
+  {
+    absl::MutexLock sync_lock(&sync_lock_);
+    absl::MutexLock l(&counters_lock_);
+    last_sync_start_ = absl::InfinitePast();
+    counters_.clear();
+    pending_invalidations_.clear();
+  }
+
+  return status;
+}
+
+bool BcmAclStatsCollector::IsRunning() const {
+  absl::MutexLock l(&thread_lock_);
+  return running_;
+}
+
+::util::Status BcmAclStatsCollector::SyncNow() {
+  return SyncIfOlderThan(absl::Now());
+}
+
+::util::Status BcmAclStatsCollector::SyncIfOlderThan(absl::Time oldest) {
+  absl::MutexLock sync_lock(&sync_lock_);
+  // A sync started at or after the given time has already read counters which
+  // are at least as fresh as the ones this sync would read.
+  if (last_sync_start_ >= oldest) return ::util::OkStatus();
+  last_sync_start_ = absl::Now();
+  {
+    absl::MutexLock l(&counters_lock_);
+    sync_in_progress_ = true;
+    pending_invalidations_.clear();
+  }
+
+  // Read the counters of each physical table in one go. The result is built
+  // aside, so the counters of the flows which are gone are dropped.
+  auto snapshot = bcm_table_manager_->GetReadSnapshot();
+  std::vector<Counter> counters;
+  ::util::Status status = ::util::OkStatus();
+  std::vector<BcmAclStats> stats;
+  for (const auto& pair : snapshot->GetBcmAclIdsByPhysicalTable()) {
+    const std::vector<int>& bcm_acl_ids = pair.second;
+    if (bcm_acl_ids.empty()) continue;
+    // A flow whose counters cannot be read is left without counters, and
+    // does not prevent the counters of the other flows to be collected.
+    stats.clear();
+    ::util::Status error = bcm_sdk_interface_->GetAclStatsBatch(
+        unit_, bcm_acl_ids, &stats, nullptr);
+    if (!error.ok()) {
+      ::util::Status table_error =
+          APPEND_ERROR(error) << " Failed to read the stats of physical ACL "
+                              << "table " << pair.first << " on unit " << unit_
+                              << ".";
+      APPEND_STATUS_IF_ERROR(status, table_error);
+    }
+    if (stats.size() != bcm_acl_ids.size()) {
+      ::util::Status size_error =
+          MAKE_ERROR(ERR_INTERNAL)
+          << "Got " << stats.size() << " stats for " << bcm_acl_ids.size()
+          << " flows of physical ACL table " << pair.first << " on unit "
+          << unit_ << ".";
+      APPEND_STATUS_IF_ERROR(status, size_error);
+      continue;
+    }
+    absl::Time timestamp = absl::Now();
+    for (size_t i = 0; i < bcm_acl_ids.size(); ++i) {
+      int bcm_acl_id = bcm_acl_ids[i];
+      if (!stats[i].has_total() || bcm_acl_id > kMaxBcmAclId) continue;
+      if (static_cast<size_t>(bcm_acl_id) >= counters.size()) {
+        counters.resize(bcm_acl_id + 1);
+      }
+      Counter& counter = counters[bcm_acl_id];
+      counter.bytes = stats[i].total().bytes();
+      counter.packets = stats[i].total().packets();
+      counter.timestamp = timestamp;
+    }
+  }
+
+  absl::MutexLock l(&counters_lock_);
+  counters_ = std::move(counters);
+  for (int bcm_acl_id : pending_invalidations_) {
+    if (static_cast<size_t>(bcm_acl_id) < counters_.size()) {
+      counters_[bcm_acl_id] = Counter();
+    }
+  }
+  pending_invalidations_.clear();
+  sync_in_progress_ = false;
+
+  return status;
+}
+
+::util::Status BcmAclStatsCollector::GetStats(int bcm_acl_id,
+                                              absl::Duration max_staleness,
+                                              BcmAclStats* stats) {
+  CHECK_RETURN_IF_FALSE(stats != nullptr) << "Null stats.";
+  absl::Time oldest = absl::Now() - max_staleness;
+  if (LookUpStats(bcm_acl_id, oldest, stats)) return ::util::OkStatus();
+  // Do not sync again if the last sync is recent enough. This way flows whose
+  // counters could not be read do not trigger a sync each. A sync which fails
+  // for some of the physical tables still refreshes the other ones.
+  ::util::Status status = SyncIfOlderThan(oldest);
+  if (LookUpStats(bcm_acl_id, oldest, stats)) return ::util::OkStatus();
+  RETURN_IF_ERROR(status);
+
+  return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+         << "No stats collected for BCM ACL ID " << bcm_acl_id << " on unit "
+         << unit_ << ".";
+}
+
+void BcmAclStatsCollector::Invalidate(int bcm_acl_id) {
+  if (bcm_acl_id < 0) return;
+  absl::MutexLock l(&counters_lock_);
+  if (static_cast<size_t>(bcm_acl_id) < counters_.size()) {
+    counters_[bcm_acl_id] = Counter();
+  }
+  if (sync_in_progress_) pending_invalidations_.push_back(bcm_acl_id);
+}
+
+bool BcmAclStatsCollector::LookUpStats(int bcm_acl_id, absl::Time oldest,
+                                       BcmAclStats* stats) const {
+  if (bcm_acl_id < 0) return false;
+  absl::MutexLock l(&counters_lock_);
+  if (static_cast<size_t>(bcm_acl_id) >= counters_.size()) return false;
+  const Counter& counter = counters_[bcm_acl_id];
+  if (counter.timestamp == absl::InfinitePast() || counter.timestamp < oldest) {
+    return false;
+  }
+  stats->Clear();
+  stats->mutable_total()->set_bytes(counter.bytes);
+  stats->mutable_total()->set_packets(counter.packets);
+
+  return true;
+}
+
+void BcmAclStatsCollector::CollectStatsPeriodically() {
+  while (true) {
+    {
+      absl::MutexLock l(&thread_lock_);
+      absl::Time deadline = absl::Now() + interval_;
+      while (!shutdown_ && absl::Now() < deadline) {
+        thread_cond_var_.WaitWithDeadline(&thread_lock_, deadline);
+      }
+      if (shutdown_) return;
+    }
+    ::util::Status status = SyncNow();
+    if (!status.ok()) {
+      LOG_EVERY_N(ERROR, 100) << "Failed to collect the ACL stats on unit "
+                              << unit_ << ": " << status.error_message();
+    }
+  }
+}
+
+void* BcmAclStatsCollector::CollectorThreadFunc(void* arg) {
+  BcmAclStatsCollector* collector = static_cast<BcmAclStatsCollector*>(arg);
+  collector->CollectStatsPeriodically();
+  return nullptr;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
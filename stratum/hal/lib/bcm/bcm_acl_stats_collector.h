@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_ACL_STATS_COLLECTOR_H_
+#define STRATUM_HAL_LIB_BCM_BCM_ACL_STATS_COLLECTOR_H_
+
+#include <pthread.h>
+
+#include <memory>
+#include <vector>
+
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/bcm/bcm.pb.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
+#include "stratum/hal/lib/bcm/bcm_table_manager.h"
+#include "stratum/glue/integral_types.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// The BcmAclStatsCollector class keeps a cache of the direct counters of all
+// the ACL flows programmed on a unit. The counters are read from hardware by a
+// background thread, one GetAclStatsBatch() call per physical ACL table, and
+// are kept in a flat array indexed by BCM ACL ID. The set of flows to read is
+// taken from the last ReadSnapshot published by the BcmTableManager, so the
+// collector never needs the node lock.
+class BcmAclStatsCollector {
+ public:
+  // Largest BCM ACL ID whose counters are cached. The counters of flows with
+  // larger IDs are not collected and must be read from hardware directly.
+  static constexpr int kMaxBcmAclId = 1 << 20;
+
+  ~BcmAclStatsCollector();
+
+  // Starts the background thread which refreshes the counters of all the ACL
+  // flows every interval. Calling Start() on a running collector is a no-op.
+  ::util::Status Start(absl::Duration interval)
+      LOCKS_EXCLUDED(thread_lock_);
+
+  // Stops the background thread, if running, and drops all the counters.
+  ::util::Status Stop()
+      LOCKS_EXCLUDED(thread_lock_, sync_lock_, counters_lock_);
+
+  // Returns true if the background thread is running.
+  bool IsRunning() const LOCKS_EXCLUDED(thread_lock_);
+
+  // Reads the counters of all the ACL flows from hardware right away. Requests
+  // made while another sync is in progress are coalesced: a caller waits for
+  // the ongoing sync to finish and then returns without syncing again if a
+  // sync was started after its own request.
+  ::util::Status SyncNow() LOCKS_EXCLUDED(sync_lock_, counters_lock_);
+
+  // Returns the counters of the ACL flow with the given BCM ACL ID. If the
+  // cached counters are older than max_staleness, all the counters are synced
+  // before they are returned. Returns ERR_ENTRY_NOT_FOUND if the counters of
+  // the flow are not known to the collector, e.g. if the flow was added after
+  // the last ReadSnapshot was published.
+  ::util::Status GetStats(int bcm_acl_id, absl::Duration max_staleness,
+                          BcmAclStats* stats)
+      LOCKS_EXCLUDED(sync_lock_, counters_lock_);
+
+  // Drops the counters of the ACL flow with the given BCM ACL ID. To be called
+  // when the flow is removed from hardware, as the ID may be reused.
+  void Invalidate(int bcm_acl_id) LOCKS_EXCLUDED(counters_lock_);
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<BcmAclStatsCollector> CreateInstance(
+      BcmTableManager* bcm_table_manager, BcmSdkInterface* bcm_sdk_interface,
+      int unit);
+
+  // BcmAclStatsCollector is neither copyable nor movable.
+  BcmAclStatsCollector(const BcmAclStatsCollector&) = delete;
+  BcmAclStatsCollector& operator=(const BcmAclStatsCollector&) = delete;
+
+ private:
+  // The cached counters of an ACL flow.
+  struct Counter {
+    uint64 bytes;
+    uint64 packets;
+    // Time the counters were read from hardware. InfinitePast() if the
+    // counters are not known.
+    absl::Time timestamp;
+    Counter() : bytes(0), packets(0), timestamp(absl::InfinitePast()) {}
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  BcmAclStatsCollector(BcmTableManager* bcm_table_manager,
+                       BcmSdkInterface* bcm_sdk_interface, int unit);
+
+  // Syncs the counters unless the last sync was started at or after the given
+  // time.
+  ::util::Status SyncIfOlderThan(absl::Time oldest)
+      LOCKS_EXCLUDED(sync_lock_, counters_lock_);
+
+  // Copies the counters of the given flow to stats if they were read at or
+  // after the given time. Returns false otherwise.
+  bool LookUpStats(int bcm_acl_id, absl::Time oldest, BcmAclStats* stats) const
+      LOCKS_EXCLUDED(counters_lock_);
+
+  // Body of the background thread.
+  void CollectStatsPeriodically() LOCKS_EXCLUDED(thread_lock_);
+
+  // Background thread function. Invoked with "this" as the argument in
+  // pthread_create.
+  static void* CollectorThreadFunc(void* arg);
+
+  // Protects the state of the background thread.
+  mutable absl::Mutex thread_lock_;
+
+  // Signaled on Stop() to wake up the background thread.
+  absl::CondVar thread_cond_var_;
+
+  // The background thread and its parameters.
+  pthread_t collector_thread_id_ GUARDED_BY(thread_lock_);
+  bool running_ GUARDED_BY(thread_lock_);
+  bool shutdown_ GUARDED_BY(thread_lock_);
+  absl::Duration interval_ GUARDED_BY(thread_lock_);
+
+  // Serializes the syncs. Acquired before counters_lock_.
+  absl::Mutex sync_lock_;
+
+  // Time the last sync was started.
+  absl::Time last_sync_start_ GUARDED_BY(sync_lock_);
+
+  // Protects the cached counters.
+  mutable absl::Mutex counters_lock_;
+
+  // The cached counters, indexed by BCM ACL ID.
+  std::vector<Counter> counters_ GUARDED_BY(counters_lock_);
+
+  // True while a sync is reading the counters from hardware.
+  bool sync_in_progress_ GUARDED_BY(counters_lock_);
+
+  // BCM ACL IDs invalidated while a sync was in progress. Their counters are
+  // dropped again once the sync stores its results.
+  std::vector<int> pending_invalidations_ GUARDED_BY(counters_lock_);
+
+  // Pointer to a BcmTableManager to take the ReadSnapshot from.
+  BcmTableManager* bcm_table_manager_;  // not owned by this class.
+
+  // Pointer to a BcmSdkInterface implementation that wraps all the SDK calls.
+  BcmSdkInterface* bcm_sdk_interface_;  // not owned by this class.
+
+  // Fixed zero-based BCM unit number corresponding to the node/ASIC managed by
+  // this class instance. Assigned in the class constructor.
+  const int unit_;
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_ACL_STATS_COLLECTOR_H_
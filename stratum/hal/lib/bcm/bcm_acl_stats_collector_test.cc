@@ -0,0 +1,245 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_acl_stats_collector.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/bcm/bcm_chassis_ro_mock.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_mock.h"
+#include "stratum/hal/lib/p4/p4_table_mapper_mock.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::UnorderedElementsAre;
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+constexpr int kUnit = 0;
+constexpr uint32 kTableId1 = 33554433;
+constexpr uint32 kTableId2 = 33554434;
+constexpr uint32 kFieldId = 1;
+constexpr int kPhysicalTableId1 = 1;
+constexpr int kPhysicalTableId2 = 2;
+
+// Fake GetAclStatsBatch() returning 100 bytes and 1 packet per unit of BCM ACL
+// ID.
+::util::Status FakeGetAclStatsBatch(int unit, const std::vector<int>& flow_ids,
+                                    std::vector<BcmAclStats>* stats,
+                                    std::vector<::util::Status>* details) {
+  stats->clear();
+  for (int flow_id : flow_ids) {
+    BcmAclStats flow_stats;
+    flow_stats.mutable_total()->set_bytes(flow_id * 100);
+    flow_stats.mutable_total()->set_packets(flow_id);
+    stats->push_back(flow_stats);
+    if (details != nullptr) details->push_back(::util::OkStatus());
+  }
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+class BcmAclStatsCollectorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    bcm_chassis_ro_mock_ = absl::make_unique<BcmChassisRoMock>();
+    p4_table_mapper_mock_ = absl::make_unique<P4TableMapperMock>();
+    bcm_sdk_mock_ = absl::make_unique<BcmSdkMock>();
+    bcm_table_manager_ = BcmTableManager::CreateInstance(
+        bcm_chassis_ro_mock_.get(), p4_table_mapper_mock_.get(), kUnit);
+    collector_ = BcmAclStatsCollector::CreateInstance(
+        bcm_table_manager_.get(), bcm_sdk_mock_.get(), kUnit);
+  }
+
+  void TearDown() override { ASSERT_OK(collector_->Stop()); }
+
+  // Adds an ACL table in the given physical table with one entry per given
+  // BCM ACL ID, and publishes the result.
+  void AddAclTable(uint32 table_id, int physical_table_id,
+                   const std::vector<int>& bcm_acl_ids) {
+    ::p4::config::v1::Table p4_table;
+    p4_table.mutable_preamble()->set_id(table_id);
+    p4_table.add_match_fields()->set_id(kFieldId);
+    p4_table.set_size(10);
+    AclTable table(p4_table, BCM_ACL_STAGE_IFP, /*priority=*/10, {});
+    table.SetPhysicalTableId(physical_table_id);
+    ASSERT_OK(bcm_table_manager_->AddAclTable(table));
+    for (int bcm_acl_id : bcm_acl_ids) {
+      ::p4::v1::TableEntry entry;
+      entry.set_table_id(table_id);
+      auto* match = entry.add_match();
+      match->set_field_id(kFieldId);
+      match->mutable_exact()->set_value(std::string(1, bcm_acl_id));
+      ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entry, bcm_acl_id));
+    }
+    bcm_table_manager_->PublishReadSnapshot();
+  }
+
+  std::unique_ptr<BcmChassisRoMock> bcm_chassis_ro_mock_;
+  std::unique_ptr<P4TableMapperMock> p4_table_mapper_mock_;
+  std::unique_ptr<BcmSdkMock> bcm_sdk_mock_;
+  std::unique_ptr<BcmTableManager> bcm_table_manager_;
+  std::unique_ptr<BcmAclStatsCollector> collector_;
+};
+
+TEST_F(BcmAclStatsCollectorTest, SyncReadsEachPhysicalTableInOneBatch) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10, 11}));
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId2, kPhysicalTableId2, {20}));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              GetAclStatsBatch(kUnit, UnorderedElementsAre(10, 11), _, _))
+      .WillOnce(Invoke(FakeGetAclStatsBatch));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(20), _, _))
+      .WillOnce(Invoke(FakeGetAclStatsBatch));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStats(_, _, _)).Times(0);
+
+  ASSERT_OK(collector_->SyncNow());
+  // All the stats are served from the collected counters.
+  for (int bcm_acl_id : {10, 11, 20}) {
+    BcmAclStats stats;
+    ASSERT_OK(collector_->GetStats(bcm_acl_id, absl::Hours(1), &stats));
+    EXPECT_EQ(bcm_acl_id * 100, stats.total().bytes());
+    EXPECT_EQ(bcm_acl_id, stats.total().packets());
+  }
+}
+
+TEST_F(BcmAclStatsCollectorTest, StaleStatsAreSyncedOnRead) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10}));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(10), _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(FakeGetAclStatsBatch));
+
+  // The first read syncs all the counters, the next one is served from them.
+  BcmAclStats stats;
+  ASSERT_OK(collector_->GetStats(10, absl::Hours(1), &stats));
+  ASSERT_OK(collector_->GetStats(10, absl::Hours(1), &stats));
+  // No staleness allowed.
+  ASSERT_OK(collector_->GetStats(10, absl::ZeroDuration(), &stats));
+  EXPECT_EQ(1000, stats.total().bytes());
+}
+
+TEST_F(BcmAclStatsCollectorTest, UnknownFlowDoesNotTriggerRepeatedSyncs) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10}));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, _, _, _))
+      .WillOnce(Invoke(FakeGetAclStatsBatch));
+
+  BcmAclStats stats;
+  for (int i = 0; i < 3; ++i) {
+    ::util::Status status = collector_->GetStats(99, absl::Hours(1), &stats);
+    EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+  }
+}
+
+TEST_F(BcmAclStatsCollectorTest, InvalidateDropsCounters) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10, 11}));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, _, _, _))
+      .WillOnce(Invoke(FakeGetAclStatsBatch));
+
+  ASSERT_OK(collector_->SyncNow());
+  collector_->Invalidate(10);
+  BcmAclStats stats;
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            collector_->GetStats(10, absl::Hours(1), &stats).error_code());
+  EXPECT_OK(collector_->GetStats(11, absl::Hours(1), &stats));
+}
+
+TEST_F(BcmAclStatsCollectorTest, FailedTableDoesNotAffectOtherTables) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10}));
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId2, kPhysicalTableId2, {20}));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(10), _, _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Some error.")));
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(20), _, _))
+      .WillOnce(Invoke(FakeGetAclStatsBatch));
+
+  ::util::Status status = collector_->SyncNow();
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr("Some error."));
+  BcmAclStats stats;
+  EXPECT_OK(collector_->GetStats(20, absl::Hours(1), &stats));
+  EXPECT_FALSE(collector_->GetStats(10, absl::Hours(1), &stats).ok());
+}
+
+TEST_F(BcmAclStatsCollectorTest, FailedFlowDoesNotAffectOtherFlows) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10, 11}));
+  // The counters of the flow 10 cannot be read.
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, _, _, _))
+      .WillOnce(Invoke([](int unit, const std::vector<int>& flow_ids,
+                          std::vector<BcmAclStats>* stats,
+                          std::vector<::util::Status>* details) {
+        FakeGetAclStatsBatch(unit, flow_ids, stats, details).IgnoreError();
+        for (size_t i = 0; i < flow_ids.size(); ++i) {
+          if (flow_ids[i] == 10) (*stats)[i].Clear();
+        }
+        return ::util::Status(StratumErrorSpace(), ERR_INTERNAL,
+                              "Some error.");
+      }));
+
+  ::util::Status status = collector_->SyncNow();
+  EXPECT_THAT(status.error_message(), HasSubstr("Some error."));
+  BcmAclStats stats;
+  EXPECT_OK(collector_->GetStats(11, absl::Hours(1), &stats));
+  EXPECT_EQ(1100, stats.total().bytes());
+  EXPECT_FALSE(collector_->GetStats(10, absl::Hours(1), &stats).ok());
+}
+
+TEST_F(BcmAclStatsCollectorTest, BackgroundThreadCollectsStats) {
+  ASSERT_NO_FATAL_FAILURE(AddAclTable(kTableId1, kPhysicalTableId1, {10}));
+  absl::Notification collected;
+  EXPECT_CALL(*bcm_sdk_mock_, GetAclStatsBatch(kUnit, ElementsAre(10), _, _))
+      .WillRepeatedly(Invoke(
+          [&collected](int unit, const std::vector<int>& flow_ids,
+                       std::vector<BcmAclStats>* stats,
+                       std::vector<::util::Status>* details) {
+            if (!collected.HasBeenNotified()) collected.Notify();
+            return FakeGetAclStatsBatch(unit, flow_ids, stats, details);
+          }));
+
+  EXPECT_FALSE(collector_->IsRunning());
+  ASSERT_OK(collector_->Start(absl::Milliseconds(1)));
+  EXPECT_TRUE(collector_->IsRunning());
+  ASSERT_TRUE(collected.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ASSERT_OK(collector_->Stop());
+  EXPECT_FALSE(collector_->IsRunning());
+  // Reads sync the counters on demand once the collector is stopped.
+  BcmAclStats stats;
+  EXPECT_OK(collector_->GetStats(10, absl::Hours(1), &stats));
+}
+
+TEST_F(BcmAclStatsCollectorTest, StartFailsForInvalidInterval) {
+  EXPECT_FALSE(collector_->Start(absl::ZeroDuration()).ok());
+  EXPECT_FALSE(collector_->IsRunning());
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
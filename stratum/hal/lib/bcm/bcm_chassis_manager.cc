@@ -19,6 +19,7 @@
 #include <pthread.h>
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <sstream>  // IWYU pragma: keep
 
@@ -28,6 +29,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "stratum/glue/logging.h"
 #include "stratum/hal/lib/bcm/utils.h"
 #include "stratum/hal/lib/common/common.pb.h"
@@ -52,6 +54,7 @@ DEFINE_string(bcm_sdk_config_flush_file, "/tmp/stratum/config.bcm.tmp",
               "The BCM config flush file loaded by SDK while initializing.");
 DEFINE_string(bcm_sdk_shell_log_file, "/tmp/stratum/bcm.log",
               "The BCM shell log file loaded by SDK while initializing.");
+DECLARE_int32(port_counters_sampling_interval_ms);
 DEFINE_string(bcm_sdk_checkpoint_dir, "",
               "The dir used by SDK to save checkpoints. Default is empty and "
               "it is expected to be explicitly given by flags.");
@@ -104,7 +107,16 @@ BcmChassisManager::BcmChassisManager(OperationMode mode,
       linkscan_event_channel_(nullptr),
       phal_interface_(ABSL_DIE_IF_NULL(phal_interface)),
       bcm_sdk_interface_(ABSL_DIE_IF_NULL(bcm_sdk_interface)),
-      bcm_serdes_db_manager_(ABSL_DIE_IF_NULL(bcm_serdes_db_manager)) {}
+      bcm_serdes_db_manager_(ABSL_DIE_IF_NULL(bcm_serdes_db_manager)),
+      unit_to_bcm_node_(),
+      port_counters_sampler_(PortCountersSampler::CreateInstance(
+          [this](std::vector<PortCountersSampler::Sample>* samples) {
+            return SweepPortCounters(samples);
+          },
+          [this](uint64 node_id, uint32 port_id,
+                 const PortCounters& counters) {
+            SendPortCountersGnmiEvent(node_id, port_id, counters);
+          })) {}
 
 // Default constructor is called by the mock class only.
 BcmChassisManager::BcmChassisManager()
@@ -138,7 +150,9 @@ BcmChassisManager::BcmChassisManager()
       linkscan_event_channel_(nullptr),
       phal_interface_(nullptr),
       bcm_sdk_interface_(nullptr),
-      bcm_serdes_db_manager_(nullptr) {}
+      bcm_serdes_db_manager_(nullptr),
+      unit_to_bcm_node_(),
+      port_counters_sampler_(nullptr) {}
 
 BcmChassisManager::~BcmChassisManager() {
   // NOTE: We should not detach any unit or unregister any handler in the
@@ -172,6 +186,10 @@ BcmChassisManager::~BcmChassisManager() {
     RETURN_IF_ERROR(ConfigurePortGroups());
     RETURN_IF_ERROR(RegisterEventWriters());
     initialized_ = true;
+    if (FLAGS_port_counters_sampling_interval_ms > 0) {
+      RETURN_IF_ERROR(port_counters_sampler_->Start(
+          absl::Milliseconds(FLAGS_port_counters_sampling_interval_ms)));
+    }
   } else {
     // If already initialized, sync the internal state and (re-)configure the
     // the flex and non-flex port groups.
@@ -222,6 +240,10 @@ BcmChassisManager::~BcmChassisManager() {
 
 ::util::Status BcmChassisManager::Shutdown() {
   ::util::Status status = ::util::OkStatus();
+  // The sampler takes chassis_lock, so it is stopped before anything else.
+  if (port_counters_sampler_) {
+    APPEND_STATUS_IF_ERROR(status, port_counters_sampler_->Stop());
+  }
   APPEND_STATUS_IF_ERROR(status, UnregisterEventWriters());
   APPEND_STATUS_IF_ERROR(status, bcm_sdk_interface_->ShutdownAllUnits());
   initialized_ = false;  // Set to false even if there is an error
@@ -1777,6 +1799,58 @@ void BcmChassisManager::SendPortOperStateGnmiEvent(uint64 node_id,
   }
 }
 
+::util::Status BcmChassisManager::SweepPortCounters(
+    std::vector<PortCountersSampler::Sample>* samples) {
+  {
+    absl::ReaderMutexLock l(&gnmi_event_lock_);
+    if (!gnmi_event_writer_) return ::util::OkStatus();
+  }
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown || !initialized_) return ::util::OkStatus();
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& e : node_id_to_port_id_to_sdk_port_) {
+    uint64 node_id = e.first;
+    // Group the ports by unit, so all the ports of a unit are read in one go.
+    std::map<int, std::vector<std::pair<uint32, int>>> unit_to_ports;
+    for (const auto& entry : e.second) {
+      unit_to_ports[entry.second.unit].emplace_back(
+          entry.first, entry.second.logical_port);
+    }
+    for (const auto& entry : unit_to_ports) {
+      int unit = entry.first;
+      std::vector<int> logical_ports;
+      logical_ports.reserve(entry.second.size());
+      for (const auto& port : entry.second) {
+        logical_ports.push_back(port.second);
+      }
+      std::vector<PortCounters> counters;
+      ::util::Status error = bcm_sdk_interface_->GetPortCountersBatch(
+          unit, logical_ports, &counters);
+      if (!error.ok()) {
+        APPEND_STATUS_IF_ERROR(status, error);
+        continue;
+      }
+      for (size_t i = 0; i < entry.second.size(); ++i) {
+        samples->push_back(PortCountersSampler::Sample{
+            node_id, entry.second[i].first, std::move(counters[i])});
+      }
+    }
+  }
+
+  return status;
+}
+
+void BcmChassisManager::SendPortCountersGnmiEvent(
+    uint64 node_id, uint32 port_id, const PortCounters& counters) {
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  if (!gnmi_event_writer_->Write(GnmiEventPtr(
+          new PortCountersChangedEvent(node_id, port_id, counters)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
 void* BcmChassisManager::TransceiverEventHandlerThreadFunc(void* arg) {
   CHECK(arg != nullptr);
   // Retrieve arguments.
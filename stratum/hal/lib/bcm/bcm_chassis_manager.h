@@ -40,6 +40,7 @@
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/phal_interface.h"
+#include "stratum/hal/lib/common/port_counters_sampler.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
 #include "absl/base/thread_annotations.h"
@@ -360,6 +361,21 @@ class BcmChassisManager : public BcmChassisRoInterface {
                                   PortState new_state)
       SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(gnmi_event_lock_);
 
+  // Reads the counters of all the singleton ports of the chassis, one
+  // GetPortCountersBatch() call per unit. Called by port_counters_sampler_
+  // once per sweep. Returns no samples if no gNMI event writer is registered,
+  // as nobody would consume the changes.
+  ::util::Status SweepPortCounters(
+      std::vector<PortCountersSampler::Sample>* samples)
+      LOCKS_EXCLUDED(chassis_lock, gnmi_event_lock_);
+
+  // Forward PortCounters changed events through the registered
+  // ChannelWriter<GnmiEventPtr> object. Called by port_counters_sampler_ for
+  // each port whose counters changed since the previous sweep.
+  void SendPortCountersGnmiEvent(uint64 node_id, uint32 port_id,
+                                 const PortCounters& counters)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
   // Sets the speed for a flex port group after a chassis config is pushed. The
   // input is a PortKey encapsulating (slot, port) of the port group. The
   // function determines if there is a change in the speed based on the pushed
@@ -584,6 +600,12 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // Map from unit to BcmNode instance.
   std::map<int, BcmNode*> unit_to_bcm_node_;  // not owned by this class.
 
+  // Samples the port counters in the background and emits a
+  // PortCountersChangedEvent for each port whose counters changed. Started
+  // on the first config push if FLAGS_port_counters_sampling_interval_ms > 0
+  // and stopped on Shutdown().
+  std::unique_ptr<PortCountersSampler> port_counters_sampler_;
+
   friend class BcmChassisManagerTest;
 };
 
@@ -49,13 +49,16 @@ DECLARE_string(bcm_sdk_config_file);
 DECLARE_string(bcm_sdk_config_flush_file);
 DECLARE_string(bcm_sdk_shell_log_file);
 DECLARE_string(bcm_sdk_checkpoint_dir);
+DECLARE_int32(port_counters_sampling_interval_ms);
 DECLARE_string(test_tmpdir);
 
 using ::testing::_;
+using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Matcher;
 using ::testing::Mock;
 using ::testing::Return;
+using ::testing::SetArgPointee;
 
 namespace stratum {
 namespace hal {
@@ -75,6 +78,15 @@ MATCHER_P(GnmiEventEq, event, "") {
            cast_event.GetNodeId() == cast_arg.GetNodeId() &&
            cast_event.GetNewState() == cast_arg.GetNewState();
   }
+  if (absl::StrContains(typeid(*event).name(), "PortCountersChangedEvent")) {
+    const auto& cast_event =
+        static_cast<const PortCountersChangedEvent&>(*event);
+    const auto& cast_arg = static_cast<const PortCountersChangedEvent&>(*arg);
+    return cast_event.GetPortId() == cast_arg.GetPortId() &&
+           cast_event.GetNodeId() == cast_arg.GetNodeId() &&
+           cast_event.GetInOctets() == cast_arg.GetInOctets() &&
+           cast_event.GetOutOctets() == cast_arg.GetOutOctets();
+  }
   return false;
 }
 
@@ -91,6 +103,8 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     FLAGS_bcm_sdk_config_flush_file = FLAGS_test_tmpdir + "/config.bcm.tmp";
     FLAGS_bcm_sdk_shell_log_file = FLAGS_test_tmpdir + "/bcm.log";
     FLAGS_bcm_sdk_checkpoint_dir = FLAGS_test_tmpdir + "/sdk_checkpoint/";
+    // The tests sample the port counters explicitly.
+    FLAGS_port_counters_sampling_interval_ms = 0;
   }
 
   void SetUp() override {
@@ -121,6 +135,10 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     bcm_chassis_manager_->LinkscanEventHandler(unit, logical_port, state);
   }
 
+  ::util::StatusOr<int> SamplePortCounters() {
+    return bcm_chassis_manager_->port_counters_sampler_->SampleNow();
+  }
+
   ::util::Status CheckCleanInternalState() {
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->unit_to_bcm_chip_.empty());
     CHECK_RETURN_IF_FALSE(
@@ -4599,6 +4617,151 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
   }
 }
 
+TEST_P(BcmChassisManagerTest, SamplePortCountersAfterConfigPush) {
+  const std::string kBcmChassisMapListText = R"(
+      bcm_chassis_maps {
+        bcm_chips {
+          type: TOMAHAWK
+          slot: 1
+          unit: 0
+          module: 0
+          pci_bus: 7
+          pci_slot: 1
+          is_oversubscribed: true
+        }
+        bcm_ports {
+          type: CE
+          slot: 1
+          port: 1
+          unit: 0
+          speed_bps: 100000000000
+          logical_port: 34
+          physical_port: 33
+          diag_port: 0
+          serdes_lane: 0
+          num_serdes_lanes: 4
+        }
+      }
+  )";
+
+  const std::string kConfigText = R"(
+      description: "Sample Generic Tomahawk config 32x100G ports."
+      chassis {
+        platform: PLT_GENERIC_TOMAHAWK
+        name: "standalone"
+      }
+      nodes {
+        id: 7654321
+        slot: 1
+      }
+      singleton_ports {
+        id: 12345
+        slot: 1
+        port: 1
+        speed_bps: 100000000000
+        node: 7654321
+      }
+  )";
+
+  // WriterInterface for reporting gNMI events.
+  auto gnmi_event_writer = std::make_shared<WriterMock<GnmiEventPtr>>();
+  PortCounters counters1, counters2;
+  counters1.set_in_octets(100);
+  counters1.set_out_octets(200);
+  counters2.set_in_octets(150);
+  counters2.set_out_octets(200);
+  GnmiEventPtr counters_changed(
+      new PortCountersChangedEvent(kNodeId, kPortId, counters2));
+
+  // Expectations for the mock objects.
+  EXPECT_CALL(*bcm_serdes_db_manager_mock_, Load());
+  EXPECT_CALL(*bcm_sdk_mock_, InitializeSdk(FLAGS_bcm_sdk_config_file,
+                                            FLAGS_bcm_sdk_config_flush_file,
+                                            FLAGS_bcm_sdk_shell_log_file))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, FindUnit(0, 7, 1, BcmChip::TOMAHAWK))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, InitializeUnit(0, false))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetModuleId(0, 0))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, InitializePort(0, 34))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, StartDiagShellServer())
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetPortOptions(0, 34, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              RegisterLinkscanEventWriter(
+                  _, BcmSdkInterface::kLinkscanEventWriterPriorityHigh))
+      .WillOnce(Return(kTestLinkscanWriterId));
+  EXPECT_CALL(*phal_mock_,
+              RegisterTransceiverEventWriter(
+                  _, PhalInterface::kTransceiverEventWriterPriorityHigh))
+      .WillOnce(Return(kTestTransceiverWriterId));
+  EXPECT_CALL(*bcm_sdk_mock_, StartLinkscan(0))
+      .WillOnce(Return(::util::OkStatus()));
+  // All the ports of unit 0 are read with a single call per sweep.
+  EXPECT_CALL(*bcm_sdk_mock_,
+              GetPortCountersBatch(0, std::vector<int>({34}), _))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<PortCounters>({counters1})),
+                      Return(::util::OkStatus())))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<PortCounters>({counters1})),
+                      Return(::util::OkStatus())))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<PortCounters>({counters2})),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*gnmi_event_writer, Write(Matcher<const GnmiEventPtr&>(
+                                      GnmiEventEq(counters_changed))))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              UnregisterLinkscanEventWriter(kTestLinkscanWriterId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*phal_mock_,
+              UnregisterTransceiverEventWriter(kTestTransceiverWriterId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, ShutdownAllUnits())
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Write the kBcmChassisMapListText to FLAGS_base_bcm_chassis_map_file.
+  ASSERT_OK(WriteStringToFile(kBcmChassisMapListText,
+                              FLAGS_base_bcm_chassis_map_file));
+
+  // Setup a test config and pass it to PushChassisConfig.
+  ChassisConfig config;
+  ASSERT_OK(ParseProtoFromString(kConfigText, &config));
+  ASSERT_OK(PushChassisConfig(config));
+  ASSERT_TRUE(Initialized());
+
+  // Nothing is read before a gNMI event writer is registered.
+  {
+    auto ret = SamplePortCounters();
+    ASSERT_OK(ret.status());
+    EXPECT_EQ(0, ret.ValueOrDie());
+  }
+  EXPECT_OK(RegisterEventNotifyWriter(gnmi_event_writer));
+
+  // The first sweep only records the counters, the second one sees no change
+  // and the third one reports the port whose counters changed.
+  {
+    auto ret = SamplePortCounters();
+    ASSERT_OK(ret.status());
+    EXPECT_EQ(0, ret.ValueOrDie());
+  }
+  {
+    auto ret = SamplePortCounters();
+    ASSERT_OK(ret.status());
+    EXPECT_EQ(0, ret.ValueOrDie());
+  }
+  {
+    auto ret = SamplePortCounters();
+    ASSERT_OK(ret.status());
+    EXPECT_EQ(1, ret.ValueOrDie());
+  }
+
+  ASSERT_OK(Shutdown());
+  ASSERT_FALSE(Initialized());
+}
+
 TEST_P(BcmChassisManagerTest, InitializeBcmChipsSuccess) {
   // This test config has a mix of flex and non-flex ports and mgmt ports.
   const std::string kBaseBcmChassisMapText = R"(
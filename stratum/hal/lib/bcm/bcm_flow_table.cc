@@ -0,0 +1,235 @@
+// Copyright 2018 Google LLC
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_flow_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+// Tags identifying the encoding used for a match key.
+constexpr char kFixedWidthKeyTag = 'F';
+constexpr char kGenericKeyTag = 'G';
+
+// Tags identifying the match type of a field in a match key.
+enum MatchTag : char {
+  kNoMatch = 0,
+  kExactMatch = 1,
+  kTernaryMatch = 2,
+  kLpmMatch = 3,
+  kRangeMatch = 4,
+  kOtherMatch = 5,
+};
+
+// Largest value width (in bytes) supported by a fixed-width slot. The length
+// of each value is stored in a single byte.
+constexpr size_t kMaxFixedWidth = 255;
+
+// Size of the encoded LPM prefix length.
+constexpr size_t kPrefixLenSize = sizeof(uint32);
+
+void AppendUint32(uint32 value, std::string* out) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out->push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+void AppendUint64(uint64 value, std::string* out) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    out->push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+// Appends a length-prefixed byte string.
+void AppendBytes(const std::string& bytes, std::string* out) {
+  AppendUint32(bytes.size(), out);
+  out->append(bytes);
+}
+
+// Appends the non-match part of the key, common to all encodings.
+void AppendEntryTrailer(const ::p4::v1::TableEntry& entry, std::string* out) {
+  AppendUint32(static_cast<uint32>(entry.priority()), out);
+  out->push_back(entry.is_default_action() ? 1 : 0);
+  AppendUint64(static_cast<uint64>(entry.idle_timeout_ns()), out);
+}
+
+// Encodes a single match field for the generic key.
+std::string EncodeFieldMatch(const ::p4::v1::FieldMatch& field) {
+  std::string out;
+  AppendUint32(field.field_id(), &out);
+  switch (field.field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact:
+      out.push_back(kExactMatch);
+      AppendBytes(field.exact().value(), &out);
+      break;
+    case ::p4::v1::FieldMatch::kTernary:
+      out.push_back(kTernaryMatch);
+      AppendBytes(field.ternary().value(), &out);
+      AppendBytes(field.ternary().mask(), &out);
+      break;
+    case ::p4::v1::FieldMatch::kLpm:
+      out.push_back(kLpmMatch);
+      AppendBytes(field.lpm().value(), &out);
+      AppendUint32(static_cast<uint32>(field.lpm().prefix_len()), &out);
+      break;
+    case ::p4::v1::FieldMatch::kRange:
+      out.push_back(kRangeMatch);
+      AppendBytes(field.range().low(), &out);
+      AppendBytes(field.range().high(), &out);
+      break;
+    default:
+      // Any other match type is compared on its serialized form.
+      out.push_back(kOtherMatch);
+      AppendBytes(ProtoSerialize(field), &out);
+      break;
+  }
+  return out;
+}
+
+// Stores a value in a fixed-width slot component as a length byte followed by
+// the value, zero-padded to width. Returns false if the value does not fit.
+bool PutFixedWidthValue(const std::string& value, size_t width, char* dst) {
+  if (value.size() > width) return false;
+  dst[0] = static_cast<char>(value.size());
+  if (!value.empty()) std::memcpy(dst + 1, value.data(), value.size());
+  return true;
+}
+
+}  // namespace
+
+TableEntryKeyLayout::TableEntryKeyLayout(const ::p4::config::v1::Table& table)
+    : slots_(), slot_index_(), key_size_(0) {
+  std::vector<const ::p4::config::v1::MatchField*> fields;
+  fields.reserve(table.match_fields_size());
+  for (const auto& match_field : table.match_fields()) {
+    fields.push_back(&match_field);
+  }
+  std::sort(fields.begin(), fields.end(),
+            [](const ::p4::config::v1::MatchField* l,
+               const ::p4::config::v1::MatchField* r) {
+              return l->id() < r->id();
+            });
+  for (const auto* match_field : fields) {
+    size_t width = (match_field->bitwidth() + 7) / 8;
+    // Without a usable bitwidth the table cannot have a fixed-width layout.
+    if (width == 0 || width > kMaxFixedWidth ||
+        slot_index_.count(match_field->id())) {
+      slots_.clear();
+      slot_index_.clear();
+      key_size_ = 0;
+      return;
+    }
+    slot_index_[match_field->id()] = slots_.size();
+    slots_.push_back({match_field->id(), key_size_, width});
+    // Match tag, first value (exact/ternary/LPM value, range low) and second
+    // value (ternary mask, LPM prefix length, range high).
+    key_size_ += 1 + (1 + width) + (1 + std::max(width, kPrefixLenSize));
+  }
+}
+
+std::string TableEntryKeyLayout::MakeKey(
+    const ::p4::v1::TableEntry& entry) const {
+  if (IsFixedWidth()) {
+    std::string key;
+    if (MakeFixedWidthKey(entry, &key)) return key;
+  }
+  return MakeGenericKey(entry);
+}
+
+std::string TableEntryKeyLayout::MakeGenericKey(
+    const ::p4::v1::TableEntry& entry) {
+  // The key does not depend on the order of the match fields.
+  std::vector<std::string> fields;
+  fields.reserve(entry.match_size());
+  size_t size = 0;
+  for (const auto& match : entry.match()) {
+    fields.push_back(EncodeFieldMatch(match));
+    size += fields.back().size() + sizeof(uint32);
+  }
+  std::sort(fields.begin(), fields.end());
+  std::string key;
+  key.reserve(1 + sizeof(uint32) + size + 2 * sizeof(uint64));
+  key.push_back(kGenericKeyTag);
+  AppendUint32(fields.size(), &key);
+  for (const auto& field : fields) AppendBytes(field, &key);
+  AppendEntryTrailer(entry, &key);
+  return key;
+}
+
+bool TableEntryKeyLayout::MakeFixedWidthKey(const ::p4::v1::TableEntry& entry,
+                                            std::string* key) const {
+  key->reserve(1 + key_size_ + 2 * sizeof(uint64));
+  key->assign(1 + key_size_, '\0');
+  (*key)[0] = kFixedWidthKeyTag;
+  for (const auto& match : entry.match()) {
+    auto it = slot_index_.find(match.field_id());
+    if (it == slot_index_.end()) return false;
+    const FieldSlot& slot = slots_[it->second];
+    char* tag = &(*key)[1 + slot.offset];
+    // A field may only be matched once.
+    if (*tag != kNoMatch) return false;
+    char* first = tag + 1;
+    char* second = first + 1 + slot.width;
+    size_t second_width = std::max(slot.width, kPrefixLenSize);
+    switch (match.field_match_type_case()) {
+      case ::p4::v1::FieldMatch::kExact:
+        if (!PutFixedWidthValue(match.exact().value(), slot.width, first)) {
+          return false;
+        }
+        *tag = kExactMatch;
+        break;
+      case ::p4::v1::FieldMatch::kTernary:
+        if (!PutFixedWidthValue(match.ternary().value(), slot.width, first) ||
+            !PutFixedWidthValue(match.ternary().mask(), second_width,
+                                second)) {
+          return false;
+        }
+        *tag = kTernaryMatch;
+        break;
+      case ::p4::v1::FieldMatch::kLpm: {
+        if (!PutFixedWidthValue(match.lpm().value(), slot.width, first)) {
+          return false;
+        }
+        std::string prefix_len;
+        AppendUint32(static_cast<uint32>(match.lpm().prefix_len()),
+                     &prefix_len);
+        PutFixedWidthValue(prefix_len, second_width, second);
+        *tag = kLpmMatch;
+        break;
+      }
+      case ::p4::v1::FieldMatch::kRange:
+        if (!PutFixedWidthValue(match.range().low(), slot.width, first) ||
+            !PutFixedWidthValue(match.range().high(), second_width, second)) {
+          return false;
+        }
+        *tag = kRangeMatch;
+        break;
+      default:
+        return false;
+    }
+  }
+  AppendEntryTrailer(entry, key);
+  return true;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
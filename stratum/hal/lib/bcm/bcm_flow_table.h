@@ -19,15 +19,20 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 #define STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 
+#include <iterator>
 #include <utility>
 #include <string>
-#include <algorithm>
+#include <vector>
 
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
 #include "stratum/glue/integral_types.h"
-#include "absl/container/node_hash_set.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/hash/hash.h"
+#include "p4/config/v1/p4info.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
@@ -39,96 +44,164 @@ namespace stratum {
 namespace hal {
 namespace bcm {
 
-// Custom hash and equal function for P4 TableEntry protos. We need a way
-// to differeniate flows in the following way: If we have 2 flows f1 and f2
-// with f2 being the modified version of f1 as intended by the controller, f1
-// = f2. In any other case they should not.
+// TableEntryKeyLayout builds the canonical binary match key used to identify
+// P4 TableEntry protos in a BcmFlowTable. We need a way to differentiate flows
+// in the following way: If we have 2 flows f1 and f2 with f2 being the
+// modified version of f1 as intended by the controller, f1 = f2. In any other
+// case they should not. Two entries are therefore identified by their match
+// fields (regardless of order), priority, is_default_action and
+// idle_timeout_ns. The action, controller metadata, meter config and counter
+// data are not part of the key.
+//
+// When constructed from a P4Info table, the layout assigns every match field
+// of the table a fixed-width slot (ordered by field id), so keys of the same
+// table have a constant size and can be built without sorting. Entries that do
+// not fit the layout (unknown field ids, duplicated fields, values wider than
+// the field bitwidth), and all entries of tables with no P4Info, fall back to a
+// generic encoding in which the individually encoded match fields are sorted.
+// The key is built once per operation; hashing and equality are then
+// proportional to the key size and not to the size of the entry proto.
+class TableEntryKeyLayout {
+ public:
+  // Generic layout, used when the P4Info for the table is not known.
+  TableEntryKeyLayout() : slots_(), slot_index_(), key_size_(0) {}
+
+  // Fixed-width layout for the match fields of the given P4Info table.
+  explicit TableEntryKeyLayout(const ::p4::config::v1::Table& table);
+
+  // Returns the canonical match key for the given entry.
+  std::string MakeKey(const ::p4::v1::TableEntry& entry) const;
+
+  // Returns the canonical match key for the given entry using the generic
+  // encoding.
+  static std::string MakeGenericKey(const ::p4::v1::TableEntry& entry);
+
+  // Returns true if this layout has fixed-width slots from a P4Info table.
+  bool IsFixedWidth() const { return !slots_.empty(); }
+
+ private:
+  // Fixed-width slot reserved for a match field in the key.
+  struct FieldSlot {
+    uint32 field_id;
+    // Offset of the slot inside the key.
+    size_t offset;
+    // Width in bytes of each value stored in the slot.
+    size_t width;
+  };
+
+  // Encodes the match fields of the entry into a fixed-width key. Returns
+  // false if the entry does not fit the layout.
+  bool MakeFixedWidthKey(const ::p4::v1::TableEntry& entry,
+                         std::string* key) const;
+
+  // Slots ordered by field id.
+  std::vector<FieldSlot> slots_;
+  // Map from field id to the index of its slot in slots_.
+  absl::flat_hash_map<uint32, size_t> slot_index_;
+  // Size of the match field part of a fixed-width key.
+  size_t key_size_;
+};
+
+// Custom hash and equal function for P4 TableEntry protos, based on the
+// generic canonical match key. See TableEntryKeyLayout for the semantics.
 struct TableEntryHash {
   size_t operator()(const ::p4::v1::TableEntry& x) const {
-    // Save a copy of the input proto, clear actions/metadata/counter/meter,
-    // and hash the rest.
-    ::p4::v1::TableEntry a = x;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    // Hash on match field combination, not on permutation.
-    std::sort(a.mutable_match()->begin(), a.mutable_match()->end(),
-              [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-                return ProtoSerialize(l) < ProtoSerialize(r);
-              });
-    return std::hash<std::string>()(ProtoSerialize(a));
+    return absl::Hash<std::string>()(TableEntryKeyLayout::MakeGenericKey(x));
   }
 };
 
 struct TableEntryEqual {
   bool operator()(const ::p4::v1::TableEntry& x,
                   const ::p4::v1::TableEntry& y) const {
-    // Save copies of the input protos, clear actions/metadata/counter/meter
-    // and compare the rest.
-    ::p4::v1::TableEntry a = x, b = y;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    b.clear_table_id();
-    b.clear_action();
-    b.clear_controller_metadata();
-    b.clear_meter_config();
-    b.clear_counter_data();
-    // The order of the match fields are not important.
-    if (a.match_size() != b.match_size() ||
-        !std::is_permutation(
-            a.match().begin(), a.match().end(), b.match().begin(),
-            [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-              return ProtoSerialize(l) == ProtoSerialize(r);
-            })) {
-      return false;
-    }
-    a.clear_match();
-    b.clear_match();
-    return ProtoSerialize(a) == ProtoSerialize(b);
+    return TableEntryKeyLayout::MakeGenericKey(x) ==
+           TableEntryKeyLayout::MakeGenericKey(y);
   }
 };
 
-using TableEntrySet =
-    absl::node_hash_set<::p4::v1::TableEntry, TableEntryHash, TableEntryEqual>;
+// Map from the canonical match key to the P4 TableEntry it identifies.
+using TableEntryMap = absl::node_hash_map<std::string, ::p4::v1::TableEntry>;
 
 // Class for managing a BCM table.
 class BcmFlowTable {
  public:
-  // STL-style types that allow table traversal.
-  using const_iterator = TableEntrySet::const_iterator;
-  using value_type = TableEntrySet::value_type;
+  // STL-style iterator that allows table traversal. Dereferences to the
+  // stored P4 TableEntry.
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ::p4::v1::TableEntry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ::p4::v1::TableEntry*;
+    using reference = const ::p4::v1::TableEntry&;
+
+    const_iterator() : iter_() {}
+    explicit const_iterator(TableEntryMap::const_iterator iter) : iter_(iter) {}
+
+    reference operator*() const { return iter_->second; }
+    pointer operator->() const { return &iter_->second; }
+    const_iterator& operator++() {
+      ++iter_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      ++iter_;
+      return tmp;
+    }
+    bool operator==(const const_iterator& other) const {
+      return iter_ == other.iter_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return iter_ != other.iter_;
+    }
+
+   private:
+    TableEntryMap::const_iterator iter_;
+  };
+  using value_type = ::p4::v1::TableEntry;
 
   // Constructors.
   explicit BcmFlowTable(uint32 p4_table_id)
-      : id_(p4_table_id), name_(), entries_(), is_const_(false) {}
+      : id_(p4_table_id),
+        name_(),
+        layout_(),
+        entries_(),
+        is_const_(false),
+        changed_keys_() {}
 
   BcmFlowTable(uint32 p4_table_id, absl::string_view name)
-      : id_(p4_table_id), name_(name), entries_(), is_const_(false) {}
+      : id_(p4_table_id),
+        name_(name),
+        layout_(),
+        entries_(),
+        is_const_(false),
+        changed_keys_() {}
 
   explicit BcmFlowTable(const ::p4::config::v1::Table& table)
       : id_(table.preamble().id()),
         name_(table.preamble().name()),
+        layout_(table),
         entries_(),
-        is_const_(table.is_const_table()) {}
+        is_const_(table.is_const_table()),
+        changed_keys_() {}
 
   // Copy Constructor.
   BcmFlowTable(const BcmFlowTable& other)
       : id_(other.id_),
         name_(other.name_),
+        layout_(other.layout_),
         entries_(other.entries_),
-        is_const_(other.is_const_) {}
+        is_const_(other.is_const_),
+        changed_keys_(other.changed_keys_) {}
 
   // Move Constructor.
   BcmFlowTable(BcmFlowTable&& other)
       : id_(other.id_),
         name_(std::move(other.name_)),
+        layout_(std::move(other.layout_)),
         entries_(std::move(other.entries_)),
-        is_const_(other.is_const_) {}
+        is_const_(other.is_const_),
+        changed_keys_(std::move(other.changed_keys_)) {}
 
   // Copy assignment operator.
   BcmFlowTable& operator=(const BcmFlowTable&) = default;
@@ -146,9 +219,17 @@ class BcmFlowTable {
   // Returns the table's P4 name.
   virtual std::string Name() const { return name_; }
 
+  // Returns the canonical match key identifying the given entry in this table.
+  std::string MatchKey(const ::p4::v1::TableEntry& entry) const {
+    return layout_.MakeKey(entry);
+  }
+
+  // Returns the layout used to build the match keys of this table.
+  const TableEntryKeyLayout& KeyLayout() const { return layout_; }
+
   // Returns true if this table already has this entry.
   virtual bool HasEntry(const ::p4::v1::TableEntry& entry) const {
-    return entries_.count(entry) > 0;
+    return entries_.count(MatchKey(entry)) > 0;
   }
 
   // Returns the number of entries in this table.
@@ -161,17 +242,33 @@ class BcmFlowTable {
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry is not found.
   virtual ::util::StatusOr<::p4::v1::TableEntry> Lookup(
       const ::p4::v1::TableEntry& key) const {
-    auto lookup = entries_.find(key);
+    auto lookup = entries_.find(MatchKey(key));
     if (lookup == entries_.end()) {
       return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
              << TableStr()
              << " does not contain TableEntry: " << key.ShortDebugString();
     }
-    return *lookup;
+    return lookup->second;
+  }
+
+  // Returns the entry with the given match key, or nullptr if this table has
+  // no such entry.
+  const ::p4::v1::TableEntry* FindMatchKey(const std::string& match_key) const {
+    auto lookup = entries_.find(match_key);
+    return lookup == entries_.end() ? nullptr : &lookup->second;
   }
 
-  TableEntrySet::const_iterator begin() const { return entries_.begin(); }
-  TableEntrySet::const_iterator end() const { return entries_.end(); }
+  // Returns the match keys of the entries which have been inserted, modified
+  // or deleted since the last call to ClearChangedMatchKeys().
+  const absl::flat_hash_set<std::string>& ChangedMatchKeys() const {
+    return changed_keys_;
+  }
+
+  // Forgets the changes recorded so far.
+  void ClearChangedMatchKeys() { changed_keys_.clear(); }
+
+  const_iterator begin() const { return const_iterator(entries_.begin()); }
+  const_iterator end() const { return const_iterator(entries_.end()); }
 
   // Returns true if this is a const table.
   virtual bool IsConst() const { return is_const_; }
@@ -189,41 +286,35 @@ class BcmFlowTable {
   // 2) TableEntry.priority
   // 3) is_default_action
   //
-  // See TableEntryEqual below.
+  // See TableEntryKeyLayout above.
   virtual ::util::Status InsertEntry(const ::p4::v1::TableEntry& entry) {
-    auto result = entries_.insert(entry);
-    if (!result.second) {
-      return MAKE_ERROR(ERR_ENTRY_EXISTS)
-             << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result.first->ShortDebugString()
-             << ".";
-    }
-    return ::util::OkStatus();
+    return InsertEntryWithKey(MatchKey(entry), entry);
   }
 
   // Performs a dry-run of InsertEntry. Returns errors if the entry cannot be
   // inserted. If the entry can be inserted, returns ::util::OkStatus().
   virtual ::util::Status DryRunInsertEntry(
       const ::p4::v1::TableEntry& entry) const {
-    const auto result = entries_.find(entry);
-    if (result != entries_.end()) {
-      return MAKE_ERROR(ERR_ENTRY_EXISTS)
-             << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result->ShortDebugString() << ".";
-    }
-    return ::util::OkStatus();
+    return DryRunInsertEntryWithKey(MatchKey(entry), entry);
   }
 
   // Attempts to modify an existing entry in this table. Returns the original
-  // entry on success.
+  // entry on success. The entry is replaced in place; bookkeeping attached to
+  // the match key by derived classes is preserved.
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   // Returns an error if the entry cannot be added.
   virtual ::util::StatusOr<::p4::v1::TableEntry> ModifyEntry(
       const ::p4::v1::TableEntry& entry) {
-    ASSIGN_OR_RETURN(::p4::v1::TableEntry old_entry, DeleteEntry(entry));
-    entries_.insert(entry);
+    auto lookup = entries_.find(MatchKey(entry));
+    if (lookup == entries_.end()) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << TableStr()
+             << " does not contain TableEntry: " << entry.ShortDebugString()
+             << ".";
+    }
+    ::p4::v1::TableEntry old_entry = std::move(lookup->second);
+    lookup->second = entry;
+    changed_keys_.insert(lookup->first);
     return old_entry;
   }
 
@@ -232,22 +323,62 @@ class BcmFlowTable {
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   virtual ::util::StatusOr<::p4::v1::TableEntry> DeleteEntry(
       const ::p4::v1::TableEntry& key) {
-    const auto lookup = entries_.find(key);
+    return DeleteEntryWithKey(MatchKey(key), key);
+  }
+
+ protected:
+  // Returns the standard Table ID string.
+  std::string TableStr() const {
+    return absl::StrCat("Table <", Id(), "> (", Name(), ")");
+  }
+
+  // Versions of the entry management functions above that take a match key
+  // already computed by MatchKey(). The entry is only used for the stored
+  // value and error messages.
+  ::util::Status InsertEntryWithKey(std::string match_key,
+                                    const ::p4::v1::TableEntry& entry) {
+    auto result = entries_.emplace(std::move(match_key), entry);
+    if (!result.second) {
+      return MAKE_ERROR(ERR_ENTRY_EXISTS)
+             << TableStr() << " contains duplicate of TableEntry: "
+             << entry.ShortDebugString() << ". Matching TableEntry: "
+             << result.first->second.ShortDebugString() << ".";
+    }
+    changed_keys_.insert(result.first->first);
+    return ::util::OkStatus();
+  }
+
+  ::util::Status DryRunInsertEntryWithKey(
+      const std::string& match_key, const ::p4::v1::TableEntry& entry) const {
+    const auto result = entries_.find(match_key);
+    if (result != entries_.end()) {
+      return MAKE_ERROR(ERR_ENTRY_EXISTS)
+             << TableStr() << " contains duplicate of TableEntry: "
+             << entry.ShortDebugString()
+             << ". Matching TableEntry: " << result->second.ShortDebugString()
+             << ".";
+    }
+    return ::util::OkStatus();
+  }
+
+  ::util::StatusOr<::p4::v1::TableEntry> DeleteEntryWithKey(
+      const std::string& match_key, const ::p4::v1::TableEntry& key) {
+    auto lookup = entries_.find(match_key);
     if (lookup == entries_.end()) {
       return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
              << TableStr()
              << " does not contain TableEntry: " << key.ShortDebugString()
              << ".";
     }
-    ::p4::v1::TableEntry entry = *lookup;
+    ::p4::v1::TableEntry entry = std::move(lookup->second);
+    changed_keys_.insert(match_key);
     entries_.erase(lookup);
     return entry;
   }
 
- protected:
-  // Returns the standard Table ID string.
-  std::string TableStr() const {
-    return absl::StrCat("Table <", Id(), "> (", Name(), ")");
+  // Returns true if this table has an entry with the given match key.
+  bool HasMatchKey(const std::string& match_key) const {
+    return entries_.count(match_key) > 0;
   }
 
   // ***************************************************************************
@@ -255,11 +386,16 @@ class BcmFlowTable {
   // ***************************************************************************
   uint32 id_;
   std::string name_;
-  // Keeps track of all entries currently in the table.
-  TableEntrySet entries_;
+  // Layout used to build the match keys of the entries in this table.
+  TableEntryKeyLayout layout_;
+  // Keeps track of all entries currently in the table, indexed by match key.
+  TableEntryMap entries_;
   // True is this is a const table. Const tables can only be modified during
   // SetForwardingPipelineConfig().
   bool is_const_;
+  // Match keys of the entries changed since the last ClearChangedMatchKeys().
+  // Used to update the read snapshots of the table incrementally.
+  absl::flat_hash_set<std::string> changed_keys_;
 };
 
 }  // namespace bcm
@@ -13,6 +13,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_flow_table.h"
@@ -327,6 +328,72 @@ TEST(BcmFlowTableTest, ConstructFromP4ConfigTable) {
   EXPECT_EQ(true, bcm_table.IsConst());
 }
 
+// Verify that the order of the match fields does not matter.
+TEST(BcmFlowTableTest, LookupPermutedMatch) {
+  ::p4::v1::TableEntry mod = MockTableEntry();
+  std::reverse(mod.mutable_match()->begin(), mod.mutable_match()->end());
+
+  BcmFlowTable table(1);
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  EXPECT_EQ(table.MatchKey(MockTableEntry()), table.MatchKey(mod));
+  EXPECT_THAT(table.Lookup(mod), IsOkAndHolds(EqualsProto(MockTableEntry())));
+  EXPECT_EQ(table.InsertEntry(mod).error_code(), ERR_ENTRY_EXISTS);
+}
+
+// P4 config Table with the match fields used by MockTableEntry.
+::p4::config::v1::Table MockP4Table() {
+  ::p4::config::v1::Table p4_table;
+  CHECK_OK(ParseProtoFromString(R"PROTO(
+      preamble { id: 1 name: "table" }
+      match_fields { id: 3 bitwidth: 32 match_type: LPM }
+      match_fields { id: 1 bitwidth: 16 match_type: EXACT }
+      match_fields { id: 2 bitwidth: 8 match_type: TERNARY })PROTO",
+                                &p4_table));
+  return p4_table;
+}
+
+// Verify that tables built from a P4 config Table use fixed-width keys.
+TEST(BcmFlowTableTest, FixedWidthMatchKey) {
+  BcmFlowTable table(MockP4Table());
+  ::p4::v1::TableEntry other = MockTableEntry();
+  other.mutable_match(0)->mutable_exact()->set_value("7");
+  std::reverse(other.mutable_match()->begin(), other.mutable_match()->end());
+  EXPECT_EQ(table.MatchKey(MockTableEntry()).size(),
+            table.MatchKey(other).size());
+  EXPECT_NE(table.MatchKey(MockTableEntry()), table.MatchKey(other));
+
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  ASSERT_OK(table.InsertEntry(other));
+  EXPECT_EQ(2, table.EntryCount());
+  EXPECT_THAT(table.Lookup(other), IsOkAndHolds(EqualsProto(other)));
+  ASSERT_THAT(table.DeleteEntry(other), IsOkAndHolds(EqualsProto(other)));
+  EXPECT_TRUE(table.HasEntry(MockTableEntry()));
+  EXPECT_FALSE(table.HasEntry(other));
+}
+
+// Verify that entries which do not fit the fixed-width layout are still
+// managed, and remain distinct from the entries that do.
+TEST(BcmFlowTableTest, FixedWidthMatchKeyFallback) {
+  BcmFlowTable table(MockP4Table());
+  // Value wider than the 8-bit field.
+  ::p4::v1::TableEntry wide = MockTableEntry();
+  wide.mutable_match(1)->mutable_ternary()->set_value("33");
+  // Unknown field id.
+  ::p4::v1::TableEntry unknown = MockTableEntry();
+  unknown.mutable_match(0)->set_field_id(100);
+  // Duplicated field.
+  ::p4::v1::TableEntry duplicate = MockTableEntry();
+  *duplicate.add_match() = duplicate.match(0);
+
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  for (const auto& entry : {wide, unknown, duplicate}) {
+    EXPECT_FALSE(table.HasEntry(entry));
+    ASSERT_OK(table.InsertEntry(entry));
+    EXPECT_THAT(table.Lookup(entry), IsOkAndHolds(EqualsProto(entry)));
+  }
+  EXPECT_EQ(4, table.EntryCount());
+}
+
 }  // namespace
 }  // namespace bcm
 }  // namespace hal
@@ -0,0 +1,166 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_knet_socket.h"
+
+#include <errno.h>
+#include <net/ethernet.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+BcmKnetRxSocket::BcmKnetRxSocket(int sock, size_t header_size,
+                                 size_t max_payload_size, int max_batch_size)
+    : sock_(sock),
+      header_size_(header_size),
+      max_payload_size_(max_payload_size),
+      max_batch_size_(std::max(max_batch_size, 1)),
+      buffers_(new char[max_batch_size_ * (header_size + max_payload_size)]),
+      iovecs_(2 * max_batch_size_),
+      addrs_(max_batch_size_),
+      msgs_(max_batch_size_),
+      frames_(max_batch_size_) {
+  const size_t buffer_size = header_size_ + max_payload_size_;
+  for (int i = 0; i < max_batch_size_; ++i) {
+    char* buffer = buffers_.get() + i * buffer_size;
+    iovecs_[2 * i].iov_base = buffer;
+    iovecs_[2 * i].iov_len = header_size_;
+    iovecs_[2 * i + 1].iov_base = buffer + header_size_;
+    iovecs_[2 * i + 1].iov_len = max_payload_size_;
+    memset(&msgs_[i], 0, sizeof(msgs_[i]));
+    msgs_[i].msg_hdr.msg_iov = &iovecs_[2 * i];
+    msgs_[i].msg_hdr.msg_iovlen = 2;
+    msgs_[i].msg_hdr.msg_name = &addrs_[i];
+    frames_[i].header = buffer;
+    frames_[i].header_size = header_size_;
+    frames_[i].payload = buffer + header_size_;
+  }
+}
+
+int BcmKnetRxSocket::ReceiveBatch() {
+  for (int i = 0; i < max_batch_size_; ++i) {
+    // The kernel overwrites these, so they need to be reset before each call.
+    memset(&addrs_[i], 0, sizeof(addrs_[i]));
+    msgs_[i].msg_hdr.msg_namelen = sizeof(addrs_[i]);
+    msgs_[i].msg_hdr.msg_flags = 0;
+    msgs_[i].msg_len = 0;
+  }
+  int num_msgs = recvmmsg(sock_, msgs_.data(), max_batch_size_, MSG_DONTWAIT,
+                          nullptr);
+  if (num_msgs < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    return -1;
+  }
+  for (int i = 0; i < num_msgs; ++i) {
+    BcmKnetRxFrame* frame = &frames_[i];
+    frame->length = msgs_[i].msg_len;
+    frame->payload_size =
+        frame->length > header_size_ ? frame->length - header_size_ : 0;
+    frame->truncated = msgs_[i].msg_hdr.msg_flags & MSG_TRUNC;
+    frame->ifindex = addrs_[i].sll_ifindex;
+    frame->pkttype = addrs_[i].sll_pkttype;
+  }
+
+  return num_msgs;
+}
+
+std::unique_ptr<BcmKnetRxSocket> BcmKnetRxSocket::CreateInstance(
+    int sock, size_t header_size, size_t max_payload_size,
+    int max_batch_size) {
+  return std::unique_ptr<BcmKnetRxSocket>(new BcmKnetRxSocket(
+      sock, header_size, max_payload_size, max_batch_size));
+}
+
+BcmKnetTxSocket::BcmKnetTxSocket(int sock, int netif_index,
+                                 int max_batch_size)
+    : sock_(sock),
+      netif_index_(netif_index),
+      max_batch_size_(std::max(max_batch_size, 1)) {}
+
+int BcmKnetTxSocket::SendBatch(const std::vector<BcmKnetTxFrame>& frames,
+                               std::vector<ssize_t>* results) const {
+  const size_t num_frames = frames.size();
+  results->assign(num_frames, 0);
+  if (num_frames == 0) return 0;
+
+  // Here sa.sll_addr is left zeroed out, matching what's in rcpu_hdr.
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family = AF_PACKET;
+  sa.sll_ifindex = netif_index_;
+  sa.sll_halen = ETH_ALEN;
+
+  // The sendmmsg() arguments point directly to the header and payload of the
+  // given frames. Only the descriptors are allocated here, once per batch.
+  const size_t batch_size =
+      std::min(num_frames, static_cast<size_t>(max_batch_size_));
+  std::vector<struct iovec> iovecs(2 * batch_size);
+  std::vector<struct mmsghdr> msgs(batch_size);
+  int num_sent = 0;
+  size_t idx = 0;  // index of the first frame not yet sent
+  while (idx < num_frames) {
+    const size_t n = std::min(num_frames - idx, batch_size);
+    for (size_t i = 0; i < n; ++i) {
+      const BcmKnetTxFrame& frame = frames[idx + i];
+      iovecs[2 * i].iov_base = const_cast<char*>(frame.header);
+      iovecs[2 * i].iov_len = frame.header_size;
+      iovecs[2 * i + 1].iov_base = const_cast<char*>(frame.payload);
+      iovecs[2 * i + 1].iov_len = frame.payload_size;
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_iov = &iovecs[2 * i];
+      msgs[i].msg_hdr.msg_iovlen = 2;
+      if (netif_index_ >= 0) {
+        msgs[i].msg_hdr.msg_name = &sa;
+        msgs[i].msg_hdr.msg_namelen = sizeof(sa);
+      }
+    }
+    int res = sendmmsg(sock_, msgs.data(), n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res < 0 && errno == EINTR) {
+      // Signal received before we could transmit anything. Need to retry.
+      continue;
+    }
+    if (res <= 0) {
+      // The first packet of the batch could not be sent. Record the error and
+      // move on to the rest of the packets.
+      (*results)[idx] = res < 0 ? -errno : -EAGAIN;
+      ++idx;
+      continue;
+    }
+    for (int i = 0; i < res; ++i) {
+      const BcmKnetTxFrame& frame = frames[idx + i];
+      (*results)[idx + i] = msgs[i].msg_len;
+      if (msgs[i].msg_len == frame.header_size + frame.payload_size) {
+        ++num_sent;
+      }
+    }
+    idx += res;
+  }
+
+  return num_sent;
+}
+
+std::unique_ptr<BcmKnetTxSocket> BcmKnetTxSocket::CreateInstance(
+    int sock, int netif_index, int max_batch_size) {
+  return std::unique_ptr<BcmKnetTxSocket>(
+      new BcmKnetTxSocket(sock, netif_index, max_batch_size));
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_KNET_SOCKET_H_
+#define STRATUM_HAL_LIB_BCM_BCM_KNET_SOCKET_H_
+
+#include <netpacket/packet.h>
+#include <sys/socket.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// A single packet received on a KNET interface socket. The header and payload
+// point to buffers owned by the BcmKnetRxSocket instance which received the
+// packet and are only valid till the next call to ReceiveBatch().
+struct BcmKnetRxFrame {
+  // Num of bytes received (KNET header + payload). Zero means the socket was
+  // shut down.
+  size_t length;
+  // The KNET header. Only valid if length >= header_size.
+  const char* header;
+  size_t header_size;
+  // The payload following the KNET header.
+  const char* payload;
+  size_t payload_size;
+  // True if the packet did not fit in the buffer and was truncated.
+  bool truncated;
+  // The netif index and packet type of the received packet, as reported by the
+  // kernel for AF_PACKET sockets. Zero for other socket types.
+  int ifindex;
+  int pkttype;
+  BcmKnetRxFrame()
+      : length(0),
+        header(nullptr),
+        header_size(0),
+        payload(nullptr),
+        payload_size(0),
+        truncated(false),
+        ifindex(0),
+        pkttype(0) {}
+};
+
+// The "BcmKnetRxSocket" class reads packets from a KNET interface RX socket in
+// batches. It owns a set of preallocated buffers, one for each packet in a
+// batch, and reads up to max_batch_size packets with a single recvmmsg()
+// call, splitting each packet into its KNET header and payload on the fly.
+// The class does not own the socket and can be used with any datagram socket
+// (e.g. a socketpair or a veth in tests).
+class BcmKnetRxSocket {
+ public:
+  virtual ~BcmKnetRxSocket() {}
+
+  // Reads up to max_batch_size packets from the socket without blocking.
+  // Returns the num of packets read, which may be zero if there was no packet
+  // available. Returns -1 with errno set on error (including EINTR).
+  int ReceiveBatch();
+
+  // Returns the i-th packet read by the last call to ReceiveBatch().
+  const BcmKnetRxFrame& frame(int i) const { return frames_[i]; }
+
+  int max_batch_size() const { return max_batch_size_; }
+
+  // Factory function for creating the instance of the class. 'sock' is the
+  // socket fd (not owned), 'header_size' is the size of the KNET header
+  // prepended to each packet and 'max_payload_size' is the max size of the
+  // payload that can be read without truncation.
+  static std::unique_ptr<BcmKnetRxSocket> CreateInstance(
+      int sock, size_t header_size, size_t max_payload_size,
+      int max_batch_size);
+
+  // BcmKnetRxSocket is neither copyable nor movable.
+  BcmKnetRxSocket(const BcmKnetRxSocket&) = delete;
+  BcmKnetRxSocket& operator=(const BcmKnetRxSocket&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  BcmKnetRxSocket(int sock, size_t header_size, size_t max_payload_size,
+                  int max_batch_size);
+
+  const int sock_;
+  const size_t header_size_;
+  const size_t max_payload_size_;
+  const int max_batch_size_;
+
+  // One header + payload buffer for each packet in a batch.
+  std::unique_ptr<char[]> buffers_;
+
+  // The recvmmsg() arguments, setup once in the constructor. Each message has
+  // two iovecs, one for the header and one for the payload.
+  std::vector<struct iovec> iovecs_;
+  std::vector<struct sockaddr_ll> addrs_;
+  std::vector<struct mmsghdr> msgs_;
+
+  // The packets read by the last call to ReceiveBatch().
+  std::vector<BcmKnetRxFrame> frames_;
+};
+
+// A single packet to be transmitted on a KNET interface socket. The header and
+// payload are not owned and must stay valid till SendBatch() returns. They are
+// sent as two separate iovecs, i.e. the payload is not copied.
+struct BcmKnetTxFrame {
+  // The KNET header.
+  const char* header;
+  size_t header_size;
+  // The payload following the KNET header.
+  const char* payload;
+  size_t payload_size;
+  BcmKnetTxFrame()
+      : header(nullptr), header_size(0), payload(nullptr), payload_size(0) {}
+  BcmKnetTxFrame(const std::string& _header, const std::string& _payload)
+      : header(_header.data()),
+        header_size(_header.size()),
+        payload(_payload.data()),
+        payload_size(_payload.size()) {}
+};
+
+// The "BcmKnetTxSocket" class writes packets to a KNET interface TX socket in
+// batches, using a single sendmmsg() call for up to max_batch_size packets.
+// The class does not own the socket. If netif_index is negative, the packets
+// are sent without a destination address, which is what a connected datagram
+// socket (e.g. a socketpair in tests) expects. Otherwise the packets are sent
+// to the AF_PACKET address of the given netif. Unlike BcmKnetRxSocket, the
+// class does not keep any state across calls and SendBatch() is thread-safe.
+class BcmKnetTxSocket {
+ public:
+  virtual ~BcmKnetTxSocket() {}
+
+  // Sends the given packets without blocking, in order. A packet which fails
+  // to be sent does not stop the packets after it. On return, results[i] is
+  // the num of bytes sent for the i-th packet or -errno if the packet could
+  // not be sent. Returns the num of packets sent completely.
+  int SendBatch(const std::vector<BcmKnetTxFrame>& frames,
+                std::vector<ssize_t>* results) const;
+
+  int max_batch_size() const { return max_batch_size_; }
+
+  // Factory function for creating the instance of the class. 'sock' is the
+  // socket fd (not owned) and 'netif_index' is the kernel index of the KNET
+  // netif (or -1 for connected sockets).
+  static std::unique_ptr<BcmKnetTxSocket> CreateInstance(int sock,
+                                                         int netif_index,
+                                                         int max_batch_size);
+
+  // BcmKnetTxSocket is neither copyable nor movable.
+  BcmKnetTxSocket(const BcmKnetTxSocket&) = delete;
+  BcmKnetTxSocket& operator=(const BcmKnetTxSocket&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  BcmKnetTxSocket(int sock, int netif_index, int max_batch_size);
+
+  const int sock_;
+  const int netif_index_;
+  const int max_batch_size_;
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_KNET_SOCKET_H_
@@ -0,0 +1,168 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_knet_socket.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// The tests use a socketpair as a stand-in for the KNET interface socket.
+class BcmKnetSocketTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kHeaderSize = 16;
+  static constexpr size_t kMaxPayloadSize = 64;
+  static constexpr int kMaxBatchSize = 4;
+
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, socks_));
+    rx_socket_ = BcmKnetRxSocket::CreateInstance(socks_[0], kHeaderSize,
+                                                 kMaxPayloadSize, kMaxBatchSize);
+  }
+
+  void TearDown() override {
+    close(socks_[0]);
+    close(socks_[1]);
+  }
+
+  void SendPacket(const std::string& header, const std::string& payload) {
+    std::string packet = header + payload;
+    ASSERT_EQ(static_cast<ssize_t>(packet.size()),
+              send(socks_[1], packet.data(), packet.size(), 0));
+  }
+
+  int socks_[2];
+  std::unique_ptr<BcmKnetRxSocket> rx_socket_;
+};
+
+constexpr size_t BcmKnetSocketTest::kHeaderSize;
+constexpr size_t BcmKnetSocketTest::kMaxPayloadSize;
+constexpr int BcmKnetSocketTest::kMaxBatchSize;
+
+TEST_F(BcmKnetSocketTest, ReceiveBatch) {
+  constexpr int kNumPackets = kMaxBatchSize + 1;
+  for (int i = 0; i < kNumPackets; ++i) {
+    SendPacket(std::string(kHeaderSize, 'a' + i), absl::StrCat("payload", i));
+  }
+
+  // The first batch is full and the rest of the packets are in the second one.
+  ASSERT_EQ(kMaxBatchSize, rx_socket_->ReceiveBatch());
+  for (int i = 0; i < kMaxBatchSize; ++i) {
+    const BcmKnetRxFrame& frame = rx_socket_->frame(i);
+    std::string payload = absl::StrCat("payload", i);
+    EXPECT_EQ(kHeaderSize + payload.size(), frame.length);
+    EXPECT_EQ(std::string(kHeaderSize, 'a' + i),
+              std::string(frame.header, frame.header_size));
+    EXPECT_EQ(payload, std::string(frame.payload, frame.payload_size));
+    EXPECT_FALSE(frame.truncated);
+  }
+  ASSERT_EQ(kNumPackets - kMaxBatchSize, rx_socket_->ReceiveBatch());
+  EXPECT_EQ(absl::StrCat("payload", kMaxBatchSize),
+            std::string(rx_socket_->frame(0).payload,
+                        rx_socket_->frame(0).payload_size));
+
+  // No more packets.
+  EXPECT_EQ(0, rx_socket_->ReceiveBatch());
+}
+
+TEST_F(BcmKnetSocketTest, ReceiveIncompleteAndTruncatedPackets) {
+  SendPacket(std::string(kHeaderSize - 1, 'h'), "");
+  SendPacket(std::string(kHeaderSize, 'h'), std::string(kMaxPayloadSize, 'p'));
+  SendPacket(std::string(kHeaderSize, 'h'),
+             std::string(kMaxPayloadSize + 1, 'p'));
+
+  ASSERT_EQ(3, rx_socket_->ReceiveBatch());
+  EXPECT_EQ(kHeaderSize - 1, rx_socket_->frame(0).length);
+  EXPECT_EQ(0, rx_socket_->frame(0).payload_size);
+  EXPECT_FALSE(rx_socket_->frame(0).truncated);
+  EXPECT_EQ(kMaxPayloadSize, rx_socket_->frame(1).payload_size);
+  EXPECT_FALSE(rx_socket_->frame(1).truncated);
+  EXPECT_EQ(kMaxPayloadSize, rx_socket_->frame(2).payload_size);
+  EXPECT_TRUE(rx_socket_->frame(2).truncated);
+}
+
+TEST_F(BcmKnetSocketTest, ReceiveEmptyPacket) {
+  // Zero length reads are reported as is, the caller treats them as a socket
+  // shutdown.
+  SendPacket("", "");
+  ASSERT_EQ(1, rx_socket_->ReceiveBatch());
+  EXPECT_EQ(0, rx_socket_->frame(0).length);
+  EXPECT_EQ(0, rx_socket_->frame(0).payload_size);
+}
+
+TEST_F(BcmKnetSocketTest, ReceiveError) {
+  auto rx_socket =
+      BcmKnetRxSocket::CreateInstance(-1, kHeaderSize, kMaxPayloadSize, 1);
+  EXPECT_EQ(-1, rx_socket->ReceiveBatch());
+  EXPECT_EQ(EBADF, errno);
+}
+
+TEST_F(BcmKnetSocketTest, SendBatch) {
+  // Send more packets than the TX batch size, so that more than one sendmmsg()
+  // call is needed.
+  constexpr int kNumPackets = kMaxBatchSize - 1;
+  auto tx_socket = BcmKnetTxSocket::CreateInstance(socks_[1], -1, 2);
+  std::vector<std::string> headers, payloads;
+  for (int i = 0; i < kNumPackets; ++i) {
+    headers.push_back(std::string(kHeaderSize, 'a' + i));
+    payloads.push_back(absl::StrCat("payload", i));
+  }
+  std::vector<BcmKnetTxFrame> frames;
+  for (int i = 0; i < kNumPackets; ++i) {
+    frames.emplace_back(headers[i], payloads[i]);
+  }
+  std::vector<ssize_t> results;
+  ASSERT_EQ(kNumPackets, tx_socket->SendBatch(frames, &results));
+  ASSERT_EQ(kNumPackets, results.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(kHeaderSize + payloads[i].size(), results[i]);
+  }
+
+  // The packets are received in order, with the header and payload intact.
+  ASSERT_EQ(kNumPackets, rx_socket_->ReceiveBatch());
+  for (int i = 0; i < kNumPackets; ++i) {
+    const BcmKnetRxFrame& frame = rx_socket_->frame(i);
+    EXPECT_EQ(headers[i], std::string(frame.header, frame.header_size));
+    EXPECT_EQ(payloads[i], std::string(frame.payload, frame.payload_size));
+  }
+}
+
+TEST_F(BcmKnetSocketTest, SendError) {
+  auto tx_socket = BcmKnetTxSocket::CreateInstance(-1, -1, kMaxBatchSize);
+  std::string header(kHeaderSize, 'h'), payload("payload");
+  std::vector<BcmKnetTxFrame> frames(2, BcmKnetTxFrame(header, payload));
+  std::vector<ssize_t> results;
+  EXPECT_EQ(0, tx_socket->SendBatch(frames, &results));
+  ASSERT_EQ(2, results.size());
+  EXPECT_EQ(-EBADF, results[0]);
+  EXPECT_EQ(-EBADF, results[1]);
+  EXPECT_EQ(0, tx_socket->SendBatch({}, &results));
+  EXPECT_TRUE(results.empty());
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
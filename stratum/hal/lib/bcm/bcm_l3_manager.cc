@@ -14,6 +14,8 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <set>
+#include <tuple>
 #include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
@@ -28,6 +30,45 @@ namespace stratum {
 namespace hal {
 namespace bcm {
 
+namespace {
+
+// Converts the IPv6 address/mask bytes given in a BcmFlowEntry field to the
+// fixed-size form used in LpmOrHostKey. Values of IPV6_DST_UPPER_64 fields
+// hold the upper 64 bits of the address, so shorter values are left-aligned.
+// Values of full-width IPV6_DST fields are P4Runtime bytestrings whose leading
+// zeros may be stripped, so shorter values are right-aligned. Both are padded
+// with zeros.
+::util::Status ParseIpv6Address(const std::string& bytes,
+                                BcmField::Type field_type,
+                                BcmSdkInterface::Ipv6Address* addr) {
+  if (bytes.size() > addr->size()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "IPv6 address or mask has " << bytes.size() << " bytes, "
+           << "expected at most " << addr->size() << ".";
+  }
+  addr->fill(0);
+  if (field_type == BcmField::IPV6_DST_UPPER_64) {
+    std::copy(bytes.begin(), bytes.end(), addr->begin());
+  } else {
+    std::copy(bytes.begin(), bytes.end(),
+              addr->begin() + (addr->size() - bytes.size()));
+  }
+  return ::util::OkStatus();
+}
+
+// Returns the IPv6 address/mask as the 16-byte string expected by the
+// per-route IPv6 SDK calls.
+std::string Ipv6ToString(const BcmSdkInterface::Ipv6Address& addr) {
+  return std::string(addr.begin(), addr.end());
+}
+
+bool IsZero(const BcmSdkInterface::Ipv6Address& addr) {
+  return std::all_of(addr.begin(), addr.end(),
+                     [](uint8 byte) { return byte == 0; });
+}
+
+}  // namespace
+
 BcmL3Manager::BcmL3Manager(BcmSdkInterface* bcm_sdk_interface,
                            BcmTableManager* bcm_table_manager, int unit)
     : router_intf_ref_count_(),
@@ -365,13 +406,13 @@ BcmL3Manager::~BcmL3Manager() {}
                                                action_params.egress_intf_id);
     case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
       return bcm_sdk_interface_->AddL3RouteIpv6(
-          unit_, key.vrf, key.subnet_ipv6, key.mask_ipv6,
-          action_params.class_id, action_params.egress_intf_id,
-          action_params.is_intf_multipath);
+          unit_, key.vrf, Ipv6ToString(key.subnet_ipv6),
+          Ipv6ToString(key.mask_ipv6), action_params.class_id,
+          action_params.egress_intf_id, action_params.is_intf_multipath);
     case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
-      return bcm_sdk_interface_->AddL3HostIpv6(unit_, key.vrf, key.subnet_ipv6,
-                                               action_params.class_id,
-                                               action_params.egress_intf_id);
+      return bcm_sdk_interface_->AddL3HostIpv6(
+          unit_, key.vrf, Ipv6ToString(key.subnet_ipv6), action_params.class_id,
+          action_params.egress_intf_id);
     default:
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "Invalid table_id: "
@@ -410,11 +451,12 @@ BcmL3Manager::~BcmL3Manager() {}
           action_params.egress_intf_id);
     case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
       return bcm_sdk_interface_->ModifyL3RouteIpv6(
-          unit, key.vrf, key.subnet_ipv6, key.mask_ipv6, action_params.class_id,
+          unit, key.vrf, Ipv6ToString(key.subnet_ipv6),
+          Ipv6ToString(key.mask_ipv6), action_params.class_id,
           action_params.egress_intf_id, action_params.is_intf_multipath);
     case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
       return bcm_sdk_interface_->ModifyL3HostIpv6(
-          unit, key.vrf, key.subnet_ipv6, action_params.class_id,
+          unit, key.vrf, Ipv6ToString(key.subnet_ipv6), action_params.class_id,
           action_params.egress_intf_id);
     default:
       return MAKE_ERROR(ERR_INVALID_PARAM)
@@ -435,6 +477,131 @@ BcmL3Manager::~BcmL3Manager() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmL3Manager::WriteTableEntries(
+    const std::vector<L3TableEntryWrite>& writes,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  results->assign(writes.size(), ::util::OkStatus());
+
+  // The routes are programmed in batches. A batch never holds two updates for
+  // the same route key, as the SDK would otherwise see them in a different
+  // order. Such an update flushes the pending batch first.
+  typedef std::tuple<int, int, uint32, uint32, BcmSdkInterface::Ipv6Address,
+                     BcmSdkInterface::Ipv6Address>
+      RouteKey;
+  std::set<RouteKey> batch_keys;
+  std::vector<BcmSdkInterface::L3RouteUpdate> batch;
+  std::vector<size_t> batch_indices;
+  auto flush = [&]() {
+    if (batch.empty()) return;
+    std::vector<::util::Status> sdk_results;
+    ::util::Status status =
+        bcm_sdk_interface_->ProgramL3Routes(unit_, batch, &sdk_results);
+    if (sdk_results.size() != batch.size()) {
+      // The batch was not programmed at all.
+      if (status.ok()) {
+        status = MAKE_ERROR(ERR_INTERNAL)
+                 << "Got " << sdk_results.size() << " results for "
+                 << batch.size() << " L3 route updates.";
+      }
+      sdk_results.assign(batch.size(), status);
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const size_t index = batch_indices[i];
+      if (!sdk_results[i].ok()) {
+        (*results)[index] = sdk_results[i];
+        continue;
+      }
+      // Update the internal records in BcmTableManager.
+      const ::p4::v1::TableEntry& entry = *writes[index].entry;
+      switch (writes[index].type) {
+        case ::p4::v1::Update::INSERT:
+          (*results)[index] = bcm_table_manager_->AddTableEntry(entry);
+          break;
+        case ::p4::v1::Update::MODIFY:
+          (*results)[index] = bcm_table_manager_->UpdateTableEntry(entry);
+          break;
+        default:
+          (*results)[index] = bcm_table_manager_->DeleteTableEntry(entry);
+          break;
+      }
+    }
+    batch_keys.clear();
+    batch.clear();
+    batch_indices.clear();
+  };
+
+  for (size_t i = 0; i < writes.size(); ++i) {
+    BcmSdkInterface::L3RouteUpdate route_update;
+    ::util::Status status = BuildL3RouteUpdate(writes[i], &route_update);
+    if (!status.ok()) {
+      (*results)[i] = status;
+      continue;
+    }
+    RouteKey key(route_update.table_type, route_update.vrf,
+                 route_update.subnet_ipv4, route_update.mask_ipv4,
+                 route_update.subnet_ipv6, route_update.mask_ipv6);
+    if (batch_keys.count(key)) flush();
+    batch_keys.insert(key);
+    batch.push_back(route_update);
+    batch_indices.push_back(i);
+  }
+  flush();
+
+  for (const auto& result : *results) {
+    if (!result.ok()) {
+      return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+             << "One or more L3 flow writes failed.";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmL3Manager::BuildL3RouteUpdate(
+    const L3TableEntryWrite& write,
+    BcmSdkInterface::L3RouteUpdate* route_update) {
+  const BcmFlowEntry& bcm_flow_entry = write.bcm_flow_entry;
+  CHECK_RETURN_IF_FALSE(write.entry != nullptr) << "Null entry!";
+  CHECK_RETURN_IF_FALSE(bcm_flow_entry.unit() == unit_)
+      << "Received L3 flow for unit " << bcm_flow_entry.unit() << " on unit "
+      << unit_ << ".";
+  switch (write.type) {
+    case ::p4::v1::Update::INSERT:
+      route_update->type = BcmSdkInterface::L3RouteUpdate::Type::ADD;
+      break;
+    case ::p4::v1::Update::MODIFY:
+      route_update->type = BcmSdkInterface::L3RouteUpdate::Type::MODIFY;
+      break;
+    case ::p4::v1::Update::DELETE:
+      route_update->type = BcmSdkInterface::L3RouteUpdate::Type::DELETE;
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Invalid update type "
+             << ::p4::v1::Update::Type_Name(write.type) << " for "
+             << write.entry->ShortDebugString() << ".";
+  }
+  route_update->table_type = bcm_flow_entry.bcm_table_type();
+  LpmOrHostKey key;
+  RETURN_IF_ERROR(ExtractLpmOrHostKey(bcm_flow_entry, &key));
+  route_update->vrf = key.vrf;
+  route_update->subnet_ipv4 = key.subnet_ipv4;
+  route_update->mask_ipv4 = key.mask_ipv4;
+  route_update->subnet_ipv6 = key.subnet_ipv6;
+  route_update->mask_ipv6 = key.mask_ipv6;
+  if (write.type != ::p4::v1::Update::DELETE) {
+    LpmOrHostActionParams action_params;
+    RETURN_IF_ERROR(
+        ExtractLpmOrHostActionParams(bcm_flow_entry, &action_params));
+    route_update->class_id = action_params.class_id;
+    route_update->egress_intf_id = action_params.egress_intf_id;
+    route_update->is_intf_multipath = action_params.is_intf_multipath;
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmL3Manager::UpdateMultipathGroupsForPort(uint32 port_id) {
   // Generate map from BCM multipath group id to data for all groups which
   // reference the given port.
@@ -464,10 +631,11 @@ BcmL3Manager::~BcmL3Manager() {}
                                                   key.subnet_ipv4);
     case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
       return bcm_sdk_interface_->DeleteL3RouteIpv6(
-          unit_, key.vrf, key.subnet_ipv6, key.mask_ipv6);
+          unit_, key.vrf, Ipv6ToString(key.subnet_ipv6),
+          Ipv6ToString(key.mask_ipv6));
     case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
-      return bcm_sdk_interface_->DeleteL3HostIpv6(unit_, key.vrf,
-                                                  key.subnet_ipv6);
+      return bcm_sdk_interface_->DeleteL3HostIpv6(
+          unit_, key.vrf, Ipv6ToString(key.subnet_ipv6));
     default:
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "Invalid bcm_table_type: "
@@ -525,8 +693,10 @@ std::unique_ptr<BcmL3Manager> BcmL3Manager::CreateInstance(
       for (const auto& field : bcm_flow_entry.fields()) {
         if (field.type() == BcmField::IPV6_DST ||
             field.type() == BcmField::IPV6_DST_UPPER_64) {
-          key->subnet_ipv6 = field.value().b();
-          key->mask_ipv6 = field.mask().b();
+          RETURN_IF_ERROR(ParseIpv6Address(field.value().b(), field.type(),
+                                           &key->subnet_ipv6));
+          RETURN_IF_ERROR(ParseIpv6Address(field.mask().b(), field.type(),
+                                           &key->mask_ipv6));
         } else if (field.type() == BcmField::VRF) {
           key->vrf = static_cast<int>(field.value().u32());
         } else {
@@ -535,9 +705,9 @@ std::unique_ptr<BcmL3Manager> BcmL3Manager::CreateInstance(
                  << bcm_flow_entry.ShortDebugString();
         }
         // Validations.
-        if (key->subnet_ipv6.empty() ||
+        if (IsZero(key->subnet_ipv6) ||
             bcm_table_type == BcmFlowEntry::BCM_TABLE_IPV6_HOST) {
-          if (!key->mask_ipv6.empty()) {
+          if (!IsZero(key->mask_ipv6)) {
             return MAKE_ERROR(ERR_INVALID_PARAM)
                    << "Must not specify mask when subnet is 0 or a host dst "
                    << "IP: " << bcm_flow_entry.ShortDebugString() << ".";
@@ -46,15 +46,16 @@ struct LpmOrHostKey {
   // IPv4 subnet/mask.
   uint32 subnet_ipv4;
   uint32 mask_ipv4;
-  // IPv6 subnet/mask.
-  std::string subnet_ipv6;
-  std::string mask_ipv6;
+  // IPv6 subnet/mask. Shorter values given in the flow (e.g. the upper 64
+  // bits of the address) are left-aligned and zero-padded.
+  BcmSdkInterface::Ipv6Address subnet_ipv6;
+  BcmSdkInterface::Ipv6Address mask_ipv6;
   LpmOrHostKey()
       : vrf(kVrfDefault),
         subnet_ipv4(0),
         mask_ipv4(0),
-        subnet_ipv6(""),
-        mask_ipv6("") {}
+        subnet_ipv6(),
+        mask_ipv6() {}
 };
 
 // This struct encapsulates the action params for an LPM/host flow.
@@ -70,6 +71,15 @@ struct LpmOrHostActionParams {
       : class_id(-1), egress_intf_id(-1), is_intf_multipath(false) {}
 };
 
+// This struct encapsulates one IPv4/IPv6 LPM/host flow update given to
+// BcmL3Manager::WriteTableEntries(), together with the BcmFlowEntry already
+// filled for it by BcmTableManager.
+struct L3TableEntryWrite {
+  ::p4::v1::Update::Type type;
+  const ::p4::v1::TableEntry* entry;  // not owned by this struct.
+  BcmFlowEntry bcm_flow_entry;
+};
+
 // The "BcmL3Manager" class implements the L3 routing functionality.
 class BcmL3Manager {
  public:
@@ -139,6 +149,15 @@ class BcmL3Manager {
   // not needed).
   virtual ::util::Status DeleteTableEntry(const ::p4::v1::TableEntry& entry);
 
+  // Inserts, modifies or deletes a batch of IPv4/IPv6 L3 LPM/Host flows. The
+  // low level routes are programmed with as few SDK calls as possible, with
+  // the same result as writing the flows one by one in the given order.
+  // 'results' is filled with one status per write. Returns
+  // ERR_AT_LEAST_ONE_OPER_FAILED if any of the writes failed.
+  virtual ::util::Status WriteTableEntries(
+      const std::vector<L3TableEntryWrite>& writes,
+      std::vector<::util::Status>* results);
+
   // Updates any ECMP/WCMP groups which include a member pointing to the given
   // singleton port. Adds or removes the port to or from all groups referencing
   // it based on whether the port is UP or not, respectively. In the case that
@@ -183,6 +202,12 @@ class BcmL3Manager {
   ::util::Status ExtractLpmOrHostKey(const BcmFlowEntry& bcm_flow_entry,
                                      LpmOrHostKey* key);
 
+  // Helper to build the SDK route update for an IPv4/IPv6 L3 LPM/Host flow
+  // write given to WriteTableEntries().
+  ::util::Status BuildL3RouteUpdate(
+      const L3TableEntryWrite& write,
+      BcmSdkInterface::L3RouteUpdate* route_update);
+
   // Helper to extract IPv4/IPv6 L3 LPM/Host flow actions given BcmFlowEntry.
   ::util::Status ExtractLpmOrHostActionParams(
       const BcmFlowEntry& bcm_flow_entry, LpmOrHostActionParams* action_params);
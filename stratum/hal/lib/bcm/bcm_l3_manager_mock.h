@@ -51,6 +51,9 @@ class BcmL3ManagerMock : public BcmL3Manager {
                ::util::Status(const ::p4::v1::TableEntry& entry));
   MOCK_METHOD1(DeleteTableEntry,
                ::util::Status(const ::p4::v1::TableEntry& entry));
+  MOCK_METHOD2(WriteTableEntries,
+               ::util::Status(const std::vector<L3TableEntryWrite>& writes,
+                              std::vector<::util::Status>* results));
   MOCK_METHOD1(UpdateMultipathGroupsForPort, ::util::Status(uint32 port_id));
 };
 
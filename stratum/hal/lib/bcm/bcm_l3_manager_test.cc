@@ -37,9 +37,28 @@ using ::testing::_;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SetArgPointee;
+using ::testing::SizeIs;
 using ::testing::StrictMock;
 
+namespace {
+
+// The IPv6 subnet and mask given to the SDK for the test flows, which only set
+// the upper 64 bits with IPV6_DST_UPPER_64. The SDK is always given 16-byte
+// values.
+std::string Ipv6Subnet() {
+  return std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8) +
+         std::string(8, '\0');
+}
+
+std::string Ipv6Mask() {
+  return std::string("\xff\xff\xff\xff\xff\xff\xff\x00", 8) +
+         std::string(8, '\0');
+}
+
+}  // namespace
+
 class BcmL3ManagerTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -1251,7 +1270,7 @@ TEST_F(BcmL3ManagerTest,
       unit: 3
       bcm_table_type: BCM_TABLE_IPV6_LPM
       fields: {
-        type: IPV6_DST
+        type: IPV6_DST_UPPER_64
         value {
           b: "\x01\x02\x03\x04\x05\x06\x07\x08"
         }
@@ -1278,10 +1297,8 @@ TEST_F(BcmL3ManagerTest,
 
   // Expectations for the mock objects.
   EXPECT_CALL(*bcm_sdk_mock_,
-              AddL3RouteIpv6(kUnit, 0,
-                             std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8),
-                             std::string("\xff\xff\xff\xff\xff\xff\xff\x00", 8),
-                             -1, 200256, true))
+              AddL3RouteIpv6(kUnit, 0, Ipv6Subnet(), Ipv6Mask(), -1, 200256,
+                             true))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               AddTableEntry(EqualsProto(p4_table_entry)))
@@ -1295,7 +1312,7 @@ TEST_F(BcmL3ManagerTest, InsertLpmOrHostFlowSuccessForIpv6HostFlow) {
       unit: 3
       bcm_table_type: BCM_TABLE_IPV6_HOST
       fields: {
-        type: IPV6_DST
+        type: IPV6_DST_UPPER_64
         value {
           b: "\x01\x02\x03\x04\x05\x06\x07\x08"
         }
@@ -1319,9 +1336,7 @@ TEST_F(BcmL3ManagerTest, InsertLpmOrHostFlowSuccessForIpv6HostFlow) {
 
   // Expectations for the mock objects.
   EXPECT_CALL(*bcm_sdk_mock_,
-              AddL3HostIpv6(kUnit, 0,
-                            std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8),
-                            -1, 100003))
+              AddL3HostIpv6(kUnit, 0, Ipv6Subnet(), -1, 100003))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               AddTableEntry(EqualsProto(p4_table_entry)))
@@ -1671,7 +1686,7 @@ TEST_F(BcmL3ManagerTest,
       unit: 3
       bcm_table_type: BCM_TABLE_IPV6_LPM
       fields: {
-        type: IPV6_DST
+        type: IPV6_DST_UPPER_64
         value {
           b: "\x01\x02\x03\x04\x05\x06\x07\x08"
         }
@@ -1699,9 +1714,7 @@ TEST_F(BcmL3ManagerTest,
   // Expectations for the mock objects.
   EXPECT_CALL(
       *bcm_sdk_mock_,
-      ModifyL3RouteIpv6(
-          kUnit, 0, std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8),
-          std::string("\xff\xff\xff\xff\xff\xff\xff\x00", 8), -1, 200256, true))
+      ModifyL3RouteIpv6(kUnit, 0, Ipv6Subnet(), Ipv6Mask(), -1, 200256, true))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               UpdateTableEntry(EqualsProto(p4_table_entry)))
@@ -1715,7 +1728,7 @@ TEST_F(BcmL3ManagerTest, ModifyLpmOrHostFlowSuccessForIpv6HostFlow) {
       unit: 3
       bcm_table_type: BCM_TABLE_IPV6_HOST
       fields: {
-        type: IPV6_DST
+        type: IPV6_DST_UPPER_64
         value {
           b: "\x01\x02\x03\x04\x05\x06\x07\x08"
         }
@@ -1739,9 +1752,7 @@ TEST_F(BcmL3ManagerTest, ModifyLpmOrHostFlowSuccessForIpv6HostFlow) {
 
   // Expectations for the mock objects.
   EXPECT_CALL(*bcm_sdk_mock_,
-              ModifyL3HostIpv6(
-                  kUnit, 0, std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8),
-                  -1, 100003))
+              ModifyL3HostIpv6(kUnit, 0, Ipv6Subnet(), -1, 100003))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               UpdateTableEntry(EqualsProto(p4_table_entry)))
@@ -1829,7 +1840,7 @@ TEST_F(BcmL3ManagerTest, DeleteLpmOrHostFlowSuccessForIpv6LpmFlow) {
       unit: 3
       bcm_table_type: BCM_TABLE_IPV6_LPM
       fields: {
-        type: IPV6_DST
+        type: IPV6_DST_UPPER_64
         value {
           b: "\x01\x02\x03\x04\x05\x06\x07\x08"
         }
@@ -1847,9 +1858,7 @@ TEST_F(BcmL3ManagerTest, DeleteLpmOrHostFlowSuccessForIpv6LpmFlow) {
 
   // Expectations for the mock objects.
   EXPECT_CALL(*bcm_sdk_mock_,
-              DeleteL3RouteIpv6(
-                  kUnit, 0, std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8),
-                  std::string("\xff\xff\xff\xff\xff\xff\xff\x00", 8)))
+              DeleteL3RouteIpv6(kUnit, 0, Ipv6Subnet(), Ipv6Mask()))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               DeleteTableEntry(EqualsProto(p4_table_entry)))
@@ -1888,8 +1897,7 @@ TEST_F(BcmL3ManagerTest, DeleteLpmOrHostFlowSuccessForIpv6HostFlow) {
 
   // Expectations for the mock objects.
   EXPECT_CALL(*bcm_sdk_mock_,
-              DeleteL3HostIpv6(
-                  kUnit, 0, std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8)))
+              DeleteL3HostIpv6(kUnit, 0, Ipv6Subnet()))
       .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_table_manager_mock_,
               DeleteTableEntry(EqualsProto(p4_table_entry)))
@@ -1906,6 +1914,264 @@ TEST_F(BcmL3ManagerTest, DeleteLpmOrHostFlowP4ConversionFailure) {
   ASSERT_FALSE(bcm_l3_manager_->DeleteTableEntry(p4_table_entry).ok());
 }
 
+TEST_F(BcmL3ManagerTest, InsertLpmOrHostFlowRightAlignsShortIpv6Dst) {
+  // A full-width IPV6_DST value with its leading zeros stripped, i.e.
+  // ::ffff:10.0.0.1, and a /120 mask.
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV6_LPM
+      fields: {
+        type: IPV6_DST
+        value {
+          b: "\xff\xff\x0a\x00\x00\x01"
+        }
+        mask {
+          b: "\xff\xff\xff\xff\xff\xff\xff\xff"
+             "\xff\xff\xff\xff\xff\xff\xff\x00"
+        }
+      }
+      actions: {
+        type: OUTPUT_L3
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 200256
+          }
+        }
+      }
+  )";
+
+  // Test BcmFlowEntry.
+  BcmFlowEntry bcm_flow_entry;
+  ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &bcm_flow_entry));
+  ::p4::v1::TableEntry p4_table_entry =
+      ExpectFlowConversion(::p4::v1::Update::INSERT, bcm_flow_entry);
+
+  // Expectations for the mock objects.
+  const std::string kSubnet =
+      std::string(10, '\0') + std::string("\xff\xff\x0a\x00\x00\x01", 6);
+  const std::string kMask = std::string(15, '\xff') + std::string(1, '\0');
+  EXPECT_CALL(*bcm_sdk_mock_,
+              AddL3RouteIpv6(kUnit, 0, kSubnet, kMask, -1, 200256, true))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ASSERT_OK(bcm_l3_manager_->InsertTableEntry(p4_table_entry));
+}
+
+TEST_F(BcmL3ManagerTest, InsertLpmOrHostFlowFailureForTooLongIpv6Subnet) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV6_HOST
+      fields: {
+        type: IPV6_DST
+        value {
+          b: "\x01\x02\x03\x04\x05\x06\x07\x08"
+             "\x01\x02\x03\x04\x05\x06\x07\x08\x09"
+        }
+      }
+      actions: {
+        type: OUTPUT_PORT
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 100003
+          }
+        }
+      }
+  )";
+
+  // Test BcmFlowEntry.
+  BcmFlowEntry bcm_flow_entry;
+  ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &bcm_flow_entry));
+  ::p4::v1::TableEntry p4_table_entry =
+      ExpectFlowConversion(::p4::v1::Update::INSERT, bcm_flow_entry);
+
+  ::util::Status status = bcm_l3_manager_->InsertTableEntry(p4_table_entry);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("17 bytes"));
+}
+
+TEST_F(BcmL3ManagerTest, WriteTableEntriesSuccess) {
+  const std::string kBcmFlowEntryText1 = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_LPM
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00100
+        }
+        mask {
+          u32: 0xffffff00
+        }
+      }
+      actions: {
+        type: OUTPUT_L3
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 200256
+          }
+        }
+      }
+  )";
+  const std::string kBcmFlowEntryText2 = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV6_HOST
+      fields: {
+        type: IPV6_DST_UPPER_64
+        value {
+          b: "\x01\x02\x03\x04\x05\x06\x07\x08"
+        }
+      }
+  )";
+
+  ::p4::v1::TableEntry p4_table_entry1, p4_table_entry2;
+  p4_table_entry1.set_table_id(1);
+  p4_table_entry2.set_table_id(2);
+  std::vector<L3TableEntryWrite> writes(2);
+  writes[0].type = ::p4::v1::Update::INSERT;
+  writes[0].entry = &p4_table_entry1;
+  ASSERT_OK(
+      ParseProtoFromString(kBcmFlowEntryText1, &writes[0].bcm_flow_entry));
+  writes[1].type = ::p4::v1::Update::DELETE;
+  writes[1].entry = &p4_table_entry2;
+  ASSERT_OK(
+      ParseProtoFromString(kBcmFlowEntryText2, &writes[1].bcm_flow_entry));
+
+  // Both routes are programmed with a single SDK call.
+  std::vector<BcmSdkInterface::L3RouteUpdate> updates;
+  EXPECT_CALL(*bcm_sdk_mock_, ProgramL3Routes(kUnit, SizeIs(2), _))
+      .WillOnce(DoAll(SaveArg<1>(&updates),
+                      SetArgPointee<2>(std::vector<::util::Status>(
+                          2, ::util::OkStatus())),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entry1)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              DeleteTableEntry(EqualsProto(p4_table_entry2)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_l3_manager_->WriteTableEntries(writes, &results));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_OK(results[1]);
+  ASSERT_EQ(2U, updates.size());
+  EXPECT_EQ(BcmSdkInterface::L3RouteUpdate::Type::ADD, updates[0].type);
+  EXPECT_EQ(BcmFlowEntry::BCM_TABLE_IPV4_LPM, updates[0].table_type);
+  EXPECT_EQ(0xc0a00100, updates[0].subnet_ipv4);
+  EXPECT_EQ(0xffffff00, updates[0].mask_ipv4);
+  EXPECT_EQ(200256, updates[0].egress_intf_id);
+  EXPECT_TRUE(updates[0].is_intf_multipath);
+  EXPECT_EQ(BcmSdkInterface::L3RouteUpdate::Type::DELETE, updates[1].type);
+  EXPECT_EQ(BcmFlowEntry::BCM_TABLE_IPV6_HOST, updates[1].table_type);
+  EXPECT_EQ(Ipv6Subnet(), std::string(updates[1].subnet_ipv6.begin(),
+                                      updates[1].subnet_ipv6.end()));
+}
+
+TEST_F(BcmL3ManagerTest, WriteTableEntriesSplitsBatchOnRepeatedRoute) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_HOST
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00101
+        }
+      }
+      actions: {
+        type: OUTPUT_PORT
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 100003
+          }
+        }
+      }
+  )";
+
+  // Inserting and then deleting the same route needs two SDK calls.
+  ::p4::v1::TableEntry p4_table_entry;
+  p4_table_entry.set_table_id(1);
+  std::vector<L3TableEntryWrite> writes(2);
+  writes[0].type = ::p4::v1::Update::INSERT;
+  writes[1].type = ::p4::v1::Update::DELETE;
+  for (auto& write : writes) {
+    write.entry = &p4_table_entry;
+    ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &write.bcm_flow_entry));
+  }
+
+  EXPECT_CALL(*bcm_sdk_mock_, ProgramL3Routes(kUnit, SizeIs(1), _))
+      .Times(2)
+      .WillRepeatedly(DoAll(SetArgPointee<2>(std::vector<::util::Status>(
+                                1, ::util::OkStatus())),
+                            Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              DeleteTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_l3_manager_->WriteTableEntries(writes, &results));
+  EXPECT_EQ(2U, results.size());
+}
+
+TEST_F(BcmL3ManagerTest, WriteTableEntriesReportsPerEntryFailures) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_HOST
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00101
+        }
+      }
+  )";
+
+  ::p4::v1::TableEntry p4_table_entry1, p4_table_entry2, p4_table_entry3;
+  p4_table_entry1.set_table_id(1);
+  p4_table_entry2.set_table_id(2);
+  p4_table_entry3.set_table_id(3);
+  std::vector<L3TableEntryWrite> writes(3);
+  writes[0].entry = &p4_table_entry1;
+  writes[1].entry = &p4_table_entry2;
+  writes[2].entry = &p4_table_entry3;
+  for (auto& write : writes) {
+    write.type = ::p4::v1::Update::DELETE;
+    ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &write.bcm_flow_entry));
+  }
+  writes[1].bcm_flow_entry.mutable_fields(0)->mutable_value()->set_u32(
+      0xc0a00102);
+  // A flow for another unit is rejected before reaching the SDK.
+  writes[2].bcm_flow_entry.set_unit(kUnit + 1);
+
+  std::vector<::util::Status> sdk_results = {
+      ::util::OkStatus(),
+      ::util::Status(StratumErrorSpace(), ERR_ENTRY_NOT_FOUND, "Blah")};
+  EXPECT_CALL(*bcm_sdk_mock_, ProgramL3Routes(kUnit, SizeIs(2), _))
+      .WillOnce(DoAll(SetArgPointee<2>(sdk_results),
+                      Return(::util::Status(StratumErrorSpace(),
+                                            ERR_AT_LEAST_ONE_OPER_FAILED,
+                                            "Blah"))));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              DeleteTableEntry(EqualsProto(p4_table_entry1)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results;
+  ::util::Status status = bcm_l3_manager_->WriteTableEntries(writes, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(3U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, results[1].error_code());
+  EXPECT_FALSE(results[2].ok());
+}
+
 // TODO(unknown): Add more coverage for the failure case.
 
 }  // namespace bcm
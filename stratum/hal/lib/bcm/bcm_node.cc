@@ -13,10 +13,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <utility>
 #include <set>
 
 #include "gflags/gflags.h"
+#include "stratum/glue/gtl/cleanup.h"
 #include "stratum/lib/macros.h"
 #include "stratum/hal/lib/bcm/bcm_node.h"
 #include "absl/memory/memory.h"
@@ -27,6 +29,12 @@
 DEFINE_bool(enable_static_table_writes, true,
             "Enables writes of static table "
             "entries from the P4 pipeline config to the hardware tables");
+DEFINE_int32(max_num_table_entries_per_read_response, 1000,
+             "Max number of table entries sent in a single ReadResponse. "
+             "Reads of larger tables are streamed in several responses.");
+DEFINE_int32(max_read_response_size_bytes, 1024 * 1024,
+             "Approximate max size of a single ReadResponse carrying table "
+             "entries. A response is sent as soon as it reaches this size.");
 
 namespace stratum {
 namespace hal {
@@ -115,6 +123,9 @@ BcmNode::~BcmNode() {}
 ::util::Status BcmNode::PushForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::WriterMutexLock l(&lock_);
+  // Publish the changes made by the static entries, even on error.
+  auto publisher =
+      gtl::MakeCleanup([this]() { bcm_table_manager_->PublishReadSnapshot(); });
   P4PipelineConfig p4_pipeline_config;
   CHECK_RETURN_IF_FALSE(
       p4_pipeline_config.ParseFromString(config.p4_device_config()))
@@ -152,6 +163,7 @@ BcmNode::~BcmNode() {}
   APPEND_STATUS_IF_ERROR(status, bcm_l3_manager_->Shutdown());
   APPEND_STATUS_IF_ERROR(status, bcm_l2_manager_->Shutdown());
   APPEND_STATUS_IF_ERROR(status, bcm_table_manager_->Shutdown());
+  bcm_table_manager_->PublishReadSnapshot();
   APPEND_STATUS_IF_ERROR(status, p4_table_mapper_->Shutdown());
   initialized_ = false;  // Set to false even if there is an error
 
@@ -178,7 +190,12 @@ BcmNode::~BcmNode() {}
   if (!initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  return DoWriteForwardingEntries(req, results);
+  ::util::Status status = DoWriteForwardingEntries(req, results);
+  // Make the updates visible to the readers, including the successful ones in
+  // a partially failed batch.
+  bcm_table_manager_->PublishReadSnapshot();
+
+  return status;
 }
 
 ::util::Status BcmNode::ReadForwardingEntries(
@@ -188,11 +205,24 @@ BcmNode::~BcmNode() {}
   CHECK_RETURN_IF_FALSE(writer) << "Channel writer must be non-null.";
   CHECK_RETURN_IF_FALSE(details) << "Details pointer must be non-null.";
 
-  absl::ReaderMutexLock l(&lock_);
-  CHECK_RETURN_IF_FALSE(req.device_id() == node_id_)
-      << "Request device id must be same as id of this BcmNode.";
-  if (!initialized_) {
-    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  // The node lock is only held to get the last published snapshot of the
+  // programmed entities. The rest of the read is served from the snapshot and
+  // does not block (or wait for) the writes.
+  uint64 node_id = 0;
+  std::shared_ptr<const BcmTableManager::ReadSnapshot> snapshot;
+  {
+    absl::ReaderMutexLock l(&lock_);
+    CHECK_RETURN_IF_FALSE(req.device_id() == node_id_)
+        << "Request device id must be same as id of this BcmNode.";
+    if (!initialized_) {
+      return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+    }
+    node_id = node_id_;
+    snapshot = bcm_table_manager_->GetReadSnapshot();
+  }
+  if (snapshot == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "No read snapshot for node " << node_id << ".";
   }
   std::set<uint32> table_ids = {};
   std::set<uint32> action_profile_ids = {};
@@ -266,11 +296,14 @@ BcmNode::~BcmNode() {}
         ::p4::v1::ReadResponse resp;
         ::p4::v1::CounterData* counter =
             resp.add_entities()->mutable_direct_counter_entry()->mutable_data();
-        RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
-            entity.direct_counter_entry().table_entry(), counter));
+        const ::p4::v1::TableEntry& table_entry =
+            entity.direct_counter_entry().table_entry();
+        ASSIGN_OR_RETURN(int bcm_acl_id, snapshot->FindBcmAclId(table_entry));
+        RETURN_IF_ERROR(
+            ReadSnapshotAclStats(*snapshot, table_entry, bcm_acl_id, counter));
         if (!writer->Write(resp)) {
           return MAKE_ERROR(ERR_INTERNAL)
-                 << "Write to stream for failed for node " << node_id_ << ".";
+                 << "Write to stream for failed for node " << node_id << ".";
         }
         break;
       }
@@ -292,42 +325,106 @@ BcmNode::~BcmNode() {}
   if (action_profile_ids.count(0)) action_profile_ids.clear();  // request all
 
   if (table_entries_requested) {
-    ::p4::v1::ReadResponse resp;
-    std::vector<::p4::v1::TableEntry*> acl_flows;
-    // Populate response with table entries and obtain list of pointers into the
-    // response to entries for which stats need to be collected.
-    RETURN_IF_ERROR(
-        bcm_table_manager_->ReadTableEntries(table_ids, &resp, &acl_flows));
-    // Collect ACL stats.
-    for (auto* flow : acl_flows) {
-      RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
-          *flow, flow->mutable_counter_data()));
-    }
-    if (!writer->Write(resp)) {
-      return MAKE_ERROR(ERR_INTERNAL)
-             << "Write to stream for failed for node " << node_id_ << ".";
-    }
+    RETURN_IF_ERROR(StreamTableEntries(*snapshot, table_ids, node_id, writer));
   }
   if (action_profile_members_requested) {
-    RETURN_IF_ERROR(bcm_table_manager_->ReadActionProfileMembers(
-        action_profile_ids, writer));
+    RETURN_IF_ERROR(
+        snapshot->ReadActionProfileMembers(action_profile_ids, writer));
   }
   if (action_profile_groups_requested) {
-    RETURN_IF_ERROR(bcm_table_manager_->ReadActionProfileGroups(
-        action_profile_ids, writer));
+    RETURN_IF_ERROR(
+        snapshot->ReadActionProfileGroups(action_profile_ids, writer));
   }
   if (clone_sessions_requested) {
-    RETURN_IF_ERROR(bcm_table_manager_->ReadMulticastGroups(
-        clone_session_ids, writer));
+    RETURN_IF_ERROR(snapshot->ReadMulticastGroups(clone_session_ids, writer));
   }
   if (multicast_groups_requested) {
-    RETURN_IF_ERROR(bcm_table_manager_->ReadCloneSessions(
-        multicast_group_ids, writer));
+    RETURN_IF_ERROR(snapshot->ReadCloneSessions(multicast_group_ids, writer));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmNode::StreamTableEntries(
+    const BcmTableManager::ReadSnapshot& snapshot,
+    const std::set<uint32>& table_ids, uint64 node_id,
+    WriterInterface<::p4::v1::ReadResponse>* writer) const {
+  const int max_entries =
+      std::max(1, FLAGS_max_num_table_entries_per_read_response);
+  const size_t max_bytes =
+      static_cast<size_t>(std::max(0, FLAGS_max_read_response_size_bytes));
+  // The same response is cleared and refilled for each chunk. Clearing keeps
+  // the already allocated entities around, so they are reused by the next
+  // chunk instead of being allocated again.
+  ::p4::v1::ReadResponse resp;
+  size_t resp_size = 0;
+  int num_responses = 0;
+  auto flush = [&resp, &resp_size, &num_responses, writer,
+                node_id]() -> ::util::Status {
+    if (!writer->Write(resp)) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Write to stream for failed for node " << node_id << ".";
+    }
+    resp.Clear();
+    resp_size = 0;
+    num_responses++;
+    return ::util::OkStatus();
+  };
+
+  RETURN_IF_ERROR(snapshot.ForEachTableEntry(
+      table_ids, [this, &snapshot, &resp, &resp_size, &flush, max_entries,
+                  max_bytes](
+                     const ::p4::v1::TableEntry& entry, bool is_acl,
+                     int bcm_acl_id) -> ::util::Status {
+        auto* entity = resp.add_entities();
+        auto* table_entry = entity->mutable_table_entry();
+        *table_entry = entry;
+        // Collect ACL stats. An entry whose counters cannot be read is
+        // returned without them rather than failing the whole read.
+        if (is_acl && bcm_acl_id >= 0) {
+          ::util::Status status =
+              ReadSnapshotAclStats(snapshot, entry, bcm_acl_id,
+                                   table_entry->mutable_counter_data());
+          if (!status.ok()) {
+            table_entry->clear_counter_data();
+            LOG_EVERY_N(WARNING, 100)
+                << "Failed to read the counters of table entry "
+                << entry.ShortDebugString() << ": " << status;
+          }
+        }
+        resp_size += entity->ByteSizeLong();
+        if (resp.entities_size() >= max_entries || resp_size >= max_bytes) {
+          RETURN_IF_ERROR(flush());
+        }
+        return ::util::OkStatus();
+      }));
+  // Send the last chunk. An empty response is sent if there are no entries at
+  // all, so the caller always gets an answer to the table entry read.
+  if (resp.entities_size() > 0 || num_responses == 0) {
+    RETURN_IF_ERROR(flush());
   }
 
   return ::util::OkStatus();
 }
 
+::util::Status BcmNode::ReadSnapshotAclStats(
+    const BcmTableManager::ReadSnapshot& snapshot,
+    const ::p4::v1::TableEntry& entry, int bcm_acl_id,
+    ::p4::v1::CounterData* counter) const {
+  // Reading the counters may sync all of them from hardware, so it is done
+  // without the node lock.
+  RETURN_IF_ERROR(bcm_acl_manager_->GetBcmAclStats(bcm_acl_id, entry, counter));
+  // The ID is released before its flow is removed, so if it is still current
+  // after the read, the counters are the ones of the entry.
+  if (!bcm_table_manager_->IsBcmAclIdCurrent(snapshot, bcm_acl_id)) {
+    counter->Clear();
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << "Table entry " << entry.ShortDebugString()
+           << " has changed since the read snapshot was published.";
+  }
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmNode::RegisterPacketReceiveWriter(
     const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer) {
   absl::WriterMutexLock l(&lock_);
@@ -356,6 +453,16 @@ BcmNode::~BcmNode() {}
       GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
 }
 
+::util::Status BcmNode::TransmitPackets(
+    const std::vector<::p4::v1::PacketOut>& packets) {
+  absl::ReaderMutexLock l(&lock_);
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  return bcm_packetio_manager_->TransmitPackets(
+      GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packets);
+}
+
 ::util::Status BcmNode::UpdatePortState(uint32 port_id) {
   absl::WriterMutexLock l(&lock_);
   if (!initialized_) {
@@ -425,18 +532,54 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
 
 ::util::Status BcmNode::DoWriteForwardingEntries(
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
-  bool success = true;
-  for (const auto& update : req.updates()) {
+  // Contiguous L3 LPM/host table entry updates are deferred and programmed as
+  // one batch. The creation of action profile members/groups (i.e. the egress
+  // and ECMP/WCMP intfs the routes point to) does not interrupt a batch, as
+  // the routes in it were already resolved against the existing nexthops. Any
+  // other update first flushes the pending batch, so that e.g. the routes are
+  // deleted before the nexthops they point to.
+  const size_t base = results->size();
+  results->resize(base + req.updates_size(), ::util::OkStatus());
+  std::vector<L3TableEntryWrite> l3_writes;
+  std::vector<size_t> l3_indices;
+  for (int i = 0; i < req.updates_size(); ++i) {
+    const auto& update = req.updates(i);
+    const auto entity_case = update.entity().entity_case();
+    const bool is_nexthop_insert =
+        update.type() == ::p4::v1::Update::INSERT &&
+        (entity_case == ::p4::v1::Entity::kActionProfileMember ||
+         entity_case == ::p4::v1::Entity::kActionProfileGroup);
+    if (entity_case != ::p4::v1::Entity::kTableEntry && !is_nexthop_insert) {
+      FlushL3TableWrites(&l3_writes, &l3_indices, results);
+    }
     ::util::Status status = ::util::OkStatus();
-    switch (update.entity().entity_case()) {
+    switch (entity_case) {
       case ::p4::v1::Entity::kExternEntry:
         // TODO(unknown): Implement this.
         status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
                  << "Extern entries are not currently supported.";
         break;
-      case ::p4::v1::Entity::kTableEntry:
-        status = TableWrite(update.entity().table_entry(), update.type());
+      case ::p4::v1::Entity::kTableEntry: {
+        const auto& entry = update.entity().table_entry();
+        BcmFlowEntry bcm_flow_entry;
+        status = FillTableWrite(entry, update.type(), &bcm_flow_entry);
+        if (!status.ok()) break;
+        switch (bcm_flow_entry.bcm_table_type()) {
+          case BcmFlowEntry::BCM_TABLE_IPV4_LPM:
+          case BcmFlowEntry::BCM_TABLE_IPV4_HOST:
+          case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
+          case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
+            l3_writes.push_back(
+                {update.type(), &entry, std::move(bcm_flow_entry)});
+            l3_indices.push_back(base + i);
+            break;
+          default:
+            FlushL3TableWrites(&l3_writes, &l3_indices, results);
+            status = TableWrite(entry, update.type(), bcm_flow_entry);
+            break;
+        }
         break;
+      }
       case ::p4::v1::Entity::kActionProfileMember:
         status = ActionProfileMemberWrite(
             update.entity().action_profile_member(), update.type());
@@ -488,13 +631,15 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
                  << " with no plan of support: " << update.ShortDebugString()
                  << ".";
     }
-    success &= status.ok();
-    results->push_back(status);
+    (*results)[base + i] = status;
   }
+  FlushL3TableWrites(&l3_writes, &l3_indices, results);
 
-  if (!success) {
-    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
-           << "One or more write operations failed.";
+  for (size_t i = base; i < results->size(); ++i) {
+    if (!(*results)[i].ok()) {
+      return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+             << "One or more write operations failed.";
+    }
   }
 
   LOG(INFO) << "P4-based forwarding entities written successfully to node with "
@@ -503,15 +648,41 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
   return ::util::OkStatus();
 }
 
-// TODO(unknown): Complete this function for all the update types.
-::util::Status BcmNode::TableWrite(const ::p4::v1::TableEntry& entry,
-                                   ::p4::v1::Update::Type type) {
+::util::Status BcmNode::FillTableWrite(const ::p4::v1::TableEntry& entry,
+                                       ::p4::v1::Update::Type type,
+                                       BcmFlowEntry* bcm_flow_entry) {
   CHECK_RETURN_IF_FALSE(type != ::p4::v1::Update::UNSPECIFIED);
 
   // We populate BcmFlowEntry based on the given TableEntry.
-  BcmFlowEntry bcm_flow_entry;
-  RETURN_IF_ERROR(
-      bcm_table_manager_->FillBcmFlowEntry(entry, type, &bcm_flow_entry));
+  return bcm_table_manager_->FillBcmFlowEntry(entry, type, bcm_flow_entry);
+}
+
+void BcmNode::FlushL3TableWrites(std::vector<L3TableEntryWrite>* writes,
+                                 std::vector<size_t>* indices,
+                                 std::vector<::util::Status>* results) {
+  if (writes->empty()) return;
+  if (writes->size() == 1) {
+    // Nothing to gain from a batch of one.
+    const auto& write = writes->front();
+    (*results)[indices->front()] =
+        TableWrite(*write.entry, write.type, write.bcm_flow_entry);
+  } else {
+    std::vector<::util::Status> l3_results;
+    ::util::Status status =
+        bcm_l3_manager_->WriteTableEntries(*writes, &l3_results);
+    for (size_t i = 0; i < indices->size(); ++i) {
+      (*results)[(*indices)[i]] =
+          i < l3_results.size() ? l3_results[i] : status;
+    }
+  }
+  writes->clear();
+  indices->clear();
+}
+
+// TODO(unknown): Complete this function for all the update types.
+::util::Status BcmNode::TableWrite(const ::p4::v1::TableEntry& entry,
+                                   ::p4::v1::Update::Type type,
+                                   const BcmFlowEntry& bcm_flow_entry) {
   BcmFlowEntry::BcmTableType bcm_table_type = bcm_flow_entry.bcm_table_type();
   // Try to program the flow.
   bool consumed = false;  // will be set to true if we know what to do
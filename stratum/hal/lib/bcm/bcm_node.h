@@ -89,7 +89,11 @@ class BcmNode {
       SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
 
   // Reads P4-based forwarding entries (table entries, action profile members,
-  // action profile groups, meters, counters) from this node.
+  // action profile groups, meters, counters) from this node. The entries are
+  // read from the last snapshot published by the BcmTableManager, so the read
+  // runs concurrently with WriteForwardingEntries() and does not see the
+  // updates of a write which is in progress. Table entries are streamed to
+  // the writer in several ReadResponses of bounded size.
   virtual ::util::Status ReadForwardingEntries(
       const ::p4::v1::ReadRequest& req,
       WriterInterface<::p4::v1::ReadResponse>* writer,
@@ -114,6 +118,12 @@ class BcmNode {
   virtual ::util::Status TransmitPacket(const ::p4::v1::PacketOut& packet)
       SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
 
+  // Transmits a batch of packets received from controller, amortizing the
+  // locking and the socket writes over the whole batch.
+  virtual ::util::Status TransmitPackets(
+      const std::vector<::p4::v1::PacketOut>& packets)
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
+
   // Updates any managers which rely on current port state. This is generally
   // invoked by BcmChassisManager in the linkscan event handler.
   virtual ::util::Status UpdatePortState(uint32 port_id)
@@ -157,9 +167,44 @@ class BcmNode {
       const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
-  // Write a single P4 TableEntry.
+  // Streams the entries of the given tables (all tables if table_ids is
+  // empty) from the snapshot to the writer, together with the counters of the
+  // ACL entries. The entries are split over several ReadResponses, each
+  // holding at most FLAGS_max_num_table_entries_per_read_response entries and
+  // about FLAGS_max_read_response_size_bytes bytes, so that the memory used by
+  // the read does not grow with the size of the tables.
+  ::util::Status StreamTableEntries(
+      const BcmTableManager::ReadSnapshot& snapshot,
+      const std::set<uint32>& table_ids, uint64 node_id,
+      WriterInterface<::p4::v1::ReadResponse>* writer) const
+      LOCKS_EXCLUDED(lock_);
+
+  // Reads the counters of an ACL entry returned by the given ReadSnapshot,
+  // given the BCM ACL ID recorded in the snapshot. The entry may have been
+  // deleted, and its ID given to another entry, since the snapshot was
+  // published, so the counters are only returned if the ID has not been
+  // released. Does not take lock_, so the reads never wait for the writes.
+  ::util::Status ReadSnapshotAclStats(
+      const BcmTableManager::ReadSnapshot& snapshot,
+      const ::p4::v1::TableEntry& entry, int bcm_acl_id,
+      ::p4::v1::CounterData* counter) const LOCKS_EXCLUDED(lock_);
+
+  // Fills the BcmFlowEntry for a single P4 TableEntry to write.
+  ::util::Status FillTableWrite(const ::p4::v1::TableEntry& entry,
+                                ::p4::v1::Update::Type type,
+                                BcmFlowEntry* bcm_flow_entry);
+
+  // Programs the L3 LPM/host table entry writes deferred by
+  // DoWriteForwardingEntries() and stores their statuses at the given indices
+  // of results. Clears writes and indices.
+  void FlushL3TableWrites(std::vector<L3TableEntryWrite>* writes,
+                          std::vector<size_t>* indices,
+                          std::vector<::util::Status>* results);
+
+  // Write a single P4 TableEntry, given the BcmFlowEntry filled for it.
   ::util::Status TableWrite(const ::p4::v1::TableEntry& entry,
-                            ::p4::v1::Update::Type type);
+                            ::p4::v1::Update::Type type,
+                            const BcmFlowEntry& bcm_flow_entry);
 
   // Write a single P4 ActionProfileMember.
   ::util::Status ActionProfileMemberWrite(
@@ -56,6 +56,8 @@ class BcmNodeMock : public BcmNode {
           std::function<void(const ::p4::v1::PacketIn& packet)> callback));
   MOCK_METHOD1(TransmitPacket,
                ::util::Status(const ::p4::v1::PacketOut& packet));
+  MOCK_METHOD1(TransmitPackets,
+               ::util::Status(const std::vector<::p4::v1::PacketOut>& packets));
   MOCK_METHOD1(UpdatePortState, ::util::Status(uint32 port_id));
 };
 
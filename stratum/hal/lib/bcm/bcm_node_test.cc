@@ -14,11 +14,15 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_node.h"
 #include "stratum/glue/status/canonical_errors.h"
 #include "stratum/glue/status/status_test_util.h"
+#include "gflags/gflags.h"
+#include "stratum/hal/lib/bcm/acl_table.h"
 #include "stratum/hal/lib/bcm/bcm_acl_manager_mock.h"
+#include "stratum/hal/lib/bcm/bcm_chassis_ro_mock.h"
 #include "stratum/hal/lib/bcm/bcm_l2_manager_mock.h"
 #include "stratum/hal/lib/bcm/bcm_l3_manager_mock.h"
 #include "stratum/hal/lib/bcm/bcm_packetio_manager_mock.h"
@@ -32,6 +36,9 @@
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 
+DECLARE_int32(max_num_table_entries_per_read_response);
+DECLARE_int32(max_read_response_size_bytes);
+
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Eq;
@@ -39,6 +46,10 @@ using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::SetArgPointee;
+using ::testing::SizeIs;
+using ::testing::UnorderedElementsAre;
 using ::testing::WithArgs;
 
 namespace stratum {
@@ -106,6 +117,14 @@ class BcmNodeTest : public ::testing::Test {
     return bcm_node_->WriteForwardingEntries(req, results);
   }
 
+  ::util::Status ReadForwardingEntries(
+      const ::p4::v1::ReadRequest& req,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      std::vector<::util::Status>* details) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_node_->ReadForwardingEntries(req, writer, details);
+  }
+
   ::util::Status RegisterPacketReceiveWriter(
       const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer) {
     absl::ReaderMutexLock l(&chassis_lock);
@@ -171,6 +190,7 @@ class BcmNodeTest : public ::testing::Test {
   static constexpr int kLogicalPortId = 35;
   static constexpr uint32 kPortId = 941;
   static constexpr uint32 kL2McastGroupId = 20;
+  static constexpr uint32 kTableId = 33554433;
 
   std::unique_ptr<BcmAclManagerMock> bcm_acl_manager_mock_;
   std::unique_ptr<BcmL2ManagerMock> bcm_l2_manager_mock_;
@@ -190,6 +210,7 @@ constexpr uint32 BcmNodeTest::kGroupId;
 constexpr int BcmNodeTest::kEgressIntfId;
 constexpr int BcmNodeTest::kLogicalPortId;
 constexpr uint32 BcmNodeTest::kPortId;
+constexpr uint32 BcmNodeTest::kTableId;
 
 TEST_F(BcmNodeTest, PushChassisConfigSuccess) { PushChassisConfigWithCheck(); }
 
@@ -953,6 +974,106 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_Ipv6Host) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_L3Batch) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  // Two routes, with a nexthop created in between, and an ACL entry.
+  ::p4::v1::WriteRequest req;
+  auto* route1 = SetupTableEntryToInsert(&req, kNodeId);
+  route1->set_table_id(kTableId);
+  auto* update = req.add_updates();
+  update->set_type(::p4::v1::Update::INSERT);
+  auto* member = update->mutable_entity()->mutable_action_profile_member();
+  member->set_member_id(kMemberId);
+  auto* route2 = SetupTableEntryToInsert(&req, kNodeId);
+  route2->set_table_id(kTableId + 1);
+  auto* acl = SetupTableEntryToInsert(&req, kNodeId);
+  acl->set_table_id(kTableId + 2);
+
+  for (const auto* route : {route1, route2}) {
+    EXPECT_CALL(*bcm_table_manager_mock_,
+                FillBcmFlowEntry(EqualsProto(*route), ::p4::v1::Update::INSERT,
+                                 _))
+        .WillOnce(DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                          x->set_bcm_table_type(
+                              BcmFlowEntry::BCM_TABLE_IPV4_LPM);
+                        })),
+                        Return(::util::OkStatus())));
+  }
+  EXPECT_CALL(
+      *bcm_table_manager_mock_,
+      FillBcmFlowEntry(EqualsProto(*acl), ::p4::v1::Update::INSERT, _))
+      .WillOnce(DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                        x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_ACL);
+                      })),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_table_manager_mock_, ActionProfileMemberExists(kMemberId))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmNonMultipathNexthop(EqualsProto(*member), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke([](BcmNonMultipathNexthop* x) {
+                        x->set_type(BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT);
+                        x->set_unit(kUnit);
+                        x->set_logical_port(kLogicalPortId);
+                      })),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddActionProfileMember(EqualsProto(*member),
+                                     BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT,
+                                     kEgressIntfId, kLogicalPortId))
+      .WillOnce(Return(::util::OkStatus()));
+  {
+    // The nexthop creation does not interrupt the batch of routes, but the
+    // ACL entry is only written after the routes.
+    InSequence sequence;
+    EXPECT_CALL(*bcm_l3_manager_mock_, FindOrCreateNonMultipathNexthop(_))
+        .WillOnce(Return(kEgressIntfId));
+    EXPECT_CALL(*bcm_l3_manager_mock_, WriteTableEntries(SizeIs(2), _))
+        .WillOnce(DoAll(SetArgPointee<1>(std::vector<::util::Status>(
+                            2, ::util::OkStatus())),
+                        Return(::util::OkStatus())));
+    EXPECT_CALL(*bcm_acl_manager_mock_, InsertTableEntry(EqualsProto(*acl)))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+
+  std::vector<::util::Status> results = {};
+  EXPECT_OK(WriteForwardingEntries(req, &results));
+  EXPECT_EQ(4U, results.size());
+}
+
+TEST_F(BcmNodeTest, WriteForwardingEntriesFailure_InsertTableEntry_L3Batch) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  auto* route1 = SetupTableEntryToInsert(&req, kNodeId);
+  route1->set_table_id(kTableId);
+  auto* route2 = SetupTableEntryToInsert(&req, kNodeId);
+  route2->set_table_id(kTableId + 1);
+
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmFlowEntry(_, ::p4::v1::Update::INSERT, _))
+      .Times(2)
+      .WillRepeatedly(DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                              x->set_bcm_table_type(
+                                  BcmFlowEntry::BCM_TABLE_IPV6_HOST);
+                            })),
+                            Return(::util::OkStatus())));
+  std::vector<::util::Status> l3_results = {::util::OkStatus(),
+                                            DefaultError()};
+  EXPECT_CALL(*bcm_l3_manager_mock_, WriteTableEntries(SizeIs(2), _))
+      .WillOnce(DoAll(SetArgPointee<1>(l3_results),
+                      Return(::util::Status(StratumErrorSpace(),
+                                            ERR_AT_LEAST_ONE_OPER_FAILED,
+                                            "Blah"))));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(2U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_THAT(results[1], DerivedFromStatus(DefaultError()));
+}
+
 TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_L2Multicat) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
 
@@ -1681,6 +1802,209 @@ TEST_F(BcmNodeTest, TestUpdatePortState) {
   EXPECT_EQ(expected_error.ToString(), status.ToString());
 }
 
+TEST_F(BcmNodeTest, ReadForwardingEntriesStreamsTableEntriesInChunks) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  // Program a few entries in a real BcmTableManager and serve its snapshot.
+  BcmChassisRoMock bcm_chassis_ro_mock;
+  auto bcm_table_manager = BcmTableManager::CreateInstance(
+      &bcm_chassis_ro_mock, p4_table_mapper_mock_.get(), kUnit);
+  constexpr int kNumEntries = 5;
+  std::vector<::p4::v1::TableEntry> entries;
+  for (int i = 0; i < kNumEntries; ++i) {
+    ::p4::v1::TableEntry entry;
+    entry.set_table_id(kTableId);
+    auto* match = entry.add_match();
+    match->set_field_id(1);
+    match->mutable_exact()->set_value(std::string(1, 'a' + i));
+    ASSERT_OK(bcm_table_manager->AddTableEntry(entry));
+    entries.push_back(entry);
+  }
+  bcm_table_manager->PublishReadSnapshot();
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadSnapshot())
+      .WillRepeatedly(Return(bcm_table_manager->GetReadSnapshot()));
+
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  req.add_entities()->mutable_table_entry()->set_table_id(0);
+
+  // Collect all the responses written by the node.
+  std::vector<::p4::v1::ReadResponse> responses;
+  WriterMock<::p4::v1::ReadResponse> writer;
+  EXPECT_CALL(writer, Write(_))
+      .WillRepeatedly(Invoke([&responses](const ::p4::v1::ReadResponse& resp) {
+        responses.push_back(resp);
+        return true;
+      }));
+  std::vector<::util::Status> details;
+
+  // At most 2 entries per response.
+  FLAGS_max_num_table_entries_per_read_response = 2;
+  ASSERT_OK(ReadForwardingEntries(req, &writer, &details));
+  ASSERT_EQ(3, responses.size());
+  EXPECT_EQ(2, responses[0].entities_size());
+  EXPECT_EQ(2, responses[1].entities_size());
+  EXPECT_EQ(1, responses[2].entities_size());
+  std::vector<std::string> values;
+  for (const auto& resp : responses) {
+    for (const auto& entity : resp.entities()) {
+      values.push_back(entity.table_entry().match(0).exact().value());
+    }
+  }
+  EXPECT_THAT(values, UnorderedElementsAre("a", "b", "c", "d", "e"));
+
+  // A tiny byte limit sends each entry in its own response.
+  responses.clear();
+  FLAGS_max_num_table_entries_per_read_response = 1000;
+  FLAGS_max_read_response_size_bytes = 1;
+  ASSERT_OK(ReadForwardingEntries(req, &writer, &details));
+  EXPECT_EQ(kNumEntries, responses.size());
+
+  // An empty table still gets an (empty) response.
+  responses.clear();
+  req.mutable_entities(0)->mutable_table_entry()->set_table_id(kTableId + 1);
+  ASSERT_OK(ReadForwardingEntries(req, &writer, &details));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(0, responses[0].entities_size());
+
+  FLAGS_max_num_table_entries_per_read_response = 1000;
+  FLAGS_max_read_response_size_bytes = 1024 * 1024;
+}
+
+TEST_F(BcmNodeTest, ReadForwardingEntriesFailsWhenWriteFails) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  BcmChassisRoMock bcm_chassis_ro_mock;
+  auto bcm_table_manager = BcmTableManager::CreateInstance(
+      &bcm_chassis_ro_mock, p4_table_mapper_mock_.get(), kUnit);
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadSnapshot())
+      .WillOnce(Return(bcm_table_manager->GetReadSnapshot()));
+
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  req.add_entities()->mutable_table_entry();
+  WriterMock<::p4::v1::ReadResponse> writer;
+  EXPECT_CALL(writer, Write(_)).WillOnce(Return(false));
+  std::vector<::util::Status> details;
+  auto status = ReadForwardingEntries(req, &writer, &details);
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Write to stream"));
+}
+
+TEST_F(BcmNodeTest, ReadForwardingEntriesOmitsUnavailableAclStats) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  BcmChassisRoMock bcm_chassis_ro_mock;
+  auto bcm_table_manager = BcmTableManager::CreateInstance(
+      &bcm_chassis_ro_mock, p4_table_mapper_mock_.get(), kUnit);
+  ::p4::config::v1::Table p4_table;
+  p4_table.mutable_preamble()->set_id(kTableId);
+  p4_table.add_match_fields()->set_id(1);
+  p4_table.set_size(10);
+  ASSERT_OK(bcm_table_manager->AddAclTable(
+      AclTable(p4_table, BCM_ACL_STAGE_IFP, /*priority=*/1, {})));
+  std::vector<::p4::v1::TableEntry> entries(5);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].set_table_id(kTableId);
+    auto* match = entries[i].add_match();
+    match->set_field_id(1);
+    match->mutable_exact()->set_value(std::string(1, 'a' + i));
+  }
+  ASSERT_OK(bcm_table_manager->AddAclTableEntry(entries[0], 10));
+  ASSERT_OK(bcm_table_manager->AddAclTableEntry(entries[1], 11));
+  ASSERT_OK(bcm_table_manager->AddAclTableEntry(entries[2], 12));
+  // No BCM ACL ID for the 4th entry.
+  ASSERT_OK(bcm_table_manager->AddTableEntry(entries[3]));
+  bcm_table_manager->PublishReadSnapshot();
+  // The 1st entry is deleted after the snapshot was published, and its BCM
+  // ACL ID given to another entry.
+  bcm_table_manager->ReleaseBcmAclId(10);
+  ASSERT_OK(bcm_table_manager->DeleteTableEntry(entries[0]));
+  ASSERT_OK(bcm_table_manager->AddAclTableEntry(entries[4], 10));
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadSnapshot())
+      .WillOnce(Return(bcm_table_manager->GetReadSnapshot()));
+  EXPECT_CALL(*bcm_table_manager_mock_, IsBcmAclIdCurrent(_, _))
+      .WillRepeatedly(Invoke(bcm_table_manager.get(),
+                             &BcmTableManager::IsBcmAclIdCurrent));
+
+  // The counters read for the stale entry are dropped, and a failure to read
+  // the counters of an entry does not fail the read.
+  ::p4::v1::CounterData counter;
+  counter.set_packet_count(5);
+  EXPECT_CALL(*bcm_acl_manager_mock_,
+              GetBcmAclStats(10, EqualsProto(entries[0]), _))
+      .WillOnce(DoAll(SetArgPointee<2>(counter), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_acl_manager_mock_,
+              GetBcmAclStats(11, EqualsProto(entries[1]), _))
+      .WillOnce(DoAll(SetArgPointee<2>(counter), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_acl_manager_mock_,
+              GetBcmAclStats(12, EqualsProto(entries[2]), _))
+      .WillOnce(Return(DefaultError()));
+
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  req.add_entities()->mutable_table_entry()->set_table_id(kTableId);
+  ::p4::v1::ReadResponse resp;
+  WriterMock<::p4::v1::ReadResponse> writer;
+  EXPECT_CALL(writer, Write(_))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  std::vector<::util::Status> details;
+  ASSERT_OK(ReadForwardingEntries(req, &writer, &details));
+  ASSERT_EQ(4, resp.entities_size());
+  for (const auto& entity : resp.entities()) {
+    const auto& table_entry = entity.table_entry();
+    if (table_entry.match(0).exact().value() == "b") {
+      EXPECT_EQ(5, table_entry.counter_data().packet_count());
+    } else {
+      EXPECT_FALSE(table_entry.has_counter_data());
+    }
+  }
+}
+
+TEST_F(BcmNodeTest, ReadForwardingEntriesReadsDirectCountersFromSnapshot) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  BcmChassisRoMock bcm_chassis_ro_mock;
+  auto bcm_table_manager = BcmTableManager::CreateInstance(
+      &bcm_chassis_ro_mock, p4_table_mapper_mock_.get(), kUnit);
+  ::p4::config::v1::Table p4_table;
+  p4_table.mutable_preamble()->set_id(kTableId);
+  p4_table.add_match_fields()->set_id(1);
+  p4_table.set_size(10);
+  ASSERT_OK(bcm_table_manager->AddAclTable(
+      AclTable(p4_table, BCM_ACL_STAGE_IFP, /*priority=*/1, {})));
+  ::p4::v1::TableEntry entry;
+  entry.set_table_id(kTableId);
+  auto* match = entry.add_match();
+  match->set_field_id(1);
+  match->mutable_exact()->set_value("a");
+  ASSERT_OK(bcm_table_manager->AddAclTableEntry(entry, 10));
+  bcm_table_manager->PublishReadSnapshot();
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadSnapshot())
+      .WillOnce(Return(bcm_table_manager->GetReadSnapshot()));
+  EXPECT_CALL(*bcm_table_manager_mock_, IsBcmAclIdCurrent(_, 10))
+      .WillOnce(Return(true));
+  // The BCM ACL ID comes from the snapshot, not from the live tables.
+  EXPECT_CALL(*bcm_table_manager_mock_, GetReadOnlyAclTable(_)).Times(0);
+  ::p4::v1::CounterData counter;
+  counter.set_packet_count(5);
+  EXPECT_CALL(*bcm_acl_manager_mock_, GetBcmAclStats(10, EqualsProto(entry), _))
+      .WillOnce(DoAll(SetArgPointee<2>(counter), Return(::util::OkStatus())));
+
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  *req.add_entities()->mutable_direct_counter_entry()->mutable_table_entry() =
+      entry;
+  ::p4::v1::ReadResponse resp;
+  WriterMock<::p4::v1::ReadResponse> writer;
+  EXPECT_CALL(writer, Write(_))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  std::vector<::util::Status> details;
+  ASSERT_OK(ReadForwardingEntries(req, &writer, &details));
+  ASSERT_EQ(1, resp.entities_size());
+  EXPECT_EQ(5, resp.entities(0).direct_counter_entry().data().packet_count());
+}
+
 // TODO(unknown): Complete unit test coverage.
 
 }  // namespace bcm
@@ -48,9 +48,17 @@ DEFINE_int32(knet_rx_buf_size, 512 * 1024,
              "KNET RX socket buffer size (0 = kernel default).");
 DEFINE_int32(knet_rx_poll_timeout_ms, 100,
              "Polling timeout to check incoming packets from KNET RX sockets.");
-DEFINE_int32(knet_max_num_packets_to_read_at_once, 8,
-             "Determines the number of packets we try to read at once as soon "
-             "as the socket FD becomes available.");
+DEFINE_int32(knet_max_num_packets_to_read_at_once, 32,
+             "Determines the number of packets we try to read at once (with a "
+             "single recvmmsg() call) as soon as the socket FD becomes "
+             "available.");
+DEFINE_int32(knet_max_num_packets_to_write_at_once, 32,
+             "Determines the max number of packets we try to write at once "
+             "(with a single sendmmsg() call) when transmitting a batch of "
+             "packets.");
+DEFINE_int32(knet_tx_header_cache_size, 4096,
+             "Max number of KNET TX headers cached per node. The cache is "
+             "cleared when it grows beyond this size. 0 disables the cache.");
 
 // TODO(unknown): I really really wish we could use google3 thread libraries.
 namespace stratum {
@@ -69,14 +77,8 @@ constexpr size_t BcmPacketioManager::kMaxRxBufferSize;
 
 namespace {
 
-// Macros to increment the RX/TX counters for a KNET intf. MUST be called inside
+// Macro to increment the RX counters for a KNET intf. MUST be called inside
 // the class methods only as it accesses class member variables.
-#define INCREMENT_TX_COUNTER(purpose, counter) \
-  do {                                         \
-    absl::WriterMutexLock l(&tx_stats_lock_);  \
-    purpose_to_tx_stats_[purpose].counter++;   \
-  } while (0)
-
 #define INCREMENT_RX_COUNTER(purpose, counter) \
   do {                                         \
     absl::WriterMutexLock l(&rx_stats_lock_);  \
@@ -191,6 +193,10 @@ BcmPacketioManager::~BcmPacketioManager() {}
   RETURN_IF_ERROR(SetRateLimit(*bcm_rate_limit_config));
   bcm_rate_limit_config_ = std::move(bcm_rate_limit_config);
 
+  // The KNET TX headers are built based on the logical ports. Make sure we do
+  // not use any stale header after the push.
+  ClearKnetTxHeaderCache();
+
   // The last step is to update the port_id_to_logical_port_ and
   // logical_port_to_port_id_ (reverse of port_id_to_logical_port_) maps using
   // the last updated maps from BcmChassisRoInterface. This is done after each
@@ -335,6 +341,7 @@ BcmPacketioManager::~BcmPacketioManager() {}
   bcm_tx_config_.reset(nullptr);
   bcm_knet_config_.reset(nullptr);
   bcm_rate_limit_config_.reset(nullptr);
+  ClearKnetTxHeaderCache();
   {
     absl::WriterMutexLock l(&rx_writer_lock_);
     purpose_to_rx_writer_.clear();
@@ -413,96 +420,16 @@ BcmPacketioManager::~BcmPacketioManager() {}
 ::util::Status BcmPacketioManager::TransmitPacket(
     GoogleConfig::BcmKnetIntfPurpose purpose,
     const ::p4::v1::PacketOut& packet) {
-  ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
-  CHECK_RETURN_IF_FALSE(intf->tx_sock > 0)  // MUST NOT HAPPEN!
-      << "KNET interface with purpose "
-      << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
-      << node_id_ << " mapped to unit " << unit_
-      << " does not have a TX socket.";
-
-  INCREMENT_TX_COUNTER(purpose, all_tx);
-
-  // Try to find the port/cos to send the packet to. Also find out if we need to
-  // send the packet to ingress pipeline.
-  PacketOutMetadata meta;
-  ::util::Status status = ParsePacketOutMetadata(packet, &meta);
-  if (!status.ok()) {
-    INCREMENT_TX_COUNTER(purpose, tx_drops_metadata_parse_error);
-  }
-  VLOG(1) << "PacketOutMetadata.egress_port_id: " << meta.egress_port_id << "\n"
-          << "PacketOutMetadata.egress_trunk_id: " << meta.egress_trunk_id
-          << "\n"
-          << "PacketOutMetadata.cos: " << meta.cos << "\n"
-          << "PacketOutMetadata.use_ingress_pipeline: "
-          << meta.use_ingress_pipeline;
-
-  // Now try to send the packet. There are several cases:
-  // 1- Direct packet to physical port.
-  // 2- Direct packet to trunk port. In this case we send the packet to the
-  //    first member of the trunk which is up.
-  // 3- Packet to ingress pipeline.
-  if (!meta.use_ingress_pipeline) {
-    uint32 port_id = 0;
-    if (meta.egress_trunk_id > 0) {
-      // TX to trunk. Select the first member of the trunk which is up.
-      ASSIGN_OR_RETURN(const std::set<uint32>& members,
-                       bcm_chassis_ro_interface_->GetTrunkMembers(
-                           node_id_, meta.egress_trunk_id));
-      if (!members.empty()) {
-        for (uint32 member : members) {
-          ASSIGN_OR_RETURN(
-              PortState port_state,
-              bcm_chassis_ro_interface_->GetPortState(node_id_, member));
-          if (port_state == PORT_STATE_UP) {
-            port_id = member;
-            break;
-          }
-        }
-      }
-      if (port_id == 0) {
-        INCREMENT_TX_COUNTER(purpose, tx_drops_down_trunk);
-        return MAKE_ERROR(ERR_INVALID_PARAM)
-               << "Trunk with ID " << meta.egress_trunk_id
-               << " does not have any UP port.";
-      }
-    } else {
-      // TX to regular port. If the port is not up we should discard it.
-      ASSIGN_OR_RETURN(PortState port_state,
-                       bcm_chassis_ro_interface_->GetPortState(
-                           node_id_, meta.egress_port_id));
-      if (port_state != PORT_STATE_UP) {
-        INCREMENT_TX_COUNTER(purpose, tx_drops_down_port);
-        return MAKE_ERROR(ERR_INVALID_PARAM)
-               << "Port with ID " << meta.egress_port_id << " is not UP.";
-      }
-      port_id = meta.egress_port_id;
-    }
-    int* logical_port = gtl::FindOrNull(port_id_to_logical_port_, port_id);
-    if (logical_port == nullptr) {
-      INCREMENT_TX_COUNTER(purpose, tx_drops_unknown_port);
-      return MAKE_ERROR(ERR_INVALID_PARAM)
-             << "Port ID " << port_id
-             << " not found in port_id_to_logical_port_.";
-    }
-    std::string header = "";
-    RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForDirectTx(
-        unit_, *logical_port, meta.cos, intf->smac, packet.payload().size(),
-        &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, true, header,
-                             packet.payload()));
-    INCREMENT_TX_COUNTER(purpose, tx_accepts_direct);
-  } else {
-    std::string header = "";
-    RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForIngressPipelineTx(
-        unit_, intf->smac, packet.payload().size(), &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, false, header,
-                             packet.payload()));
-    INCREMENT_TX_COUNTER(purpose, tx_accepts_ingress_pipeline);
-  }
+  return TransmitPacketBatch(purpose, {&packet});
+}
 
-  return ::util::OkStatus();
+::util::Status BcmPacketioManager::TransmitPackets(
+    GoogleConfig::BcmKnetIntfPurpose purpose,
+    const std::vector<::p4::v1::PacketOut>& packets) {
+  std::vector<const ::p4::v1::PacketOut*> packet_ptrs;
+  packet_ptrs.reserve(packets.size());
+  for (const auto& packet : packets) packet_ptrs.push_back(&packet);
+  return TransmitPacketBatch(purpose, packet_ptrs);
 }
 
 ::util::StatusOr<BcmKnetTxStats> BcmPacketioManager::GetTxStats(
@@ -903,6 +830,9 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   if (intf->tx_sock == -1 || intf->rx_sock == -1) {
     return MAKE_ERROR(ERR_INTERNAL) << "Couldn't create socket.";
   }
+  intf->tx_socket = BcmKnetTxSocket::CreateInstance(
+      intf->tx_sock, intf->netif_index,
+      FLAGS_knet_max_num_packets_to_write_at_once);
 
   // Set Berkeley Packet Filter (BPF) for the socket. The filters here are
   // copied directly from Sandcastle. No need to change anything here.
@@ -1016,6 +946,12 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
         << " does not have a RX socket.";
   }
 
+  // All the buffers used to receive the packets are allocated once here and
+  // reused for all the batches.
+  std::unique_ptr<BcmKnetRxSocket> rx_socket = BcmKnetRxSocket::CreateInstance(
+      rx_sock, bcm_sdk_interface_->GetKnetHeaderSizeForRx(unit_),
+      kMaxRxBufferSize, FLAGS_knet_max_num_packets_to_read_at_once);
+
   // Use the newest linux poll mechanism (epoll) to detect whether we have
   // data to read on the socket.
   struct epoll_event event;
@@ -1030,6 +966,8 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
     return MAKE_ERROR(ERR_INTERNAL)
            << "epoll_ctl() failed. errno: " << errno << ".";
   }
+  std::vector<::p4::v1::PacketIn> packets;
+  packets.reserve(rx_socket->max_batch_size());
   while (true) {
     {
       absl::ReaderMutexLock l(&chassis_lock);
@@ -1044,99 +982,40 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
       INCREMENT_RX_COUNTER(purpose, rx_errors_epoll_wait_failures);
       continue;  // let it retry
     } else if (ret > 0 && pevents[0].events & EPOLLIN) {
-      // We have data to receive. Try to read max of
-      // FLAGS_knet_max_num_packets_to_read_at_once packets before we try to
-      // check for exit criteria.
-      std::vector<::p4::v1::PacketIn> packets;
-      for (int i = 0; i < FLAGS_knet_max_num_packets_to_read_at_once; ++i) {
+      // We have data to receive. Read max of
+      // FLAGS_knet_max_num_packets_to_read_at_once packets with a single
+      // syscall before we try to check for exit criteria. The counters are
+      // collected locally and merged with the RX stats once per batch.
+      BcmKnetRxStats stats;
+      packets.clear();
+      {
         absl::ReaderMutexLock l(&chassis_lock);
         if (shutdown) break;
-        std::string header = "";
-        ::p4::v1::PacketIn packet;
-        ASSIGN_OR_RETURN(bool retry,
-                         RxPacket(purpose, rx_sock, netif_index, &header,
-                                  packet.mutable_payload()));
-        if (!retry) break;
-        if (!header.empty()) {
-          // We received good data. Process it. The parsing errors will not
-          // result in RX thread to shutdown.
-          int ingress_logical_port = 0, egress_logical_port = 0;
-          PacketInMetadata meta;
-          ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
-              unit_, header, &ingress_logical_port, &egress_logical_port,
-              &meta.cos);
-          if (!status.ok()) {
-            VLOG(1) << "Failed to parse KNET header for a packet on unit "
-                    << unit_ << ": " << status.error_message();
-            INCREMENT_RX_COUNTER(purpose, rx_drops_knet_header_parse_error);
-            continue;  // let it retry
-          }
-          // Find ingress port ID.
-          if (ingress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.ingress_port_id = kCpuPortId;
-          } else {
-            uint32* ingress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
-            if (ingress_port_id == nullptr) {
-              VLOG(1) << "Ingress logical port " << ingress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_ingress_port);
-              continue;  // let it retry
-            }
-            meta.ingress_port_id = *ingress_port_id;
-            auto ret = bcm_chassis_ro_interface_->GetParentTrunkId(
-                node_id_, *ingress_port_id);
-            if (ret.ok()) {
-              // If status is OK, there is a parent trunk.
-              meta.ingress_trunk_id = ret.ValueOrDie();
-            }
-          }
-          // Find egress port ID.
-          if (egress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.egress_port_id = kCpuPortId;
-          } else if (egress_logical_port == 1) {
-            // SDKLT sets egress port to 1 for packets that do not match
-            // MY_STATION table or got dropped by the ASIC?
-            // TODO(unknown): check this and decide what to report upwards
-            meta.egress_port_id = 1;
-          } else {
-            uint32* egress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
-            if (egress_port_id == nullptr) {
-              VLOG(1) << "Egress logical port " << egress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_egress_port);
-              continue;  // let it retry
-            }
-            meta.egress_port_id = *egress_port_id;
-          }
-          VLOG(1) << "PacketInMetadata.ingress_port_id: "
-                  << meta.ingress_port_id << "\n"
-                  << "PacketInMetadata.ingress_trunk_id: "
-                  << meta.ingress_trunk_id << "\n"
-                  << "PacketInMetadata.egress_port_id: " << meta.egress_port_id
-                  << "\n"
-                  << "PacketInMetadata.cos: " << meta.cos;
-          status = DeparsePacketInMetadata(meta, &packet);
-          if (!status.ok()) {
-            INCREMENT_RX_COUNTER(purpose, rx_drops_metadata_deparse_error);
-            continue;  // let it retry
+        int num_packets = rx_socket->ReceiveBatch();
+        if (num_packets < 0 && errno != EINTR) {
+          // We retry in case of errors other than EINTR as well.
+          VLOG(1) << "Error when receiving packets on netif  " << netif_index
+                  << " on unit " << unit_ << ": " << errno;
+          stats.rx_errors_internal_read_failures++;
+        }
+        for (int i = 0; i < num_packets; ++i) {
+          ::p4::v1::PacketIn packet;
+          auto ret = ProcessRxFrame(rx_socket->frame(i), netif_index, &packet,
+                                    &stats);
+          if (!ret.ok()) {
+            MergeRxStats(purpose, stats);
+            close(efd);
+            return ret.status();
           }
-          INCREMENT_RX_COUNTER(purpose, rx_accepts);
-          packets.push_back(packet);
+          if (ret.ValueOrDie()) packets.push_back(std::move(packet));
         }
       }
-      // Send the packet to the packet RX writer.
+      MergeRxStats(purpose, stats);
+      // Send the whole batch to the packet RX writer.
       if (!packets.empty()) {
         absl::ReaderMutexLock l(&rx_writer_lock_);
         auto* writer = gtl::FindOrNull(purpose_to_rx_writer_, purpose);
-        if (writer != nullptr) {
-          for (const auto& p : packets) {
-            (*writer)->Write(p);
-          }
-        }
+        if (writer != nullptr) (*writer)->WriteBatch(packets);
       }
     }
   }
@@ -1150,114 +1029,135 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
-::util::StatusOr<bool> BcmPacketioManager::RxPacket(
-    GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int netif_index,
-    std::string* header, std::string* payload) {
-  if (header == nullptr || payload == nullptr) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Null header or payload!";
-  }
-
-  header->clear();
-  payload->clear();
-
-  constexpr size_t kMaxIovLen = 2;
-  struct iovec iov[kMaxIovLen];
-  size_t idx = 0;
-  size_t header_size = bcm_sdk_interface_->GetKnetHeaderSizeForRx(unit_);
-  std::unique_ptr<char[]> header_buffer(new char[header_size]);
-  std::unique_ptr<char[]> payload_buffer(new char[kMaxRxBufferSize]);
-  memset(header_buffer.get(), 0, header_size);
-  memset(payload_buffer.get(), 0, kMaxRxBufferSize);
-
-  iov[idx].iov_base = header_buffer.get();
-  iov[idx].iov_len = header_size;
-  idx++;
-
-  iov[idx].iov_base = payload_buffer.get();
-  iov[idx].iov_len = kMaxRxBufferSize;
-  idx++;
-
-  CHECK_RETURN_IF_FALSE(idx <= kMaxIovLen);  // juts in case. Will never happen
-
-  struct sockaddr_ll sa;
-  memset(&sa, 0, sizeof(sa));
-
-  struct msghdr msg;
-  memset(&msg, 0, sizeof(msg));
-  msg.msg_iov = iov;
-  msg.msg_iovlen = idx;
-  msg.msg_name = &sa;
-  msg.msg_namelen = sizeof(sa);
-
-  ssize_t res = recvmsg(sock, &msg, MSG_DONTWAIT);
-  if (res < 0) {
-    switch (errno) {
-      case EINTR:
-        // Signal received before we could read anything. Need to retry.
-        return true;
-      case EAGAIN:
-        // No data was available. No need to retry before we check for data
-        // available again.
-        return false;
-      default:
-        VLOG(1) << "Error when receiving packet on netif  " << netif_index
-                << " on unit " << unit_ << ": " << errno;
-        INCREMENT_RX_COUNTER(purpose, rx_errors_internal_read_failures);
-        // We retry in case of other errors as well.
-        return true;
-    }
-  } else if (res == 0) {
-    INCREMENT_RX_COUNTER(purpose, rx_errors_sock_shutdown);
+::util::StatusOr<bool> BcmPacketioManager::ProcessRxFrame(
+    const BcmKnetRxFrame& frame, int netif_index, ::p4::v1::PacketIn* packet,
+    BcmKnetRxStats* stats) {
+  if (frame.length == 0) {
+    stats->rx_errors_sock_shutdown++;
     return MAKE_ERROR(ERR_INTERNAL)
            << "Unexpected socket shutdown on netif  " << netif_index
            << " on unit " << unit_ << ".";
   }
 
-  INCREMENT_RX_COUNTER(purpose, all_rx);
-  // res > 0 so cast to size_t is safe.
-  if (static_cast<size_t>(res) < header_size) {
+  stats->all_rx++;
+  if (frame.length < frame.header_size) {
     VLOG(1) << "Num of received bytes on netif  " << netif_index << " on unit "
-            << unit_ << " < " << header_size << ".";
-    INCREMENT_RX_COUNTER(purpose, rx_errors_incomplete_read);
-    return true;
+            << unit_ << " < " << frame.header_size << ".";
+    stats->rx_errors_incomplete_read++;
+    return false;
   }
-  size_t payload_size = static_cast<size_t>(res - header_size);
 
-  // Try to see if the message looks OK. If not retry.
-  if (msg.msg_flags & MSG_TRUNC || sa.sll_ifindex != netif_index ||
-      sa.sll_pkttype == PACKET_OUTGOING) {
+  // Try to see if the message looks OK. If not drop it.
+  if (frame.truncated || frame.ifindex != netif_index ||
+      frame.pkttype == PACKET_OUTGOING) {
     VLOG(1) << "Received invalid packet on netif  " << netif_index
             << " on unit " << unit_ << ".";
-    INCREMENT_RX_COUNTER(purpose, rx_errors_invalid_packet);
-    return true;
+    stats->rx_errors_invalid_packet++;
+    return false;
   }
 
   // Strip some known VLAN tags.
-  struct ether_header* ether_header =
-      reinterpret_cast<struct ether_header*>(payload_buffer.get());
+  const char* payload = frame.payload;
+  size_t payload_size = frame.payload_size;
+  const struct ether_header* ether_header =
+      reinterpret_cast<const struct ether_header*>(payload);
   bool tagged = false;
   if (payload_size >= sizeof(struct ether_header) + kVlanIdSize &&
       ntohs(ether_header->ether_type) == ETHERTYPE_VLAN) {
-    auto* pid = reinterpret_cast<uint16*>(payload_buffer.get() +
-                                          sizeof(struct ether_header));
-    uint16 vlan = ntohs(*pid) & kVlanIdMask;
+    uint16 tci = 0;
+    memcpy(&tci, payload + sizeof(struct ether_header), sizeof(tci));
+    uint16 vlan = ntohs(tci) & kVlanIdMask;
     if (vlan == kDefaultVlan || vlan == kArpVlan) {
       tagged = true;
     }
   }
 
+  std::string* packet_payload = packet->mutable_payload();
   if (tagged) {
-    payload->assign(payload_buffer.get(), ETH_ALEN * 2);
-    payload->append(payload_buffer.get() + ETH_ALEN * 2 + kVlanTagSize,
-                    payload_size - ETH_ALEN * 2 - kVlanTagSize);
+    packet_payload->reserve(payload_size - kVlanTagSize);
+    packet_payload->assign(payload, ETH_ALEN * 2);
+    packet_payload->append(payload + ETH_ALEN * 2 + kVlanTagSize,
+                           payload_size - ETH_ALEN * 2 - kVlanTagSize);
   } else {
-    payload->assign(payload_buffer.get(), payload_size);
+    packet_payload->assign(payload, payload_size);
+  }
+
+  // We received good data. Process it. The parsing errors will not result in
+  // RX thread to shutdown.
+  int ingress_logical_port = 0, egress_logical_port = 0;
+  PacketInMetadata meta;
+  ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
+      unit_, std::string(frame.header, frame.header_size),
+      &ingress_logical_port, &egress_logical_port, &meta.cos);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to parse KNET header for a packet on unit " << unit_
+            << ": " << status.error_message();
+    stats->rx_drops_knet_header_parse_error++;
+    return false;
+  }
+  // Find ingress port ID.
+  if (ingress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.ingress_port_id = kCpuPortId;
+  } else {
+    uint32* ingress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
+    if (ingress_port_id == nullptr) {
+      VLOG(1) << "Ingress logical port " << ingress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      stats->rx_drops_unknown_ingress_port++;
+      return false;
+    }
+    meta.ingress_port_id = *ingress_port_id;
+    auto ret =
+        bcm_chassis_ro_interface_->GetParentTrunkId(node_id_, *ingress_port_id);
+    if (ret.ok()) {
+      // If status is OK, there is a parent trunk.
+      meta.ingress_trunk_id = ret.ValueOrDie();
+    }
+  }
+  // Find egress port ID.
+  if (egress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.egress_port_id = kCpuPortId;
+  } else if (egress_logical_port == 1) {
+    // SDKLT sets egress port to 1 for packets that do not match
+    // MY_STATION table or got dropped by the ASIC?
+    // TODO(unknown): check this and decide what to report upwards
+    meta.egress_port_id = 1;
+  } else {
+    uint32* egress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
+    if (egress_port_id == nullptr) {
+      VLOG(1) << "Egress logical port " << egress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      stats->rx_drops_unknown_egress_port++;
+      return false;
+    }
+    meta.egress_port_id = *egress_port_id;
+  }
+  VLOG(1) << "PacketInMetadata.ingress_port_id: " << meta.ingress_port_id
+          << "\n"
+          << "PacketInMetadata.ingress_trunk_id: " << meta.ingress_trunk_id
+          << "\n"
+          << "PacketInMetadata.egress_port_id: " << meta.egress_port_id << "\n"
+          << "PacketInMetadata.cos: " << meta.cos;
+  status = DeparsePacketInMetadata(meta, packet);
+  if (!status.ok()) {
+    stats->rx_drops_metadata_deparse_error++;
+    return false;
   }
-  header->assign(header_buffer.get(), header_size);
+  stats->rx_accepts++;
 
   return true;
 }
 
+void BcmPacketioManager::MergeRxStats(GoogleConfig::BcmKnetIntfPurpose purpose,
+                                      const BcmKnetRxStats& stats) {
+  absl::WriterMutexLock l(&rx_stats_lock_);
+  purpose_to_rx_stats_[purpose] += stats;
+}
+
 ::util::Status BcmPacketioManager::DeparsePacketInMetadata(
     const PacketInMetadata& meta, ::p4::v1::PacketIn* packet) {
   // Note: We are down-casting to uint32 for the port/trunk IDs in this method.
@@ -1333,70 +1233,205 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
-::util::Status BcmPacketioManager::TxPacket(
-    GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int vlan,
-    int netif_index, bool direct_tx, const std::string& header,
-    const std::string& payload) {
-  CHECK_RETURN_IF_FALSE(payload.length() >= sizeof(struct ether_header));
-
-  constexpr size_t kMaxIovLen = 4;
-  struct iovec iov[kMaxIovLen];
-  size_t idx = 0;       // points to the current iov being filled up
-  ssize_t tot_len = 0;  // total packet size to be transmitted
-  memset(&iov, 0, sizeof(iov));
-
-  iov[idx].iov_base = const_cast<char*>(header.data());
-  iov[idx].iov_len = header.length();
-  tot_len += iov[idx].iov_len;
-  idx++;
-  // Add payload without caring about (missing) VLAN tags.
-  iov[idx].iov_base = const_cast<char*>(payload.data());
-  iov[idx].iov_len = payload.length();
-  tot_len += iov[idx].iov_len;
-  idx++;
-
-  CHECK_RETURN_IF_FALSE(idx <= kMaxIovLen);  // just in case. Will never happen
-
-  // Here sa.sll_addr is left zeroed out, matching what's in rcpu_hdr.
-  struct sockaddr_ll sa;
-  memset(&sa, 0, sizeof(sa));
-  sa.sll_family = AF_PACKET;
-  sa.sll_ifindex = netif_index;
-  sa.sll_halen = ETH_ALEN;
-
-  struct msghdr msg;
-  memset(&msg, 0, sizeof(msg));
-  msg.msg_iov = iov;
-  msg.msg_iovlen = idx;
-  msg.msg_name = &sa;
-  msg.msg_namelen = sizeof(sa);
-
-  while (1) {
-    int res = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
-    if (res < 0) {
-      switch (errno) {
-        case EINTR:
-          // signal received before we could transmit anything. Need to retry.
-          continue;
-        default:
-          INCREMENT_TX_COUNTER(purpose, tx_errors_internal_send_failures);
-          return MAKE_ERROR(ERR_INTERNAL)
-                 << "Error when transmitting packet to netif " << netif_index
-                 << " on unit " << unit_ << ": " << errno;
+::util::Status BcmPacketioManager::TransmitPacketBatch(
+    GoogleConfig::BcmKnetIntfPurpose purpose,
+    const std::vector<const ::p4::v1::PacketOut*>& packets) {
+  ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
+  CHECK_RETURN_IF_FALSE(intf->tx_sock > 0 && intf->tx_socket != nullptr)
+      << "KNET interface with purpose "
+      << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
+      << node_id_ << " mapped to unit " << unit_
+      << " does not have a TX socket.";  // MUST NOT HAPPEN!
+
+  // The counters are collected locally and merged with the TX stats of the
+  // KNET intf once for the whole batch.
+  BcmKnetTxStats stats;
+  ::util::Status status = ::util::OkStatus();
+
+  // First find where each packet needs to go and get its KNET header. The
+  // packets which cannot be sent are skipped.
+  std::vector<PreparedTxPacket> prepared_packets;
+  prepared_packets.reserve(packets.size());
+  for (const auto* packet : packets) {
+    stats.all_tx++;
+    PreparedTxPacket prepared;
+    ::util::Status error = PrepareTxPacket(*intf, *packet, &prepared, &stats);
+    if (!error.ok()) {
+      APPEND_STATUS_IF_ERROR(status, error);
+      continue;
+    }
+    prepared_packets.push_back(std::move(prepared));
+  }
+
+  // Then send all the packets. The frames point to the prepared headers and
+  // the payloads given by the controller, i.e. the payloads are not copied.
+  std::vector<BcmKnetTxFrame> frames;
+  frames.reserve(prepared_packets.size());
+  for (const auto& prepared : prepared_packets) {
+    frames.emplace_back(prepared.header, *prepared.payload);
+  }
+  std::vector<ssize_t> results;
+  intf->tx_socket->SendBatch(frames, &results);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const ssize_t tot_len = frames[i].header_size + frames[i].payload_size;
+    if (results[i] < 0) {
+      stats.tx_errors_internal_send_failures++;
+      ::util::Status error =
+          MAKE_ERROR(ERR_INTERNAL)
+          << "Error when transmitting packet to netif " << intf->netif_index
+          << " on unit " << unit_ << ": " << -results[i];
+      APPEND_STATUS_IF_ERROR(status, error);
+    } else if (results[i] != tot_len) {
+      stats.tx_errors_incomplete_send++;
+      ::util::Status error =
+          MAKE_ERROR(ERR_INTERNAL)
+          << "Incomplete packet transmit on netif  " << intf->netif_index
+          << " on unit " << unit_ << " (" << results[i] << " != " << tot_len
+          << ").";
+      APPEND_STATUS_IF_ERROR(status, error);
+    } else if (prepared_packets[i].direct_tx) {
+      stats.tx_accepts_direct++;
+    } else {
+      stats.tx_accepts_ingress_pipeline++;
+    }
+  }
+  MergeTxStats(purpose, stats);
+
+  return status;
+}
+
+::util::Status BcmPacketioManager::PrepareTxPacket(
+    const BcmKnetIntf& intf, const ::p4::v1::PacketOut& packet,
+    PreparedTxPacket* prepared, BcmKnetTxStats* stats) {
+  // Try to find the port/cos to send the packet to. Also find out if we need to
+  // send the packet to ingress pipeline.
+  PacketOutMetadata meta;
+  ::util::Status status = ParsePacketOutMetadata(packet, &meta);
+  if (!status.ok()) {
+    stats->tx_drops_metadata_parse_error++;
+  }
+  VLOG(1) << "PacketOutMetadata.egress_port_id: " << meta.egress_port_id << "\n"
+          << "PacketOutMetadata.egress_trunk_id: " << meta.egress_trunk_id
+          << "\n"
+          << "PacketOutMetadata.cos: " << meta.cos << "\n"
+          << "PacketOutMetadata.use_ingress_pipeline: "
+          << meta.use_ingress_pipeline;
+
+  // Now try to find where to send the packet. There are several cases:
+  // 1- Direct packet to physical port.
+  // 2- Direct packet to trunk port. In this case we send the packet to the
+  //    first member of the trunk which is up.
+  // 3- Packet to ingress pipeline.
+  if (!meta.use_ingress_pipeline) {
+    uint32 port_id = 0;
+    if (meta.egress_trunk_id > 0) {
+      // TX to trunk. Select the first member of the trunk which is up.
+      ASSIGN_OR_RETURN(const std::set<uint32>& members,
+                       bcm_chassis_ro_interface_->GetTrunkMembers(
+                           node_id_, meta.egress_trunk_id));
+      if (!members.empty()) {
+        for (uint32 member : members) {
+          ASSIGN_OR_RETURN(
+              PortState port_state,
+              bcm_chassis_ro_interface_->GetPortState(node_id_, member));
+          if (port_state == PORT_STATE_UP) {
+            port_id = member;
+            break;
+          }
+        }
       }
-    } else if (res != tot_len) {
-      INCREMENT_TX_COUNTER(purpose, tx_errors_incomplete_send);
-      return MAKE_ERROR(ERR_INTERNAL)
-             << "Incomplete packet transmit on netif  " << netif_index
-             << " on unit " << unit_ << " (" << res << " != " << tot_len
-             << ").";
+      if (port_id == 0) {
+        stats->tx_drops_down_trunk++;
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Trunk with ID " << meta.egress_trunk_id
+               << " does not have any UP port.";
+      }
+    } else {
+      // TX to regular port. If the port is not up we should discard it.
+      ASSIGN_OR_RETURN(PortState port_state,
+                       bcm_chassis_ro_interface_->GetPortState(
+                           node_id_, meta.egress_port_id));
+      if (port_state != PORT_STATE_UP) {
+        stats->tx_drops_down_port++;
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Port with ID " << meta.egress_port_id << " is not UP.";
+      }
+      port_id = meta.egress_port_id;
+    }
+    const int* logical_port = gtl::FindOrNull(port_id_to_logical_port_, port_id);
+    if (logical_port == nullptr) {
+      stats->tx_drops_unknown_port++;
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Port ID " << port_id
+             << " not found in port_id_to_logical_port_.";
     }
-    break;
+    RETURN_IF_ERROR(GetKnetTxHeader(intf, *logical_port, meta.cos,
+                                    packet.payload().size(),
+                                    &prepared->header));
+    prepared->direct_tx = true;
+  } else {
+    RETURN_IF_ERROR(GetKnetTxHeader(intf, -1, meta.cos,
+                                    packet.payload().size(),
+                                    &prepared->header));
+    prepared->direct_tx = false;
   }
+  CHECK_RETURN_IF_FALSE(packet.payload().length() >=
+                        sizeof(struct ether_header));
+  prepared->payload = &packet.payload();
 
   return ::util::OkStatus();
 }
 
+::util::Status BcmPacketioManager::GetKnetTxHeader(const BcmKnetIntf& intf,
+                                                   int logical_port, int cos,
+                                                   size_t payload_size,
+                                                   std::string* header) {
+  // The CoS is not used for packets sent to ingress pipeline.
+  if (logical_port < 0) cos = 0;
+  const auto key = std::make_tuple(intf.smac, logical_port, cos);
+  std::shared_ptr<const std::string> cached_header = nullptr;
+  {
+    absl::ReaderMutexLock l(&tx_header_cache_lock_);
+    const auto* lookup = gtl::FindOrNull(tx_header_cache_, key);
+    if (lookup != nullptr) cached_header = *lookup;
+  }
+
+  if (cached_header == nullptr) {
+    std::string new_header = "";
+    if (logical_port >= 0) {
+      RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForDirectTx(
+          unit_, logical_port, cos, intf.smac, 0, &new_header));
+    } else {
+      RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForIngressPipelineTx(
+          unit_, intf.smac, 0, &new_header));
+    }
+    cached_header = std::make_shared<const std::string>(std::move(new_header));
+    if (FLAGS_knet_tx_header_cache_size > 0) {
+      absl::WriterMutexLock l(&tx_header_cache_lock_);
+      if (tx_header_cache_.size() >=
+          static_cast<size_t>(FLAGS_knet_tx_header_cache_size)) {
+        tx_header_cache_.clear();
+      }
+      tx_header_cache_[key] = cached_header;
+    }
+  }
+  *header = *cached_header;
+
+  return bcm_sdk_interface_->SetKnetHeaderPacketLength(unit_, payload_size,
+                                                       header);
+}
+
+void BcmPacketioManager::ClearKnetTxHeaderCache() {
+  absl::WriterMutexLock l(&tx_header_cache_lock_);
+  tx_header_cache_.clear();
+}
+
+void BcmPacketioManager::MergeTxStats(GoogleConfig::BcmKnetIntfPurpose purpose,
+                                      const BcmKnetTxStats& stats) {
+  absl::WriterMutexLock l(&tx_stats_lock_);
+  purpose_to_tx_stats_[purpose] += stats;
+}
+
 ::util::Status BcmPacketioManager::ParsePacketOutMetadata(
     const ::p4::v1::PacketOut& packet, PacketOutMetadata* meta) {
   meta->cos = kDefaultCos;  // default
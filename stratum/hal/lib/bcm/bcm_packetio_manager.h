@@ -29,11 +29,13 @@
 #include <memory>
 #include <string>
 #include <set>
+#include <tuple>
 
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_interface.h"
 #include "stratum/hal/lib/bcm/bcm_global_vars.h"
+#include "stratum/hal/lib/bcm/bcm_knet_socket.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
 #include "stratum/hal/lib/bcm/constants.h"
 #include "stratum/hal/lib/common/writer_interface.h"
@@ -100,6 +102,18 @@ struct BcmKnetTxStats {
         tx_drops_unknown_port(0),
         tx_drops_down_port(0),
         tx_drops_down_trunk(0) {}
+  BcmKnetTxStats& operator+=(const BcmKnetTxStats& other) {
+    all_tx += other.all_tx;
+    tx_accepts_ingress_pipeline += other.tx_accepts_ingress_pipeline;
+    tx_accepts_direct += other.tx_accepts_direct;
+    tx_errors_internal_send_failures += other.tx_errors_internal_send_failures;
+    tx_errors_incomplete_send += other.tx_errors_incomplete_send;
+    tx_drops_metadata_parse_error += other.tx_drops_metadata_parse_error;
+    tx_drops_unknown_port += other.tx_drops_unknown_port;
+    tx_drops_down_port += other.tx_drops_down_port;
+    tx_drops_down_trunk += other.tx_drops_down_trunk;
+    return *this;
+  }
   std::string ToString() const {
     return absl::StrCat(
         "(all_tx:", all_tx,
@@ -153,6 +167,20 @@ struct BcmKnetRxStats {
         rx_drops_metadata_deparse_error(0),
         rx_drops_unknown_ingress_port(0),
         rx_drops_unknown_egress_port(0) {}
+  BcmKnetRxStats& operator+=(const BcmKnetRxStats& other) {
+    all_rx += other.all_rx;
+    rx_accepts += other.rx_accepts;
+    rx_errors_epoll_wait_failures += other.rx_errors_epoll_wait_failures;
+    rx_errors_internal_read_failures += other.rx_errors_internal_read_failures;
+    rx_errors_sock_shutdown += other.rx_errors_sock_shutdown;
+    rx_errors_incomplete_read += other.rx_errors_incomplete_read;
+    rx_errors_invalid_packet += other.rx_errors_invalid_packet;
+    rx_drops_knet_header_parse_error += other.rx_drops_knet_header_parse_error;
+    rx_drops_metadata_deparse_error += other.rx_drops_metadata_deparse_error;
+    rx_drops_unknown_ingress_port += other.rx_drops_unknown_ingress_port;
+    rx_drops_unknown_egress_port += other.rx_drops_unknown_egress_port;
+    return *this;
+  }
   std::string ToString() const {
     return absl::StrCat(
         "(all_rx:", all_rx, ", rx_accepts:", rx_accepts,
@@ -193,6 +221,8 @@ struct BcmKnetIntf {
   std::set<int> filter_ids;
   // TX socket fd.
   int tx_sock;
+  // Batched writer for tx_sock. Created together with tx_sock.
+  std::shared_ptr<BcmKnetTxSocket> tx_socket;
   // RX socket fd.
   int rx_sock;
   // The ID of the RX thread which is in charge of receiving the packets.
@@ -207,6 +237,7 @@ struct BcmKnetIntf {
         smac(0),
         filter_ids(),
         tx_sock(-1),
+        tx_socket(nullptr),
         rx_sock(-1),
         rx_thread_id(0) {}
 };
@@ -299,7 +330,17 @@ class BcmPacketioManager {
   // application (given by 'purpose') on the node which this class is mapped to.
   virtual ::util::Status TransmitPacket(
       GoogleConfig::BcmKnetIntfPurpose purpose,
-      const ::p4::v1::PacketOut& packet);
+      const ::p4::v1::PacketOut& packet) LOCKS_EXCLUDED(tx_stats_lock_);
+
+  // Transmits a batch of packets to the KNET interface which is created for a
+  // specific application (given by 'purpose'). All the packets which can be
+  // sent are written to the socket with a minimum num of sendmmsg() calls. A
+  // packet which cannot be sent does not stop the rest of the batch, and the
+  // returned status aggregates the errors for all the failed packets.
+  virtual ::util::Status TransmitPackets(
+      GoogleConfig::BcmKnetIntfPurpose purpose,
+      const std::vector<::p4::v1::PacketOut>& packets)
+      LOCKS_EXCLUDED(tx_stats_lock_);
 
   // Return copies of BcmKnetTxStats/BcmKnetRxStats for a given purpose
   // respectively. Returns error if the given purpose is not found in the
@@ -407,12 +448,22 @@ class BcmPacketioManager {
       GoogleConfig::BcmKnetIntfPurpose purpose)
       LOCKS_EXCLUDED(chassis_lock, rx_writer_lock_);
 
-  // Helper called by HandleKnetIntfPacketRx() to read one single full message
-  // from a socket. Returns true if we need to retry the receive and false if
-  // otherwise. If any non-recoverable error is encountered, returns error.
-  ::util::StatusOr<bool> RxPacket(GoogleConfig::BcmKnetIntfPurpose purpose,
-                                  int sock, int netif_index,
-                                  std::string* header, std::string* payload);
+  // Helper called by HandleKnetIntfPacketRx() to process one single packet
+  // read from the RX socket of the KNET interface with the given netif_index.
+  // Returns true and fills in the given PacketIn if the packet needs to be sent
+  // to the controller, or false if the packet was dropped. The RX counters are
+  // incremented in the given 'stats', which are local to the RX thread and
+  // merged with the RX stats of the KNET interface once per batch. Returns
+  // error if the socket was shut down.
+  ::util::StatusOr<bool> ProcessRxFrame(const BcmKnetRxFrame& frame,
+                                        int netif_index,
+                                        ::p4::v1::PacketIn* packet,
+                                        BcmKnetRxStats* stats);
+
+  // Adds the RX counters collected by an RX thread to the RX stats of the
+  // KNET interface with the given purpose.
+  void MergeRxStats(GoogleConfig::BcmKnetIntfPurpose purpose,
+                    const BcmKnetRxStats& stats) LOCKS_EXCLUDED(rx_stats_lock_);
 
   // Deparses the given PacketInMetadata to the a set of
   // P4 PacketMetadata protos in the given P4 PacketIn which
@@ -423,11 +474,52 @@ class BcmPacketioManager {
   ::util::Status DeparsePacketOutMetadata(const PacketOutMetadata& meta,
                                           ::p4::v1::PacketOut* packet);
 
-  // Helper called by TransmitPacket() to send packet (KNET headers + payload).
-  ::util::Status TxPacket(GoogleConfig::BcmKnetIntfPurpose purpose, int sock,
-                          int vlan, int netif_index, bool direct_tx,
-                          const std::string& header,
-                          const std::string& payload);
+  // A PacketOut which is ready to be sent on a KNET interface TX socket.
+  struct PreparedTxPacket {
+    // The KNET header, copied from the TX header cache with the length of the
+    // payload set.
+    std::string header;
+    // The payload of the PacketOut given by the controller (not owned).
+    const std::string* payload;
+    // True if the packet is sent directly to a port, false if it is sent to
+    // the ingress pipeline.
+    bool direct_tx;
+    PreparedTxPacket() : header(), payload(nullptr), direct_tx(false) {}
+  };
+
+  // Helper called by TransmitPacket() and TransmitPackets() to send a batch of
+  // packets on the KNET interface with the given purpose.
+  ::util::Status TransmitPacketBatch(
+      GoogleConfig::BcmKnetIntfPurpose purpose,
+      const std::vector<const ::p4::v1::PacketOut*>& packets)
+      LOCKS_EXCLUDED(tx_stats_lock_);
+
+  // Helper called by TransmitPacketBatch() to find where the given packet needs
+  // to be sent and get its KNET header. The TX counters are incremented in
+  // the given 'stats', which are merged with the TX stats of the KNET
+  // interface once per batch.
+  ::util::Status PrepareTxPacket(const BcmKnetIntf& intf,
+                                 const ::p4::v1::PacketOut& packet,
+                                 PreparedTxPacket* prepared,
+                                 BcmKnetTxStats* stats);
+
+  // Fills the KNET header for a packet with the given payload size sent from
+  // the given KNET interface directly to the given logical port and CoS, or to
+  // the ingress pipeline if logical_port is negative. The headers are cached
+  // per smac of the KNET interface, logical port and CoS, and the payload size
+  // is set in a copy of the cached header.
+  ::util::Status GetKnetTxHeader(const BcmKnetIntf& intf, int logical_port,
+                                 int cos, size_t payload_size,
+                                 std::string* header)
+      LOCKS_EXCLUDED(tx_header_cache_lock_);
+
+  // Clears the TX header cache. Called when the port mappings change.
+  void ClearKnetTxHeaderCache() LOCKS_EXCLUDED(tx_header_cache_lock_);
+
+  // Adds the TX counters collected for a batch of packets to the TX stats of
+  // the KNET interface with the given purpose.
+  void MergeTxStats(GoogleConfig::BcmKnetIntfPurpose purpose,
+                    const BcmKnetTxStats& stats) LOCKS_EXCLUDED(tx_stats_lock_);
 
   // Parses the P4 PacketMetadata protos in the given P4 PacketOut and
   // fills in the given PacketOutMetadata proto, which is then used to transmit
@@ -460,6 +552,9 @@ class BcmPacketioManager {
   // Mutex lock for protecting the purpose_to_rx_stats_ map.
   mutable absl::Mutex rx_stats_lock_;
 
+  // Mutex lock for protecting the tx_header_cache_ map.
+  mutable absl::Mutex tx_header_cache_lock_;
+
   // Map from KNET interface purpose (specifying which application will use the
   // interface, e.g. controller, sflow, etc.) to the BcmKnetIntf instance
   // encapsulating the settings for that KNET interface. Each node can only
@@ -516,6 +611,16 @@ class BcmPacketioManager {
   std::map<GoogleConfig::BcmKnetIntfPurpose, BcmKnetRxStats>
       purpose_to_rx_stats_ GUARDED_BY(rx_stats_lock_);
 
+  // Cache of the KNET headers used for TX, keyed by (smac, logical_port, cos),
+  // where smac is the one of the sending KNET interface and logical_port is
+  // -1 for packets sent to the ingress pipeline. The cached headers are built
+  // for an empty payload; the packet length is set on a copy for each packet.
+  // The cache is cleared on each config push and whenever it grows beyond
+  // FLAGS_knet_tx_header_cache_size entries.
+  absl::flat_hash_map<std::tuple<uint64, int, int>,
+                      std::shared_ptr<const std::string>>
+      tx_header_cache_ GUARDED_BY(tx_header_cache_lock_);
+
   // Pointer to BcmChassisRoInterface class to get the most updated node & port
   // maps after the config is pushed.
   BcmChassisRoInterface* bcm_chassis_ro_interface_;  // not owned by this class.
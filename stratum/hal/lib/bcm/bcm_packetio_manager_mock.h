@@ -20,6 +20,7 @@
 #define STRATUM_HAL_LIB_BCM_BCM_PACKETIO_MANAGER_MOCK_H_
 
 #include <memory>
+#include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_packetio_manager.h"
 #include "gmock/gmock.h"
@@ -49,6 +50,9 @@ class BcmPacketioManagerMock : public BcmPacketioManager {
   MOCK_METHOD2(TransmitPacket,
                ::util::Status(GoogleConfig::BcmKnetIntfPurpose purpose,
                               const ::p4::v1::PacketOut& packet));
+  MOCK_METHOD2(TransmitPackets,
+               ::util::Status(GoogleConfig::BcmKnetIntfPurpose purpose,
+                              const std::vector<::p4::v1::PacketOut>& packets));
 };
 
 }  // namespace bcm
@@ -17,6 +17,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_mock.h"
@@ -43,6 +44,7 @@ using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
+using ::testing::ReturnArg;
 using ::testing::SetArgPointee;
 using ::testing::WithArgs;
 
@@ -59,6 +61,18 @@ MATCHER_P(EqualsStatus, status, "") {
 
 namespace {
 
+// Fakes a sendmmsg() call which sends all the given messages completely.
+int SendAllMmsgs(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+                 int flags) {
+  for (unsigned int i = 0; i < vlen; ++i) {
+    msgvec[i].msg_len = 0;
+    for (size_t j = 0; j < msgvec[i].msg_hdr.msg_iovlen; ++j) {
+      msgvec[i].msg_len += msgvec[i].msg_hdr.msg_iov[j].iov_len;
+    }
+  }
+  return vlen;
+}
+
 class LibcProxyMock : public PassthroughLibcProxy {
  public:
   ~LibcProxyMock() override {}
@@ -97,9 +111,17 @@ class LibcProxyMock : public PassthroughLibcProxy {
   ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) override {
     return SendMsg(sockfd, msg, flags);
   }
+  int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+               int flags) override {
+    return SendMmsg(sockfd, msgvec, vlen, flags);
+  }
   ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) override {
     return RecvMsg(sockfd, msg, flags);
   }
+  int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags,
+               struct timespec* timeout) override {
+    return RecvMmsg(sockfd, msgvec, vlen, flags, timeout);
+  }
   int epoll_create1(int flags) override { return EpollCreate1(flags); }
   int epoll_ctl(int efd, int op, int fd, struct epoll_event* event) override {
     return EpollCtl(efd, op, fd, event);
@@ -123,7 +145,12 @@ class LibcProxyMock : public PassthroughLibcProxy {
                          socklen_t addrlen));
   MOCK_METHOD3(SendMsg,
                ssize_t(int sockfd, const struct msghdr* msg, int flags));
+  MOCK_METHOD4(SendMmsg, int(int sockfd, struct mmsghdr* msgvec,
+                             unsigned int vlen, int flags));
   MOCK_METHOD3(RecvMsg, ssize_t(int sockfd, struct msghdr* msg, int flags));
+  MOCK_METHOD5(RecvMmsg, int(int sockfd, struct mmsghdr* msgvec,
+                             unsigned int vlen, int flags,
+                             struct timespec* timeout));
   MOCK_METHOD1(EpollCreate1, int(int flags));
   MOCK_METHOD4(EpollCtl,
                int(int efd, int op, int fd, struct epoll_event* event));
@@ -1255,12 +1282,16 @@ TEST_P(BcmPacketioManagerTest,
                               p[0].events = EPOLLIN;
                             })),
                             Return(1)));  // 1 means RX packet is available
-  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMsg(kSocket1, _, _))
-      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct msghdr* msg) {
-                              // Any modification to msg goes here. Not needed
-                              // At the moment.
+  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMmsg(kSocket1, _, _, _, _))
+      .WillRepeatedly(DoAll(WithArgs<1, 2>(Invoke([](struct mmsghdr* msgvec,
+                                                     unsigned int vlen) {
+                              // Fill up the whole batch.
+                              for (unsigned int i = 0; i < vlen; ++i) {
+                                msgvec[i].msg_len =
+                                    kTestKnetHeaderSize + kTestPacketBodySize;
+                              }
                             })),
-                            Return(kTestKnetHeaderSize + kTestPacketBodySize)));
+                            ReturnArg<2>()));  // the whole batch was read
 
   // BcmSdkInterface calls triggered by RX thread.
   EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit1))
@@ -1441,12 +1472,16 @@ TEST_P(BcmPacketioManagerTest,
                               p[0].events = EPOLLIN;
                             })),
                             Return(1)));  // 1 means RX packet is available
-  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMsg(kSocket1, _, _))
-      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct msghdr* msg) {
-                              // Any modification to msg goes here. Not needed
-                              // At the moment.
+  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMmsg(kSocket1, _, _, _, _))
+      .WillRepeatedly(DoAll(WithArgs<1, 2>(Invoke([](struct mmsghdr* msgvec,
+                                                     unsigned int vlen) {
+                              // Fill up the whole batch.
+                              for (unsigned int i = 0; i < vlen; ++i) {
+                                msgvec[i].msg_len =
+                                    kTestKnetHeaderSize + kTestPacketBodySize;
+                              }
                             })),
-                            Return(kTestKnetHeaderSize + kTestPacketBodySize)));
+                            ReturnArg<2>()));  // the whole batch was read
 
   // BcmSdkInterface calls triggered by RX thread.
   EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit1))
@@ -1761,11 +1796,16 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
                       Return(::util::OkStatus())));
   EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, kPortId1))
       .WillOnce(Return(PORT_STATE_UP));
+  // The cached header is built for an empty payload, and the payload size is
+  // set on the copy used for the packet.
   EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderForDirectTx(kUnit1, kLogicalPort1,
-                                                       kDefaultCos, _, _, _))
+                                                       kDefaultCos, _, 0, _))
       .WillOnce(Return(::util::OkStatus()));
-  EXPECT_CALL(*LibcProxyMock::Instance(), SendMsg(kSocket1, _, _))
-      .WillOnce(Return(64));  // 64 is tot_len of the packet.
+  EXPECT_CALL(*bcm_sdk_mock_,
+              SetKnetHeaderPacketLength(kUnit1, packet.payload().size(), _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMmsg(kSocket1, _, 1, _))
+      .WillOnce(Invoke(SendAllMmsgs));
 
   ASSERT_OK(
       TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
@@ -1806,11 +1846,15 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
       .WillOnce(Return(std::set<uint32>({kPortId1, kPortId2})));
   EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, kPortId1))
       .WillOnce(Return(PORT_STATE_UP));
+  // The KNET header for the port was cached when sending the previous packet.
   EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderForDirectTx(kUnit1, kLogicalPort1,
                                                        kDefaultCos, _, _, _))
+      .Times(0);
+  EXPECT_CALL(*bcm_sdk_mock_,
+              SetKnetHeaderPacketLength(kUnit1, packet.payload().size(), _))
       .WillOnce(Return(::util::OkStatus()));
-  EXPECT_CALL(*LibcProxyMock::Instance(), SendMsg(kSocket1, _, _))
-      .WillOnce(Return(64));  // 64 is tot_len of the packet.
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMmsg(kSocket1, _, 1, _))
+      .WillOnce(Invoke(SendAllMmsgs));
 
   ASSERT_OK(
       TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
@@ -1882,10 +1926,13 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
   // 6- A packet sent to ingress pipeline
   packet.clear_metadata();  // no metadata will send packet to ingress pipeline
   EXPECT_CALL(*bcm_sdk_mock_,
-              GetKnetHeaderForIngressPipelineTx(kUnit1, _, _, _))
+              GetKnetHeaderForIngressPipelineTx(kUnit1, _, 0, _))
       .WillOnce(Return(::util::OkStatus()));
-  EXPECT_CALL(*LibcProxyMock::Instance(), SendMsg(kSocket1, _, _))
-      .WillOnce(Return(64));  // 64 is tot_len of the packet.
+  EXPECT_CALL(*bcm_sdk_mock_,
+              SetKnetHeaderPacketLength(kUnit1, packet.payload().size(), _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMmsg(kSocket1, _, 1, _))
+      .WillOnce(Invoke(SendAllMmsgs));
 
   ASSERT_OK(
       TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
@@ -1913,6 +1960,37 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
                               tx_drops_down_trunk);
   }
 
+  // 7- A batch of packets sent to ingress pipeline. All the packets are sent
+  // with a single sendmmsg() call, reusing the cached KNET header even for
+  // packets of another size.
+  std::vector<::p4::v1::PacketOut> packets(3, packet);
+  packets[2].mutable_payload()->append("extra");
+  EXPECT_CALL(*bcm_sdk_mock_,
+              GetKnetHeaderForIngressPipelineTx(kUnit1, _, _, _))
+      .Times(0);
+  EXPECT_CALL(*bcm_sdk_mock_,
+              SetKnetHeaderPacketLength(kUnit1, packet.payload().size(), _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              SetKnetHeaderPacketLength(kUnit1, packets[2].payload().size(), _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMmsg(kSocket1, _, 3, _))
+      .WillOnce(Invoke(SendAllMmsgs));
+
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    ASSERT_OK(bcm_packetio_manager_->TransmitPackets(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packets));
+  }
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    ASSERT_OK_AND_ASSIGN(auto tx_stats,
+                         bcm_packetio_manager_->GetTxStats(
+                             GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER));
+    EXPECT_EQ(4, tx_stats.tx_accepts_ingress_pipeline);
+  }
+
   //--------------------------------------------------------------
   // Shutdown
   //--------------------------------------------------------------
@@ -0,0 +1,1510 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_sdk_fake.h"
+
+#include <algorithm>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/common/constants.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+// Size of the fake KNET headers. The headers are all zeros, except for the
+// port and cos saved in the RX headers.
+constexpr size_t kKnetHeaderSize = 32;
+
+// Waits for the given duration. Short waits spin instead of sleeping, as the
+// sleep granularity is coarser than the latency of most SDK calls, which are
+// a few microseconds. Like the SDK, a spinning call keeps its CPU busy.
+void Wait(absl::Duration duration) {
+  if (duration <= absl::ZeroDuration()) return;
+  if (duration >= absl::Milliseconds(1)) {
+    absl::SleepFor(duration);
+    return;
+  }
+  const absl::Time deadline = absl::Now() + duration;
+  while (absl::Now() < deadline) {
+  }
+}
+
+// Normalizes a VLAN given to the SDK, where 0 stands for the default VLAN.
+int NormalizeVlan(int vlan) { return vlan == 0 ? kDefaultVlan : vlan; }
+
+}  // namespace
+
+constexpr int BcmSdkFake::kFirstEgressIntfId;
+constexpr int BcmSdkFake::kFirstEcmpEgressIntfId;
+
+BcmSdkFake::BcmSdkFake()
+    : call_latency_(absl::ZeroDuration()),
+      method_to_call_latency_(),
+      method_to_injected_failures_(),
+      method_to_call_count_(),
+      unit_to_state_(),
+      linkscan_event_writers_() {}
+
+BcmSdkFake::~BcmSdkFake() {}
+
+::util::Status BcmSdkFake::InitializeSdk(
+    const std::string& config_file_path,
+    const std::string& config_flush_file_path,
+    const std::string& bcm_shell_log_file_path) {
+  return SimulateCall(__func__);
+}
+
+::util::Status BcmSdkFake::FindUnit(int unit, int pci_bus, int pci_slot,
+                                    BcmChip::BcmChipType chip_type) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  CHECK_RETURN_IF_FALSE(unit >= 0) << "Invalid unit " << unit << ".";
+  if (unit_to_state_.count(unit)) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS) << "Unit " << unit << " already found.";
+  }
+  unit_to_state_[unit];
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::InitializeUnit(int unit, bool warm_boot) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->initialized = true;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::ShutdownUnit(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  RETURN_IF_ERROR(GetUnitState(unit).status());
+  unit_to_state_.erase(unit);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::ShutdownAllUnits() {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  unit_to_state_.clear();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetModuleId(int unit, int module) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->module = module;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::InitializePort(int unit, int port) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->port_to_options[port] = BcmPortOptions();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetPortOptions(int unit, int port,
+                                          const BcmPortOptions& options) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  // Like in the SDK, only the options which are set are changed.
+  state->port_to_options[port].MergeFrom(options);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetPortOptions(int unit, int port,
+                                          BcmPortOptions* options) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(options != nullptr) << "Null options.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  const BcmPortOptions* port_options =
+      gtl::FindOrNull(state->port_to_options, port);
+  if (port_options == nullptr) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Port " << port << " not initialized on unit " << unit << ".";
+  }
+  *options = *port_options;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetPortCounters(int unit, int port,
+                                           PortCounters* pc) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(pc != nullptr) << "Null port counters.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  CHECK_RETURN_IF_FALSE(state->port_to_options.count(port))
+      << "Port " << port << " not initialized on unit " << unit << ".";
+  pc->Clear();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetPortCountersBatch(
+    int unit, const std::vector<int>& ports, std::vector<PortCounters>* pcs) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(pcs != nullptr) << "Null port counters.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  for (int port : ports) {
+    CHECK_RETURN_IF_FALSE(state->port_to_options.count(port))
+        << "Port " << port << " not initialized on unit " << unit << ".";
+  }
+  pcs->clear();
+  pcs->resize(ports.size());
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::StartDiagShellServer() {
+  return SimulateCall(__func__);
+}
+
+::util::Status BcmSdkFake::StartLinkscan(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->linkscan_started = true;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::StopLinkscan(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->linkscan_started = false;
+  return ::util::OkStatus();
+}
+
+void BcmSdkFake::OnLinkscanEvent(int unit, int port, PortState linkstatus) {
+  SimulateCall(__func__).IgnoreError();
+  LinkscanEvent event = {unit, port, linkstatus};
+  absl::ReaderMutexLock l(&linkscan_writers_lock_);
+  // Invoke the Writers based on priority.
+  for (const auto& w : linkscan_event_writers_) {
+    w.writer->Write(event, absl::Seconds(1)).IgnoreError();
+  }
+}
+
+::util::StatusOr<int> BcmSdkFake::RegisterLinkscanEventWriter(
+    std::unique_ptr<ChannelWriter<LinkscanEvent>> writer, int priority) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(writer != nullptr) << "Null linkscan event Writer.";
+  absl::WriterMutexLock l(&linkscan_writers_lock_);
+  int id = 1;
+  for (const auto& w : linkscan_event_writers_) id = std::max(id, w.id + 1);
+  auto it = std::find_if(
+      linkscan_event_writers_.begin(), linkscan_event_writers_.end(),
+      [priority](const LinkscanEventWriter& w) {
+        return w.priority < priority;
+      });
+  linkscan_event_writers_.insert(it, {std::move(writer), priority, id});
+  return id;
+}
+
+::util::Status BcmSdkFake::UnregisterLinkscanEventWriter(int id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&linkscan_writers_lock_);
+  auto it = std::find_if(
+      linkscan_event_writers_.begin(), linkscan_event_writers_.end(),
+      [id](const LinkscanEventWriter& w) { return w.id == id; });
+  CHECK_RETURN_IF_FALSE(it != linkscan_event_writers_.end())
+      << "Could not find a linkscan event Writer with ID " << id << ".";
+  linkscan_event_writers_.erase(it);
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<BcmPortOptions::LinkscanMode> BcmSdkFake::GetPortLinkscanMode(
+    int unit, int port) {
+  BcmPortOptions options;
+  RETURN_IF_ERROR(GetPortOptions(unit, port, &options));
+  return options.linkscan_mode();
+}
+
+::util::Status BcmSdkFake::SetMtu(int unit, int mtu) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->mtu = mtu;
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateL3RouterIntf(int unit,
+                                                           uint64 router_mac,
+                                                           int vlan) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  const auto key = std::make_pair(router_mac, NormalizeVlan(vlan));
+  const int* id = gtl::FindOrNull(state->router_intf_key_to_id, key);
+  if (id != nullptr) return *id;
+  int router_intf_id = state->next_router_intf_id++;
+  state->router_intf_key_to_id[key] = router_intf_id;
+  state->router_intfs[router_intf_id] = key;
+  return router_intf_id;
+}
+
+::util::Status BcmSdkFake::DeleteL3RouterIntf(int unit, int router_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  auto it = state->router_intfs.find(router_intf_id);
+  if (it == state->router_intfs.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Router intf " << router_intf_id << " not found on unit " << unit
+           << ".";
+  }
+  for (const auto& e : state->egress_intfs) {
+    if (e.second.router_intf_id == router_intf_id &&
+        (e.second.type == EgressIntf::PORT ||
+         e.second.type == EgressIntf::TRUNK)) {
+      return MAKE_ERROR(ERR_OPER_STILL_RUNNING)
+             << "Router intf " << router_intf_id << " on unit " << unit
+             << " is still used by egress intf " << e.first << ".";
+    }
+  }
+  state->router_intf_key_to_id.erase(it->second);
+  state->router_intfs.erase(it);
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateL3CpuEgressIntf(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(state, 0,
+                                        {EgressIntf::CPU, 0, 0, 0, -1});
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateL3PortEgressIntf(
+    int unit, uint64 nexthop_mac, int port, int vlan, int router_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(
+      state, 0, {EgressIntf::PORT, nexthop_mac, port, NormalizeVlan(vlan),
+                 router_intf_id});
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateL3TrunkEgressIntf(
+    int unit, uint64 nexthop_mac, int trunk, int vlan, int router_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(
+      state, 0, {EgressIntf::TRUNK, nexthop_mac, trunk, NormalizeVlan(vlan),
+                 router_intf_id});
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateL3DropIntf(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(state, 0,
+                                        {EgressIntf::DROP, 0, 0, 0, -1});
+}
+
+::util::Status BcmSdkFake::ModifyL3CpuEgressIntf(int unit,
+                                                 int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(state, egress_intf_id,
+                                        {EgressIntf::CPU, 0, 0, 0, -1})
+      .status();
+}
+
+::util::Status BcmSdkFake::ModifyL3PortEgressIntf(int unit, int egress_intf_id,
+                                                  uint64 nexthop_mac, int port,
+                                                  int vlan,
+                                                  int router_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(
+             state, egress_intf_id,
+             {EgressIntf::PORT, nexthop_mac, port, NormalizeVlan(vlan),
+              router_intf_id})
+      .status();
+}
+
+::util::Status BcmSdkFake::ModifyL3TrunkEgressIntf(int unit,
+                                                   int egress_intf_id,
+                                                   uint64 nexthop_mac,
+                                                   int trunk, int vlan,
+                                                   int router_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(
+             state, egress_intf_id,
+             {EgressIntf::TRUNK, nexthop_mac, trunk, NormalizeVlan(vlan),
+              router_intf_id})
+      .status();
+}
+
+::util::Status BcmSdkFake::ModifyL3DropIntf(int unit, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return FindOrCreateOrModifyEgressIntf(state, egress_intf_id,
+                                        {EgressIntf::DROP, 0, 0, 0, -1})
+      .status();
+}
+
+::util::Status BcmSdkFake::DeleteL3EgressIntf(int unit, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  int ref_count = gtl::FindWithDefault(state->egress_intf_ref_counts,
+                                       egress_intf_id, 0);
+  if (ref_count > 0) {
+    return MAKE_ERROR(ERR_OPER_STILL_RUNNING)
+           << "Egress intf " << egress_intf_id << " on unit " << unit
+           << " is still used by " << ref_count << " routes or groups.";
+  }
+  auto it = state->egress_intfs.find(egress_intf_id);
+  state->egress_intf_key_to_id.erase(it->second.Key());
+  state->egress_intfs.erase(it);
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::FindRouterIntfFromEgressIntf(
+    int unit, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  const EgressIntf& intf = state->egress_intfs.at(egress_intf_id);
+  if (intf.type != EgressIntf::PORT && intf.type != EgressIntf::TRUNK) {
+    return -1;
+  }
+  return intf.router_intf_id;
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateEcmpEgressIntf(
+    int unit, const std::vector<int>& member_ids) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  CHECK_RETURN_IF_FALSE(!member_ids.empty())
+      << "Empty member_ids for ECMP/WCMP egress intf on unit " << unit << ".";
+  for (int member_id : member_ids) {
+    RETURN_IF_ERROR(CheckEgressIntfExists(*state, member_id, false));
+  }
+  // Groups with the same members, in any order, are the same group. Repeated
+  // members (WCMP weights) are kept.
+  std::vector<int> members = member_ids;
+  std::sort(members.begin(), members.end());
+  const int* id = gtl::FindOrNull(state->ecmp_members_to_id, members);
+  if (id != nullptr) return *id;
+  int egress_intf_id = state->next_ecmp_egress_intf_id++;
+  for (int member_id : members) ++state->egress_intf_ref_counts[member_id];
+  state->ecmp_members_to_id[members] = egress_intf_id;
+  state->ecmp_intfs[egress_intf_id] = members;
+  return egress_intf_id;
+}
+
+::util::Status BcmSdkFake::ModifyEcmpEgressIntf(
+    int unit, int egress_intf_id, const std::vector<int>& member_ids) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, true));
+  CHECK_RETURN_IF_FALSE(!member_ids.empty())
+      << "Empty member_ids for ECMP/WCMP egress intf " << egress_intf_id
+      << " on unit " << unit << ".";
+  for (int member_id : member_ids) {
+    RETURN_IF_ERROR(CheckEgressIntfExists(*state, member_id, false));
+  }
+  std::vector<int> members = member_ids;
+  std::sort(members.begin(), members.end());
+  std::vector<int>& old_members = state->ecmp_intfs[egress_intf_id];
+  for (int member_id : old_members) --state->egress_intf_ref_counts[member_id];
+  for (int member_id : members) ++state->egress_intf_ref_counts[member_id];
+  auto it = state->ecmp_members_to_id.find(old_members);
+  if (it != state->ecmp_members_to_id.end() && it->second == egress_intf_id) {
+    state->ecmp_members_to_id.erase(it);
+  }
+  state->ecmp_members_to_id.emplace(members, egress_intf_id);
+  old_members = members;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeleteEcmpEgressIntf(int unit, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, true));
+  int ref_count = gtl::FindWithDefault(state->egress_intf_ref_counts,
+                                       egress_intf_id, 0);
+  if (ref_count > 0) {
+    return MAKE_ERROR(ERR_OPER_STILL_RUNNING)
+           << "ECMP/WCMP egress intf " << egress_intf_id << " on unit " << unit
+           << " is still used by " << ref_count << " routes.";
+  }
+  auto it = state->ecmp_intfs.find(egress_intf_id);
+  for (int member_id : it->second) --state->egress_intf_ref_counts[member_id];
+  auto key_it = state->ecmp_members_to_id.find(it->second);
+  if (key_it != state->ecmp_members_to_id.end() &&
+      key_it->second == egress_intf_id) {
+    state->ecmp_members_to_id.erase(key_it);
+  }
+  state->ecmp_intfs.erase(it);
+  return ::util::OkStatus();
+}
+
+namespace {
+
+// Adds, modifies or deletes an L3 route or host in the given map, and keeps
+// the ref counts of the egress intfs up to date. The caller checks the egress
+// intf of the new route exists.
+template <typename Map, typename Key, typename Route>
+::util::Status AddL3Route(Map* routes, const Key& key, const Route& route,
+                          std::map<int, int>* ref_counts) {
+  if (!routes->emplace(key, route).second) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS) << "L3 route or host already exists.";
+  }
+  ++(*ref_counts)[route.egress_intf_id];
+  return ::util::OkStatus();
+}
+
+template <typename Map, typename Key, typename Route>
+::util::Status ModifyL3Route(Map* routes, const Key& key, const Route& route,
+                             std::map<int, int>* ref_counts) {
+  auto it = routes->find(key);
+  if (it == routes->end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "L3 route or host not found.";
+  }
+  --(*ref_counts)[it->second.egress_intf_id];
+  ++(*ref_counts)[route.egress_intf_id];
+  // Like in the SDK, a zero class_id leaves the class ID unchanged.
+  int class_id = route.class_id ? route.class_id : it->second.class_id;
+  it->second = route;
+  it->second.class_id = class_id;
+  return ::util::OkStatus();
+}
+
+template <typename Map, typename Key>
+::util::Status DeleteL3Route(Map* routes, const Key& key,
+                             std::map<int, int>* ref_counts) {
+  auto it = routes->find(key);
+  if (it == routes->end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "L3 route or host not found.";
+  }
+  --(*ref_counts)[it->second.egress_intf_id];
+  routes->erase(it);
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status BcmSdkFake::AddL3RouteIpv4(int unit, int vrf, uint32 subnet,
+                                          uint32 mask, int class_id,
+                                          int egress_intf_id,
+                                          bool is_intf_multipath) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(
+      CheckEgressIntfExists(*state, egress_intf_id, is_intf_multipath));
+  return AddL3Route(&state->ipv4_routes, std::make_tuple(vrf, subnet, mask),
+                    L3Route{class_id, egress_intf_id, is_intf_multipath},
+                    &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::AddL3RouteIpv6(int unit, int vrf,
+                                          const std::string& subnet,
+                                          const std::string& mask,
+                                          int class_id, int egress_intf_id,
+                                          bool is_intf_multipath) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(
+      CheckEgressIntfExists(*state, egress_intf_id, is_intf_multipath));
+  return AddL3Route(&state->ipv6_routes, std::make_tuple(vrf, subnet, mask),
+                    L3Route{class_id, egress_intf_id, is_intf_multipath},
+                    &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::AddL3HostIpv4(int unit, int vrf, uint32 ipv4,
+                                         int class_id, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  return AddL3Route(&state->ipv4_hosts, std::make_pair(vrf, ipv4),
+                    L3Route{class_id, egress_intf_id, false},
+                    &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::AddL3HostIpv6(int unit, int vrf,
+                                         const std::string& ipv6, int class_id,
+                                         int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  return AddL3Route(&state->ipv6_hosts, std::make_pair(vrf, ipv6),
+                    L3Route{class_id, egress_intf_id, false},
+                    &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::ModifyL3RouteIpv4(int unit, int vrf, uint32 subnet,
+                                             uint32 mask, int class_id,
+                                             int egress_intf_id,
+                                             bool is_intf_multipath) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(
+      CheckEgressIntfExists(*state, egress_intf_id, is_intf_multipath));
+  return ModifyL3Route(&state->ipv4_routes, std::make_tuple(vrf, subnet, mask),
+                       L3Route{class_id, egress_intf_id, is_intf_multipath},
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::ModifyL3RouteIpv6(int unit, int vrf,
+                                             const std::string& subnet,
+                                             const std::string& mask,
+                                             int class_id, int egress_intf_id,
+                                             bool is_intf_multipath) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(
+      CheckEgressIntfExists(*state, egress_intf_id, is_intf_multipath));
+  return ModifyL3Route(&state->ipv6_routes, std::make_tuple(vrf, subnet, mask),
+                       L3Route{class_id, egress_intf_id, is_intf_multipath},
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::ModifyL3HostIpv4(int unit, int vrf, uint32 ipv4,
+                                            int class_id, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  return ModifyL3Route(&state->ipv4_hosts, std::make_pair(vrf, ipv4),
+                       L3Route{class_id, egress_intf_id, false},
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::ModifyL3HostIpv6(int unit, int vrf,
+                                            const std::string& ipv6,
+                                            int class_id, int egress_intf_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+  return ModifyL3Route(&state->ipv6_hosts, std::make_pair(vrf, ipv6),
+                       L3Route{class_id, egress_intf_id, false},
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::DeleteL3RouteIpv4(int unit, int vrf, uint32 subnet,
+                                             uint32 mask) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return DeleteL3Route(&state->ipv4_routes, std::make_tuple(vrf, subnet, mask),
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::DeleteL3RouteIpv6(int unit, int vrf,
+                                             const std::string& subnet,
+                                             const std::string& mask) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return DeleteL3Route(&state->ipv6_routes, std::make_tuple(vrf, subnet, mask),
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::DeleteL3HostIpv4(int unit, int vrf, uint32 ipv4) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return DeleteL3Route(&state->ipv4_hosts, std::make_pair(vrf, ipv4),
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::DeleteL3HostIpv6(int unit, int vrf,
+                                            const std::string& ipv6) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  return DeleteL3Route(&state->ipv6_hosts, std::make_pair(vrf, ipv6),
+                       &state->egress_intf_ref_counts);
+}
+
+::util::Status BcmSdkFake::ProgramL3Routes(
+    int unit, const std::vector<L3RouteUpdate>& updates,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  // Models a bulk SDK operation: the whole batch is a single call.
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  results->clear();
+  results->reserve(updates.size());
+  bool success = true;
+  for (const auto& update : updates) {
+    results->push_back(ProgramL3Route(state, update));
+    success &= results->back().ok();
+  }
+  if (!success) {
+    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+           << "One or more L3 route updates failed on unit " << unit << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::AddMyStationEntry(int unit, int priority,
+                                                    int vlan, int vlan_mask,
+                                                    uint64 dst_mac,
+                                                    uint64 dst_mac_mask) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  // NOOP if the entry already exists.
+  const auto key = std::make_tuple(vlan, vlan_mask, dst_mac, dst_mac_mask);
+  const int* id = gtl::FindOrNull(state->my_station_entries, key);
+  if (id != nullptr) return *id;
+  int station_id = state->next_station_id++;
+  state->my_station_entries[key] = station_id;
+  return station_id;
+}
+
+::util::Status BcmSdkFake::DeleteMyStationEntry(int unit, int station_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  for (auto it = state->my_station_entries.begin();
+       it != state->my_station_entries.end(); ++it) {
+    if (it->second == station_id) {
+      state->my_station_entries.erase(it);
+      return ::util::OkStatus();
+    }
+  }
+  return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+         << "My station entry " << station_id << " not found on unit " << unit
+         << ".";
+}
+
+::util::Status BcmSdkFake::AddL2Entry(int unit, int vlan, uint64 dst_mac,
+                                      int logical_port, int trunk_port,
+                                      int l2_mcast_group_id, int class_id,
+                                      bool copy_to_cpu, bool dst_drop) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->l2_entries.emplace(std::make_pair(NormalizeVlan(vlan), dst_mac),
+                                 logical_port)
+           .second) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "L2 entry (vlan: " << vlan << ", dst_mac: " << dst_mac
+           << ") already exists on unit " << unit << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeleteL2Entry(int unit, int vlan, uint64 dst_mac) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->l2_entries.erase(std::make_pair(NormalizeVlan(vlan), dst_mac))) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "L2 entry (vlan: " << vlan << ", dst_mac: " << dst_mac
+           << ") not found on unit " << unit << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::AddL2MulticastEntry(int unit, int priority, int vlan,
+                                               int vlan_mask, uint64 dst_mac,
+                                               uint64 dst_mac_mask,
+                                               bool copy_to_cpu, bool drop,
+                                               uint8 l2_mcast_group_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->l2_multicast_entries
+           .insert(std::make_tuple(vlan, vlan_mask, dst_mac, dst_mac_mask))
+           .second) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "L2 multicast entry (vlan: " << vlan << ", dst_mac: " << dst_mac
+           << ") already exists on unit " << unit << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeleteL2MulticastEntry(int unit, int vlan,
+                                                  int vlan_mask,
+                                                  uint64 dst_mac,
+                                                  uint64 dst_mac_mask) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->l2_multicast_entries.erase(
+          std::make_tuple(vlan, vlan_mask, dst_mac, dst_mac_mask))) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "L2 multicast entry (vlan: " << vlan << ", dst_mac: " << dst_mac
+           << ") not found on unit " << unit << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::InsertPacketReplicationEntry(
+    const BcmPacketReplicationEntry& entry) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(entry.unit()));
+  bool inserted = false;
+  if (entry.has_multicast_group_entry()) {
+    inserted = state->multicast_group_ids
+                   .insert(entry.multicast_group_entry().multicast_group_id())
+                   .second;
+  } else if (entry.has_clone_session_entry()) {
+    inserted = state->clone_session_ids
+                   .insert(entry.clone_session_entry().clone_session_id())
+                   .second;
+  } else {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Invalid packet replication entry: " << entry.ShortDebugString();
+  }
+  if (!inserted) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "Packet replication entry already exists: "
+           << entry.ShortDebugString();
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeletePacketReplicationEntry(
+    const BcmPacketReplicationEntry& entry) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(entry.unit()));
+  bool erased = false;
+  if (entry.has_multicast_group_entry()) {
+    erased = state->multicast_group_ids.erase(
+        entry.multicast_group_entry().multicast_group_id());
+  } else if (entry.has_clone_session_entry()) {
+    erased = state->clone_session_ids.erase(
+        entry.clone_session_entry().clone_session_id());
+  }
+  if (!erased) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Packet replication entry not found: "
+           << entry.ShortDebugString();
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeleteL2EntriesByVlan(int unit, int vlan) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  vlan = NormalizeVlan(vlan);
+  for (auto it = state->l2_entries.begin(); it != state->l2_entries.end();) {
+    if (it->first.first == vlan) {
+      state->l2_entries.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::AddVlanIfNotFound(int unit, int vlan) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->vlans.insert(NormalizeVlan(vlan));
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DeleteVlanIfFound(int unit, int vlan) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->vlans.erase(NormalizeVlan(vlan));
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::ConfigureVlanBlock(int unit, int vlan,
+                                              bool block_broadcast,
+                                              bool block_known_multicast,
+                                              bool block_unknown_multicast,
+                                              bool block_unknown_unicast) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  CHECK_RETURN_IF_FALSE(state->vlans.count(NormalizeVlan(vlan)))
+      << "VLAN " << vlan << " not found on unit " << unit << ".";
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::ConfigureL2Learning(int unit, int vlan,
+                                               bool disable_l2_learning) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  CHECK_RETURN_IF_FALSE(state->vlans.count(NormalizeVlan(vlan)))
+      << "VLAN " << vlan << " not found on unit " << unit << ".";
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetL2AgeTimer(int unit, int l2_age_duration_sec) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  return GetUnitState(unit).status();
+}
+
+::util::Status BcmSdkFake::ConfigSerdesForPort(
+    int unit, int port, uint64 speed_bps, int serdes_core, int serdes_lane,
+    int serdes_num_lanes, const std::string& intf_type,
+    const SerdesRegisterConfigs& serdes_register_configs,
+    const SerdesAttrConfigs& serdes_attr_configs) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  return GetUnitState(unit).status();
+}
+
+::util::Status BcmSdkFake::CreateKnetIntf(int unit, int vlan,
+                                          std::string* netif_name,
+                                          int* netif_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(netif_name != nullptr && netif_id != nullptr)
+      << "Null netif_name or netif_id pointers.";
+  CHECK_RETURN_IF_FALSE(!netif_name->empty())
+      << "Empty netif name for unit " << unit << ".";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  // No netif is created in the kernel. The name template is returned as is.
+  *netif_id = state->next_knet_id++;
+  state->knet_intf_ids.insert(*netif_id);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::DestroyKnetIntf(int unit, int netif_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->knet_intf_ids.erase(netif_id)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "KNET intf " << netif_id << " not found on unit " << unit << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::CreateKnetFilter(int unit, int netif_id,
+                                                   KnetFilterType type) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->knet_intf_ids.count(netif_id)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "KNET intf " << netif_id << " not found on unit " << unit << ".";
+  }
+  int filter_id = state->next_knet_id++;
+  state->knet_filter_ids.insert(filter_id);
+  return filter_id;
+}
+
+::util::Status BcmSdkFake::DestroyKnetFilter(int unit, int filter_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->knet_filter_ids.erase(filter_id)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "KNET filter " << filter_id << " not found on unit " << unit
+           << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::StartRx(int unit, const RxConfig& rx_config) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->rx_started = true;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::StopRx(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->rx_started = false;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetRateLimit(
+    int unit, const RateLimitConfig& rate_limit_config) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  return GetUnitState(unit).status();
+}
+
+::util::Status BcmSdkFake::GetKnetHeaderForDirectTx(int unit, int port,
+                                                    int cos, uint64 smac,
+                                                    size_t packet_len,
+                                                    std::string* header) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(header != nullptr) << "Null header.";
+  header->assign(kKnetHeaderSize, 0);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetKnetHeaderForIngressPipelineTx(
+    int unit, uint64 smac, size_t packet_len, std::string* header) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(header != nullptr) << "Null header.";
+  header->assign(kKnetHeaderSize, 0);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetKnetHeaderPacketLength(int unit,
+                                                     size_t packet_len,
+                                                     std::string* header) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(header != nullptr) << "Null header.";
+  return ::util::OkStatus();
+}
+
+size_t BcmSdkFake::GetKnetHeaderSizeForRx(int unit) {
+  SimulateCall(__func__).IgnoreError();
+  return kKnetHeaderSize;
+}
+
+::util::Status BcmSdkFake::ParseKnetHeaderForRx(int unit,
+                                                const std::string& header,
+                                                int* ingress_logical_port,
+                                                int* egress_logical_port,
+                                                int* cos) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(ingress_logical_port != nullptr &&
+                        egress_logical_port != nullptr && cos != nullptr)
+      << "Null ingress_logical_port, egress_logical_port or cos.";
+  CHECK_RETURN_IF_FALSE(header.size() == kKnetHeaderSize)
+      << "Invalid KNET header size for RX (" << header.size()
+      << " != " << kKnetHeaderSize << ").";
+  // The first bytes of the header hold the ingress port, the egress port and
+  // the cos.
+  *ingress_logical_port = static_cast<uint8>(header[0]);
+  *egress_logical_port = static_cast<uint8>(header[1]);
+  *cos = static_cast<uint8>(header[2]);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::InitAclHardware(int unit) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->acl_hardware_initialized = true;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::SetAclControl(int unit,
+                                         const AclControl& acl_control) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  return GetUnitState(unit).status();
+}
+
+::util::Status BcmSdkFake::SetAclUdfChunks(int unit, const BcmUdfSet& udfs) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  state->udfs = udfs;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclUdfChunks(int unit, BcmUdfSet* udfs) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(udfs != nullptr) << "Null udfs.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  *udfs = state->udfs;
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::CreateAclTable(int unit,
+                                                 const BcmAclTable& table) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->acl_hardware_initialized) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED)
+           << "ACL hardware not initialized on unit " << unit << ".";
+  }
+  CHECK_RETURN_IF_FALSE(table.stage() != BCM_ACL_STAGE_UNKNOWN)
+      << "Attempted to create ACL table with invalid pipeline stage: "
+      << table.ShortDebugString();
+  // Like in the SDK, the requested table ID is used if given.
+  int table_id = table.id();
+  if (table_id == 0) {
+    while (state->acl_tables.count(state->next_acl_table_id)) {
+      ++state->next_acl_table_id;
+    }
+    table_id = state->next_acl_table_id++;
+  } else if (state->acl_tables.count(table_id)) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "ACL table " << table_id << " already exists on unit " << unit
+           << ".";
+  }
+  BcmAclTable& new_table = state->acl_tables[table_id];
+  new_table = table;
+  new_table.set_id(table_id);
+  return table_id;
+}
+
+::util::Status BcmSdkFake::DestroyAclTable(int unit, int table_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->acl_tables.count(table_id)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL table " << table_id << " not found on unit " << unit << ".";
+  }
+  for (const auto& e : state->acl_flows) {
+    if (static_cast<int>(e.second.flow.bcm_acl_table_id()) == table_id) {
+      return MAKE_ERROR(ERR_OPER_STILL_RUNNING)
+             << "ACL table " << table_id << " on unit " << unit
+             << " still has flows.";
+    }
+  }
+  state->acl_tables.erase(table_id);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclTable(int unit, int table_id,
+                                       BcmAclTable* table) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(table != nullptr) << "Null table.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  const BcmAclTable* acl_table = gtl::FindOrNull(state->acl_tables, table_id);
+  if (acl_table == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL table " << table_id << " not found on unit " << unit << ".";
+  }
+  *table = *acl_table;
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::InsertAclFlow(int unit,
+                                                const BcmFlowEntry& flow,
+                                                bool add_stats,
+                                                bool color_aware) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->acl_tables.count(flow.bcm_acl_table_id())) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL table " << flow.bcm_acl_table_id() << " not found on unit "
+           << unit << ".";
+  }
+  int flow_id = state->next_acl_flow_id++;
+  AclFlow& acl_flow = state->acl_flows[flow_id];
+  acl_flow.flow = flow;
+  acl_flow.has_stats = add_stats;
+  acl_flow.color_aware = color_aware;
+  return flow_id;
+}
+
+::util::Status BcmSdkFake::ModifyAclFlow(int unit, int flow_id,
+                                         const BcmFlowEntry& flow) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  // Only the actions and the meter of a flow can be modified.
+  acl_flow->flow.clear_actions();
+  acl_flow->flow.mutable_actions()->CopyFrom(flow.actions());
+  if (flow.has_meter()) *acl_flow->flow.mutable_meter() = flow.meter();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::RemoveAclFlow(int unit, int flow_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  RETURN_IF_ERROR(GetAclFlowState(state, flow_id).status());
+  state->acl_flows.erase(flow_id);
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclFlow(int unit, int flow_id,
+                                      BcmFlowEntry* flow) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(flow != nullptr) << "Null flow.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  *flow = acl_flow->flow;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::AddAclStats(int unit, int table_id, int flow_id,
+                                       bool color_aware) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  if (acl_flow->has_stats) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "ACL flow " << flow_id << " on unit " << unit
+           << " already has a stat object.";
+  }
+  acl_flow->has_stats = true;
+  acl_flow->color_aware = color_aware;
+  acl_flow->stats.Clear();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::RemoveAclStats(int unit, int flow_id) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  if (!acl_flow->has_stats) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL flow " << flow_id << " on unit " << unit
+           << " has no stat object.";
+  }
+  acl_flow->has_stats = false;
+  acl_flow->stats.Clear();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclStats(int unit, int flow_id,
+                                       BcmAclStats* stats) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(stats != nullptr) << "Null stats.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  if (!acl_flow->has_stats) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL flow " << flow_id << " on unit " << unit
+           << " has no stat object.";
+  }
+  *stats = acl_flow->stats;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclStatsBatch(
+    int unit, const std::vector<int>& flow_ids,
+    std::vector<BcmAclStats>* stats, std::vector<::util::Status>* details) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(stats != nullptr) << "Null stats.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  stats->clear();
+  stats->resize(flow_ids.size());
+  ::util::Status status = ::util::OkStatus();
+  for (size_t i = 0; i < flow_ids.size(); ++i) {
+    ::util::Status error = ::util::OkStatus();
+    auto ret = GetAclFlowState(state, flow_ids[i]);
+    if (!ret.ok()) {
+      error = ret.status();
+    } else if (!ret.ValueOrDie()->has_stats) {
+      error = MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+              << "ACL flow " << flow_ids[i] << " on unit " << unit
+              << " has no stat object.";
+    } else {
+      (*stats)[i] = ret.ValueOrDie()->stats;
+    }
+    APPEND_STATUS_IF_ERROR(status, error);
+    if (details != nullptr) details->push_back(error);
+  }
+  return status;
+}
+
+::util::Status BcmSdkFake::SetAclPolicer(int unit, int flow_id,
+                                         const BcmMeterConfig& meter) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  *acl_flow->flow.mutable_meter() = meter;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkFake::GetAclTableFlowIds(int unit, int table_id,
+                                              std::vector<int>* flow_ids) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  CHECK_RETURN_IF_FALSE(flow_ids != nullptr) << "Null flow_ids.";
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  if (!state->acl_tables.count(table_id)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "ACL Table id " << table_id << " not found.";
+  }
+  flow_ids->clear();
+  for (const auto& e : state->acl_flows) {
+    if (static_cast<int>(e.second.flow.bcm_acl_table_id()) == table_id) {
+      flow_ids->push_back(e.first);
+    }
+  }
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<std::string> BcmSdkFake::MatchAclFlow(
+    int unit, int flow_id, const BcmFlowEntry& flow) {
+  RETURN_IF_ERROR(SimulateCall(__func__));
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  const BcmFlowEntry& hw_flow = acl_flow->flow;
+  if (hw_flow.priority() != flow.priority()) {
+    return absl::StrCat("Priority mismatch: ", hw_flow.priority(), " vs ",
+                        flow.priority(), ".");
+  }
+  if (hw_flow.fields_size() != flow.fields_size()) {
+    return absl::StrCat("Number of fields mismatch: ", hw_flow.fields_size(),
+                        " vs ", flow.fields_size(), ".");
+  }
+  for (int i = 0; i < flow.fields_size(); ++i) {
+    if (!ProtoEqual(hw_flow.fields(i), flow.fields(i))) {
+      return absl::StrCat("Field mismatch: ",
+                          hw_flow.fields(i).ShortDebugString(), " vs ",
+                          flow.fields(i).ShortDebugString(), ".");
+    }
+  }
+  if (hw_flow.actions_size() != flow.actions_size()) {
+    return absl::StrCat("Number of actions mismatch: ",
+                        hw_flow.actions_size(), " vs ", flow.actions_size(),
+                        ".");
+  }
+  for (int i = 0; i < flow.actions_size(); ++i) {
+    if (!ProtoEqual(hw_flow.actions(i), flow.actions(i))) {
+      return absl::StrCat("Action mismatch: ",
+                          hw_flow.actions(i).ShortDebugString(), " vs ",
+                          flow.actions(i).ShortDebugString(), ".");
+    }
+  }
+  return std::string();
+}
+
+void BcmSdkFake::SetCallLatency(absl::Duration latency) {
+  absl::WriterMutexLock l(&call_lock_);
+  call_latency_ = latency;
+}
+
+void BcmSdkFake::SetCallLatency(const std::string& method,
+                                absl::Duration latency) {
+  absl::WriterMutexLock l(&call_lock_);
+  method_to_call_latency_[method] = latency;
+}
+
+void BcmSdkFake::InjectFailures(const std::string& method, int count,
+                                const ::util::Status& status) {
+  absl::WriterMutexLock l(&call_lock_);
+  if (count <= 0 || status.ok()) {
+    method_to_injected_failures_.erase(method);
+  } else {
+    method_to_injected_failures_[method] = std::make_pair(count, status);
+  }
+}
+
+void BcmSdkFake::ClearInjectedFailures() {
+  absl::WriterMutexLock l(&call_lock_);
+  method_to_injected_failures_.clear();
+}
+
+int64 BcmSdkFake::GetCallCount(const std::string& method) const {
+  absl::ReaderMutexLock l(&call_lock_);
+  return gtl::FindWithDefault(method_to_call_count_, method, 0);
+}
+
+::util::Status BcmSdkFake::SetAclStats(int unit, int flow_id,
+                                       const BcmAclStats& stats) {
+  absl::WriterMutexLock l(&data_lock_);
+  ASSIGN_OR_RETURN(UnitState* state, GetUnitState(unit));
+  ASSIGN_OR_RETURN(AclFlow* acl_flow, GetAclFlowState(state, flow_id));
+  CHECK_RETURN_IF_FALSE(acl_flow->has_stats)
+      << "ACL flow " << flow_id << " on unit " << unit
+      << " has no stat object.";
+  acl_flow->stats = stats;
+  return ::util::OkStatus();
+}
+
+std::unique_ptr<BcmSdkFake> BcmSdkFake::CreateInstance() {
+  return absl::WrapUnique(new BcmSdkFake());
+}
+
+::util::Status BcmSdkFake::SimulateCall(const std::string& method) {
+  absl::Duration latency;
+  ::util::Status status = ::util::OkStatus();
+  {
+    absl::WriterMutexLock l(&call_lock_);
+    ++method_to_call_count_[method];
+    latency = gtl::FindWithDefault(method_to_call_latency_, method,
+                                   call_latency_);
+    auto it = method_to_injected_failures_.find(method);
+    if (it == method_to_injected_failures_.end()) {
+      it = method_to_injected_failures_.find("");
+    }
+    if (it != method_to_injected_failures_.end()) {
+      status = it->second.second;
+      if (--it->second.first == 0) method_to_injected_failures_.erase(it);
+    }
+  }
+  Wait(latency);
+  return status;
+}
+
+::util::StatusOr<BcmSdkFake::UnitState*> BcmSdkFake::GetUnitState(int unit) {
+  UnitState* state = gtl::FindOrNull(unit_to_state_, unit);
+  if (state == nullptr) {
+    return MAKE_ERROR(ERR_INVALID_PARAM) << "Unit " << unit << " not found!";
+  }
+  return state;
+}
+
+::util::Status BcmSdkFake::ProgramL3Route(UnitState* state,
+                                          const L3RouteUpdate& update) {
+  const int vrf = update.vrf;
+  const std::string subnet_ipv6(update.subnet_ipv6.begin(),
+                                update.subnet_ipv6.end());
+  const std::string mask_ipv6(update.mask_ipv6.begin(), update.mask_ipv6.end());
+  const bool is_lpm =
+      update.table_type == BcmFlowEntry::BCM_TABLE_IPV4_LPM ||
+      update.table_type == BcmFlowEntry::BCM_TABLE_IPV6_LPM;
+  const L3Route route{update.class_id, update.egress_intf_id,
+                      is_lpm && update.is_intf_multipath};
+  if (update.type != L3RouteUpdate::Type::DELETE) {
+    RETURN_IF_ERROR(CheckEgressIntfExists(*state, route.egress_intf_id,
+                                          route.is_intf_multipath));
+  }
+  auto* ref_counts = &state->egress_intf_ref_counts;
+  switch (update.table_type) {
+    case BcmFlowEntry::BCM_TABLE_IPV4_LPM: {
+      const auto key =
+          std::make_tuple(vrf, update.subnet_ipv4, update.mask_ipv4);
+      if (update.type == L3RouteUpdate::Type::ADD) {
+        return AddL3Route(&state->ipv4_routes, key, route, ref_counts);
+      } else if (update.type == L3RouteUpdate::Type::MODIFY) {
+        return ModifyL3Route(&state->ipv4_routes, key, route, ref_counts);
+      }
+      return DeleteL3Route(&state->ipv4_routes, key, ref_counts);
+    }
+    case BcmFlowEntry::BCM_TABLE_IPV4_HOST: {
+      const auto key = std::make_pair(vrf, update.subnet_ipv4);
+      if (update.type == L3RouteUpdate::Type::ADD) {
+        return AddL3Route(&state->ipv4_hosts, key, route, ref_counts);
+      } else if (update.type == L3RouteUpdate::Type::MODIFY) {
+        return ModifyL3Route(&state->ipv4_hosts, key, route, ref_counts);
+      }
+      return DeleteL3Route(&state->ipv4_hosts, key, ref_counts);
+    }
+    case BcmFlowEntry::BCM_TABLE_IPV6_LPM: {
+      const auto key = std::make_tuple(vrf, subnet_ipv6, mask_ipv6);
+      if (update.type == L3RouteUpdate::Type::ADD) {
+        return AddL3Route(&state->ipv6_routes, key, route, ref_counts);
+      } else if (update.type == L3RouteUpdate::Type::MODIFY) {
+        return ModifyL3Route(&state->ipv6_routes, key, route, ref_counts);
+      }
+      return DeleteL3Route(&state->ipv6_routes, key, ref_counts);
+    }
+    case BcmFlowEntry::BCM_TABLE_IPV6_HOST: {
+      const auto key = std::make_pair(vrf, subnet_ipv6);
+      if (update.type == L3RouteUpdate::Type::ADD) {
+        return AddL3Route(&state->ipv6_hosts, key, route, ref_counts);
+      } else if (update.type == L3RouteUpdate::Type::MODIFY) {
+        return ModifyL3Route(&state->ipv6_hosts, key, route, ref_counts);
+      }
+      return DeleteL3Route(&state->ipv6_hosts, key, ref_counts);
+    }
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Invalid bcm_table_type: "
+             << BcmFlowEntry::BcmTableType_Name(update.table_type) << ".";
+  }
+}
+
+::util::Status BcmSdkFake::CheckEgressIntfExists(const UnitState& state,
+                                                 int egress_intf_id,
+                                                 bool is_intf_multipath) const {
+  bool found = is_intf_multipath ? state.ecmp_intfs.count(egress_intf_id)
+                                 : state.egress_intfs.count(egress_intf_id);
+  if (!found) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << (is_intf_multipath ? "ECMP/WCMP egress intf " : "Egress intf ")
+           << egress_intf_id << " not found.";
+  }
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmSdkFake::FindOrCreateOrModifyEgressIntf(
+    UnitState* state, int egress_intf_id, const EgressIntf& intf) {
+  if ((intf.type == EgressIntf::PORT || intf.type == EgressIntf::TRUNK) &&
+      intf.router_intf_id > 0 && !state->router_intfs.count(intf.router_intf_id)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Router intf " << intf.router_intf_id << " not found.";
+  }
+  if (egress_intf_id > 0) {
+    // Modify the existing egress intf.
+    RETURN_IF_ERROR(CheckEgressIntfExists(*state, egress_intf_id, false));
+    EgressIntf& old_intf = state->egress_intfs[egress_intf_id];
+    auto it = state->egress_intf_key_to_id.find(old_intf.Key());
+    if (it != state->egress_intf_key_to_id.end() &&
+        it->second == egress_intf_id) {
+      state->egress_intf_key_to_id.erase(it);
+    }
+    old_intf = intf;
+    state->egress_intf_key_to_id.emplace(intf.Key(), egress_intf_id);
+    return egress_intf_id;
+  }
+  const int* id = gtl::FindOrNull(state->egress_intf_key_to_id, intf.Key());
+  if (id != nullptr) return *id;
+  egress_intf_id = state->next_egress_intf_id++;
+  state->egress_intf_key_to_id[intf.Key()] = egress_intf_id;
+  state->egress_intfs[egress_intf_id] = intf;
+  return egress_intf_id;
+}
+
+::util::StatusOr<BcmSdkFake::AclFlow*> BcmSdkFake::GetAclFlowState(
+    UnitState* state, int flow_id) {
+  AclFlow* acl_flow = gtl::FindOrNull(state->acl_flows, flow_id);
+  if (acl_flow == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "ACL flow " << flow_id << " not found.";
+  }
+  return acl_flow;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,506 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_SDK_FAKE_H_
+#define STRATUM_HAL_LIB_BCM_BCM_SDK_FAKE_H_
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/bcm/bcm.pb.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// The "BcmSdkFake" is an in-memory implementation of BcmSdkInterface. Instead
+// of programming an ASIC, it keeps the L2, L3 and ACL state of each unit in
+// memory and checks the calls against it the way the SDK would, e.g. adding an
+// existing route or pointing a route to an unknown egress intf fails. KNET and
+// RX calls are accepted and do nothing. This lets the whole HAL stack on top of
+// BcmSdkInterface run without the SDK or the BcmSdkSim simulator processes,
+// e.g. in benchmarks. To model real hardware, every call can be delayed by a
+// configurable latency and failures can be injected into any of the calls.
+class BcmSdkFake : public BcmSdkInterface {
+ public:
+  // The first IDs given to the L3 egress intfs and ECMP/WCMP egress intfs.
+  // Like in the SDK, the two kinds of intfs use disjoint ID ranges.
+  static constexpr int kFirstEgressIntfId = 100000;
+  static constexpr int kFirstEcmpEgressIntfId = 200000;
+
+  ~BcmSdkFake() override;
+
+  // BcmSdkInterface public methods.
+  ::util::Status InitializeSdk(
+      const std::string& config_file_path,
+      const std::string& config_flush_file_path,
+      const std::string& bcm_shell_log_file_path) override;
+  ::util::Status FindUnit(int unit, int pci_bus, int pci_slot,
+                          BcmChip::BcmChipType chip_type) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status InitializeUnit(int unit, bool warm_boot) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ShutdownUnit(int unit) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ShutdownAllUnits() override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetModuleId(int unit, int module) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status InitializePort(int unit, int port) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetPortOptions(int unit, int port,
+                                const BcmPortOptions& options) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetPortOptions(int unit, int port,
+                                BcmPortOptions* options) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetPortCounters(int unit, int port, PortCounters* pc) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetPortCountersBatch(int unit, const std::vector<int>& ports,
+                                      std::vector<PortCounters>* pcs) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status StartDiagShellServer() override;
+  ::util::Status StartLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status StopLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
+  void OnLinkscanEvent(int unit, int port, PortState linkstatus) override
+      LOCKS_EXCLUDED(linkscan_writers_lock_);
+  ::util::StatusOr<int> RegisterLinkscanEventWriter(
+      std::unique_ptr<ChannelWriter<LinkscanEvent>> writer,
+      int priority) override LOCKS_EXCLUDED(linkscan_writers_lock_);
+  ::util::Status UnregisterLinkscanEventWriter(int id) override
+      LOCKS_EXCLUDED(linkscan_writers_lock_);
+  ::util::StatusOr<BcmPortOptions::LinkscanMode> GetPortLinkscanMode(
+      int unit, int port) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetMtu(int unit, int mtu) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateL3RouterIntf(int unit, uint64 router_mac,
+                                                 int vlan) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3RouterIntf(int unit, int router_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateL3CpuEgressIntf(int unit) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateL3PortEgressIntf(
+      int unit, uint64 nexthop_mac, int port, int vlan,
+      int router_intf_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateL3TrunkEgressIntf(
+      int unit, uint64 nexthop_mac, int trunk, int vlan,
+      int router_intf_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateL3DropIntf(int unit) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3CpuEgressIntf(int unit, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3PortEgressIntf(int unit, int egress_intf_id,
+                                        uint64 nexthop_mac, int port, int vlan,
+                                        int router_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3TrunkEgressIntf(int unit, int egress_intf_id,
+                                         uint64 nexthop_mac, int trunk,
+                                         int vlan, int router_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3DropIntf(int unit, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3EgressIntf(int unit, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindRouterIntfFromEgressIntf(
+      int unit, int egress_intf_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> FindOrCreateEcmpEgressIntf(
+      int unit, const std::vector<int>& member_ids) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyEcmpEgressIntf(
+      int unit, int egress_intf_id,
+      const std::vector<int>& member_ids) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL3RouteIpv4(int unit, int vrf, uint32 subnet, uint32 mask,
+                                int class_id, int egress_intf_id,
+                                bool is_intf_multipath) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL3RouteIpv6(int unit, int vrf, const std::string& subnet,
+                                const std::string& mask, int class_id,
+                                int egress_intf_id,
+                                bool is_intf_multipath) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL3HostIpv4(int unit, int vrf, uint32 ipv4, int class_id,
+                               int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL3HostIpv6(int unit, int vrf, const std::string& ipv6,
+                               int class_id, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3RouteIpv4(int unit, int vrf, uint32 subnet,
+                                   uint32 mask, int class_id,
+                                   int egress_intf_id,
+                                   bool is_intf_multipath) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3RouteIpv6(int unit, int vrf, const std::string& subnet,
+                                   const std::string& mask, int class_id,
+                                   int egress_intf_id,
+                                   bool is_intf_multipath) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3HostIpv4(int unit, int vrf, uint32 ipv4, int class_id,
+                                  int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyL3HostIpv6(int unit, int vrf, const std::string& ipv6,
+                                  int class_id, int egress_intf_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3RouteIpv4(int unit, int vrf, uint32 subnet,
+                                   uint32 mask) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3RouteIpv6(int unit, int vrf, const std::string& subnet,
+                                   const std::string& mask) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3HostIpv4(int unit, int vrf, uint32 ipv4) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL3HostIpv6(int unit, int vrf,
+                                  const std::string& ipv6) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ProgramL3Routes(int unit,
+                                 const std::vector<L3RouteUpdate>& updates,
+                                 std::vector<::util::Status>* results) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> AddMyStationEntry(int unit, int priority, int vlan,
+                                          int vlan_mask, uint64 dst_mac,
+                                          uint64 dst_mac_mask) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteMyStationEntry(int unit, int station_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL2Entry(int unit, int vlan, uint64 dst_mac,
+                            int logical_port, int trunk_port,
+                            int l2_mcast_group_id, int class_id,
+                            bool copy_to_cpu, bool dst_drop) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL2Entry(int unit, int vlan, uint64 dst_mac) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddL2MulticastEntry(int unit, int priority, int vlan,
+                                     int vlan_mask, uint64 dst_mac,
+                                     uint64 dst_mac_mask, bool copy_to_cpu,
+                                     bool drop,
+                                     uint8 l2_mcast_group_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL2MulticastEntry(int unit, int vlan, int vlan_mask,
+                                        uint64 dst_mac,
+                                        uint64 dst_mac_mask) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status InsertPacketReplicationEntry(
+      const BcmPacketReplicationEntry& entry) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeletePacketReplicationEntry(
+      const BcmPacketReplicationEntry& entry) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteL2EntriesByVlan(int unit, int vlan) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddVlanIfNotFound(int unit, int vlan) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteVlanIfFound(int unit, int vlan) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ConfigureVlanBlock(int unit, int vlan, bool block_broadcast,
+                                    bool block_known_multicast,
+                                    bool block_unknown_multicast,
+                                    bool block_unknown_unicast) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ConfigureL2Learning(int unit, int vlan,
+                                     bool disable_l2_learning) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetL2AgeTimer(int unit, int l2_age_duration_sec) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ConfigSerdesForPort(
+      int unit, int port, uint64 speed_bps, int serdes_core, int serdes_lane,
+      int serdes_num_lanes, const std::string& intf_type,
+      const SerdesRegisterConfigs& serdes_register_configs,
+      const SerdesAttrConfigs& serdes_attr_configs) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status CreateKnetIntf(int unit, int vlan, std::string* netif_name,
+                                int* netif_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DestroyKnetIntf(int unit, int netif_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> CreateKnetFilter(int unit, int netif_id,
+                                         KnetFilterType type) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DestroyKnetFilter(int unit, int filter_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status StartRx(int unit, const RxConfig& rx_config) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status StopRx(int unit) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetRateLimit(
+      int unit, const RateLimitConfig& rate_limit_config) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetKnetHeaderForDirectTx(int unit, int port, int cos,
+                                          uint64 smac, size_t packet_len,
+                                          std::string* header) override;
+  ::util::Status GetKnetHeaderForIngressPipelineTx(
+      int unit, uint64 smac, size_t packet_len, std::string* header) override;
+  ::util::Status SetKnetHeaderPacketLength(int unit, size_t packet_len,
+                                           std::string* header) override;
+  size_t GetKnetHeaderSizeForRx(int unit) override;
+  ::util::Status ParseKnetHeaderForRx(int unit, const std::string& header,
+                                      int* ingress_logical_port,
+                                      int* egress_logical_port,
+                                      int* cos) override;
+  ::util::Status InitAclHardware(int unit) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetAclControl(int unit,
+                               const AclControl& acl_control) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetAclUdfChunks(int unit, const BcmUdfSet& udfs) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclUdfChunks(int unit, BcmUdfSet* udfs) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> CreateAclTable(int unit,
+                                       const BcmAclTable& table) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DestroyAclTable(int unit, int table_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclTable(int unit, int table_id,
+                             BcmAclTable* table) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<int> InsertAclFlow(int unit, const BcmFlowEntry& flow,
+                                      bool add_stats,
+                                      bool color_aware) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyAclFlow(int unit, int flow_id,
+                               const BcmFlowEntry& flow) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status RemoveAclFlow(int unit, int flow_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclFlow(int unit, int flow_id, BcmFlowEntry* flow) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddAclStats(int unit, int table_id, int flow_id,
+                             bool color_aware) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status RemoveAclStats(int unit, int flow_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclStats(int unit, int flow_id,
+                             BcmAclStats* stats) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclStatsBatch(int unit, const std::vector<int>& flow_ids,
+                                  std::vector<BcmAclStats>* stats,
+                                  std::vector<::util::Status>* details) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetAclPolicer(int unit, int flow_id,
+                               const BcmMeterConfig& meter) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status GetAclTableFlowIds(int unit, int table_id,
+                                    std::vector<int>* flow_ids) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<std::string> MatchAclFlow(
+      int unit, int flow_id, const BcmFlowEntry& flow) override
+      LOCKS_EXCLUDED(data_lock_);
+
+  // Sets the time every call made to this class takes before it returns. The
+  // calls do not hold any lock while they wait, so concurrent calls overlap.
+  void SetCallLatency(absl::Duration latency) LOCKS_EXCLUDED(call_lock_);
+
+  // Same as SetCallLatency(), but only for the calls to the given method
+  // (e.g. "AddL3RouteIpv4"). Overrides the latency set by SetCallLatency().
+  void SetCallLatency(const std::string& method, absl::Duration latency)
+      LOCKS_EXCLUDED(call_lock_);
+
+  // Makes the next 'count' calls to the given method (e.g. "InsertAclFlow")
+  // fail with the given error status, without changing the state of the fake.
+  // An empty method name matches the calls to all the methods.
+  void InjectFailures(const std::string& method, int count,
+                      const ::util::Status& status) LOCKS_EXCLUDED(call_lock_);
+
+  // Removes all the failures injected by InjectFailures() and not yet
+  // returned.
+  void ClearInjectedFailures() LOCKS_EXCLUDED(call_lock_);
+
+  // Returns the number of calls made to the given method so far, including
+  // the calls which failed.
+  int64 GetCallCount(const std::string& method) const
+      LOCKS_EXCLUDED(call_lock_);
+
+  // Sets the counters returned for an ACL flow by GetAclStats() and
+  // GetAclStatsBatch(). The flow must have a stat object attached.
+  ::util::Status SetAclStats(int unit, int flow_id, const BcmAclStats& stats)
+      LOCKS_EXCLUDED(data_lock_);
+
+  // Creates a new instance of this class.
+  static std::unique_ptr<BcmSdkFake> CreateInstance();
+
+  // BcmSdkFake is neither copyable nor movable.
+  BcmSdkFake(const BcmSdkFake&) = delete;
+  BcmSdkFake& operator=(const BcmSdkFake&) = delete;
+
+ private:
+  // An L3 egress intf, i.e. a non-multipath nexthop.
+  struct EgressIntf {
+    enum Type { CPU, PORT, TRUNK, DROP };
+    Type type;
+    uint64 nexthop_mac;
+    int port;  // logical port for PORT type, trunk for TRUNK type.
+    int vlan;
+    int router_intf_id;
+    std::tuple<int, uint64, int, int, int> Key() const {
+      return std::make_tuple(type, nexthop_mac, port, vlan, router_intf_id);
+    }
+  };
+
+  // The action of an L3 LPM or host route.
+  struct L3Route {
+    int class_id;
+    int egress_intf_id;
+    bool is_intf_multipath;
+  };
+
+  // An ACL flow and the stat object and policer attached to it, if any.
+  struct AclFlow {
+    BcmFlowEntry flow;
+    bool has_stats;
+    bool color_aware;
+    BcmAclStats stats;
+  };
+
+  // The state of a unit, as created by FindUnit().
+  struct UnitState {
+    bool initialized = false;
+    int module = 0;
+    int mtu = 0;
+    bool linkscan_started = false;
+    std::map<int, BcmPortOptions> port_to_options;
+    // L3 router intfs, egress intfs and ECMP/WCMP egress intfs, with the
+    // reverse maps used by the FindOrCreate*() methods.
+    std::map<std::pair<uint64, int>, int> router_intf_key_to_id;
+    std::map<int, std::pair<uint64, int>> router_intfs;
+    std::map<std::tuple<int, uint64, int, int, int>, int> egress_intf_key_to_id;
+    std::map<int, EgressIntf> egress_intfs;
+    std::map<std::vector<int>, int> ecmp_members_to_id;
+    std::map<int, std::vector<int>> ecmp_intfs;
+    // Number of routes, hosts and groups using each egress intf, which cannot
+    // be deleted while in use.
+    std::map<int, int> egress_intf_ref_counts;
+    int next_router_intf_id = 1;
+    int next_egress_intf_id = kFirstEgressIntfId;
+    int next_ecmp_egress_intf_id = kFirstEcmpEgressIntfId;
+    // L3 routes, keyed by (vrf, subnet, mask) and hosts, keyed by (vrf, ip).
+    absl::flat_hash_map<std::tuple<int, uint32, uint32>, L3Route> ipv4_routes;
+    absl::flat_hash_map<std::tuple<int, std::string, std::string>, L3Route>
+        ipv6_routes;
+    absl::flat_hash_map<std::pair<int, uint32>, L3Route> ipv4_hosts;
+    absl::flat_hash_map<std::pair<int, std::string>, L3Route> ipv6_hosts;
+    // My station TCAM entries keyed by (vlan, vlan_mask, dst_mac,
+    // dst_mac_mask), with their station IDs.
+    std::map<std::tuple<int, int, uint64, uint64>, int> my_station_entries;
+    int next_station_id = 1;
+    // L2 FDB entries keyed by (vlan, dst_mac), L2 multicast entries keyed
+    // by (vlan, vlan_mask, dst_mac, dst_mac_mask) and VLANs.
+    absl::flat_hash_map<std::pair<int, uint64>, int> l2_entries;
+    std::set<std::tuple<int, int, uint64, uint64>> l2_multicast_entries;
+    std::set<int> vlans;
+    std::set<uint32> multicast_group_ids;
+    std::set<uint32> clone_session_ids;
+    // KNET intfs and filters.
+    std::set<int> knet_intf_ids;
+    std::set<int> knet_filter_ids;
+    int next_knet_id = 1;
+    bool rx_started = false;
+    // ACL tables and flows, keyed by their IDs.
+    bool acl_hardware_initialized = false;
+    BcmUdfSet udfs;
+    std::map<int, BcmAclTable> acl_tables;
+    std::map<int, AclFlow> acl_flows;
+    int next_acl_table_id = 1;
+    int next_acl_flow_id = 1;
+  };
+
+  // A Writer registered by RegisterLinkscanEventWriter().
+  struct LinkscanEventWriter {
+    std::unique_ptr<ChannelWriter<LinkscanEvent>> writer;
+    int priority;
+    int id;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  BcmSdkFake();
+
+  // Accounts for a call to the given method: waits for the call latency and
+  // returns the failure injected for the method, if any.
+  ::util::Status SimulateCall(const std::string& method)
+      LOCKS_EXCLUDED(call_lock_);
+
+  // Returns the state of a unit which was found by FindUnit().
+  ::util::StatusOr<UnitState*> GetUnitState(int unit)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Checks that an egress intf (or an ECMP/WCMP egress intf if
+  // is_intf_multipath is true) with the given ID exists on the unit.
+  ::util::Status CheckEgressIntfExists(const UnitState& state,
+                                       int egress_intf_id,
+                                       bool is_intf_multipath) const
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
+  // Applies one update of a ProgramL3Routes() batch to the unit.
+  ::util::Status ProgramL3Route(UnitState* state, const L3RouteUpdate& update)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Finds or creates an egress intf on the unit, or modifies the existing
+  // egress intf with the given ID if egress_intf_id > 0.
+  ::util::StatusOr<int> FindOrCreateOrModifyEgressIntf(
+      UnitState* state, int egress_intf_id, const EgressIntf& intf)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Returns the flow with the given ID on the unit.
+  ::util::StatusOr<AclFlow*> GetAclFlowState(UnitState* state, int flow_id)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Mutex lock protecting the call latencies, injected failures and call
+  // counters.
+  mutable absl::Mutex call_lock_;
+
+  // Latency of all the calls, and the latencies overridden per method.
+  absl::Duration call_latency_ GUARDED_BY(call_lock_);
+  std::map<std::string, absl::Duration> method_to_call_latency_
+      GUARDED_BY(call_lock_);
+
+  // Map from method name ("" for all the methods) to the number of failures
+  // left to return and the status to return.
+  std::map<std::string, std::pair<int, ::util::Status>>
+      method_to_injected_failures_ GUARDED_BY(call_lock_);
+
+  // Map from method name to the number of calls made to the method.
+  std::map<std::string, int64> method_to_call_count_ GUARDED_BY(call_lock_);
+
+  // Mutex lock protecting the state of the units.
+  mutable absl::Mutex data_lock_;
+
+  // Map from unit number to the state of the unit.
+  std::map<int, UnitState> unit_to_state_ GUARDED_BY(data_lock_);
+
+  // RW mutex lock for protecting the linkscan event Writers.
+  mutable absl::Mutex linkscan_writers_lock_;
+
+  // Linkscan event Writers, sorted by decreasing priority.
+  std::vector<LinkscanEventWriter> linkscan_event_writers_
+      GUARDED_BY(linkscan_writers_lock_);
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_SDK_FAKE_H_
@@ -0,0 +1,375 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_sdk_fake.h"
+
+#include "absl/time/clock.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+using test_utils::EqualsProto;
+using ::testing::HasSubstr;
+using ::testing::UnorderedElementsAre;
+
+class BcmSdkFakeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    bcm_sdk_fake_ = BcmSdkFake::CreateInstance();
+    ASSERT_OK(bcm_sdk_fake_->FindUnit(kUnit, 0, 0, BcmChip::TOMAHAWK));
+    ASSERT_OK(bcm_sdk_fake_->InitializeUnit(kUnit, false));
+  }
+
+  // Creates a router intf and a port egress intf using it.
+  int CreatePortEgressIntf(int port) {
+    auto router_intf_id =
+        bcm_sdk_fake_->FindOrCreateL3RouterIntf(kUnit, kRouterMac, kVlan);
+    EXPECT_OK(router_intf_id);
+    auto egress_intf_id = bcm_sdk_fake_->FindOrCreateL3PortEgressIntf(
+        kUnit, kNexthopMac, port, kVlan, router_intf_id.ValueOrDie());
+    EXPECT_OK(egress_intf_id);
+    return egress_intf_id.ValueOrDie();
+  }
+
+  static constexpr int kUnit = 0;
+  static constexpr int kVrf = 10;
+  static constexpr int kVlan = 20;
+  static constexpr uint64 kRouterMac = 0x112233445566ULL;
+  static constexpr uint64 kNexthopMac = 0x665544332211ULL;
+  std::unique_ptr<BcmSdkFake> bcm_sdk_fake_;
+};
+
+constexpr int BcmSdkFakeTest::kUnit;
+constexpr int BcmSdkFakeTest::kVrf;
+constexpr int BcmSdkFakeTest::kVlan;
+constexpr uint64 BcmSdkFakeTest::kRouterMac;
+constexpr uint64 BcmSdkFakeTest::kNexthopMac;
+
+TEST_F(BcmSdkFakeTest, UnknownUnit) {
+  ::util::Status status = bcm_sdk_fake_->SetMtu(kUnit + 1, 1500);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Unit 1 not found"));
+  status = bcm_sdk_fake_->FindUnit(kUnit, 0, 0, BcmChip::TOMAHAWK);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, status.error_code());
+}
+
+TEST_F(BcmSdkFakeTest, PortOptions) {
+  ASSERT_OK(bcm_sdk_fake_->InitializePort(kUnit, 1));
+  BcmPortOptions options;
+  options.set_enabled(TRI_STATE_TRUE);
+  options.set_speed_bps(100000000000ULL);
+  ASSERT_OK(bcm_sdk_fake_->SetPortOptions(kUnit, 1, options));
+  BcmPortOptions new_options;
+  new_options.set_linkscan_mode(BcmPortOptions::LINKSCAN_MODE_SW);
+  ASSERT_OK(bcm_sdk_fake_->SetPortOptions(kUnit, 1, new_options));
+
+  options.set_linkscan_mode(BcmPortOptions::LINKSCAN_MODE_SW);
+  BcmPortOptions read_options;
+  ASSERT_OK(bcm_sdk_fake_->GetPortOptions(kUnit, 1, &read_options));
+  EXPECT_THAT(read_options, EqualsProto(options));
+  auto ret = bcm_sdk_fake_->GetPortLinkscanMode(kUnit, 1);
+  ASSERT_OK(ret);
+  EXPECT_EQ(BcmPortOptions::LINKSCAN_MODE_SW, ret.ValueOrDie());
+  EXPECT_EQ(ERR_INVALID_PARAM,
+            bcm_sdk_fake_->GetPortOptions(kUnit, 2, &read_options)
+                .error_code());
+}
+
+TEST_F(BcmSdkFakeTest, EgressIntfsAreReused) {
+  int egress_intf_id = CreatePortEgressIntf(1);
+  EXPECT_GE(egress_intf_id, BcmSdkFake::kFirstEgressIntfId);
+  EXPECT_EQ(egress_intf_id, CreatePortEgressIntf(1));
+  EXPECT_NE(egress_intf_id, CreatePortEgressIntf(2));
+
+  auto cpu_intf_id = bcm_sdk_fake_->FindOrCreateL3CpuEgressIntf(kUnit);
+  ASSERT_OK(cpu_intf_id);
+  auto drop_intf_id = bcm_sdk_fake_->FindOrCreateL3DropIntf(kUnit);
+  ASSERT_OK(drop_intf_id);
+  EXPECT_NE(cpu_intf_id.ValueOrDie(), drop_intf_id.ValueOrDie());
+
+  // Only the port egress intfs have a router intf.
+  auto router_intf_id =
+      bcm_sdk_fake_->FindRouterIntfFromEgressIntf(kUnit, egress_intf_id);
+  ASSERT_OK(router_intf_id);
+  EXPECT_GT(router_intf_id.ValueOrDie(), 0);
+  router_intf_id = bcm_sdk_fake_->FindRouterIntfFromEgressIntf(
+      kUnit, cpu_intf_id.ValueOrDie());
+  ASSERT_OK(router_intf_id);
+  EXPECT_LT(router_intf_id.ValueOrDie(), 0);
+
+  // A router intf cannot be deleted while an egress intf uses it.
+  int id = bcm_sdk_fake_
+               ->FindRouterIntfFromEgressIntf(kUnit, egress_intf_id)
+               .ValueOrDie();
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING,
+            bcm_sdk_fake_->DeleteL3RouterIntf(kUnit, id).error_code());
+}
+
+TEST_F(BcmSdkFakeTest, ModifyEgressIntf) {
+  int egress_intf_id = CreatePortEgressIntf(1);
+  ASSERT_OK(bcm_sdk_fake_->ModifyL3DropIntf(kUnit, egress_intf_id));
+  // The old egress intf does not exist anymore, so a new one is created.
+  EXPECT_NE(egress_intf_id, CreatePortEgressIntf(1));
+  auto drop_intf_id = bcm_sdk_fake_->FindOrCreateL3DropIntf(kUnit);
+  ASSERT_OK(drop_intf_id);
+  EXPECT_EQ(egress_intf_id, drop_intf_id.ValueOrDie());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            bcm_sdk_fake_->ModifyL3CpuEgressIntf(kUnit, 12345).error_code());
+}
+
+TEST_F(BcmSdkFakeTest, AddModifyDeleteL3Routes) {
+  int egress_intf_id = CreatePortEgressIntf(1);
+  ASSERT_OK(bcm_sdk_fake_->AddL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000,
+                                          0, egress_intf_id, false));
+  ::util::Status status = bcm_sdk_fake_->AddL3RouteIpv4(
+      kUnit, kVrf, 0x0a000000, 0xff000000, 0, egress_intf_id, false);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, status.error_code());
+  // The route uses an unknown egress intf.
+  status = bcm_sdk_fake_->AddL3RouteIpv4(kUnit, kVrf, 0x0b000000, 0xff000000,
+                                         0, egress_intf_id + 1, false);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+
+  // The egress intf is in use.
+  status = bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, egress_intf_id);
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING, status.error_code());
+
+  int other_egress_intf_id = CreatePortEgressIntf(2);
+  ASSERT_OK(bcm_sdk_fake_->ModifyL3RouteIpv4(kUnit, kVrf, 0x0a000000,
+                                             0xff000000, 0,
+                                             other_egress_intf_id, false));
+  ASSERT_OK(bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, egress_intf_id));
+  ASSERT_OK(
+      bcm_sdk_fake_->DeleteL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000));
+  status =
+      bcm_sdk_fake_->DeleteL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+  EXPECT_OK(bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, other_egress_intf_id));
+
+  ASSERT_OK(bcm_sdk_fake_->AddL3HostIpv6(kUnit, kVrf, std::string(16, '\x01'),
+                                         0, CreatePortEgressIntf(3)));
+  status = bcm_sdk_fake_->ModifyL3HostIpv6(kUnit, kVrf, std::string(16, '\x02'),
+                                           0, CreatePortEgressIntf(3));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+}
+
+TEST_F(BcmSdkFakeTest, ProgramL3RoutesInOneCall) {
+  int egress_intf_id = CreatePortEgressIntf(1);
+  std::vector<BcmSdkInterface::L3RouteUpdate> updates(4);
+  updates[0].table_type = BcmFlowEntry::BCM_TABLE_IPV4_LPM;
+  updates[0].vrf = kVrf;
+  updates[0].subnet_ipv4 = 0x0a000000;
+  updates[0].mask_ipv4 = 0xff000000;
+  updates[0].egress_intf_id = egress_intf_id;
+  updates[1] = updates[0];
+  updates[1].type = BcmSdkInterface::L3RouteUpdate::Type::MODIFY;
+  updates[1].class_id = 5;
+  updates[2].table_type = BcmFlowEntry::BCM_TABLE_IPV6_HOST;
+  updates[2].subnet_ipv6.fill(0x01);
+  updates[2].egress_intf_id = egress_intf_id;
+  // The route does not exist.
+  updates[3] = updates[0];
+  updates[3].type = BcmSdkInterface::L3RouteUpdate::Type::DELETE;
+  updates[3].subnet_ipv4 = 0x0b000000;
+
+  std::vector<::util::Status> results;
+  ::util::Status status =
+      bcm_sdk_fake_->ProgramL3Routes(kUnit, updates, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_OK(results[1]);
+  EXPECT_OK(results[2]);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, results[3].error_code());
+  EXPECT_EQ(1, bcm_sdk_fake_->GetCallCount("ProgramL3Routes"));
+  EXPECT_EQ(0, bcm_sdk_fake_->GetCallCount("AddL3RouteIpv4"));
+
+  // The routes are the same as the ones added one by one.
+  status = bcm_sdk_fake_->AddL3HostIpv6(kUnit, 0, std::string(16, '\x01'), 0,
+                                        egress_intf_id);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, status.error_code());
+  ASSERT_OK(
+      bcm_sdk_fake_->DeleteL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000));
+  ASSERT_OK(
+      bcm_sdk_fake_->DeleteL3HostIpv6(kUnit, 0, std::string(16, '\x01')));
+  EXPECT_OK(bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, egress_intf_id));
+}
+
+TEST_F(BcmSdkFakeTest, EcmpEgressIntfs) {
+  int member1 = CreatePortEgressIntf(1);
+  int member2 = CreatePortEgressIntf(2);
+  auto ecmp_intf_id =
+      bcm_sdk_fake_->FindOrCreateEcmpEgressIntf(kUnit, {member1, member2});
+  ASSERT_OK(ecmp_intf_id);
+  EXPECT_GE(ecmp_intf_id.ValueOrDie(), BcmSdkFake::kFirstEcmpEgressIntfId);
+  // The order of the members does not matter.
+  auto same_intf_id =
+      bcm_sdk_fake_->FindOrCreateEcmpEgressIntf(kUnit, {member2, member1});
+  ASSERT_OK(same_intf_id);
+  EXPECT_EQ(ecmp_intf_id.ValueOrDie(), same_intf_id.ValueOrDie());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            bcm_sdk_fake_->FindOrCreateEcmpEgressIntf(kUnit, {member1, 12345})
+                .status()
+                .error_code());
+
+  // The route must say the egress intf is multipath.
+  ::util::Status status = bcm_sdk_fake_->AddL3RouteIpv4(
+      kUnit, kVrf, 0x0a000000, 0xff000000, 0, ecmp_intf_id.ValueOrDie(),
+      false);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+  ASSERT_OK(bcm_sdk_fake_->AddL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000,
+                                          0, ecmp_intf_id.ValueOrDie(), true));
+  status =
+      bcm_sdk_fake_->DeleteEcmpEgressIntf(kUnit, ecmp_intf_id.ValueOrDie());
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING, status.error_code());
+
+  ASSERT_OK(bcm_sdk_fake_->ModifyEcmpEgressIntf(
+      kUnit, ecmp_intf_id.ValueOrDie(), {member2}));
+  EXPECT_OK(bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, member1));
+  status = bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, member2);
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING, status.error_code());
+  ASSERT_OK(
+      bcm_sdk_fake_->DeleteL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000));
+  ASSERT_OK(
+      bcm_sdk_fake_->DeleteEcmpEgressIntf(kUnit, ecmp_intf_id.ValueOrDie()));
+  EXPECT_OK(bcm_sdk_fake_->DeleteL3EgressIntf(kUnit, member2));
+}
+
+TEST_F(BcmSdkFakeTest, L2Entries) {
+  ASSERT_OK(bcm_sdk_fake_->AddL2Entry(kUnit, kVlan, kNexthopMac, 1, 0, 0, 0,
+                                      false, false));
+  EXPECT_EQ(ERR_ENTRY_EXISTS,
+            bcm_sdk_fake_
+                ->AddL2Entry(kUnit, kVlan, kNexthopMac, 2, 0, 0, 0, false,
+                             false)
+                .error_code());
+  ASSERT_OK(bcm_sdk_fake_->DeleteL2EntriesByVlan(kUnit, kVlan));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            bcm_sdk_fake_->DeleteL2Entry(kUnit, kVlan, kNexthopMac)
+                .error_code());
+
+  auto station_id =
+      bcm_sdk_fake_->AddMyStationEntry(kUnit, 10, kVlan, 0xfff, kRouterMac,
+                                       0xffffffffffffULL);
+  ASSERT_OK(station_id);
+  auto same_station_id =
+      bcm_sdk_fake_->AddMyStationEntry(kUnit, 10, kVlan, 0xfff, kRouterMac,
+                                       0xffffffffffffULL);
+  ASSERT_OK(same_station_id);
+  EXPECT_EQ(station_id.ValueOrDie(), same_station_id.ValueOrDie());
+  EXPECT_OK(
+      bcm_sdk_fake_->DeleteMyStationEntry(kUnit, station_id.ValueOrDie()));
+}
+
+TEST_F(BcmSdkFakeTest, AclTablesFlowsAndStats) {
+  BcmAclTable table;
+  table.set_stage(BCM_ACL_STAGE_IFP);
+  EXPECT_EQ(ERR_NOT_INITIALIZED,
+            bcm_sdk_fake_->CreateAclTable(kUnit, table).status().error_code());
+  ASSERT_OK(bcm_sdk_fake_->InitAclHardware(kUnit));
+  table.set_id(7);
+  auto table_id = bcm_sdk_fake_->CreateAclTable(kUnit, table);
+  ASSERT_OK(table_id);
+  EXPECT_EQ(7, table_id.ValueOrDie());
+  EXPECT_EQ(ERR_ENTRY_EXISTS,
+            bcm_sdk_fake_->CreateAclTable(kUnit, table).status().error_code());
+
+  BcmFlowEntry flow;
+  flow.set_bcm_acl_table_id(7);
+  flow.set_priority(100);
+  flow.add_fields()->set_type(BcmField::ETH_TYPE);
+  flow.add_actions()->set_type(BcmAction::DROP);
+  auto flow_id = bcm_sdk_fake_->InsertAclFlow(kUnit, flow, true, false);
+  ASSERT_OK(flow_id);
+  auto flow_id2 = bcm_sdk_fake_->InsertAclFlow(kUnit, flow, false, false);
+  ASSERT_OK(flow_id2);
+  std::vector<int> flow_ids;
+  ASSERT_OK(bcm_sdk_fake_->GetAclTableFlowIds(kUnit, 7, &flow_ids));
+  EXPECT_THAT(flow_ids, UnorderedElementsAre(flow_id.ValueOrDie(),
+                                             flow_id2.ValueOrDie()));
+
+  auto match = bcm_sdk_fake_->MatchAclFlow(kUnit, flow_id.ValueOrDie(), flow);
+  ASSERT_OK(match);
+  EXPECT_EQ("", match.ValueOrDie());
+  BcmFlowEntry other_flow = flow;
+  other_flow.set_priority(200);
+  match = bcm_sdk_fake_->MatchAclFlow(kUnit, flow_id.ValueOrDie(), other_flow);
+  ASSERT_OK(match);
+  EXPECT_THAT(match.ValueOrDie(), HasSubstr("Priority mismatch"));
+
+  BcmAclStats stats;
+  stats.mutable_total()->set_packets(5);
+  ASSERT_OK(bcm_sdk_fake_->SetAclStats(kUnit, flow_id.ValueOrDie(), stats));
+  BcmAclStats read_stats;
+  ASSERT_OK(
+      bcm_sdk_fake_->GetAclStats(kUnit, flow_id.ValueOrDie(), &read_stats));
+  EXPECT_THAT(read_stats, EqualsProto(stats));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            bcm_sdk_fake_->GetAclStats(kUnit, flow_id2.ValueOrDie(),
+                                       &read_stats)
+                .error_code());
+
+  // A table cannot be destroyed while it has flows.
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING,
+            bcm_sdk_fake_->DestroyAclTable(kUnit, 7).error_code());
+  ASSERT_OK(bcm_sdk_fake_->RemoveAclFlow(kUnit, flow_id.ValueOrDie()));
+  ASSERT_OK(bcm_sdk_fake_->RemoveAclFlow(kUnit, flow_id2.ValueOrDie()));
+  EXPECT_OK(bcm_sdk_fake_->DestroyAclTable(kUnit, 7));
+}
+
+TEST_F(BcmSdkFakeTest, InjectedFailures) {
+  bcm_sdk_fake_->InjectFailures("AddL3RouteIpv4", 2,
+                                MAKE_ERROR(ERR_TABLE_FULL) << "Table full.");
+  int egress_intf_id = CreatePortEgressIntf(1);
+  for (int i = 0; i < 2; ++i) {
+    ::util::Status status = bcm_sdk_fake_->AddL3RouteIpv4(
+        kUnit, kVrf, 0x0a000000, 0xff000000, 0, egress_intf_id, false);
+    EXPECT_EQ(ERR_TABLE_FULL, status.error_code());
+  }
+  EXPECT_OK(bcm_sdk_fake_->AddL3RouteIpv4(kUnit, kVrf, 0x0a000000, 0xff000000,
+                                          0, egress_intf_id, false));
+  EXPECT_EQ(3, bcm_sdk_fake_->GetCallCount("AddL3RouteIpv4"));
+  EXPECT_EQ(0, bcm_sdk_fake_->GetCallCount("DeleteL3RouteIpv4"));
+
+  // An empty method name matches all the methods.
+  bcm_sdk_fake_->InjectFailures("", 1, MAKE_ERROR(ERR_INTERNAL) << "Boom.");
+  EXPECT_EQ(ERR_INTERNAL, bcm_sdk_fake_->SetMtu(kUnit, 1500).error_code());
+  EXPECT_OK(bcm_sdk_fake_->SetMtu(kUnit, 1500));
+  bcm_sdk_fake_->InjectFailures("", 10, MAKE_ERROR(ERR_INTERNAL) << "Boom.");
+  bcm_sdk_fake_->ClearInjectedFailures();
+  EXPECT_OK(bcm_sdk_fake_->SetMtu(kUnit, 1500));
+}
+
+TEST_F(BcmSdkFakeTest, CallLatency) {
+  bcm_sdk_fake_->SetCallLatency(absl::Microseconds(200));
+  bcm_sdk_fake_->SetCallLatency("SetMtu", absl::Milliseconds(20));
+  absl::Time start = absl::Now();
+  ASSERT_OK(bcm_sdk_fake_->SetL2AgeTimer(kUnit, 300));
+  absl::Duration elapsed = absl::Now() - start;
+  EXPECT_GE(elapsed, absl::Microseconds(200));
+  EXPECT_LT(elapsed, absl::Milliseconds(20));
+  start = absl::Now();
+  ASSERT_OK(bcm_sdk_fake_->SetMtu(kUnit, 1500));
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(20));
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,135 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
+
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+// Returns the IPv6 address/mask as the 16-byte string expected by the
+// per-route IPv6 methods.
+std::string Ipv6ToString(const BcmSdkInterface::Ipv6Address& addr) {
+  return std::string(addr.begin(), addr.end());
+}
+
+}  // namespace
+
+::util::Status BcmSdkInterface::ProgramL3Routes(
+    int unit, const std::vector<L3RouteUpdate>& updates,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  results->clear();
+  results->reserve(updates.size());
+  bool success = true;
+  for (const auto& u : updates) {
+    ::util::Status status = ::util::OkStatus();
+    switch (u.type) {
+      case L3RouteUpdate::Type::ADD:
+        switch (u.table_type) {
+          case BcmFlowEntry::BCM_TABLE_IPV4_LPM:
+            status = AddL3RouteIpv4(unit, u.vrf, u.subnet_ipv4, u.mask_ipv4,
+                                    u.class_id, u.egress_intf_id,
+                                    u.is_intf_multipath);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV4_HOST:
+            status = AddL3HostIpv4(unit, u.vrf, u.subnet_ipv4, u.class_id,
+                                   u.egress_intf_id);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
+            status = AddL3RouteIpv6(unit, u.vrf, Ipv6ToString(u.subnet_ipv6),
+                                    Ipv6ToString(u.mask_ipv6), u.class_id,
+                                    u.egress_intf_id, u.is_intf_multipath);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
+            status = AddL3HostIpv6(unit, u.vrf, Ipv6ToString(u.subnet_ipv6),
+                                   u.class_id, u.egress_intf_id);
+            break;
+          default:
+            status = MAKE_ERROR(ERR_INVALID_PARAM)
+                     << "Invalid bcm_table_type: "
+                     << BcmFlowEntry::BcmTableType_Name(u.table_type) << ".";
+        }
+        break;
+      case L3RouteUpdate::Type::MODIFY:
+        switch (u.table_type) {
+          case BcmFlowEntry::BCM_TABLE_IPV4_LPM:
+            status = ModifyL3RouteIpv4(unit, u.vrf, u.subnet_ipv4, u.mask_ipv4,
+                                       u.class_id, u.egress_intf_id,
+                                       u.is_intf_multipath);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV4_HOST:
+            status = ModifyL3HostIpv4(unit, u.vrf, u.subnet_ipv4, u.class_id,
+                                      u.egress_intf_id);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
+            status = ModifyL3RouteIpv6(
+                unit, u.vrf, Ipv6ToString(u.subnet_ipv6),
+                Ipv6ToString(u.mask_ipv6), u.class_id, u.egress_intf_id,
+                u.is_intf_multipath);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
+            status = ModifyL3HostIpv6(unit, u.vrf, Ipv6ToString(u.subnet_ipv6),
+                                      u.class_id, u.egress_intf_id);
+            break;
+          default:
+            status = MAKE_ERROR(ERR_INVALID_PARAM)
+                     << "Invalid bcm_table_type: "
+                     << BcmFlowEntry::BcmTableType_Name(u.table_type) << ".";
+        }
+        break;
+      case L3RouteUpdate::Type::DELETE:
+        switch (u.table_type) {
+          case BcmFlowEntry::BCM_TABLE_IPV4_LPM:
+            status = DeleteL3RouteIpv4(unit, u.vrf, u.subnet_ipv4, u.mask_ipv4);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV4_HOST:
+            status = DeleteL3HostIpv4(unit, u.vrf, u.subnet_ipv4);
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
+            status = DeleteL3RouteIpv6(unit, u.vrf, Ipv6ToString(u.subnet_ipv6),
+                                       Ipv6ToString(u.mask_ipv6));
+            break;
+          case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
+            status =
+                DeleteL3HostIpv6(unit, u.vrf, Ipv6ToString(u.subnet_ipv6));
+            break;
+          default:
+            status = MAKE_ERROR(ERR_INVALID_PARAM)
+                     << "Invalid bcm_table_type: "
+                     << BcmFlowEntry::BcmTableType_Name(u.table_type) << ".";
+        }
+        break;
+    }
+    success &= status.ok();
+    results->push_back(status);
+  }
+
+  if (!success) {
+    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+           << "One or more L3 route updates failed on unit " << unit << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
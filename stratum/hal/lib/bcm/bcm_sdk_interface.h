@@ -18,6 +18,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_SDK_INTERFACE_H_
 #define STRATUM_HAL_LIB_BCM_BCM_SDK_INTERFACE_H_
 
+#include <array>
 #include <functional>
 #include <map>
 #include <string>
@@ -49,6 +50,9 @@ class BcmSdkInterface {
   // Map from BCM serdes attributes for ports to their values.
   typedef std::map<std::string, uint32> SerdesAttrConfigs;
 
+  // A fixed-size IPv6 address or mask, in network byte order.
+  typedef std::array<uint8, 16> Ipv6Address;
+
   // The type of KNET filter to add. Given to CreateKnetFilter API.
   enum class KnetFilterType {
     // Catch all packets.
@@ -180,6 +184,38 @@ class BcmSdkInterface {
     PortState state;
   };
 
+  // L3RouteUpdate encapsulates the data required to add, modify or delete one
+  // IPv4/IPv6 LPM or host route. This is used as part of the batch given to
+  // ProgramL3Routes() API.
+  struct L3RouteUpdate {
+    enum class Type { ADD, MODIFY, DELETE };
+    Type type;
+    // One of BCM_TABLE_IPV4_LPM, BCM_TABLE_IPV4_HOST, BCM_TABLE_IPV6_LPM or
+    // BCM_TABLE_IPV6_HOST.
+    BcmFlowEntry::BcmTableType table_type;
+    // The route key. The mask is ignored for host routes.
+    int vrf;
+    uint32 subnet_ipv4;
+    uint32 mask_ipv4;
+    Ipv6Address subnet_ipv6;
+    Ipv6Address mask_ipv6;
+    // The route action, ignored for DELETE.
+    int class_id;
+    int egress_intf_id;
+    bool is_intf_multipath;
+    L3RouteUpdate()
+        : type(Type::ADD),
+          table_type(BcmFlowEntry::BCM_TABLE_UNKNOWN),
+          vrf(0),
+          subnet_ipv4(0),
+          mask_ipv4(0),
+          subnet_ipv6(),
+          mask_ipv6(),
+          class_id(0),
+          egress_intf_id(0),
+          is_intf_multipath(false) {}
+  };
+
   // A few predefined priority values that can be used by external functions
   // when calling RegisterLinkscanEventWriter.
   static constexpr int kLinkscanEventWriterPriorityHigh = 100;
@@ -232,6 +268,13 @@ class BcmSdkInterface {
   virtual ::util::Status GetPortCounters(int unit, int port,
                                          PortCounters* pc) = 0;
 
+  // Gets the counters for a batch of logical ports (typically all the ports
+  // of a unit) in one call. On success, pcs holds the counters of each of the
+  // ports, in the same order as in ports.
+  virtual ::util::Status GetPortCountersBatch(
+      int unit, const std::vector<int>& ports,
+      std::vector<PortCounters>* pcs) = 0;
+
   // Starts the diag shell server for listening to client telnet connections.
   virtual ::util::Status StartDiagShellServer() = 0;
 
@@ -457,6 +500,17 @@ class BcmSdkInterface {
   virtual ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                           const std::string& ipv6) = 0;
 
+  // Adds, modifies or deletes a batch of IPv4/IPv6 L3 LPM/host routes on a
+  // given unit, in the given order. The semantics of each update are the same
+  // as the ones of the corresponding Add*/Modify*/Delete* method above, and
+  // 'results' is filled with one status per update. Returns
+  // ERR_AT_LEAST_ONE_OPER_FAILED if any of the updates failed. The default
+  // implementation programs the routes one by one. Implementations with a
+  // bulk API override it to program the whole batch at once.
+  virtual ::util::Status ProgramL3Routes(
+      int unit, const std::vector<L3RouteUpdate>& updates,
+      std::vector<::util::Status>* results);
+
   // Adds an entry to match the given (vlan, vlan_mask, dst_mac, dst_mac_mask)
   // to the my station TCAM, with the given priority. NOOP if the entry already
   // exists. All the IPv4/IPv6 packets, independent of the src port, will be
@@ -595,6 +649,12 @@ class BcmSdkInterface {
   virtual ::util::Status GetKnetHeaderForIngressPipelineTx(
       int unit, uint64 smac, size_t packet_len, std::string* header) = 0;
 
+  // Sets the packet length in a TX KNET header returned by one of the two
+  // methods above, so that the header can be reused for packets of another
+  // size.
+  virtual ::util::Status SetKnetHeaderPacketLength(int unit, size_t packet_len,
+                                                   std::string* header) = 0;
+
   // Returns the fixed size KNET header size for packets received from a port.
   virtual size_t GetKnetHeaderSizeForRx(int unit) = 0;
 
@@ -687,6 +747,17 @@ class BcmSdkInterface {
   virtual ::util::Status GetAclStats(int unit, int flow_id,
                                      BcmAclStats* stats) = 0;
 
+  // Obtain the stat counters associated with a batch of flows on a given unit
+  // (typically all the flows of a physical ACL table) in one call. stats holds
+  // the counters of each of the flows, in the same order as in flow_ids. A
+  // flow whose counters cannot be read does not stop the batch: its entry in
+  // stats is left empty and an error is returned for the whole batch. If
+  // details is not nullptr, it is filled with the status of each flow.
+  virtual ::util::Status GetAclStatsBatch(
+      int unit, const std::vector<int>& flow_ids,
+      std::vector<BcmAclStats>* stats,
+      std::vector<::util::Status>* details) = 0;
+
   // **************************************************************************
   // ACL Flow Metering Functions
   // **************************************************************************
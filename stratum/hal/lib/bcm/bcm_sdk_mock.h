@@ -49,6 +49,9 @@ class BcmSdkMock : public BcmSdkInterface {
                ::util::Status(int unit, int port, BcmPortOptions* options));
   MOCK_METHOD3(GetPortCounters,
                ::util::Status(int unit, int port, PortCounters* pc));
+  MOCK_METHOD3(GetPortCountersBatch,
+               ::util::Status(int unit, const std::vector<int>& ports,
+                              std::vector<PortCounters>* pcs));
   MOCK_METHOD0(StartDiagShellServer, ::util::Status());
   MOCK_METHOD1(StartLinkscan, ::util::Status(int unit));
   MOCK_METHOD1(StopLinkscan, ::util::Status(int unit));
@@ -131,6 +134,10 @@ class BcmSdkMock : public BcmSdkInterface {
                ::util::Status(int unit, int vrf, uint32 ipv4));
   MOCK_METHOD3(DeleteL3HostIpv6,
                ::util::Status(int unit, int vrf, const std::string& ipv6));
+  MOCK_METHOD3(ProgramL3Routes,
+               ::util::Status(int unit,
+                              const std::vector<L3RouteUpdate>& updates,
+                              std::vector<::util::Status>* results));
   MOCK_METHOD6(AddMyStationEntry,
                ::util::StatusOr<int>(int unit, int priority, int vlan,
                                      int vlan_mask, uint64 dst_mac,
@@ -191,6 +198,9 @@ class BcmSdkMock : public BcmSdkInterface {
   MOCK_METHOD4(GetKnetHeaderForIngressPipelineTx,
                ::util::Status(int unit, uint64 smac, size_t packet_len,
                               std::string* header));
+  MOCK_METHOD3(SetKnetHeaderPacketLength,
+               ::util::Status(int unit, size_t packet_len,
+                              std::string* header));
   MOCK_METHOD1(GetKnetHeaderSizeForRx, size_t(int unit));
   MOCK_METHOD5(ParseKnetHeaderForRx,
                ::util::Status(int unit, const std::string& header,
@@ -225,6 +235,10 @@ class BcmSdkMock : public BcmSdkInterface {
   MOCK_METHOD2(RemoveAclStats, ::util::Status(int unit, int flow_id));
   MOCK_METHOD3(GetAclStats,
                ::util::Status(int unit, int flow_id, BcmAclStats* stats));
+  MOCK_METHOD4(GetAclStatsBatch,
+               ::util::Status(int unit, const std::vector<int>& flow_ids,
+                              std::vector<BcmAclStats>* stats,
+                              std::vector<::util::Status>* details));
   MOCK_METHOD3(SetAclPolicer, ::util::Status(int unit, int flow_id,
                                              const BcmMeterConfig& meter));
 };
@@ -197,6 +197,22 @@ size_t BcmSdkSim::GetKnetHeaderSizeForRx(int unit) { return 0; }
   return MAKE_ERROR(ERR_FEATURE_UNAVAILABLE) << "Not supported in sim mode.";
 }
 
+::util::Status BcmSdkSim::GetAclStatsBatch(
+    int unit, const std::vector<int> &flow_ids,
+    std::vector<BcmAclStats> *stats, std::vector<::util::Status> *details) {
+  // The simulator does not count the packets hitting the ACL flows. Report
+  // zero counters for all the flows in one go.
+  CHECK_RETURN_IF_FALSE(stats != nullptr) << "Null stats.";
+  stats->clear();
+  stats->resize(flow_ids.size());
+  for (auto &flow_stats : *stats) {
+    flow_stats.mutable_total()->set_bytes(0);
+    flow_stats.mutable_total()->set_packets(0);
+    if (details != nullptr) details->push_back(::util::OkStatus());
+  }
+  return ::util::OkStatus();
+}
+
 BcmSdkSim *BcmSdkSim::CreateSingleton(const std::string& bcm_sdk_sim_bin) {
   absl::WriterMutexLock l(&init_lock_);
   if (!singleton_) {
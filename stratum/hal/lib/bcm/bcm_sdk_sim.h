@@ -21,6 +21,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_wrapper.h"
@@ -83,6 +84,9 @@ class BcmSdkSim : public BcmSdkWrapper {
                                       int* ingress_logical_port,
                                       int* egress_logical_port,
                                       int* cos) override;
+  ::util::Status GetAclStatsBatch(int unit, const std::vector<int>& flow_ids,
+                                  std::vector<BcmAclStats>* stats,
+                                  std::vector<::util::Status>* details) override;
 
   // Creates the singleton instance. Expected to be called once to initialize
   // the instance.
@@ -1774,6 +1774,79 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::GetPortCountersBatch(
+    int unit, const std::vector<int>& ports, std::vector<PortCounters>* pcs) {
+  // Check if unit is valid
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  CHECK_RETURN_IF_FALSE(pcs != nullptr);
+  pcs->clear();
+  pcs->resize(ports.size());
+  if (ports.empty()) return ::util::OkStatus();
+
+  // Look up the good and error counters of all the ports in one batch
+  // transaction, instead of two synchronous commits per port.
+  bcmlt_transaction_hdl_t trans_hdl;
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_allocate(BCMLT_TRANS_TYPE_BATCH, &trans_hdl));
+  // Freeing the transaction also frees all the entries added to it.
+  auto cleanup =
+      gtl::MakeCleanup([trans_hdl]() { bcmlt_transaction_free(trans_hdl); });
+  auto add_lookup = [unit, trans_hdl](const char* table, int port,
+                                      bcmlt_entry_handle_t* entry_hdl) {
+    int rv = bcmlt_entry_allocate(unit, table, entry_hdl);
+    if (rv != SHR_E_NONE) return rv;
+    rv = bcmlt_entry_field_add(*entry_hdl, PORT_IDs, port);
+    if (rv == SHR_E_NONE) {
+      rv = bcmlt_transaction_entry_add(trans_hdl, BCMLT_OPCODE_LOOKUP,
+                                       *entry_hdl);
+    }
+    if (rv != SHR_E_NONE) bcmlt_entry_free(*entry_hdl);
+    return rv;
+  };
+  std::vector<bcmlt_entry_handle_t> mac_entries(ports.size());
+  std::vector<bcmlt_entry_handle_t> mac_err_entries(ports.size());
+  for (size_t i = 0; i < ports.size(); ++i) {
+    // Check if port is valid
+    RETURN_IF_BCM_ERROR(CheckIfPortExists(unit, ports[i]))
+        << "Port " << ports[i] << " does not exit on unit " << unit << ".";
+    RETURN_IF_BCM_ERROR(add_lookup(CTR_MACs, ports[i], &mac_entries[i]));
+    RETURN_IF_BCM_ERROR(
+        add_lookup(CTR_MAC_ERRs, ports[i], &mac_err_entries[i]));
+  }
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_commit(trans_hdl, BCMLT_PRIORITY_NORMAL));
+
+  uint64 value;
+  for (size_t i = 0; i < ports.size(); ++i) {
+    PortCounters* pc = &(*pcs)[i];
+    bcmlt_entry_handle_t entry_hdl = mac_entries[i];
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, RX_BYTESs, &value));
+    pc->set_in_octets(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, RX_UC_PKTs, &value));
+    pc->set_in_unicast_pkts(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, RX_BC_PKTs, &value));
+    pc->set_in_broadcast_pkts(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, RX_MC_PKTs, &value));
+    pc->set_in_multicast_pkts(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, TX_BYTESs, &value));
+    pc->set_out_octets(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, TX_UC_PKTs, &value));
+    pc->set_out_unicast_pkts(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, TX_BC_PKTs, &value));
+    pc->set_out_broadcast_pkts(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, TX_MC_PKTs, &value));
+    pc->set_out_multicast_pkts(value);
+    entry_hdl = mac_err_entries[i];
+    RETURN_IF_BCM_ERROR(
+        bcmlt_entry_field_get(entry_hdl, RX_FCS_ERR_PKTs, &value));
+    pc->set_in_fcs_errors(value);
+    RETURN_IF_BCM_ERROR(bcmlt_entry_field_get(entry_hdl, TX_ERR_PKTs, &value));
+    pc->set_out_errors(value);
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmSdkWrapper::InitCLI() {
   // Initialize system log output
   RETURN_IF_BCM_ERROR(bcma_bslmgmt_init());
@@ -4660,6 +4733,22 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::SetKnetHeaderPacketLength(int unit,
+                                                        size_t packet_len,
+                                                        std::string* header) {
+  CHECK_RETURN_IF_FALSE(header != nullptr);
+  // Both TX headers start with the RCPU header, which holds the only
+  // length-dependent field.
+  CHECK_RETURN_IF_FALSE(header->length() >= sizeof(RcpuHeader))
+      << "Invalid KNET header size for TX (" << header->length() << " < "
+      << sizeof(RcpuHeader) << ").";
+  struct RcpuHeader* rcpu_header =
+      reinterpret_cast<struct RcpuHeader*>(&(*header)[0]);
+  rcpu_header->rcpu_data.rcpu_payloadlen = htons(packet_len);
+
+  return ::util::OkStatus();
+}
+
 size_t BcmSdkWrapper::GetKnetHeaderSizeForRx(int unit) {
   return sizeof(RcpuHeader) + kRcpuRxMetaSize;
 }
@@ -7468,6 +7557,25 @@ inline int bcm_get_field_u32(F func, int unit, int flow_id, uint32* value,
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::GetAclStatsBatch(
+    int unit, const std::vector<int>& flow_ids,
+    std::vector<BcmAclStats>* stats, std::vector<::util::Status>* details) {
+  CHECK_RETURN_IF_FALSE(stats != nullptr) << "Null stats.";
+  stats->clear();
+  stats->resize(flow_ids.size());
+  ::util::Status status = ::util::OkStatus();
+  for (size_t i = 0; i < flow_ids.size(); ++i) {
+    ::util::Status error = GetAclStats(unit, flow_ids[i], &(*stats)[i]);
+    if (!error.ok()) {
+      // Do not return partially filled counters for the flow.
+      (*stats)[i].Clear();
+      APPEND_STATUS_IF_ERROR(status, error);
+    }
+    if (details != nullptr) details->push_back(error);
+  }
+  return status;
+}
+
 BcmSdkWrapper* BcmSdkWrapper::CreateSingleton(BcmDiagShell* bcm_diag_shell) {
   absl::WriterMutexLock l(&init_lock_);
   if (!singleton_) {
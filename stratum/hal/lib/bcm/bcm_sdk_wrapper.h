@@ -117,6 +117,8 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status GetPortOptions(int unit, int port,
                                 BcmPortOptions* options) override;
   ::util::Status GetPortCounters(int unit, int port, PortCounters* pc) override;
+  ::util::Status GetPortCountersBatch(int unit, const std::vector<int>& ports,
+                                      std::vector<PortCounters>* pcs) override;
   ::util::Status StartDiagShellServer() override;
   ::util::Status StartLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
   ::util::Status StopLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
@@ -236,6 +238,8 @@ class BcmSdkWrapper : public BcmSdkInterface {
                                           std::string* header) override;
   ::util::Status GetKnetHeaderForIngressPipelineTx(
       int unit, uint64 smac, size_t packet_len, std::string* header) override;
+  ::util::Status SetKnetHeaderPacketLength(int unit, size_t packet_len,
+                                           std::string* header) override;
   size_t GetKnetHeaderSizeForRx(int unit) override;
   ::util::Status ParseKnetHeaderForRx(int unit, const std::string& header,
                                       int* ingress_logical_port,
@@ -267,6 +271,9 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status RemoveAclStats(int unit, int flow_id) override;
   ::util::Status GetAclStats(int unit, int flow_id,
                              BcmAclStats* stats) override;
+  ::util::Status GetAclStatsBatch(int unit, const std::vector<int>& flow_ids,
+                                  std::vector<BcmAclStats>* stats,
+                                  std::vector<::util::Status>* details) override;
   ::util::Status SetAclPolicer(int unit, int flow_id,
                                const BcmMeterConfig& meter) override;
   ::util::Status InsertPacketReplicationEntry(
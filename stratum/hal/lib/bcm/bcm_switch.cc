@@ -42,12 +42,16 @@ BcmSwitch::BcmSwitch(PhalInterface* phal_interface,
     : phal_interface_(ABSL_DIE_IF_NULL(phal_interface)),
       bcm_chassis_manager_(ABSL_DIE_IF_NULL(bcm_chassis_manager)),
       unit_to_bcm_node_(unit_to_bcm_node),
-      node_id_to_bcm_node_() {
+      node_id_to_bcm_node_(),
+      unit_executor_() {
+  std::vector<int> units;
   for (auto entry : unit_to_bcm_node_) {
     CHECK_GE(entry.first, 0) << "Invalid unit number " << entry.first << ".";
     CHECK_NE(entry.second, nullptr)
         << "Detected null BcmNode for unit " << entry.first << ".";
+    units.push_back(entry.first);
   }
+  unit_executor_ = UnitExecutor::CreateInstance(units);
 }
 
 BcmSwitch::~BcmSwitch() {}
@@ -65,13 +69,31 @@ BcmSwitch::~BcmSwitch() {}
   ASSIGN_OR_RETURN(const auto& node_id_to_unit,
                    bcm_chassis_manager_->GetNodeIdToUnitMap());
   node_id_to_bcm_node_.clear();
+  std::map<int, uint64> unit_to_node_id;
+  std::map<int, bool> unit_to_pushed;
+  std::vector<int> units;
   for (const auto& entry : node_id_to_unit) {
-    uint64 node_id = entry.first;
-    int unit = entry.second;
-    ASSIGN_OR_RETURN(auto* bcm_node, GetBcmNodeFromUnit(unit));
-    RETURN_IF_ERROR(bcm_node->PushChassisConfig(config, node_id));
-    node_id_to_bcm_node_[node_id] = bcm_node;
+    RETURN_IF_ERROR(GetBcmNodeFromUnit(entry.second).status());
+    unit_to_node_id[entry.second] = entry.first;
+    unit_to_pushed[entry.second] = false;
+    units.push_back(entry.second);
   }
+  // Push the config to all the nodes concurrently, each on the thread of its
+  // unit. Only the nodes which took the config are added to
+  // node_id_to_bcm_node_, even if some other node failed.
+  ::util::Status status = unit_executor_->RunOnUnits(
+      units, [&](int unit) NO_THREAD_SAFETY_ANALYSIS -> ::util::Status {
+        RETURN_IF_ERROR(unit_to_bcm_node_.at(unit)->PushChassisConfig(
+            config, unit_to_node_id.at(unit)));
+        unit_to_pushed.at(unit) = true;
+        return ::util::OkStatus();
+      });
+  for (const auto& entry : unit_to_pushed) {
+    if (!entry.second) continue;
+    node_id_to_bcm_node_[unit_to_node_id[entry.first]] =
+        unit_to_bcm_node_.at(entry.first);
+  }
+  RETURN_IF_ERROR(status);
 
   LOG(INFO) << "Chassis config pushed successfully.";
 
@@ -140,12 +162,10 @@ BcmSwitch::~BcmSwitch() {}
     shutdown = true;
   }
 
-  // Shutdown all the managers and then PHAL at the end.
-  ::util::Status status = ::util::OkStatus();
-  for (const auto& entry : unit_to_bcm_node_) {
-    BcmNode* bcm_node = entry.second;
-    APPEND_STATUS_IF_ERROR(status, bcm_node->Shutdown());
-  }
+  // Shutdown all the nodes concurrently, then the rest of the managers and
+  // PHAL at the end.
+  ::util::Status status = unit_executor_->RunOnAllUnits(
+      [this](int unit) { return unit_to_bcm_node_.at(unit)->Shutdown(); });
   APPEND_STATUS_IF_ERROR(status, bcm_chassis_manager_->Shutdown());
   APPEND_STATUS_IF_ERROR(status, phal_interface_->Shutdown());
   node_id_to_bcm_node_.clear();
@@ -233,6 +253,17 @@ BcmSwitch::~BcmSwitch() {}
   return bcm_node->TransmitPacket(packet);
 }
 
+::util::Status BcmSwitch::TransmitPackets(
+    uint64 node_id, const std::vector<::p4::v1::PacketOut>& packets) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
+  }
+  // Get BcmNode which the node_id is associated with.
+  ASSIGN_OR_RETURN(auto* bcm_node, GetBcmNodeFromNodeId(node_id));
+  return bcm_node->TransmitPackets(packets);
+}
+
 ::util::Status BcmSwitch::RegisterEventNotifyWriter(
     std::shared_ptr<WriterInterface<GnmiEventPtr>> writer) {
   absl::ReaderMutexLock l(&chassis_lock);
@@ -485,20 +516,29 @@ std::unique_ptr<BcmSwitch> BcmSwitch::CreateInstance(
     }
   } else {
     const auto& node_id_to_unit = ret.ValueOrDie();
+    std::map<int, uint64> unit_to_node_id;
+    std::vector<int> units;
     for (const auto& entry : node_id_to_unit) {
       uint64 node_id = entry.first;
       int unit = entry.second;
-      BcmNode* bcm_node = gtl::FindPtrOrNull(unit_to_bcm_node_, unit);
-      if (bcm_node == nullptr) {
+      if (!unit_to_bcm_node_.count(unit)) {
         ::util::Status error = MAKE_ERROR(ERR_INVALID_PARAM)
                                << "Node ID " << node_id
                                << " mapped to unknown unit " << unit << ".";
         APPEND_STATUS_IF_ERROR(status, error);
         continue;
       }
-      APPEND_STATUS_IF_ERROR(status,
-                             bcm_node->VerifyChassisConfig(config, node_id));
+      unit_to_node_id[unit] = node_id;
+      units.push_back(unit);
     }
+    // Verify the config on all the nodes concurrently.
+    APPEND_STATUS_IF_ERROR(
+        status,
+        unit_executor_->RunOnUnits(
+            units, [&](int unit) NO_THREAD_SAFETY_ANALYSIS {
+              return unit_to_bcm_node_.at(unit)->VerifyChassisConfig(
+                  config, unit_to_node_id.at(unit));
+            }));
   }
 
   if (status.ok()) {
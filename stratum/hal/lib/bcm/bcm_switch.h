@@ -29,6 +29,7 @@
 #include "stratum/hal/lib/bcm/bcm_node.h"
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/unit_executor.h"
 #include "stratum/glue/integral_types.h"
 #include "absl/synchronization/mutex.h"
 
@@ -78,6 +79,9 @@ class BcmSwitch : public SwitchInterface {
   ::util::Status TransmitPacket(uint64 node_id,
                                 const ::p4::v1::PacketOut& packet) override
       LOCKS_EXCLUDED(chassis_lock);
+  ::util::Status TransmitPackets(
+      uint64 node_id, const std::vector<::p4::v1::PacketOut>& packets) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status RegisterEventNotifyWriter(
       std::shared_ptr<WriterInterface<GnmiEventPtr>> writer) override
       LOCKS_EXCLUDED(chassis_lock);
@@ -144,6 +148,10 @@ class BcmSwitch : public SwitchInterface {
   // which had a successful config push.
   std::map<uint64, BcmNode*> node_id_to_bcm_node_;  //  pointers not owned
 
+  // Runs the chassis-level operations (config push/verify, shutdown) on all
+  // the nodes concurrently, with one thread per unit in unit_to_bcm_node_.
+  std::unique_ptr<UnitExecutor> unit_executor_;
+
   friend class BcmSwitchTest;
 };
 
@@ -0,0 +1,603 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// This binary measures the end-to-end flow programming performance of
+// BcmSwitch, from the P4Runtime WriteRequest down to the BCM SDK calls. The
+// full BCM stack (chassis, table, ACL, L2, L3, tunnel and packetio managers,
+// node and switch) runs on top of BcmSdkFake, an in-memory SDK with a
+// configurable per-call latency, in place of the real SDK or the simulator.
+// For each workload and each number of entries, the binary inserts the entries
+// in batches of --batch_size updates, reads them back and deletes them, and
+// reports the updates/sec, the p50/p99 batch latency and the RSS. Workloads:
+//   lpm:  IPv4 routes pointing to one action profile member per port.
+//   ecmp: IPv4 routes pointing to --num_ecmp_groups action profile groups of
+//         --ecmp_group_size members each.
+//   acl:  ternary punt_table entries.
+// Example:
+//   bcm_switch_benchmark --workloads=lpm,ecmp,acl \
+//       --num_entries=1000,10000,100000,500000 --sdk_call_latency_us=5
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/bcm/bcm_acl_manager.h"
+#include "stratum/hal/lib/bcm/bcm_chassis_manager.h"
+#include "stratum/hal/lib/bcm/bcm_global_vars.h"
+#include "stratum/hal/lib/bcm/bcm_l2_manager.h"
+#include "stratum/hal/lib/bcm/bcm_l3_manager.h"
+#include "stratum/hal/lib/bcm/bcm_node.h"
+#include "stratum/hal/lib/bcm/bcm_packetio_manager.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_fake.h"
+#include "stratum/hal/lib/bcm/bcm_serdes_db_manager.h"
+#include "stratum/hal/lib/bcm/bcm_switch.h"
+#include "stratum/hal/lib/bcm/bcm_table_manager.h"
+#include "stratum/hal/lib/bcm/bcm_tunnel_manager.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/constants.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_pipeline_config.pb.h"
+#include "stratum/hal/lib/p4/p4_table_mapper.h"
+#include "stratum/hal/lib/phal/phal_sim.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(base_bcm_chassis_map_file);
+DECLARE_string(applied_bcm_chassis_map_file);
+DECLARE_string(bcm_hardware_specs_file);
+DECLARE_string(bcm_sdk_checkpoint_dir);
+DECLARE_string(bcm_sdk_config_file);
+DECLARE_string(bcm_sdk_config_flush_file);
+DECLARE_string(bcm_sdk_shell_log_file);
+
+DEFINE_string(platform_dir, "stratum/hal/config/x86-64-accton-as7712-32x-r0",
+              "Dir with the chassis_config.pb.txt and "
+              "base_bcm_chassis_map.pb.txt files of the benchmarked platform.");
+DEFINE_string(hardware_specs_file,
+              "stratum/hal/config/bcm_hardware_specs.pb.txt",
+              "Path to the BCM hardware specs file of the ACL manager.");
+DEFINE_string(p4_info_file, "stratum/pipelines/main/fpm/main.p4info",
+              "Path to the P4Info text file pushed to the switch.");
+DEFINE_string(p4_pipeline_config_file, "stratum/pipelines/main/fpm/main.pb.txt",
+              "Path to the P4PipelineConfig text file pushed to the switch.");
+DEFINE_string(dir, "/tmp/bcm_switch_benchmark",
+              "Dir where the BCM config files generated by the chassis "
+              "manager are written.");
+DEFINE_string(workloads, "lpm,ecmp,acl",
+              "Comma-separated list of the workloads to run: lpm, ecmp, acl.");
+DEFINE_string(num_entries, "1000,10000,100000",
+              "Comma-separated list of the numbers of table entries each "
+              "workload is run with.");
+DEFINE_int32(batch_size, 100, "Number of updates per WriteRequest.");
+DEFINE_int32(sdk_call_latency_us, 0,
+             "Latency added to every BCM SDK call, in microseconds.");
+DEFINE_int32(num_ecmp_groups, 256,
+             "Number of action profile groups used by the ecmp workload.");
+DEFINE_int32(ecmp_group_size, 8,
+             "Number of members of each action profile group used by the "
+             "ecmp workload.");
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+constexpr int kUnit = 0;
+constexpr int kVrf = 10;
+constexpr uint64 kRouterMac = 0x000011223344ULL;
+constexpr uint64 kFirstNexthopMac = 0x0000aa000000ULL;
+constexpr uint32 kFirstSubnet = 0x0b000000;  // 11.0.0.0/24
+
+constexpr char kL3FwdTable[] = "ingress.l3_fwd.l3_fwd_table";
+constexpr char kWcmpActionProfile[] = "ingress.l3_fwd.wcmp_action_profile";
+constexpr char kSetNexthopAction[] = "ingress.l3_fwd.set_nexthop";
+constexpr char kPuntTable[] = "ingress.punt.punt_table";
+constexpr char kSendToCpuAction[] = "ingress.punt.set_queue_and_send_to_cpu";
+
+// The BCM stack of a single unit on top of BcmSdkFake, put together the same
+// way as by the BCM switch binary.
+struct BcmStack {
+  std::unique_ptr<BcmSdkFake> bcm_sdk_fake;
+  std::unique_ptr<PhalSim> phal_sim;
+  std::unique_ptr<BcmSerdesDbManager> bcm_serdes_db_manager;
+  std::unique_ptr<BcmChassisManager> bcm_chassis_manager;
+  std::unique_ptr<P4TableMapper> p4_table_mapper;
+  std::unique_ptr<BcmTableManager> bcm_table_manager;
+  std::unique_ptr<BcmAclManager> bcm_acl_manager;
+  std::unique_ptr<BcmL2Manager> bcm_l2_manager;
+  std::unique_ptr<BcmL3Manager> bcm_l3_manager;
+  std::unique_ptr<BcmTunnelManager> bcm_tunnel_manager;
+  std::unique_ptr<BcmPacketioManager> bcm_packetio_manager;
+  std::unique_ptr<BcmNode> bcm_node;
+  std::unique_ptr<BcmSwitch> bcm_switch;
+};
+
+void CreateBcmStack(BcmStack* stack) {
+  stack->bcm_sdk_fake = BcmSdkFake::CreateInstance();
+  stack->phal_sim = absl::WrapUnique(PhalSim::CreateSingleton());
+  stack->bcm_serdes_db_manager = BcmSerdesDbManager::CreateInstance();
+  stack->bcm_chassis_manager = BcmChassisManager::CreateInstance(
+      OPERATION_MODE_SIM, stack->phal_sim.get(), stack->bcm_sdk_fake.get(),
+      stack->bcm_serdes_db_manager.get());
+  stack->p4_table_mapper = P4TableMapper::CreateInstance();
+  stack->bcm_table_manager = BcmTableManager::CreateInstance(
+      stack->bcm_chassis_manager.get(), stack->p4_table_mapper.get(), kUnit);
+  stack->bcm_acl_manager = BcmAclManager::CreateInstance(
+      stack->bcm_chassis_manager.get(), stack->bcm_table_manager.get(),
+      stack->bcm_sdk_fake.get(), stack->p4_table_mapper.get(), kUnit);
+  stack->bcm_l2_manager = BcmL2Manager::CreateInstance(
+      stack->bcm_chassis_manager.get(), stack->bcm_sdk_fake.get(), kUnit);
+  stack->bcm_l3_manager = BcmL3Manager::CreateInstance(
+      stack->bcm_sdk_fake.get(), stack->bcm_table_manager.get(), kUnit);
+  stack->bcm_tunnel_manager = BcmTunnelManager::CreateInstance(
+      stack->bcm_sdk_fake.get(), stack->bcm_table_manager.get(), kUnit);
+  stack->bcm_packetio_manager = BcmPacketioManager::CreateInstance(
+      OPERATION_MODE_SIM, stack->bcm_chassis_manager.get(),
+      stack->p4_table_mapper.get(), stack->bcm_sdk_fake.get(), kUnit);
+  stack->bcm_node = BcmNode::CreateInstance(
+      stack->bcm_acl_manager.get(), stack->bcm_l2_manager.get(),
+      stack->bcm_l3_manager.get(), stack->bcm_packetio_manager.get(),
+      stack->bcm_table_manager.get(), stack->bcm_tunnel_manager.get(),
+      stack->p4_table_mapper.get(), kUnit);
+  std::map<int, BcmNode*> unit_to_bcm_node;
+  unit_to_bcm_node[kUnit] = stack->bcm_node.get();
+  stack->bcm_switch =
+      BcmSwitch::CreateInstance(stack->phal_sim.get(),
+                                stack->bcm_chassis_manager.get(),
+                                unit_to_bcm_node);
+}
+
+// Counts the entities read back from the switch.
+class EntityCounter : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  EntityCounter() : num_entities_(0) {}
+  bool Write(const ::p4::v1::ReadResponse& resp) override {
+    num_entities_ += resp.entities_size();
+    return true;
+  }
+  int64 num_entities() const { return num_entities_; }
+
+ private:
+  int64 num_entities_;
+};
+
+// Returns the big endian encoding of the value on the given number of bytes.
+std::string Encode(uint64 value, int num_bytes) {
+  std::string bytes(num_bytes, 0);
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    bytes[i] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  return bytes;
+}
+
+int NumBytes(int bitwidth) { return (bitwidth + 7) / 8; }
+
+// Returns the resident set size of the process in KB, or -1 if unknown.
+int64 GetRssKb() {
+  std::string proc_status;
+  if (!ReadFileToString("/proc/self/status", &proc_status).ok()) return -1;
+  for (absl::string_view line : absl::StrSplit(proc_status, '\n')) {
+    if (!absl::ConsumePrefix(&line, "VmRSS:")) continue;
+    line = absl::StripAsciiWhitespace(line);
+    absl::ConsumeSuffix(&line, "kB");
+    int64 rss_kb;
+    if (absl::SimpleAtoi(absl::StripAsciiWhitespace(line), &rss_kb)) {
+      return rss_kb;
+    }
+  }
+  return -1;
+}
+
+// Returns the percentile of the sorted latencies.
+absl::Duration Percentile(const std::vector<absl::Duration>& latencies,
+                          double percentile) {
+  if (latencies.empty()) return absl::ZeroDuration();
+  size_t index = static_cast<size_t>(latencies.size() * percentile / 100);
+  return latencies[std::min(index, latencies.size() - 1)];
+}
+
+// Builds the entities of the workloads from the P4Info pushed to the switch.
+class EntityBuilder {
+ public:
+  EntityBuilder(const P4InfoManager& p4_info_manager,
+                const ChassisConfig& chassis_config)
+      : p4_info_manager_(p4_info_manager) {
+    for (const auto& singleton_port : chassis_config.singleton_ports()) {
+      port_ids_.push_back(singleton_port.id());
+    }
+  }
+
+  ::util::Status Initialize() {
+    CHECK_RETURN_IF_FALSE(!port_ids_.empty())
+        << "No singleton ports in the chassis config.";
+    ASSIGN_OR_RETURN(l3_fwd_table_,
+                     p4_info_manager_.FindTableByName(kL3FwdTable));
+    ASSIGN_OR_RETURN(wcmp_action_profile_,
+                     p4_info_manager_.FindActionProfileByName(
+                         kWcmpActionProfile));
+    ASSIGN_OR_RETURN(set_nexthop_action_,
+                     p4_info_manager_.FindActionByName(kSetNexthopAction));
+    ASSIGN_OR_RETURN(punt_table_, p4_info_manager_.FindTableByName(kPuntTable));
+    ASSIGN_OR_RETURN(send_to_cpu_action_,
+                     p4_info_manager_.FindActionByName(kSendToCpuAction));
+    return ::util::OkStatus();
+  }
+
+  // An action profile member setting a nexthop on one of the ports, with a
+  // distinct nexthop MAC for each member.
+  ::p4::v1::Entity Member(int member_id) const {
+    ::p4::v1::Entity entity;
+    auto* member = entity.mutable_action_profile_member();
+    member->set_action_profile_id(wcmp_action_profile_.preamble().id());
+    member->set_member_id(member_id);
+    auto* action = member->mutable_action();
+    action->set_action_id(set_nexthop_action_.preamble().id());
+    for (const auto& p : set_nexthop_action_.params()) {
+      uint64 value = 0;
+      if (p.name() == "port") {
+        value = port_ids_[member_id % port_ids_.size()];
+      } else if (p.name() == "smac") {
+        value = kRouterMac;
+      } else if (p.name() == "dmac") {
+        value = kFirstNexthopMac + member_id;
+      } else if (p.name() == "dst_vlan") {
+        value = kDefaultVlan;
+      }
+      auto* param = action->add_params();
+      param->set_param_id(p.id());
+      param->set_value(Encode(value, NumBytes(p.bitwidth())));
+    }
+    return entity;
+  }
+
+  // An action profile group made of the given members.
+  ::p4::v1::Entity Group(int group_id, int first_member_id,
+                         int num_members) const {
+    ::p4::v1::Entity entity;
+    auto* group = entity.mutable_action_profile_group();
+    group->set_action_profile_id(wcmp_action_profile_.preamble().id());
+    group->set_group_id(group_id);
+    for (int i = 0; i < num_members; ++i) {
+      auto* member = group->add_members();
+      member->set_member_id(first_member_id + i);
+      member->set_weight(1);
+    }
+    return entity;
+  }
+
+  // A /24 IPv4 route pointing to an action profile member or group.
+  ::p4::v1::Entity Route(int index, int member_or_group_id,
+                         bool is_group) const {
+    ::p4::v1::Entity entity;
+    auto* table_entry = entity.mutable_table_entry();
+    table_entry->set_table_id(l3_fwd_table_.preamble().id());
+    for (const auto& f : l3_fwd_table_.match_fields()) {
+      auto* match = table_entry->add_match();
+      match->set_field_id(f.id());
+      if (f.match_type() == ::p4::config::v1::MatchField::EXACT) {
+        match->mutable_exact()->set_value(
+            Encode(kVrf, NumBytes(f.bitwidth())));
+      } else if (f.match_type() == ::p4::config::v1::MatchField::LPM) {
+        match->mutable_lpm()->set_value(
+            Encode(kFirstSubnet + (static_cast<uint32>(index) << 8),
+                   NumBytes(f.bitwidth())));
+        match->mutable_lpm()->set_prefix_len(24);
+      }
+    }
+    if (is_group) {
+      table_entry->mutable_action()->set_action_profile_group_id(
+          member_or_group_id);
+    } else {
+      table_entry->mutable_action()->set_action_profile_member_id(
+          member_or_group_id);
+    }
+    return entity;
+  }
+
+  // A punt_table entry matching the IPv4 packets to a /32 destination.
+  ::p4::v1::Entity AclEntry(int index) const {
+    ::p4::v1::Entity entity;
+    auto* table_entry = entity.mutable_table_entry();
+    table_entry->set_table_id(punt_table_.preamble().id());
+    for (const auto& f : punt_table_.match_fields()) {
+      uint64 value;
+      if (f.name() == "hdr.ethernet.ether_type") {
+        value = 0x0800;
+      } else if (f.name() == "hdr.ipv4_base.dst_addr") {
+        value = kFirstSubnet + index;
+      } else {
+        continue;
+      }
+      auto* match = table_entry->add_match();
+      match->set_field_id(f.id());
+      match->mutable_ternary()->set_value(
+          Encode(value, NumBytes(f.bitwidth())));
+      match->mutable_ternary()->set_mask(
+          std::string(NumBytes(f.bitwidth()), '\xff'));
+    }
+    table_entry->set_priority(index + 1);
+    auto* action = table_entry->mutable_action()->mutable_action();
+    action->set_action_id(send_to_cpu_action_.preamble().id());
+    for (const auto& p : send_to_cpu_action_.params()) {
+      auto* param = action->add_params();
+      param->set_param_id(p.id());
+      param->set_value(Encode(1, NumBytes(p.bitwidth())));
+    }
+    return entity;
+  }
+
+  uint32 l3_fwd_table_id() const { return l3_fwd_table_.preamble().id(); }
+  uint32 punt_table_id() const { return punt_table_.preamble().id(); }
+  int num_ports() const { return port_ids_.size(); }
+
+ private:
+  const P4InfoManager& p4_info_manager_;
+  std::vector<uint64> port_ids_;
+  ::p4::config::v1::Table l3_fwd_table_;
+  ::p4::config::v1::ActionProfile wcmp_action_profile_;
+  ::p4::config::v1::Action set_nexthop_action_;
+  ::p4::config::v1::Table punt_table_;
+  ::p4::config::v1::Action send_to_cpu_action_;
+};
+
+// Writes the entities with the given update type in batches of --batch_size
+// updates, and saves the latency of each batch.
+::util::Status WriteEntities(BcmSwitch* bcm_switch, uint64 node_id,
+                             const std::vector<::p4::v1::Entity>& entities,
+                             ::p4::v1::Update::Type type,
+                             std::vector<absl::Duration>* latencies) {
+  for (size_t i = 0; i < entities.size(); i += FLAGS_batch_size) {
+    ::p4::v1::WriteRequest req;
+    req.set_device_id(node_id);
+    size_t end = std::min(entities.size(), i + FLAGS_batch_size);
+    for (size_t j = i; j < end; ++j) {
+      auto* update = req.add_updates();
+      update->set_type(type);
+      *update->mutable_entity() = entities[j];
+    }
+    std::vector<::util::Status> results;
+    absl::Time start = absl::Now();
+    ::util::Status status = bcm_switch->WriteForwardingEntries(req, &results);
+    if (latencies) latencies->push_back(absl::Now() - start);
+    if (!status.ok()) {
+      for (const auto& result : results) {
+        if (!result.ok()) {
+          return APPEND_ERROR(status) << " " << result.error_message();
+        }
+      }
+      return status;
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+// Runs a workload with the given number of table entries and logs its stats.
+// The switch is left with no entries.
+::util::Status RunWorkload(BcmSwitch* bcm_switch, uint64 node_id,
+                           const EntityBuilder& builder,
+                           const std::string& workload, int num_entries) {
+  // The members and groups the routes point to are not part of the measure.
+  std::vector<::p4::v1::Entity> members, groups, entries;
+  uint32 table_id;
+  if (workload == "lpm") {
+    for (int i = 0; i < builder.num_ports(); ++i) {
+      members.push_back(builder.Member(i + 1));
+    }
+    for (int i = 0; i < num_entries; ++i) {
+      entries.push_back(builder.Route(i, i % members.size() + 1, false));
+    }
+    table_id = builder.l3_fwd_table_id();
+  } else if (workload == "ecmp") {
+    // Each group has its own members, so that it maps to a distinct ECMP
+    // egress intf.
+    for (int i = 0; i < FLAGS_num_ecmp_groups * FLAGS_ecmp_group_size; ++i) {
+      members.push_back(builder.Member(i + 1));
+    }
+    for (int i = 0; i < FLAGS_num_ecmp_groups; ++i) {
+      groups.push_back(builder.Group(i + 1, i * FLAGS_ecmp_group_size + 1,
+                                     FLAGS_ecmp_group_size));
+    }
+    for (int i = 0; i < num_entries; ++i) {
+      entries.push_back(builder.Route(i, i % groups.size() + 1, true));
+    }
+    table_id = builder.l3_fwd_table_id();
+  } else if (workload == "acl") {
+    for (int i = 0; i < num_entries; ++i) {
+      entries.push_back(builder.AclEntry(i));
+    }
+    table_id = builder.punt_table_id();
+  } else {
+    return MAKE_ERROR(ERR_INVALID_PARAM) << "Unknown workload " << workload
+                                         << ".";
+  }
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, members,
+                                ::p4::v1::Update::INSERT, nullptr));
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, groups,
+                                ::p4::v1::Update::INSERT, nullptr));
+
+  int64 rss_before_kb = GetRssKb();
+  std::vector<absl::Duration> insert_latencies;
+  absl::Time start = absl::Now();
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, entries,
+                                ::p4::v1::Update::INSERT, &insert_latencies));
+  double insert_secs = absl::ToDoubleSeconds(absl::Now() - start);
+  int64 rss_after_kb = GetRssKb();
+
+  ::p4::v1::ReadRequest read_req;
+  read_req.set_device_id(node_id);
+  read_req.add_entities()->mutable_table_entry()->set_table_id(table_id);
+  EntityCounter counter;
+  std::vector<::util::Status> details;
+  start = absl::Now();
+  RETURN_IF_ERROR(
+      bcm_switch->ReadForwardingEntries(read_req, &counter, &details));
+  double read_secs = absl::ToDoubleSeconds(absl::Now() - start);
+  CHECK_RETURN_IF_FALSE(counter.num_entities() == num_entries)
+      << "Read " << counter.num_entities() << " entries back instead of "
+      << num_entries << ".";
+
+  std::reverse(entries.begin(), entries.end());
+  std::vector<absl::Duration> delete_latencies;
+  start = absl::Now();
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, entries,
+                                ::p4::v1::Update::DELETE, &delete_latencies));
+  double delete_secs = absl::ToDoubleSeconds(absl::Now() - start);
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, groups,
+                                ::p4::v1::Update::DELETE, nullptr));
+  RETURN_IF_ERROR(WriteEntities(bcm_switch, node_id, members,
+                                ::p4::v1::Update::DELETE, nullptr));
+
+  std::sort(insert_latencies.begin(), insert_latencies.end());
+  std::sort(delete_latencies.begin(), delete_latencies.end());
+  LOG(INFO) << workload << ", " << num_entries << " entries: insert "
+            << (insert_secs > 0 ? num_entries / insert_secs : 0)
+            << " updates/sec (p50 " << Percentile(insert_latencies, 50)
+            << ", p99 " << Percentile(insert_latencies, 99)
+            << " per batch), read "
+            << (read_secs > 0 ? num_entries / read_secs : 0)
+            << " entries/sec, delete "
+            << (delete_secs > 0 ? num_entries / delete_secs : 0)
+            << " updates/sec (p50 " << Percentile(delete_latencies, 50)
+            << ", p99 " << Percentile(delete_latencies, 99)
+            << " per batch), RSS " << rss_after_kb << " KB (+"
+            << rss_after_kb - rss_before_kb << " KB).";
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  InitStratumLogging();
+  CHECK_RETURN_IF_FALSE(FLAGS_batch_size > 0 && FLAGS_num_ecmp_groups > 0 &&
+                        FLAGS_ecmp_group_size > 0 &&
+                        FLAGS_sdk_call_latency_us >= 0)
+      << "--batch_size, --num_ecmp_groups and --ecmp_group_size must be "
+      << "positive, --sdk_call_latency_us must not be negative.";
+  std::vector<int> num_entries_list;
+  for (absl::string_view s :
+       absl::StrSplit(FLAGS_num_entries, ',', absl::SkipEmpty())) {
+    int num_entries;
+    CHECK_RETURN_IF_FALSE(absl::SimpleAtoi(s, &num_entries) && num_entries > 0)
+        << "Invalid --num_entries " << FLAGS_num_entries << ".";
+    num_entries_list.push_back(num_entries);
+  }
+  CHECK_RETURN_IF_FALSE(!num_entries_list.empty()) << "Empty --num_entries.";
+
+  // Same flags as the ones set by the BCM switch binary deployment scripts.
+  FLAGS_base_bcm_chassis_map_file =
+      absl::StrCat(FLAGS_platform_dir, "/base_bcm_chassis_map.pb.txt");
+  FLAGS_bcm_hardware_specs_file = FLAGS_hardware_specs_file;
+  FLAGS_applied_bcm_chassis_map_file =
+      absl::StrCat(FLAGS_dir, "/applied_bcm_chassis_map.pb.txt");
+  FLAGS_bcm_sdk_config_file = absl::StrCat(FLAGS_dir, "/config.bcm");
+  FLAGS_bcm_sdk_config_flush_file = absl::StrCat(FLAGS_dir, "/config.bcm.tmp");
+  FLAGS_bcm_sdk_shell_log_file = absl::StrCat(FLAGS_dir, "/bcm.log");
+  FLAGS_bcm_sdk_checkpoint_dir = absl::StrCat(FLAGS_dir, "/sdk_checkpoint");
+  RETURN_IF_ERROR(RecursivelyCreateDir(FLAGS_dir));
+
+  ChassisConfig chassis_config;
+  RETURN_IF_ERROR(ReadProtoFromTextFile(
+      absl::StrCat(FLAGS_platform_dir, "/chassis_config.pb.txt"),
+      &chassis_config));
+  CHECK_RETURN_IF_FALSE(chassis_config.nodes_size() == 1)
+      << "The chassis config must have exactly one node.";
+  const uint64 node_id = chassis_config.nodes(0).id();
+
+  // The P4 table size of the ACL tables is their max number of entries, so
+  // the punt table is made large enough for the benchmark.
+  ::p4::v1::ForwardingPipelineConfig config;
+  RETURN_IF_ERROR(
+      ReadProtoFromTextFile(FLAGS_p4_info_file, config.mutable_p4info()));
+  int max_num_entries =
+      *std::max_element(num_entries_list.begin(), num_entries_list.end());
+  for (auto& table : *config.mutable_p4info()->mutable_tables()) {
+    if (table.preamble().name() == kPuntTable) {
+      table.set_size(std::max<int64>(table.size(), max_num_entries));
+    }
+  }
+  P4PipelineConfig p4_pipeline_config;
+  RETURN_IF_ERROR(ReadProtoFromTextFile(FLAGS_p4_pipeline_config_file,
+                                        &p4_pipeline_config));
+  CHECK_RETURN_IF_FALSE(p4_pipeline_config.SerializeToString(
+      config.mutable_p4_device_config()));
+  P4InfoManager p4_info_manager(config.p4info());
+  RETURN_IF_ERROR(p4_info_manager.InitializeAndVerify());
+  EntityBuilder builder(p4_info_manager, chassis_config);
+  RETURN_IF_ERROR(builder.Initialize());
+
+  BcmStack stack;
+  CreateBcmStack(&stack);
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    shutdown = false;
+  }
+  RETURN_IF_ERROR(stack.bcm_switch->PushChassisConfig(chassis_config));
+  RETURN_IF_ERROR(
+      stack.bcm_switch->PushForwardingPipelineConfig(node_id, config));
+  // The latency only applies to flow programming, not to the setup above.
+  stack.bcm_sdk_fake->SetCallLatency(
+      absl::Microseconds(FLAGS_sdk_call_latency_us));
+
+  ::util::Status status = ::util::OkStatus();
+  for (absl::string_view workload :
+       absl::StrSplit(FLAGS_workloads, ',', absl::SkipEmpty())) {
+    for (int num_entries : num_entries_list) {
+      status = RunWorkload(stack.bcm_switch.get(), node_id, builder,
+                           std::string(workload), num_entries);
+      if (!status.ok()) break;
+    }
+    if (!status.ok()) break;
+  }
+  stack.bcm_sdk_fake->SetCallLatency(absl::ZeroDuration());
+  APPEND_STATUS_IF_ERROR(status, stack.bcm_switch->Shutdown());
+
+  return status;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::util::Status status = stratum::hal::bcm::Main(argc, argv);
+  if (status.ok()) {
+    return 0;
+  } else {
+    LOG(ERROR) << status;
+    return 1;
+  }
+}
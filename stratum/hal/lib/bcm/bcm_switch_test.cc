@@ -32,12 +32,14 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/blocking_counter.h"
 
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Pointee;
 using ::testing::Return;
 using ::testing::Sequence;
@@ -245,6 +247,63 @@ TEST_F(BcmSwitchTest, PushChassisConfigFailureWhenNodePushFails) {
               DerivedFromStatus(DefaultError()));
 }
 
+TEST_F(BcmSwitchTest, PushChassisConfigPushesToAllNodesConcurrently) {
+  constexpr uint64 kNodeId2 = kNodeId + 1;
+  constexpr int kUnit2 = kUnit + 1;
+  auto bcm_node_mock2 = absl::make_unique<BcmNodeMock>();
+  unit_to_bcm_node_mock_[kUnit2] = bcm_node_mock2.get();
+  bcm_switch_ = BcmSwitch::CreateInstance(phal_mock_.get(),
+                                          bcm_chassis_manager_mock_.get(),
+                                          unit_to_bcm_node_mock_);
+  ON_CALL(*bcm_chassis_manager_mock_, GetNodeIdToUnitMap())
+      .WillByDefault(Return(
+          std::map<uint64, int>({{kNodeId, kUnit}, {kNodeId2, kUnit2}})));
+
+  ChassisConfig config;
+  config.add_nodes()->set_id(kNodeId);
+  config.add_nodes()->set_id(kNodeId2);
+  EXPECT_CALL(*phal_mock_, VerifyChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_chassis_manager_mock_,
+              VerifyChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_node_mock_,
+              VerifyChassisConfig(EqualsProto(config), kNodeId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_node_mock2,
+              VerifyChassisConfig(EqualsProto(config), kNodeId2))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*phal_mock_, PushChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_chassis_manager_mock_,
+              PushChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  // Each node waits for the other one to start its push, which only completes
+  // if the nodes are programmed in parallel.
+  absl::BlockingCounter pushing(2);
+  auto wait_for_all_nodes = [&pushing]() {
+    pushing.DecrementCount();
+    pushing.Wait();
+    return ::util::OkStatus();
+  };
+  EXPECT_CALL(*bcm_node_mock_, PushChassisConfig(EqualsProto(config), kNodeId))
+      .WillOnce(InvokeWithoutArgs(wait_for_all_nodes));
+  EXPECT_CALL(*bcm_node_mock2,
+              PushChassisConfig(EqualsProto(config), kNodeId2))
+      .WillOnce(InvokeWithoutArgs(wait_for_all_nodes));
+
+  EXPECT_OK(bcm_switch_->PushChassisConfig(config));
+
+  // Both nodes are now reachable by node ID.
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId2);
+  req.add_updates();
+  std::vector<::util::Status> results;
+  EXPECT_CALL(*bcm_node_mock2, WriteForwardingEntries(_, &results))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(bcm_switch_->WriteForwardingEntries(req, &results));
+}
+
 TEST_F(BcmSwitchTest, VerifyChassisConfigSuccess) {
   ChassisConfig config;
   config.add_nodes()->set_id(kNodeId);
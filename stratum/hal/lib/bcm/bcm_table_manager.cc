@@ -16,6 +16,7 @@
 
 #include "stratum/hal/lib/bcm/bcm_table_manager.h"
 
+#include <memory>
 #include <string>
 
 #include "google/protobuf/message.h"
@@ -29,6 +30,7 @@
 #include "stratum/glue/integral_types.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "stratum/glue/gtl/map_util.h"
@@ -271,8 +273,259 @@ template <class C>  // Iterable collection of P4 colors.
   return ::util::OkStatus();
 }
 
+// Writes the ActionProfileMembers in the given map which belong to one of the
+// given action profiles (or all of them if action_profile_ids is empty).
+::util::Status ReadActionProfileMembersFromMap(
+    const absl::flat_hash_map<uint32, ::p4::v1::ActionProfileMember>& members,
+    const std::set<uint32>& action_profile_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  if (writer == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
+  }
+
+  ::p4::v1::ReadResponse resp;
+  for (const auto& member : members) {
+    if (action_profile_ids.empty() ||
+        action_profile_ids.count(member.second.action_profile_id())) {
+      auto* entity = resp.add_entities();
+      *entity->mutable_action_profile_member() = member.second;
+    }
+  }
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+// Writes the ActionProfileGroups in the given map which belong to one of the
+// given action profiles (or all of them if action_profile_ids is empty).
+::util::Status ReadActionProfileGroupsFromMap(
+    const absl::flat_hash_map<uint32, ::p4::v1::ActionProfileGroup>& groups,
+    const std::set<uint32>& action_profile_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  if (writer == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
+  }
+
+  ::p4::v1::ReadResponse resp;
+  for (const auto& group : groups) {
+    if (action_profile_ids.empty() ||
+        action_profile_ids.count(group.second.action_profile_id())) {
+      auto* entity = resp.add_entities();
+      *entity->mutable_action_profile_group() = group.second;
+    }
+  }
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+// Writes the MulticastGroupEntries in the given map with the given ids (or
+// all of them if multicast_group_ids is empty).
+::util::Status ReadMulticastGroupsFromMap(
+    const absl::flat_hash_map<uint32, ::p4::v1::MulticastGroupEntry>&
+        multicast_groups,
+    const std::set<uint32>& multicast_group_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  if (writer == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
+  }
+
+  ::p4::v1::ReadResponse resp;
+  for (const auto& group : multicast_groups) {
+    if (multicast_group_ids.empty() ||
+        multicast_group_ids.count(group.second.multicast_group_id())) {
+      auto* entity = resp.add_entities();
+      *entity->mutable_packet_replication_engine_entry()
+          ->mutable_multicast_group_entry() = group.second;
+    }
+  }
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+// Writes the CloneSessionEntries in the given map with the given ids (or all
+// of them if clone_session_ids is empty).
+::util::Status ReadCloneSessionsFromMap(
+    const absl::flat_hash_map<uint32, ::p4::v1::CloneSessionEntry>&
+        clone_sessions,
+    const std::set<uint32>& clone_session_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  if (writer == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
+  }
+
+  ::p4::v1::ReadResponse resp;
+  for (const auto& session : clone_sessions) {
+    if (clone_session_ids.empty() ||
+        clone_session_ids.count(session.second.session_id())) {
+      auto* entity = resp.add_entities();
+      *entity->mutable_packet_replication_engine_entry()
+          ->mutable_clone_session_entry() = session.second;
+    }
+  }
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
 }  // namespace
 
+constexpr size_t BcmTableManager::ReadSnapshot::Table::kNumChunks;
+
+size_t BcmTableManager::ReadSnapshot::Table::ChunkIndex(
+    const std::string& match_key) {
+  return absl::Hash<std::string>()(match_key) % kNumChunks;
+}
+
+BcmTableManager::ReadSnapshot::ReadSnapshot()
+    : version_(0),
+      tables_(),
+      members_(std::make_shared<const absl::flat_hash_map<
+                   uint32, ::p4::v1::ActionProfileMember>>()),
+      groups_(std::make_shared<const absl::flat_hash_map<
+                  uint32, ::p4::v1::ActionProfileGroup>>()),
+      multicast_groups_(std::make_shared<const absl::flat_hash_map<
+                            uint32, ::p4::v1::MulticastGroupEntry>>()),
+      clone_sessions_(std::make_shared<const absl::flat_hash_map<
+                          uint32, ::p4::v1::CloneSessionEntry>>()) {}
+
+::util::Status BcmTableManager::ReadSnapshot::ForEachTableEntry(
+    const std::set<uint32>& table_ids,
+    const std::function<::util::Status(const ::p4::v1::TableEntry& entry,
+                                       bool is_acl, int bcm_acl_id)>& visitor)
+    const {
+  auto visit_table = [&visitor](const Table& table) -> ::util::Status {
+    // We shouldn't return static flows.
+    if (table.is_const) return ::util::OkStatus();
+    for (const auto& chunk : table.chunks) {
+      if (chunk == nullptr) continue;
+      for (const auto& pair : *chunk) {
+        RETURN_IF_ERROR(visitor(pair.second->entry, table.is_acl,
+                                pair.second->bcm_acl_id));
+      }
+    }
+    return ::util::OkStatus();
+  };
+
+  // Visit all tables if no table ids were specified. Generic tables go first.
+  if (table_ids.empty()) {
+    for (bool is_acl : {false, true}) {
+      for (const auto& pair : tables_) {
+        if (pair.second->is_acl != is_acl) continue;
+        RETURN_IF_ERROR(visit_table(*pair.second));
+      }
+    }
+  } else {
+    // Lookup each provided table id.
+    for (uint32 table_id : table_ids) {
+      const auto* lookup = gtl::FindOrNull(tables_, table_id);
+      if (lookup) RETURN_IF_ERROR(visit_table(**lookup));
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> BcmTableManager::ReadSnapshot::FindBcmAclId(
+    const ::p4::v1::TableEntry& entry) const {
+  const auto* table = gtl::FindOrNull(tables_, entry.table_id());
+  if (table == nullptr || !(*table)->is_acl) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Table " << entry.table_id() << " is not an ACL table.";
+  }
+  std::string match_key = (*table)->layout->MakeKey(entry);
+  const auto& chunk = (*table)->chunks[Table::ChunkIndex(match_key)];
+  const std::shared_ptr<const Entry>* lookup =
+      chunk == nullptr ? nullptr : gtl::FindOrNull(*chunk, match_key);
+  if (lookup == nullptr || (*lookup)->bcm_acl_id < 0) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "No BcmAclId associated with table entry: "
+           << entry.ShortDebugString() << ".";
+  }
+  return (*lookup)->bcm_acl_id;
+}
+
+std::map<int, std::vector<int>>
+BcmTableManager::ReadSnapshot::GetBcmAclIdsByPhysicalTable() const {
+  std::map<int, std::vector<int>> bcm_acl_ids;
+  for (const auto& pair : tables_) {
+    const Table& table = *pair.second;
+    if (!table.is_acl || table.is_const) continue;
+    auto& ids = bcm_acl_ids[table.physical_table_id];
+    for (const auto& chunk : table.chunks) {
+      if (chunk == nullptr) continue;
+      for (const auto& pair : *chunk) {
+        if (pair.second->bcm_acl_id >= 0) {
+          ids.push_back(pair.second->bcm_acl_id);
+        }
+      }
+    }
+  }
+
+  return bcm_acl_ids;
+}
+
+::util::Status BcmTableManager::ReadSnapshot::ReadTableEntries(
+    const std::set<uint32>& table_ids, ::p4::v1::ReadResponse* resp,
+    std::vector<::p4::v1::TableEntry*>* acl_flows,
+    std::vector<int>* bcm_acl_ids) const {
+  if (resp == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null resp.";
+  }
+  if (acl_flows == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null acl_flows.";
+  }
+
+  // Acl entries should also be recorded in acl_flows. These are pointers to
+  // the acl entries in resp.
+  return ForEachTableEntry(
+      table_ids, [resp, acl_flows, bcm_acl_ids](
+                     const ::p4::v1::TableEntry& entry, bool is_acl,
+                     int bcm_acl_id) {
+        auto* entry_ptr = resp->add_entities()->mutable_table_entry();
+        *entry_ptr = entry;
+        if (is_acl) {
+          acl_flows->push_back(entry_ptr);
+          if (bcm_acl_ids) bcm_acl_ids->push_back(bcm_acl_id);
+        }
+        return ::util::OkStatus();
+      });
+}
+
+::util::Status BcmTableManager::ReadSnapshot::ReadActionProfileMembers(
+    const std::set<uint32>& action_profile_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) const {
+  return ReadActionProfileMembersFromMap(*members_, action_profile_ids, writer);
+}
+
+::util::Status BcmTableManager::ReadSnapshot::ReadActionProfileGroups(
+    const std::set<uint32>& action_profile_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) const {
+  return ReadActionProfileGroupsFromMap(*groups_, action_profile_ids, writer);
+}
+
+::util::Status BcmTableManager::ReadSnapshot::ReadMulticastGroups(
+    const std::set<uint32>& multicast_group_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) const {
+  return ReadMulticastGroupsFromMap(*multicast_groups_, multicast_group_ids,
+                                    writer);
+}
+
+::util::Status BcmTableManager::ReadSnapshot::ReadCloneSessions(
+    const std::set<uint32>& clone_session_ids,
+    WriterInterface<::p4::v1::ReadResponse>* writer) const {
+  return ReadCloneSessionsFromMap(*clone_sessions_, clone_session_ids, writer);
+}
+
 BcmTableManager::BcmTableManager(
     const BcmChassisRoInterface* bcm_chassis_ro_interface,
     P4TableMapper* p4_table_mapper, int unit)
@@ -282,6 +535,14 @@ BcmTableManager::BcmTableManager(
       group_id_to_nexthop_info_(),
       members_(),
       groups_(),
+      read_snapshot_(std::make_shared<const ReadSnapshot>()),
+      dirty_table_ids_(),
+      rebuilt_table_ids_(),
+      released_bcm_acl_ids_(),
+      members_dirty_(false),
+      groups_dirty_(false),
+      multicast_groups_dirty_(false),
+      clone_sessions_dirty_(false),
       bcm_chassis_ro_interface_(ABSL_DIE_IF_NULL(bcm_chassis_ro_interface)),
       p4_table_mapper_(ABSL_DIE_IF_NULL(p4_table_mapper)),
       node_id_(0),
@@ -294,6 +555,14 @@ BcmTableManager::BcmTableManager()
       group_id_to_nexthop_info_(),
       members_(),
       groups_(),
+      read_snapshot_(std::make_shared<const ReadSnapshot>()),
+      dirty_table_ids_(),
+      rebuilt_table_ids_(),
+      released_bcm_acl_ids_(),
+      members_dirty_(false),
+      groups_dirty_(false),
+      multicast_groups_dirty_(false),
+      clone_sessions_dirty_(false),
       bcm_chassis_ro_interface_(nullptr),
       p4_table_mapper_(nullptr),
       node_id_(0),
@@ -374,6 +643,8 @@ BcmTableManager::~BcmTableManager() {}
   trunk_id_to_trunk_port_.clear();
   members_.clear();
   groups_.clear();
+  members_dirty_ = true;
+  groups_dirty_ = true;
   gtl::STLDeleteValues(&member_id_to_nexthop_info_);
   gtl::STLDeleteValues(&group_id_to_nexthop_info_);
 
@@ -968,6 +1239,8 @@ namespace {
     RETURN_IF_ERROR_WITH_APPEND(
         p4_table_mapper_->LookupTable(table_id, &p4_table))
         << "Table entry refers to unknown table id " << table_id << ".";
+    dirty_table_ids_.insert(table_id);
+    rebuilt_table_ids_.insert(table_id);
     auto table_result =
         generic_flow_tables_.emplace(std::make_pair(table_id, p4_table));
     if (!table_result.second) {
@@ -1042,6 +1315,7 @@ namespace {
   // If this is the last entry in a generic table, remove the generic table.
   auto table_iter = generic_flow_tables_.find(table_id);
   if (table_iter != generic_flow_tables_.end() && table_iter->second.Empty()) {
+    rebuilt_table_ids_.insert(table_id);
     generic_flow_tables_.erase(table_iter);
   }
 
@@ -1111,6 +1385,7 @@ namespace {
   }
 
   // Save a copy of P4 ActionProfileMember.
+  members_dirty_ = true;
   if (!gtl::InsertIfNotPresent(&members_, {member_id, action_profile_member})) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
            << "Inconsistent state. Member with ID " << member_id << " already "
@@ -1179,6 +1454,7 @@ namespace {
   }
 
   // Save a copy of P4 ActionProfileGroup.
+  groups_dirty_ = true;
   if (!gtl::InsertIfNotPresent(&groups_, {group_id, action_profile_group})) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
            << "Inconsistent state. Group with ID " << group_id << " already "
@@ -1199,6 +1475,7 @@ namespace {
   uint32 group_id = multicast_group.multicast_group_id();
 
   // Save a copy of P4 MulticastGroupEntry.
+  multicast_groups_dirty_ = true;
   if (!gtl::InsertIfNotPresent(&multicast_groups_,
                                {group_id, multicast_group})) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
@@ -1220,6 +1497,7 @@ namespace {
   uint32 session_id = clone_session.session_id();
 
   // Save a copy of P4 CloneSessionEntry.
+  clone_sessions_dirty_ = true;
   if (!gtl::InsertIfNotPresent(&clone_sessions_, {session_id, clone_session})) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
         << "Inconsistent state. Multicast group with ID " << session_id
@@ -1244,6 +1522,7 @@ namespace {
 
   // Update the copy of P4 ActionProfileMember matching the input
   // (remove the old match and add the new one instead).
+  members_dirty_ = true;
   CHECK_RETURN_IF_FALSE(members_.erase(member_id) == 1)
       << "Inconsistent state. Old member with ID " << member_id << " did not "
       << "exist in members_.";
@@ -1323,6 +1602,7 @@ namespace {
 
   // Update the copy of P4 ActionProfileGroup matching the input
   // (remove the old match and add the new one instead).
+  groups_dirty_ = true;
   CHECK_RETURN_IF_FALSE(groups_.erase(group_id) == 1)
       << "Inconsistent state. Old group with ID " << group_id << " did not "
       << "exist in groups_.";
@@ -1345,6 +1625,7 @@ namespace {
   member_id_to_nexthop_info_.erase(member_id);
 
   // Delete the copy of P4 ActionProfileMember matching the input.
+  members_dirty_ = true;
   CHECK_RETURN_IF_FALSE(members_.erase(member_id) == 1)
       << "Inconsistent state. Old member with ID " << member_id << " did not "
       << "exist in members_.";
@@ -1385,6 +1666,7 @@ namespace {
   group_id_to_nexthop_info_.erase(group_id);
 
   // Delete the copy of P4 ActionProfileGroup matching the input.
+  groups_dirty_ = true;
   CHECK_RETURN_IF_FALSE(groups_.erase(group_id) == 1)
       << "Inconsistent state. Old group with ID " << group_id << " did not "
       << "exist in groups_.";
@@ -1396,6 +1678,7 @@ namespace {
     const ::p4::v1::MulticastGroupEntry& multicast_group) {
   uint32 group_id = multicast_group.multicast_group_id();
   // Delete the copy of P4 MulticastGroupEntry matching the input.
+  multicast_groups_dirty_ = true;
   CHECK_RETURN_IF_FALSE(multicast_groups_.erase(group_id) == 1)
       << "Inconsistent state. Old multicast group with ID " << group_id
       << " did not exist in multicast_groups_.";
@@ -1407,6 +1690,7 @@ namespace {
     const ::p4::v1::CloneSessionEntry& clone_session) {
   uint32 session_id = clone_session.session_id();
   // Delete the copy of P4 CloneSessionEntry matching the input.
+  clone_sessions_dirty_ = true;
   CHECK_RETURN_IF_FALSE(clone_sessions_.erase(session_id) == 1)
       << "Inconsistent state. Old clone session with ID " << session_id
       << " did not exist in clone_sessions_.";
@@ -1486,6 +1770,8 @@ bool BcmTableManager::ActionProfileGroupExists(uint32 group_id) const {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
            << "Cannot insert table with existing id: " << table.Id();
   }
+  dirty_table_ids_.insert(table.Id());
+  rebuilt_table_ids_.insert(table.Id());
   acl_tables_.emplace(table.Id(), std::move(table));
   return ::util::OkStatus();
 }
@@ -1517,6 +1803,7 @@ bool BcmTableManager::ActionProfileGroupExists(uint32 group_id) const {
            << "Table " << table_id << " is not an ACL table.";
   }
   RETURN_IF_ERROR(AddTableEntry(table_entry));
+  dirty_table_ids_.insert(table_id);
   RETURN_IF_ERROR(table->SetBcmAclId(table_entry, bcm_flow_id));
   return ::util::OkStatus();
 }
@@ -1548,10 +1835,92 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
   }
   // Remove the ACL table since it is not automatically deleted when the entries
   // are removed like generic tables.
+  dirty_table_ids_.insert(table_id);
+  rebuilt_table_ids_.insert(table_id);
   acl_tables_.erase(table_id);
   return ::util::OkStatus();
 }
 
+std::shared_ptr<const BcmTableManager::ReadSnapshot>
+BcmTableManager::GetReadSnapshot() const {
+  return std::atomic_load(&read_snapshot_);
+}
+
+void BcmTableManager::PublishReadSnapshot() {
+  if (dirty_table_ids_.empty() && !members_dirty_ && !groups_dirty_ &&
+      !multicast_groups_dirty_ && !clone_sessions_dirty_) {
+    return;
+  }
+  std::shared_ptr<const ReadSnapshot> old_snapshot = GetReadSnapshot();
+  // Start from a shallow copy of the old snapshot, so that all the tables and
+  // maps which have not changed are shared with it.
+  auto snapshot = std::make_shared<ReadSnapshot>(*old_snapshot);
+  snapshot->version_ = old_snapshot->version_ + 1;
+  for (uint32 table_id : dirty_table_ids_) {
+    BcmFlowTable* table = gtl::FindOrNull(generic_flow_tables_, table_id);
+    AclTable* acl_table = gtl::FindOrNull(acl_tables_, table_id);
+    if (acl_table != nullptr) table = acl_table;
+    if (table == nullptr) {
+      snapshot->tables_.erase(table_id);
+      continue;
+    }
+    // Tables which were added or replaced since the last publish are copied
+    // in full. The other ones only get the changed entries copied.
+    const ReadSnapshot::Table* old_copy = nullptr;
+    if (!rebuilt_table_ids_.count(table_id)) {
+      const auto* lookup = gtl::FindOrNull(old_snapshot->tables_, table_id);
+      if (lookup) old_copy = lookup->get();
+    }
+    snapshot->tables_[table_id] =
+        CopyTableForReadSnapshot(*table, acl_table, old_copy);
+    table->ClearChangedMatchKeys();
+  }
+  if (members_dirty_) {
+    snapshot->members_ = std::make_shared<
+        const absl::flat_hash_map<uint32, ::p4::v1::ActionProfileMember>>(
+        members_);
+  }
+  if (groups_dirty_) {
+    snapshot->groups_ = std::make_shared<
+        const absl::flat_hash_map<uint32, ::p4::v1::ActionProfileGroup>>(
+        groups_);
+  }
+  if (multicast_groups_dirty_) {
+    snapshot->multicast_groups_ = std::make_shared<
+        const absl::flat_hash_map<uint32, ::p4::v1::MulticastGroupEntry>>(
+        multicast_groups_);
+  }
+  if (clone_sessions_dirty_) {
+    snapshot->clone_sessions_ = std::make_shared<
+        const absl::flat_hash_map<uint32, ::p4::v1::CloneSessionEntry>>(
+        clone_sessions_);
+  }
+  dirty_table_ids_.clear();
+  rebuilt_table_ids_.clear();
+  members_dirty_ = false;
+  groups_dirty_ = false;
+  multicast_groups_dirty_ = false;
+  clone_sessions_dirty_ = false;
+
+  std::atomic_store(&read_snapshot_,
+                    std::shared_ptr<const ReadSnapshot>(std::move(snapshot)));
+}
+
+void BcmTableManager::ReleaseBcmAclId(int bcm_acl_id) {
+  uint64 version = GetReadSnapshot()->version();
+  absl::MutexLock l(&released_bcm_acl_ids_lock_);
+  released_bcm_acl_ids_[bcm_acl_id] = version;
+}
+
+bool BcmTableManager::IsBcmAclIdCurrent(const ReadSnapshot& snapshot,
+                                        int bcm_acl_id) const {
+  absl::MutexLock l(&released_bcm_acl_ids_lock_);
+  const uint64* version =
+      gtl::FindOrNull(released_bcm_acl_ids_, bcm_acl_id);
+  // The snapshots published after the release have the new owner of the ID.
+  return version == nullptr || snapshot.version() > *version;
+}
+
 ::util::Status BcmTableManager::ReadTableEntries(
     const std::set<uint32>& table_ids, ::p4::v1::ReadResponse* resp,
     std::vector<::p4::v1::TableEntry*>* acl_flows) const {
@@ -1626,91 +1995,26 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
 ::util::Status BcmTableManager::ReadActionProfileMembers(
     const std::set<uint32>& action_profile_ids,
     WriterInterface<::p4::v1::ReadResponse>* writer) const {
-  if (writer == nullptr) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
-  }
-
-  ::p4::v1::ReadResponse resp;
-  for (const auto& member : members_) {
-    if (action_profile_ids.empty() ||
-        action_profile_ids.count(member.second.action_profile_id())) {
-      auto* entity = resp.add_entities();
-      *entity->mutable_action_profile_member() = member.second;
-    }
-  }
-  if (!writer->Write(resp)) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
-  }
-
-  return ::util::OkStatus();
+  return ReadActionProfileMembersFromMap(members_, action_profile_ids, writer);
 }
 
 ::util::Status BcmTableManager::ReadActionProfileGroups(
     const std::set<uint32>& action_profile_ids,
     WriterInterface<::p4::v1::ReadResponse>* writer) const {
-  if (writer == nullptr) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
-  }
-
-  ::p4::v1::ReadResponse resp;
-  for (const auto& group : groups_) {
-    if (action_profile_ids.empty() ||
-        action_profile_ids.count(group.second.action_profile_id())) {
-      auto* entity = resp.add_entities();
-      *entity->mutable_action_profile_group() = group.second;
-    }
-  }
-  if (!writer->Write(resp)) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
-  }
-
-  return ::util::OkStatus();
+  return ReadActionProfileGroupsFromMap(groups_, action_profile_ids, writer);
 }
 
 ::util::Status BcmTableManager::ReadMulticastGroups(
     const std::set<uint32>& multicast_group_ids,
     WriterInterface<::p4::v1::ReadResponse>* writer) const {
-  if (writer == nullptr) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
-  }
-
-  ::p4::v1::ReadResponse resp;
-  for (const auto& group : multicast_groups_) {
-    if (multicast_group_ids.empty() ||
-        multicast_group_ids.count(group.second.multicast_group_id())) {
-      auto* entity = resp.add_entities();
-      *entity->mutable_packet_replication_engine_entry()
-          ->mutable_multicast_group_entry() = group.second;
-    }
-  }
-  if (!writer->Write(resp)) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
-  }
-
-  return ::util::OkStatus();
+  return ReadMulticastGroupsFromMap(multicast_groups_, multicast_group_ids,
+                                    writer);
 }
 
 ::util::Status BcmTableManager::ReadCloneSessions(
     const std::set<uint32>& clone_session_ids,
     WriterInterface<::p4::v1::ReadResponse>* writer) const {
-  if (writer == nullptr) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Null writer.";
-  }
-
-  ::p4::v1::ReadResponse resp;
-  for (const auto& session : clone_sessions_) {
-    if (clone_session_ids.empty() ||
-        clone_session_ids.count(session.second.session_id())) {
-      auto* entity = resp.add_entities();
-      *entity->mutable_packet_replication_engine_entry()
-          ->mutable_clone_session_entry() = session.second;
-    }
-  }
-  if (!writer->Write(resp)) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
-  }
-
-  return ::util::OkStatus();
+  return ReadCloneSessionsFromMap(clone_sessions_, clone_session_ids, writer);
 }
 
 ::util::Status BcmTableManager::MapFlowEntry(
@@ -2291,14 +2595,86 @@ BcmTableManager::GetBcmMultipathNexthopInfo(uint32 group_id) const {
   return bcm_table_type;
 }
 
+std::shared_ptr<const BcmTableManager::ReadSnapshot::Table>
+BcmTableManager::CopyTableForReadSnapshot(
+    const BcmFlowTable& table, const AclTable* acl_table,
+    const ReadSnapshot::Table* old_copy) const {
+  using Chunk = ReadSnapshot::Chunk;
+  using Table = ReadSnapshot::Table;
+  auto copy = std::make_shared<Table>();
+  copy->is_acl = acl_table != nullptr;
+  copy->is_const = table.IsConst();
+  if (acl_table != nullptr) {
+    copy->physical_table_id = static_cast<int>(acl_table->PhysicalTableId());
+  }
+  copy->layout = old_copy != nullptr
+                     ? old_copy->layout
+                     : std::make_shared<const TableEntryKeyLayout>(
+                           table.KeyLayout());
+  auto make_entry = [acl_table](const std::string& match_key,
+                                const ::p4::v1::TableEntry& entry) {
+    auto snapshot_entry = std::make_shared<ReadSnapshot::Entry>();
+    snapshot_entry->entry = entry;
+    if (acl_table != nullptr) {
+      snapshot_entry->bcm_acl_id = acl_table->BcmAclIdForMatchKey(match_key);
+    }
+    return std::shared_ptr<const ReadSnapshot::Entry>(
+        std::move(snapshot_entry));
+  };
+
+  std::vector<std::unique_ptr<Chunk>> new_chunks(Table::kNumChunks);
+  if (old_copy == nullptr) {
+    // Full copy.
+    for (const auto& entry : table) {
+      std::string match_key = table.MatchKey(entry);
+      auto& chunk = new_chunks[Table::ChunkIndex(match_key)];
+      if (chunk == nullptr) chunk = absl::make_unique<Chunk>();
+      chunk->emplace(match_key, make_entry(match_key, entry));
+    }
+  } else {
+    // Share the unchanged chunks, and copy the pointers of the chunks holding
+    // changed entries before updating them. The entries themselves are only
+    // rebuilt if they changed.
+    copy->chunks = old_copy->chunks;
+    for (const std::string& match_key : table.ChangedMatchKeys()) {
+      size_t index = Table::ChunkIndex(match_key);
+      auto& chunk = new_chunks[index];
+      if (chunk == nullptr) {
+        chunk = copy->chunks[index] ? absl::make_unique<Chunk>(
+                                          *copy->chunks[index])
+                                    : absl::make_unique<Chunk>();
+      }
+      const ::p4::v1::TableEntry* entry = table.FindMatchKey(match_key);
+      if (entry == nullptr) {
+        chunk->erase(match_key);
+      } else {
+        (*chunk)[match_key] = make_entry(match_key, *entry);
+      }
+    }
+  }
+  for (size_t i = 0; i < Table::kNumChunks; ++i) {
+    if (new_chunks[i] == nullptr) continue;
+    if (new_chunks[i]->empty()) {
+      copy->chunks[i] = nullptr;
+    } else {
+      copy->chunks[i] = std::shared_ptr<const Chunk>(std::move(new_chunks[i]));
+    }
+  }
+
+  return copy;
+}
+
 ::util::StatusOr<BcmFlowTable*> BcmTableManager::GetMutableFlowTable(
     uint32 table_id) {
+  // The caller is about to modify the table.
   auto generic_lookup = generic_flow_tables_.find(table_id);
   if (generic_lookup != generic_flow_tables_.end()) {
+    dirty_table_ids_.insert(table_id);
     return &(generic_lookup->second);
   }
   auto acl_lookup = acl_tables_.find(table_id);
   if (acl_lookup != acl_tables_.end()) {
+    dirty_table_ids_.insert(table_id);
     return &(acl_lookup->second);
   }
   return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
@@ -20,9 +20,11 @@
 #define STRATUM_HAL_LIB_BCM_BCM_TABLE_MANAGER_H_
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -38,8 +40,10 @@
 #include "stratum/hal/lib/p4/p4_table_mapper.h"
 #include "stratum/lib/utils.h"
 #include "stratum/glue/integral_types.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "p4/config/v1/p4info.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 
@@ -86,6 +90,129 @@ struct BcmMultipathNexthopInfo {
 // The "BcmTableManager" class implements the L3 routing functionality.
 class BcmTableManager {
  public:
+  // An immutable view of the P4 entities programmed on the node, as of the
+  // last call to PublishReadSnapshot(). The P4Runtime reads are served from
+  // the snapshot, so that they do not need to hold the lock which serializes
+  // the writes. A snapshot shares the tables and the entity maps which did not
+  // change with the snapshot published before it, so publishing after a write
+  // batch only copies the tables touched by the batch.
+  class ReadSnapshot {
+   public:
+    // An entry of a flow table, as of the snapshot. Entries are immutable and
+    // shared by all the snapshots in which they did not change.
+    struct Entry {
+      ::p4::v1::TableEntry entry;
+      // For ACL tables, the BCM ACL ID of the entry, or -1 if the entry has
+      // not been assigned one.
+      int bcm_acl_id;
+      Entry() : entry(), bcm_acl_id(-1) {}
+    };
+
+    // Entries of a table whose match keys hash to the same chunk, indexed by
+    // match key.
+    using Chunk =
+        absl::flat_hash_map<std::string, std::shared_ptr<const Entry>>;
+
+    // A copy of the entries of a flow table. The entries are spread over a
+    // fixed number of chunks, so that publishing a change to a few entries
+    // only copies the chunks holding them.
+    struct Table {
+      static constexpr size_t kNumChunks = 64;
+      // True if the table is an ACL table.
+      bool is_acl;
+      // True if the table holds static entries only.
+      bool is_const;
+      // For ACL tables, the ID of the physical table holding the entries. -1
+      // for the other tables.
+      int physical_table_id;
+      // kNumChunks chunks, nullptr for the empty ones.
+      std::vector<std::shared_ptr<const Chunk>> chunks;
+      // The layout of the match keys of the table, shared by all the copies
+      // of the table.
+      std::shared_ptr<const TableEntryKeyLayout> layout;
+      Table()
+          : is_acl(false),
+            is_const(false),
+            physical_table_id(-1),
+            chunks(kNumChunks),
+            layout() {}
+      // Returns the index of the chunk holding the given match key.
+      static size_t ChunkIndex(const std::string& match_key);
+    };
+
+    ReadSnapshot();
+
+    // Calls the visitor on each of the entries programmed in the given set of
+    // tables (given by table_ids), or in all the tables if table_ids is empty.
+    // Static entries are skipped. Together with the entry, the visitor gets
+    // whether the entry belongs to an ACL table and its BCM ACL ID (-1 if the
+    // entry is not an ACL entry or has no BCM ACL ID). Stops at and returns
+    // the first error returned by the visitor.
+    ::util::Status ForEachTableEntry(
+        const std::set<uint32>& table_ids,
+        const std::function<::util::Status(const ::p4::v1::TableEntry& entry,
+                                           bool is_acl, int bcm_acl_id)>&
+            visitor) const;
+
+    // Same as BcmTableManager::ReadTableEntries(). If bcm_acl_ids is not
+    // nullptr, it is filled with the BCM ACL ID of each of the acl_flows.
+    ::util::Status ReadTableEntries(
+        const std::set<uint32>& table_ids, ::p4::v1::ReadResponse* resp,
+        std::vector<::p4::v1::TableEntry*>* acl_flows,
+        std::vector<int>* bcm_acl_ids) const;
+
+    // Returns the BCM ACL ID of the given ACL table entry, as of the snapshot.
+    // Returns ERR_INVALID_PARAM if the table is not an ACL table and
+    // ERR_ENTRY_NOT_FOUND if the snapshot has no BCM ACL ID for the entry.
+    ::util::StatusOr<int> FindBcmAclId(const ::p4::v1::TableEntry& entry) const;
+
+    // Returns the BCM ACL IDs of all the non-static ACL entries in the
+    // snapshot, grouped by the ID of the physical table holding them.
+    std::map<int, std::vector<int>> GetBcmAclIdsByPhysicalTable() const;
+
+    // Same as BcmTableManager::ReadActionProfileMembers().
+    ::util::Status ReadActionProfileMembers(
+        const std::set<uint32>& action_profile_ids,
+        WriterInterface<::p4::v1::ReadResponse>* writer) const;
+
+    // Same as BcmTableManager::ReadActionProfileGroups().
+    ::util::Status ReadActionProfileGroups(
+        const std::set<uint32>& action_profile_ids,
+        WriterInterface<::p4::v1::ReadResponse>* writer) const;
+
+    // Same as BcmTableManager::ReadMulticastGroups().
+    ::util::Status ReadMulticastGroups(
+        const std::set<uint32>& multicast_group_ids,
+        WriterInterface<::p4::v1::ReadResponse>* writer) const;
+
+    // Same as BcmTableManager::ReadCloneSessions().
+    ::util::Status ReadCloneSessions(
+        const std::set<uint32>& clone_session_ids,
+        WriterInterface<::p4::v1::ReadResponse>* writer) const;
+
+    // Sequence number of the snapshot. Incremented on every publish.
+    uint64 version() const { return version_; }
+
+   private:
+    friend class BcmTableManager;
+
+    uint64 version_;
+    // Map from table id to the copy of the table.
+    absl::flat_hash_map<uint32, std::shared_ptr<const Table>> tables_;
+    std::shared_ptr<const absl::flat_hash_map<
+        uint32, ::p4::v1::ActionProfileMember>>
+        members_;
+    std::shared_ptr<const absl::flat_hash_map<
+        uint32, ::p4::v1::ActionProfileGroup>>
+        groups_;
+    std::shared_ptr<const absl::flat_hash_map<
+        uint32, ::p4::v1::MulticastGroupEntry>>
+        multicast_groups_;
+    std::shared_ptr<const absl::flat_hash_map<
+        uint32, ::p4::v1::CloneSessionEntry>>
+        clone_sessions_;
+  };
+
   virtual ~BcmTableManager();
 
   // Converts ACL constant conditions to BcmFields.
@@ -325,10 +452,37 @@ class BcmTableManager {
   // way to fully remove an ACL table.
   virtual ::util::Status DeleteTable(uint32 table_id);
 
+  // Returns the last published ReadSnapshot. Unlike the rest of the class,
+  // this method is thread-safe and can be called while the state is being
+  // modified by another thread. Never returns nullptr.
+  virtual std::shared_ptr<const ReadSnapshot> GetReadSnapshot() const;
+
+  // Publishes a new ReadSnapshot with all the changes made to the P4 entities
+  // since the last publish. To be called by the writer at the end of each
+  // batch of changes. The readers holding the old snapshot are not affected.
+  virtual void PublishReadSnapshot();
+
+  // Records that the given BCM ACL ID is about to be removed from hardware,
+  // after which it may be given to another ACL entry. To be called by the
+  // writer before the ACL flow is removed.
+  virtual void ReleaseBcmAclId(int bcm_acl_id)
+      LOCKS_EXCLUDED(released_bcm_acl_ids_lock_);
+
+  // Returns true if the given BCM ACL ID, as recorded in the given snapshot,
+  // has not been released since the snapshot was published, i.e. if it still
+  // belongs to the same entry. Like GetReadSnapshot(), this method is
+  // thread-safe. Readers of a snapshot call it after reading the counters of
+  // an ACL entry, to know whether the counters are the ones of the entry.
+  virtual bool IsBcmAclIdCurrent(const ReadSnapshot& snapshot,
+                                 int bcm_acl_id) const
+      LOCKS_EXCLUDED(released_bcm_acl_ids_lock_);
+
   // Reads the P4 TableEntry(s) programmed in the given set of tables
   // (given by table_ids) on the node. If table_ids is empty, return all the
   // entries programmed on the node. Assembles a list of pointers to the
-  // returned entries which have counters to be read.
+  // returned entries which have counters to be read. This and the Read*()
+  // methods below read the live state. Readers which do not hold the lock
+  // serializing the writes must use GetReadSnapshot() instead.
   virtual ::util::Status ReadTableEntries(
       const std::set<uint32>& table_ids, ::p4::v1::ReadResponse* resp,
       std::vector<::p4::v1::TableEntry*>* acl_flows) const;
@@ -484,6 +638,13 @@ class BcmTableManager {
   // Returns true if the given table id refers to a known ACL table.
   bool IsAclTable(uint32 table_id) const;
 
+  // Builds the ReadSnapshot copy of the given table. If old_copy is not
+  // nullptr, only the chunks of old_copy holding the entries changed since
+  // the last publish are rebuilt, and the other chunks are shared with it.
+  std::shared_ptr<const ReadSnapshot::Table> CopyTableForReadSnapshot(
+      const BcmFlowTable& table, const AclTable* acl_table,
+      const ReadSnapshot::Table* old_copy) const;
+
   // ***************************************************************************
   // Port/trunk Maps
   // ***************************************************************************
@@ -539,6 +700,38 @@ class BcmTableManager {
   // Map of ACL tables indexed by table id.
   absl::flat_hash_map<uint32, AclTable> acl_tables_;
 
+  // ***************************************************************************
+  // Read Snapshot
+  // ***************************************************************************
+
+  // The last published ReadSnapshot. Only accessed through std::atomic_load()
+  // and std::atomic_store(), as it is read without any lock.
+  std::shared_ptr<const ReadSnapshot> read_snapshot_;
+
+  // Ids of the tables which have been (possibly) modified since the last
+  // publish, including the tables which have been removed.
+  absl::flat_hash_set<uint32> dirty_table_ids_;
+
+  // Ids of the tables which have been added or removed since the last
+  // publish. Their copy is rebuilt from scratch instead of being updated with
+  // the changed entries.
+  absl::flat_hash_set<uint32> rebuilt_table_ids_;
+
+  // Protects released_bcm_acl_ids_, which is read by the readers of the
+  // snapshots without holding the lock serializing the writes.
+  mutable absl::Mutex released_bcm_acl_ids_lock_;
+
+  // Map from each BCM ACL ID released so far to the version of the last
+  // snapshot published before its (last) release.
+  absl::flat_hash_map<int, uint64> released_bcm_acl_ids_
+      GUARDED_BY(released_bcm_acl_ids_lock_);
+
+  // Set when the corresponding entity map is modified after the last publish.
+  bool members_dirty_;
+  bool groups_dirty_;
+  bool multicast_groups_dirty_;
+  bool clone_sessions_dirty_;
+
   // ***************************************************************************
   // Utilities
   // ***************************************************************************
@@ -19,6 +19,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_TABLE_MANAGER_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_TABLE_MANAGER_MOCK_H_
 
+#include <memory>
 #include <vector>
 #include <set>
 
@@ -122,6 +123,11 @@ class BcmTableManagerMock : public BcmTableManager {
                      ::util::StatusOr<const AclTable*>(uint32 table_id));
   MOCK_CONST_METHOD0(GetAllAclTableIDs, std::set<uint32>());
   MOCK_METHOD1(DeleteTable, ::util::Status(uint32 table_id));
+  MOCK_CONST_METHOD0(GetReadSnapshot, std::shared_ptr<const ReadSnapshot>());
+  MOCK_METHOD0(PublishReadSnapshot, void());
+  MOCK_METHOD1(ReleaseBcmAclId, void(int bcm_acl_id));
+  MOCK_CONST_METHOD2(IsBcmAclIdCurrent,
+                     bool(const ReadSnapshot& snapshot, int bcm_acl_id));
   MOCK_CONST_METHOD3(
       ReadTableEntries,
       ::util::Status(const std::set<uint32>& table_ids,
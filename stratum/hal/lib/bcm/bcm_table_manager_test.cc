@@ -16,6 +16,7 @@
 
 #include "stratum/hal/lib/bcm/bcm_table_manager.h"
 
+#include <map>
 #include <memory>
 #include <vector>
 #include <string>
@@ -47,6 +48,7 @@ using ::stratum::test_utils::EqualsProto;
 using ::stratum::test_utils::UnorderedEqualsProto;
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Pair;
 using ::testing::Return;
@@ -4419,6 +4421,223 @@ TEST_F(BcmTableManagerTest, ReadActionProfileMembersSuccess) {
   }
 }
 
+TEST_F(BcmTableManagerTest, ReadSnapshotIsNotAffectedByLaterChanges) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  ::p4::v1::ActionProfileMember member1;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  ::p4::v1::TableEntry entry1;
+  entry1.set_table_id(kTableId1);
+  entry1.add_match()->set_field_id(kFieldId1);
+  entry1.mutable_action()->set_action_profile_member_id(kMemberId1);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry1));
+
+  // The changes are not visible to the readers until they are published.
+  auto snapshot0 = bcm_table_manager_->GetReadSnapshot();
+  ASSERT_NE(nullptr, snapshot0);
+  {
+    ::p4::v1::ReadResponse resp;
+    std::vector<::p4::v1::TableEntry*> acl_flows;
+    ASSERT_OK(snapshot0->ReadTableEntries({}, &resp, &acl_flows, nullptr));
+    EXPECT_EQ(0, resp.entities_size());
+  }
+  bcm_table_manager_->PublishReadSnapshot();
+  auto snapshot1 = bcm_table_manager_->GetReadSnapshot();
+  EXPECT_EQ(snapshot0->version() + 1, snapshot1->version());
+
+  // Remove everything and publish again. The old snapshot still holds the
+  // entities as they were when it was published.
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entry1));
+  ASSERT_OK(bcm_table_manager_->DeleteActionProfileMember(member1));
+  bcm_table_manager_->PublishReadSnapshot();
+  auto snapshot2 = bcm_table_manager_->GetReadSnapshot();
+  {
+    ::p4::v1::ReadResponse resp;
+    std::vector<::p4::v1::TableEntry*> acl_flows;
+    ASSERT_OK(snapshot1->ReadTableEntries({kTableId1}, &resp, &acl_flows,
+                                          nullptr));
+    ::p4::v1::ReadResponse expected;
+    *expected.add_entities()->mutable_table_entry() = entry1;
+    EXPECT_THAT(resp, EqualsProto(expected));
+    EXPECT_TRUE(acl_flows.empty());
+  }
+  {
+    ::p4::v1::ReadResponse resp;
+    *resp.add_entities()->mutable_action_profile_member() = member1;
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+    ASSERT_OK(snapshot1->ReadActionProfileMembers({}, &writer_mock));
+  }
+  {
+    ::p4::v1::ReadResponse resp;
+    std::vector<::p4::v1::TableEntry*> acl_flows;
+    ASSERT_OK(snapshot2->ReadTableEntries({}, &resp, &acl_flows, nullptr));
+    EXPECT_EQ(0, resp.entities_size());
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+    ASSERT_OK(snapshot2->ReadActionProfileMembers({}, &writer_mock));
+  }
+
+  // Publishing without any change keeps the same snapshot.
+  bcm_table_manager_->PublishReadSnapshot();
+  EXPECT_EQ(snapshot2, bcm_table_manager_->GetReadSnapshot());
+}
+
+TEST_F(BcmTableManagerTest, ReadSnapshotReturnsBcmAclIds) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  ::p4::v1::ActionProfileMember member1;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  AclTable table =
+      CreateAclTable(/*p4_id=*/kTableId1, /*match_fields=*/{kFieldId1},
+                     /*stage=*/BCM_ACL_STAGE_IFP, /*size=*/10,
+                     /*priority=*/20);
+  ASSERT_OK(bcm_table_manager_->AddAclTable(table));
+  ::p4::v1::TableEntry entry;
+  entry.set_table_id(kTableId1);
+  entry.add_match()->set_field_id(kFieldId1);
+  entry.mutable_action()->set_action_profile_member_id(kMemberId1);
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entry, 15));
+  bcm_table_manager_->PublishReadSnapshot();
+
+  ::p4::v1::ReadResponse resp;
+  std::vector<::p4::v1::TableEntry*> acl_flows;
+  std::vector<int> bcm_acl_ids;
+  ASSERT_OK(bcm_table_manager_->GetReadSnapshot()->ReadTableEntries(
+      {}, &resp, &acl_flows, &bcm_acl_ids));
+  ASSERT_EQ(1, resp.entities_size());
+  ASSERT_EQ(1, acl_flows.size());
+  EXPECT_EQ(acl_flows[0], resp.mutable_entities(0)->mutable_table_entry());
+  EXPECT_THAT(*acl_flows[0], EqualsProto(entry));
+  EXPECT_THAT(bcm_acl_ids, ElementsAre(15));
+  EXPECT_THAT(bcm_table_manager_->GetReadSnapshot()
+                  ->GetBcmAclIdsByPhysicalTable(),
+              ElementsAre(Pair(0, ElementsAre(15))));
+
+  // Deleting the table removes it from the next snapshot.
+  ASSERT_OK(bcm_table_manager_->DeleteTable(kTableId1));
+  bcm_table_manager_->PublishReadSnapshot();
+  resp.Clear();
+  acl_flows.clear();
+  bcm_acl_ids.clear();
+  ASSERT_OK(bcm_table_manager_->GetReadSnapshot()->ReadTableEntries(
+      {kTableId1}, &resp, &acl_flows, &bcm_acl_ids));
+  EXPECT_EQ(0, resp.entities_size());
+  EXPECT_TRUE(bcm_acl_ids.empty());
+}
+
+TEST_F(BcmTableManagerTest, ReadSnapshotSharesUnchangedEntries) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  ::p4::v1::ActionProfileMember member1;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  AclTable table =
+      CreateAclTable(/*p4_id=*/kTableId1, /*match_fields=*/{kFieldId1},
+                     /*stage=*/BCM_ACL_STAGE_IFP, /*size=*/10,
+                     /*priority=*/20);
+  ASSERT_OK(bcm_table_manager_->AddAclTable(table));
+  std::vector<::p4::v1::TableEntry> entries(3);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].set_table_id(kTableId1);
+    auto* match = entries[i].add_match();
+    match->set_field_id(kFieldId1);
+    match->mutable_exact()->set_value(std::string(1, 'a' + i));
+    entries[i].mutable_action()->set_action_profile_member_id(kMemberId1);
+  }
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entries[0], 15));
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entries[1], 16));
+  bcm_table_manager_->PublishReadSnapshot();
+
+  // Returns the address of each entry in the current snapshot, indexed by BCM
+  // ACL ID.
+  auto get_entry_addresses = [this]() {
+    std::map<int, const ::p4::v1::TableEntry*> addresses;
+    EXPECT_OK(bcm_table_manager_->GetReadSnapshot()->ForEachTableEntry(
+        {}, [&addresses](const ::p4::v1::TableEntry& entry, bool is_acl,
+                         int bcm_acl_id) {
+          addresses[bcm_acl_id] = &entry;
+          return ::util::OkStatus();
+        }));
+    return addresses;
+  };
+  auto snapshot1 = bcm_table_manager_->GetReadSnapshot();
+  auto addresses1 = get_entry_addresses();
+  ASSERT_EQ(2, addresses1.size());
+
+  // The new snapshot shares the entries which did not change with the old one.
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entries[2], 17));
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entries[1]));
+  bcm_table_manager_->PublishReadSnapshot();
+  auto addresses2 = get_entry_addresses();
+  EXPECT_THAT(addresses2, ElementsAre(Pair(15, addresses1[15]), Pair(17, _)));
+  EXPECT_THAT(*addresses2[17], EqualsProto(entries[2]));
+
+  // The old snapshot is unchanged.
+  std::vector<int> bcm_acl_ids;
+  ::p4::v1::ReadResponse resp;
+  std::vector<::p4::v1::TableEntry*> acl_flows;
+  ASSERT_OK(snapshot1->ReadTableEntries({}, &resp, &acl_flows, &bcm_acl_ids));
+  EXPECT_THAT(bcm_acl_ids, UnorderedElementsAre(15, 16));
+}
+
+TEST_F(BcmTableManagerTest, ReadSnapshotTracksReleasedBcmAclIds) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  ::p4::v1::ActionProfileMember member1;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  AclTable table =
+      CreateAclTable(/*p4_id=*/kTableId1, /*match_fields=*/{kFieldId1},
+                     /*stage=*/BCM_ACL_STAGE_IFP, /*size=*/10,
+                     /*priority=*/20);
+  ASSERT_OK(bcm_table_manager_->AddAclTable(table));
+  std::vector<::p4::v1::TableEntry> entries(2);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].set_table_id(kTableId1);
+    auto* match = entries[i].add_match();
+    match->set_field_id(kFieldId1);
+    match->mutable_exact()->set_value(std::string(1, 'a' + i));
+    entries[i].mutable_action()->set_action_profile_member_id(kMemberId1);
+  }
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entries[0], 15));
+  bcm_table_manager_->PublishReadSnapshot();
+  auto snapshot1 = bcm_table_manager_->GetReadSnapshot();
+  ASSERT_OK_AND_ASSIGN(int bcm_acl_id, snapshot1->FindBcmAclId(entries[0]));
+  EXPECT_EQ(15, bcm_acl_id);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            snapshot1->FindBcmAclId(entries[1]).status().error_code());
+  EXPECT_TRUE(bcm_table_manager_->IsBcmAclIdCurrent(*snapshot1, 15));
+
+  // The ID of the deleted entry is given to another entry. It is no longer
+  // current for the old snapshot, but it is for the new one.
+  bcm_table_manager_->ReleaseBcmAclId(15);
+  EXPECT_FALSE(bcm_table_manager_->IsBcmAclIdCurrent(*snapshot1, 15));
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entries[0]));
+  ASSERT_OK(bcm_table_manager_->AddAclTableEntry(entries[1], 15));
+  bcm_table_manager_->PublishReadSnapshot();
+  auto snapshot2 = bcm_table_manager_->GetReadSnapshot();
+  EXPECT_FALSE(bcm_table_manager_->IsBcmAclIdCurrent(*snapshot1, 15));
+  EXPECT_TRUE(bcm_table_manager_->IsBcmAclIdCurrent(*snapshot2, 15));
+  ASSERT_OK_AND_ASSIGN(bcm_acl_id, snapshot2->FindBcmAclId(entries[1]));
+  EXPECT_EQ(15, bcm_acl_id);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            snapshot2->FindBcmAclId(entries[0]).status().error_code());
+}
+
 TEST_F(BcmTableManagerTest,
        CommonFlowEntryToBcmFlowEntry_AclWithMultipleConstConditions) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
@@ -38,6 +38,8 @@
 #include "openconfig/openconfig.pb.h"
 #include "stratum/glue/logging.h"
 #include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/data_request_batch.h"
+#include "stratum/hal/lib/common/gnmi_caps.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/openconfig_converter.h"
 #include "stratum/lib/macros.h"
@@ -55,6 +57,11 @@ DEFINE_string(chassis_config_file, "",
               "Default is empty and it is expected to be explicitly given by "
               "flags.");
 
+DEFINE_int32(gnmi_get_cache_max_paths, 1024,
+             "Max number of gNMI Get paths whose config-derived values are "
+             "cached until the next config push or Set. 0 disables the "
+             "cache.");
+
 namespace stratum {
 namespace hal {
 
@@ -101,6 +108,7 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 ::util::Status ConfigMonitoringService::Teardown() {
   absl::WriterMutexLock l(&config_lock_);
   running_chassis_config_ = nullptr;
+  ClearGetCache();
 
   if (gnmi_publisher_.UnregisterEventWriter() != ::util::OkStatus()) {
     return MAKE_ERROR(ERR_INTERNAL)
@@ -149,6 +157,7 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 
   // Save running_chassis_config_ after everything went OK.
   running_chassis_config_ = std::move(config);
+  ClearGetCache();
 
   // Notify the gNMI GnmiPublisher that the config has changed.
   RETURN_IF_ERROR(gnmi_publisher_.HandleChange(
@@ -165,11 +174,39 @@ ConfigMonitoringService::~ConfigMonitoringService() {
   return DoCapabilities(context, req, resp);
 }
 
+namespace {
+
+// The response to the Capabilities RPC, along with the status of parsing it.
+struct ParsedCapabilities {
+  ::gnmi::CapabilityResponse resp;
+  ::util::Status status;
+};
+
+// Returns the capabilities, which are parsed only once from the text embedded
+// at build time, as they never change.
+const ParsedCapabilities& GetCapabilities() {
+  static const ParsedCapabilities* capabilities = []() {
+    auto* caps = new ParsedCapabilities();
+    caps->status = ParseProtoFromString(kGnmiCapabilitiesText, &caps->resp);
+    if (!caps->status.ok()) {
+      LOG(ERROR) << "Failed to parse the gNMI capabilities: " << caps->status;
+    }
+    return caps;
+  }();
+  return *capabilities;
+}
+
+}  // namespace
+
 ::grpc::Status ConfigMonitoringService::DoCapabilities(
     ::grpc::ServerContext* context, const ::gnmi::CapabilityRequest* req,
     ::gnmi::CapabilityResponse* resp) {
-  // TODO(Yi): Use auto generated file or code.
-  ReadProtoFromTextFile("stratum/hal/lib/common/gnmi_caps.pb.txt", resp);
+  const ParsedCapabilities& capabilities = GetCapabilities();
+  if (!capabilities.status.ok()) {
+    return ::grpc::Status(ToGrpcCode(capabilities.status.CanonicalCode()),
+                          capabilities.status.error_message());
+  }
+  *resp = capabilities.resp;
   return ::grpc::Status::OK;
 }
 
@@ -185,6 +222,8 @@ ConfigMonitoringService::~ConfigMonitoringService() {
                                               const ::gnmi::SetRequest* req,
                                               ::gnmi::SetResponse* resp) {
   absl::WriterMutexLock l(&config_lock_);
+  // Any config-derived value may change below, even if the Set fails halfway.
+  ClearGetCache();
 
   CopyOnWriteChassisConfig config(running_chassis_config_.get());
 
@@ -292,15 +331,57 @@ ConfigMonitoringService::~ConfigMonitoringService() {
                           "Get response can only be encoded as PROTO.");
   }
 
+  // The serialized form of each path, used as the key of the Get cache.
+  std::vector<std::string> keys;
+  keys.reserve(req->path_size());
   for (const auto& path : req->path()) {
+    keys.push_back(ProtoSerialize(path));
+  }
+
+  // When many paths are requested, they are polled once to collect the
+  // DataRequests of all their leaves, which are then sent to the switch in one
+  // DataRequest per node. The response is built by the loop below from the
+  // values retrieved by the batch. The paths served from the Get cache are not
+  // polled.
+  DataRequestBatch batch;
+  std::unique_ptr<DataRequestBatch::Scope> batch_scope;
+  if (req->path_size() > 1) {
+    {
+      DataRequestBatch::Scope scope(&batch);
+      InlineGnmiSubscribeStream null_stream(
+          [](const ::gnmi::SubscribeResponse& /*resp*/) { return true; });
+      for (int i = 0; i < req->path_size(); ++i) {
+        const auto& path = req->path(i);
+        if (path == GetPath()() || IsInGetCache(keys[i])) continue;
+        SubscriptionHandle h;
+        if (gnmi_publisher_.SubscribePoll(path, &null_stream, &h).ok()) {
+          gnmi_publisher_.HandlePoll(h).IgnoreError();
+        }
+      }
+    }
+    batch.Dispatch();
+    batch_scope = absl::make_unique<DataRequestBatch::Scope>(&batch);
+  }
+
+  for (int i = 0; i < req->path_size(); ++i) {
+    const auto& path = req->path(i);
     VLOG(1) << "GET: " << path.ShortDebugString();
-    if (path == GetPath()()) {
+    bool whole_config = path == GetPath()();
+    if (whole_config && req->type() != ::gnmi::GetRequest::CONFIG) {
+      // Unsupported case!
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                            "Get '/' can be done for CONFIG elements only.");
+    }
+    // The values of the config-derived paths are served from the cache if
+    // they have been got since the last config change.
+    const std::string& key = keys[i];
+    if (ReadGetCache(key, resp)) {
+      if (whole_config) return ::grpc::Status::OK;
+      continue;
+    }
+    int first_notification = resp->notification_size();
+    if (whole_config) {
       // Special case - whole configuration.
-      if (req->type() != ::gnmi::GetRequest::CONFIG) {
-        // Unsupported case!
-        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                              "Get '/' can be done for CONFIG elements only.");
-      }
       auto* notification = resp->add_notification();
       // TODO(unknown): Set correct timestamp.
       notification->set_timestamp(0ll);
@@ -314,6 +395,7 @@ ConfigMonitoringService::~ConfigMonitoringService() {
       if (out.ok()) {
         // Serialize the proto and add it to the response.
         update->mutable_val()->mutable_any_val()->PackFrom(out.ValueOrDie());
+        WriteGetCache(key, *resp, first_notification);
         return ::grpc::Status::OK;
       } else {
         return ::grpc::Status(ToGrpcCode(out.status().CanonicalCode()),
@@ -344,11 +426,52 @@ ConfigMonitoringService::~ConfigMonitoringService() {
         return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
                               status.error_message());
       }
+      if (gnmi_publisher_.IsConfigDerived(path)) {
+        WriteGetCache(key, *resp, first_notification);
+      }
     }
   }
   return ::grpc::Status::OK;
 }
 
+bool ConfigMonitoringService::ReadGetCache(const std::string& key,
+                                           ::gnmi::GetResponse* resp) {
+  absl::ReaderMutexLock l(&get_cache_lock_);
+  const auto* notifications = gtl::FindOrNull(get_cache_, key);
+  if (notifications == nullptr) return false;
+  // The cached values are still current, so they are stamped with the time of
+  // this Get. The notifications left without a timestamp are kept as is.
+  uint64 now = absl::GetCurrentTimeNanos();
+  for (const auto& notification : *notifications) {
+    auto* copy = resp->add_notification();
+    *copy = notification;
+    if (copy->timestamp() != 0) copy->set_timestamp(now);
+  }
+  return true;
+}
+
+bool ConfigMonitoringService::IsInGetCache(const std::string& key) const {
+  absl::ReaderMutexLock l(&get_cache_lock_);
+  return get_cache_.count(key) > 0;
+}
+
+void ConfigMonitoringService::WriteGetCache(const std::string& key,
+                                            const ::gnmi::GetResponse& resp,
+                                            int first_notification) {
+  absl::WriterMutexLock l(&get_cache_lock_);
+  if (static_cast<int>(get_cache_.size()) >= FLAGS_gnmi_get_cache_max_paths) {
+    return;
+  }
+  std::vector<::gnmi::Notification>& notifications = get_cache_[key];
+  notifications.assign(resp.notification().begin() + first_notification,
+                       resp.notification().end());
+}
+
+void ConfigMonitoringService::ClearGetCache() {
+  absl::WriterMutexLock l(&get_cache_lock_);
+  get_cache_.clear();
+}
+
 ::grpc::Status ConfigMonitoringService::Subscribe(
     ::grpc::ServerContext* context, ServerSubscribeReaderWriter* stream) {
   RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, ConfigMonitoringService,
@@ -19,8 +19,11 @@
 #define STRATUM_HAL_LIB_COMMON_CONFIG_MONITORING_SERVICE_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
 #include "gnmi/gnmi.grpc.pb.h"
 #include "grpcpp/grpcpp.h"
@@ -143,9 +146,47 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
                        const ::gnmi::SetRequest* req, ::gnmi::SetResponse* resp)
       LOCKS_EXCLUDED(config_lock_);
 
+  // Copies the notifications cached for the Get of the path with the given
+  // serialized form to 'resp', timestamped with the current time. Returns
+  // false if there are none.
+  bool ReadGetCache(const std::string& key, ::gnmi::GetResponse* resp)
+      SHARED_LOCKS_REQUIRED(config_lock_) LOCKS_EXCLUDED(get_cache_lock_);
+
+  // Returns true if ReadGetCache() would find the notifications of the path
+  // with the given serialized form. As the cache is only cleared while holding
+  // config_lock_ as a writer, the result holds as long as config_lock_ is held.
+  bool IsInGetCache(const std::string& key) const
+      SHARED_LOCKS_REQUIRED(config_lock_) LOCKS_EXCLUDED(get_cache_lock_);
+
+  // Caches the notifications of 'resp' starting at 'first_notification', which
+  // are the ones returned for the Get of the path with the given serialized
+  // form.
+  void WriteGetCache(const std::string& key, const ::gnmi::GetResponse& resp,
+                     int first_notification)
+      SHARED_LOCKS_REQUIRED(config_lock_) LOCKS_EXCLUDED(get_cache_lock_);
+
+  // Forgets all the cached Get responses. Called whenever the config-derived
+  // values may change, i.e. when a config is pushed or a Set is processed.
+  void ClearGetCache() EXCLUSIVE_LOCKS_REQUIRED(config_lock_)
+      LOCKS_EXCLUDED(get_cache_lock_);
+
   // Mutex lock for protecting the internal chassis config pushed to the switch.
   mutable absl::Mutex config_lock_;
 
+  // Mutex lock for protecting the cache of Get responses. Gets are processed in
+  // parallel while holding config_lock_ as a reader, so the cache needs a lock
+  // of its own.
+  mutable absl::Mutex get_cache_lock_ ACQUIRED_AFTER(config_lock_);
+
+  // Map from the serialized path of a Get to the notifications returned for it,
+  // for the paths all the leaves of which are config-derived (see
+  // GnmiPublisher::IsConfigDerived()). The values of such leaves change only
+  // when config_lock_ is held as a writer, which is when the cache is cleared.
+  // The timestamps of the cached notifications are replaced with the current
+  // time when they are returned.
+  absl::flat_hash_map<std::string, std::vector<::gnmi::Notification>>
+      get_cache_ GUARDED_BY(get_cache_lock_);
+
   // Hold the ChassisConfig which is currently running on the switch.
   std::unique_ptr<ChassisConfig> running_chassis_config_
       GUARDED_BY(config_lock_);
@@ -19,6 +19,7 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
@@ -124,6 +125,12 @@ class ConfigMonitoringServiceTest
     return config_monitoring_service_->DoCapabilities(context, req, resp);
   }
 
+  // Returns the number of paths whose Get responses are cached.
+  int GetCacheSize() {
+    absl::ReaderMutexLock l(&config_monitoring_service_->get_cache_lock_);
+    return config_monitoring_service_->get_cache_.size();
+  }
+
   static constexpr char kChassisConfigTemplate[] = R"PROTO(
       description: "Sample test config."
       nodes {
@@ -951,6 +958,87 @@ TEST_P(ConfigMonitoringServiceTest,
           "state")("admin-status")());
 }
 
+// DoGet() serves the config-derived leaves from the cache until the config is
+// pushed or set.
+TEST_P(ConfigMonitoringServiceTest, GnmiGetCachesConfigDerivedLeaves) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  // Prepare and push configuration. The method under test requires the
+  // configuration to be pushed.
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  // Prepare a GET request for a leaf whose value comes from the config.
+  ::gnmi::GetRequest req;
+  *req.add_path() =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/2")(
+          "state")("name")();
+  req.set_type(::gnmi::GetRequest::STATE);
+  req.set_encoding(::gnmi::Encoding::PROTO);
+
+  ::grpc::ServerContext context;
+  ::gnmi::GetResponse resp;
+  auto grpc_status = DoGet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  ASSERT_EQ(1, resp.notification_size());
+  EXPECT_EQ("device1.domain.net.com:ce-1/2",
+            resp.notification(0).update(0).val().string_val());
+  EXPECT_EQ(1, GetCacheSize());
+
+  // The same response is returned from the cache, with a new timestamp.
+  ::gnmi::GetResponse cached_resp;
+  uint64 before_cached_get = absl::GetCurrentTimeNanos();
+  grpc_status = DoGet(&context, &req, &cached_resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  ASSERT_EQ(1, cached_resp.notification_size());
+  EXPECT_LE(before_cached_get, cached_resp.notification(0).timestamp());
+  cached_resp.mutable_notification(0)->set_timestamp(
+      resp.notification(0).timestamp());
+  EXPECT_TRUE(ProtoEqual(resp, cached_resp));
+  EXPECT_EQ(1, GetCacheSize());
+
+  // A Set clears the cache.
+  ::gnmi::SetRequest set_req;
+  ::gnmi::SetResponse set_resp;
+  EXPECT_TRUE(DoSet(&context, &set_req, &set_resp).ok());
+  EXPECT_EQ(0, GetCacheSize());
+
+  // So does a config push.
+  resp.Clear();
+  grpc_status = DoGet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_EQ(1, GetCacheSize());
+  ASSERT_OK(config_monitoring_service_->PushChassisConfig(
+      false, absl::make_unique<ChassisConfig>(config)));
+  EXPECT_EQ(0, GetCacheSize());
+}
+
+// DoGet() does not cache the leaves whose values are read from the switch.
+TEST_P(ConfigMonitoringServiceTest, GnmiGetDoesNotCacheStateLeaves) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  // Prepare and push configuration. The method under test requires the
+  // configuration to be pushed.
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  ::gnmi::GetRequest req;
+  *req.add_path() =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/2")(
+          "state")("admin-status")();
+  req.set_type(::gnmi::GetRequest::STATE);
+  req.set_encoding(::gnmi::Encoding::PROTO);
+
+  ::grpc::ServerContext context;
+  ::gnmi::GetResponse resp;
+  auto grpc_status = DoGet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_EQ(1, resp.notification_size());
+  EXPECT_EQ(0, GetCacheSize());
+}
+
 // Successful DoSet() execution for simple leaf gNMI SET REPLACE message.
 TEST_P(ConfigMonitoringServiceTest, GnmiSetRootReplace) {
   if (mode_ == OPERATION_MODE_COUPLED) return;
@@ -0,0 +1,174 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/data_request_batch.h"
+
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "stratum/glue/logging.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// The batch bound to the calling thread by DataRequestBatch::Scope.
+thread_local DataRequestBatch* current_batch = nullptr;
+
+// Saves all the responses received from the switch, in order.
+class DataResponseCollector : public WriterInterface<DataResponse> {
+ public:
+  explicit DataResponseCollector(std::vector<DataResponse>* responses)
+      : responses_(responses) {}
+
+  bool Write(const DataResponse& resp) override {
+    responses_->push_back(resp);
+    return true;
+  }
+
+ private:
+  std::vector<DataResponse>* responses_;  // not owned by the class.
+};
+
+}  // namespace
+
+DataRequestBatch::Scope::Scope(DataRequestBatch* batch)
+    : previous_(current_batch) {
+  current_batch = batch;
+}
+
+DataRequestBatch::Scope::~Scope() { current_batch = previous_; }
+
+DataRequestBatch::DataRequestBatch()
+    : switch_interface_(nullptr),
+      dispatched_(false),
+      num_requests_(0),
+      node_to_requests_(),
+      recorded_keys_(),
+      results_() {}
+
+void DataRequestBatch::Dispatch() {
+  if (dispatched_) return;
+  dispatched_ = true;
+  for (const auto& e : node_to_requests_) {
+    const uint64 node_id = e.first;
+    const NodeRequests& node_requests = e.second;
+    std::vector<DataResponse> responses;
+    std::vector<::util::Status> details;
+    DataResponseCollector writer(&responses);
+    ::util::Status status = switch_interface_->RetrieveValue(
+        node_id, node_requests.request, &writer, &details);
+    const size_t num_requests = node_requests.keys.size();
+    // The responses carry no reference to the requests, so they are matched
+    // by their order. The switch writes a response for each successful
+    // request and, if given the details vector, adds one status per request.
+    // Some implementations only add the statuses of the failed requests.
+    if (details.size() == num_requests) {
+      size_t num_ok = 0;
+      for (const auto& detail : details) {
+        if (detail.ok()) ++num_ok;
+      }
+      if (num_ok == responses.size()) {
+        size_t next = 0;
+        for (size_t i = 0; i < num_requests; ++i) {
+          Result& result = results_[node_requests.keys[i]];
+          result.status = details[i];
+          if (details[i].ok()) result.response = responses[next++];
+        }
+        continue;
+      }
+    } else if (status.ok() && responses.size() == num_requests) {
+      for (size_t i = 0; i < num_requests; ++i) {
+        Result& result = results_[node_requests.keys[i]];
+        result.status = ::util::OkStatus();
+        result.response = responses[i];
+      }
+      continue;
+    }
+    // The requests of this node will be sent to the switch one by one.
+    VLOG(1) << "Cannot match the " << responses.size() << " responses and "
+            << details.size() << " statuses received for the "
+            << num_requests << " requests sent to node " << node_id
+            << " (status: " << status << ").";
+  }
+  node_to_requests_.clear();
+  recorded_keys_.clear();
+}
+
+::util::Status DataRequestBatch::RetrieveValue(
+    SwitchInterface* switch_interface, uint64 node_id,
+    const DataRequest& request, WriterInterface<DataResponse>* writer,
+    std::vector<::util::Status>* details) {
+  DataRequestBatch* batch = current_batch;
+  if (batch != nullptr) {
+    if (batch->collecting()) {
+      // Nothing is written during the collect phase.
+      if (batch->Collect(switch_interface, node_id, request)) {
+        return ::util::OkStatus();
+      }
+    } else if (batch->Serve(switch_interface, node_id, request, writer,
+                            details)) {
+      return ::util::OkStatus();
+    }
+  }
+
+  return switch_interface->RetrieveValue(node_id, request, writer, details);
+}
+
+DataRequestBatch* DataRequestBatch::GetCurrent() { return current_batch; }
+
+std::string DataRequestBatch::MakeKey(uint64 node_id,
+                                      const DataRequest::Request& request) {
+  return absl::StrCat(node_id, "/", request.SerializeAsString());
+}
+
+bool DataRequestBatch::Collect(SwitchInterface* switch_interface,
+                               uint64 node_id, const DataRequest& request) {
+  if (switch_interface_ == nullptr) switch_interface_ = switch_interface;
+  if (switch_interface != switch_interface_) return false;
+  for (const auto& req : request.requests()) {
+    std::string key = MakeKey(node_id, req);
+    if (!recorded_keys_.insert(key).second) continue;
+    NodeRequests& node_requests = node_to_requests_[node_id];
+    *node_requests.request.add_requests() = req;
+    node_requests.keys.push_back(std::move(key));
+    ++num_requests_;
+  }
+
+  return true;
+}
+
+bool DataRequestBatch::Serve(SwitchInterface* switch_interface,
+                             uint64 node_id, const DataRequest& request,
+                             WriterInterface<DataResponse>* writer,
+                             std::vector<::util::Status>* details) const {
+  if (switch_interface != switch_interface_) return false;
+  std::vector<const Result*> results;
+  for (const auto& req : request.requests()) {
+    auto it = results_.find(MakeKey(node_id, req));
+    if (it == results_.end()) return false;
+    results.push_back(&it->second);
+  }
+  for (const Result* result : results) {
+    if (result->status.ok()) writer->Write(result->response);
+    if (details) details->push_back(result->status);
+  }
+
+  return true;
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_DATA_REQUEST_BATCH_H_
+#define STRATUM_HAL_LIB_COMMON_DATA_REQUEST_BATCH_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+
+namespace stratum {
+namespace hal {
+
+// The "DataRequestBatch" class merges the single-value DataRequests issued by
+// the gNMI leaf handlers into one multi-value DataRequest per node. The leaf
+// handlers are run twice. During the first run (the collect phase) each
+// DataRequestBatch::RetrieveValue() call records its requests and returns
+// without writing anything. Dispatch() then sends the recorded requests with
+// a single SwitchInterface::RetrieveValue() call per node. During the second
+// run (the serve phase) each DataRequestBatch::RetrieveValue() call is served
+// from the responses received by Dispatch(). Requests which were not recorded
+// or could not be matched to a response are forwarded to the switch as-is, so
+// a handler always sees the same result as without the batch.
+//
+// A batch is bound to the calling thread by a Scope object. When no batch is
+// bound to the calling thread, DataRequestBatch::RetrieveValue() simply calls
+// SwitchInterface::RetrieveValue(). The class is not thread-safe.
+class DataRequestBatch {
+ public:
+  // Binds a batch to the calling thread for the lifetime of the object.
+  class Scope {
+   public:
+    explicit Scope(DataRequestBatch* batch);
+    ~Scope();
+
+    // Scope is neither copyable nor movable.
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    // The batch bound to the calling thread before this object was created.
+    DataRequestBatch* const previous_;
+  };
+
+  DataRequestBatch();
+  virtual ~DataRequestBatch() {}
+
+  // Sends the requests recorded during the collect phase to the switch, one
+  // SwitchInterface::RetrieveValue() call per node, and switches the batch to
+  // the serve phase. Calling Dispatch() more than once is a no-op.
+  void Dispatch();
+
+  // Returns true if the batch is in the collect phase.
+  bool collecting() const { return !dispatched_; }
+
+  // Returns the number of requests recorded during the collect phase.
+  int num_requests() const { return num_requests_; }
+
+  // Drop-in replacement for SwitchInterface::RetrieveValue() used by the gNMI
+  // leaf handlers. Depending on the batch bound to the calling thread, it
+  // either records 'request', serves it from the batch, or forwards it to
+  // 'switch_interface'.
+  static ::util::Status RetrieveValue(SwitchInterface* switch_interface,
+                                      uint64 node_id,
+                                      const DataRequest& request,
+                                      WriterInterface<DataResponse>* writer,
+                                      std::vector<::util::Status>* details);
+
+  // Returns the batch bound to the calling thread or nullptr if there is none.
+  static DataRequestBatch* GetCurrent();
+
+  // DataRequestBatch is neither copyable nor movable.
+  DataRequestBatch(const DataRequestBatch&) = delete;
+  DataRequestBatch& operator=(const DataRequestBatch&) = delete;
+
+ private:
+  // The result of a single request, as returned by the switch.
+  struct Result {
+    ::util::Status status;
+    DataResponse response;
+  };
+
+  // The requests recorded for a single node, in the order they were recorded,
+  // together with the keys they are saved under in results_.
+  struct NodeRequests {
+    DataRequest request;
+    std::vector<std::string> keys;
+  };
+
+  // Returns the key used to find the result of 'request' sent to 'node_id'.
+  static std::string MakeKey(uint64 node_id,
+                             const DataRequest::Request& request);
+
+  // Records the requests found in 'request'. Returns false if they cannot be
+  // batched and need to be sent to the switch as-is.
+  bool Collect(SwitchInterface* switch_interface, uint64 node_id,
+               const DataRequest& request);
+
+  // Serves 'request' from the results received by Dispatch(). Returns false if
+  // any of its requests has no result and 'request' needs to be sent to the
+  // switch as-is.
+  bool Serve(SwitchInterface* switch_interface, uint64 node_id,
+             const DataRequest& request, WriterInterface<DataResponse>* writer,
+             std::vector<::util::Status>* details) const;
+
+  // The switch the requests are sent to. Set by the first recorded request.
+  // Not owned by the class.
+  SwitchInterface* switch_interface_;
+
+  // Set to true by Dispatch().
+  bool dispatched_;
+
+  // Num of distinct requests recorded during the collect phase.
+  int num_requests_;
+
+  // The requests recorded during the collect phase, keyed by node ID.
+  std::map<uint64, NodeRequests> node_to_requests_;
+
+  // The keys of all the recorded requests. Used to drop duplicates.
+  absl::flat_hash_set<std::string> recorded_keys_;
+
+  // The results received by Dispatch(), keyed by MakeKey().
+  absl::flat_hash_map<std::string, Result> results_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_DATA_REQUEST_BATCH_H_
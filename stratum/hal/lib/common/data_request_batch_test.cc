@@ -0,0 +1,194 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/data_request_batch.h"
+
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+// Saves the MAC address received from the switch.
+class MacAddressWriter : public WriterInterface<DataResponse> {
+ public:
+  MacAddressWriter() : mac_address_(0), num_writes_(0) {}
+
+  bool Write(const DataResponse& resp) override {
+    if (!resp.has_mac_address()) return false;
+    mac_address_ = resp.mac_address().mac_address();
+    ++num_writes_;
+    return true;
+  }
+
+  uint64 mac_address() const { return mac_address_; }
+  int num_writes() const { return num_writes_; }
+
+ private:
+  uint64 mac_address_;
+  int num_writes_;
+};
+
+class DataRequestBatchTest : public ::testing::Test {
+ protected:
+  static constexpr uint64 kNodeId1 = 123;
+  static constexpr uint64 kNodeId2 = 456;
+  static constexpr uint32 kFailedPortId = 99;
+
+  // Mock implementation of RetrieveValue() which returns the port ID as the
+  // MAC address of each port, and fails for kFailedPortId. It adds one status
+  // per request to 'details' the same way most of the switches do.
+  ::util::Status RetrieveValue(uint64 node_id, const DataRequest& req,
+                               WriterInterface<DataResponse>* writer,
+                               std::vector<::util::Status>* details) {
+    ++num_calls_;
+    num_requests_ += req.requests_size();
+    for (const auto& request : req.requests()) {
+      EXPECT_EQ(node_id, request.mac_address().node_id());
+      ::util::Status status = ::util::OkStatus();
+      if (request.mac_address().port_id() == kFailedPortId) {
+        status = MAKE_ERROR(ERR_INVALID_PARAM) << "Port not found.";
+      } else {
+        DataResponse resp;
+        resp.mutable_mac_address()->set_mac_address(
+            request.mac_address().port_id());
+        writer->Write(resp);
+      }
+      if (details) details->push_back(status);
+    }
+    return ::util::OkStatus();
+  }
+
+  void SetUp() override {
+    ON_CALL(switch_, RetrieveValue(_, _, _, _))
+        .WillByDefault(Invoke(this, &DataRequestBatchTest::RetrieveValue));
+  }
+
+  // Requests the MAC address of the given port like a gNMI leaf handler does
+  // and returns the writer the response was written to.
+  MacAddressWriter GetMacAddress(uint64 node_id, uint32 port_id,
+                                 std::vector<::util::Status>* details) {
+    DataRequest req;
+    auto* request = req.add_requests()->mutable_mac_address();
+    request->set_node_id(node_id);
+    request->set_port_id(port_id);
+    MacAddressWriter writer;
+    EXPECT_OK(DataRequestBatch::RetrieveValue(&switch_, node_id, req, &writer,
+                                              details));
+    return writer;
+  }
+
+  ::testing::NiceMock<SwitchMock> switch_;
+  int num_calls_ = 0;
+  int num_requests_ = 0;
+};
+
+constexpr uint64 DataRequestBatchTest::kNodeId1;
+constexpr uint64 DataRequestBatchTest::kNodeId2;
+constexpr uint32 DataRequestBatchTest::kFailedPortId;
+
+TEST_F(DataRequestBatchTest, ForwardsRequestsWithoutBatch) {
+  EXPECT_EQ(nullptr, DataRequestBatch::GetCurrent());
+  EXPECT_EQ(1, GetMacAddress(kNodeId1, 1, nullptr).mac_address());
+  EXPECT_EQ(2, GetMacAddress(kNodeId1, 2, nullptr).mac_address());
+  EXPECT_EQ(2, num_calls_);
+}
+
+TEST_F(DataRequestBatchTest, SendsOneRequestPerNode) {
+  DataRequestBatch batch;
+  {
+    DataRequestBatch::Scope scope(&batch);
+    EXPECT_EQ(&batch, DataRequestBatch::GetCurrent());
+    // Nothing is written during the collect phase.
+    EXPECT_EQ(0, GetMacAddress(kNodeId1, 1, nullptr).num_writes());
+    EXPECT_EQ(0, GetMacAddress(kNodeId1, 2, nullptr).num_writes());
+    EXPECT_EQ(0, GetMacAddress(kNodeId1, 1, nullptr).num_writes());
+    EXPECT_EQ(0, GetMacAddress(kNodeId2, 3, nullptr).num_writes());
+  }
+  EXPECT_EQ(nullptr, DataRequestBatch::GetCurrent());
+  EXPECT_EQ(0, num_calls_);
+  // The duplicated request is sent once.
+  EXPECT_EQ(3, batch.num_requests());
+
+  batch.Dispatch();
+  EXPECT_FALSE(batch.collecting());
+  EXPECT_EQ(2, num_calls_);
+  EXPECT_EQ(3, num_requests_);
+
+  DataRequestBatch::Scope scope(&batch);
+  EXPECT_EQ(1, GetMacAddress(kNodeId1, 1, nullptr).mac_address());
+  EXPECT_EQ(2, GetMacAddress(kNodeId1, 2, nullptr).mac_address());
+  EXPECT_EQ(3, GetMacAddress(kNodeId2, 3, nullptr).mac_address());
+  EXPECT_EQ(2, num_calls_);
+
+  // The requests which were not collected are sent to the switch.
+  EXPECT_EQ(4, GetMacAddress(kNodeId2, 4, nullptr).mac_address());
+  EXPECT_EQ(3, num_calls_);
+}
+
+TEST_F(DataRequestBatchTest, ServesFailedRequestWithoutResponse) {
+  DataRequestBatch batch;
+  {
+    DataRequestBatch::Scope scope(&batch);
+    GetMacAddress(kNodeId1, 1, nullptr);
+    GetMacAddress(kNodeId1, kFailedPortId, nullptr);
+    GetMacAddress(kNodeId1, 2, nullptr);
+  }
+  batch.Dispatch();
+  EXPECT_EQ(1, num_calls_);
+
+  DataRequestBatch::Scope scope(&batch);
+  std::vector<::util::Status> details;
+  EXPECT_EQ(0, GetMacAddress(kNodeId1, kFailedPortId, &details).num_writes());
+  ASSERT_EQ(1, details.size());
+  EXPECT_EQ(ERR_INVALID_PARAM, details[0].error_code());
+  // The responses following the failed request are not shifted.
+  EXPECT_EQ(2, GetMacAddress(kNodeId1, 2, nullptr).mac_address());
+  EXPECT_EQ(1, num_calls_);
+}
+
+TEST_F(DataRequestBatchTest, FallsBackToSingleRequestsOnMismatch) {
+  // A switch which only returns the status of the whole request, and fails
+  // to write some of the responses, cannot be matched.
+  EXPECT_CALL(switch_, RetrieveValue(kNodeId1, _, _, _))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillRepeatedly(Invoke(this, &DataRequestBatchTest::RetrieveValue));
+
+  DataRequestBatch batch;
+  {
+    DataRequestBatch::Scope scope(&batch);
+    GetMacAddress(kNodeId1, 1, nullptr);
+    GetMacAddress(kNodeId1, 2, nullptr);
+  }
+  batch.Dispatch();
+
+  DataRequestBatch::Scope scope(&batch);
+  EXPECT_EQ(1, GetMacAddress(kNodeId1, 1, nullptr).mac_address());
+  EXPECT_EQ(2, GetMacAddress(kNodeId1, 2, nullptr).mac_address());
+  EXPECT_EQ(2, num_calls_);
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_GNMI_CAPS_H_
+#define STRATUM_HAL_LIB_COMMON_GNMI_CAPS_H_
+
+namespace stratum {
+namespace hal {
+
+// The ::gnmi::CapabilityResponse returned to the gNMI Capabilities RPC, in the
+// text format. Its definition is generated at build time from gnmi_caps.pb.txt,
+// so the response does not depend on any file being present on the switch.
+extern const char kGnmiCapabilitiesText[];
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_GNMI_CAPS_H_
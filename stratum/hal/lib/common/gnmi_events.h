@@ -19,10 +19,13 @@
 #ifndef STRATUM_HAL_LIB_COMMON_GNMI_EVENTS_H_
 #define STRATUM_HAL_LIB_COMMON_GNMI_EVENTS_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <list>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "gnmi/gnmi.grpc.pb.h"
 #include "stratum/glue/status/status.h"
@@ -56,6 +59,8 @@ namespace hal {
 // C++ template and inheritence magic is used to make the whole process as
 // automatic (i.e. without explicit code) as possible.
 
+class EventHandlerRecord;
+
 // A base class for all types of events the gNMI GnmiPublisher handles.
 // Allows for using pointer of type GnmiEvent* to reference an event of any
 // type.
@@ -67,6 +72,12 @@ class GnmiEvent {
   // Triggers processing of this event. The processing is different for each
   // type of an event, so, each type will define its version of this method.
   virtual ::util::Status Process() const = 0;
+
+  // Returns the handlers registered for this type of event, so that they can
+  // be called by the caller, e.g. in parallel. Each type will define its
+  // version of this method.
+  virtual std::vector<std::shared_ptr<EventHandlerRecord>> GetHandlers()
+      const = 0;
 };
 using GnmiEventPtr = std::shared_ptr<GnmiEvent>;
 
@@ -80,6 +91,8 @@ template <typename E>
 class GnmiEventProcess : public GnmiEvent {
  public:
   ::util::Status Process() const override;
+  std::vector<std::shared_ptr<EventHandlerRecord>> GetHandlers()
+      const override;
 };
 
 // A Timer event. Only certain type of subscriptions, like interface statistics,
@@ -523,6 +536,11 @@ class InlineGnmiSubscribeStream : public GnmiSubscribeStream {
 using GnmiEventHandler = std::function<::util::Status(
     const GnmiEvent& event, GnmiSubscribeStream* stream)>;
 
+// A functor returning the GnmiEventHandler to be called for an event. Allows
+// for looking up the handler while holding a lock and calling it once the lock
+// has been released.
+using GnmiEventHandlerResolver = std::function<GnmiEventHandler()>;
+
 // A class that provides limited (but sufficient) copy-on-write
 // functionality - it makes a copy of the original chassis config only if a
 // mutable pointer is requested. It is used to avoid unnecessary copies of
@@ -604,29 +622,63 @@ using GnmiDeleteHandler = std::function<::util::Status(
 // A class used to keep information about a subscription.
 class EventHandlerRecord {
  public:
-  // Constructor.
+  // Constructor. The records of all the subscriptions made over the same
+  // stream share 'stream_lock', which serializes their handlers, and hence
+  // the writes to the stream. If 'stream_lock' is nullptr, the record gets a
+  // lock of its own.
   EventHandlerRecord(const GnmiEventHandler& handler,
-                     GnmiSubscribeStream* stream)
-      : handler_(handler), stream_(stream) {}
+                     GnmiSubscribeStream* stream,
+                     std::shared_ptr<absl::Mutex> stream_lock = nullptr)
+      : handler_(handler),
+        stream_(stream),
+        stream_lock_(stream_lock != nullptr ? std::move(stream_lock)
+                                            : std::make_shared<absl::Mutex>()) {
+  }
+  // Constructor. Same as above but the handler is looked up by calling
+  // 'resolver' every time an event is to be handled.
+  EventHandlerRecord(const GnmiEventHandlerResolver& resolver,
+                     GnmiSubscribeStream* stream,
+                     std::shared_ptr<absl::Mutex> stream_lock = nullptr)
+      : EventHandlerRecord(GnmiEventHandler(), stream, std::move(stream_lock)) {
+    resolver_ = resolver;
+  }
   // Destructor.
   virtual ~EventHandlerRecord() {}
 
-  // Generic processing of an event.
-  ::util::Status operator()(const GnmiEvent& event) const {
-    auto status = handler_(event, stream_);
+  // Returns the handler to be passed to Call().
+  GnmiEventHandler Resolve() const {
+    return resolver_ != nullptr ? resolver_() : handler_;
+  }
+
+  // Calls 'handler' with 'event' and the stream of this record. The handlers of
+  // records sharing the same stream never run concurrently, while other
+  // records are not blocked.
+  ::util::Status Call(const GnmiEventHandler& handler,
+                      const GnmiEvent& event) const {
+    absl::MutexLock l(stream_lock_.get());
+    auto status = handler(event, stream_);
     if (status != ::util::OkStatus()) {
       return status;
     }
     return ::util::OkStatus();
   }
 
+  // Generic processing of an event.
+  ::util::Status operator()(const GnmiEvent& event) const {
+    return Call(Resolve(), event);
+  }
+
   TimerDaemon::DescriptorPtr* mutable_timer() { return &timer_; }
 
  protected:
   // The handler functor. Is called every time there is an event to handle.
   GnmiEventHandler handler_;
+  // If set, returns the handler functor to be used instead of 'handler_'.
+  GnmiEventHandlerResolver resolver_;
   // A stream to the client (the controller).
   GnmiSubscribeStream* stream_;
+  // The lock serializing the handlers writing to 'stream_'.
+  std::shared_ptr<absl::Mutex> stream_lock_;
   // Not every EventHandler is executed on timer, but some are and this is the
   // handler that is used by the timer sub-system.
   TimerDaemon::DescriptorPtr timer_;
@@ -642,6 +694,14 @@ using SubscriptionHandle = std::shared_ptr<EventHandlerRecord>;
 // - to implement Register() and UnRegister() methods (to limit code-bloat)
 class EventHandlerListBase {
  public:
+  // The list of handlers as seen by the readers. It is never modified once
+  // published: Register() and UnRegister() publish a new copy instead, so
+  // that the events can be processed without holding any lock.
+  using HandlerSnapshot = std::vector<EventHandlerRecordPtr>;
+
+  EventHandlerListBase()
+      : snapshot_(std::make_shared<const HandlerSnapshot>()) {}
+
   // A hierarchy of classes uses this class as base, so, virtual destructor is
   // needed.
   virtual ~EventHandlerListBase() {}
@@ -657,6 +717,7 @@ class EventHandlerListBase {
       LOCKS_EXCLUDED(access_lock_) {
     absl::WriterMutexLock l(&access_lock_);
     handlers_.insert(record);
+    PublishSnapshot();
     return ::util::OkStatus();
   }
 
@@ -666,6 +727,7 @@ class EventHandlerListBase {
       LOCKS_EXCLUDED(access_lock_) {
     absl::WriterMutexLock l(&access_lock_);
     handlers_.erase(record);
+    PublishSnapshot();
     return ::util::OkStatus();
   }
 
@@ -678,6 +740,29 @@ class EventHandlerListBase {
     return handlers_.size();
   }
 
+  // Returns the handlers which are still active. Does not take the lock unless
+  // some subscriptions have been canceled since the last call.
+  std::vector<SubscriptionHandle> GetActiveHandlers()
+      LOCKS_EXCLUDED(access_lock_) {
+    std::shared_ptr<const HandlerSnapshot> snapshot =
+        std::atomic_load(&snapshot_);
+    std::vector<SubscriptionHandle> handlers;
+    handlers.reserve(snapshot->size());
+    bool found_expired = false;
+    for (const auto& entry : *snapshot) {
+      if (auto handler = entry.lock()) {
+        handlers.push_back(std::move(handler));
+      } else {
+        found_expired = true;
+      }
+    }
+    if (found_expired) {
+      absl::WriterMutexLock l(&access_lock_);
+      CleanUpInactiveRegistrations();
+    }
+    return handlers;
+  }
+
  protected:
   // Removes pointers that are expired.
   void CleanUpInactiveRegistrations() EXCLUSIVE_LOCKS_REQUIRED(access_lock_) {
@@ -694,6 +779,15 @@ class EventHandlerListBase {
     for (const auto& handler : entries_to_be_removed) {
       handlers_.erase(handler);
     }
+    if (!entries_to_be_removed.empty()) PublishSnapshot();
+  }
+
+  // Makes the current contents of handlers_ visible to the readers.
+  void PublishSnapshot() EXCLUSIVE_LOCKS_REQUIRED(access_lock_) {
+    std::atomic_store(&snapshot_,
+                      std::shared_ptr<const HandlerSnapshot>(
+                          std::make_shared<const HandlerSnapshot>(
+                              handlers_.begin(), handlers_.end())));
   }
 
   // A Mutex used to guard access to the map of pointers to handlers.
@@ -702,6 +796,10 @@ class EventHandlerListBase {
   // A set of event handlers that are interested in this ('E') type of events.
   std::set<EventHandlerRecordPtr, std::owner_less<EventHandlerRecordPtr>>
       handlers_ GUARDED_BY(access_lock_);
+
+  // The last published copy of handlers_. Only accessed with
+  // std::atomic_load() and std::atomic_store().
+  std::shared_ptr<const HandlerSnapshot> snapshot_;
 };
 
 // A class that keeps track of all event handlers that are interested in
@@ -724,14 +822,10 @@ class EventHandlerList : public EventHandlerListBase {
   // It goes through the list of registered event handlers and calls each of
   // them with the 'event' to be processed.
   ::util::Status Process(const GnmiEvent& base_event) override {
-    absl::WriterMutexLock l(&access_lock_);
     if (const E* event = dynamic_cast<const E*>(&base_event)) {
       VLOG(1) << "Handling " << typeid(E).name();
-      CleanUpInactiveRegistrations();
-      for (const auto& entry : handlers_) {
-        if (auto handler = entry.lock()) {
-          (*handler)(*event).IgnoreError();
-        }
+      for (const auto& handler : GetActiveHandlers()) {
+        (*handler)(*event).IgnoreError();
       }
     } else {
       // This __really__ should never happen!
@@ -756,6 +850,13 @@ template <typename E>
   return EventHandlerList<E>::GetInstance()->Process(*this);
 }
 
+// Implementation of the abstract GnmiEvent::GetHandlers() specialized for each
+// type of event.
+template <typename E>
+std::vector<SubscriptionHandle> GnmiEventProcess<E>::GetHandlers() const {
+  return EventHandlerList<E>::GetInstance()->GetActiveHandlers();
+}
+
 }  // namespace hal
 }  // namespace stratum
 
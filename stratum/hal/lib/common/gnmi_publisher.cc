@@ -19,27 +19,53 @@
 #include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "gflags/gflags.h"
 #include "gnmi/gnmi.pb.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
 #include "absl/synchronization/mutex.h"
 #include "stratum/glue/gtl/map_util.h"
 
+DEFINE_int32(gnmi_publisher_num_handler_threads, 4,
+             "Num of threads calling the handlers of the gNMI subscriptions "
+             "when an event is received from the switch. If 0, the handlers "
+             "are called by the thread which received the event.");
+
 namespace stratum {
 namespace hal {
 
 GnmiPublisher::GnmiPublisher(SwitchInterface* switch_interface)
     : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       parse_tree_(ABSL_DIE_IF_NULL(switch_interface)),
+      shutdown_(false),
       event_channel_(nullptr),
       on_config_pushed_(
           new EventHandlerRecord(on_config_pushed_func_, nullptr)) {
   Register<ConfigHasBeenPushedEvent>(EventHandlerRecordPtr(on_config_pushed_))
       .IgnoreError();
+  for (int i = 0; i < FLAGS_gnmi_publisher_num_handler_threads; ++i) {
+    pthread_t tid;
+    int ret = pthread_create(&tid, nullptr, ThreadRunHandlers, this);
+    if (ret != 0) {
+      // Not fatal, the handlers are called by the thread receiving the event
+      // if there are no handler threads.
+      LOG(ERROR) << "Failed to spawn gNMI handler thread. Err: " << ret << ".";
+      break;
+    }
+    handler_tids_.push_back(tid);
+  }
 }
 
-GnmiPublisher::~GnmiPublisher() {}
+GnmiPublisher::~GnmiPublisher() {
+  {
+    absl::MutexLock l(&handler_queue_lock_);
+    shutdown_ = true;
+    handler_queue_cond_.SignalAll();
+  }
+  for (pthread_t tid : handler_tids_) pthread_join(tid, nullptr);
+}
 
 ::util::Status GnmiPublisher::HandleUpdate(
     const ::gnmi::Path& path, const ::google::protobuf::Message& val,
@@ -98,31 +124,95 @@ GnmiPublisher::~GnmiPublisher() {}
 }
 
 ::util::Status GnmiPublisher::HandleChange(const GnmiEvent& event) {
-  absl::WriterMutexLock l(&access_lock_);
-
-  ::util::Status status = event.Process();
-  if (status != ::util::OkStatus()) LOG(ERROR) << status;
+  // The handlers are taken from a snapshot of the list of handlers registered
+  // for this type of event, so, no lock is needed here.
+  RunHandlers(event, event.GetHandlers());
 
   return ::util::OkStatus();
 }
 
+void GnmiPublisher::RunHandlers(
+    const GnmiEvent& event, const std::vector<SubscriptionHandle>& handlers) {
+  if (handlers.empty()) return;
+  absl::BlockingCounter done(handlers.size() - 1);
+  if (handlers.size() > 1) {
+    absl::MutexLock l(&handler_queue_lock_);
+    for (size_t i = 1; i < handlers.size(); ++i) {
+      handler_queue_.push_back(
+          HandlerTask{&event, handlers[i].get(), &done});
+    }
+    handler_queue_cond_.SignalAll();
+  }
+  CallHandler(event, handlers[0].get()).IgnoreError();
+  // Help with the queued handlers rather than waiting idle. This also
+  // guarantees progress if there are no handler threads.
+  while (RunQueuedHandler()) continue;
+  done.Wait();
+}
+
+bool GnmiPublisher::RunQueuedHandler() {
+  HandlerTask task;
+  {
+    absl::MutexLock l(&handler_queue_lock_);
+    if (handler_queue_.empty()) return false;
+    task = handler_queue_.front();
+    handler_queue_.pop_front();
+  }
+  CallHandler(*task.event, task.handler).IgnoreError();
+  task.done->DecrementCount();
+
+  return true;
+}
+
+::util::Status GnmiPublisher::CallHandler(const GnmiEvent& event,
+                                          EventHandlerRecord* handler) {
+  // The handler of the config push rebuilds the parse tree, so it takes the
+  // lock as a writer itself.
+  if (handler == on_config_pushed_.get()) return (*handler)(event);
+  // The other handlers are looked up in the parse tree, which must not be
+  // modified meanwhile. The handler found does not access the tree, so it is
+  // called, and may block writing to the stream, without holding the lock.
+  GnmiEventHandler resolved;
+  {
+    absl::ReaderMutexLock l(&access_lock_);
+    resolved = handler->Resolve();
+  }
+  return handler->Call(resolved, event);
+}
+
+void GnmiPublisher::HandlerThreadLoop() {
+  while (true) {
+    {
+      absl::MutexLock l(&handler_queue_lock_);
+      while (!shutdown_ && handler_queue_.empty()) {
+        handler_queue_cond_.Wait(&handler_queue_lock_);
+      }
+      if (shutdown_) break;
+    }
+    RunQueuedHandler();
+  }
+}
+
+void* GnmiPublisher::ThreadRunHandlers(void* arg) {
+  CHECK(arg != nullptr);
+  reinterpret_cast<GnmiPublisher*>(arg)->HandlerThreadLoop();
+  return nullptr;
+}
+
 ::util::Status GnmiPublisher::HandleEvent(
     const GnmiEvent& event, const std::weak_ptr<EventHandlerRecord>& h) {
-  absl::WriterMutexLock l(&access_lock_);
-
   // In order to reference a weak pointer, first it has to be used to create a
-  // shared pointer.
+  // shared pointer. The record itself serializes the handlers of its stream.
   if (std::shared_ptr<EventHandlerRecord> handler = h.lock()) {
-    RETURN_IF_ERROR((*handler)(event));
+    RETURN_IF_ERROR(CallHandler(event, handler.get()));
   }
   return ::util::OkStatus();
 }
 
 ::util::Status GnmiPublisher::HandlePoll(const SubscriptionHandle& handle) {
-  absl::WriterMutexLock l(&access_lock_);
-
   ::util::Status status;
-  if ((status = (*handle)(PollEvent())) != ::util::OkStatus()) {
+  if ((status = CallHandler(PollEvent(), handle.get())) !=
+      ::util::OkStatus()) {
     // Something went wrong.
     LOG(ERROR) << "Handler returned non-OK status: " << status;
   }
@@ -134,7 +224,7 @@ GnmiPublisher::~GnmiPublisher() {}
                                                 GnmiSubscribeStream* stream,
                                                 SubscriptionHandle* h) {
   auto status = Subscribe(&TreeNode::AllSubtreeLeavesSupportOnTimer,
-                          &TreeNode::GetOnTimerHandler, path, stream, h);
+                          &TreeNode::ResolveOnTimerHandler, path, stream, h);
   if (status != ::util::OkStatus()) {
     return status;
   }
@@ -154,14 +244,14 @@ GnmiPublisher::~GnmiPublisher() {}
                                             GnmiSubscribeStream* stream,
                                             SubscriptionHandle* h) {
   return Subscribe(&TreeNode::AllSubtreeLeavesSupportOnPoll,
-                   &TreeNode::GetOnPollHandler, path, stream, h);
+                   &TreeNode::ResolveOnPollHandler, path, stream, h);
 }
 
 ::util::Status GnmiPublisher::SubscribeOnChange(const ::gnmi::Path& path,
                                                 GnmiSubscribeStream* stream,
                                                 SubscriptionHandle* h) {
   auto status = Subscribe(&TreeNode::AllSubtreeLeavesSupportOnChange,
-                          &TreeNode::GetOnChangeHandler, path, stream, h);
+                          &TreeNode::ResolveOnChangeHandler, path, stream, h);
   if (status != ::util::OkStatus()) {
     return status;
   }
@@ -204,11 +294,41 @@ GnmiPublisher::~GnmiPublisher() {}
            << "Not all leaves on the path (" << path.ShortDebugString()
            << ") support this mode!";
   }
-  // All good! Save the handler that handles this leaf.
-  h->reset(new EventHandlerRecord((node->*get_handler)(), stream));
+  // All good! Save the handler that handles this leaf. It is looked up again
+  // for each event, as the handlers of the subtree change when a new config
+  // is pushed. The node itself is never removed from the tree.
+  h->reset(new EventHandlerRecord(
+      [node, get_handler]() { return (node->*get_handler)(); }, stream,
+      GetStreamLock(stream)));
   return ::util::OkStatus();
 }
 
+std::shared_ptr<absl::Mutex> GnmiPublisher::GetStreamLock(
+    GnmiSubscribeStream* stream) {
+  auto& entry = stream_locks_[stream];
+  std::shared_ptr<absl::Mutex> lock = entry.lock();
+  if (lock == nullptr) {
+    lock = std::make_shared<absl::Mutex>();
+    entry = lock;
+    // A new stream. Forget the streams all subscriptions of which are gone.
+    for (auto it = stream_locks_.begin(); it != stream_locks_.end();) {
+      if (it->second.expired()) {
+        stream_locks_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return lock;
+}
+
+bool GnmiPublisher::IsConfigDerived(const ::gnmi::Path& path) {
+  absl::ReaderMutexLock l(&access_lock_);
+  const TreeNode* node = parse_tree_.FindNodeOrNull(path);
+  return node != nullptr && node->AllSubtreeLeavesAreConfigDerived();
+}
+
 ::util::Status GnmiPublisher::UnSubscribe(const SubscriptionHandle& h) {
   absl::WriterMutexLock l(&access_lock_);
   // There is no way to match a subscription to a certain type of event.
@@ -247,15 +367,26 @@ GnmiPublisher::UpdateSubscriptionWithTargetSpecificModeSpecification(
     LOG(ERROR) << "Message cannot be sent as the stream pointer is null!";
     return MAKE_ERROR(ERR_INTERNAL) << "stream pointer is null!";
   }
+  // Do not interleave with the handlers writing to the same stream.
+  std::shared_ptr<absl::Mutex> stream_lock;
+  {
+    absl::WriterMutexLock l(&access_lock_);
+    stream_lock = GetStreamLock(stream);
+  }
+  absl::MutexLock l(stream_lock.get());
   return YangParseTreePaths::SendEndOfSeriesMessage(stream);
 }
 
 void GnmiPublisher::ReadGnmiEvents(
     const std::unique_ptr<ChannelReader<GnmiEventPtr>>& reader) {
+  std::vector<GnmiEventPtr> events;
   do {
-    GnmiEventPtr event_ptr;
-    // Block on the next event message from the Channel.
-    int code = reader->Read(&event_ptr, absl::InfiniteDuration()).error_code();
+    // Block on the next event message from the Channel, and take whatever
+    // else is queued along with it.
+    int code = reader
+                   ->ReadBatch(&events, kMaxGnmiEventBatchSize,
+                               absl::InfiniteDuration())
+                   .error_code();
     // Exit if the Channel is closed.
     if (code == ERR_CANCELLED) break;
     // Read should never timeout.
@@ -263,9 +394,11 @@ void GnmiPublisher::ReadGnmiEvents(
       LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
       continue;
     }
-    // Handle received message.
-    ::util::Status status = HandleChange(*event_ptr);
-    if (status != ::util::OkStatus()) LOG(ERROR) << status;
+    // Handle received messages.
+    for (const auto& event_ptr : events) {
+      ::util::Status status = HandleChange(*event_ptr);
+      if (status != ::util::OkStatus()) LOG(ERROR) << status;
+    }
   } while (true);
 }
 
@@ -285,7 +418,10 @@ void* GnmiPublisher::ThreadReadGnmiEvents(void* arg) {
   // If we have not done that yet, create notification event Channel, register
   // it, and create Reader thread.
   if (event_channel_ == nullptr && switch_interface_ != nullptr) {
-    event_channel_ = Channel<GnmiEventPtr>::Create(kMaxGnmiEventDepth);
+    // Events are written by many threads and read only by the reader thread
+    // created below.
+    event_channel_ = Channel<GnmiEventPtr>::Create(
+        kMaxGnmiEventDepth, ChannelType::kMultiProducerSingleConsumer);
     // Create and register writer to channel with the BcmSdkInterface.
     auto writer = std::make_shared<ChannelWriterWrapper<GnmiEventPtr>>(
         ChannelWriter<GnmiEventPtr>::Create(event_channel_));
@@ -25,7 +25,9 @@
 #include <memory>
 #include <string>
 #include <algorithm>
+#include <deque>
 #include <map>
+#include <vector>
 
 #include "gnmi/gnmi.grpc.pb.h"
 // FIXME(boc) is this required?
@@ -36,6 +38,7 @@
 #include "stratum/hal/lib/common/yang_parse_tree.h"
 #include "stratum/lib/timer_daemon.h"
 #include "stratum/public/lib/error.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/container/flat_hash_map.h"
 #include "stratum/glue/gtl/map_util.h"
@@ -80,6 +83,14 @@ class PeriodicWithHeartbeat : public Frequency {
 
 // The main class responsible for handling all aspects of gNMI subscriptions and
 // notifications.
+// The access_lock_ is held as a writer while the subscriptions are created or
+// removed and while the parse tree is modified. When an event is delivered, it
+// is held as a reader only while the handlers are looked up in the parse tree;
+// the handlers found are called, and write to the streams, without holding it.
+// The handlers of the subscriptions made over the same stream are serialized
+// by a lock shared by these subscriptions, and the handlers of an event
+// received from the switch are called in parallel on a pool of
+// --gnmi_publisher_num_handler_threads threads.
 class GnmiPublisher {
  protected:
   using SupportOnPtr = bool (TreeNode::*)() const;
@@ -87,6 +98,8 @@ class GnmiPublisher {
 
  public:
   static constexpr int kMaxGnmiEventDepth = 256;
+  // The max number of events read at once from the event Channel.
+  static constexpr int kMaxGnmiEventBatchSize = 32;
 
   // Constructor.
   explicit GnmiPublisher(SwitchInterface*);
@@ -107,8 +120,10 @@ class GnmiPublisher {
                                       CopyOnWriteChassisConfig* config)
       LOCKS_EXCLUDED(access_lock_);
 
+  // Passes 'event' to all the handlers registered for its type and waits for
+  // all of them to finish.
   ::util::Status HandleChange(const GnmiEvent& event)
-      LOCKS_EXCLUDED(access_lock_);
+      LOCKS_EXCLUDED(access_lock_, handler_queue_lock_);
 
   virtual ::util::Status HandlePoll(const SubscriptionHandle& handle)
       LOCKS_EXCLUDED(access_lock_);
@@ -139,11 +154,19 @@ class GnmiPublisher {
       const ::gnmi::Path& path, ::gnmi::Subscription* subscription)
       LOCKS_EXCLUDED(access_lock_);
 
+  // Returns true if 'path' is supported and the values of all the leaves under
+  // it are derived from the pushed chassis config only (see
+  // TreeNode::SetIsConfigDerived()), i.e. they change only when a new config is
+  // pushed or the leaves are set.
+  virtual bool IsConfigDerived(const ::gnmi::Path& path)
+      LOCKS_EXCLUDED(access_lock_);
+
   virtual ::util::Status UnSubscribe(const SubscriptionHandle& h)
       LOCKS_EXCLUDED(access_lock_);
 
   // The method sends a gNMI message denoting the end of initial set of values.
-  virtual ::util::Status SendSyncResponse(GnmiSubscribeStream* stream);
+  virtual ::util::Status SendSyncResponse(GnmiSubscribeStream* stream)
+      LOCKS_EXCLUDED(access_lock_);
 
   // Method creating the channel to be used to receive notifications from
   // the switch.
@@ -161,6 +184,14 @@ class GnmiPublisher {
     std::unique_ptr<ChannelReader<T>> reader;
   };
 
+  // A handler of an event to be executed by one of the handler threads.
+  struct HandlerTask {
+    const GnmiEvent* event;
+    EventHandlerRecord* handler;
+    // Decremented once the handler has finished.
+    absl::BlockingCounter* done;
+  };
+
   // A family of helper methods that simplify registration of event handlers
   // with correct event handler list.
   template <typename E>
@@ -183,6 +214,33 @@ class GnmiPublisher {
                            GnmiSubscribeStream* stream, SubscriptionHandle* h)
       LOCKS_EXCLUDED(access_lock_);
 
+  // Looks up the handler of 'handler' holding access_lock_ as a reader and
+  // calls it with 'event' once the lock has been released. The handler of the
+  // config push is called directly as it takes the lock as a writer.
+  ::util::Status CallHandler(const GnmiEvent& event,
+                             EventHandlerRecord* handler)
+      LOCKS_EXCLUDED(access_lock_);
+
+  // Returns the lock shared by all the subscriptions made over 'stream'.
+  std::shared_ptr<absl::Mutex> GetStreamLock(GnmiSubscribeStream* stream)
+      EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
+  // Calls all the 'handlers' with 'event'. All but the first handler are
+  // queued for the handler threads, and the calling thread helps executing
+  // the queued handlers until all of them have finished.
+  void RunHandlers(const GnmiEvent& event,
+                   const std::vector<SubscriptionHandle>& handlers)
+      LOCKS_EXCLUDED(handler_queue_lock_);
+
+  // Pops a handler from the queue and executes it. Returns false if the
+  // queue is empty.
+  bool RunQueuedHandler() LOCKS_EXCLUDED(handler_queue_lock_);
+
+  // The body of each handler thread. Executes the queued handlers until the
+  // publisher is destroyed.
+  void HandlerThreadLoop() LOCKS_EXCLUDED(handler_queue_lock_);
+  static void* ThreadRunHandlers(void* arg);
+
   // A handler of events received over the event_channel_ channel.
   void ReadGnmiEvents(
       const std::unique_ptr<ChannelReader<GnmiEventPtr>>& reader)
@@ -203,6 +261,27 @@ class GnmiPublisher {
   // that node.
   YangParseTree parse_tree_ GUARDED_BY(access_lock_);
 
+  // Map from each stream used by the subscriptions to the lock serializing
+  // their handlers. The locks are owned by the EventHandlerRecords.
+  absl::flat_hash_map<GnmiSubscribeStream*, std::weak_ptr<absl::Mutex>>
+      stream_locks_ GUARDED_BY(access_lock_);
+
+  // A Mutex used to guard access to the queue of handlers to be executed by the
+  // handler threads.
+  absl::Mutex handler_queue_lock_;
+
+  // Signaled when a handler is queued or the handler threads need to exit.
+  absl::CondVar handler_queue_cond_;
+
+  std::deque<HandlerTask> handler_queue_ GUARDED_BY(handler_queue_lock_);
+
+  // Set when the handler threads need to exit.
+  bool shutdown_ GUARDED_BY(handler_queue_lock_);
+
+  // The handler threads. Empty if all the handlers are executed by the thread
+  // which received the event.
+  std::vector<pthread_t> handler_tids_;
+
   // Channel for receiving transceiver events from the SwitchInterface.
   std::shared_ptr<Channel<GnmiEventPtr>> event_channel_
       GUARDED_BY(access_lock_);
@@ -212,8 +291,10 @@ class GnmiPublisher {
   std::function<::util::Status(const GnmiEvent&, GnmiSubscribeStream*)>
       on_config_pushed_func_ GUARDED_BY(access_lock_) =
           [this](const GnmiEvent& event_base, GnmiSubscribeStream* stream)
-              EXCLUSIVE_LOCKS_REQUIRED(access_lock_) {
-                // Special case - change of configuration.
+              LOCKS_EXCLUDED(access_lock_) {
+                // Special case - change of configuration. The parse tree is
+                // rebuilt, so, no subscriptions can be made meanwhile.
+                absl::WriterMutexLock l(&access_lock_);
                 // FIXME(boc) VLOG(1) does not appear to work inside of a lambda
                 // VLOG(1) << "Configuration has changed.";
                 // FIXME(boc) the following statement is a temporary hack
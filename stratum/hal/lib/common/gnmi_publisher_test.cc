@@ -16,14 +16,21 @@
 
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 
+#include <atomic>
+#include <thread>  // NOLINT
+
 #include "gnmi/gnmi.pb.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
 #include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/constants.h"
 #include "stratum/lib/utils.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 
 using ::testing::_;
 using ::testing::DoAll;
@@ -245,6 +252,134 @@ TEST_F(SubscriptionTest, HandleTimer) {
   EXPECT_OK(gnmi_publisher_->HandleChange(TimerEvent()));
 }
 
+TEST_F(SubscriptionTest, HandlersOfDifferentStreamsRunInParallel) {
+  ASSERT_OK(
+      gnmi_publisher_->HandleChange(ConfigHasBeenPushedEvent(hal_config_)));
+
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream1, &h1));
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream2, &h2));
+
+  EXPECT_CALL(stream1, Write(_, _)).WillOnce(Return(true));
+  EXPECT_CALL(stream2, Write(_, _)).WillOnce(Return(true));
+
+  // Each read waits until both subscriptions are being handled, which only
+  // happens if the handlers of the two streams run in parallel.
+  absl::Mutex lock;
+  int num_reads = 0;
+  bool timed_out = false;
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](uint64 node_id, const DataRequest& req,
+                                 WriterInterface<DataResponse>* w,
+                                 std::vector<::util::Status>* details) {
+        {
+          absl::MutexLock l(&lock);
+          ++num_reads;
+          if (!lock.AwaitWithTimeout(
+                  absl::Condition(+[](int* n) { return *n == 2; }, &num_reads),
+                  absl::Seconds(10))) {
+            timed_out = true;
+          }
+        }
+        DataResponse resp;
+        resp.mutable_admin_status()->set_state(ADMIN_STATE_ENABLED);
+        w->Write(resp);
+        return ::util::OkStatus();
+      }));
+
+  EXPECT_OK(gnmi_publisher_->HandleChange(TimerEvent()));
+  absl::MutexLock l(&lock);
+  EXPECT_FALSE(timed_out);
+}
+
+TEST_F(SubscriptionTest, HandlersOfSameStreamAreSerialized) {
+  ASSERT_OK(
+      gnmi_publisher_->HandleChange(ConfigHasBeenPushedEvent(hal_config_)));
+
+  SubscribeReaderWriterMock stream;
+  SubscriptionHandle h1, h2, h3;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  for (auto* h : {&h1, &h2, &h3}) {
+    ASSERT_OK(
+        gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream, h));
+  }
+
+  EXPECT_CALL(stream, Write(_, _)).Times(3).WillRepeatedly(Return(true));
+
+  absl::Mutex lock;
+  int running = 0, max_running = 0;
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](uint64 node_id, const DataRequest& req,
+                                 WriterInterface<DataResponse>* w,
+                                 std::vector<::util::Status>* details) {
+        {
+          absl::MutexLock l(&lock);
+          max_running = std::max(max_running, ++running);
+        }
+        absl::SleepFor(absl::Milliseconds(10));
+        {
+          absl::MutexLock l(&lock);
+          --running;
+        }
+        DataResponse resp;
+        resp.mutable_admin_status()->set_state(ADMIN_STATE_ENABLED);
+        w->Write(resp);
+        return ::util::OkStatus();
+      }));
+
+  EXPECT_OK(gnmi_publisher_->HandleChange(TimerEvent()));
+  absl::MutexLock l(&lock);
+  EXPECT_EQ(1, max_running);
+}
+
+// The handlers are called without holding the lock of the publisher, so a
+// handler waiting for the switch does not delay subscribing over other streams.
+TEST_F(SubscriptionTest, SlowHandlerDoesNotBlockSubscribe) {
+  ASSERT_OK(
+      gnmi_publisher_->HandleChange(ConfigHasBeenPushedEvent(hal_config_)));
+
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  ASSERT_OK(gnmi_publisher_->SubscribePoll(path, &stream1, &h1));
+
+  EXPECT_CALL(stream1, Write(_, _)).WillOnce(Return(true));
+
+  bool timed_out = false;
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .WillOnce(Invoke([&](uint64 node_id, const DataRequest& req,
+                           WriterInterface<DataResponse>* w,
+                           std::vector<::util::Status>* details) {
+        absl::Notification subscribed;
+        std::thread subscriber([&]() {
+          EXPECT_OK(gnmi_publisher_->SubscribePoll(path, &stream2, &h2));
+          subscribed.Notify();
+        });
+        timed_out =
+            !subscribed.WaitForNotificationWithTimeout(absl::Seconds(10));
+        subscriber.join();
+        DataResponse resp;
+        resp.mutable_admin_status()->set_state(ADMIN_STATE_ENABLED);
+        w->Write(resp);
+        return ::util::OkStatus();
+      }));
+
+  EXPECT_OK(gnmi_publisher_->HandlePoll(h1));
+  EXPECT_FALSE(timed_out);
+}
+
 TEST_F(SubscriptionTest, OnUpdateUnSupportedPath) {
   // Configure the device - the model will reconfigure itself to reflect the
   // configuration.
@@ -344,6 +479,43 @@ TEST_F(SubscriptionTest, PromisedOnChangeOnlyLeafsAreSupported) {
       GetPath("interfaces")("interface")("...")(), &stream, &h));
 }
 
+// A wildcard poll walks the children of the interfaces node, which are
+// replaced by each config push, so they must not be looked up while a config
+// is being pushed.
+TEST_F(SubscriptionTest, WildcardPollDuringConfigPush) {
+  SubscribeReaderWriterMock stream;
+  EXPECT_CALL(stream, Write(_, _)).WillRepeatedly(Return(true));
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  SubscriptionHandle h;
+  ASSERT_OK(gnmi_publisher_->SubscribePoll(
+      GetPath("interfaces")("interface")("...")(), &stream, &h));
+
+  // A config with more ports, which adds nodes to the parse tree.
+  ChassisConfig larger_config = hal_config_;
+  for (int i = 3; i <= 64; ++i) {
+    auto* singleton = larger_config.add_singleton_ports();
+    singleton->set_id(i);
+    singleton->set_name(absl::StrCat("device1.domain.net.com:ce-1/", i));
+    singleton->set_slot(1);
+    singleton->set_port(i);
+    singleton->set_speed_bps(kHundredGigBps);
+    singleton->set_node(1);
+  }
+
+  std::atomic<bool> done(false);
+  std::thread poller([&]() {
+    while (!done) EXPECT_OK(gnmi_publisher_->HandlePoll(h));
+  });
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_OK(gnmi_publisher_->HandleChange(
+        ConfigHasBeenPushedEvent(i % 2 ? hal_config_ : larger_config)));
+  }
+  done = true;
+  poller.join();
+}
+
 // FIXME(boc) google only (using new path)
 // Some of the paths support only OnPoll mode, so, they cannot be tested by
 // the parametrized test below.
@@ -52,6 +52,9 @@ DEFINE_uint32(grpc_max_recv_msg_size, 0,
               "grpc server max receive message size in MB");
 DEFINE_uint32(grpc_max_send_msg_size, 0,
               "grpc server max send message size in MB");
+DEFINE_bool(p4_async_service, false,
+            "Serve P4Runtime with the completion queue based async service, "
+            "instead of the sync one. See P4AsyncService.");
 
 namespace stratum {
 namespace hal {
@@ -220,7 +223,11 @@ Hal::~Hal() {
           FLAGS_grpc_max_send_msg_size * 1024 * 1024);
     }
     builder.RegisterService(config_monitoring_service_.get());
-    builder.RegisterService(p4_service_.get());
+    if (p4_async_service_ != nullptr) {
+      p4_async_service_->RegisterWithServerBuilder(&builder);
+    } else {
+      builder.RegisterService(p4_service_.get());
+    }
     builder.RegisterService(admin_service_.get());
     builder.RegisterService(certificate_management_service_.get());
     builder.RegisterService(diag_service_.get());
@@ -234,6 +241,7 @@ Hal::~Hal() {
     LOG(ERROR) << "Stratum external facing services are listening to "
                << absl::StrJoin(external_stratum_urls, ", ") << ", "
                << FLAGS_local_stratum_url << "...";
+    if (p4_async_service_ != nullptr) p4_async_service_->Start();
   }
 
   if (mode_ != OPERATION_MODE_SIM) {
@@ -248,6 +256,9 @@ Hal::~Hal() {
 
   external_server_->Wait();  // blocking until external_server_->Shutdown()
                              // is called. We dont wait on internal_service.
+  // Stop the async P4Runtime service before tearing down the P4Service which
+  // handles its RPCs.
+  if (p4_async_service_ != nullptr) p4_async_service_->Shutdown();
   return Teardown();
 }
 
@@ -300,6 +311,7 @@ Hal* Hal::GetSingleton() {
 ::util::Status Hal::InitializeServer() {
   CHECK_IS_NULL(config_monitoring_service_);
   CHECK_IS_NULL(p4_service_);
+  CHECK_IS_NULL(p4_async_service_);
   CHECK_IS_NULL(admin_service_);
   CHECK_IS_NULL(certificate_management_service_);
   CHECK_IS_NULL(diag_service_);
@@ -316,6 +328,9 @@ Hal* Hal::GetSingleton() {
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
   p4_service_ = absl::make_unique<P4Service>(
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
+  if (FLAGS_p4_async_service) {
+    p4_async_service_ = P4AsyncService::CreateInstance(p4_service_.get());
+  }
   admin_service_ = absl::make_unique<AdminService>(
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get(),
       SignalRcvCallback);
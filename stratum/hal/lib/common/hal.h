@@ -38,6 +38,7 @@
 #include "stratum/hal/lib/common/diag_service.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/file_service.h"
+#include "stratum/hal/lib/common/p4_async_service.h"
 #include "stratum/hal/lib/common/p4_service.h"
 #include "stratum/hal/lib/common/switch_interface.h"
 #include "stratum/lib/security/auth_policy_checker.h"
@@ -154,6 +155,8 @@ class Hal final {
   // Unique pointer to the HAL service classes. Owned by the class.
   std::unique_ptr<ConfigMonitoringService> config_monitoring_service_;
   std::unique_ptr<P4Service> p4_service_;
+  // Serves the RPCs of p4_service_ when --p4_async_service is set.
+  std::unique_ptr<P4AsyncService> p4_async_service_;
   std::unique_ptr<AdminService> admin_service_;
   std::unique_ptr<CertificateManagementService> certificate_management_service_;
   std::unique_ptr<DiagService> diag_service_;
@@ -0,0 +1,626 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/p4_async_service.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+
+DEFINE_int32(p4_async_num_cq_threads, 2,
+             "Number of completion queues, each with its own thread, used by "
+             "the async P4Runtime service to receive the RPCs and send their "
+             "responses.");
+DEFINE_int32(p4_async_num_read_threads, 2,
+             "Number of threads used by the async P4Runtime service to run "
+             "the Read RPCs, which block until the controller has received "
+             "each response.");
+DEFINE_int32(p4_stream_max_pending_packet_ins, 256,
+             "Max number of PacketIns queued for sending on a StreamChannel "
+             "by the async P4Runtime service. The PacketIns received when the "
+             "queue is full are dropped.");
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Max number of nodes with a writer thread of their own. The RPCs of the
+// nodes beyond that share a single writer thread.
+constexpr size_t kMaxNumNodeWriters = 32;
+
+// Key of the writer thread shared by the nodes beyond kMaxNumNodeWriters. Node
+// ID 0 is invalid, and the RPCs which use it are all rejected.
+constexpr uint64 kSharedNodeWriterKey = 0;
+
+// Returns the ID of the node the request is for.
+template <typename Request>
+uint64 GetNodeId(const Request& req) {
+  return req.device_id();
+}
+
+// Capabilities is not tied to a node.
+uint64 GetNodeId(const ::p4::v1::CapabilitiesRequest& req) { return 0; }
+
+}  // namespace
+
+// The tag of a pending operation on a completion queue. Runs the given
+// callback with the result of the operation once it is completed.
+class P4AsyncService::Tag {
+ public:
+  explicit Tag(std::function<void(bool ok)> callback)
+      : callback_(std::move(callback)) {}
+  void Run(bool ok) { callback_(ok); }
+
+ private:
+  std::function<void(bool ok)> callback_;
+};
+
+// Runs the RPC handlers given to Schedule() on its own threads, starting them
+// in the order they were scheduled. With a single thread, each handler starts
+// once the previous one has finished. The destructor waits for all the
+// scheduled handlers to be run.
+class P4AsyncService::HandlerQueue {
+ public:
+  explicit HandlerQueue(int num_threads) : shutdown_(false) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this]() { Run(); });
+    }
+  }
+
+  ~HandlerQueue() {
+    {
+      absl::MutexLock l(&lock_);
+      shutdown_ = true;
+    }
+    for (auto& thread : threads_) thread.join();
+  }
+
+  void Schedule(std::function<void()> handler) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    handlers_.push_back(std::move(handler));
+  }
+
+ private:
+  void Run() LOCKS_EXCLUDED(lock_) {
+    while (true) {
+      std::function<void()> handler;
+      {
+        absl::MutexLock l(&lock_);
+        lock_.Await(absl::Condition(this, &HandlerQueue::HasWorkOrShutdown));
+        if (handlers_.empty()) return;  // Shutting down and drained.
+        handler = std::move(handlers_.front());
+        handlers_.pop_front();
+      }
+      handler();
+    }
+  }
+
+  bool HasWorkOrShutdown() const EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    return shutdown_ || !handlers_.empty();
+  }
+
+  absl::Mutex lock_;
+  std::deque<std::function<void()>> handlers_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+  std::vector<std::thread> threads_;
+};
+
+// A unary RPC, from the arrival of the call to its response. Write and
+// SetForwardingPipelineConfig are handled by the writer thread of their node,
+// the others are handled right away on the completion queue thread.
+template <typename Request, typename Response>
+class P4AsyncService::UnaryCall {
+ public:
+  typedef void (::p4::v1::P4Runtime::AsyncService::*RequestMethod)(
+      ::grpc::ServerContext*, Request*,
+      ::grpc::ServerAsyncResponseWriter<Response>*, ::grpc::CompletionQueue*,
+      ::grpc::ServerCompletionQueue*, void*);
+  typedef ::grpc::Status (P4Service::*Handler)(::grpc::ServerContext*,
+                                               const Request*, Response*);
+
+  // Waits for the next call of the RPC on the given completion queue.
+  static void Listen(P4AsyncService* service, ::grpc::ServerCompletionQueue* cq,
+                     RequestMethod request_method, Handler handler,
+                     bool per_node) {
+    auto* call = new UnaryCall(service, cq, request_method, handler, per_node);
+    bool started = service->StartOperation([call]() {
+      (call->service_->service_.*(call->request_method_))(
+          &call->context_, &call->request_, &call->responder_, call->cq_,
+          call->cq_, &call->new_call_tag_);
+    });
+    if (!started) delete call;
+  }
+
+ private:
+  UnaryCall(P4AsyncService* service, ::grpc::ServerCompletionQueue* cq,
+            RequestMethod request_method, Handler handler, bool per_node)
+      : service_(service),
+        cq_(cq),
+        request_method_(request_method),
+        handler_(handler),
+        per_node_(per_node),
+        responder_(&context_),
+        new_call_tag_([this](bool ok) { OnNewCall(ok); }),
+        finish_tag_([this](bool ok) { delete this; }) {}
+
+  void OnNewCall(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    Listen(service_, cq_, request_method_, handler_, per_node_);
+    if (!per_node_) {
+      Handle();
+    } else if (!service_->ScheduleOnNode(GetNodeId(request_),
+                                         [this]() { Handle(); })) {
+      Finish(::grpc::Status(::grpc::StatusCode::UNAVAILABLE,
+                            "The service is shutting down."));
+    }
+  }
+
+  void Handle() {
+    Finish((service_->p4_service_->*handler_)(&context_, &request_,
+                                              &response_));
+  }
+
+  void Finish(const ::grpc::Status& status) {
+    bool started = service_->StartOperation([this, &status]() {
+      responder_.Finish(response_, status, &finish_tag_);
+    });
+    if (!started) delete this;
+  }
+
+  P4AsyncService* service_;  // not owned by the class.
+  ::grpc::ServerCompletionQueue* cq_;  // not owned by the class.
+  const RequestMethod request_method_;
+  const Handler handler_;
+  const bool per_node_;
+  ::grpc::ServerContext context_;
+  Request request_;
+  Response response_;
+  ::grpc::ServerAsyncResponseWriter<Response> responder_;
+  Tag new_call_tag_;
+  Tag finish_tag_;
+};
+
+// A Read RPC, from the arrival of the call to its final status. The entities
+// are read by one of the read threads, which waits for each response to be
+// sent before it writes the next one. The writes to the node are not held up
+// meanwhile.
+class P4AsyncService::ReadCall
+    : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  // Waits for the next Read call on the given completion queue.
+  static void Listen(P4AsyncService* service,
+                     ::grpc::ServerCompletionQueue* cq) {
+    auto* call = new ReadCall(service, cq);
+    bool started = service->StartOperation([call]() {
+      call->service_->service_.RequestRead(&call->context_, &call->request_,
+                                           &call->writer_, call->cq_,
+                                           call->cq_, &call->new_call_tag_);
+    });
+    if (!started) delete call;
+  }
+
+  // Blocks until the response is sent. Not to be called on a completion queue
+  // thread.
+  bool Write(const ::p4::v1::ReadResponse& msg) override LOCKS_EXCLUDED(lock_) {
+    {
+      absl::MutexLock l(&lock_);
+      write_done_ = false;
+    }
+    bool started = service_->StartOperation(
+        [this, &msg]() { writer_.Write(msg, &write_tag_); });
+    if (!started) return false;
+    absl::MutexLock l(&lock_);
+    lock_.Await(absl::Condition(&write_done_));
+    return write_ok_;
+  }
+
+ private:
+  ReadCall(P4AsyncService* service, ::grpc::ServerCompletionQueue* cq)
+      : service_(service),
+        cq_(cq),
+        writer_(&context_),
+        new_call_tag_([this](bool ok) { OnNewCall(ok); }),
+        write_tag_([this](bool ok) { OnWriteDone(ok); }),
+        finish_tag_([this](bool ok) { delete this; }),
+        write_done_(false),
+        write_ok_(false) {}
+
+  void OnNewCall(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    Listen(service_, cq_);
+    if (!service_->ScheduleRead([this]() {
+          Finish(service_->p4_service_->ReadEntities(&context_, &request_,
+                                                     this));
+        })) {
+      Finish(::grpc::Status(::grpc::StatusCode::UNAVAILABLE,
+                            "The service is shutting down."));
+    }
+  }
+
+  void OnWriteDone(bool ok) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    write_ok_ = ok;
+    write_done_ = true;
+  }
+
+  void Finish(const ::grpc::Status& status) {
+    bool started = service_->StartOperation(
+        [this, &status]() { writer_.Finish(status, &finish_tag_); });
+    if (!started) delete this;
+  }
+
+  P4AsyncService* service_;  // not owned by the class.
+  ::grpc::ServerCompletionQueue* cq_;  // not owned by the class.
+  ::grpc::ServerContext context_;
+  ::p4::v1::ReadRequest request_;
+  ::grpc::ServerAsyncWriter<::p4::v1::ReadResponse> writer_;
+  Tag new_call_tag_;
+  Tag write_tag_;
+  Tag finish_tag_;
+  absl::Mutex lock_;
+  bool write_done_ GUARDED_BY(lock_);
+  bool write_ok_ GUARDED_BY(lock_);
+};
+
+// A StreamChannel RPC, from the arrival of the call to its final status. The
+// requests are read and handled on the completion queue thread. The messages
+// written to the stream by P4Service are queued, and sent one after the other
+// in the background.
+class P4AsyncService::StreamCall : public StreamMessageResponseWriter {
+ public:
+  // Waits for the next StreamChannel call on the given completion queue.
+  static void Listen(P4AsyncService* service,
+                     ::grpc::ServerCompletionQueue* cq) {
+    auto* call = new StreamCall(service, cq);
+    bool started = service->StartOperation([call]() {
+      call->service_->service_.RequestStreamChannel(
+          &call->context_, &call->stream_, call->cq_, call->cq_,
+          &call->new_call_tag_);
+    });
+    if (!started) delete call;
+  }
+
+  // Queues the message for sending. Returns false if the stream is closed, or
+  // if the message is a PacketIn and too many PacketIns are already queued.
+  bool Write(const ::p4::v1::StreamMessageResponse& msg) override
+      LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    if (closed_) return false;
+    if (msg.has_packet()) {
+      if (num_pending_packet_ins_ >=
+          static_cast<size_t>(FLAGS_p4_stream_max_pending_packet_ins)) {
+        service_->num_packet_ins_dropped_++;
+        return false;
+      }
+      num_pending_packet_ins_++;
+    }
+    pending_.push_back(msg);
+    if (!write_in_flight_) WriteNext();
+    return true;
+  }
+
+ private:
+  StreamCall(P4AsyncService* service, ::grpc::ServerCompletionQueue* cq)
+      : service_(service),
+        cq_(cq),
+        stream_(&context_),
+        new_call_tag_([this](bool ok) { OnNewCall(ok); }),
+        read_tag_([this](bool ok) { OnRead(ok); }),
+        write_tag_([this](bool ok) { OnWriteDone(ok); }),
+        finish_tag_([this](bool ok) { delete this; }),
+        connection_id_(0),
+        node_id_(0),
+        closed_(false),
+        finish_status_(::grpc::Status::OK),
+        finish_pending_(false),
+        write_in_flight_(false),
+        in_flight_is_packet_in_(false),
+        num_pending_packet_ins_(0) {}
+
+  void OnNewCall(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    Listen(service_, cq_);
+    ::grpc::Status status =
+        service_->p4_service_->StartStreamChannel(&context_, &connection_id_);
+    if (!status.ok()) {
+      // No connection to release.
+      {
+        absl::MutexLock l(&lock_);
+        closed_ = true;
+      }
+      Finish(status);
+      return;
+    }
+    peer_ = context_.peer();
+    ReadNext();
+  }
+
+  void ReadNext() {
+    bool started = service_->StartOperation(
+        [this]() { stream_.Read(&request_, &read_tag_); });
+    if (!started) {
+      EndStream(::grpc::Status(::grpc::StatusCode::UNAVAILABLE,
+                               "The service is shutting down."));
+    }
+  }
+
+  void OnRead(bool ok) {
+    if (!ok) {
+      // The client is done writing, or the call is cancelled.
+      EndStream(::grpc::Status::OK);
+      return;
+    }
+    ::grpc::Status status = service_->p4_service_->HandleStreamMessageRequest(
+        request_, peer_, connection_id_, &node_id_, this);
+    if (!status.ok()) {
+      EndStream(status);
+      return;
+    }
+    ReadNext();
+  }
+
+  // Releases the connection and finishes the call with the given status once
+  // the message in flight, if any, is sent. The pending messages are dropped.
+  void EndStream(const ::grpc::Status& status) LOCKS_EXCLUDED(lock_) {
+    // Takes the controller lock of P4Service, so it must not be called with
+    // lock_ held. No one writes to the stream after this returns.
+    service_->p4_service_->RemoveController(node_id_, connection_id_);
+    bool finish_now = false;
+    {
+      absl::MutexLock l(&lock_);
+      closed_ = true;
+      service_->num_packet_ins_dropped_ += num_pending_packet_ins_ -
+                                           (in_flight_is_packet_in_ ? 1 : 0);
+      num_pending_packet_ins_ = in_flight_is_packet_in_ ? 1 : 0;
+      pending_.clear();
+      if (write_in_flight_) {
+        finish_status_ = status;
+        finish_pending_ = true;
+      } else {
+        finish_now = true;
+      }
+    }
+    if (finish_now) Finish(status);
+  }
+
+  void OnWriteDone(bool ok) LOCKS_EXCLUDED(lock_) {
+    ::grpc::Status status;
+    {
+      absl::MutexLock l(&lock_);
+      write_in_flight_ = false;
+      if (in_flight_is_packet_in_) {
+        num_pending_packet_ins_--;
+        if (ok) {
+          service_->num_packet_ins_sent_++;
+        } else {
+          service_->num_packet_ins_dropped_++;
+        }
+      }
+      in_flight_is_packet_in_ = false;
+      if (!finish_pending_) {
+        // On failure, the stream is broken and the pending read fails as well,
+        // which ends the stream.
+        if (ok && !pending_.empty()) WriteNext();
+        return;
+      }
+      status = finish_status_;
+    }
+    Finish(status);
+  }
+
+  void WriteNext() EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    in_flight_is_packet_in_ = pending_.front().has_packet();
+    // The message is serialized by Write(), so it can be released right away.
+    bool started = service_->StartOperation(
+        [this]() { stream_.Write(pending_.front(), &write_tag_); });
+    if (!started) {
+      // The service is shutting down. The pending read fails as well, which
+      // ends the stream.
+      if (in_flight_is_packet_in_) {
+        num_pending_packet_ins_--;
+        service_->num_packet_ins_dropped_++;
+      }
+      in_flight_is_packet_in_ = false;
+      pending_.pop_front();
+      return;
+    }
+    write_in_flight_ = true;
+    pending_.pop_front();
+  }
+
+  void Finish(const ::grpc::Status& status) {
+    bool started = service_->StartOperation(
+        [this, &status]() { stream_.Finish(status, &finish_tag_); });
+    if (!started) delete this;
+  }
+
+  P4AsyncService* service_;  // not owned by the class.
+  ::grpc::ServerCompletionQueue* cq_;  // not owned by the class.
+  ::grpc::ServerContext context_;
+  ::grpc::ServerAsyncReaderWriter<::p4::v1::StreamMessageResponse,
+                                  ::p4::v1::StreamMessageRequest>
+      stream_;
+  Tag new_call_tag_;
+  Tag read_tag_;
+  Tag write_tag_;
+  Tag finish_tag_;
+
+  // Only accessed by the completion queue thread.
+  ::p4::v1::StreamMessageRequest request_;
+  std::string peer_;
+  uint64 connection_id_;
+  uint64 node_id_;
+
+  // Protects the write side of the stream, which is used by any thread
+  // writing to the controller (e.g. the packet RX threads).
+  absl::Mutex lock_;
+  bool closed_ GUARDED_BY(lock_);
+  ::grpc::Status finish_status_ GUARDED_BY(lock_);
+  bool finish_pending_ GUARDED_BY(lock_);
+  bool write_in_flight_ GUARDED_BY(lock_);
+  bool in_flight_is_packet_in_ GUARDED_BY(lock_);
+  // Includes the PacketIn in flight, if any.
+  size_t num_pending_packet_ins_ GUARDED_BY(lock_);
+  std::deque<::p4::v1::StreamMessageResponse> pending_ GUARDED_BY(lock_);
+};
+
+P4AsyncService::P4AsyncService(P4Service* p4_service)
+    : p4_service_(CHECK_NOTNULL(p4_service)),
+      started_(false),
+      shutdown_(false),
+      cqs_shutdown_(false),
+      num_packet_ins_sent_(0),
+      num_packet_ins_dropped_(0) {}
+
+P4AsyncService::~P4AsyncService() { Shutdown(); }
+
+std::unique_ptr<P4AsyncService> P4AsyncService::CreateInstance(
+    P4Service* p4_service) {
+  return absl::WrapUnique(new P4AsyncService(p4_service));
+}
+
+void P4AsyncService::RegisterWithServerBuilder(::grpc::ServerBuilder* builder) {
+  builder->RegisterService(&service_);
+  int num_cqs = std::max(FLAGS_p4_async_num_cq_threads, 1);
+  for (int i = 0; i < num_cqs; ++i) {
+    cqs_.push_back(builder->AddCompletionQueue());
+  }
+}
+
+void P4AsyncService::Start() {
+  absl::MutexLock l(&lock_);
+  if (started_ || shutdown_) return;
+  started_ = true;
+  read_threads_ = absl::make_unique<HandlerQueue>(
+      std::max(FLAGS_p4_async_num_read_threads, 1));
+  for (const auto& cq : cqs_) {
+    ListenForCalls(cq.get());
+    cq_threads_.emplace_back(&P4AsyncService::RunCompletionQueue, this,
+                             cq.get());
+  }
+}
+
+void P4AsyncService::Shutdown() {
+  absl::flat_hash_map<uint64, std::unique_ptr<HandlerQueue>> node_writers;
+  std::unique_ptr<HandlerQueue> read_threads;
+  {
+    absl::MutexLock l(&lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+    node_writers = std::move(node_writers_);
+    node_writers_.clear();
+    read_threads = std::move(read_threads_);
+  }
+  // Run the RPCs already scheduled. Their responses need the completion
+  // queues.
+  node_writers.clear();
+  read_threads.reset();
+  {
+    absl::WriterMutexLock l(&cq_lock_);
+    cqs_shutdown_ = true;
+  }
+  for (const auto& cq : cqs_) cq->Shutdown();
+  for (auto& thread : cq_threads_) thread.join();
+  cq_threads_.clear();
+  // The completion queues need to be drained before they are destroyed, even
+  // if they were never used.
+  void* tag;
+  bool ok;
+  for (const auto& cq : cqs_) {
+    while (cq->Next(&tag, &ok)) static_cast<Tag*>(tag)->Run(ok);
+  }
+}
+
+P4AsyncService::Stats P4AsyncService::GetStats() const {
+  return {num_packet_ins_sent_.load(), num_packet_ins_dropped_.load()};
+}
+
+void P4AsyncService::ListenForCalls(::grpc::ServerCompletionQueue* cq) {
+  UnaryCall<::p4::v1::WriteRequest, ::p4::v1::WriteResponse>::Listen(
+      this, cq, &::p4::v1::P4Runtime::AsyncService::RequestWrite,
+      &P4Service::Write, true);
+  UnaryCall<::p4::v1::SetForwardingPipelineConfigRequest,
+            ::p4::v1::SetForwardingPipelineConfigResponse>::
+      Listen(this, cq,
+             &::p4::v1::P4Runtime::AsyncService::
+                 RequestSetForwardingPipelineConfig,
+             &P4Service::SetForwardingPipelineConfig, true);
+  UnaryCall<::p4::v1::GetForwardingPipelineConfigRequest,
+            ::p4::v1::GetForwardingPipelineConfigResponse>::
+      Listen(this, cq,
+             &::p4::v1::P4Runtime::AsyncService::
+                 RequestGetForwardingPipelineConfig,
+             &P4Service::GetForwardingPipelineConfig, false);
+  UnaryCall<::p4::v1::CapabilitiesRequest, ::p4::v1::CapabilitiesResponse>::
+      Listen(this, cq, &::p4::v1::P4Runtime::AsyncService::RequestCapabilities,
+             &P4Service::Capabilities, false);
+  ReadCall::Listen(this, cq);
+  StreamCall::Listen(this, cq);
+}
+
+void P4AsyncService::RunCompletionQueue(::grpc::ServerCompletionQueue* cq) {
+  void* tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) static_cast<Tag*>(tag)->Run(ok);
+}
+
+bool P4AsyncService::ScheduleOnNode(uint64 node_id,
+                                    std::function<void()> handler) {
+  absl::MutexLock l(&lock_);
+  if (shutdown_) return false;
+  auto it = node_writers_.find(node_id);
+  if (it == node_writers_.end()) {
+    if (node_id == kSharedNodeWriterKey ||
+        node_writers_.size() >= kMaxNumNodeWriters) {
+      node_id = kSharedNodeWriterKey;
+    }
+    it = node_writers_.find(node_id);
+    if (it == node_writers_.end()) {
+      it = node_writers_.emplace(node_id, absl::make_unique<HandlerQueue>(1))
+               .first;
+    }
+  }
+  it->second->Schedule(std::move(handler));
+  return true;
+}
+
+bool P4AsyncService::ScheduleRead(std::function<void()> handler) {
+  absl::MutexLock l(&lock_);
+  if (shutdown_ || read_threads_ == nullptr) return false;
+  read_threads_->Schedule(std::move(handler));
+  return true;
+}
+
+}  // namespace hal
+}  // namespace stratum
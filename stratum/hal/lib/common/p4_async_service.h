@@ -0,0 +1,169 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_P4_ASYNC_SERVICE_H_
+#define STRATUM_HAL_LIB_COMMON_P4_ASYNC_SERVICE_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "grpcpp/grpcpp.h"
+#include "p4/v1/p4runtime.grpc.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/hal/lib/common/p4_service.h"
+
+namespace stratum {
+namespace hal {
+
+// P4AsyncService serves the P4Runtime RPCs with the gRPC async (completion
+// queue) API, as an alternative to registering the P4Service itself, which
+// uses the sync API and holds a gRPC thread for every in-flight RPC and for
+// the whole life of every StreamChannel:
+// - The RPCs are received and their responses sent by a fixed number of
+//   completion queue threads (see --p4_async_num_cq_threads).
+// - Write and SetForwardingPipelineConfig RPCs of a node are run in the order
+//   they are received, by a writer thread dedicated to the node. The RPCs of
+//   different nodes run in parallel.
+// - Read RPCs are run by a pool of read threads (see
+//   --p4_async_num_read_threads), as they block until the controller has
+//   received each response. They do not wait for the writes of the node.
+// - The messages sent on a StreamChannel are queued and sent asynchronously.
+//   At most --p4_stream_max_pending_packet_ins PacketIns are queued per
+//   stream. The PacketIns received beyond that are dropped and counted, so a
+//   slow controller never blocks the packet RX threads.
+// The RPCs themselves are handled by the given P4Service, which must outlive
+// this class, so both APIs behave the same.
+//
+// Usage:
+//   auto p4_async_service = P4AsyncService::CreateInstance(p4_service);
+//   p4_async_service->RegisterWithServerBuilder(&builder);
+//   auto server = builder.BuildAndStart();
+//   p4_async_service->Start();
+//   ...
+//   server->Shutdown();
+//   p4_async_service->Shutdown();
+class P4AsyncService {
+ public:
+  // Counters of the PacketIns sent to the controllers.
+  struct Stats {
+    uint64 num_packet_ins_sent;
+    uint64 num_packet_ins_dropped;
+  };
+
+  // Calls Shutdown().
+  ~P4AsyncService();
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<P4AsyncService> CreateInstance(P4Service* p4_service);
+
+  // Registers the P4Runtime service and the completion queues with the given
+  // builder. To be called once, before the server is built.
+  void RegisterWithServerBuilder(::grpc::ServerBuilder* builder);
+
+  // Starts serving the RPCs. To be called once the server is built.
+  void Start() LOCKS_EXCLUDED(lock_);
+
+  // Stops the completion queue threads, the node writer threads and the read
+  // threads. To be called after the server is shut down. Further calls are
+  // no-ops.
+  void Shutdown() LOCKS_EXCLUDED(lock_);
+
+  Stats GetStats() const;
+
+  // P4AsyncService is neither copyable nor movable.
+  P4AsyncService(const P4AsyncService&) = delete;
+  P4AsyncService& operator=(const P4AsyncService&) = delete;
+
+ private:
+  // The tag of a pending operation on a completion queue.
+  class Tag;
+  // The state machines of the RPCs.
+  template <typename Request, typename Response>
+  class UnaryCall;
+  class ReadCall;
+  class StreamCall;
+  // Runs the RPCs scheduled on its threads.
+  class HandlerQueue;
+
+  // Private constructor. Use CreateInstance() to create an instance.
+  explicit P4AsyncService(P4Service* p4_service);
+
+  // Waits for the first call of each RPC on the given completion queue. Every
+  // call then waits for the next one as soon as it starts.
+  void ListenForCalls(::grpc::ServerCompletionQueue* cq);
+
+  // Body of the completion queue threads.
+  void RunCompletionQueue(::grpc::ServerCompletionQueue* cq);
+
+  // Runs the given RPC handler on the writer thread of the given node, after
+  // the RPCs of the node which were scheduled before it. Returns false if the
+  // service is shutting down, in which case the handler is not run.
+  bool ScheduleOnNode(uint64 node_id, std::function<void()> handler)
+      LOCKS_EXCLUDED(lock_);
+
+  // Runs the given Read RPC handler on one of the read threads. Returns false
+  // if the service is shutting down, in which case the handler is not run.
+  bool ScheduleRead(std::function<void()> handler) LOCKS_EXCLUDED(lock_);
+
+  // Runs the given function, which starts an operation on a completion queue,
+  // unless the completion queues are shut down. Returns false in that case.
+  template <typename Op>
+  bool StartOperation(Op op) LOCKS_EXCLUDED(cq_lock_) {
+    absl::ReaderMutexLock l(&cq_lock_);
+    if (cqs_shutdown_) return false;
+    op();
+    return true;
+  }
+
+  // Not owned by this class.
+  P4Service* p4_service_;
+
+  ::p4::v1::P4Runtime::AsyncService service_;
+
+  // One completion queue per thread. Added by RegisterWithServerBuilder().
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> cqs_;
+  std::vector<std::thread> cq_threads_;
+
+  // Protects the node writers, the read threads and the state of the service.
+  mutable absl::Mutex lock_;
+
+  absl::flat_hash_map<uint64, std::unique_ptr<HandlerQueue>> node_writers_
+      GUARDED_BY(lock_);
+  // Created by Start().
+  std::unique_ptr<HandlerQueue> read_threads_ GUARDED_BY(lock_);
+  bool started_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+
+  // Held in reader mode while starting an operation on a completion queue,
+  // and in writer mode while the completion queues are being shut down.
+  mutable absl::Mutex cq_lock_;
+  bool cqs_shutdown_ GUARDED_BY(cq_lock_);
+
+  std::atomic<uint64> num_packet_ins_sent_;
+  std::atomic<uint64> num_packet_ins_dropped_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_P4_ASYNC_SERVICE_H_
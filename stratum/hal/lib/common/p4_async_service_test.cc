@@ -0,0 +1,509 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/p4_async_service.h"
+
+#include <chrono>  // NOLINT
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/numeric/int128.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "google/rpc/code.pb.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/net_util/ports.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/security/auth_policy_checker_mock.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_int32(p4_async_num_cq_threads);
+DECLARE_int32(p4_stream_max_pending_packet_ins);
+DECLARE_string(forwarding_pipeline_configs_file);
+DECLARE_string(write_req_log_file);
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::SetArgPointee;
+
+typedef ::grpc::ClientReaderWriter<::p4::v1::StreamMessageRequest,
+                                   ::p4::v1::StreamMessageResponse>
+    ClientStreamChannelReaderWriter;
+
+class P4AsyncServiceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FLAGS_p4_async_num_cq_threads = 2;
+    FLAGS_p4_stream_max_pending_packet_ins = 256;
+    FLAGS_forwarding_pipeline_configs_file =
+        FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
+    FLAGS_write_req_log_file = FLAGS_test_tmpdir + "/write_req_log_file.csv";
+    switch_mock_ = absl::make_unique<SwitchMock>();
+    auth_policy_checker_mock_ = absl::make_unique<AuthPolicyCheckerMock>();
+    error_buffer_ = absl::make_unique<ErrorBuffer>();
+    p4_service_ = absl::make_unique<P4Service>(
+        OPERATION_MODE_STANDALONE, switch_mock_.get(),
+        auth_policy_checker_mock_.get(), error_buffer_.get());
+    p4_async_service_ = P4AsyncService::CreateInstance(p4_service_.get());
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    p4_async_service_->RegisterWithServerBuilder(&builder);
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    p4_async_service_->Start();
+    stub_ = ::p4::v1::P4Runtime::NewStub(
+        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+    ASSERT_NE(stub_, nullptr);
+  }
+
+  void TearDown() override {
+    // Cancels the streams which are still open.
+    server_->Shutdown(std::chrono::system_clock::now());
+    p4_async_service_->Shutdown();
+    ASSERT_OK(p4_service_->Teardown());
+  }
+
+  // Makes the stream the master controller of the given node.
+  void BecomeMaster(ClientStreamChannelReaderWriter* stream, uint64 node_id,
+                    absl::uint128 election_id) {
+    ::p4::v1::StreamMessageRequest req;
+    ::p4::v1::StreamMessageResponse resp;
+    req.mutable_arbitration()->set_device_id(node_id);
+    req.mutable_arbitration()->mutable_election_id()->set_high(
+        absl::Uint128High64(election_id));
+    req.mutable_arbitration()->mutable_election_id()->set_low(
+        absl::Uint128Low64(election_id));
+    ASSERT_TRUE(stream->Write(req));
+    ASSERT_TRUE(stream->Read(&resp));
+    ASSERT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+  }
+
+  // Waits until the given number of PacketIns are either sent or dropped.
+  P4AsyncService::Stats WaitForPacketIns(uint64 num_packet_ins) {
+    absl::Time deadline = absl::Now() + absl::Seconds(10);
+    P4AsyncService::Stats stats = p4_async_service_->GetStats();
+    while (stats.num_packet_ins_sent + stats.num_packet_ins_dropped <
+               num_packet_ins &&
+           absl::Now() < deadline) {
+      absl::SleepFor(absl::Milliseconds(1));
+      stats = p4_async_service_->GetStats();
+    }
+    return stats;
+  }
+
+  static constexpr uint64 kNodeId1 = 123123123;
+  static constexpr uint64 kNodeId2 = 456456456;
+  static constexpr absl::uint128 kElectionId1 = 1111;
+  static constexpr absl::uint128 kElectionId2 = 2222;
+  static constexpr uint32 kTableId1 = 12;
+  std::unique_ptr<SwitchMock> switch_mock_;
+  std::unique_ptr<AuthPolicyCheckerMock> auth_policy_checker_mock_;
+  std::unique_ptr<ErrorBuffer> error_buffer_;
+  std::unique_ptr<P4Service> p4_service_;
+  std::unique_ptr<P4AsyncService> p4_async_service_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::unique_ptr<::p4::v1::P4Runtime::Stub> stub_;
+};
+
+constexpr uint64 P4AsyncServiceTest::kNodeId1;
+constexpr uint64 P4AsyncServiceTest::kNodeId2;
+constexpr absl::uint128 P4AsyncServiceTest::kElectionId1;
+constexpr absl::uint128 P4AsyncServiceTest::kElectionId2;
+
+TEST_F(P4AsyncServiceTest, WriteSuccess) {
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ::grpc::ClientContext stream_context;
+  auto stream = stub_->StreamChannel(&stream_context);
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResults),
+                      Return(::util::OkStatus())));
+
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+  EXPECT_TRUE(status.ok()) << status.error_message();
+}
+
+TEST_F(P4AsyncServiceTest, WriteFailureWhenNonMaster) {
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_low(1);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+  EXPECT_EQ(::grpc::StatusCode::PERMISSION_DENIED, status.error_code());
+}
+
+TEST_F(P4AsyncServiceTest, WritesToDifferentNodesRunInParallel) {
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(_, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ::grpc::ClientContext stream_context1;
+  ::grpc::ClientContext stream_context2;
+  auto stream1 = stub_->StreamChannel(&stream_context1);
+  auto stream2 = stub_->StreamChannel(&stream_context2);
+  BecomeMaster(stream1.get(), kNodeId1, kElectionId1);
+  BecomeMaster(stream2.get(), kNodeId2, kElectionId1);
+
+  // The write to node 1 blocks until the write to node 2 is done.
+  absl::Notification node1_writing;
+  absl::Notification node2_written;
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .WillRepeatedly(Invoke([&](const ::p4::v1::WriteRequest& req,
+                                 std::vector<::util::Status>* results) {
+        if (req.device_id() == kNodeId1) {
+          node1_writing.Notify();
+          EXPECT_TRUE(
+              node2_written.WaitForNotificationWithTimeout(absl::Seconds(10)));
+        }
+        results->assign(req.updates_size(), ::util::OkStatus());
+        return ::util::OkStatus();
+      }));
+
+  auto write = [this](uint64 node_id) {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteRequest req;
+    ::p4::v1::WriteResponse resp;
+    req.set_device_id(node_id);
+    req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+    req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+    req.add_updates()->set_type(::p4::v1::Update::INSERT);
+    return stub_->Write(&context, req, &resp);
+  };
+  std::thread node1_writer([&write]() { EXPECT_TRUE(write(kNodeId1).ok()); });
+  ASSERT_TRUE(node1_writing.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_TRUE(write(kNodeId2).ok());
+  node2_written.Notify();
+  node1_writer.join();
+}
+
+TEST_F(P4AsyncServiceTest, ReadSuccess) {
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Read", _))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::ReadResponse resp1;
+  ::p4::v1::ReadResponse resp2;
+  resp1.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+  resp2.add_entities()->mutable_table_entry()->set_priority(10);
+  EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _))
+      .WillOnce(Invoke([&](const ::p4::v1::ReadRequest& req,
+                           WriterInterface<::p4::v1::ReadResponse>* writer,
+                           std::vector<::util::Status>* details) {
+        EXPECT_TRUE(writer->Write(resp1));
+        EXPECT_TRUE(writer->Write(resp2));
+        return ::util::OkStatus();
+      }));
+
+  ::grpc::ClientContext context;
+  ::p4::v1::ReadRequest req;
+  ::p4::v1::ReadResponse resp;
+  req.set_device_id(kNodeId1);
+  req.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+  auto reader = stub_->Read(&context, req);
+  ASSERT_TRUE(reader->Read(&resp));
+  EXPECT_EQ(resp1.SerializeAsString(), resp.SerializeAsString());
+  ASSERT_TRUE(reader->Read(&resp));
+  EXPECT_EQ(resp2.SerializeAsString(), resp.SerializeAsString());
+  ASSERT_FALSE(reader->Read(&resp));
+  EXPECT_TRUE(reader->Finish().ok());
+}
+
+TEST_F(P4AsyncServiceTest, ReadDoesNotWaitForWritesToTheSameNode) {
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(_, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ::grpc::ClientContext stream_context;
+  auto stream = stub_->StreamChannel(&stream_context);
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+
+  // The write blocks until the read of the same node is done.
+  absl::Notification writing;
+  absl::Notification read;
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .WillOnce(Invoke([&](const ::p4::v1::WriteRequest& req,
+                           std::vector<::util::Status>* results) {
+        writing.Notify();
+        EXPECT_TRUE(read.WaitForNotificationWithTimeout(absl::Seconds(10)));
+        results->assign(req.updates_size(), ::util::OkStatus());
+        return ::util::OkStatus();
+      }));
+  ::p4::v1::ReadResponse read_resp;
+  read_resp.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+  EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _))
+      .WillOnce(Invoke([&](const ::p4::v1::ReadRequest& req,
+                           WriterInterface<::p4::v1::ReadResponse>* writer,
+                           std::vector<::util::Status>* details) {
+        EXPECT_TRUE(writer->Write(read_resp));
+        return ::util::OkStatus();
+      }));
+
+  std::thread writer([this]() {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteRequest req;
+    ::p4::v1::WriteResponse resp;
+    req.set_device_id(kNodeId1);
+    req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+    req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+    req.add_updates()->set_type(::p4::v1::Update::INSERT);
+    EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+  });
+  ASSERT_TRUE(writing.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ::grpc::ClientContext context;
+  ::p4::v1::ReadRequest req;
+  ::p4::v1::ReadResponse resp;
+  req.set_device_id(kNodeId1);
+  req.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+  auto reader = stub_->Read(&context, req);
+  EXPECT_TRUE(reader->Read(&resp));
+  EXPECT_EQ(read_resp.SerializeAsString(), resp.SerializeAsString());
+  EXPECT_FALSE(reader->Read(&resp));
+  EXPECT_TRUE(reader->Finish().ok());
+  read.Notify();
+  writer.join();
+}
+
+TEST_F(P4AsyncServiceTest, GetCapabilities) {
+  ::grpc::ClientContext context;
+  ::p4::v1::CapabilitiesRequest req;
+  ::p4::v1::CapabilitiesResponse resp;
+  ::grpc::Status status = stub_->Capabilities(&context, req, &resp);
+  EXPECT_TRUE(status.ok()) << status.error_message();
+  EXPECT_FALSE(resp.p4runtime_api_version().empty());
+}
+
+TEST_F(P4AsyncServiceTest, StreamChannelSuccess) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> packet_in_writer;
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(DoAll(SaveArg<1>(&packet_in_writer),
+                      Return(::util::OkStatus())));
+  ::p4::v1::PacketOut packet_out;
+  packet_out.set_payload("out");
+  absl::Notification packet_out_transmitted;
+  EXPECT_CALL(*switch_mock_, TransmitPackets(kNodeId1, _))
+      .WillOnce(Invoke([&](uint64 node_id,
+                           const std::vector<::p4::v1::PacketOut>& packets) {
+        EXPECT_EQ(1U, packets.size());
+        packet_out_transmitted.Notify();
+        return ::util::OkStatus();
+      }));
+
+  ::grpc::ClientContext context1;
+  ::grpc::ClientContext context2;
+  auto stream1 = stub_->StreamChannel(&context1);
+  auto stream2 = stub_->StreamChannel(&context2);
+  BecomeMaster(stream1.get(), kNodeId1, kElectionId1);
+  ASSERT_NE(packet_in_writer, nullptr);
+
+  // Controller #2 takes over. Both controllers are told.
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+  req.mutable_arbitration()->set_device_id(kNodeId1);
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId2));
+  ASSERT_TRUE(stream2->Write(req));
+  ASSERT_TRUE(stream1->Read(&resp));
+  EXPECT_EQ(::google::rpc::ALREADY_EXISTS, resp.arbitration().status().code());
+  ASSERT_TRUE(stream2->Read(&resp));
+  EXPECT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+
+  // The PacketIns go to the master only.
+  ::p4::v1::PacketIn packet_in;
+  packet_in.set_payload("in");
+  ASSERT_TRUE(packet_in_writer->Write(packet_in));
+  ASSERT_TRUE(stream2->Read(&resp));
+  EXPECT_EQ("in", resp.packet().payload());
+  EXPECT_EQ(1, WaitForPacketIns(1).num_packet_ins_sent);
+
+  // The PacketOuts of the slaves are ignored.
+  *req.mutable_packet() = packet_out;
+  ASSERT_TRUE(stream1->Write(req));
+  ASSERT_TRUE(stream2->Write(req));
+  ASSERT_TRUE(
+      packet_out_transmitted.WaitForNotificationWithTimeout(absl::Seconds(10)));
+
+  // Controller #1 becomes master again once controller #2 is gone.
+  ASSERT_TRUE(stream2->WritesDone());
+  EXPECT_TRUE(stream2->Finish().ok());
+  ASSERT_TRUE(stream1->Read(&resp));
+  EXPECT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+  ASSERT_TRUE(stream1->WritesDone());
+  EXPECT_TRUE(stream1->Finish().ok());
+}
+
+TEST_F(P4AsyncServiceTest, StreamChannelTransmitsQueuedPacketOutsInBatches) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // The first batch blocks the TX thread until the next PacketOuts are queued.
+  absl::Notification first_batch_transmitting;
+  absl::Notification packets_queued;
+  absl::Notification second_batch_transmitted;
+  std::vector<size_t> batch_sizes;
+  EXPECT_CALL(*switch_mock_, TransmitPackets(kNodeId1, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](uint64 node_id,
+                                 const std::vector<::p4::v1::PacketOut>&
+                                     packets) {
+        batch_sizes.push_back(packets.size());
+        if (batch_sizes.size() == 1) {
+          first_batch_transmitting.Notify();
+          EXPECT_TRUE(
+              packets_queued.WaitForNotificationWithTimeout(absl::Seconds(10)));
+        } else {
+          second_batch_transmitted.Notify();
+        }
+        return ::util::OkStatus();
+      }));
+
+  ::grpc::ClientContext context;
+  auto stream = stub_->StreamChannel(&context);
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+  ::p4::v1::StreamMessageRequest req;
+  req.mutable_packet()->set_payload("out");
+  ASSERT_TRUE(stream->Write(req));
+  ASSERT_TRUE(first_batch_transmitting.WaitForNotificationWithTimeout(
+      absl::Seconds(10)));
+  for (int i = 0; i < 3; ++i) ASSERT_TRUE(stream->Write(req));
+  // The requests of a stream are handled in order, so the PacketOuts are all
+  // queued once the arbitration that follows them is answered.
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+  packets_queued.Notify();
+  ASSERT_TRUE(second_batch_transmitted.WaitForNotificationWithTimeout(
+      absl::Seconds(10)));
+  EXPECT_EQ(std::vector<size_t>({1, 3}), batch_sizes);
+  ASSERT_TRUE(stream->WritesDone());
+  EXPECT_TRUE(stream->Finish().ok());
+}
+
+TEST_F(P4AsyncServiceTest, StreamChannelDropsPacketInsWhenQueueIsFull) {
+  FLAGS_p4_stream_max_pending_packet_ins = 0;
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+  std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> packet_in_writer;
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(DoAll(SaveArg<1>(&packet_in_writer),
+                      Return(::util::OkStatus())));
+
+  // The arbitration updates are never dropped.
+  ::grpc::ClientContext context;
+  auto stream = stub_->StreamChannel(&context);
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+  ASSERT_NE(packet_in_writer, nullptr);
+
+  ::p4::v1::PacketIn packet_in;
+  for (int i = 0; i < 3; ++i) ASSERT_TRUE(packet_in_writer->Write(packet_in));
+  P4AsyncService::Stats stats = WaitForPacketIns(3);
+  EXPECT_EQ(0, stats.num_packet_ins_sent);
+  EXPECT_EQ(3, stats.num_packet_ins_dropped);
+
+  ASSERT_TRUE(stream->WritesDone());
+  EXPECT_TRUE(stream->Finish().ok());
+}
+
+TEST_F(P4AsyncServiceTest, StreamChannelFailureForAuthError) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Some error")));
+
+  ::grpc::ClientContext context;
+  auto stream = stub_->StreamChannel(&context);
+  ::p4::v1::StreamMessageResponse resp;
+  EXPECT_FALSE(stream->Read(&resp));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr("Some error"));
+}
+
+TEST_F(P4AsyncServiceTest, StreamChannelFailureForZeroDeviceId) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ClientContext context;
+  auto stream = stub_->StreamChannel(&context);
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+  req.mutable_arbitration()->mutable_election_id()->set_low(1);
+  ASSERT_TRUE(stream->Write(req));
+  EXPECT_FALSE(stream->Read(&resp));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Invalid node"));
+}
+
+TEST_F(P4AsyncServiceTest, ShutdownWithOpenStreams) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ::grpc::ClientContext context;
+  auto stream = stub_->StreamChannel(&context);
+  BecomeMaster(stream.get(), kNodeId1, kElectionId1);
+
+  server_->Shutdown(std::chrono::system_clock::now());
+  p4_async_service_->Shutdown();
+  ::p4::v1::StreamMessageResponse resp;
+  EXPECT_FALSE(stream->Read(&resp));
+  EXPECT_FALSE(stream->Finish().ok());
+}
+
+}  // namespace hal
+}  // namespace stratum
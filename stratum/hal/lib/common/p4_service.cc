@@ -19,6 +19,7 @@
 #include <functional>
 #include <sstream>  // IWYU pragma: keep
 #include <utility>
+#include <vector>
 
 #include "gflags/gflags.h"
 #include "google/protobuf/any.pb.h"
@@ -29,6 +30,7 @@
 #include "stratum/hal/lib/common/server_writer_wrapper.h"
 #include "stratum/lib/channel/channel.h"
 #include "stratum/lib/macros.h"
+#include "stratum/lib/proto_container_file.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
 #include "absl/memory/memory.h"
@@ -45,11 +47,29 @@ DEFINE_string(forwarding_pipeline_configs_file, "",
               "ForwardingPipelineConfig proto for switching node is added or "
               "modified. Default is empty and it is expected to be explicitly "
               "given by flags.");
+DEFINE_bool(forwarding_pipeline_configs_text_export, false,
+            "If true, the saved forwarding pipeline configs are also exported "
+            "in text format to <forwarding_pipeline_configs_file>.txt, for "
+            "debugging. The export is never read back.");
 DEFINE_string(write_req_log_file, "",
               "The log file for all the individual write request updates and "
               "the corresponding result. The format for each line is: "
               "<timestamp>;<node_id>;<update proto>;<status>.  Default is "
               "empty and it is expected to be explicitly given by flags.");
+DEFINE_int32(write_req_log_queue_size, 4096,
+             "Max number of write requests queued to be logged to "
+             "write_req_log_file. Requests are dropped if the queue is full.");
+DEFINE_int32(write_req_log_max_file_size_mb, 0,
+             "The write request log file is rotated once it grows beyond this "
+             "size. 0 disables size based rotation.");
+DEFINE_int32(write_req_log_max_file_age_sec, 0,
+             "The write request log file is rotated once it is older than "
+             "this. 0 disables time based rotation.");
+DEFINE_int32(write_req_log_max_rotated_files, 3,
+             "Number of rotated write request log files kept around.");
+DEFINE_bool(write_req_log_binary, false,
+            "If true, write requests are logged in a compact binary format "
+            "instead of text. See WriteRequestLogger for the format.");
 DEFINE_int32(max_num_controllers_per_node, 5,
              "Max number of controllers that can manage a node.");
 DEFINE_int32(max_num_controller_connections, 20,
@@ -71,7 +91,17 @@ P4Service::P4Service(OperationMode mode, SwitchInterface* switch_interface,
       mode_(mode),
       switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       auth_policy_checker_(ABSL_DIE_IF_NULL(auth_policy_checker)),
-      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)) {}
+      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)) {
+  WriteRequestLogger::Options options;
+  options.path = FLAGS_write_req_log_file;
+  options.queue_size = FLAGS_write_req_log_queue_size;
+  options.max_file_size =
+      static_cast<uint64>(FLAGS_write_req_log_max_file_size_mb) * 1024 * 1024;
+  options.max_file_age = absl::Seconds(FLAGS_write_req_log_max_file_age_sec);
+  options.max_rotated_files = FLAGS_write_req_log_max_rotated_files;
+  options.binary = FLAGS_write_req_log_binary;
+  write_req_logger_ = WriteRequestLogger::CreateInstance(options);
+}
 
 P4Service::~P4Service() {}
 
@@ -107,6 +137,10 @@ P4Service::~P4Service() {}
       pair.second->Close();
     }
     packet_in_channels_.clear();
+    // Close PacketOut Channels.
+    for (const auto& pair : packet_out_channels_) pair.second->Close();
+    packet_out_channels_.clear();
+    packet_out_writers_.clear();
     // Join threads.
     for (const auto& tid : packet_in_reader_tids_) {
       int ret = pthread_join(tid, nullptr);
@@ -115,15 +149,61 @@ P4Service::~P4Service() {}
                    << ".";
       }
     }
+    packet_in_reader_tids_.clear();
+    for (const auto& tid : packet_out_reader_tids_) {
+      int ret = pthread_join(tid, nullptr);
+      if (ret) {
+        LOG(ERROR) << "Failed to join thread " << tid << " with error " << ret
+                   << ".";
+      }
+    }
+    packet_out_reader_tids_.clear();
   }
   {
     absl::WriterMutexLock l(&config_lock_);
     forwarding_pipeline_configs_ = nullptr;
   }
+  // Make sure all the queued write requests make it to the log file.
+  write_req_logger_->Flush();
 
   return ::util::OkStatus();
 }
 
+namespace {
+
+// Reads the saved forwarding pipeline configs. The configs are saved in the
+// proto container format, but a text file saved by an older version is still
+// read. It is replaced by a container file the next time the configs are
+// saved.
+::util::Status ReadForwardingPipelineConfigsFromFile(
+    ForwardingPipelineConfigs* configs) {
+  const std::string& filename = FLAGS_forwarding_pipeline_configs_file;
+  if (!IsProtoContainerFile(filename)) {
+    return ReadProtoFromTextFile(filename, configs);
+  }
+  return ReadProtoFromContainerFile(filename, configs);
+}
+
+// Saves the forwarding pipeline configs, replacing the file atomically.
+::util::Status SaveForwardingPipelineConfigsToFile(
+    const ForwardingPipelineConfigs& configs) {
+  RETURN_IF_ERROR(WriteProtoToContainerFile(
+      configs, FLAGS_forwarding_pipeline_configs_file));
+  if (FLAGS_forwarding_pipeline_configs_text_export) {
+    // Best effort. The export is only for debugging.
+    ::util::Status status = WriteProtoToTextFile(
+        configs, FLAGS_forwarding_pipeline_configs_file + ".txt");
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to export the forwarding pipeline configs in "
+                   << "text format: " << status;
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
 ::util::Status P4Service::PushSavedForwardingPipelineConfigs(bool warmboot) {
   // Try to read the saved forwarding pipeline configs for all the nodes and
   // push them to the nodes.
@@ -131,8 +211,7 @@ P4Service::~P4Service() {}
             << FLAGS_forwarding_pipeline_configs_file << "...";
   absl::WriterMutexLock l(&config_lock_);
   ForwardingPipelineConfigs configs;
-  ::util::Status status =
-      ReadProtoFromTextFile(FLAGS_forwarding_pipeline_configs_file, &configs);
+  ::util::Status status = ReadForwardingPipelineConfigsFromFile(&configs);
   if (!status.ok()) {
     if (!warmboot && status.error_code() == ERR_FILE_NOT_FOUND) {
       // Not a critical error. If coldboot, we don't even return error.
@@ -217,31 +296,6 @@ namespace {
                         from.SerializeAsString());
 }
 
-// Helper to facilitate logging the write requests to the desired log file.
-void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
-                     const std::vector<::util::Status>& results,
-                     const absl::Time timestamp) {
-  if (results.size() != req.updates_size()) {
-    LOG(ERROR) << "Size mismatch: " << results.size()
-               << " != " << req.updates_size() << ". Did not log anything!";
-    return;
-  }
-  std::string msg = "";
-  std::string ts =
-      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", timestamp, absl::LocalTimeZone());
-  for (size_t i = 0; i < results.size(); ++i) {
-    absl::StrAppend(&msg, ts, ";", node_id, ";",
-                    req.updates(i).ShortDebugString(), ";",
-                    results[i].error_message(), "\n");
-  }
-  ::util::Status status =
-      WriteStringToFile(msg, FLAGS_write_req_log_file, /*append=*/true);
-  if (!status.ok()) {
-    LOG_EVERY_N(ERROR, 50) << "Failed to log the write request: "
-                           << status.error_message();
-  }
-}
-
 }  // namespace
 
 ::grpc::Status P4Service::Write(::grpc::ServerContext* context,
@@ -282,8 +336,9 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
                << ": " << status.error_message();
   }
 
-  // Log debug info for future debugging.
-  LogWriteRequest(node_id, *req, results, timestamp);
+  // Log debug info for future debugging. This only queues the request, the
+  // log file is written in the background.
+  write_req_logger_->LogWriteRequest(node_id, *req, results, timestamp);
 
   return ToGrpcStatus(status, results);
 }
@@ -291,6 +346,13 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
 ::grpc::Status P4Service::Read(
     ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
     ::grpc::ServerWriter<::p4::v1::ReadResponse>* writer) {
+  ServerWriterWrapper<::p4::v1::ReadResponse> wrapper(writer);
+  return ReadEntities(context, req, &wrapper);
+}
+
+::grpc::Status P4Service::ReadEntities(
+    ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
   RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, Read, context);
 
   if (!req->entities_size()) return ::grpc::Status::OK;
@@ -299,10 +361,9 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
                           "Invalid device ID.");
   }
 
-  ServerWriterWrapper<::p4::v1::ReadResponse> wrapper(writer);
   std::vector<::util::Status> details = {};
   ::util::Status status =
-      switch_interface_->ReadForwardingEntries(*req, &wrapper, &details);
+      switch_interface_->ReadForwardingEntries(*req, writer, &details);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to read forwarding entries from node "
                << req->device_id() << ": " << status.error_message();
@@ -385,8 +446,7 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
             req->config();
         APPEND_STATUS_IF_ERROR(
             status,
-            WriteProtoToTextFile(configs_to_save_in_file,
-                                 FLAGS_forwarding_pipeline_configs_file));
+            SaveForwardingPipelineConfigsToFile(configs_to_save_in_file));
       }
       if (error.ok()) {
         (*forwarding_pipeline_configs_->mutable_node_id_to_config())[node_id] =
@@ -485,9 +545,6 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
 
 ::grpc::Status P4Service::StreamChannel(
     ::grpc::ServerContext* context, ServerStreamChannelReaderWriter* stream) {
-  RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, StreamChannel,
-                           context);
-
   // Here are the rules:
   // 1- When a client (aka controller) connects for the first time, we do not do
   //    anything until a MasterArbitrationUpdate proto is received.
@@ -497,17 +554,20 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
   //    and receiving packets.
 
   // First thing to do is to find a new ID for this connection.
-  auto ret = FindNewConnectionId();
-  if (!ret.ok()) {
-    return ::grpc::Status(ToGrpcCode(ret.status().CanonicalCode()),
-                          ret.status().error_message());
-  }
-  uint64 connection_id = ret.ValueOrDie();
+  uint64 connection_id = 0;
+  ::grpc::Status status = StartStreamChannel(context, &connection_id);
+  if (!status.ok()) return status;
 
   // The ID of the node this stream channel corresponds to. This is MUST NOT
   // change after it is set for the first time.
   uint64 node_id = 0;
 
+  // The writer registered with the controller. Declared before the cleanup
+  // object, so that it outlives the controller.
+  ServerReaderWriterWrapper<::p4::v1::StreamMessageResponse,
+                            ::p4::v1::StreamMessageRequest>
+      wrapper(stream);
+
   // The cleanup object. Will call RemoveController() upon exit.
   auto cleaner = gtl::MakeCleanup([this, &node_id, &connection_id]() {
     this->RemoveController(node_id, connection_id);
@@ -515,52 +575,85 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
 
   ::p4::v1::StreamMessageRequest req;
   while (stream->Read(&req)) {
-    switch (req.update_case()) {
-      case ::p4::v1::StreamMessageRequest::kArbitration: {
-        if (req.arbitration().device_id() == 0) {
-          return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                                "Invalid node (aka device) ID.");
-        } else if (node_id == 0) {
-          node_id = req.arbitration().device_id();
-        } else if (node_id != req.arbitration().device_id()) {
-          std::stringstream ss;
-          ss << "Node (aka device) ID for this stream has changed. Was "
-             << node_id << ", now is " << req.arbitration().device_id() << ".";
-          return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, ss.str());
-        }
-        absl::uint128 election_id =
-            absl::MakeUint128(req.arbitration().election_id().high(),
-                              req.arbitration().election_id().low());
-        if (election_id == 0) {
-          return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                                "Invalid election ID.");
-        }
-        // Try to add the controller to controllers_.
-        auto status = AddOrModifyController(node_id, connection_id, election_id,
-                                            context->peer(), stream);
-        if (!status.ok()) {
-          return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                                status.error_message());
-        }
-        break;
-      }
-      case ::p4::v1::StreamMessageRequest::kPacket: {
-        // If this stream is not the master stream do not do anything.
-        if (!IsMasterController(node_id, connection_id)) break;
-        // If master, try to transmit the packet. No error reporting.
-        ::util::Status status =
-            switch_interface_->TransmitPacket(node_id, req.packet());
-        if (!status.ok()) {
-          LOG_EVERY_N(INFO, 500) << "Failed to transmit packet: " << status;
-        }
-        break;
+    status = HandleStreamMessageRequest(req, context->peer(), connection_id,
+                                        &node_id, &wrapper);
+    if (!status.ok()) return status;
+  }
+
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status P4Service::StartStreamChannel(::grpc::ServerContext* context,
+                                             uint64* connection_id) {
+  RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, StreamChannel,
+                           context);
+
+  auto ret = FindNewConnectionId();
+  if (!ret.ok()) {
+    return ::grpc::Status(ToGrpcCode(ret.status().CanonicalCode()),
+                          ret.status().error_message());
+  }
+  *connection_id = ret.ValueOrDie();
+
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status P4Service::HandleStreamMessageRequest(
+    const ::p4::v1::StreamMessageRequest& req, const std::string& peer,
+    uint64 connection_id, uint64* node_id,
+    StreamMessageResponseWriter* stream) {
+  switch (req.update_case()) {
+    case ::p4::v1::StreamMessageRequest::kArbitration: {
+      if (req.arbitration().device_id() == 0) {
+        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                              "Invalid node (aka device) ID.");
+      } else if (*node_id == 0) {
+        *node_id = req.arbitration().device_id();
+      } else if (*node_id != req.arbitration().device_id()) {
+        std::stringstream ss;
+        ss << "Node (aka device) ID for this stream has changed. Was "
+           << *node_id << ", now is " << req.arbitration().device_id() << ".";
+        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, ss.str());
       }
-      case ::p4::v1::StreamMessageRequest::kDigestAck:
-      case ::p4::v1::StreamMessageRequest::UPDATE_NOT_SET:
+      absl::uint128 election_id =
+          absl::MakeUint128(req.arbitration().election_id().high(),
+                            req.arbitration().election_id().low());
+      if (election_id == 0) {
         return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                              "Need to specify either arbitration or packet.");
-        break;
+                              "Invalid election ID.");
+      }
+      // Try to add the controller to controllers_.
+      auto status = AddOrModifyController(*node_id, connection_id, election_id,
+                                          peer, stream);
+      if (!status.ok()) {
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+      break;
     }
+    case ::p4::v1::StreamMessageRequest::kPacket: {
+      // If this stream is not the master stream do not do anything.
+      if (!IsMasterController(*node_id, connection_id)) break;
+      // If master, queue the packet for the TX thread of the node, which
+      // transmits the queued packets in batches. No error reporting.
+      std::shared_ptr<ChannelWriter<::p4::v1::PacketOut>> writer;
+      {
+        absl::ReaderMutexLock l(&packet_in_thread_lock_);
+        writer = gtl::FindWithDefault(packet_out_writers_, *node_id, nullptr);
+      }
+      if (writer == nullptr) break;
+      ::util::Status status =
+          writer->Write(req.packet(), absl::InfiniteDuration());
+      if (!status.ok()) {
+        LOG_EVERY_N(INFO, 500) << "Failed to queue packet: " << status;
+      }
+      break;
+    }
+    case ::p4::v1::StreamMessageRequest::kDigestAck:
+    case ::p4::v1::StreamMessageRequest::UPDATE_NOT_SET:
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                            "Need to specify either arbitration or packet.");
+      break;
   }
 
   return ::grpc::Status::OK;
@@ -574,6 +667,10 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
   return ::grpc::Status::OK;
 }
 
+std::string P4Service::DumpStats() const {
+  return write_req_logger_->DumpStats();
+}
+
 ::util::StatusOr<uint64> P4Service::FindNewConnectionId() {
   absl::WriterMutexLock l(&controller_lock_);
   if (static_cast<int>(connection_ids_.size()) >=
@@ -595,15 +692,35 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
 
 ::util::Status P4Service::AddOrModifyController(
     uint64 node_id, uint64 connection_id, absl::uint128 election_id,
-    const std::string& uri, ServerStreamChannelReaderWriter* stream) {
+    const std::string& uri, StreamMessageResponseWriter* stream) {
   // To be called by all the threads handling controller connections.
   absl::WriterMutexLock l(&controller_lock_);
   auto it = node_id_to_controllers_.find(node_id);
   if (it == node_id_to_controllers_.end()) {
     absl::WriterMutexLock l(&packet_in_thread_lock_);
-    // This is the first time we are hearing about this node. Lets try to add
-    // an RX packet writer for it. If the node_id is invalid, registration will
-    // fail.
+    // This is the first time we are hearing about this node. Lets add a TX
+    // Channel for it, drained by a thread which transmits the PacketOuts of
+    // the master controller in batches.
+    std::shared_ptr<Channel<::p4::v1::PacketOut>> tx_channel =
+        Channel<::p4::v1::PacketOut>::Create(kMaxPacketOutQueueDepth);
+    pthread_t tx_tid = 0;
+    int tx_ret = pthread_create(
+        &tx_tid, nullptr, PacketTransmitThreadFunc,
+        new ReaderArgs<::p4::v1::PacketOut>{
+            this, ChannelReader<::p4::v1::PacketOut>::Create(tx_channel),
+            node_id});
+    if (tx_ret) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to create packet-out transmitter thread for node "
+             << node_id << " with error " << tx_ret << ".";
+    }
+    // Stops the TX thread if the RX side cannot be set up.
+    auto tx_cleaner = gtl::MakeCleanup([&tx_channel, tx_tid]() {
+      tx_channel->Close();
+      pthread_join(tx_tid, nullptr);
+    });
+    // Then lets try to add an RX packet writer for it. If the node_id is
+    // invalid, registration will fail.
     std::shared_ptr<Channel<::p4::v1::PacketIn>> channel =
         Channel<::p4::v1::PacketIn>::Create(128);
     // Create the writer and register with the SwitchInterface.
@@ -625,9 +742,14 @@ void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
              << "Failed to create packet-in receiver thread for node "
              << node_id << " with error " << ret << ".";
     }
-    // Store Channel and tid for Teardown().
+    // Store Channels and tids for Teardown().
     packet_in_reader_tids_.push_back(tid);
     packet_in_channels_[node_id] = channel;
+    tx_cleaner.release();
+    packet_out_reader_tids_.push_back(tx_tid);
+    packet_out_channels_[node_id] = tx_channel;
+    packet_out_writers_[node_id] =
+        ChannelWriter<::p4::v1::PacketOut>::Create(tx_channel);
     node_id_to_controllers_[node_id] = {};
     it = node_id_to_controllers_.find(node_id);
   }
@@ -799,10 +921,50 @@ void* P4Service::PacketReceiveThreadFunc(void* arg) {
 
 void* P4Service::ReceivePackets(
     uint64 node_id, std::unique_ptr<ChannelReader<::p4::v1::PacketIn>> reader) {
+  std::vector<::p4::v1::PacketIn> packets;
+  do {
+    // Block on next packet RX from Channel, and take whatever else is queued
+    // along with it.
+    int code = reader
+                   ->ReadBatch(&packets, kMaxPacketInBatchSize,
+                               absl::InfiniteDuration())
+                   .error_code();
+    // Exit if the Channel is closed.
+    if (code == ERR_CANCELLED) break;
+    // Read should never timeout.
+    if (code == ERR_ENTRY_NOT_FOUND) {
+      LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
+      continue;
+    }
+    // Handle PacketIns.
+    for (const auto& packet_in : packets) {
+      PacketReceiveHandler(node_id, packet_in);
+    }
+  } while (true);
+  return nullptr;
+}
+
+void* P4Service::PacketTransmitThreadFunc(void* arg) {
+  auto* args = reinterpret_cast<ReaderArgs<::p4::v1::PacketOut>*>(arg);
+  auto* p4_service = args->p4_service;
+  auto node_id = args->node_id;
+  auto reader = std::move(args->reader);
+  delete args;
+  return p4_service->TransmitPackets(node_id, std::move(reader));
+}
+
+void* P4Service::TransmitPackets(
+    uint64 node_id,
+    std::unique_ptr<ChannelReader<::p4::v1::PacketOut>> reader) {
+  std::vector<::p4::v1::PacketOut> packets;
   do {
-    ::p4::v1::PacketIn packet_in;
-    // Block on next packet RX from Channel.
-    int code = reader->Read(&packet_in, absl::InfiniteDuration()).error_code();
+    // Block on the next PacketOut from the Channel, and take whatever else
+    // the controller has sent meanwhile, so that they are transmitted as one
+    // batch.
+    int code = reader
+                   ->ReadBatch(&packets, kMaxPacketOutBatchSize,
+                               absl::InfiniteDuration())
+                   .error_code();
     // Exit if the Channel is closed.
     if (code == ERR_CANCELLED) break;
     // Read should never timeout.
@@ -810,8 +972,12 @@ void* P4Service::ReceivePackets(
       LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
       continue;
     }
-    // Handle PacketIn.
-    PacketReceiveHandler(node_id, packet_in);
+    // Transmit the PacketOuts. No error reporting.
+    ::util::Status status =
+        switch_interface_->TransmitPackets(node_id, packets);
+    if (!status.ok()) {
+      LOG_EVERY_N(INFO, 500) << "Failed to transmit packets: " << status;
+    }
   } while (true);
   return nullptr;
 }
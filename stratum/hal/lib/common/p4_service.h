@@ -39,6 +39,8 @@
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/write_request_logger.h"
+#include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/p4/forwarding_pipeline_configs.pb.h"
 #include "stratum/lib/security/auth_policy_checker.h"
 
@@ -49,6 +51,10 @@ namespace hal {
 typedef ::grpc::ServerReaderWriter<::p4::v1::StreamMessageResponse,
                                    ::p4::v1::StreamMessageRequest>
     ServerStreamChannelReaderWriter;
+typedef WriterInterface<::p4::v1::StreamMessageResponse>
+    StreamMessageResponseWriter;
+
+class P4AsyncService;
 
 // The "P4Service" class implements P4Runtime::Service. It handles all
 // the RPCs that are part of the P4-based PI API.
@@ -61,7 +67,7 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
     Controller()
         : connection_id_(0), election_id_(0), uri_(""), stream_(nullptr) {}
     Controller(uint64 connection_id, absl::uint128 election_id,
-               const std::string& uri, ServerStreamChannelReaderWriter* stream)
+               const std::string& uri, StreamMessageResponseWriter* stream)
         : connection_id_(connection_id),
           election_id_(election_id),
           uri_(uri),
@@ -75,7 +81,7 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
     uint64 election_id_low() const { return absl::Uint128Low64(election_id_); }
     absl::uint128 election_id() const { return election_id_; }
     std::string uri() const { return uri_; }
-    ServerStreamChannelReaderWriter* stream() const { return stream_; }
+    StreamMessageResponseWriter* stream() const { return stream_; }
     // A unique name string for the controller.
     std::string Name() const {
       std::stringstream ss;
@@ -88,7 +94,7 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
     uint64 connection_id_;
     absl::uint128 election_id_;
     std::string uri_;
-    ServerStreamChannelReaderWriter* stream_;  // not owned
+    StreamMessageResponseWriter* stream_;  // not owned
   };
 
   // Custom comparator for Controller class.
@@ -160,6 +166,10 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       const ::p4::v1::CapabilitiesRequest* request,
       ::p4::v1::CapabilitiesResponse* response) override;
 
+  // Returns the stats of the write request log as string. It also dumps the
+  // string to stdout.
+  std::string DumpStats() const;
+
   // P4Service is neither copyable nor movable.
   P4Service(const P4Service&) = delete;
   P4Service& operator=(const P4Service&) = delete;
@@ -176,6 +186,15 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // Specifies the max number of controllers that can connect for a node.
   static constexpr size_t kMaxNumControllerPerNode = 5;
 
+  // Specifies the max number of packets read at once from the packet RX
+  // Channel of a node.
+  static constexpr size_t kMaxPacketInBatchSize = 32;
+
+  // Specifies the max number of packets queued in the packet TX Channel of a
+  // node, and the max number of them transmitted as one batch.
+  static constexpr size_t kMaxPacketOutQueueDepth = 128;
+  static constexpr size_t kMaxPacketOutBatchSize = 32;
+
   // Finds a new connection ID for a newly connected controller and adds it to
   // connection_ids_. Checks the number of active connections as well to make
   // sure we do not end with so many dangling threads.
@@ -194,9 +213,31 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   ::util::Status AddOrModifyController(uint64 node_id, uint64 connection_id,
                                        absl::uint128 election_id,
                                        const std::string& uri,
-                                       ServerStreamChannelReaderWriter* stream)
+                                       StreamMessageResponseWriter* stream)
+      LOCKS_EXCLUDED(controller_lock_);
+
+  // Reads the requested entities and writes them to the given writer. Does
+  // the work of Read() for both the sync and the async API.
+  ::grpc::Status ReadEntities(
+      ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
+      WriterInterface<::p4::v1::ReadResponse>* writer);
+
+  // Authorizes a new StreamChannel and finds an ID for its connection. To be
+  // followed by RemoveController() once the stream is done, if OK.
+  ::grpc::Status StartStreamChannel(::grpc::ServerContext* context,
+                                    uint64* connection_id)
       LOCKS_EXCLUDED(controller_lock_);
 
+  // Handles a request received on the StreamChannel of the given connection.
+  // The responses to the controller are written to the given stream. Sets
+  // node_id when the first arbitration request is received. A non-OK status
+  // ends the stream.
+  ::grpc::Status HandleStreamMessageRequest(
+      const ::p4::v1::StreamMessageRequest& req, const std::string& peer,
+      uint64 connection_id, uint64* node_id,
+      StreamMessageResponseWriter* stream)
+      LOCKS_EXCLUDED(controller_lock_, packet_in_thread_lock_);
+
   // Removes an existing controller from the controllers_ set given its stream.
   // To be called after stream from an existing controller is broken (e.g.
   // controller is disconnected).
@@ -224,6 +265,15 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       uint64 node_id, std::unique_ptr<ChannelReader<::p4::v1::PacketIn>> reader)
       LOCKS_EXCLUDED(controller_lock_);
 
+  // Thread function for handling packet TX.
+  static void* PacketTransmitThreadFunc(void* arg);
+
+  // Blocks on the packet TX Channel of the given node to read the PacketOuts
+  // queued by the master controller stream, and transmits them in batches.
+  void* TransmitPackets(
+      uint64 node_id,
+      std::unique_ptr<ChannelReader<::p4::v1::PacketOut>> reader);
+
   // Callback to be called whenever we receive a packet on the specified node
   // which is destined to controller.
   void PacketReceiveHandler(uint64 node_id, const ::p4::v1::PacketIn& packet)
@@ -238,7 +288,7 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // to the switch.
   mutable absl::Mutex config_lock_;
 
-  // Mutex which protects the creation and destruction of the Packet RX
+  // Mutex which protects the creation and destruction of the Packet RX and TX
   // Channels and threads.
   mutable absl::Mutex packet_in_thread_lock_;
 
@@ -258,6 +308,17 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   std::map<uint64, std::shared_ptr<Channel<::p4::v1::PacketIn>>>
       packet_in_channels_ GUARDED_BY(packet_in_thread_lock_);
 
+  // List of threads which transmit the packets sent by the controllers.
+  std::vector<pthread_t> packet_out_reader_tids_
+      GUARDED_BY(packet_in_thread_lock_);
+
+  // Map of per-node Channels which are used to queue the packets sent by the
+  // master controller for transmission, and their writers.
+  std::map<uint64, std::shared_ptr<Channel<::p4::v1::PacketOut>>>
+      packet_out_channels_ GUARDED_BY(packet_in_thread_lock_);
+  std::map<uint64, std::shared_ptr<ChannelWriter<::p4::v1::PacketOut>>>
+      packet_out_writers_ GUARDED_BY(packet_in_thread_lock_);
+
   // Holds the IDs of all streaming connections. Every time there is a new
   // streaming connection, we select min{1,...,max(connection_ids_) + 1} as
   // the ID of the new connection. Also, whenever the connection is dropped
@@ -290,6 +351,11 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // by this class.
   ErrorBuffer* error_buffer_;
 
+  // Logs all the write requests and their results to the file given by
+  // FLAGS_write_req_log_file in the background. Owned by this class.
+  std::unique_ptr<WriteRequestLogger> write_req_logger_;
+
+  friend class P4AsyncService;
   friend class P4ServiceTest;
 };
 
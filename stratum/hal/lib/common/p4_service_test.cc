@@ -16,11 +16,13 @@
 #include "stratum/hal/lib/common/p4_service.h"
 
 #include <memory>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/numeric/int128.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/rpc/code.pb.h"
@@ -32,6 +34,7 @@
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/switch_mock.h"
 #include "stratum/lib/macros.h"
+#include "stratum/lib/proto_container_file.h"
 #include "stratum/lib/security/auth_policy_checker_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
@@ -40,6 +43,7 @@
 DECLARE_int32(max_num_controllers_per_node);
 DECLARE_int32(max_num_controller_connections);
 DECLARE_string(forwarding_pipeline_configs_file);
+DECLARE_bool(forwarding_pipeline_configs_text_export);
 DECLARE_string(write_req_log_file);
 DECLARE_string(test_tmpdir);
 
@@ -48,6 +52,7 @@ namespace hal {
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::Return;
@@ -64,6 +69,18 @@ class P4ServiceTest : public ::testing::TestWithParam<OperationMode> {
  protected:
   void SetUp() override {
     mode_ = GetParam();
+    FLAGS_max_num_controllers_per_node = 5;
+    FLAGS_max_num_controller_connections = 20;
+    FLAGS_forwarding_pipeline_configs_file =
+        FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
+    FLAGS_forwarding_pipeline_configs_text_export = false;
+    // The write request log file is opened by P4Service, so it needs to be set
+    // before the class is instantiated.
+    FLAGS_write_req_log_file = FLAGS_test_tmpdir + "/write_req_log_fil.csv";
+    // Before starting the tests, remove the write req file if exists.
+    if (PathExists(FLAGS_write_req_log_file)) {
+      ASSERT_OK(RemoveFile(FLAGS_write_req_log_file));
+    }
     switch_mock_ = absl::make_unique<SwitchMock>();
     auth_policy_checker_mock_ = absl::make_unique<AuthPolicyCheckerMock>();
     error_buffer_ = absl::make_unique<ErrorBuffer>();
@@ -80,19 +97,13 @@ class P4ServiceTest : public ::testing::TestWithParam<OperationMode> {
     stub_ = ::p4::v1::P4Runtime::NewStub(
         ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
     ASSERT_NE(stub_, nullptr);
-    FLAGS_max_num_controllers_per_node = 5;
-    FLAGS_max_num_controller_connections = 20;
-    FLAGS_forwarding_pipeline_configs_file =
-        FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
-    FLAGS_write_req_log_file = FLAGS_test_tmpdir + "/write_req_log_fil.csv";
-    // Before starting the tests, remove the write req file if exists.
-    if (PathExists(FLAGS_write_req_log_file)) {
-      ASSERT_OK(RemoveFile(FLAGS_write_req_log_file));
-    }
   }
 
   void TearDown() override { server_->Shutdown(); }
 
+  // Waits until all the queued write requests are written to the log file.
+  void FlushWriteRequestLog() { p4_service_->write_req_logger_->Flush(); }
+
   void OnPacketReceive(const ::p4::v1::PacketIn& packet) {
     p4_service_->PacketReceiveHandler(kNodeId1, packet);
   }
@@ -394,6 +405,77 @@ TEST_P(P4ServiceTest, SetupAndPushForwardingPipelineConfigSuccess) {
   CheckForwardingPipelineConfigs(nullptr, 0 /*ignored*/);
 }
 
+TEST_P(P4ServiceTest, ColdbootSetupSuccessForSavedContainerFile) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  // Setup the test config and save it in the container format.
+  ForwardingPipelineConfigs configs;
+  FillTestForwardingPipelineConfigsAndSave(&configs);
+  ASSERT_OK(WriteProtoToContainerFile(configs,
+                                      FLAGS_forwarding_pipeline_configs_file));
+
+  EXPECT_CALL(
+      *switch_mock_,
+      PushForwardingPipelineConfig(
+          kNodeId1, EqualsProto(configs.node_id_to_config().at(kNodeId1))))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(
+      *switch_mock_,
+      PushForwardingPipelineConfig(
+          kNodeId2, EqualsProto(configs.node_id_to_config().at(kNodeId2))))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Call and validate results.
+  ASSERT_OK(p4_service_->Setup(false));
+  const auto& errors = error_buffer_->GetErrors();
+  EXPECT_TRUE(errors.empty());
+  CheckForwardingPipelineConfigs(&configs, kNodeId1);
+  CheckForwardingPipelineConfigs(&configs, kNodeId2);
+}
+
+TEST_P(P4ServiceTest, PushForwardingPipelineConfigSavesContainerFile) {
+  FLAGS_forwarding_pipeline_configs_text_export = true;
+  const std::string text_export_file =
+      FLAGS_forwarding_pipeline_configs_file + ".txt";
+  ForwardingPipelineConfigs configs;
+  FillTestForwardingPipelineConfigsAndSave(&configs);
+  ASSERT_OK(RemoveFile(FLAGS_forwarding_pipeline_configs_file));
+  if (PathExists(text_export_file)) ASSERT_OK(RemoveFile(text_export_file));
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ServerContext context;
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_action(
+      ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT);
+  *request.mutable_config() = configs.node_id_to_config().at(kNodeId1);
+  AddFakeMasterController(kNodeId1, 1, kElectionId1, "some uri");
+
+  ::grpc::Status status =
+      p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+  EXPECT_TRUE(status.ok()) << "Error: " << status.error_message();
+
+  // The configs are saved in the container format, and exported in text.
+  ForwardingPipelineConfigs expected;
+  (*expected.mutable_node_id_to_config())[kNodeId1] = request.config();
+  ForwardingPipelineConfigs saved;
+  EXPECT_TRUE(IsProtoContainerFile(FLAGS_forwarding_pipeline_configs_file));
+  ASSERT_OK(ReadProtoFromContainerFile(FLAGS_forwarding_pipeline_configs_file,
+                                       &saved));
+  EXPECT_TRUE(ProtoEqual(expected, saved));
+  ForwardingPipelineConfigs exported;
+  ASSERT_OK(ReadProtoFromTextFile(text_export_file, &exported));
+  EXPECT_TRUE(ProtoEqual(expected, exported));
+}
+
 TEST_P(P4ServiceTest, VerifyForwardingPipelineConfigSuccess) {
   ForwardingPipelineConfigs configs;
   FillTestForwardingPipelineConfigsAndSave(&configs);
@@ -598,6 +680,7 @@ TEST_P(P4ServiceTest, WriteSuccess) {
   EXPECT_TRUE(status.error_message().empty());
   EXPECT_TRUE(status.error_details().empty());
   std::string s;
+  FlushWriteRequestLog();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
 }
@@ -707,6 +790,7 @@ TEST_P(P4ServiceTest, WriteFailureWhenWriteForwardingEntriesFails) {
   const auto& errors = error_buffer_->GetErrors();
   EXPECT_TRUE(errors.empty());
   std::string s;
+  FlushWriteRequestLog();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
   EXPECT_THAT(s, HasSubstr(req.updates(1).ShortDebugString()));
@@ -863,8 +947,14 @@ TEST_P(P4ServiceTest, StreamChannelSuccess) {
       .WillRepeatedly(Return(::util::OkStatus()));
   EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
       .WillOnce(Return(::util::OkStatus()));
-  EXPECT_CALL(*switch_mock_, TransmitPacket(kNodeId1, EqualsProto(packet2)))
-      .WillOnce(Return(::util::OkStatus()));
+  absl::Notification packet2_transmitted;
+  EXPECT_CALL(*switch_mock_,
+              TransmitPackets(kNodeId1, ElementsAre(EqualsProto(packet2))))
+      .WillOnce(Invoke([&](uint64 node_id,
+                           const std::vector<::p4::v1::PacketOut>& packets) {
+        packet2_transmitted.Notify();
+        return ::util::OkStatus();
+      }));
 
   //----------------------------------------------------------------------------
   // Before any connection, any packet received from the controller will be
@@ -1017,9 +1107,11 @@ TEST_P(P4ServiceTest, StreamChannelSuccess) {
   ASSERT_EQ(::google::rpc::OK, resp.arbitration().status().code());
 
   //----------------------------------------------------------------------------
-  // Controller #2 sends some packet out.
+  // Controller #2 sends some packet out. It is transmitted in the background.
   *req.mutable_packet() = packet2;
   ASSERT_TRUE(stream2->Write(req));
+  ASSERT_TRUE(
+      packet2_transmitted.WaitForNotificationWithTimeout(absl::Seconds(10)));
 
   //----------------------------------------------------------------------------
   // Controller #1 tries sends some packet out too. However its packet will be
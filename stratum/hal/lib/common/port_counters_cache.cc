@@ -0,0 +1,138 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/port_counters_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Saves the port counters received from the switch.
+class PortCountersWriter : public WriterInterface<DataResponse> {
+ public:
+  PortCountersWriter() : counters_(), found_(false) {}
+
+  bool Write(const DataResponse& resp) override {
+    if (!resp.has_port_counters()) return false;
+    counters_ = resp.port_counters();
+    found_ = true;
+    return true;
+  }
+
+  const PortCounters& counters() const { return counters_; }
+  bool found() const { return found_; }
+
+ private:
+  PortCounters counters_;
+  bool found_;
+};
+
+}  // namespace
+
+PortCountersCache::PortCountersCache(SwitchInterface* switch_interface,
+                                     absl::Duration ttl)
+    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
+      ttl_(ttl),
+      entries_(),
+      stats_() {}
+
+::util::StatusOr<PortCounters> PortCountersCache::GetPortCounters(
+    uint64 node_id, uint32 port_id) {
+  if (ttl_ <= absl::ZeroDuration()) {
+    {
+      absl::WriterMutexLock l(&lock_);
+      stats_.misses++;
+    }
+    return ReadPortCounters(node_id, port_id);
+  }
+
+  std::shared_ptr<Entry> entry;
+  {
+    absl::WriterMutexLock l(&lock_);
+    auto& e = entries_[std::make_pair(node_id, port_id)];
+    if (e == nullptr) e = std::make_shared<Entry>();
+    entry = e;
+  }
+
+  // Holding the entry lock while reading from the switch makes the concurrent
+  // lookups on the same port wait for the result instead of reading again.
+  absl::MutexLock l(&entry->lock);
+  if (absl::Now() - entry->timestamp < ttl_) {
+    absl::WriterMutexLock s(&lock_);
+    stats_.hits++;
+    return entry->counters;
+  }
+  {
+    absl::WriterMutexLock s(&lock_);
+    stats_.misses++;
+  }
+  ASSIGN_OR_RETURN(entry->counters, ReadPortCounters(node_id, port_id));
+  entry->timestamp = absl::Now();
+
+  return entry->counters;
+}
+
+void PortCountersCache::Clear() {
+  absl::WriterMutexLock l(&lock_);
+  entries_.clear();
+}
+
+PortCountersCache::Stats PortCountersCache::GetStats() const {
+  absl::ReaderMutexLock l(&lock_);
+  return stats_;
+}
+
+std::string PortCountersCache::DumpStats() const {
+  Stats stats = GetStats();
+  std::string msg = absl::StrCat(
+      "Port counters cache stats: (hits:", stats.hits,
+      ", misses:", stats.misses, ", errors:", stats.errors, ")");
+  LOG(INFO) << msg;
+
+  return msg;
+}
+
+::util::StatusOr<PortCounters> PortCountersCache::ReadPortCounters(
+    uint64 node_id, uint32 port_id) {
+  DataRequest req;
+  auto* request = req.add_requests()->mutable_port_counters();
+  request->set_node_id(node_id);
+  request->set_port_id(port_id);
+
+  PortCountersWriter writer;
+  ::util::Status status = switch_interface_->RetrieveValue(
+      node_id, req, &writer, /* details= */ nullptr);
+  if (status.ok() && !writer.found()) {
+    status = MAKE_ERROR(ERR_INTERNAL)
+             << "No port counters returned for port " << port_id
+             << " on node " << node_id << ".";
+  }
+  if (!status.ok()) {
+    absl::WriterMutexLock l(&lock_);
+    stats_.errors++;
+    return status;
+  }
+
+  return writer.counters();
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_CACHE_H_
+#define STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/switch_interface.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+
+// The "PortCountersCache" class keeps the last snapshot of the counters of
+// each (node, port) read from the switch. gNMI handles each counter leaf of a
+// port separately, and all the leaves of a port subscribed with the same
+// sample interval fire within the same tick. The cache makes sure all these
+// leaves are served from a single SwitchInterface::RetrieveValue() call (and
+// hence a single read of the counters from the SDK) as long as the snapshot is
+// younger than the given TTL. Concurrent misses on the same port are
+// coalesced: the first caller reads the counters while the others wait for
+// its result. The class is thread-safe.
+class PortCountersCache {
+ public:
+  // Hit/miss statistics of the cache.
+  struct Stats {
+    // Num of lookups served from a fresh snapshot.
+    uint64 hits;
+    // Num of lookups which required reading the counters from the switch.
+    uint64 misses;
+    // Num of reads from the switch which failed.
+    uint64 errors;
+    Stats() : hits(0), misses(0), errors(0) {}
+  };
+
+  // 'switch_interface' is not owned by the class. A zero TTL disables the
+  // cache, i.e. the counters are read from the switch for every lookup.
+  PortCountersCache(SwitchInterface* switch_interface, absl::Duration ttl);
+  virtual ~PortCountersCache() {}
+
+  // Returns the counters of the given port, either from a snapshot which is
+  // younger than the TTL or by reading them from the switch. The errors
+  // returned by the switch are forwarded to the caller and not cached.
+  ::util::StatusOr<PortCounters> GetPortCounters(uint64 node_id,
+                                                 uint32 port_id)
+      LOCKS_EXCLUDED(lock_);
+
+  // Drops all the snapshots. Called when the config is pushed, as the set of
+  // ports may change.
+  void Clear() LOCKS_EXCLUDED(lock_);
+
+  // Returns a copy of the cache statistics.
+  Stats GetStats() const LOCKS_EXCLUDED(lock_);
+
+  // Returns the cache statistics as a string. It also dumps the string to
+  // stdout.
+  std::string DumpStats() const LOCKS_EXCLUDED(lock_);
+
+  // PortCountersCache is neither copyable nor movable.
+  PortCountersCache(const PortCountersCache&) = delete;
+  PortCountersCache& operator=(const PortCountersCache&) = delete;
+
+ private:
+  // The last snapshot of the counters of a single port. Each entry has its own
+  // lock, which is held while the counters are read from the switch, so that
+  // lookups on other ports are not blocked.
+  struct Entry {
+    absl::Mutex lock;
+    // The time the counters were read. absl::InfinitePast() if the entry has
+    // never been filled.
+    absl::Time timestamp GUARDED_BY(lock);
+    PortCounters counters GUARDED_BY(lock);
+    Entry() : timestamp(absl::InfinitePast()) {}
+  };
+
+  // Reads the counters of the given port from the switch.
+  ::util::StatusOr<PortCounters> ReadPortCounters(uint64 node_id,
+                                                  uint32 port_id)
+      LOCKS_EXCLUDED(lock_);
+
+  // Pointer to the switch used to read the counters. Not owned.
+  SwitchInterface* const switch_interface_;
+
+  // Max age of a snapshot served from the cache.
+  const absl::Duration ttl_;
+
+  // Mutex lock protecting the map and the stats.
+  mutable absl::Mutex lock_;
+
+  // Map from (node_id, port_id) to the last snapshot of the port counters. The
+  // entries are shared with the callers reading them, so that Clear() does not
+  // pull an entry from under a reader.
+  absl::flat_hash_map<std::pair<uint64, uint32>, std::shared_ptr<Entry>>
+      entries_ GUARDED_BY(lock_);
+
+  Stats stats_ GUARDED_BY(lock_);
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_CACHE_H_
@@ -0,0 +1,194 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/port_counters_cache.h"
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Return;
+
+class PortCountersCacheTest : public ::testing::Test {
+ protected:
+  static constexpr uint64 kNodeId = 123;
+  static constexpr uint32 kPortId1 = 1;
+  static constexpr uint32 kPortId2 = 2;
+
+  // Mock implementation of RetrieveValue() which returns the port ID as the
+  // in_octets counter, and the num of calls so far as the out_octets counter.
+  ::util::Status RetrieveValue(uint64 node_id, const DataRequest& req,
+                               WriterInterface<DataResponse>* writer,
+                               std::vector<::util::Status>* details) {
+    EXPECT_EQ(1, req.requests_size());
+    EXPECT_EQ(node_id, req.requests(0).port_counters().node_id());
+    DataResponse resp;
+    resp.mutable_port_counters()->set_in_octets(
+        req.requests(0).port_counters().port_id());
+    resp.mutable_port_counters()->set_out_octets(++num_reads_);
+    writer->Write(resp);
+    return ::util::OkStatus();
+  }
+
+  // Returns an action calling the mock implementation of RetrieveValue().
+  ::testing::Action<::util::Status(uint64, const DataRequest&,
+                                   WriterInterface<DataResponse>*,
+                                   std::vector<::util::Status>*)>
+  FakeRetrieveValue() {
+    return Invoke(this, &PortCountersCacheTest::RetrieveValue);
+  }
+
+  void ExpectReads(int times) {
+    EXPECT_CALL(switch_, RetrieveValue(kNodeId, _, _, _))
+        .Times(times)
+        .WillRepeatedly(FakeRetrieveValue());
+  }
+
+  SwitchMock switch_;
+  int num_reads_ = 0;
+};
+
+constexpr uint64 PortCountersCacheTest::kNodeId;
+constexpr uint32 PortCountersCacheTest::kPortId1;
+constexpr uint32 PortCountersCacheTest::kPortId2;
+
+TEST_F(PortCountersCacheTest, ServesFreshSnapshotFromCache) {
+  PortCountersCache cache(&switch_, absl::Hours(1));
+  ExpectReads(2);
+
+  // All the lookups for the same port share one read.
+  for (int i = 0; i < 14; ++i) {
+    ASSERT_OK_AND_ASSIGN(auto counters,
+                         cache.GetPortCounters(kNodeId, kPortId1));
+    EXPECT_EQ(kPortId1, counters.in_octets());
+    EXPECT_EQ(1, counters.out_octets());
+  }
+  // Other ports are read separately.
+  ASSERT_OK_AND_ASSIGN(auto counters,
+                       cache.GetPortCounters(kNodeId, kPortId2));
+  EXPECT_EQ(kPortId2, counters.in_octets());
+  EXPECT_EQ(2, counters.out_octets());
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(13, stats.hits);
+  EXPECT_EQ(2, stats.misses);
+  EXPECT_EQ(0, stats.errors);
+  EXPECT_THAT(cache.DumpStats(), HasSubstr("hits:13, misses:2, errors:0"));
+}
+
+TEST_F(PortCountersCacheTest, ZeroTtlDisablesCache) {
+  PortCountersCache cache(&switch_, absl::ZeroDuration());
+  ExpectReads(3);
+
+  for (int i = 1; i <= 3; ++i) {
+    ASSERT_OK_AND_ASSIGN(auto counters,
+                         cache.GetPortCounters(kNodeId, kPortId1));
+    EXPECT_EQ(i, counters.out_octets());
+  }
+  EXPECT_EQ(0, cache.GetStats().hits);
+  EXPECT_EQ(3, cache.GetStats().misses);
+}
+
+TEST_F(PortCountersCacheTest, StaleSnapshotIsReadAgain) {
+  PortCountersCache cache(&switch_, absl::Milliseconds(1));
+  ExpectReads(2);
+
+  ASSERT_OK_AND_ASSIGN(auto counters,
+                       cache.GetPortCounters(kNodeId, kPortId1));
+  EXPECT_EQ(1, counters.out_octets());
+  absl::SleepFor(absl::Milliseconds(5));
+  ASSERT_OK_AND_ASSIGN(counters, cache.GetPortCounters(kNodeId, kPortId1));
+  EXPECT_EQ(2, counters.out_octets());
+}
+
+TEST_F(PortCountersCacheTest, ClearDropsSnapshots) {
+  PortCountersCache cache(&switch_, absl::Hours(1));
+  ExpectReads(2);
+
+  ASSERT_OK(cache.GetPortCounters(kNodeId, kPortId1).status());
+  cache.Clear();
+  ASSERT_OK_AND_ASSIGN(auto counters,
+                       cache.GetPortCounters(kNodeId, kPortId1));
+  EXPECT_EQ(2, counters.out_octets());
+}
+
+TEST_F(PortCountersCacheTest, ErrorsAreNotCached) {
+  PortCountersCache cache(&switch_, absl::Hours(1));
+  EXPECT_CALL(switch_, RetrieveValue(kNodeId, _, _, _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Some error.")))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(FakeRetrieveValue());
+
+  auto ret = cache.GetPortCounters(kNodeId, kPortId1);
+  ASSERT_FALSE(ret.ok());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("Some error."));
+  // No response from the switch is an error too.
+  ret = cache.GetPortCounters(kNodeId, kPortId1);
+  ASSERT_FALSE(ret.ok());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("No port counters"));
+  ASSERT_OK(cache.GetPortCounters(kNodeId, kPortId1).status());
+  ASSERT_OK(cache.GetPortCounters(kNodeId, kPortId1).status());
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(3, stats.misses);
+  EXPECT_EQ(2, stats.errors);
+}
+
+TEST_F(PortCountersCacheTest, ConcurrentMissesAreCoalesced) {
+  PortCountersCache cache(&switch_, absl::Hours(1));
+  // The first read blocks until all the threads are started.
+  absl::Notification started;
+  EXPECT_CALL(switch_, RetrieveValue(kNodeId, _, _, _))
+      .WillOnce(Invoke([this, &started](uint64 node_id, const DataRequest& req,
+                                        WriterInterface<DataResponse>* writer,
+                                        std::vector<::util::Status>* details) {
+        started.WaitForNotification();
+        return RetrieveValue(node_id, req, writer, details);
+      }));
+
+  constexpr int kNumThreads = 8;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&cache]() {
+      auto ret = cache.GetPortCounters(kNodeId, kPortId1);
+      ASSERT_OK(ret.status());
+      EXPECT_EQ(1, ret.ValueOrDie().out_octets());
+    });
+  }
+  started.Notify();
+  for (auto& t : threads) t.join();
+
+  EXPECT_EQ(kNumThreads - 1, cache.GetStats().hits);
+  EXPECT_EQ(1, cache.GetStats().misses);
+}
+
+}  // namespace hal
+}  // namespace stratum
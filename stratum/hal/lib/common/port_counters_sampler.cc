@@ -0,0 +1,138 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/port_counters_sampler.h"
+
+#include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_int32(port_counters_sampling_interval_ms, 1000,
+             "Interval in milliseconds between two sweeps of the port counters "
+             "done by the chassis managers to detect counter changes and emit "
+             "PortCountersChangedEvents. Set to 0 to disable the sampling.");
+
+namespace stratum {
+namespace hal {
+
+PortCountersSampler::PortCountersSampler(SweepFunc sweep_func,
+                                         NotifyFunc notify_func)
+    : sampler_thread_(),
+      running_(false),
+      shutdown_(false),
+      interval_(absl::ZeroDuration()),
+      last_counters_(),
+      sweep_func_(std::move(sweep_func)),
+      notify_func_(std::move(notify_func)) {}
+
+PortCountersSampler::~PortCountersSampler() { Stop().IgnoreError(); }
+
+std::unique_ptr<PortCountersSampler> PortCountersSampler::CreateInstance(
+    SweepFunc sweep_func, NotifyFunc notify_func) {
+  return absl::WrapUnique(
+      new PortCountersSampler(std::move(sweep_func), std::move(notify_func)));
+}
+
+::util::Status PortCountersSampler::Start(absl::Duration interval) {
+  CHECK_RETURN_IF_FALSE(interval > absl::ZeroDuration())
+      << "Invalid port counters sampling interval " << interval << ".";
+  absl::MutexLock l(&thread_lock_);
+  if (running_) return ::util::OkStatus();
+  interval_ = interval;
+  shutdown_ = false;
+  sampler_thread_ = std::thread([this]() { SamplePeriodically(); });
+  running_ = true;
+  LOG(INFO) << "Port counters sampler started with an interval of "
+            << interval << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status PortCountersSampler::Stop() {
+  {
+    absl::MutexLock l(&thread_lock_);
+    if (!running_) return ::util::OkStatus();
+    shutdown_ = true;
+    thread_cond_var_.SignalAll();
+  }
+  // The thread takes thread_lock_, so it is joined without holding it.
+  sampler_thread_.join();
+  {
+    absl::MutexLock l(&thread_lock_);
+    running_ = false;
+  }
+  {
+    absl::MutexLock l(&sweep_lock_);
+    last_counters_.clear();
+  }
+
+  return ::util::OkStatus();
+}
+
+bool PortCountersSampler::IsRunning() const {
+  absl::MutexLock l(&thread_lock_);
+  return running_;
+}
+
+::util::StatusOr<int> PortCountersSampler::SampleNow() {
+  absl::MutexLock l(&sweep_lock_);
+  std::vector<Sample> samples;
+  ::util::Status status = sweep_func_(&samples);
+  if (!status.ok()) {
+    LOG_EVERY_N(ERROR, 100) << "Failed to sample the counters of some ports: "
+                            << status.error_message();
+  }
+  // After a complete sweep, only the ports read by the sweep are kept, so the
+  // counters of the ports removed by a config push are dropped. After a failed
+  // sweep, the ports which could not be read keep their previous counters.
+  std::map<std::pair<uint64, uint32>, PortCounters> counters;
+  if (!status.ok()) counters = last_counters_;
+  int num_changed = 0;
+  for (auto& sample : samples) {
+    auto key = std::make_pair(sample.node_id, sample.port_id);
+    auto it = last_counters_.find(key);
+    if (it != last_counters_.end() &&
+        !ProtoEqual(it->second, sample.counters)) {
+      notify_func_(sample.node_id, sample.port_id, sample.counters);
+      ++num_changed;
+    }
+    counters[key] = std::move(sample.counters);
+  }
+  last_counters_ = std::move(counters);
+  if (!status.ok()) return status;
+
+  return num_changed;
+}
+
+void PortCountersSampler::SamplePeriodically() {
+  while (true) {
+    {
+      absl::MutexLock l(&thread_lock_);
+      absl::Time deadline = absl::Now() + interval_;
+      while (!shutdown_ && absl::Now() < deadline) {
+        thread_cond_var_.WaitWithDeadline(&thread_lock_, deadline);
+      }
+      if (shutdown_) return;
+    }
+    // The errors are logged by SampleNow().
+    SampleNow().status().IgnoreError();
+  }
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_SAMPLER_H_
+#define STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_SAMPLER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/common.pb.h"
+
+namespace stratum {
+namespace hal {
+
+// The "PortCountersSampler" class is the counter-change detection engine used
+// by the chassis managers. A background thread reads the counters of all the
+// ports of the chassis in one sweep every interval, compares them with the
+// previous sweep, and reports the ports whose counters changed. The chassis
+// managers turn each report into a PortCountersChangedEvent, so ON_CHANGE
+// counter subscriptions get push-style updates.
+class PortCountersSampler {
+ public:
+  // The counters of one port, as read by a sweep.
+  struct Sample {
+    uint64 node_id;
+    uint32 port_id;
+    PortCounters counters;
+  };
+
+  // Reads the counters of all the ports of the chassis into samples. Called
+  // once per sweep, never concurrently. On error, the samples of the ports
+  // which could be read are still used.
+  using SweepFunc = std::function<::util::Status(std::vector<Sample>* samples)>;
+
+  // Called once per port whose counters changed since the previous sweep.
+  using NotifyFunc = std::function<void(uint64 node_id, uint32 port_id,
+                                        const PortCounters& counters)>;
+
+  ~PortCountersSampler();
+
+  // Starts the background thread which samples the counters every interval.
+  // Calling Start() on a running sampler is a no-op.
+  ::util::Status Start(absl::Duration interval) LOCKS_EXCLUDED(thread_lock_);
+
+  // Stops the background thread, if running, and forgets the counters of the
+  // last sweep. Must not be called with any lock taken by the SweepFunc held.
+  ::util::Status Stop() LOCKS_EXCLUDED(thread_lock_, sweep_lock_);
+
+  // Returns true if the background thread is running.
+  bool IsRunning() const LOCKS_EXCLUDED(thread_lock_);
+
+  // Runs one sweep right away and reports the ports whose counters changed
+  // since the previous sweep. The ports seen for the first time are only
+  // recorded. Returns the number of changed ports. If the sweep fails, the
+  // ports it could read are still reported, the counters of the other ports
+  // are kept for the next sweep, and the (logged) error is returned.
+  ::util::StatusOr<int> SampleNow() LOCKS_EXCLUDED(sweep_lock_);
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<PortCountersSampler> CreateInstance(
+      SweepFunc sweep_func, NotifyFunc notify_func);
+
+  // PortCountersSampler is neither copyable nor movable.
+  PortCountersSampler(const PortCountersSampler&) = delete;
+  PortCountersSampler& operator=(const PortCountersSampler&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  PortCountersSampler(SweepFunc sweep_func, NotifyFunc notify_func);
+
+  // Body of the background thread.
+  void SamplePeriodically() LOCKS_EXCLUDED(thread_lock_);
+
+  // Protects the state of the background thread.
+  mutable absl::Mutex thread_lock_;
+
+  // Signaled on Stop() to wake up the background thread.
+  absl::CondVar thread_cond_var_;
+
+  // The background thread and its parameters.
+  std::thread sampler_thread_;
+  bool running_ GUARDED_BY(thread_lock_);
+  bool shutdown_ GUARDED_BY(thread_lock_);
+  absl::Duration interval_ GUARDED_BY(thread_lock_);
+
+  // Serializes the sweeps. Acquired before any lock taken by sweep_func_.
+  absl::Mutex sweep_lock_;
+
+  // The counters read by the last sweep, keyed by (node ID, port ID).
+  std::map<std::pair<uint64, uint32>, PortCounters> last_counters_
+      GUARDED_BY(sweep_lock_);
+
+  // The callbacks given by the owner of the class.
+  const SweepFunc sweep_func_;
+  const NotifyFunc notify_func_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_PORT_COUNTERS_SAMPLER_H_
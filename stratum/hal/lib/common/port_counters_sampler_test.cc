@@ -0,0 +1,169 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/port_counters_sampler.h"
+
+#include <tuple>
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+class PortCountersSamplerTest : public ::testing::Test {
+ protected:
+  static constexpr uint64 kNodeId = 123;
+  static constexpr uint32 kPortId1 = 1;
+  static constexpr uint32 kPortId2 = 2;
+
+  void SetUp() override {
+    sampler_ = PortCountersSampler::CreateInstance(
+        [this](std::vector<PortCountersSampler::Sample>* samples) {
+          absl::MutexLock l(&lock_);
+          ++num_sweeps_;
+          // Like the chassis managers, the ports which fail to be read are
+          // skipped and the sweep goes on.
+          for (const auto& sample : samples_) {
+            if (sample.port_id != failed_port_id_) samples->push_back(sample);
+          }
+          if (failed_port_id_ != 0) {
+            return MAKE_ERROR(ERR_INTERNAL)
+                   << "Failed to read port " << failed_port_id_ << ".";
+          }
+          return ::util::OkStatus();
+        },
+        [this](uint64 node_id, uint32 port_id, const PortCounters& counters) {
+          absl::MutexLock l(&lock_);
+          events_.emplace_back(node_id, port_id, counters.in_octets());
+        });
+  }
+
+  // Sets the in_octets counter the next sweep reads for the given port.
+  void SetInOctets(uint32 port_id, uint64 in_octets) {
+    absl::MutexLock l(&lock_);
+    for (auto& sample : samples_) {
+      if (sample.port_id == port_id) {
+        sample.counters.set_in_octets(in_octets);
+        return;
+      }
+    }
+    PortCountersSampler::Sample sample;
+    sample.node_id = kNodeId;
+    sample.port_id = port_id;
+    sample.counters.set_in_octets(in_octets);
+    samples_.push_back(sample);
+  }
+
+  absl::Mutex lock_;
+  std::vector<PortCountersSampler::Sample> samples_ GUARDED_BY(lock_);
+  // ID of the port the sweeps fail to read, 0 for none.
+  uint32 failed_port_id_ GUARDED_BY(lock_) = 0;
+  int num_sweeps_ GUARDED_BY(lock_) = 0;
+  std::vector<std::tuple<uint64, uint32, uint64>> events_ GUARDED_BY(lock_);
+  std::unique_ptr<PortCountersSampler> sampler_;
+};
+
+constexpr uint64 PortCountersSamplerTest::kNodeId;
+constexpr uint32 PortCountersSamplerTest::kPortId1;
+constexpr uint32 PortCountersSamplerTest::kPortId2;
+
+TEST_F(PortCountersSamplerTest, FirstSweepOnlyRecordsTheCounters) {
+  SetInOctets(kPortId1, 10);
+  SetInOctets(kPortId2, 20);
+  ASSERT_OK_AND_ASSIGN(int num_changed, sampler_->SampleNow());
+  EXPECT_EQ(0, num_changed);
+  absl::MutexLock l(&lock_);
+  EXPECT_TRUE(events_.empty());
+}
+
+TEST_F(PortCountersSamplerTest, ReportsOnlyTheChangedPorts) {
+  SetInOctets(kPortId1, 10);
+  SetInOctets(kPortId2, 20);
+  ASSERT_OK(sampler_->SampleNow().status());
+  SetInOctets(kPortId2, 25);
+  ASSERT_OK_AND_ASSIGN(int num_changed, sampler_->SampleNow());
+  EXPECT_EQ(1, num_changed);
+  // Nothing changed since the previous sweep.
+  ASSERT_OK_AND_ASSIGN(num_changed, sampler_->SampleNow());
+  EXPECT_EQ(0, num_changed);
+  absl::MutexLock l(&lock_);
+  EXPECT_THAT(events_, ElementsAre(std::make_tuple(kNodeId, kPortId2, 25)));
+}
+
+TEST_F(PortCountersSamplerTest, SweepErrorKeepsThePreviousCounters) {
+  SetInOctets(kPortId1, 10);
+  SetInOctets(kPortId2, 20);
+  ASSERT_OK(sampler_->SampleNow().status());
+  {
+    absl::MutexLock l(&lock_);
+    failed_port_id_ = kPortId2;
+  }
+  // The ports read by the failed sweep are still reported.
+  SetInOctets(kPortId1, 11);
+  SetInOctets(kPortId2, 25);
+  EXPECT_THAT(sampler_->SampleNow().status().error_message(),
+              HasSubstr("Failed to read port 2."));
+  {
+    absl::MutexLock l(&lock_);
+    EXPECT_THAT(events_, ElementsAre(std::make_tuple(kNodeId, kPortId1, 11)));
+    failed_port_id_ = 0;
+  }
+  // The port which could not be read kept its counters from the sweep before,
+  // so its change is reported by the next sweep.
+  ASSERT_OK_AND_ASSIGN(int num_changed, sampler_->SampleNow());
+  EXPECT_EQ(1, num_changed);
+  absl::MutexLock l(&lock_);
+  EXPECT_THAT(events_, ElementsAre(std::make_tuple(kNodeId, kPortId1, 11),
+                                   std::make_tuple(kNodeId, kPortId2, 25)));
+}
+
+TEST_F(PortCountersSamplerTest, BackgroundThreadSamplesPeriodically) {
+  SetInOctets(kPortId1, 10);
+  ASSERT_OK(sampler_->Start(absl::Milliseconds(1)));
+  EXPECT_TRUE(sampler_->IsRunning());
+  {
+    absl::MutexLock l(&lock_);
+    lock_.Await(absl::Condition(
+        +[](int* num_sweeps) { return *num_sweeps >= 1; }, &num_sweeps_));
+  }
+  SetInOctets(kPortId1, 11);
+  {
+    absl::MutexLock l(&lock_);
+    lock_.Await(absl::Condition(
+        +[](std::vector<std::tuple<uint64, uint32, uint64>>* events) {
+          return !events->empty();
+        },
+        &events_));
+    EXPECT_EQ(std::make_tuple(kNodeId, kPortId1, uint64{11}), events_[0]);
+  }
+  ASSERT_OK(sampler_->Stop());
+  EXPECT_FALSE(sampler_->IsRunning());
+  // Stop() is idempotent.
+  ASSERT_OK(sampler_->Stop());
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -40,6 +40,22 @@ class ServerWriterWrapper : public WriterInterface<T> {
   ::grpc::ServerWriter<T>* writer_;  // not owned by the class.
 };
 
+// Wrapper for the writing side of ::grpc::ServerReaderWriter based on
+// WriterInterface class.
+template <typename W, typename R>
+class ServerReaderWriterWrapper : public WriterInterface<W> {
+ public:
+  explicit ServerReaderWriterWrapper(::grpc::ServerReaderWriter<W, R>* stream)
+      : stream_(stream) {}
+  bool Write(const W& msg) override {
+    if (stream_) return stream_->Write(msg);
+    return false;
+  }
+
+ private:
+  ::grpc::ServerReaderWriter<W, R>* stream_;  // not owned by the class.
+};
+
 }  // namespace hal
 }  // namespace stratum
 
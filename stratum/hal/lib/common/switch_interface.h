@@ -29,6 +29,7 @@
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
+#include "stratum/lib/macros.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 
 namespace stratum {
@@ -183,6 +184,21 @@ class SwitchInterface {
   virtual ::util::Status TransmitPacket(uint64 node_id,
                                         const ::p4::v1::PacketOut& packet) = 0;
 
+  // Transmits a batch of packets received from controller to a given node.
+  // Each packet is handled the same way as in TransmitPacket(), and a packet
+  // which cannot be sent does not stop the rest of the batch. The returned
+  // status aggregates the errors for all the failed packets. The default
+  // implementation calls TransmitPacket() for each packet. Implementations
+  // which can amortize the per-packet cost (locks, syscalls) override it.
+  virtual ::util::Status TransmitPackets(
+      uint64 node_id, const std::vector<::p4::v1::PacketOut>& packets) {
+    ::util::Status status = ::util::OkStatus();
+    for (const auto& packet : packets) {
+      APPEND_STATUS_IF_ERROR(status, TransmitPacket(node_id, packet));
+    }
+    return status;
+  }
+
   // Registers a writer for sending gNMI events.
   virtual ::util::Status RegisterEventNotifyWriter(
       std::shared_ptr<WriterInterface<GnmiEventPtr>> writer) = 0;
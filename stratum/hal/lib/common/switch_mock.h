@@ -69,6 +69,9 @@ class SwitchMock : public SwitchInterface {
   MOCK_METHOD2(TransmitPacket,
                ::util::Status(uint64 node_id,
                               const ::p4::v1::PacketOut& packet));
+  MOCK_METHOD2(TransmitPackets,
+               ::util::Status(uint64 node_id,
+                              const std::vector<::p4::v1::PacketOut>& packets));
   MOCK_METHOD1(
       RegisterEventNotifyWriter,
       ::util::Status(std::shared_ptr<WriterInterface<GnmiEventPtr>> writer));
@@ -0,0 +1,139 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/unit_executor.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// The worker whose thread is running the current code, if any. Used to run
+// work posted by a unit to itself inline instead of deadlocking.
+thread_local const void* current_worker = nullptr;
+
+}  // namespace
+
+UnitExecutor::UnitExecutor(const std::vector<int>& units) : unit_to_worker_() {
+  for (int unit : units) {
+    auto& worker = unit_to_worker_[unit];
+    if (worker != nullptr) continue;
+    worker = absl::make_unique<Worker>();
+    worker->thread = std::thread(&UnitExecutor::WorkerThread, worker.get());
+  }
+}
+
+UnitExecutor::~UnitExecutor() { Shutdown(); }
+
+::util::Status UnitExecutor::RunOnUnits(
+    const std::vector<int>& units,
+    const std::function<::util::Status(int)>& fn) {
+  std::vector<::util::Status> results(units.size(), ::util::OkStatus());
+  std::vector<Worker*> workers(units.size(), nullptr);
+  int num_posted = 0;
+  for (size_t i = 0; i < units.size(); ++i) {
+    auto it = unit_to_worker_.find(units[i]);
+    if (it == unit_to_worker_.end()) {
+      results[i] = MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+                   << "Unit " << units[i] << " is unknown.";
+      continue;
+    }
+    Worker* worker = it->second.get();
+    if (units.size() > 1 && worker != current_worker) {
+      workers[i] = worker;
+      ++num_posted;
+    }
+  }
+
+  // Post the work to the other units first, then run the inline ones while
+  // the workers make progress.
+  absl::BlockingCounter done(num_posted);
+  for (size_t i = 0; i < units.size(); ++i) {
+    Worker* worker = workers[i];
+    if (worker == nullptr) continue;
+    int unit = units[i];
+    ::util::Status* result = &results[i];
+    absl::MutexLock l(&worker->lock);
+    worker->queue.emplace_back([&fn, &done, unit, result]() {
+      *result = fn(unit);
+      done.DecrementCount();
+    });
+  }
+  for (size_t i = 0; i < units.size(); ++i) {
+    if (workers[i] != nullptr || !results[i].ok()) continue;
+    results[i] = fn(units[i]);
+  }
+  done.Wait();
+
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& result : results) {
+    APPEND_STATUS_IF_ERROR(status, result);
+  }
+
+  return status;
+}
+
+::util::Status UnitExecutor::RunOnAllUnits(
+    const std::function<::util::Status(int)>& fn) {
+  std::vector<int> units;
+  units.reserve(unit_to_worker_.size());
+  for (const auto& entry : unit_to_worker_) units.push_back(entry.first);
+  return RunOnUnits(units, fn);
+}
+
+void UnitExecutor::Shutdown() {
+  for (const auto& entry : unit_to_worker_) {
+    absl::MutexLock l(&entry.second->lock);
+    entry.second->stop = true;
+  }
+  for (const auto& entry : unit_to_worker_) {
+    if (entry.second->thread.joinable()) entry.second->thread.join();
+  }
+}
+
+std::unique_ptr<UnitExecutor> UnitExecutor::CreateInstance(
+    const std::vector<int>& units) {
+  return absl::WrapUnique(new UnitExecutor(units));
+}
+
+void UnitExecutor::WorkerThread(Worker* worker) {
+  current_worker = worker;
+  while (true) {
+    std::function<void()> work;
+    {
+      absl::MutexLock l(&worker->lock);
+      worker->lock.Await(absl::Condition(
+          +[](Worker* w) NO_THREAD_SAFETY_ANALYSIS {
+            return w->stop || !w->queue.empty();
+          },
+          worker));
+      if (worker->queue.empty()) break;  // stop is set and queue is drained.
+      work = std::move(worker->queue.front());
+      worker->queue.pop_front();
+    }
+    work();
+  }
+}
+
+}  // namespace hal
+}  // namespace stratum
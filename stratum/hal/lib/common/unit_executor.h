@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_UNIT_EXECUTOR_H_
+#define STRATUM_HAL_LIB_COMMON_UNIT_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+
+// The "UnitExecutor" class owns one worker thread per unit (ASIC) and is used
+// by the switch classes to fan chassis-level operations out to all the nodes
+// concurrently. Work posted to a unit always runs on that unit's thread, so
+// the operations on a single node keep their order while different nodes make
+// progress in parallel.
+class UnitExecutor {
+ public:
+  virtual ~UnitExecutor();
+
+  // Runs fn(unit) for each of the given units on the unit's worker thread and
+  // blocks until all of them are done. The returned status aggregates the
+  // errors (if any) in the order of the given units. Units not known to the
+  // executor are reported as ERR_INVALID_PARAM. If there is a single unit, or
+  // if called from the worker thread of a unit, fn is run inline for that
+  // unit. Must not be called after Shutdown(). Note that fn must not fan out
+  // to other units from more than one unit at a time, as the workers would
+  // then wait for each other.
+  ::util::Status RunOnUnits(const std::vector<int>& units,
+                            const std::function<::util::Status(int)>& fn);
+
+  // Same as RunOnUnits() for all the units known to the executor.
+  ::util::Status RunOnAllUnits(const std::function<::util::Status(int)>& fn);
+
+  // Stops and joins all the worker threads after they drain their queues.
+  // Called by the destructor. Idempotent.
+  void Shutdown();
+
+  // Factory function for creating the instance of the class. Starts one
+  // worker thread per given unit.
+  static std::unique_ptr<UnitExecutor> CreateInstance(
+      const std::vector<int>& units);
+
+  // UnitExecutor is neither copyable nor movable.
+  UnitExecutor(const UnitExecutor&) = delete;
+  UnitExecutor& operator=(const UnitExecutor&) = delete;
+
+ private:
+  // The work queue and thread of a single unit.
+  struct Worker {
+    Worker() : queue(), stop(false), thread() {}
+    absl::Mutex lock;
+    std::deque<std::function<void()>> queue GUARDED_BY(lock);
+    bool stop GUARDED_BY(lock);
+    std::thread thread;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  explicit UnitExecutor(const std::vector<int>& units);
+
+  // Body of the worker thread of a unit.
+  static void WorkerThread(Worker* worker);
+
+  // Map from unit number to its worker. Not changed after construction.
+  std::map<int, std::unique_ptr<Worker>> unit_to_worker_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_UNIT_EXECUTOR_H_
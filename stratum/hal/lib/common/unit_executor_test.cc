@@ -0,0 +1,104 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/unit_executor.h"
+
+#include <set>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::HasSubstr;
+
+TEST(UnitExecutorTest, RunOnAllUnitsRunsUnitsConcurrently) {
+  auto executor = UnitExecutor::CreateInstance({0, 1, 2});
+  // Every unit waits for all the others, which only completes if the units
+  // are run in parallel.
+  absl::BlockingCounter started(3);
+  absl::Mutex lock;
+  std::set<int> units;
+  EXPECT_OK(executor->RunOnAllUnits([&](int unit) {
+    started.DecrementCount();
+    started.Wait();
+    absl::MutexLock l(&lock);
+    units.insert(unit);
+    return ::util::OkStatus();
+  }));
+  EXPECT_EQ(std::set<int>({0, 1, 2}), units);
+}
+
+TEST(UnitExecutorTest, RunOnUnitsUsesOneThreadPerUnit) {
+  auto executor = UnitExecutor::CreateInstance({0, 1});
+  std::vector<std::thread::id> first(2), second(2);
+  EXPECT_OK(executor->RunOnAllUnits([&](int unit) {
+    first[unit] = std::this_thread::get_id();
+    return ::util::OkStatus();
+  }));
+  EXPECT_OK(executor->RunOnAllUnits([&](int unit) {
+    second[unit] = std::this_thread::get_id();
+    return ::util::OkStatus();
+  }));
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first[0], first[1]);
+  EXPECT_NE(std::this_thread::get_id(), first[0]);
+}
+
+TEST(UnitExecutorTest, RunOnUnitsAggregatesErrors) {
+  auto executor = UnitExecutor::CreateInstance({0, 1, 2});
+  ::util::Status status =
+      executor->RunOnUnits({0, 1, 2, 7}, [](int unit) -> ::util::Status {
+        if (unit == 1) {
+          return MAKE_ERROR(ERR_INTERNAL) << "Unit 1 failed.";
+        }
+        return ::util::OkStatus();
+      });
+  ASSERT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr("Unit 1 failed."));
+  EXPECT_THAT(status.error_message(), HasSubstr("Unit 7 is unknown."));
+}
+
+TEST(UnitExecutorTest, RunOnUnitsFromWorkerThreadRunsInline) {
+  auto executor = UnitExecutor::CreateInstance({0, 1});
+  std::thread::id outer, inner;
+  EXPECT_OK(executor->RunOnAllUnits([&](int unit) {
+    if (unit != 0) return ::util::OkStatus();
+    // Fanning out again from the thread of unit 0 must not deadlock.
+    outer = std::this_thread::get_id();
+    return executor->RunOnAllUnits([&](int nested_unit) {
+      if (nested_unit == 0) inner = std::this_thread::get_id();
+      return ::util::OkStatus();
+    });
+  }));
+  EXPECT_EQ(outer, inner);
+}
+
+TEST(UnitExecutorTest, ShutdownIsIdempotent) {
+  auto executor = UnitExecutor::CreateInstance({0, 1});
+  executor->Shutdown();
+  executor->Shutdown();
+}
+
+}  // namespace hal
+}  // namespace stratum
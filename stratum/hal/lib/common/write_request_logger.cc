@@ -0,0 +1,433 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/write_request_logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+void AppendFixed32(uint32 value, std::string* out) {
+  for (int i = 0; i < 4; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void AppendFixed64(uint64 value, std::string* out) {
+  for (int i = 0; i < 8; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+// Reads a little endian integer of the given size at *pos and advances *pos.
+// Returns false if there is not enough data.
+template <typename T>
+bool ReadFixed(const std::string& data, size_t* pos, T* value) {
+  if (data.size() - *pos < sizeof(T)) return false;
+  *value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    *value |= static_cast<T>(static_cast<unsigned char>(data[*pos + i]))
+              << (8 * i);
+  }
+  *pos += sizeof(T);
+  return true;
+}
+
+// Writes all the buffers given by iov to fd, retrying on partial writes.
+bool WriteFully(int fd, struct iovec* iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t ret = writev(fd, iov, std::min(iovcnt, IOV_MAX));
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    size_t written = static_cast<size_t>(ret);
+    while (iovcnt > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iovcnt;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+size_t NextPowerOfTwo(size_t n) {
+  size_t size = 1;
+  while (size < n) size <<= 1;
+  return size;
+}
+
+}  // namespace
+
+WriteRequestLogger::WriteRequestLogger(const Options& options)
+    : options_(options),
+      queue_size_(NextPowerOfTwo(std::max<size_t>(options.queue_size, 2))),
+      slots_(new Slot[queue_size_]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      batch_(new Slot[std::max<size_t>(options.max_batch_size, 1)]),
+      scratch_req_(),
+      buffers_(),
+      fd_(-1),
+      file_size_(0),
+      file_opened_at_(),
+      num_logged_(0),
+      num_dropped_(0),
+      num_bytes_written_(0),
+      num_write_errors_(0),
+      num_rotations_(0),
+      num_batches_(0),
+      writer_idle_(false),
+      num_processed_(0),
+      num_flush_requests_(0),
+      shutdown_(false) {
+  for (size_t i = 0; i < queue_size_; ++i) {
+    slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+WriteRequestLogger::~WriteRequestLogger() {
+  {
+    absl::MutexLock l(&lock_);
+    shutdown_ = true;
+    writer_cond_.Signal();
+    flush_cond_.SignalAll();
+  }
+  if (writer_thread_.joinable()) writer_thread_.join();
+  if (fd_ >= 0) close(fd_);
+}
+
+std::unique_ptr<WriteRequestLogger> WriteRequestLogger::CreateInstance(
+    const Options& options) {
+  auto logger =
+      std::unique_ptr<WriteRequestLogger>(new WriteRequestLogger(options));
+  if (logger->IsEnabled()) {
+    logger->writer_thread_ =
+        std::thread([&logger = *logger]() { logger.WriterThread(); });
+  }
+  return logger;
+}
+
+bool WriteRequestLogger::LogWriteRequest(
+    uint64 node_id, const ::p4::v1::WriteRequest& req,
+    const std::vector<::util::Status>& results, absl::Time timestamp) {
+  if (!IsEnabled()) return false;
+  if (results.size() != static_cast<size_t>(req.updates_size())) {
+    LOG(ERROR) << "Size mismatch: " << results.size()
+               << " != " << req.updates_size() << ". Did not log anything!";
+    return false;
+  }
+
+  // Claim a free slot.
+  Slot* slot = nullptr;
+  uint64 pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    slot = &slots_[pos & (queue_size_ - 1)];
+    uint64 seq = slot->seq.load(std::memory_order_acquire);
+    int64 diff = static_cast<int64>(seq) - static_cast<int64>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The writer thread has not caught up. Drop the record.
+      num_dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Fill the slot. The buffers of the slot are reused across records.
+  slot->timestamp = timestamp;
+  slot->node_id = node_id;
+  req.SerializeToString(&slot->serialized_req);
+  slot->error_codes.resize(results.size());
+  slot->error_messages.resize(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    slot->error_codes[i] = results[i].error_code();
+    slot->error_messages[i] = results[i].error_message();
+  }
+  slot->seq.store(pos + 1, std::memory_order_release);
+  num_logged_.fetch_add(1, std::memory_order_relaxed);
+
+  // Pairs with the fence in WriterThread() so that either the writer thread
+  // sees the record before going idle or we see it idle and wake it up.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_idle_.load(std::memory_order_relaxed)) WakeUpWriter();
+
+  return true;
+}
+
+void WriteRequestLogger::Flush() {
+  if (!IsEnabled()) return;
+  uint64 target = enqueue_pos_.load(std::memory_order_acquire);
+  absl::MutexLock l(&lock_);
+  ++num_flush_requests_;
+  writer_cond_.Signal();
+  while (num_processed_ < target && !shutdown_) flush_cond_.Wait(&lock_);
+  --num_flush_requests_;
+}
+
+std::string WriteRequestLogger::DumpStats() const {
+  std::string msg = absl::StrCat(
+      "\nWrite request log stats for ", options_.path, ": (",
+      "logged: ", num_logged_.load(std::memory_order_relaxed),
+      ", dropped: ", num_dropped_.load(std::memory_order_relaxed),
+      ", batches: ", num_batches_.load(std::memory_order_relaxed),
+      ", bytes_written: ", num_bytes_written_.load(std::memory_order_relaxed),
+      ", write_errors: ", num_write_errors_.load(std::memory_order_relaxed),
+      ", rotations: ", num_rotations_.load(std::memory_order_relaxed), ")");
+  LOG(INFO) << msg;
+  return msg;
+}
+
+::util::Status WriteRequestLogger::DecodeBinaryRecords(
+    const std::string& data, std::vector<Record>* records) {
+  CHECK_RETURN_IF_FALSE(records != nullptr);
+  size_t pos = 0;
+  while (pos < data.size()) {
+    uint32 frame_size = 0;
+    if (!ReadFixed(data, &pos, &frame_size) ||
+        data.size() - pos < frame_size) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Truncated write request log record at offset " << pos << ".";
+    }
+    const std::string frame = data.substr(pos, frame_size);
+    pos += frame_size;
+    size_t frame_pos = 0;
+    Record record;
+    uint64 timestamp_usec = 0;
+    uint32 req_size = 0, num_results = 0;
+    if (!ReadFixed(frame, &frame_pos, &timestamp_usec) ||
+        !ReadFixed(frame, &frame_pos, &record.node_id) ||
+        !ReadFixed(frame, &frame_pos, &req_size) ||
+        frame.size() - frame_pos < req_size ||
+        !record.req.ParseFromArray(frame.data() + frame_pos, req_size)) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Corrupted write request log record.";
+    }
+    frame_pos += req_size;
+    record.timestamp =
+        absl::FromUnixMicros(static_cast<int64>(timestamp_usec));
+    if (!ReadFixed(frame, &frame_pos, &num_results)) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Corrupted write request log record.";
+    }
+    for (uint32 i = 0; i < num_results; ++i) {
+      uint32 code = 0, msg_size = 0;
+      if (!ReadFixed(frame, &frame_pos, &code) ||
+          !ReadFixed(frame, &frame_pos, &msg_size) ||
+          frame.size() - frame_pos < msg_size) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Corrupted write request log record.";
+      }
+      std::string msg = frame.substr(frame_pos, msg_size);
+      frame_pos += msg_size;
+      if (code == ERR_SUCCESS) {
+        record.results.push_back(::util::OkStatus());
+      } else {
+        record.results.emplace_back(StratumErrorSpace(),
+                                    static_cast<int>(code), msg);
+      }
+    }
+    records->push_back(std::move(record));
+  }
+  return ::util::OkStatus();
+}
+
+void WriteRequestLogger::WriterThread() {
+  const size_t max_batch_size = std::max<size_t>(options_.max_batch_size, 1);
+  while (true) {
+    size_t num_records = PopBatch();
+    if (num_records > 0) {
+      WriteBatch(num_records);
+      absl::MutexLock l(&lock_);
+      num_processed_ = dequeue_pos_;
+      if (num_flush_requests_ > 0) flush_cond_.SignalAll();
+      // Keep draining while the ring is busy.
+      if (num_records == max_batch_size) continue;
+    }
+    absl::MutexLock l(&lock_);
+    writer_idle_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const Slot& next = slots_[dequeue_pos_ & (queue_size_ - 1)];
+    bool ready =
+        next.seq.load(std::memory_order_acquire) == dequeue_pos_ + 1;
+    if (!ready) {
+      if (shutdown_) break;
+      writer_cond_.WaitWithTimeout(&lock_, options_.flush_interval);
+    }
+    writer_idle_.store(false, std::memory_order_relaxed);
+  }
+}
+
+size_t WriteRequestLogger::PopBatch() {
+  const size_t max_batch_size = std::max<size_t>(options_.max_batch_size, 1);
+  size_t num_records = 0;
+  while (num_records < max_batch_size) {
+    Slot* slot = &slots_[dequeue_pos_ & (queue_size_ - 1)];
+    if (slot->seq.load(std::memory_order_acquire) != dequeue_pos_ + 1) break;
+    // Swap the record out so the slot keeps a set of allocated buffers.
+    Slot* record = &batch_[num_records++];
+    std::swap(record->timestamp, slot->timestamp);
+    std::swap(record->node_id, slot->node_id);
+    record->serialized_req.swap(slot->serialized_req);
+    record->error_codes.swap(slot->error_codes);
+    record->error_messages.swap(slot->error_messages);
+    slot->seq.store(dequeue_pos_ + queue_size_, std::memory_order_release);
+    ++dequeue_pos_;
+  }
+  return num_records;
+}
+
+void WriteRequestLogger::WriteBatch(size_t num_records) {
+  if (buffers_.size() < num_records) buffers_.resize(num_records);
+  std::vector<struct iovec> iov;
+  iov.reserve(num_records);
+  size_t total_size = 0;
+  for (size_t i = 0; i < num_records; ++i) {
+    buffers_[i].clear();
+    FormatRecord(batch_[i], &buffers_[i]);
+    if (buffers_[i].empty()) continue;
+    iov.push_back({&buffers_[i][0], buffers_[i].size()});
+    total_size += buffers_[i].size();
+  }
+  num_batches_.fetch_add(1, std::memory_order_relaxed);
+  if (iov.empty()) return;
+
+  ::util::Status status = MaybeOpenOrRotate(total_size);
+  if (status.ok() && !WriteFully(fd_, iov.data(), iov.size())) {
+    status = MAKE_ERROR(ERR_INTERNAL).without_logging()
+             << "Failed to write to " << options_.path << ": "
+             << strerror(errno) << ".";
+    // Reopen the file for the next batch.
+    close(fd_);
+    fd_ = -1;
+  }
+  if (!status.ok()) {
+    num_write_errors_.fetch_add(1, std::memory_order_relaxed);
+    LOG_EVERY_N(ERROR, 50) << "Failed to log the write request: "
+                           << status.error_message();
+    return;
+  }
+  file_size_ += total_size;
+  num_bytes_written_.fetch_add(total_size, std::memory_order_relaxed);
+}
+
+void WriteRequestLogger::FormatRecord(const Slot& record, std::string* out) {
+  if (options_.binary) {
+    size_t start = out->size();
+    AppendFixed32(0, out);  // Frame size, filled below.
+    AppendFixed64(static_cast<uint64>(absl::ToUnixMicros(record.timestamp)),
+                  out);
+    AppendFixed64(record.node_id, out);
+    AppendFixed32(record.serialized_req.size(), out);
+    out->append(record.serialized_req);
+    AppendFixed32(record.error_codes.size(), out);
+    for (size_t i = 0; i < record.error_codes.size(); ++i) {
+      AppendFixed32(static_cast<uint32>(record.error_codes[i]), out);
+      AppendFixed32(record.error_messages[i].size(), out);
+      out->append(record.error_messages[i]);
+    }
+    uint32 frame_size = out->size() - start - sizeof(uint32);
+    for (int i = 0; i < 4; ++i) {
+      (*out)[start + i] = static_cast<char>((frame_size >> (8 * i)) & 0xff);
+    }
+    return;
+  }
+
+  if (!scratch_req_.ParseFromString(record.serialized_req)) {
+    LOG(ERROR) << "Failed to parse a queued write request for node "
+               << record.node_id << ". Did not log anything!";
+    return;
+  }
+  std::string ts = absl::FormatTime("%Y-%m-%d %H:%M:%E6S", record.timestamp,
+                                    absl::LocalTimeZone());
+  for (int i = 0; i < scratch_req_.updates_size(); ++i) {
+    absl::StrAppend(out, ts, ";", record.node_id, ";",
+                    scratch_req_.updates(i).ShortDebugString(), ";",
+                    record.error_messages[i], "\n");
+  }
+}
+
+::util::Status WriteRequestLogger::MaybeOpenOrRotate(size_t size) {
+  if (fd_ >= 0 && file_size_ > 0) {
+    bool rotate =
+        (options_.max_file_size > 0 &&
+         file_size_ + size > options_.max_file_size) ||
+        (options_.max_file_age > absl::ZeroDuration() &&
+         absl::Now() - file_opened_at_ >= options_.max_file_age);
+    if (rotate) {
+      close(fd_);
+      fd_ = -1;
+      for (int i = options_.max_rotated_files - 1; i >= 1; --i) {
+        rename(absl::StrCat(options_.path, ".", i).c_str(),
+               absl::StrCat(options_.path, ".", i + 1).c_str());
+      }
+      if (options_.max_rotated_files > 0) {
+        rename(options_.path.c_str(),
+               absl::StrCat(options_.path, ".1").c_str());
+      } else {
+        unlink(options_.path.c_str());
+      }
+      num_rotations_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (fd_ < 0) {
+    fd_ = open(options_.path.c_str(),
+               O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      return MAKE_ERROR(ERR_INTERNAL).without_logging()
+             << "Failed to open " << options_.path << ": " << strerror(errno)
+             << ".";
+    }
+    struct stat st;
+    file_size_ = fstat(fd_, &st) == 0 ? st.st_size : 0;
+    file_opened_at_ = absl::Now();
+  }
+  return ::util::OkStatus();
+}
+
+void WriteRequestLogger::WakeUpWriter() {
+  absl::MutexLock l(&lock_);
+  writer_cond_.Signal();
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_COMMON_WRITE_REQUEST_LOGGER_H_
+#define STRATUM_HAL_LIB_COMMON_WRITE_REQUEST_LOGGER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+
+// The "WriteRequestLogger" class keeps the audit log of all the P4Runtime
+// write requests and their per-update results off the RPC critical path.
+// RPC threads only serialize the request into a preallocated slot of a bounded
+// lock-free ring. A background thread drains the ring, formats the records and
+// appends them in batches (writev) to a file it keeps open. The file is
+// rotated once it grows beyond a max size or gets older than a max age. If the
+// ring is full the record is dropped and accounted for in the stats, so a slow
+// file system never blocks a Write RPC.
+//
+// Two record formats are supported:
+// - Text (default): one line per update with the following format:
+//   <timestamp>;<node_id>;<update proto>;<status>
+// - Binary: one frame per write request. All integers are little endian:
+//   <fixed32 frame size (excluding itself)><fixed64 timestamp usec>
+//   <fixed64 node_id><fixed32 request size><serialized WriteRequest>
+//   <fixed32 num results>{<fixed32 error code><fixed32 size><error message>}*
+//   Use DecodeBinaryRecords() to read the file back.
+class WriteRequestLogger {
+ public:
+  struct Options {
+    Options()
+        : path(),
+          queue_size(4096),
+          max_batch_size(256),
+          flush_interval(absl::Milliseconds(100)),
+          max_file_size(0),
+          max_file_age(absl::ZeroDuration()),
+          max_rotated_files(3),
+          binary(false) {}
+    // The log file path. Logging is disabled if empty.
+    std::string path;
+    // Number of write requests that can be queued before records are dropped.
+    // Rounded up to the next power of 2.
+    size_t queue_size;
+    // Max number of write requests written by a single writev.
+    size_t max_batch_size;
+    // Max time a queued record waits before it is written to the file.
+    absl::Duration flush_interval;
+    // The file is rotated once it grows beyond this size. 0 disables size
+    // based rotation.
+    uint64 max_file_size;
+    // The file is rotated once it was opened for longer than this. Zero
+    // disables time based rotation.
+    absl::Duration max_file_age;
+    // Number of rotated files (<path>.1 ... <path>.N) kept around.
+    int max_rotated_files;
+    // If true, the compact binary record format is used.
+    bool binary;
+  };
+
+  // A decoded binary record.
+  struct Record {
+    absl::Time timestamp;
+    uint64 node_id;
+    ::p4::v1::WriteRequest req;
+    std::vector<::util::Status> results;
+  };
+
+  virtual ~WriteRequestLogger();
+
+  // Queues the given write request and its per-update results to be logged.
+  // Never blocks on I/O. Returns false if the record was dropped because the
+  // queue was full, or if logging is disabled.
+  bool LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
+                       const std::vector<::util::Status>& results,
+                       absl::Time timestamp);
+
+  // Blocks until all the records queued before the call are written to the
+  // file (or dropped because of a write error).
+  void Flush() LOCKS_EXCLUDED(lock_);
+
+  // Returns the logger stats as string. It also dumps the string to stdout.
+  std::string DumpStats() const;
+
+  // Returns the number of records dropped so far because the queue was full.
+  uint64 NumDroppedRecords() const {
+    return num_dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Returns true if logging is enabled, i.e. a log file path is given.
+  bool IsEnabled() const { return !options_.path.empty(); }
+
+  // Parses the content of a binary log file.
+  static ::util::Status DecodeBinaryRecords(const std::string& data,
+                                            std::vector<Record>* records);
+
+  // Factory function for creating the instance of the class. Starts the
+  // background writer thread if logging is enabled.
+  static std::unique_ptr<WriteRequestLogger> CreateInstance(
+      const Options& options);
+
+  // WriteRequestLogger is neither copyable nor movable.
+  WriteRequestLogger(const WriteRequestLogger&) = delete;
+  WriteRequestLogger& operator=(const WriteRequestLogger&) = delete;
+
+ private:
+  // A preallocated slot in the ring. seq implements the bounded MPSC queue
+  // from D. Vyukov: a slot at position pos is free for the producer when
+  // seq == pos and ready for the consumer when seq == pos + 1.
+  struct Slot {
+    std::atomic<uint64> seq;
+    absl::Time timestamp;
+    uint64 node_id;
+    std::string serialized_req;
+    std::vector<int> error_codes;
+    std::vector<std::string> error_messages;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  explicit WriteRequestLogger(const Options& options);
+
+  // Body of the background writer thread.
+  void WriterThread() LOCKS_EXCLUDED(lock_);
+
+  // Pops up to max_batch_size records into batch_. Returns the number of
+  // records popped. Called by the writer thread only.
+  size_t PopBatch();
+
+  // Formats the records in batch_ and writes them to the file. Called by the
+  // writer thread only.
+  void WriteBatch(size_t num_records);
+
+  // Appends the given record to out in the configured format.
+  void FormatRecord(const Slot& record, std::string* out);
+
+  // Opens the log file if it is not open, and rotates it if needed before
+  // writing size more bytes. Called by the writer thread only.
+  ::util::Status MaybeOpenOrRotate(size_t size);
+
+  // Wakes up the writer thread if it is idle.
+  void WakeUpWriter() LOCKS_EXCLUDED(lock_);
+
+  const Options options_;
+
+  // The ring of queue_size_ preallocated slots. queue_size_ is a power of 2.
+  const size_t queue_size_;
+  std::unique_ptr<Slot[]> slots_;
+  // Next position to be claimed by a producer.
+  std::atomic<uint64> enqueue_pos_;
+  // Next position to be consumed by the writer thread. Only accessed by the
+  // writer thread.
+  uint64 dequeue_pos_;
+
+  // Records swapped out of the ring by the writer thread. Swapping keeps the
+  // buffers of the slots allocated across records.
+  std::unique_ptr<Slot[]> batch_;
+  // Scratch buffers used by the writer thread.
+  ::p4::v1::WriteRequest scratch_req_;
+  std::vector<std::string> buffers_;
+
+  // Log file state. Only accessed by the writer thread.
+  int fd_;
+  uint64 file_size_;
+  absl::Time file_opened_at_;
+
+  // Stats.
+  std::atomic<uint64> num_logged_;
+  std::atomic<uint64> num_dropped_;
+  std::atomic<uint64> num_bytes_written_;
+  std::atomic<uint64> num_write_errors_;
+  std::atomic<uint64> num_rotations_;
+  std::atomic<uint64> num_batches_;
+
+  // Mutex protecting the writer thread wake up and flush state.
+  mutable absl::Mutex lock_;
+  absl::CondVar writer_cond_;
+  absl::CondVar flush_cond_;
+  // True while the writer thread is waiting for new records.
+  std::atomic<bool> writer_idle_;
+  // Number of records processed (written or failed) by the writer thread.
+  uint64 num_processed_ GUARDED_BY(lock_);
+  // Number of pending Flush() calls.
+  int num_flush_requests_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+
+  std::thread writer_thread_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_WRITE_REQUEST_LOGGER_H_
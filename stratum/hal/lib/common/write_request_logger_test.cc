@@ -0,0 +1,189 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/common/write_request_logger.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using test_utils::EqualsProto;
+using ::testing::HasSubstr;
+
+class WriteRequestLoggerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    options_.path = FLAGS_test_tmpdir + "/write_req_log_test.log";
+    for (const auto& path : {options_.path, options_.path + ".1",
+                             options_.path + ".2"}) {
+      if (PathExists(path)) ASSERT_OK(RemoveFile(path));
+    }
+    req_.set_device_id(kNodeId);
+    req_.add_updates()->set_type(::p4::v1::Update::INSERT);
+    req_.add_updates()->set_type(::p4::v1::Update::DELETE);
+    req_.mutable_updates(1)->mutable_entity()->mutable_table_entry()
+        ->set_table_id(kTableId);
+    results_ = {::util::OkStatus(),
+                ::util::Status(StratumErrorSpace(), ERR_ENTRY_NOT_FOUND,
+                               kErrorMsg)};
+  }
+
+  static constexpr uint64 kNodeId = 123;
+  static constexpr uint32 kTableId = 456;
+  static constexpr char kErrorMsg[] = "Some error";
+  WriteRequestLogger::Options options_;
+  ::p4::v1::WriteRequest req_;
+  std::vector<::util::Status> results_;
+};
+
+constexpr uint64 WriteRequestLoggerTest::kNodeId;
+constexpr uint32 WriteRequestLoggerTest::kTableId;
+constexpr char WriteRequestLoggerTest::kErrorMsg[];
+
+TEST_F(WriteRequestLoggerTest, TextFormat) {
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  ASSERT_TRUE(logger->IsEnabled());
+  EXPECT_TRUE(logger->LogWriteRequest(kNodeId, req_, results_, absl::Now()));
+  EXPECT_TRUE(logger->LogWriteRequest(kNodeId, req_, results_, absl::Now()));
+  logger->Flush();
+
+  std::string s;
+  ASSERT_OK(ReadFileToString(options_.path, &s));
+  std::vector<std::string> lines = absl::StrSplit(s, '\n', absl::SkipEmpty());
+  ASSERT_EQ(4, lines.size());
+  EXPECT_THAT(lines[0], HasSubstr(req_.updates(0).ShortDebugString()));
+  EXPECT_THAT(lines[1], HasSubstr(req_.updates(1).ShortDebugString()));
+  EXPECT_THAT(lines[1], HasSubstr(absl::StrCat(";", kNodeId, ";")));
+  EXPECT_THAT(lines[1], HasSubstr(kErrorMsg));
+  EXPECT_EQ(0, logger->NumDroppedRecords());
+}
+
+TEST_F(WriteRequestLoggerTest, BinaryFormat) {
+  options_.binary = true;
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  absl::Time timestamp = absl::FromUnixMicros(absl::ToUnixMicros(absl::Now()));
+  EXPECT_TRUE(logger->LogWriteRequest(kNodeId, req_, results_, timestamp));
+  EXPECT_TRUE(logger->LogWriteRequest(kNodeId + 1, req_, results_, timestamp));
+  logger->Flush();
+
+  std::string s;
+  ASSERT_OK(ReadFileToString(options_.path, &s));
+  std::vector<WriteRequestLogger::Record> records;
+  ASSERT_OK(WriteRequestLogger::DecodeBinaryRecords(s, &records));
+  ASSERT_EQ(2, records.size());
+  EXPECT_EQ(kNodeId, records[0].node_id);
+  EXPECT_EQ(kNodeId + 1, records[1].node_id);
+  for (const auto& record : records) {
+    EXPECT_EQ(timestamp, record.timestamp);
+    EXPECT_THAT(record.req, EqualsProto(req_));
+    ASSERT_EQ(2, record.results.size());
+    EXPECT_TRUE(record.results[0].ok());
+    EXPECT_EQ(ERR_ENTRY_NOT_FOUND, record.results[1].error_code());
+    EXPECT_EQ(kErrorMsg, record.results[1].error_message());
+  }
+
+  // Truncated data is rejected.
+  EXPECT_FALSE(WriteRequestLogger::DecodeBinaryRecords(
+                   s.substr(0, s.size() - 1), &records)
+                   .ok());
+}
+
+TEST_F(WriteRequestLoggerTest, SizeBasedRotation) {
+  options_.max_file_size = 1;
+  options_.max_rotated_files = 1;
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(logger->LogWriteRequest(kNodeId + i, req_, results_,
+                                        absl::Now()));
+    logger->Flush();
+  }
+
+  // The first record was rotated out, the second is in the rotated file and the
+  // last one is in the current file.
+  std::string s;
+  ASSERT_OK(ReadFileToString(options_.path, &s));
+  EXPECT_THAT(s, HasSubstr(absl::StrCat(";", kNodeId + 2, ";")));
+  ASSERT_OK(ReadFileToString(options_.path + ".1", &s));
+  EXPECT_THAT(s, HasSubstr(absl::StrCat(";", kNodeId + 1, ";")));
+  EXPECT_FALSE(PathExists(options_.path + ".2"));
+  EXPECT_THAT(logger->DumpStats(), HasSubstr("rotations: 2"));
+}
+
+TEST_F(WriteRequestLoggerTest, DropsWhenQueueIsFull) {
+  // Opening a FIFO for write blocks until there is a reader, which keeps the
+  // writer thread busy while we fill up the queue.
+  ASSERT_EQ(0, mkfifo(options_.path.c_str(), 0644));
+  options_.queue_size = 2;
+  options_.max_batch_size = 1;
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  constexpr int kNumRequests = 10;
+  int num_logged = 0;
+  for (int i = 0; i < kNumRequests; ++i) {
+    if (logger->LogWriteRequest(kNodeId, req_, results_, absl::Now())) {
+      ++num_logged;
+    }
+  }
+  // At most one batch held by the writer thread plus a full queue.
+  EXPECT_LE(num_logged, 3);
+  EXPECT_EQ(kNumRequests - num_logged, logger->NumDroppedRecords());
+  EXPECT_THAT(logger->DumpStats(),
+              HasSubstr(absl::StrCat("dropped: ", kNumRequests - num_logged)));
+
+  // Unblock the writer thread.
+  int fd = open(options_.path.c_str(), O_RDONLY | O_NONBLOCK);
+  ASSERT_GE(fd, 0);
+  logger->Flush();
+  logger.reset();
+  close(fd);
+  ASSERT_OK(RemoveFile(options_.path));
+}
+
+TEST_F(WriteRequestLoggerTest, DisabledWithoutPath) {
+  options_.path.clear();
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  EXPECT_FALSE(logger->IsEnabled());
+  EXPECT_FALSE(logger->LogWriteRequest(kNodeId, req_, results_, absl::Now()));
+  logger->Flush();
+}
+
+TEST_F(WriteRequestLoggerTest, RejectsMismatchedResults) {
+  auto logger = WriteRequestLogger::CreateInstance(options_);
+  results_.pop_back();
+  EXPECT_FALSE(logger->LogWriteRequest(kNodeId, req_, results_, absl::Now()));
+  logger->Flush();
+  EXPECT_FALSE(PathExists(options_.path));
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -19,6 +19,8 @@
 #ifndef STRATUM_HAL_LIB_COMMON_WRITER_INTERFACE_H_
 #define STRATUM_HAL_LIB_COMMON_WRITER_INTERFACE_H_
 
+#include <vector>
+
 namespace stratum {
 namespace hal {
 
@@ -33,6 +35,17 @@ class WriterInterface {
   // Blocking Write() operation which passes a message of type T into the
   // underlying transfer mechanism.
   virtual bool Write(const T& msg) = 0;
+  // Blocking Write() operation for a batch of messages, used by the producers
+  // which naturally generate messages in batches (e.g. packet RX). Stops and
+  // returns false on the first failed write. The default implementation calls
+  // Write() for each message, underlying transfer mechanisms that can do
+  // better may override it.
+  virtual bool WriteBatch(const std::vector<T>& msgs) {
+    for (const auto& msg : msgs) {
+      if (!Write(msg)) return false;
+    }
+    return true;
+  }
 
  protected:
   // Default constructor. To be called by the Mock class instance only.
@@ -15,22 +15,68 @@
 
 #include "stratum/hal/lib/common/yang_parse_tree.h"
 
+#include <algorithm>
+#include <functional>
 #include <list>
+#include <memory>
 #include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
 #include "grpcpp/grpcpp.h"
 #include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/data_request_batch.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
 
+DEFINE_int32(gnmi_port_counters_cache_ttl_ms, 250,
+             "Max age of the port counters served from the cache shared by "
+             "all the counter leaves of a port. Should be shorter than the "
+             "shortest sample interval used by the gNMI clients. 0 disables "
+             "the cache.");
+
 namespace stratum {
 namespace hal {
 
+constexpr uint32 PathElemInterner::kUnknownId;
+
+uint32 PathElemInterner::Intern(const std::string& name) {
+  {
+    absl::ReaderMutexLock l(&lock_);
+    auto it = name_to_id_.find(name);
+    if (it != name_to_id_.end()) return it->second;
+  }
+  absl::WriterMutexLock l(&lock_);
+  // kUnknownId is never assigned.
+  uint32 id = static_cast<uint32>(name_to_id_.size()) + 1;
+  return name_to_id_.emplace(name, id).first->second;
+}
+
+uint32 PathElemInterner::Find(const std::string& name) const {
+  absl::ReaderMutexLock l(&lock_);
+  auto it = name_to_id_.find(name);
+  return it != name_to_id_.end() ? it->second : kUnknownId;
+}
+
+PathElemInterner* PathElemInterner::GetInstance() {
+  static PathElemInterner* instance = new PathElemInterner();
+  return instance;
+}
+
+namespace {
+
+bool ChildIndexLess(const std::pair<uint32, TreeNode*>& entry, uint32 id) {
+  return entry.first < id;
+}
+
+}  // namespace
+
 TreeNode::TreeNode(const TreeNode& src) {
   name_ = src.name_;
   // Deep-copy children.
@@ -41,6 +87,7 @@ void TreeNode::CopySubtree(const TreeNode& src) {
   // Copy the handlers.
   on_timer_handler_ = src.on_timer_handler_;
   on_poll_handler_ = src.on_poll_handler_;
+  on_poll_resolver_ = src.on_poll_resolver_;
   on_change_handler_ = src.on_change_handler_;
   on_update_handler_ = src.on_update_handler_;
   on_replace_handler_ = src.on_replace_handler_;
@@ -56,14 +103,38 @@ void TreeNode::CopySubtree(const TreeNode& src) {
   supports_on_delete_ = src.supports_on_delete_;
   // Copy flags.
   is_name_a_key_ = src.is_name_a_key_;
+  is_config_derived_ = src.is_config_derived_;
 
   // Deep-copy children.
   for (const auto& entry : src.children_) {
-    children_.emplace(entry.first, TreeNode(*this, entry.first));
-    children_[entry.first].CopySubtree(entry.second);
+    FindOrAddChild(entry.first, entry.second.is_name_a_key_)
+        ->CopySubtree(entry.second);
   }
 }
 
+const TreeNode* TreeNode::FindChildOrNull(const std::string& name) const {
+  uint32 id = PathElemInterner::GetInstance()->Find(name);
+  if (id == PathElemInterner::kUnknownId) return nullptr;
+  auto it = std::lower_bound(child_index_.begin(), child_index_.end(), id,
+                             ChildIndexLess);
+  if (it == child_index_.end() || it->first != id) return nullptr;
+  return it->second;
+}
+
+TreeNode* TreeNode::FindOrAddChild(const std::string& name,
+                                   bool is_name_a_key) {
+  uint32 id = PathElemInterner::GetInstance()->Intern(name);
+  auto it = std::lower_bound(child_index_.begin(), child_index_.end(), id,
+                             ChildIndexLess);
+  if (it != child_index_.end() && it->first == id) return it->second;
+  // This path is not supported yet. Let's add a node with default processing.
+  TreeNode* child =
+      &children_.emplace(name, TreeNode(*this, name, is_name_a_key))
+           .first->second;
+  child_index_.insert(it, std::make_pair(id, child));
+  return child;
+}
+
 ::util::Status TreeNode::VisitThisNodeAndItsChildren(
     const TreeNodeEventHandlerPtr& handler, const GnmiEvent& event,
     const ::gnmi::Path& path, GnmiSubscribeStream* stream) const {
@@ -75,6 +146,94 @@ void TreeNode::CopySubtree(const TreeNode& src) {
   return ::util::OkStatus();
 }
 
+namespace {
+
+// Calls 'visit' twice: first to collect the DataRequests of all the visited
+// leaves into a DataRequestBatch, and then to send the responses served from
+// the batch to 'stream'.
+::util::Status VisitBatched(
+    const std::function<::util::Status(GnmiSubscribeStream*)>& visit,
+    GnmiSubscribeStream* stream) {
+  DataRequestBatch batch;
+  {
+    // The responses built by the handlers in the collect phase carry default
+    // values and are dropped.
+    DataRequestBatch::Scope scope(&batch);
+    InlineGnmiSubscribeStream null_stream(
+        [](const ::gnmi::SubscribeResponse& /*resp*/) { return true; });
+    visit(&null_stream).IgnoreError();
+  }
+  batch.Dispatch();
+  DataRequestBatch::Scope scope(&batch);
+  return visit(stream);
+}
+
+}  // namespace
+
+::util::Status TreeNode::VisitThisNodeAndItsChildrenBatched(
+    const TreeNodeEventHandlerPtr& handler, const GnmiEvent& event,
+    GnmiSubscribeStream* stream) const {
+  // Nothing to batch for a single leaf. If a batch is already bound to this
+  // thread, this subtree is a part of a larger visit which does the batching.
+  if ((children_.empty() && !IsInWildcardSubtree()) ||
+      DataRequestBatch::GetCurrent() != nullptr) {
+    return VisitThisNodeAndItsChildren(handler, event, GetPath(), stream);
+  }
+  return VisitBatched(
+      [this, &handler, &event](GnmiSubscribeStream* s) {
+        return VisitThisNodeAndItsChildren(handler, event, GetPath(), s);
+      },
+      stream);
+}
+
+void TreeNode::CollectThisNodeAndItsChildren(
+    const TreeNodeEventHandlerPtr& handler,
+    const TreeNodeEventHandlerResolverPtr& resolver,
+    std::vector<std::pair<TreeNodeEventHandler, ::gnmi::Path>>* handlers)
+    const {
+  if (resolver != nullptr && this->*resolver != nullptr) {
+    handlers->emplace_back((this->*resolver)(), GetPath());
+  } else {
+    handlers->emplace_back(this->*handler, GetPath());
+  }
+  for (const auto& child : children_) {
+    child.second.CollectThisNodeAndItsChildren(handler, resolver, handlers);
+  }
+}
+
+GnmiEventHandler TreeNode::ResolveThisNodeAndItsChildren(
+    const TreeNodeEventHandlerPtr& handler,
+    const TreeNodeEventHandlerResolverPtr& resolver, bool batched) const {
+  auto handlers = std::make_shared<
+      std::vector<std::pair<TreeNodeEventHandler, ::gnmi::Path>>>();
+  CollectThisNodeAndItsChildren(handler, resolver, handlers.get());
+  // Nothing to batch for a single leaf.
+  batched = batched && (!children_.empty() || IsInWildcardSubtree());
+  return [handlers, batched](const GnmiEvent& event,
+                             GnmiSubscribeStream* stream) -> ::util::Status {
+    auto visit = [&handlers,
+                  &event](GnmiSubscribeStream* s) -> ::util::Status {
+      for (const auto& entry : *handlers) {
+        RETURN_IF_ERROR(entry.first(event, entry.second, s));
+      }
+      return ::util::OkStatus();
+    };
+    // If a batch is already bound to this thread, this subtree is a part of a
+    // larger visit which does the batching.
+    if (!batched || DataRequestBatch::GetCurrent() != nullptr) {
+      return visit(stream);
+    }
+    return VisitBatched(visit, stream);
+  };
+}
+
+bool TreeNode::IsInWildcardSubtree() const {
+  for (const TreeNode* node = this; node != nullptr; node = node->parent_) {
+    if (node->name_ == "*" || node->name_ == "...") return true;
+  }
+  return false;
+}
+
 ::util::Status TreeNode::RegisterThisNodeAndItsChildren(
     const EventHandlerRecordPtr& record) const {
   RETURN_IF_ERROR(this->on_change_registration_(record));
@@ -119,10 +278,10 @@ const TreeNode* TreeNode::FindNodeOrNull(const ::gnmi::Path& path) const {
   const TreeNode* node = this;
   for (; node != nullptr && !node->children_.empty() &&
          element < path.elem_size();) {
-    node = gtl::FindOrNull(node->children_, path.elem(element).name());
+    node = node->FindChildOrNull(path.elem(element).name());
     auto* search = gtl::FindOrNull(path.elem(element).key(), "name");
     if (search != nullptr && node != nullptr) {
-      node = gtl::FindOrNull(node->children_, *search);
+      node = node->FindChildOrNull(*search);
     }
     ++element;
   }
@@ -147,6 +306,14 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
     const ConfigHasBeenPushedEvent& change) {
   absl::WriterMutexLock r(&root_access_lock_);
 
+  // The set of ports may have changed.
+  port_counters_cache_.Clear();
+
+  // Only the subtrees whose inputs changed since the previous push are
+  // (re)built; the handlers of the other ones are already up to date. The
+  // subtrees of the entities removed from the config are kept, as before, as
+  // the subscriptions keep pointers to their nodes.
+
   // Translation from node ID to an object describing the node.
   absl::flat_hash_map<uint64, const Node*> node_id_to_node;
   for (const auto& node : change.new_config_.nodes()) {
@@ -168,7 +335,12 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
         node_id_to_node[singleton.node()]
             ? node_id_to_node[singleton.node()]->config_params()
             : empty_node_config;
-    AddSubtreeInterfaceFromSingleton(singleton, node_config);
+    if (UpdateSubtreeFingerprint(
+            absl::StrCat("interface:", singleton.name()),
+            absl::StrCat("singleton:", singleton.SerializeAsString(),
+                         node_config.SerializeAsString()))) {
+      AddSubtreeInterfaceFromSingleton(singleton, node_config);
+    }
     port_id_to_node_id[singleton.id()] = singleton.node();
     singleton_names.insert(singleton.name());
   }
@@ -179,7 +351,10 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
       return MAKE_ERROR(ERR_INVALID_PARAM) << "Duplicate optical port name: "
           << optical.name();
     }
-    AddSubtreeInterfaceFromOptical(optical);
+    if (UpdateSubtreeFingerprint(absl::StrCat("optical:", optical.name()),
+                                 optical.SerializeAsString())) {
+      AddSubtreeInterfaceFromOptical(optical);
+    }
     optical_names.insert(optical.name());
   }
 
@@ -198,12 +373,21 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
     const NodeConfigParams& node_config =
         node_id != kNodeIdUnknown ? node_id_to_node[node_id]->config_params()
                                   : empty_node_config;
-    AddSubtreeInterfaceFromTrunk(trunk.name(), node_id, trunk.id(),
-                                 node_config);
+    if (UpdateSubtreeFingerprint(
+            absl::StrCat("interface:", trunk.name()),
+            absl::StrCat("trunk:", node_id, ":", trunk.id(), ":",
+                         node_config.SerializeAsString()))) {
+      AddSubtreeInterfaceFromTrunk(trunk.name(), node_id, trunk.id(),
+                                   node_config);
+    }
     trunk_names.insert(trunk.name());
   }
   // Add all chassis-related gNMI paths.
-  AddSubtreeChassis(change.new_config_.chassis());
+  if (UpdateSubtreeFingerprint(
+          absl::StrCat("chassis:", change.new_config_.chassis().name()),
+          change.new_config_.chassis().SerializeAsString())) {
+    AddSubtreeChassis(change.new_config_.chassis());
+  }
   // Add all node-related gNMI paths.
   std::unordered_set<std::string> node_names;
   for (const auto& node : change.new_config_.nodes()) {
@@ -211,13 +395,24 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "Duplicate node name: " << node.name();
     }
-    AddSubtreeNode(node);
+    if (UpdateSubtreeFingerprint(absl::StrCat("node:", node.name()),
+                                 node.SerializeAsString())) {
+      AddSubtreeNode(node);
+    }
     node_names.insert(node.name());
   }
   AddRoot();
   return ::util::OkStatus();
 }
 
+bool YangParseTree::UpdateSubtreeFingerprint(const std::string& key,
+                                             const std::string& fingerprint) {
+  std::string& recorded = subtree_fingerprints_[key];
+  if (recorded == fingerprint) return false;
+  recorded = fingerprint;
+  return true;
+}
+
 bool YangParseTree::IsWildcard(const std::string& name) const {
   if (name.compare("*") == 0) return true;
   if (name.compare("...") == 0) return true;
@@ -249,8 +444,33 @@ bool YangParseTree::IsWildcard(const std::string& name) const {
   return ret;
 }
 
+TreeNodeEventHandler YangParseTree::ResolveOnPollForAllNonWildcardNodes(
+    const gnmi::Path& path, const gnmi::Path& subpath) const {
+  auto handlers = std::make_shared<std::vector<GnmiEventHandler>>();
+  ::util::Status status = PerformActionForAllNonWildcardNodes(
+      path, subpath, [&handlers](const TreeNode& leaf) {
+        handlers->push_back(leaf.ResolveOnPollHandler());
+        return ::util::OkStatus();
+      });
+  return [handlers, status](const GnmiEvent& event,
+                            const ::gnmi::Path& /*path*/,
+                            GnmiSubscribeStream* stream) {
+    ::util::Status ret = status;
+    for (const auto& handler : *handlers) {
+      APPEND_STATUS_IF_ERROR(ret, handler(event, stream));
+    }
+    // Notify the client that all nodes have been processed.
+    APPEND_STATUS_IF_ERROR(
+        ret, YangParseTreePaths::SendEndOfSeriesMessage(stream));
+    return ret;
+  };
+}
+
 YangParseTree::YangParseTree(SwitchInterface* switch_interface)
-    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)) {
+    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
+      port_counters_cache_(
+          switch_interface,
+          absl::Milliseconds(FLAGS_gnmi_port_counters_cache_ttl_ms)) {
   // Add the minimum nodes:
   //   /interfaces/interface[name=*]/state/ifindex
   //   /interfaces/interface[name=*]/state/name
@@ -267,29 +487,14 @@ TreeNode* YangParseTree::AddNode(const ::gnmi::Path& path) {
   // No need to lock the mutex - it is locked by method calling this one.
   TreeNode* node = &root_;
   for (const auto& element : path.elem()) {
-    TreeNode* child = gtl::FindOrNull(node->children_, element.name());
-    if (child == nullptr) {
-      // This path is not supported yet. Let's add a node with default
-      // processing.
-      node->children_.emplace(element.name(), TreeNode(*node, element.name()));
-      child = gtl::FindOrNull(node->children_, element.name());
-    }
-    node = child;
+    node = node->FindOrAddChild(element.name(), false);
     auto* search = gtl::FindOrNull(element.key(), "name");
     if (search == nullptr) {
       continue;
     }
 
     // A filtering pattern has been found!
-    child = gtl::FindOrNull(node->children_, *search);
-    if (child == nullptr) {
-      // This path is not supported yet. Let's add a node with default
-      // processing.
-      node->children_.emplace(
-          *search, TreeNode(*node, *search, true /* mark as a key */));
-      child = gtl::FindOrNull(node->children_, *search);
-    }
-    node = child;
+    node = node->FindOrAddChild(*search, true /* mark as a key */);
   }
   return node;
 }
@@ -23,12 +23,16 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "stratum/glue/integral_types.h"
 #include "stratum/lib/macros.h"
 #include "stratum/glue/status/status.h"
 #include "gnmi/gnmi.grpc.pb.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
+#include "stratum/hal/lib/common/port_counters_cache.h"
 #include "stratum/hal/lib/common/switch_interface.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "absl/synchronization/mutex.h"
@@ -45,6 +49,7 @@ class YangParseTreeTest;
 using TreeNodeEventHandler = std::function<::util::Status(
     const GnmiEvent& event, const ::gnmi::Path& path,
     GnmiSubscribeStream* stream)>;
+using TreeNodeEventHandlerResolver = std::function<TreeNodeEventHandler()>;
 using TreeNodeSetHandler = std::function<::util::Status(
     const ::gnmi::Path& path, const ::google::protobuf::Message& val,
     CopyOnWriteChassisConfig* config)>;
@@ -55,6 +60,34 @@ using EventHandlerRecordPtr = std::weak_ptr<EventHandlerRecord>;
 using TreeNodeEventRegistration =
     std::function<::util::Status(const EventHandlerRecordPtr& record)>;
 
+// Maps the names of the path elements (and the values of their 'name' keys) to
+// small integer IDs, so that the children of a TreeNode are looked up by
+// comparing integers instead of strings. A name that has never been interned
+// cannot match any node, so unknown paths are rejected with a single hash
+// lookup. The IDs are never released; the set of names is bounded by the
+// names used in the pushed configs.
+class PathElemInterner {
+ public:
+  // The ID returned by Find() for names that have never been interned.
+  static constexpr uint32 kUnknownId = 0;
+
+  // Returns the ID of 'name', assigning a new one if needed.
+  uint32 Intern(const std::string& name) LOCKS_EXCLUDED(lock_);
+
+  // Returns the ID of 'name' or kUnknownId if it has never been interned.
+  uint32 Find(const std::string& name) const LOCKS_EXCLUDED(lock_);
+
+  // This is a singleton shared by all the trees, so, the only way to
+  // create/access its instance is to call this method.
+  static PathElemInterner* GetInstance();
+
+ private:
+  PathElemInterner() {}
+
+  mutable absl::Mutex lock_;
+  absl::flat_hash_map<std::string, uint32> name_to_id_ GUARDED_BY(lock_);
+};
+
 // YANG model is conceptually a tree with each leaf representing a value that is
 // interesting from the point of view of the gNMI client. This class implements
 // nodes and leafs of that tree.
@@ -66,6 +99,9 @@ using TreeNodeEventRegistration =
 // its children and so on until the first unknown path element is found (and the
 // client is notified that such leaf is not supported) or the whole path is
 // processed (which means that the leaf is supported).
+// The children are owned by the 'children_' map, which keeps them at stable
+// addresses and in name order. The lookups go through 'child_index_', a vector
+// of interned name IDs sorted for binary search.
 class TreeNode {
  public:
   using SupportsOnPtr = bool TreeNode::*;
@@ -81,7 +117,8 @@ class TreeNode {
         supports_on_poll_(false),
         supports_on_update_(false),
         supports_on_replace_(false),
-        supports_on_delete_(false) {}
+        supports_on_delete_(false),
+        is_config_derived_(false) {}
   TreeNode(const TreeNode& parent, const std::string& name,
            bool is_name_a_key = false)
       : parent_(&parent),
@@ -92,7 +129,8 @@ class TreeNode {
         supports_on_poll_(false),
         supports_on_update_(false),
         supports_on_replace_(false),
-        supports_on_delete_(false) {}
+        supports_on_delete_(false),
+        is_config_derived_(false) {}
   TreeNode(const TreeNode& src);
 
   void CopySubtree(const TreeNode& src);
@@ -133,6 +171,22 @@ class TreeNode {
   // a poll event is processed with a user-specified one.
   TreeNode* SetOnPollHandler(const TreeNodeEventHandler& handler) {
     on_poll_handler_ = handler;
+    on_poll_resolver_ = nullptr;
+    supports_on_poll_ = true;
+    return this;
+  }
+
+  // Same as SetOnPollHandler() but the handler is returned by 'resolver'. Used
+  // by the nodes whose handlers walk the tree, e.g. the wildcard ones, so that
+  // ResolveOnPollHandler() can find the nodes to be polled while the tree does
+  // not change and the handler it returns does not walk the tree.
+  TreeNode* SetOnPollResolver(const TreeNodeEventHandlerResolver& resolver) {
+    on_poll_handler_ = [resolver](const GnmiEvent& event,
+                                  const ::gnmi::Path& path,
+                                  GnmiSubscribeStream* stream) {
+      return resolver()(event, path, stream);
+    };
+    on_poll_resolver_ = resolver;
     supports_on_poll_ = true;
     return this;
   }
@@ -159,9 +213,25 @@ class TreeNode {
     return this;
   }
 
+  // Marks this node as a leaf whose value is derived from the pushed chassis
+  // config only (e.g. a name, an ID or a config leaf), so that the value
+  // changes only when a new config is pushed or the leaf is set. The values of
+  // such leaves can be cached between these events.
+  TreeNode* SetIsConfigDerived() {
+    is_config_derived_ = true;
+    return this;
+  }
+
   // Returns a node that handles the YANG path starting from this node.
   const TreeNode* FindNodeOrNull(const ::gnmi::Path& path) const;
 
+  // Returns the child called 'name' or nullptr if there is no such child.
+  const TreeNode* FindChildOrNull(const std::string& name) const;
+
+  // Returns the child called 'name', adding it first if there is no such
+  // child.
+  TreeNode* FindOrAddChild(const std::string& name, bool is_name_a_key);
+
   // A generic method that checks if the subtree starting from this node
   // supports a particular type of events. The input parameter is a pointer to
   // the mameber variable that keeps information if this node supports the
@@ -217,6 +287,12 @@ class TreeNode {
     return AllSubtreeLeavesSupportOn(&TreeNode::supports_on_change_);
   }
 
+  // Returns true if the values of all the leaves in the subtree starting from
+  // this node are derived from the pushed chassis config only.
+  bool AllSubtreeLeavesAreConfigDerived() const {
+    return AllSubtreeLeavesSupportOn(&TreeNode::is_config_derived_);
+  }
+
   // Returns a functor that will execute handlers of this node.
   GnmiSetHandler GetOnUpdateHandler() const {
     return
@@ -245,8 +321,8 @@ class TreeNode {
   // Returns a functor that will execute handlers of this node and its children.
   GnmiEventHandler GetOnTimerHandler() const {
     return [this](const GnmiEvent& event, GnmiSubscribeStream* stream) {
-      return VisitThisNodeAndItsChildren(&TreeNode::on_timer_handler_, event,
-                                         this->GetPath(), stream);
+      return VisitThisNodeAndItsChildrenBatched(&TreeNode::on_timer_handler_,
+                                                event, stream);
     };
   }
 
@@ -261,11 +337,33 @@ class TreeNode {
   // Returns a functor that will execute handlers of this node and its children.
   GnmiEventHandler GetOnPollHandler() const {
     return [this](const GnmiEvent& event, GnmiSubscribeStream* stream) {
-      return VisitThisNodeAndItsChildren(&TreeNode::on_poll_handler_, event,
-                                         this->GetPath(), stream);
+      return VisitThisNodeAndItsChildrenBatched(&TreeNode::on_poll_handler_,
+                                                event, stream);
     };
   }
 
+  // Returns a functor that will execute copies of the handlers this node and
+  // its children have now. Unlike the functors returned by the Get*Handler()
+  // methods, it does not access the tree, so it can be called while the tree is
+  // being modified.
+  GnmiEventHandler ResolveOnTimerHandler() const {
+    return ResolveThisNodeAndItsChildren(&TreeNode::on_timer_handler_, nullptr,
+                                         /*batched=*/true);
+  }
+
+  // Same as ResolveOnTimerHandler() but for the on_change handlers.
+  GnmiEventHandler ResolveOnChangeHandler() const {
+    return ResolveThisNodeAndItsChildren(&TreeNode::on_change_handler_,
+                                         nullptr, /*batched=*/false);
+  }
+
+  // Same as ResolveOnTimerHandler() but for the on_poll handlers.
+  GnmiEventHandler ResolveOnPollHandler() const {
+    return ResolveThisNodeAndItsChildren(&TreeNode::on_poll_handler_,
+                                         &TreeNode::on_poll_resolver_,
+                                         /*batched=*/true);
+  }
+
   // Returns a functor that will register the on_change handler of this node for
   // the event type(s) that are handled by it.
   ::util::Status DoOnChangeRegistration(
@@ -292,6 +390,9 @@ class TreeNode {
 
  private:
   using TreeNodeEventHandlerPtr = TreeNodeEventHandler TreeNode::*;
+  using TreeNodeEventHandlerResolverPtr =
+      TreeNodeEventHandlerResolver TreeNode::*;
+  using ChildIndexEntry = std::pair<uint32, TreeNode*>;
 
   // Traverses the whole subtree starting from this node.
   // This method is used to visit all subtree nodes and execute handler functor
@@ -300,6 +401,31 @@ class TreeNode {
   ::util::Status VisitThisNodeAndItsChildren(
       const TreeNodeEventHandlerPtr& handler, const GnmiEvent& event,
       const ::gnmi::Path& path, GnmiSubscribeStream* stream) const;
+  // Same as VisitThisNodeAndItsChildren() but, when more than one leaf is
+  // visited, runs the handlers twice: first to collect the DataRequests of
+  // all the leaves into a DataRequestBatch, and then to send the responses
+  // served from the batch to 'stream'.
+  ::util::Status VisitThisNodeAndItsChildrenBatched(
+      const TreeNodeEventHandlerPtr& handler, const GnmiEvent& event,
+      GnmiSubscribeStream* stream) const;
+  // Returns a functor calling copies of the 'handler' of all the subtree nodes
+  // in the order VisitThisNodeAndItsChildren() visits them. The nodes that
+  // have the 'resolver' set contribute the handler it returns instead. If
+  // 'batched', the DataRequests are batched as in
+  // VisitThisNodeAndItsChildrenBatched().
+  GnmiEventHandler ResolveThisNodeAndItsChildren(
+      const TreeNodeEventHandlerPtr& handler,
+      const TreeNodeEventHandlerResolverPtr& resolver, bool batched) const;
+  // Appends the handlers called by the functor returned by
+  // ResolveThisNodeAndItsChildren(), together with the paths of their nodes, to
+  // 'handlers'.
+  void CollectThisNodeAndItsChildren(
+      const TreeNodeEventHandlerPtr& handler,
+      const TreeNodeEventHandlerResolverPtr& resolver,
+      std::vector<std::pair<TreeNodeEventHandler, ::gnmi::Path>>* handlers)
+      const;
+  // Returns true if this node is a wildcard key or lies below one.
+  bool IsInWildcardSubtree() const;
   // Traverses the whole subtree starting from this node.
   // This method is used to visit all subtree nodes and execute registration
   // functor - this implements the expected behavior when a client subscribes in
@@ -324,6 +450,9 @@ class TreeNode {
         // return OK so its children are processed.
         return ::util::OkStatus();
       };
+  // If set, returns the handler to be called instead of 'on_poll_handler_'
+  // when the handlers of the subtree are resolved.
+  TreeNodeEventHandlerResolver on_poll_resolver_;
   TreeNodeEventHandler on_change_handler_ =
       [](const GnmiEvent&, const ::gnmi::Path&, GnmiSubscribeStream*) {
         // Intermediate node. No real processing but needs to
@@ -369,6 +498,9 @@ class TreeNode {
   };
   const TreeNode* parent_;
   std::string name_;
+  // The interned name IDs of the children, sorted by ID. Always describes the
+  // same nodes as 'children_'.
+  std::vector<ChildIndexEntry> child_index_;
   // Some nodes are mapped to ::gnmi::PathElem 'name' key value. This variable
   // is used to mark them as such.
   bool is_name_a_key_ = false;
@@ -378,6 +510,9 @@ class TreeNode {
   bool supports_on_update_;
   bool supports_on_replace_;
   bool supports_on_delete_;
+  // Set if the value of this leaf changes only when a new chassis config is
+  // pushed or the leaf is set. See SetIsConfigDerived().
+  bool is_config_derived_;
 
   friend class stratum::hal::YangParseTreeTest;
   friend class stratum::hal::SubscriptionTestBase;
@@ -456,6 +591,10 @@ class YangParseTree {
     return switch_interface_;
   }
 
+  // Returns the cache shared by all the port counter leaves. The cache is
+  // thread-safe and does not change during the lifetime of the tree.
+  PortCountersCache* GetPortCountersCache() { return &port_counters_cache_; }
+
   // A getter providing a functor setting TARGET_DEFINED mode of a leaf to be
   // STREAM:SAMPLE.
   const TreeNode::TargetDefinedModeFunc& GetStreamSampleModeFunc() {
@@ -488,6 +627,13 @@ class YangParseTree {
   // stored in the parse tree the same way as the regular ones.
   bool IsWildcard(const std::string& name) const;
 
+  // Records 'fingerprint' as the inputs the subtree called 'key' is built from.
+  // Returns false if the subtree has already been built from the same inputs,
+  // i.e. it does not have to be rebuilt.
+  bool UpdateSubtreeFingerprint(const std::string& key,
+                                const std::string& fingerprint)
+      EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
+
   // A helper function. Finds a node specified by 'path' and then for all
   // non-wildcard children finds leaf specified by 'subpath' and executes
   // 'action' on that leaf.
@@ -496,6 +642,14 @@ class YangParseTree {
       const std::function<::util::Status(const TreeNode& leaf)>& action) const
       EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
 
+  // Returns an on_poll handler polling all the leaves found as in
+  // PerformActionForAllNonWildcardNodes() and then sending the end-of-series
+  // message. The leaves are looked up now, so the handler does not walk the
+  // tree.
+  TreeNodeEventHandler ResolveOnPollForAllNonWildcardNodes(
+      const gnmi::Path& path, const gnmi::Path& subpath) const
+      EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
+
   SwitchInterface* switch_interface_ GUARDED_BY(root_access_lock_);
 
   // A channel between YangParseTree object and GnmiPublisher objest.
@@ -507,6 +661,16 @@ class YangParseTree {
   // A Mutex used to guard access to the root.
   mutable absl::Mutex root_access_lock_;
 
+  // The inputs (serialized config messages) each interface, node and chassis
+  // subtree was last built from, keyed by the kind and the name of the
+  // subtree. A config push rebuilds only the subtrees whose inputs changed.
+  absl::flat_hash_map<std::string, std::string> subtree_fingerprints_
+      GUARDED_BY(root_access_lock_);
+
+  // The last counters read for each port, shared by all the counter leaves of
+  // the port so that a sample of all the leaves reads the counters only once.
+  PortCountersCache port_counters_cache_;
+
   // In most cases the TARGET_DEFINED mode is ON_CHANGE mode as this mode
   // is the least resource-hungry. But to make the gNMI demo more realistic it
   // is changed to SAMPLE with the period of 1s.
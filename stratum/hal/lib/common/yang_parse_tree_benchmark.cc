@@ -0,0 +1,162 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// This binary measures the YangParseTree path lookup rate and the time needed
+// to apply a pushed ChassisConfig to the tree. The config has one node and
+// --num_ports singleton ports. The following pushes are timed:
+//   - the first push, which builds the subtrees of all the ports,
+//   - a push of the same config, which has nothing to rebuild,
+//   - a push where the speed of one port changed.
+// Example:
+//   yang_parse_tree_benchmark --num_ports=512 --num_lookups=1000000
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
+#include "stratum/hal/lib/common/gnmi_publisher.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/hal/lib/common/yang_parse_tree.h"
+#include "stratum/lib/constants.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_int32(num_ports, 512, "Number of singleton ports in the config.");
+DEFINE_int32(num_queues, 4, "Number of egress queues of each port.");
+DEFINE_int32(num_lookups, 1000000, "Number of path lookups to time.");
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+constexpr uint64 kNodeId = 1;
+
+// Builds a single-node config with 'num_ports' singleton ports and
+// 'num_queues' queues per port.
+ChassisConfig BuildConfig(int num_ports, int num_queues) {
+  ChassisConfig config;
+  config.set_description("YangParseTree benchmark config.");
+  config.mutable_chassis()->set_platform(PLT_GENERIC_TOMAHAWK);
+  config.mutable_chassis()->set_name("chassis-1");
+  auto* node = config.add_nodes();
+  node->set_id(kNodeId);
+  node->set_name("node-1");
+  node->set_slot(1);
+  auto* qos_config = node->mutable_config_params()->mutable_qos_config();
+  // Queue 'q' carries traffic class BE1 + q.
+  for (int q = 0; q < num_queues; ++q) {
+    auto* tc_mapping = qos_config->add_traffic_class_mapping();
+    tc_mapping->set_internal_priority(q);
+    tc_mapping->set_traffic_class(static_cast<TrafficClass>(BE1 + q));
+    auto* cosq_mapping = qos_config->add_cosq_mapping();
+    cosq_mapping->set_internal_priority(q);
+    cosq_mapping->set_q_num(q);
+  }
+  for (int i = 0; i < num_ports; ++i) {
+    auto* singleton = config.add_singleton_ports();
+    singleton->set_id(i + 1);
+    singleton->set_name(absl::StrCat("xe-1/", i / 4 + 1, "/", i % 4 + 1));
+    singleton->set_slot(1);
+    singleton->set_port(i / 4 + 1);
+    singleton->set_channel(i % 4 + 1);
+    singleton->set_speed_bps(kTwentyFiveGigBps);
+    singleton->set_node(kNodeId);
+    singleton->mutable_config_params()->set_admin_state(ADMIN_STATE_ENABLED);
+  }
+
+  return config;
+}
+
+// Pushes 'config' to 'tree' and returns the time it took.
+::util::StatusOr<absl::Duration> TimePush(const ChassisConfig& config,
+                                          YangParseTree* tree) {
+  absl::Time start = absl::Now();
+  RETURN_IF_ERROR(tree->ProcessPushedConfig(ConfigHasBeenPushedEvent(config)));
+  return absl::Now() - start;
+}
+
+}  // namespace
+
+::util::Status Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  InitStratumLogging();
+
+  SwitchMock switch_mock;
+  YangParseTree tree(&switch_mock);
+  ChassisConfig config = BuildConfig(FLAGS_num_ports, FLAGS_num_queues);
+
+  ASSIGN_OR_RETURN(absl::Duration first_push, TimePush(config, &tree));
+  ASSIGN_OR_RETURN(absl::Duration same_push, TimePush(config, &tree));
+  config.mutable_singleton_ports(0)->set_speed_bps(kHundredGigBps);
+  ASSIGN_OR_RETURN(absl::Duration one_port_push, TimePush(config, &tree));
+  LOG(INFO) << "Config push with " << FLAGS_num_ports << " ports: first push "
+            << first_push << ", same config " << same_push
+            << ", one port changed " << one_port_push << ".";
+
+  // A mix of leaves found in each port subtree and of unknown paths.
+  std::vector<::gnmi::Path> paths;
+  for (const auto& singleton : config.singleton_ports()) {
+    const std::string& name = singleton.name();
+    paths.push_back(GetPath("interfaces")(
+        "interface", name)("state")("counters")("in-octets")());
+    paths.push_back(GetPath("interfaces")(
+        "interface", name)("ethernet")("config")("port-speed")());
+    paths.push_back(GetPath("qos")("interfaces")("interface", name)(
+        "output")("queues")("queue", "BE1")("state")("transmit-pkts")());
+    paths.push_back(GetPath("interfaces")(
+        "interface", absl::StrCat(name, "-unknown"))("state")("name")());
+  }
+  int num_found = 0;
+  for (const auto& path : paths) {
+    if (tree.FindNodeOrNull(path) != nullptr) ++num_found;
+  }
+  CHECK_RETURN_IF_FALSE(num_found == FLAGS_num_ports * 3)
+      << "Found " << num_found << " of " << FLAGS_num_ports * 3 << " leaves.";
+
+  absl::Time start = absl::Now();
+  for (int i = 0; i < FLAGS_num_lookups; ++i) {
+    tree.FindNodeOrNull(paths[i % paths.size()]);
+  }
+  double secs = absl::ToDoubleSeconds(absl::Now() - start);
+  LOG(INFO) << "Looked up " << FLAGS_num_lookups << " paths in " << secs
+            << " secs (" << (secs > 0 ? FLAGS_num_lookups / secs : 0)
+            << " lookups/sec).";
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::util::Status status = stratum::hal::Main(argc, argv);
+  if (status.ok()) {
+    return 0;
+  } else {
+    LOG(ERROR) << status;
+    return 1;
+  }
+}
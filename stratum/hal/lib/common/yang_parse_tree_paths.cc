@@ -23,6 +23,7 @@
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/hal/lib/common/constants.h"
+#include "stratum/hal/lib/common/data_request_batch.h"
 #include "stratum/hal/lib/common/openconfig_converter.h"
 #include "stratum/lib/constants.h"
 #include "absl/container/flat_hash_map.h"
@@ -218,6 +219,8 @@ TreeNodeSetHandler GetOnUpdateFunctor(
 // - a pointer to method that returns a pointer to mutable DataRequest
 //   ('data_request_get_mutable_inner_message_func'); it is needed to build the
 //   data retrieval request.
+// The call goes through DataRequestBatch, so the requests of all the leaves of
+// a polled subtree reach the switch in one DataRequest per node.
 
 // Port-specific version. Extra parameters needed:
 // - node ID ('node_id')
@@ -251,8 +254,8 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                  &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -292,8 +295,8 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                  &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -327,8 +330,8 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+  DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), /* node_id= */ 0,
+                                  req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -363,8 +366,8 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                  &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -408,8 +411,8 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                  &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -820,7 +823,8 @@ void SetUpInterfacesInterfaceStateIfindex(uint32 port_id, TreeNode* node) {
                                    GnmiSubscribeStream* stream) {
         return SendResponse(GetResponse(path, port_id), stream);
       })
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -838,7 +842,8 @@ void SetUpInterfacesInterfaceStateName(const std::string& name,
                                 GnmiSubscribeStream* stream) {
         return SendResponse(GetResponse(path, name), stream);
       })
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -909,8 +914,8 @@ void SetUpInterfacesInterfaceStateHardwarePort(uint64 node_id, uint32 port_id,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                    &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -1010,7 +1015,8 @@ void SetUpInterfacesInterfaceConfigHealthIndicator(const std::string& state,
       ->SetOnChangeRegistration(register_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1078,7 +1084,8 @@ void SetUpInterfacesInterfaceConfigEnabled(const bool state,
       ->SetOnUpdateHandler(on_set_functor)
       ->SetOnReplaceHandler(on_set_functor)
       ->SetOnChangeRegistration(register_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1197,7 +1204,8 @@ void SetUpInterfacesInterfaceEthernetConfigMacAddress(uint64 node_id,
       ->SetOnPollHandler(poll_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1270,7 +1278,8 @@ void SetUpInterfacesInterfaceEthernetConfigPortSpeed(uint64 node_id,
       ->SetOnUpdateHandler(on_set_functor)
       ->SetOnReplaceHandler(on_set_functor)
       ->SetOnChangeRegistration(register_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1338,7 +1347,8 @@ void SetUpInterfacesInterfaceEthernetConfigAutoNegotiate(uint64 node_id,
   node->SetOnTimerHandler(poll_functor)
       ->SetOnPollHandler(poll_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1391,7 +1401,8 @@ void SetUpInterfacesInterfaceEthernetConfigForwardingViability(uint64 node_id,
       ->SetOnPollHandler(poll_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1506,26 +1517,14 @@ TreeNodeEventHandler GetPollCounterFunctor(
   return [tree, node_id, port_id, func_ptr](const GnmiEvent& event,
                                             const ::gnmi::Path& path,
                                             GnmiSubscribeStream* stream) {
-    // Create a data retrieval request.
-    DataRequest req;
-    auto* request = req.add_requests()->mutable_port_counters();
-    request->set_node_id(node_id);
-    request->set_port_id(port_id);
-
-    // In-place definition of method retrieving data from generic response
-    // and saving into 'resp' local variable.
+    // All the counter leaves of a port are served from the same snapshot of
+    // the port counters, which is read from the switch at most once per TTL.
     uint64 resp = 0;
-    DataResponseWriter writer(
-        [&resp, func_ptr](const DataResponse& in) -> bool {
-          if (!in.has_port_counters()) return false;
-          resp = (in.port_counters().*func_ptr)();
-          return true;
-        });
-    // Query the switch. The returned status is ignored as there is no way to
-    // notify the controller that something went wrong. The error is logged when
-    // it is created.
-    auto status = tree->GetSwitchInterface()->RetrieveValue(
-        node_id, req, &writer, /* details= */ nullptr);
+    auto counters =
+        tree->GetPortCountersCache()->GetPortCounters(node_id, port_id);
+    // An error is ignored as there is no way to notify the controller that
+    // something went wrong. The error is logged when it is created.
+    if (counters.ok()) resp = (counters.ValueOrDie().*func_ptr)();
     return SendResponse(GetResponse(path, resp), stream);
   };
 }
@@ -1914,8 +1913,9 @@ void SetUpComponentsComponentChassisAlarmsMemoryErrorInfo(TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+    DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(),
+                                    /* node_id= */ 0, req, &writer,
+                                    /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2017,8 +2017,9 @@ void SetUpComponentsComponentChassisAlarmsFlowProgrammingExceptionInfo(
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+    DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(),
+                                    /* node_id= */ 0, req, &writer,
+                                    /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2091,8 +2092,8 @@ void SetUpComponentsComponentTransceiverStateSerialNo(
         // Query the switch. The returned status is ignored as there is no
         // way to notify the controller that something went wrong.
         // The error is logged when it is created.
-        tree->GetSwitchInterface()
-            ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+        DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id,
+                                        req, &writer, /* details= */ nullptr)
             .IgnoreError();
         return SendResponse(GetResponse(path, resp), stream);
       };
@@ -2129,8 +2130,8 @@ void SetUpComponentsComponentTransceiverStateVendor(
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is
     // logged when it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                    &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2166,8 +2167,8 @@ void SetUpComponentsComponentTransceiverStateVendorPart(
         // Query the switch. The returned status is ignored as there is no
         // way to notify the controller that something went wrong.
         // The error is logged when it is created.
-        tree->GetSwitchInterface()
-            ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+        DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id,
+                                        req, &writer, /* details= */ nullptr)
             .IgnoreError();
         return SendResponse(GetResponse(path, resp), stream);
       };
@@ -2276,7 +2277,8 @@ void SetUpComponentsComponentOpticalChannelConfigFrequency(uint64 initial_value,
       ->SetOnChangeRegistration(register_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2648,7 +2650,8 @@ void SetUpComponentsComponentOpticalChannelConfigTargetOutputPower(
       ->SetOnChangeRegistration(register_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2731,7 +2734,8 @@ void SetUpComponentsComponentOpticalChannelConfigOperationalMode(
       ->SetOnChangeRegistration(register_functor)
       ->SetOnChangeHandler(on_change_functor)
       ->SetOnUpdateHandler(on_set_functor)
-      ->SetOnReplaceHandler(on_set_functor);
+      ->SetOnReplaceHandler(on_set_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2748,7 +2752,9 @@ void SetUpComponentsComponentOpticalChannelConfigLinePort(
   // so it doesn't support OnChange/OnUpdate/OnReplace until the yang tree
   // supports nodes renaming.
 
-  node->SetOnPollHandler(poll_functor)->SetOnTimerHandler(poll_functor);
+  node->SetOnPollHandler(poll_functor)
+      ->SetOnTimerHandler(poll_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2761,7 +2767,9 @@ void SetUpComponentsComponentOpticalChannelStateLinePort(
     return SendResponse(GetResponse(path, line_port), stream);
   };
 
-  node->SetOnPollHandler(poll_functor)->SetOnTimerHandler(poll_functor);
+  node->SetOnPollHandler(poll_functor)
+      ->SetOnTimerHandler(poll_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2779,7 +2787,8 @@ void SetUpComponentsComponentConfigName(
   // supports nodes renaming.
 
   node->SetOnPollHandler(poll_functor)
-      ->SetOnTimerHandler(poll_functor);
+      ->SetOnTimerHandler(poll_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2792,7 +2801,8 @@ void SetUpComponentsComponentName(const std::string& name, TreeNode* node) {
   };
 
   node->SetOnPollHandler(poll_functor)
-      ->SetOnTimerHandler(poll_functor);
+      ->SetOnTimerHandler(poll_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2806,7 +2816,8 @@ void SetUpComponentsComponentStateType(
   };
 
   node->SetOnPollHandler(poll_functor)
-      ->SetOnTimerHandler(poll_functor);
+      ->SetOnTimerHandler(poll_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2821,7 +2832,8 @@ void SetUpQosInterfacesInterfaceOutputQueuesQueueStateName(
   auto on_change_functor = UnsupportedFunc();
   node->SetOnTimerHandler(poll_functor)
       ->SetOnPollHandler(poll_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2922,7 +2934,8 @@ void SetUpQusQueuesQueueConfigId(uint32 queue_id, TreeNode* node,
   auto on_change_functor = UnsupportedFunc();
   node->SetOnTimerHandler(poll_functor)
       ->SetOnPollHandler(poll_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2939,7 +2952,8 @@ void SetUpQusQueuesQueueStateId(uint32 queue_id, TreeNode* node,
   auto on_change_functor = UnsupportedFunc();
   node->SetOnTimerHandler(poll_functor)
       ->SetOnPollHandler(poll_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2968,8 +2982,8 @@ void SetUpDebugNodesNodePacketIoDebugString(uint64 node_id, TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    DataRequestBatch::RetrieveValue(tree->GetSwitchInterface(), node_id, req,
+                                    &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2988,7 +3002,8 @@ void SetUpComponentsComponentIntegratedCircuitConfigNodeId(
   auto on_change_functor = UnsupportedFunc();
   node->SetOnPollHandler(poll_functor)
       ->SetOnTimerHandler(poll_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3004,7 +3019,8 @@ void SetUpComponentsComponentIntegratedCircuitStateNodeId(uint64 node_id,
   auto on_change_functor = UnsupportedFunc();
   node->SetOnPollHandler(poll_functor)
       ->SetOnTimerHandler(poll_functor)
-      ->SetOnChangeHandler(on_change_functor);
+      ->SetOnChangeHandler(on_change_functor)
+      ->SetIsConfigDerived();
 }
 
 }  // namespace
@@ -3490,23 +3506,14 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnChangeHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream) { return ::util::OkStatus(); })
-      ->SetOnPollHandler(
-          [tree](const GnmiEvent& event, const ::gnmi::Path& path,
-                 GnmiSubscribeStream* stream)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
-                // Polling a wildcard node means that all matching nodes have to
-                // be polled.
-                auto status = tree->PerformActionForAllNonWildcardNodes(
-                    GetPath("interfaces")("interface")(),
-                    GetPath("state")("ifindex")(),
-                    [&event, &stream](const TreeNode& leaf) {
-                      return (leaf.GetOnPollHandler())(event, stream);
-                    });
-                // Notify the client that all nodes have been processed.
-                APPEND_STATUS_IF_ERROR(
-                    status, YangParseTreePaths::SendEndOfSeriesMessage(stream));
-                return status;
-              });
+      ->SetOnPollResolver(
+          [tree]() EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+            // Polling a wildcard node means that all matching nodes have to
+            // be polled.
+            return tree->ResolveOnPollForAllNonWildcardNodes(
+                GetPath("interfaces")("interface")(),
+                GetPath("state")("ifindex")());
+          });
   // Add support for "/interfaces/interface[name=*]/state/name".
   tree->AddNode(GetPath("interfaces")("interface", "*")("state")("name")())
       ->SetOnChangeRegistration(
@@ -3525,23 +3532,14 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnChangeHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream) { return ::util::OkStatus(); })
-      ->SetOnPollHandler(
-          [tree](const GnmiEvent& event, const ::gnmi::Path& path,
-                 GnmiSubscribeStream* stream)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
-                // Polling a wildcard node means that all matching nodes have to
-                // be polled.
-                auto status = tree->PerformActionForAllNonWildcardNodes(
-                    GetPath("interfaces")("interface")(),
-                    GetPath("state")("name")(),
-                    [&event, &stream](const TreeNode& leaf) {
-                      return (leaf.GetOnPollHandler())(event, stream);
-                    });
-                // Notify the client that all nodes have been processed.
-                APPEND_STATUS_IF_ERROR(
-                    status, YangParseTreePaths::SendEndOfSeriesMessage(stream));
-                return status;
-              });
+      ->SetOnPollResolver(
+          [tree]() EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+            // Polling a wildcard node means that all matching nodes have to
+            // be polled.
+            return tree->ResolveOnPollForAllNonWildcardNodes(
+                GetPath("interfaces")("interface")(),
+                GetPath("state")("name")());
+          });
 
   auto interfaces_on_chage_reg = [tree](const EventHandlerRecordPtr& record)
   EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
@@ -3555,21 +3553,12 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
     return status;
   };  // NOLINT(readability/braces)
 
-  auto interfaces_on_poll = [tree](const GnmiEvent& event,
-                                   const ::gnmi::Path& path,
-                                   GnmiSubscribeStream* stream)
+  auto interfaces_on_poll = [tree]()
   EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
     // Polling a wildcard node means that all matching nodes have to
     // be polled.
-    auto status = tree->PerformActionForAllNonWildcardNodes(
-        GetPath("interfaces")("interface")(), gnmi::Path(),
-        [&event, &stream](const TreeNode& node) {
-          return (node.GetOnPollHandler())(event, stream);
-        });
-    // Notify the client that all nodes have been processed.
-    APPEND_STATUS_IF_ERROR(
-        status, YangParseTreePaths::SendEndOfSeriesMessage(stream));
-    return status;
+    return tree->ResolveOnPollForAllNonWildcardNodes(
+        GetPath("interfaces")("interface")(), gnmi::Path());
   };  // NOLINT(readability/braces)
 
   // Add support for "/interfaces/interface/...".
@@ -3578,7 +3567,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnChangeHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream) { return ::util::OkStatus(); })
-      ->SetOnPollHandler(interfaces_on_poll);
+      ->SetOnPollResolver(interfaces_on_poll);
 
   // Add support for "/interfaces/interface/*".
   tree->AddNode(GetPath("interfaces")("interface")("*")())
@@ -3586,28 +3575,15 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnChangeHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream) { return ::util::OkStatus(); })
-      ->SetOnPollHandler(interfaces_on_poll);
+      ->SetOnPollResolver(interfaces_on_poll);
 }
 
 void YangParseTreePaths::AddSubtreeAllComponents(YangParseTree* tree) {
-  auto on_poll_names = [tree](const GnmiEvent& event,
-                              const ::gnmi::Path& path,
-                              GnmiSubscribeStream* stream)
+  auto on_poll_names = [tree]()
   EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
-    // Execute OnPollHandler and send to the stream.
-    auto execute_poll = [&event, &stream](const TreeNode& leaf) {
-      return (leaf.GetOnPollHandler())(event, stream);
-    };
-
     // Recursively process on-poll.
-    auto status = tree->PerformActionForAllNonWildcardNodes(
-        GetPath("components")("component")(), GetPath("name")(), execute_poll);
-
-    // Notify the client that all nodes have been processed.
-    APPEND_STATUS_IF_ERROR(
-        status, YangParseTreePaths::SendEndOfSeriesMessage(stream));
-
-    return status;
+    return tree->ResolveOnPollForAllNonWildcardNodes(
+        GetPath("components")("component")(), GetPath("name")());
   };  // NOLINT(readability/braces)
 
   // YANG tree requires all tree nodes to have on-change handler.
@@ -3620,32 +3596,19 @@ void YangParseTreePaths::AddSubtreeAllComponents(YangParseTree* tree) {
 
   // Add support for all "/components/component[name]/name" paths.
   tree->AddNode(GetPath("components")("component", "*")("name")())
-      ->SetOnPollHandler(on_poll_names)
+      ->SetOnPollResolver(on_poll_names)
       ->SetOnChangeHandler(on_change);
 
-  auto on_poll_all_components = [tree](const GnmiEvent& event,
-                                       const ::gnmi::Path& path,
-                                       GnmiSubscribeStream* stream)
+  auto on_poll_all_components = [tree]()
   EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
-    // Execute OnPollHandler and send to the stream.
-    auto execute_poll = [&event, &stream](const TreeNode& leaf) {
-      return (leaf.GetOnPollHandler())(event, stream);
-    };
-
     // Recursively process on-poll.
-    auto status = tree->PerformActionForAllNonWildcardNodes(
-        GetPath("components")("component")(), gnmi::Path(), execute_poll);
-
-    // Notify the client that all nodes have been processed.
-    APPEND_STATUS_IF_ERROR(
-        status, YangParseTreePaths::SendEndOfSeriesMessage(stream));
-
-    return status;
+    return tree->ResolveOnPollForAllNonWildcardNodes(
+        GetPath("components")("component")(), gnmi::Path());
   };  // NOLINT(readability/braces)
 
   // Add support for the "/components/component/*" path.
   tree->AddNode(GetPath("components")("component")("*")())
-      ->SetOnPollHandler(on_poll_all_components)
+      ->SetOnPollResolver(on_poll_all_components)
       ->SetOnChangeHandler(on_change);
 }
 
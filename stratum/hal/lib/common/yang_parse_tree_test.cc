@@ -15,6 +15,8 @@
 
 #include "stratum/hal/lib/common/yang_parse_tree_mock.h"
 
+#include <algorithm>
+
 #include "google/protobuf/text_format.h"
 #include "gnmi/gnmi.pb.h"
 #include "openconfig/openconfig.pb.h"
@@ -41,6 +43,7 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SizeIs;
 using ::testing::WithArg;
 using ::testing::WithArgs;
@@ -694,6 +697,113 @@ TEST_F(YangParseTreeTest, PerformActionForAllNodesOnePresent) {
       GetPath("interfaces")("interface", "interface-1")("state")("ifindex")()));
 }
 
+// Check that a path with an element that has never been added is not found.
+TEST_F(YangParseTreeTest, FindNodeOrNullUnknownElement) {
+  AddSubtreeInterface("interface-1");
+
+  EXPECT_EQ(GetRoot().FindNodeOrNull(GetPath("interfaces")(
+                "interface", "interface-1")("state")("ifindex")()),
+            AddNode(GetPath("interfaces")(
+                "interface", "interface-1")("state")("ifindex")()));
+  EXPECT_EQ(nullptr, GetRoot().FindNodeOrNull(GetPath("interfaces")(
+                         "interface", "no-such-interface")("state")()));
+  EXPECT_EQ(nullptr, GetRoot().FindNodeOrNull(GetPath("interfaces")(
+                         "interface", "interface-1")("no-such-leaf")()));
+}
+
+// Check that a config push updates the subtrees whose config changed and keeps
+// the nodes of the other ones in place.
+TEST_F(YangParseTreeTest, ProcessPushedConfigUpdatesChangedSubtrees) {
+  ChassisConfig config;
+  config.mutable_chassis()->set_name("chassis-1");
+  auto* node = config.add_nodes();
+  node->set_name("node-1");
+  node->set_id(kInterface1NodeId);
+  for (const std::string& name : {"interface-1", "interface-2"}) {
+    auto* singleton = config.add_singleton_ports();
+    singleton->set_name(name);
+    singleton->set_node(kInterface1NodeId);
+    singleton->set_id(config.singleton_ports_size());
+    singleton->set_speed_bps(kTwentyFiveGigBps);
+  }
+  ASSERT_OK(parse_tree_.ProcessPushedConfig(ConfigHasBeenPushedEvent(config)));
+
+  const auto speed_path = [](const std::string& name) {
+    return GetPath("interfaces")(
+        "interface", name)("ethernet")("config")("port-speed")();
+  };
+  const TreeNode* leaf1 = GetRoot().FindNodeOrNull(speed_path("interface-1"));
+  const TreeNode* leaf2 = GetRoot().FindNodeOrNull(speed_path("interface-2"));
+  ASSERT_NE(nullptr, leaf1);
+  ASSERT_NE(nullptr, leaf2);
+
+  // Change the speed of one port only and push the config again.
+  config.mutable_singleton_ports(0)->set_speed_bps(kHundredGigBps);
+  ASSERT_OK(parse_tree_.ProcessPushedConfig(ConfigHasBeenPushedEvent(config)));
+  EXPECT_EQ(leaf1, GetRoot().FindNodeOrNull(speed_path("interface-1")));
+  EXPECT_EQ(leaf2, GetRoot().FindNodeOrNull(speed_path("interface-2")));
+
+  ::gnmi::SubscribeResponse resp1, resp2;
+  SubscribeReaderWriterMock stream;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp1), Return(true)))
+      .WillOnce(DoAll(SaveArg<0>(&resp2), Return(true)));
+  ASSERT_OK(leaf1->GetOnPollHandler()(PollEvent(), &stream));
+  ASSERT_OK(leaf2->GetOnPollHandler()(PollEvent(), &stream));
+  ASSERT_EQ(resp1.update().update_size(), 1);
+  EXPECT_EQ(resp1.update().update(0).val().string_val(), "SPEED_100GB");
+  ASSERT_EQ(resp2.update().update_size(), 1);
+  EXPECT_EQ(resp2.update().update(0).val().string_val(), "SPEED_25GB");
+}
+
+// Check that polling a subtree sends the requests of all its leaves to the
+// switch in a single DataRequest, and that each leaf is reported once.
+TEST_F(YangParseTreeTest, PollSubtreeBatchesDataRequests) {
+  AddSubtreeInterface("interface-1");
+
+  // The counters are read by the port counters cache on its own.
+  int num_requests = 0, num_calls = 0;
+  EXPECT_CALL(switch_, RetrieveValue(kInterface1NodeId, _, _, _))
+      .WillRepeatedly(Invoke([&](uint64 node_id, const DataRequest& req,
+                                 WriterInterface<DataResponse>* w,
+                                 std::vector<::util::Status>* details) {
+        if (req.requests(0).has_port_counters()) {
+          w->Write(DataResponse());
+          return ::util::OkStatus();
+        }
+        ++num_calls;
+        num_requests += req.requests_size();
+        for (int i = 0; i < req.requests_size(); ++i) {
+          DataResponse resp;
+          resp.mutable_oper_status()->set_state(PORT_STATE_UP);
+          w->Write(resp);
+          if (details) details->push_back(::util::OkStatus());
+        }
+        return ::util::OkStatus();
+      }));
+
+  std::vector<std::string> leaves;
+  SubscribeReaderWriterMock stream;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillRepeatedly(DoAll(
+          WithArgs<0>(Invoke([&leaves](const ::gnmi::SubscribeResponse& r) {
+            if (r.update().update_size() == 0) return;
+            leaves.push_back(r.update().update(0).path().DebugString());
+          })),
+          Return(true)));
+
+  auto* node = GetRoot().FindNodeOrNull(
+      GetPath("interfaces")("interface", "interface-1")("state")());
+  ASSERT_NE(node, nullptr);
+  ASSERT_OK(node->GetOnPollHandler()(PollEvent(), &stream));
+
+  EXPECT_EQ(1, num_calls);
+  EXPECT_GT(num_requests, 1);
+  EXPECT_FALSE(leaves.empty());
+  std::sort(leaves.begin(), leaves.end());
+  EXPECT_EQ(leaves.end(), std::adjacent_find(leaves.begin(), leaves.end()));
+}
+
 // Check if RetrieveValue is called.
 TEST_F(YangParseTreeTest, GetDataFromSwitchInterfaceCalled) {
   // Create a fake switch interface object.
@@ -1363,6 +1473,41 @@ TEST_F(YangParseTreeTest,
   EXPECT_EQ(resp.update().update(0).val().uint_val(), kInOctets);
 }
 
+// Check if the counter leaves of the same port share one read of the counters.
+TEST_F(YangParseTreeTest, InterfacesInterfaceStateCountersOnPollShareSnapshot) {
+  auto counters_path = [](const std::string& leaf) {
+    return GetPath("interfaces")(
+        "interface", "interface-1")("state")("counters")(leaf)();
+  };
+  constexpr uint64 kInOctets = 5;
+  constexpr uint64 kOutOctets = 45;
+
+  // Mock implementation of RetrieveValue() that sends a response set to
+  // kInOctets and kOutOctets. It is expected to be called only once.
+  EXPECT_CALL(switch_, RetrieveValue(_, _, _, _))
+      .WillOnce(DoAll(WithArg<2>(Invoke([](WriterInterface<DataResponse>* w) {
+                        DataResponse resp;
+                        // Set the response.
+                        resp.mutable_port_counters()->set_in_octets(kInOctets);
+                        resp.mutable_port_counters()->set_out_octets(
+                            kOutOctets);
+                        // Send it to the caller.
+                        w->Write(resp);
+                      })),
+                      Return(::util::OkStatus())));
+
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(counters_path("in-octets"), &resp));
+  ASSERT_EQ(resp.update().update_size(), 1);
+  EXPECT_EQ(resp.update().update(0).val().uint_val(), kInOctets);
+  EXPECT_OK(ExecuteOnPoll(counters_path("out-octets"), &resp));
+  ASSERT_EQ(resp.update().update_size(), 1);
+  EXPECT_EQ(resp.update().update(0).val().uint_val(), kOutOctets);
+
+  EXPECT_EQ(1, parse_tree_.GetPortCountersCache()->GetStats().hits);
+  EXPECT_EQ(1, parse_tree_.GetPortCountersCache()->GetStats().misses);
+}
+
 // Check if the 'counters/in-octets' OnChange action works correctly.
 TEST_F(YangParseTreeTest,
        InterfacesInterfaceStateCountersInOctetsOnChangeSuccess) {
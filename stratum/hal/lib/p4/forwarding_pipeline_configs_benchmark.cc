@@ -0,0 +1,157 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// This binary compares the time it takes to save and load the forwarding
+// pipeline configs pushed to the switch (see P4Service), in the text format
+// and in the binary container format (see proto_container_file.h). The loading
+// time adds directly to the switch startup time on coldboot and warmboot. The
+// configs are made of --num_nodes nodes, each with a P4Info of --num_tables
+// tables and a device config of --device_config_size_kb KB of random bytes.
+// Example:
+//   forwarding_pipeline_configs_benchmark --num_nodes=2 \
+//       --device_config_size_kb=16384 --dir=/tmp
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/p4/forwarding_pipeline_configs.pb.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/proto_container_file.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_int32(num_nodes, 2, "Number of nodes in the configs.");
+DEFINE_int32(num_tables, 100, "Number of tables in the P4Info of each node.");
+DEFINE_int32(device_config_size_kb, 16384,
+             "Size of the device config of each node in KB.");
+DEFINE_int32(num_iterations, 5,
+             "Number of times each file is written and read.");
+DEFINE_string(dir, "/tmp", "Dir where the files are written.");
+
+namespace stratum {
+
+namespace {
+
+// Fills the configs with made-up P4Infos and random device configs, which are
+// about as large as the real ones and not compressible.
+void BuildConfigs(hal::ForwardingPipelineConfigs* configs) {
+  std::mt19937_64 generator(1);
+  for (int node = 1; node <= FLAGS_num_nodes; ++node) {
+    ::p4::v1::ForwardingPipelineConfig& config =
+        (*configs->mutable_node_id_to_config())[node];
+    ::p4::config::v1::P4Info* p4info = config.mutable_p4info();
+    for (int i = 0; i < FLAGS_num_tables; ++i) {
+      ::p4::config::v1::Table* table = p4info->add_tables();
+      table->mutable_preamble()->set_id(0x02000000 + i);
+      table->mutable_preamble()->set_name(
+          absl::StrCat("ingress.control.table_", i));
+      for (int j = 0; j < 4; ++j) {
+        ::p4::config::v1::MatchField* match_field = table->add_match_fields();
+        match_field->set_id(j + 1);
+        match_field->set_name(absl::StrCat("hdr.header_", j, ".field"));
+        match_field->set_bitwidth(32);
+        match_field->set_match_type(::p4::config::v1::MatchField::TERNARY);
+      }
+      table->set_size(1024);
+    }
+    std::string* device_config = config.mutable_p4_device_config();
+    device_config->resize(FLAGS_device_config_size_kb * 1024LL);
+    for (size_t i = 0; i + 8 <= device_config->size(); i += 8) {
+      uint64 value = generator();
+      memcpy(&(*device_config)[i], &value, sizeof(value));
+    }
+    config.mutable_cookie()->set_cookie(node);
+  }
+}
+
+::util::Status RunBenchmark(const hal::ForwardingPipelineConfigs& configs,
+                            bool container) {
+  const std::string format = container ? "container" : "text";
+  const std::string filename = absl::StrCat(
+      FLAGS_dir, "/forwarding_pipeline_configs_benchmark.", format);
+  absl::Duration write_time, read_time;
+  for (int i = 0; i < FLAGS_num_iterations; ++i) {
+    absl::Time start = absl::Now();
+    if (container) {
+      RETURN_IF_ERROR(WriteProtoToContainerFile(configs, filename));
+    } else {
+      RETURN_IF_ERROR(WriteProtoToTextFile(configs, filename));
+    }
+    write_time += absl::Now() - start;
+
+    hal::ForwardingPipelineConfigs read_configs;
+    start = absl::Now();
+    if (container) {
+      RETURN_IF_ERROR(ReadProtoFromContainerFile(filename, &read_configs));
+    } else {
+      RETURN_IF_ERROR(ReadProtoFromTextFile(filename, &read_configs));
+    }
+    read_time += absl::Now() - start;
+    CHECK_RETURN_IF_FALSE(ProtoEqual(configs, read_configs))
+        << "The configs read from " << filename
+        << " are different from the ones written.";
+  }
+  std::string buffer;
+  RETURN_IF_ERROR(ReadFileToString(filename, &buffer));
+  RETURN_IF_ERROR(RemoveFile(filename));
+
+  LOG(INFO) << format << ": " << buffer.size() << " bytes, write "
+            << absl::ToDoubleMilliseconds(write_time) / FLAGS_num_iterations
+            << "ms, read "
+            << absl::ToDoubleMilliseconds(read_time) / FLAGS_num_iterations
+            << "ms.";
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  InitStratumLogging();
+  CHECK_RETURN_IF_FALSE(FLAGS_num_nodes > 0 && FLAGS_num_tables >= 0 &&
+                        FLAGS_device_config_size_kb >= 0 &&
+                        FLAGS_num_iterations > 0)
+      << "--num_nodes and --num_iterations must be positive, --num_tables "
+      << "and --device_config_size_kb must not be negative.";
+
+  hal::ForwardingPipelineConfigs configs;
+  BuildConfigs(&configs);
+  RETURN_IF_ERROR(RunBenchmark(configs, /*container=*/false));
+  RETURN_IF_ERROR(RunBenchmark(configs, /*container=*/true));
+
+  return ::util::OkStatus();
+}
+
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::util::Status status = stratum::Main(argc, argv);
+  if (status.ok()) {
+    return 0;
+  } else {
+    LOG(ERROR) << status;
+    return 1;
+  }
+}
@@ -66,6 +66,40 @@ std::unique_ptr<P4MatchKey> P4MatchKey::CreateInstance(
   return nullptr;
 }
 
+::util::Status P4MatchKey::ConvertFieldMatch(
+    const ::p4::v1::FieldMatch& p4_field_match,
+    const P4FieldDescriptor::P4FieldConversionEntry& conversion_entry,
+    int bit_width, MappedField* mapped_field) {
+  switch (p4_field_match.field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact: {
+      P4MatchKeyExact match_key(p4_field_match);
+      return match_key.Convert(conversion_entry, bit_width, mapped_field);
+    }
+    case ::p4::v1::FieldMatch::kTernary: {
+      P4MatchKeyTernary match_key(p4_field_match);
+      return match_key.Convert(conversion_entry, bit_width, mapped_field);
+    }
+    case ::p4::v1::FieldMatch::kLpm: {
+      P4MatchKeyLPM match_key(p4_field_match);
+      return match_key.Convert(conversion_entry, bit_width, mapped_field);
+    }
+    case ::p4::v1::FieldMatch::kRange: {
+      P4MatchKeyRange match_key(p4_field_match);
+      return match_key.Convert(conversion_entry, bit_width, mapped_field);
+    }
+    case ::p4::v1::FieldMatch::FIELD_MATCH_TYPE_NOT_SET: {
+      P4MatchKeyUnspecified match_key(p4_field_match);
+      return match_key.Convert(conversion_entry, bit_width, mapped_field);
+    }
+    default:
+      break;
+  }
+  *mapped_field->mutable_value()->mutable_raw_pi_match() = p4_field_match;
+  return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+         << "P4 TableEntry match field " << p4_field_match.ShortDebugString()
+         << " has an unsupported match type";
+}
+
 P4MatchKey::P4MatchKey(
     const ::p4::v1::FieldMatch& p4_field_match,
     ::p4::config::v1::MatchField::MatchType allowed_match_type)
@@ -47,9 +47,23 @@ class P4MatchKey {
  public:
   // The CreateInstance factory method creates a P4MatchKey given a FieldMatch
   // from a P4 runtime request.  CreateInstance determines the appropriate
-  // P4MatchKey subclass from the FieldMatch content.
+  // P4MatchKey subclass from the FieldMatch content.  The P4MatchKey refers to
+  // p4_field_match without copying it, so the caller must keep p4_field_match
+  // alive for the lifetime of the P4MatchKey.  The rvalue overload is
+  // deleted so a temporary FieldMatch cannot be given to CreateInstance.
   static std::unique_ptr<P4MatchKey> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKey> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
+
+  // ConvertFieldMatch is equivalent to calling CreateInstance followed by
+  // Convert, except that the P4MatchKey lives on the stack instead of the
+  // heap.  It is meant for callers that convert many match fields in a row,
+  // such as the P4TableMapper.
+  static ::util::Status ConvertFieldMatch(
+      const ::p4::v1::FieldMatch& p4_field_match,
+      const P4FieldDescriptor::P4FieldConversionEntry& conversion_entry,
+      int bit_width, MappedField* mapped_field);
 
   virtual ~P4MatchKey() {}
 
@@ -145,8 +159,9 @@ class P4MatchKey {
   // complies with section "8.3 Bytestrings" in the "P4Runtime Specification".
   ::util::Status CheckBitWidth(const std::string& bytes_value, int bit_width);
 
-  // This member stores the P4 FieldMatch given to CreateInstance.
-  const ::p4::v1::FieldMatch p4_field_match_;
+  // This member refers to the P4 FieldMatch given to CreateInstance, which
+  // must outlive this P4MatchKey.
+  const ::p4::v1::FieldMatch& p4_field_match_;
 
   // This member stores the subclass-dependent match type, i.e.
   // EXACT/LPM/TERNARY/RANGE.
@@ -156,12 +171,17 @@ class P4MatchKey {
 // P4MatchKey subclass for P4 config MatchField::EXACT.
 class P4MatchKeyExact : public P4MatchKey {
  public:
+  // The same p4_field_match lifetime rules as P4MatchKey::CreateInstance
+  // apply here.
   static std::unique_ptr<P4MatchKeyExact> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKeyExact> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
 
   ~P4MatchKeyExact() override {}
 
  protected:
+  friend class P4MatchKey;
   explicit P4MatchKeyExact(const ::p4::v1::FieldMatch& p4_field_match)
       : P4MatchKey(p4_field_match, ::p4::config::v1::MatchField::EXACT) {}
 
@@ -173,12 +193,17 @@ class P4MatchKeyExact : public P4MatchKey {
 // P4MatchKey subclass for P4 config MatchField::TERNARY.
 class P4MatchKeyTernary : public P4MatchKey {
  public:
+  // The same p4_field_match lifetime rules as P4MatchKey::CreateInstance
+  // apply here.
   static std::unique_ptr<P4MatchKeyTernary> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKeyTernary> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
 
   ~P4MatchKeyTernary() override {}
 
  protected:
+  friend class P4MatchKey;
   explicit P4MatchKeyTernary(const ::p4::v1::FieldMatch& p4_field_match)
       : P4MatchKey(p4_field_match, ::p4::config::v1::MatchField::TERNARY) {}
 
@@ -190,12 +215,17 @@ class P4MatchKeyTernary : public P4MatchKey {
 // P4MatchKey subclass for P4 config MatchField::LPM.
 class P4MatchKeyLPM : public P4MatchKey {
  public:
+  // The same p4_field_match lifetime rules as P4MatchKey::CreateInstance
+  // apply here.
   static std::unique_ptr<P4MatchKeyLPM> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKeyLPM> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
 
   ~P4MatchKeyLPM() override {}
 
  protected:
+  friend class P4MatchKey;
   explicit P4MatchKeyLPM(const ::p4::v1::FieldMatch& p4_field_match)
       : P4MatchKey(p4_field_match, ::p4::config::v1::MatchField::LPM) {}
 
@@ -207,12 +237,17 @@ class P4MatchKeyLPM : public P4MatchKey {
 // P4MatchKey subclass for P4 config MatchField::RANGE.
 class P4MatchKeyRange : public P4MatchKey {
  public:
+  // The same p4_field_match lifetime rules as P4MatchKey::CreateInstance
+  // apply here.
   static std::unique_ptr<P4MatchKeyRange> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKeyRange> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
 
   ~P4MatchKeyRange() override {}
 
  protected:
+  friend class P4MatchKey;
   explicit P4MatchKeyRange(const ::p4::v1::FieldMatch& p4_field_match)
       : P4MatchKey(p4_field_match, ::p4::config::v1::MatchField::RANGE) {}
 
@@ -224,8 +259,12 @@ class P4MatchKeyRange : public P4MatchKey {
 // match a default value.  For other types, it is an invalid FieldMatch.
 class P4MatchKeyUnspecified : public P4MatchKey {
  public:
+  // The same p4_field_match lifetime rules as P4MatchKey::CreateInstance
+  // apply here.
   static std::unique_ptr<P4MatchKeyUnspecified> CreateInstance(
       const ::p4::v1::FieldMatch& p4_field_match);
+  static std::unique_ptr<P4MatchKeyUnspecified> CreateInstance(
+      ::p4::v1::FieldMatch&& p4_field_match) = delete;
 
   ~P4MatchKeyUnspecified() override {}
 
@@ -236,6 +275,7 @@ class P4MatchKeyUnspecified : public P4MatchKey {
       int bit_width, MappedField* mapped_field) override;
 
  protected:
+  friend class P4MatchKey;
   explicit P4MatchKeyUnspecified(const ::p4::v1::FieldMatch& p4_field_match)
       : P4MatchKey(p4_field_match, ::p4::config::v1::MatchField::UNSPECIFIED) {}
 };
@@ -16,7 +16,7 @@
 
 #include "stratum/hal/lib/p4/p4_table_mapper.h"
 
-#include <set>
+#include <algorithm>
 
 #include "gflags/gflags.h"
 #include "stratum/glue/logging.h"
@@ -190,6 +190,12 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
     }
   }
 
+  // With the descriptors and field conversions in place, each table's mapping
+  // plan can be compiled.
+  for (const auto& table : p4_info.tables()) {
+    AddTableMappingPlan(table);
+  }
+
   // Parse controller metadata and populate the internal tables. We try our
   // best to parse metadata and skip invalid/unknown data.
   for (const auto& controller_packet_metadata :
@@ -327,30 +333,34 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
   ::util::Status status = ::util::OkStatus();
 
   // The table should be recognized in the P4Info, and it must contain a
-  // valid set of match fields and one action.
+  // valid set of match fields and one action.  Every table in the P4Info has
+  // a mapping plan, so a missing plan means an unknown table ID.
   int p4_table_id = table_entry.table_id();
-  ASSIGN_OR_RETURN(::p4::config::v1::Table table_p4_info,
-                   p4_info_manager_->FindTableByID(p4_table_id));
-  std::vector<::p4::v1::FieldMatch> all_match_fields;
-  RETURN_IF_ERROR(
-      PrepareMatchFields(table_p4_info, table_entry, &all_match_fields));
+  const P4TableMappingPlan* plan = gtl::FindOrNull(table_plans_, p4_table_id);
+  if (plan == nullptr) {
+    RETURN_IF_ERROR(p4_info_manager_->FindTableByID(p4_table_id).status());
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "P4 table ID " << PrintP4ObjectID(p4_table_id)
+           << " has no mapping plan.";
+  }
+  PlannedMatchFields all_match_fields;
+  RETURN_IF_ERROR(PrepareMatchFields(*plan, table_entry, &all_match_fields));
   if (update_type == ::p4::v1::Update::INSERT && !table_entry.has_action()) {
     return MAKE_ERROR(ERR_INVALID_PARAM)
            << "P4 TableEntry update has no action";
   }
 
-  APPEND_STATUS_IF_ERROR(
-      status, ProcessTableID(table_p4_info, p4_table_id, flow_entry));
+  APPEND_STATUS_IF_ERROR(status, ProcessTableID(*plan, flow_entry));
 
   for (const auto& match_field : all_match_fields) {
-    APPEND_STATUS_IF_ERROR(
-        status, ProcessMatchField(table_p4_info, match_field, flow_entry));
+    APPEND_STATUS_IF_ERROR(status,
+                           ProcessMatchField(*plan, match_field, flow_entry));
   }
 
   if (table_entry.has_action()) {
     APPEND_STATUS_IF_ERROR(
-        status,
-        ProcessTableAction(table_p4_info, table_entry.action(), flow_entry));
+        status, ProcessTableAction(plan->table_p4_info, table_entry.action(),
+                                   flow_entry));
   }
 
   flow_entry->set_priority(table_entry.priority());
@@ -638,10 +648,38 @@ std::string P4TableMapper::GetMapperNameKey(
   return preamble.name();
 }
 
+void P4TableMapper::AddTableMappingPlan(
+    const ::p4::config::v1::Table& table_p4_info) {
+  const int table_id = table_p4_info.preamble().id();
+  P4TableMappingPlan& plan = table_plans_[table_id];
+  plan.table_p4_info = table_p4_info;
+  plan.table_info.set_id(table_id);
+  plan.table_info.set_name(table_p4_info.preamble().name());
+  *plan.table_info.mutable_annotations() =
+      table_p4_info.preamble().annotations();
+  auto desc_iter = global_id_table_map_.find(table_id);
+  if (desc_iter != global_id_table_map_.end()) {
+    plan.table_descriptor = &desc_iter->second->table_descriptor();
+  } else {
+    plan.table_info.set_type(P4_TABLE_UNKNOWN);
+  }
+
+  for (const auto& p4info_match_field : table_p4_info.match_fields()) {
+    plan.field_index[p4info_match_field.id()] = plan.dont_care_fields.size();
+    ::p4::v1::FieldMatch dont_care_match;
+    dont_care_match.set_field_id(p4info_match_field.id());
+    plan.dont_care_fields.push_back(dont_care_match);
+    plan.field_conversions.push_back(gtl::FindOrNull(
+        field_convert_by_table_,
+        MakeP4FieldConvertKey(table_id, p4info_match_field.id())));
+  }
+}
+
 ::util::Status P4TableMapper::PrepareMatchFields(
-    const ::p4::config::v1::Table& table_p4_info,
-    const ::p4::v1::TableEntry& table_entry,
-    std::vector<::p4::v1::FieldMatch>* all_match_fields) const {
+    const P4TableMappingPlan& plan, const ::p4::v1::TableEntry& table_entry,
+    PlannedMatchFields* all_match_fields) const {
+  const auto& table_p4_info = plan.table_p4_info;
+
   // An empty set of match fields changes the default action for tables
   // that were not defined with a const default action in the P4 program.
   if (table_entry.match_size() == 0) {
@@ -657,32 +695,46 @@ std::string P4TableMapper::GetMapperNameKey(
   // Per field validations:
   //  - Every field_id must be non-zero.
   //  - A field_id can appear in a match field at most once.
-  std::set<uint32> requested_field_ids;
+  // Fields that are not in the table's P4Info are passed along with no
+  // conversion, so that ProcessMatchField reports them.
+  absl::InlinedVector<bool, 16> requested(plan.dont_care_fields.size(), false);
+  absl::InlinedVector<uint32, 4> unknown_field_ids;
   for (const auto& match_field : table_entry.match()) {
-    if (match_field.field_id() == 0) {
+    const uint32 field_id = match_field.field_id();
+    if (field_id == 0) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "P4 TableEntry match field has no field_id. "
              << table_entry.ShortDebugString();
     }
-    if (!requested_field_ids.insert(match_field.field_id()).second) {
+    const P4FieldConvertValue* conversion = nullptr;
+    bool duplicate = false;
+    auto index_iter = plan.field_index.find(field_id);
+    if (index_iter != plan.field_index.end()) {
+      duplicate = requested[index_iter->second];
+      requested[index_iter->second] = true;
+      conversion = plan.field_conversions[index_iter->second];
+    } else {
+      duplicate = std::find(unknown_field_ids.begin(), unknown_field_ids.end(),
+                            field_id) != unknown_field_ids.end();
+      unknown_field_ids.push_back(field_id);
+    }
+    if (duplicate) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "P4 TableEntry update of table "
              << table_p4_info.preamble().name() << " has multiple match field "
-             << "entries for field_id " << match_field.field_id() << ". "
+             << "entries for field_id " << field_id << ". "
              << table_entry.ShortDebugString();
     }
-    all_match_fields->push_back(match_field);
+    all_match_fields->emplace_back(&match_field, conversion);
   }
 
   // Any missing fields in the request are added with don't care values below.
   // The P4MatchKey instance in ProcessMatchField ultimately determines whether
   // don't-care/default usage is permissible for each field.
-  for (const auto& p4info_match_field : table_p4_info.match_fields()) {
-    if (requested_field_ids.find(p4info_match_field.id()) ==
-        requested_field_ids.end()) {
-      ::p4::v1::FieldMatch dont_care_match;
-      dont_care_match.set_field_id(p4info_match_field.id());
-      all_match_fields->push_back(dont_care_match);
+  for (size_t i = 0; i < requested.size(); ++i) {
+    if (!requested[i]) {
+      all_match_fields->emplace_back(&plan.dont_care_fields[i],
+                                     plan.field_conversions[i]);
     }
   }
 
@@ -690,22 +742,16 @@ std::string P4TableMapper::GetMapperNameKey(
 }
 
 ::util::Status P4TableMapper::ProcessTableID(
-    const ::p4::config::v1::Table& table_p4_info, int table_id,
-    CommonFlowEntry* flow_entry) const {
-  flow_entry->mutable_table_info()->set_id(table_id);
-  flow_entry->mutable_table_info()->set_name(table_p4_info.preamble().name());
-  *flow_entry->mutable_table_info()->mutable_annotations() =
-      table_p4_info.preamble().annotations();
-
-  auto desc_iter = global_id_table_map_.find(table_id);
-  if (desc_iter == global_id_table_map_.end()) {
-    flow_entry->mutable_table_info()->set_type(P4_TABLE_UNKNOWN);
+    const P4TableMappingPlan& plan, CommonFlowEntry* flow_entry) const {
+  *flow_entry->mutable_table_info() = plan.table_info;
+  if (plan.table_descriptor == nullptr) {
     return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-           << "P4 table ID " << table_id << " is missing a table descriptor.";
+           << "P4 table ID " << plan.table_info.id()
+           << " is missing a table descriptor.";
   }
 
-  const auto& table_descriptor = desc_iter->second->table_descriptor();
-  RETURN_IF_ERROR(IsTableUpdateAllowed(table_p4_info, table_descriptor));
+  const auto& table_descriptor = *plan.table_descriptor;
+  RETURN_IF_ERROR(IsTableUpdateAllowed(plan.table_p4_info, table_descriptor));
   // Information from the table descriptor includes the mapped type, mapped
   // pipeline stage, and any internal match fields.
   flow_entry->mutable_table_info()->set_type(table_descriptor.type());
@@ -720,35 +766,32 @@ std::string P4TableMapper::GetMapperNameKey(
 // produce some output for the field in flow_entry, even if it is just a raw
 // copy of an unknown field.
 ::util::Status P4TableMapper::ProcessMatchField(
-    const ::p4::config::v1::Table& table_p4_info,
-    const ::p4::v1::FieldMatch& match_field,
+    const P4TableMappingPlan& plan, const PlannedMatchField& match_field,
     CommonFlowEntry* flow_entry) const {
   ::util::Status status = ::util::OkStatus();
+  const ::p4::v1::FieldMatch& field_match = *match_field.first;
 
-  // This lookup in field_convert_by_table_ accomplishes two things:
+  // The conversion from the plan accomplishes two things:
   //  1) It confirms that the field is allowed in the table.
   //  2) It indicates how to map the field into the flow_entry output.
-  P4FieldConvertKey key = MakeP4FieldConvertKey(table_p4_info, match_field);
-  auto convert_iter = field_convert_by_table_.find(key);
-  if (convert_iter == field_convert_by_table_.end()) {
+  const P4FieldConvertValue* conversion_value = match_field.second;
+  if (conversion_value == nullptr) {
     ::util::Status field_error = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
                                  << "P4 TableEntry match field ID "
-                                 << PrintP4ObjectID(match_field.field_id())
+                                 << PrintP4ObjectID(field_match.field_id())
                                  << " is not recognized in table "
-                                 << table_p4_info.preamble().name();
+                                 << plan.table_info.name();
     APPEND_STATUS_IF_ERROR(status, field_error);
     return status;  // No way to decode fields that don't go with the table.
   }
 
-  const auto& conversion_value = convert_iter->second;
-  const auto& conversion_entry = conversion_value.conversion_entry;
-  const auto& conversion_field = conversion_value.mapped_field;
+  const auto& conversion_entry = conversion_value->conversion_entry;
+  const auto& conversion_field = conversion_value->mapped_field;
 
-  std::unique_ptr<P4MatchKey> match_key =
-      P4MatchKey::CreateInstance(match_field);
   auto mapped_field = flow_entry->add_fields();
-  status = match_key->Convert(conversion_entry, conversion_field.bit_width(),
-                              mapped_field);
+  status = P4MatchKey::ConvertFieldMatch(field_match, conversion_entry,
+                                         conversion_field.bit_width(),
+                                         mapped_field);
   if (status.ok()) {
     mapped_field->set_type(conversion_field.type());
     mapped_field->set_bit_width(conversion_field.bit_width());
@@ -757,8 +800,8 @@ std::string P4TableMapper::GetMapperNameKey(
   } else {
     mapped_field->set_type(P4_FIELD_TYPE_UNKNOWN);
     status = APPEND_ERROR(status)
-             << " for match field " << match_field.ShortDebugString()
-             << " in table " << table_p4_info.preamble().name();
+             << " for match field " << field_match.ShortDebugString()
+             << " in table " << plan.table_info.name();
   }
 
   return status;
@@ -938,6 +981,7 @@ std::string P4TableMapper::GetMapperNameKey(
 }
 
 void P4TableMapper::ClearMaps() {
+  table_plans_.clear();
   global_id_table_map_.clear();
   field_convert_by_table_.clear();
   packetin_metadata_type_to_id_bitwidth_pair_.clear();
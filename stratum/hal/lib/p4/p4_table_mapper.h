@@ -28,6 +28,7 @@
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/p4/common_flow_entry.pb.h"
@@ -288,6 +289,38 @@ class P4TableMapper {
   typedef std::map<P4FieldConvertKey, P4FieldConvertValue>
       P4FieldConvertByTable;
 
+  // A P4TableMappingPlan is compiled for each table in the P4Info when the
+  // forwarding pipeline config is pushed.  It keeps everything MapFlowEntry
+  // needs to know about the table, so that mapping an entry neither copies the
+  // table's P4Info nor looks up its match fields one by one:
+  //  table_p4_info - the table's P4Info.
+  //  table_info - the table_info output common to all entries in the table,
+  //      i.e. the ID, name, and annotations.
+  //  table_descriptor - the table's descriptor in the P4PipelineConfig, or
+  //      nullptr if the table has none.
+  //  field_index - maps each P4Info match field ID to its index in the
+  //      vectors below, which follow the P4Info match field order.
+  //  dont_care_fields - the FieldMatch to use when an entry omits the field.
+  //  field_conversions - the field's conversion in field_convert_by_table_,
+  //      or nullptr if the field has no known conversion.
+  struct P4TableMappingPlan {
+    ::p4::config::v1::Table table_p4_info;
+    P4TableInfo table_info;
+    const P4TableDescriptor* table_descriptor;
+    absl::flat_hash_map<uint32, int> field_index;
+    std::vector<::p4::v1::FieldMatch> dont_care_fields;
+    std::vector<const P4FieldConvertValue*> field_conversions;
+    P4TableMappingPlan() : table_descriptor(nullptr) {}
+  };
+  typedef absl::flat_hash_map<int, P4TableMappingPlan> P4TableMappingPlanMap;
+
+  // A match field of a table entry, paired with its conversion from the
+  // table's P4TableMappingPlan.  The conversion is nullptr if the field is not
+  // recognized in the table.
+  typedef std::pair<const ::p4::v1::FieldMatch*, const P4FieldConvertValue*>
+      PlannedMatchField;
+  typedef absl::InlinedVector<PlannedMatchField, 16> PlannedMatchFields;
+
   // P4FieldConvertKey generators.
   inline static P4FieldConvertKey MakeP4FieldConvertKey(int table_id,
                                                         uint32 match_field_id) {
@@ -434,32 +467,36 @@ class P4TableMapper {
   // return string is empty.
   std::string GetMapperNameKey(const ::p4::config::v1::Preamble& preamble);
 
+  // Compiles the P4TableMappingPlan for the input table into table_plans_.
+  // It expects global_id_table_map_ and field_convert_by_table_ to be
+  // complete for the table.
+  void AddTableMappingPlan(const ::p4::config::v1::Table& table_p4_info);
+
   // Validates all of the match fields in the table_entry from a P4Runtime
-  // WriteRequest message.  The input table_p4_info provides information
-  // about the expected match fields for the applicable table.  If the
-  // P4Runtime request omits some match fields as "don't care" values,
-  // PrepareMatchFields appends them to the all_match_fields output vector.
-  // Upon successful return, all_match_fields combines the match fields
-  // in the original WriteRequest with any additional don't care fields,
-  // yielding the full set of match fields as specified by table_p4_info.
-  ::util::Status PrepareMatchFields(
-      const ::p4::config::v1::Table& table_p4_info,
-      const ::p4::v1::TableEntry& table_entry,
-      std::vector<::p4::v1::FieldMatch>* all_match_fields) const;
+  // WriteRequest message.  The input plan provides information about the
+  // expected match fields for the applicable table.  If the P4Runtime request
+  // omits some match fields as "don't care" values, PrepareMatchFields appends
+  // the plan's don't care fields to the all_match_fields output.  Upon
+  // successful return, all_match_fields combines the match fields in the
+  // original WriteRequest with any additional don't care fields, yielding the
+  // full set of match fields as specified by the table's P4Info.  The output
+  // points into table_entry and plan.
+  ::util::Status PrepareMatchFields(const P4TableMappingPlan& plan,
+                                    const ::p4::v1::TableEntry& table_entry,
+                                    PlannedMatchFields* all_match_fields) const;
 
   // Processes the identified table and updates table-level flow_entry output.
   // Output always includes table_info with id, name, and type.  If the table's
   // P4Info contains annotations, they are also included in the output.  The
   // output may include internal match fields if they have been defined
   // in the P4PipelineConfig table map.
-  ::util::Status ProcessTableID(const ::p4::config::v1::Table& table_p4_info,
-                                int table_id,
+  ::util::Status ProcessTableID(const P4TableMappingPlan& plan,
                                 CommonFlowEntry* flow_entry) const;
 
   // Processes one match_field from a table entry.  If successful, a new
   // MappedField will be added to flow_entry.
-  ::util::Status ProcessMatchField(const ::p4::config::v1::Table& table_p4_info,
-                                   const ::p4::v1::FieldMatch& match_field,
+  ::util::Status ProcessMatchField(const P4TableMappingPlan& plan,
+                                   const PlannedMatchField& match_field,
                                    CommonFlowEntry* flow_entry) const;
 
   // Processes the action from a table entry.  If successful, the
@@ -507,6 +544,11 @@ class P4TableMapper {
   // This map facilitates table-dependent match field conversions.
   P4FieldConvertByTable field_convert_by_table_;
 
+  // Map from P4 table ID to the table's compiled P4TableMappingPlan.  The
+  // plans refer to entries in global_id_table_map_ and field_convert_by_table_,
+  // so they are rebuilt and cleared along with them.
+  P4TableMappingPlanMap table_plans_;
+
   // Map from packet in (out) metadata ID to the corresponding (type, bitwidth)
   // pair used for parsing the packet in (out) metadata. The ID and bitwidth of
   // metadata are available from P4Info and the type (P4FieldType) is found from
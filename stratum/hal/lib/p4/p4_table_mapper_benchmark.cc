@@ -0,0 +1,163 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// This binary measures the P4TableMapper::MapFlowEntry throughput in entries
+// per second. It pushes the P4Info and P4PipelineConfig from the unit test
+// data, and then repeatedly maps a set of TableEntries which combine explicit
+// and don't-care match fields. Example:
+//   p4_table_mapper_benchmark --num_entries=1000 --num_iterations=1000
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_table_mapper.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_string(p4_info_file,
+              "stratum/hal/lib/p4/testdata/test_p4_info.pb.txt",
+              "Path to the P4Info text file used by the benchmark.");
+DEFINE_string(p4_pipeline_config_file,
+              "stratum/hal/lib/p4/testdata/test_p4_pipeline_config.pb.txt",
+              "Path to the P4PipelineConfig text file used by the benchmark.");
+DEFINE_string(table_name, "test-multi-match-table",
+              "Name of the P4 table the benchmark entries are mapped to. The "
+              "first match field of the table is left out of the entries as a "
+              "don't-care field.");
+DEFINE_int32(num_entries, 1000, "Number of distinct TableEntries to map.");
+DEFINE_int32(num_iterations, 1000,
+             "Number of times each TableEntry is mapped.");
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Builds the TableEntries for the benchmark. Every match field of the table,
+// except the first one, gets a value derived from the entry index.
+::util::Status BuildTableEntries(const ::p4::config::v1::Table& table,
+                                 int num_entries,
+                                 std::vector<::p4::v1::TableEntry>* entries) {
+  if (table.action_refs_size() == 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Table " << table.preamble().name() << " has no actions.";
+  }
+  for (int i = 0; i < num_entries; ++i) {
+    ::p4::v1::TableEntry entry;
+    entry.set_table_id(table.preamble().id());
+    entry.mutable_action()->mutable_action()->set_action_id(
+        table.action_refs(0).id());
+    for (int f = 1; f < table.match_fields_size(); ++f) {
+      const auto& p4info_field = table.match_fields(f);
+      std::string value((p4info_field.bitwidth() + 7) / 8, 0);
+      for (size_t b = 0; b < value.size() && b < sizeof(i); ++b) {
+        value[value.size() - 1 - b] = static_cast<char>((i >> (8 * b)) & 0xff);
+      }
+      auto* match = entry.add_match();
+      match->set_field_id(p4info_field.id());
+      switch (p4info_field.match_type()) {
+        case ::p4::config::v1::MatchField::EXACT:
+          match->mutable_exact()->set_value(value);
+          break;
+        case ::p4::config::v1::MatchField::LPM:
+          match->mutable_lpm()->set_value(value);
+          match->mutable_lpm()->set_prefix_len(p4info_field.bitwidth());
+          break;
+        case ::p4::config::v1::MatchField::TERNARY:
+          match->mutable_ternary()->set_value(value);
+          match->mutable_ternary()->set_mask(std::string(value.size(), 0xff));
+          break;
+        default:
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Unsupported match type for field "
+                 << p4info_field.ShortDebugString() << ".";
+      }
+    }
+    entry.set_priority(i + 1);
+    entries->push_back(entry);
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  InitStratumLogging();
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  RETURN_IF_ERROR(
+      ReadProtoFromTextFile(FLAGS_p4_info_file, config.mutable_p4info()));
+  P4PipelineConfig p4_pipeline_config;
+  RETURN_IF_ERROR(ReadProtoFromTextFile(FLAGS_p4_pipeline_config_file,
+                                        &p4_pipeline_config));
+  CHECK_RETURN_IF_FALSE(p4_pipeline_config.SerializeToString(
+      config.mutable_p4_device_config()));
+  auto p4_table_mapper = P4TableMapper::CreateInstance();
+  RETURN_IF_ERROR(p4_table_mapper->PushForwardingPipelineConfig(config));
+
+  P4InfoManager p4_info_manager(config.p4info());
+  RETURN_IF_ERROR(p4_info_manager.InitializeAndVerify());
+  ASSIGN_OR_RETURN(const auto& table,
+                   p4_info_manager.FindTableByName(FLAGS_table_name));
+  std::vector<::p4::v1::TableEntry> entries;
+  RETURN_IF_ERROR(BuildTableEntries(table, FLAGS_num_entries, &entries));
+
+  // Make sure the entries map cleanly before timing them.
+  CommonFlowEntry flow_entry;
+  for (const auto& entry : entries) {
+    RETURN_IF_ERROR(p4_table_mapper->MapFlowEntry(
+        entry, ::p4::v1::Update::INSERT, &flow_entry));
+  }
+
+  absl::Time start = absl::Now();
+  for (int i = 0; i < FLAGS_num_iterations; ++i) {
+    for (const auto& entry : entries) {
+      p4_table_mapper->MapFlowEntry(entry, ::p4::v1::Update::INSERT,
+                                    &flow_entry)
+          .IgnoreError();
+    }
+  }
+  double secs = absl::ToDoubleSeconds(absl::Now() - start);
+  int64 num_mapped = static_cast<int64>(FLAGS_num_iterations) * entries.size();
+  LOG(INFO) << "Mapped " << num_mapped << " entries of table "
+            << FLAGS_table_name << " in " << secs << " secs ("
+            << (secs > 0 ? num_mapped / secs : 0) << " entries/sec).";
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::util::Status status = stratum::hal::Main(argc, argv);
+  if (status.ok()) {
+    return 0;
+  } else {
+    LOG(ERROR) << status;
+    return 1;
+  }
+}
@@ -1159,6 +1159,77 @@ TEST_F(P4TableMapperTest, TestTableMapMultipleFieldsDontCareExact) {
               HasSubstr("P4 MatchType EXACT has no default value"));
 }
 
+// Tests that the mapped fields follow the request order, with the don't-care
+// fields appended in P4Info order.
+TEST_F(P4TableMapperTest, TestTableMapMultipleFieldsOrder) {
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  SetUpMultiMatchFieldTest("test-multi-match-table");
+  ASSERT_EQ(3, table_.match_fields_size());
+
+  // This test reverses the ternary and exact fields and leaves out the LPM
+  // field.
+  const ::p4::v1::FieldMatch exact_field = table_entry_.match(1);
+  const ::p4::v1::FieldMatch ternary_field = table_entry_.match(2);
+  table_entry_.mutable_match()->Clear();
+  *table_entry_.add_match() = ternary_field;
+  *table_entry_.add_match() = exact_field;
+
+  CommonFlowEntry flow_entry;
+  auto map_status = p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry);
+  EXPECT_OK(map_status);
+  ASSERT_EQ(3, flow_entry.fields_size());
+  EXPECT_EQ(table_.match_fields(2).bitwidth(),
+            flow_entry.fields(0).bit_width());
+  EXPECT_EQ(table_.match_fields(1).bitwidth(),
+            flow_entry.fields(1).bit_width());
+  EXPECT_EQ(table_.match_fields(0).bitwidth(),
+            flow_entry.fields(2).bit_width());
+}
+
+// Tests mapping of duplicate field IDs that are not in the table's P4Info.
+TEST_F(P4TableMapperTest, TestTableMapDuplicateUnknownFieldID) {
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  SetUpMultiMatchFieldTest("test-multi-match-table");
+  table_entry_.mutable_match(0)->set_field_id(0xfff);
+  table_entry_.mutable_match(2)->set_field_id(0xfff);
+
+  CommonFlowEntry flow_entry;
+  auto map_status = p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry);
+  EXPECT_FALSE(map_status.ok());
+  EXPECT_EQ(ERR_INVALID_PARAM, map_status.error_code());
+  EXPECT_THAT(map_status.error_message(), HasSubstr("multiple match field"));
+}
+
+// Tests that table entries are mapped after a new pipeline config is pushed.
+TEST_F(P4TableMapperTest, TestTableMapAfterPipelineConfigChange) {
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  SetUpMultiMatchFieldTest("test-multi-match-table");
+  CommonFlowEntry flow_entry;
+  ASSERT_OK(p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry));
+
+  // The new P4Info drops the table's last match field, so the mapping should
+  // no longer recognize it.
+  auto* p4_info = forwarding_pipeline_config_.mutable_p4info();
+  for (auto& table : *p4_info->mutable_tables()) {
+    if (table.preamble().id() == table_.preamble().id()) {
+      table.mutable_match_fields()->RemoveLast();
+    }
+  }
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  auto map_status = p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry);
+  EXPECT_FALSE(map_status.ok());
+  EXPECT_EQ(ERR_OPER_NOT_SUPPORTED, map_status.error_code());
+  EXPECT_THAT(map_status.error_message(), HasSubstr("is not recognized"));
+}
+
 // Tests mapping of an action with no encoded action function or profile IDs.
 TEST_F(P4TableMapperTest, TestTableMissingActionData) {
   ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
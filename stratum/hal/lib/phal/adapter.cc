@@ -37,6 +37,16 @@ namespace phal {
   return db_query;
 }
 
+::util::StatusOr<std::unique_ptr<Query>> Adapter::SubscribeToChanges(
+    const std::vector<Path>& paths,
+    std::unique_ptr<ChannelWriter<PhalDBUpdate>> writer,
+    absl::Duration poll_time, absl::Duration snapshot_interval) {
+  ASSIGN_OR_RETURN(auto db_query, database_->MakeQuery(paths));
+  RETURN_IF_ERROR(db_query->SubscribeToChanges(std::move(writer), poll_time,
+                                               snapshot_interval));
+  return db_query;
+}
+
 ::util::Status Adapter::Set(const AttributeValueMap& attrs) {
   return database_->Set(attrs);
 }
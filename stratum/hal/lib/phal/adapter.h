@@ -48,6 +48,12 @@ class Adapter {
       const std::vector<Path>& paths,
       std::unique_ptr<ChannelWriter<PhalDB>> writer, absl::Duration poll_time);
 
+  // Convenience function to subscribe to the changes in the database.
+  ::util::StatusOr<std::unique_ptr<Query>> SubscribeToChanges(
+      const std::vector<Path>& paths,
+      std::unique_ptr<ChannelWriter<PhalDBUpdate>> writer,
+      absl::Duration poll_time, absl::Duration snapshot_interval);
+
   // Convenience function to Set values in the database.
   ::util::Status Set(const AttributeValueMap& values);
 
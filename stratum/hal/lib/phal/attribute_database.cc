@@ -24,15 +24,17 @@
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
-#include "google/protobuf/util/message_differencer.h"
 #include "stratum/glue/status/status_macros.h"
-#include "stratum/hal/lib/phal/dummy_threadpool.h"
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 
 DEFINE_string(phal_config_path, "",
               "The path to read the PhalInitConfig proto file from.");
+DEFINE_int32(phal_threadpool_size, 8,
+             "Number of threads used to refresh the PHAL datasources of a "
+             "query in parallel.");
 
 namespace stratum {
 namespace hal {
@@ -63,17 +65,19 @@ DatabaseQuery::~DatabaseQuery() {
   // Update the polling time first. Otherwise if a query starts failing
   // repeatedly we'll just busy loop on it forever.
   last_polling_time_ = poll_time;
+  // Periodic snapshots are sent even if nothing changed.
+  for (const auto& subscriber : change_subscribers_) {
+    if (subscriber.next_snapshot_time <= poll_time) query_.MarkUpdated();
+  }
   // If the query is already marked as updated (e.g. due to a runtime
   // configurator), it's a waste of time to check for updates.
   if (!query_.IsUpdated()) {
-    // If the result of this query has changed, set the update bit.
-    ASSIGN_OR_RETURN(auto polling_result, Get());
-    if (last_polling_result_ == nullptr ||
-        !google::protobuf::util::MessageDifferencer::Equals(
-                                    *last_polling_result_, *polling_result)) {
-      query_.MarkUpdated();
-      last_polling_result_ = std::move(polling_result);
-    }
+    // Executing the query sets the update bit if any attribute changed since
+    // the last execution.
+    RETURN_IF_ERROR(query_.Refresh());
+    result_is_fresh_ = true;
+    if (!has_result_) query_.MarkUpdated();
+    has_result_ = true;
   }
   return ::util::OkStatus();
 }
@@ -97,6 +101,22 @@ DatabaseQuery::~DatabaseQuery() {
   return ::util::OkStatus();
 }
 
+::util::Status DatabaseQuery::SubscribeToChanges(
+    std::unique_ptr<ChannelWriter<PhalDBUpdate>> subscriber,
+    absl::Duration polling_interval, absl::Duration snapshot_interval) {
+  CHECK_RETURN_IF_FALSE(snapshot_interval > absl::ZeroDuration())
+      << "Invalid snapshot interval " << snapshot_interval << ".";
+  absl::MutexLock lock(&database_->polling_lock_);
+  query_.TrackChanges();
+  // The first message sent to the new subscriber is a full snapshot.
+  change_subscribers_.push_back({std::move(subscriber), polling_interval,
+                                 snapshot_interval, absl::InfinitePast()});
+  query_.MarkUpdated();
+  RecalculatePollingInterval();
+  database_->polling_condvar_.Signal();
+  return ::util::OkStatus();
+}
+
 void DatabaseQuery::RecalculatePollingInterval() {
   // This uses a naive linear algorithm rather than anything more fancy because
   // we're unlikely to every have more than 2 or 3 subscribers on a single
@@ -107,14 +127,66 @@ void DatabaseQuery::RecalculatePollingInterval() {
     if (subscriber_interval < polling_interval_)
       polling_interval_ = subscriber_interval;
   }
+  for (const auto& subscriber : change_subscribers_) {
+    if (subscriber.polling_interval < polling_interval_)
+      polling_interval_ = subscriber.polling_interval;
+  }
 }
 
 ::util::Status DatabaseQuery::UpdateSubscribers() {
-  ASSIGN_OR_RETURN(auto polling_result, Get());
+  if (!result_is_fresh_) RETURN_IF_ERROR(query_.Refresh());
+  has_result_ = true;
+  // The whole result is only copied if some subscriber needs it.
+  std::unique_ptr<PhalDB> result;
+  auto get_result = [this, &result]() -> const PhalDB& {
+    if (result == nullptr) {
+      result = absl::make_unique<PhalDB>();
+      query_.GetLastResult(result.get());
+    }
+    return *result;
+  };
   bool subscribers_removed = false;
+
+  // The changes are consumed by TakeChanges, so the subscribers of the changes
+  // are all updated before any error is returned. A subscriber which misses an
+  // update gets a full snapshot next time.
+  ::util::Status change_status = ::util::OkStatus();
+  if (!change_subscribers_.empty()) {
+    PhalDBUpdate changes;
+    bool changes_complete = query_.TakeChanges(
+        changes.mutable_phal_db(), changes.mutable_changed_paths());
+    PhalDBUpdate snapshot;
+    absl::Time now = absl::Now();
+    for (unsigned int i = 0; i < change_subscribers_.size(); i++) {
+      ChangeSubscriber& subscriber = change_subscribers_[i];
+      const PhalDBUpdate* update = &changes;
+      if (!changes_complete || subscriber.next_snapshot_time <= now) {
+        if (!snapshot.full_snapshot()) {
+          snapshot.set_full_snapshot(true);
+          *snapshot.mutable_phal_db() = get_result();
+        }
+        update = &snapshot;
+        subscriber.next_snapshot_time = now + subscriber.snapshot_interval;
+      } else if (changes.changed_paths_size() == 0) {
+        continue;
+      }
+      ::util::Status write_result = subscriber.writer->TryWrite(*update);
+      if (!write_result.ok()) {
+        if (subscriber.writer->IsClosed()) {
+          change_subscribers_.erase(change_subscribers_.begin() + i);
+          i--;
+          subscribers_removed = true;
+        } else {
+          subscriber.next_snapshot_time = absl::InfinitePast();
+          APPEND_STATUS_IF_ERROR(change_status, write_result);
+        }
+      }
+    }
+  }
+
   for (unsigned int i = 0; i < subscribers_.size(); i++) {
     ChannelWriter<PhalDB>* channel = subscribers_[i].first.get();
-    ::util::Status write_result = channel->TryWrite(*polling_result);
+    ::util::Status write_result = channel->TryWrite(get_result());
     if (!write_result.ok()) {
       // This failure may be due to the channel closing, which is the expected
       // unsubscribe mechanism. Otherwise, this is considered an error.
@@ -128,8 +200,10 @@ void DatabaseQuery::RecalculatePollingInterval() {
     }
   }
   if (subscribers_removed) RecalculatePollingInterval();
+  if (!change_status.ok()) {
+    return APPEND_ERROR(change_status) << " Failed to update subscribers.";
+  }
   query_.ClearUpdated();
-  last_polling_result_ = std::move(polling_result);
   return ::util::OkStatus();
 }
 
@@ -205,7 +279,8 @@ AttributeDatabase::~AttributeDatabase() {
 AttributeDatabase::MakePhalDb(std::unique_ptr<AttributeGroup> root_group) {
   ASSIGN_OR_RETURN(
       std::unique_ptr<AttributeDatabase> database,
-      Make(std::move(root_group), absl::make_unique<DummyThreadpool>()));
+      Make(std::move(root_group), absl::make_unique<WorkStealingThreadpool>(
+                                      FLAGS_phal_threadpool_size)));
 
   // Create and run PhalDb service
   {
@@ -338,6 +413,8 @@ absl::Time AttributeDatabase::GetNextPollingTime() {
     if (query->InternalQuery()->IsUpdated()) {
       APPEND_STATUS_IF_ERROR(flush_result, query->UpdateSubscribers());
     }
+    // Whatever was read by PollQueries is stale by the next round.
+    query->result_is_fresh_ = false;
   }
   return flush_result;
 }
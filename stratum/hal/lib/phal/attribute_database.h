@@ -159,22 +159,39 @@ class DatabaseQuery : public Query {
   ::util::StatusOr<std::unique_ptr<PhalDB>> Get() override;
   ::util::Status Subscribe(std::unique_ptr<ChannelWriter<PhalDB>> subscriber,
                            absl::Duration polling_interval) override;
+  ::util::Status SubscribeToChanges(
+      std::unique_ptr<ChannelWriter<PhalDBUpdate>> subscriber,
+      absl::Duration polling_interval,
+      absl::Duration snapshot_interval) override;
 
   // Polls this query to see if the result has changed since the last time Poll
   // was called. If the result has changed, sets the update bit in the internal
-  // AttributeGroupQuery.
+  // AttributeGroupQuery. Only the versions of the attributes are compared, the
+  // whole result is not rebuilt.
   ::util::Status Poll(absl::Time poll_time);
   AttributeGroupQuery* InternalQuery() { return &query_; }
   // Returns the next time we're supposed to poll this query, based on the
   // polling intervals requested by subscribers.
   absl::Time GetNextPollingTime();
-  // Executes this query and sends the result to every subscriber. If any
-  // subscriber channels have closed, performs all necessary cleanup.
+  // Sends the result of this query to every subscriber, and the changes since
+  // the last update to the subscribers of the changes. The query is executed
+  // first unless it was just executed by Poll. If any subscriber channels have
+  // closed, performs all necessary cleanup.
   ::util::Status UpdateSubscribers();
 
  private:
   friend class AttributeDatabase;
 
+  // A subscriber to the changes of the result of this query.
+  struct ChangeSubscriber {
+    std::unique_ptr<ChannelWriter<PhalDBUpdate>> writer;
+    absl::Duration polling_interval;
+    absl::Duration snapshot_interval;
+    // The time at which the next full snapshot is due. InfinitePast if the
+    // next update must be a full snapshot.
+    absl::Time next_snapshot_time;
+  };
+
   DatabaseQuery(AttributeDatabase* database, AttributeGroup* root_group,
                 ThreadpoolInterface* threadpool);
 
@@ -190,11 +207,18 @@ class DatabaseQuery : public Query {
   // interval they requested.
   std::vector<std::pair<std::unique_ptr<ChannelWriter<PhalDB>>, absl::Duration>>
       subscribers_;
+  std::vector<ChangeSubscriber> change_subscribers_;
   // The minimum polling interval requested by any subscriber to this query.
   absl::Duration polling_interval_ = absl::InfiniteDuration();
 
   absl::Time last_polling_time_;
-  std::unique_ptr<PhalDB> last_polling_result_;
+  // True once this query was executed by Poll or UpdateSubscribers. The first
+  // poll always marks the query as updated.
+  bool has_result_ = false;
+  // True if Poll executed this query since the last round of updates, so the
+  // result does not need to be read again to update the subscribers. Reset by
+  // AttributeDatabase::FlushQueries.
+  bool result_is_fresh_ = false;
 };
 
 }  // namespace phal
@@ -117,6 +117,15 @@ class Query {
   virtual ::util::Status Subscribe(
       std::unique_ptr<ChannelWriter<PhalDB>> subscriber,
       absl::Duration polling_interval) = 0;
+  // Like Subscribe, but only sends the attributes whose value changed instead
+  // of the whole query result. The first message is a full snapshot of the
+  // result. A full snapshot is also sent whenever the changes cannot be
+  // expressed as a list of changed attributes (e.g. a transceiver was removed),
+  // and every snapshot_interval if it is not infinite, so that subscribers
+  // which missed an update eventually catch up.
+  virtual ::util::Status SubscribeToChanges(
+      std::unique_ptr<ChannelWriter<PhalDBUpdate>> subscriber,
+      absl::Duration polling_interval, absl::Duration snapshot_interval) = 0;
 
  protected:
   Query() {}
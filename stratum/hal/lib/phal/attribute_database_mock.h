@@ -42,6 +42,11 @@ class QueryMock : public Query {
   MOCK_METHOD2(Subscribe,
                ::util::Status(std::unique_ptr<ChannelWriter<PhalDB>> subscriber,
                               absl::Duration polling_interval));
+  MOCK_METHOD3(SubscribeToChanges,
+               ::util::Status(
+                   std::unique_ptr<ChannelWriter<PhalDBUpdate>> subscriber,
+                   absl::Duration polling_interval,
+                   absl::Duration snapshot_interval));
 };
 
 }  // namespace phal
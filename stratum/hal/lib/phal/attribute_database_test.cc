@@ -24,6 +24,7 @@
 #include "stratum/lib/channel/channel_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
@@ -39,6 +40,7 @@ namespace phal {
 using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::A;
+using ::testing::Property;
 using ::testing::Return;
 using ::testing::StrictMock;
 
@@ -78,6 +80,10 @@ class AttributeDatabaseTest : public ::testing::Test {
 
 namespace {
 
+::testing::Matcher<const PhalDBUpdate&> IsFullSnapshot() {
+  return Property(&PhalDBUpdate::full_snapshot, true);
+}
+
 std::vector<Path> GetTestPath() {
   return {{
       PathEntry("cards", 0),
@@ -214,6 +220,85 @@ TEST_F(AttributeDatabaseTest, QueryFlushClearsUpdatedQueries) {
   query = nullptr;
 }
 
+TEST_F(AttributeDatabaseTest, ChangeSubscribersGetSnapshotThenChanges) {
+  EXPECT_CALL(*mock_group_, RegisterQuery(_, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Query> query,
+                       database_->MakeQuery(GetTestPath()));
+
+  DatabaseQuery* db_query = reinterpret_cast<DatabaseQuery*>(query.get());
+  auto writer = absl::make_unique<ChannelWriterMock<PhalDBUpdate>>();
+  ChannelWriterMock<PhalDBUpdate>* writer_ptr = writer.get();
+  EXPECT_OK(db_query->SubscribeToChanges(std::move(writer), absl::Seconds(1),
+                                         absl::Hours(1)));
+  EXPECT_TRUE(db_query->InternalQuery()->IsUpdated());
+  EXPECT_LT(db_query->GetNextPollingTime(), absl::InfiniteFuture());
+
+  // The first update is a full snapshot.
+  EXPECT_CALL(*mock_group_, TraverseQuery(_, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*writer_ptr, TryWrite(IsFullSnapshot()))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(FlushQueries());
+  EXPECT_FALSE(db_query->InternalQuery()->IsUpdated());
+
+  // Nothing changed since the snapshot, so nothing is sent.
+  db_query->InternalQuery()->MarkUpdated();
+  EXPECT_CALL(*mock_group_, TraverseQuery(_, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(FlushQueries());
+  EXPECT_FALSE(db_query->InternalQuery()->IsUpdated());
+
+  EXPECT_CALL(*mock_group_, UnregisterQuery(_)).WillOnce(Return());
+  query = nullptr;
+}
+
+TEST_F(AttributeDatabaseTest, ChangeSubscriberGetsSnapshotAfterFailedWrite) {
+  EXPECT_CALL(*mock_group_, RegisterQuery(_, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Query> query,
+                       database_->MakeQuery(GetTestPath()));
+
+  DatabaseQuery* db_query = reinterpret_cast<DatabaseQuery*>(query.get());
+  auto writer = absl::make_unique<ChannelWriterMock<PhalDBUpdate>>();
+  ChannelWriterMock<PhalDBUpdate>* writer_ptr = writer.get();
+  EXPECT_OK(db_query->SubscribeToChanges(std::move(writer), absl::Seconds(1),
+                                         absl::Hours(1)));
+
+  // The channel is full.
+  EXPECT_CALL(*mock_group_, TraverseQuery(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*writer_ptr, TryWrite(IsFullSnapshot()))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_NO_RESOURCE,
+                                      "Channel full.")))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*writer_ptr, IsClosed()).WillOnce(Return(false));
+  EXPECT_FALSE(FlushQueries().ok());
+  EXPECT_TRUE(db_query->InternalQuery()->IsUpdated());
+  // The snapshot is sent again even though nothing changed.
+  EXPECT_OK(FlushQueries());
+  EXPECT_FALSE(db_query->InternalQuery()->IsUpdated());
+
+  EXPECT_CALL(*mock_group_, UnregisterQuery(_)).WillOnce(Return());
+  query = nullptr;
+}
+
+TEST_F(AttributeDatabaseTest, ChangeSubscriptionRejectsInvalidSnapshotInterval) {
+  EXPECT_CALL(*mock_group_, RegisterQuery(_, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Query> query,
+                       database_->MakeQuery(GetTestPath()));
+  EXPECT_FALSE(query
+                   ->SubscribeToChanges(
+                       absl::make_unique<ChannelWriterMock<PhalDBUpdate>>(),
+                       absl::Seconds(1), absl::ZeroDuration())
+                   .ok());
+
+  EXPECT_CALL(*mock_group_, UnregisterQuery(_)).WillOnce(Return());
+  query = nullptr;
+}
+
 /* FIXME(boc) google only
 // Run a few tests using an end-to-end attribute database with a fake system.
 // These tests take a bit longer (~1 sec) because they are exercising all of the
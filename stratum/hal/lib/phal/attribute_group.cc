@@ -44,16 +44,22 @@ namespace phal {
 // Query is deleted.
 class AttributeGroupQueryNode {
  public:
+  // The field and index (-1 for singular fields) of each child group on the
+  // way from the root of the query result to a node.
+  using Location =
+      std::vector<std::pair<const google::protobuf::FieldDescriptor*, int>>;
+
   AttributeGroupQueryNode() {}
   explicit AttributeGroupQueryNode(AttributeGroupQuery* root_query)
       : parent_query_(root_query),
         node_(root_query->query_result_.get()),
         reflection_(node_->GetReflection()) {}
   AttributeGroupQueryNode(AttributeGroupQuery* parent_query,
-                          google::protobuf::Message* node)
+                          google::protobuf::Message* node, Location location)
       : parent_query_(parent_query),
         node_(node),
-        reflection_(node->GetReflection()) {}
+        reflection_(node->GetReflection()),
+        location_(std::move(location)) {}
 
   // These functions will check to make sure that adding the given field to the
   // query proto is a valid operation, but under normal circumstances this check
@@ -81,9 +87,18 @@ class AttributeGroupQueryNode {
     return descriptor;
   }
 
+  // Records that the given attribute field of this node was written, and marks
+  // the query as updated. Returns the node corresponding to this one in the
+  // changes recorded by the query, or nullptr if the query does not track its
+  // changes. Only called by the attribute setters, while the query is being
+  // executed and holds its query_lock_.
+  google::protobuf::Message* RecordChange(
+      const google::protobuf::FieldDescriptor* field) NO_THREAD_SAFETY_ANALYSIS;
+
   AttributeGroupQuery* parent_query_;
   google::protobuf::Message* node_;
   const google::protobuf::Reflection* reflection_;
+  Location location_;
 };
 
 namespace {
@@ -303,6 +318,10 @@ class AttributeGroupInternal : public AttributeGroup,
         << "Found mismatched types for an attribute database field. "        \
         << "This indicates serious attribute database corruption.";          \
     reflection_->proto_setter_function(this->node_, field, *typed_value);    \
+    google::protobuf::Message* change = RecordChange(field);                 \
+    if (change != nullptr) {                                                 \
+      reflection_->proto_setter_function(change, field, *typed_value);       \
+    }                                                                        \
     /* Lambda returns success. */                                            \
     return ::util::OkStatus();                                               \
   })
@@ -358,8 +377,11 @@ AttributeGroupQueryNode::AddChildGroup(const std::string& name) {
       !field->is_repeated())
       << "Called AddChildGroup for \"" << name
       << "\", which is not a singular child group. This shouldn't happen!";
+  Location location = location_;
+  location.emplace_back(field, -1);
   return AttributeGroupQueryNode(parent_query_,
-                                 reflection_->MutableMessage(node_, field));
+                                 reflection_->MutableMessage(node_, field),
+                                 std::move(location));
 }
 
 ::util::StatusOr<AttributeGroupQueryNode>
@@ -378,8 +400,11 @@ AttributeGroupQueryNode::AddRepeatedChildGroup(const std::string& name,
   int current_field_count = reflection_->FieldSize(*node_, field);
   for (int i = current_field_count; i <= idx; i++)
     reflection_->AddMessage(node_, field);
+  Location location = location_;
+  location.emplace_back(field, idx);
   return AttributeGroupQueryNode(
-      parent_query_, reflection_->MutableRepeatedMessage(node_, field, idx));
+      parent_query_, reflection_->MutableRepeatedMessage(node_, field, idx),
+      std::move(location));
 }
 
 ::util::Status AttributeGroupQueryNode::RemoveField(const std::string& name) {
@@ -388,15 +413,50 @@ AttributeGroupQueryNode::AddRepeatedChildGroup(const std::string& name,
   ASSIGN_OR_RETURN(auto field, GetFieldDescriptor(name));
   parent_query_->query_updated_ = true;
   reflection_->ClearField(node_, field);
+  parent_query_->ResetVersions();
   return ::util::OkStatus();
 }
 
 void AttributeGroupQueryNode::RemoveAllFields() {
   absl::MutexLock lock(&parent_query_->query_lock_);
   node_->Clear();
+  parent_query_->ResetVersions();
+}
+
+google::protobuf::Message* AttributeGroupQueryNode::RecordChange(
+    const google::protobuf::FieldDescriptor* field) {
+  parent_query_->query_updated_ = true;
+  google::protobuf::Message* change = parent_query_->changes_.get();
+  if (change == nullptr) return nullptr;
+  PathQuery* path = parent_query_->changed_paths_.Add();
+  for (const auto& group_and_idx : location_) {
+    const google::protobuf::FieldDescriptor* group = group_and_idx.first;
+    int idx = group_and_idx.second;
+    const google::protobuf::Reflection* reflection = change->GetReflection();
+    PathQuery::PathEntry* entry = path->add_entries();
+    entry->set_name(group->name());
+    if (idx < 0) {
+      change = reflection->MutableMessage(change, group);
+    } else {
+      entry->set_index(idx);
+      entry->set_indexed(true);
+      // Keep the indices of the query result.
+      for (int i = reflection->FieldSize(*change, group); i <= idx; i++)
+        reflection->AddMessage(change, group);
+      change = reflection->MutableRepeatedMessage(change, group, idx);
+    }
+  }
+  path->add_entries()->set_name(field->name());
+  return change;
 }
 
 ::util::Status AttributeGroupQuery::Get(google::protobuf::Message* out) {
+  return Execute(out);
+}
+
+::util::Status AttributeGroupQuery::Refresh() { return Execute(nullptr); }
+
+::util::Status AttributeGroupQuery::Execute(google::protobuf::Message* out) {
   std::queue<std::unique_ptr<ReadableAttributeGroup>> group_locks;
   absl::flat_hash_map<
       DataSource*,
@@ -415,39 +475,93 @@ void AttributeGroupQueryNode::RemoveAllFields() {
       }));
   // We now hold locks on all of the attribute groups relevant to this query,
   // and have a list of all the datasources and attributes we'll need to touch.
-  // We can now execute our query in a threadpool.
+  // We can now execute our query in a threadpool. Each datasource is refreshed
+  // by its own task, so the slow datasource updates run in parallel. Each task
+  // holds the data_lock_ of its datasource only. The setters all write into
+  // query_result_, so they are serialized by output_lock. The attributes which
+  // did not change since the last execution are already in query_result_ and
+  // are skipped.
   ::util::Status output_status;
-  absl::Mutex output_status_lock;
+  absl::Mutex output_lock;
   {
     // We acquire our query lock to avoid messy interleaving with other calls to
     // Get().
     absl::MutexLock l(&query_lock_);
     threadpool_->Start();
-    std::vector<TaskId> task_ids(datasources.size());
+    std::vector<TaskId> task_ids;
+    task_ids.reserve(datasources.size());
     for (auto& datasource_and_attributes : datasources) {
       task_ids.push_back(threadpool_->Schedule([&]() {
         ::util::Status update_status =
             datasource_and_attributes.first->UpdateValuesAndLock();
+        absl::MutexLock l(&output_lock);
         if (update_status.ok()) {
           for (auto& attribute_and_setter : datasource_and_attributes.second) {
-            update_status = (*attribute_and_setter.second)(
-                attribute_and_setter.first->GetValue());
+            APPEND_STATUS_IF_ERROR(
+                output_status,
+                WriteAttributeIfChanged(attribute_and_setter.first,
+                                        *attribute_and_setter.second));
           }
-        }
-        if (!update_status.ok()) {
-          absl::MutexLock l(&output_status_lock);
+        } else {
           APPEND_STATUS_IF_ERROR(output_status, update_status);
         }
         datasource_and_attributes.first->Unlock();
       }));
     }
     threadpool_->WaitAll(task_ids);
-    out->CopyFrom(*query_result_);
+    if (out != nullptr) out->CopyFrom(*query_result_);
   }
   while (!group_locks.empty()) group_locks.pop();
   return output_status;
 }
 
+::util::Status AttributeGroupQuery::WriteAttributeIfChanged(
+    ManagedAttribute* attribute, const AttributeSetterFunction& setter) {
+  uint64 version = attribute->GetVersion();
+  auto last_version = attribute_versions_.find(attribute);
+  if (last_version != attribute_versions_.end() &&
+      last_version->second == version) {
+    return ::util::OkStatus();
+  }
+  RETURN_IF_ERROR(setter(attribute->GetValue()));
+  attribute_versions_[attribute] = version;
+  return ::util::OkStatus();
+}
+
+void AttributeGroupQuery::GetLastResult(google::protobuf::Message* out) {
+  absl::MutexLock lock(&query_lock_);
+  out->CopyFrom(*query_result_);
+}
+
+void AttributeGroupQuery::TrackChanges() {
+  absl::MutexLock lock(&query_lock_);
+  if (changes_ != nullptr) return;
+  changes_.reset(query_result_->New());
+  // Nothing was recorded so far.
+  changes_complete_ = false;
+}
+
+bool AttributeGroupQuery::TakeChanges(
+    google::protobuf::Message* changes,
+    google::protobuf::RepeatedPtrField<PathQuery>* changed_paths) {
+  absl::MutexLock lock(&query_lock_);
+  if (changes_ == nullptr) return false;
+  bool complete = changes_complete_;
+  if (complete) {
+    changes->GetReflection()->Swap(changes, changes_.get());
+    changed_paths->Swap(&changed_paths_);
+  }
+  changes_->Clear();
+  changed_paths_.Clear();
+  changes_complete_ = true;
+  return complete;
+}
+
+void AttributeGroupQuery::ResetVersions() {
+  attribute_versions_.clear();
+  changes_complete_ = false;
+}
+
 ::util::Status AttributeGroupQuery::Subscribe(
     std::unique_ptr<ChannelWriter<PhalDB>> subscriber,
     absl::Duration polling_interval) {
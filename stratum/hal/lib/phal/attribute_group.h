@@ -234,6 +234,27 @@ class AttributeGroupQuery {
   // same type used for the descriptor of root_group.
   ::util::Status Get(google::protobuf::Message* out)
     LOCKS_EXCLUDED(query_lock_);
+  // Executes this query without copying out the result. The query result is
+  // kept between executions, and only the attributes whose version changed
+  // since they were last read are written into it. Writing any attribute marks
+  // this query as updated.
+  ::util::Status Refresh() LOCKS_EXCLUDED(query_lock_);
+  // Copies the result of the last execution of this query into the given
+  // protobuf, without reading the attribute database.
+  void GetLastResult(google::protobuf::Message* out)
+      LOCKS_EXCLUDED(query_lock_);
+  // Starts recording the attributes written by each execution of this query,
+  // so they can be retrieved with TakeChanges.
+  void TrackChanges() LOCKS_EXCLUDED(query_lock_);
+  // Moves the attributes written since the last call to TakeChanges (or to
+  // TrackChanges) into changes, and appends their paths to changed_paths.
+  // Returns false if the result of this query changed in ways which cannot be
+  // expressed as a list of written attributes, e.g. because some attributes
+  // were removed. The whole result should be used instead in this case.
+  bool TakeChanges(
+      google::protobuf::Message* changes,
+      google::protobuf::RepeatedPtrField<PathQuery>* changed_paths)
+      LOCKS_EXCLUDED(query_lock_);
   ::util::Status Subscribe(std::unique_ptr<ChannelWriter<PhalDB>> subscriber,
                            absl::Duration polling_interval)
       LOCKS_EXCLUDED(query_lock_);
@@ -245,6 +266,19 @@ class AttributeGroupQuery {
  private:
   friend class AttributeGroupQueryNode;
 
+  // Executes this query, and copies the result into out if it is not nullptr.
+  ::util::Status Execute(google::protobuf::Message* out)
+      LOCKS_EXCLUDED(query_lock_);
+  // Writes the given attribute into query_result_ if its version changed since
+  // it was last written. Called by the threadpool tasks of Execute, which holds
+  // query_lock_ on their behalf.
+  ::util::Status WriteAttributeIfChanged(ManagedAttribute* attribute,
+                                         const AttributeSetterFunction& setter)
+      NO_THREAD_SAFETY_ANALYSIS;
+  // Must be called whenever parts of query_result_ are removed. All of the
+  // attributes are written again by the next execution of this query.
+  void ResetVersions() EXCLUSIVE_LOCKS_REQUIRED(query_lock_);
+
   AttributeGroup* root_group_;
   ThreadpoolInterface* threadpool_;
   std::unique_ptr<google::protobuf::Message> query_result_;
@@ -252,6 +286,17 @@ class AttributeGroupQuery {
   // If true, the result of this query has changed and a streaming message
   // should shortly be sent to all subscribers.
   bool query_updated_ GUARDED_BY(query_lock_) = false;
+  // The version of each attribute when it was last written into
+  // query_result_.
+  absl::flat_hash_map<const ManagedAttribute*, uint64> attribute_versions_
+      GUARDED_BY(query_lock_);
+  // The attributes written since the last call to TakeChanges, and their
+  // paths. changes_ is nullptr until TrackChanges is called.
+  std::unique_ptr<google::protobuf::Message> changes_ GUARDED_BY(query_lock_);
+  google::protobuf::RepeatedPtrField<PathQuery> changed_paths_
+      GUARDED_BY(query_lock_);
+  // False if the changes recorded in changes_ are incomplete.
+  bool changes_complete_ GUARDED_BY(query_lock_) = false;
 };
 
 }  // namespace phal
@@ -14,7 +14,10 @@
 // limitations under the License.
 
 
+#include <atomic>
 #include <memory>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/phal/attribute_group.h"
@@ -25,10 +28,13 @@
 #include "stratum/hal/lib/phal/managed_attribute_mock.h"
 #include "stratum/hal/lib/phal/test/test.pb.h"
 #include "stratum/hal/lib/phal/test_util.h"
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/integral_types.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 namespace stratum {
 namespace hal {
@@ -1039,6 +1045,253 @@ TEST_F(AttributeGroupSetTest, CannotSetUnsettableAttribute) {
   EXPECT_FALSE(group_->Set({{path, 1234}}, &threadpool).ok());
 }
 
+// A datasource which takes a while to read its only attribute, like a slow
+// I2C or sysfs read.
+class SlowDataSource : public DataSource {
+ public:
+  static std::shared_ptr<SlowDataSource> Make(int32 value,
+                                              absl::Duration delay) {
+    return std::shared_ptr<SlowDataSource>(new SlowDataSource(value, delay));
+  }
+  ManagedAttribute* GetAttribute() { return &value_; }
+  // Changes the value read by the next update.
+  void SetValue(int32 value) { raw_value_ = value; }
+
+ protected:
+  SlowDataSource(int32 value, absl::Duration delay)
+      : DataSource(new NoCache()),
+        value_(TypedAttribute<int32>(this)),
+        raw_value_(value),
+        delay_(delay) {}
+  ::util::Status UpdateValues() override {
+    absl::SleepFor(delay_);
+    value_.AssignValue(raw_value_);
+    return ::util::OkStatus();
+  }
+
+ private:
+  TypedAttribute<int32> value_;
+  std::atomic<int32> raw_value_;
+  const absl::Duration delay_;
+};
+
+// Queries many slow datasources with the given threadpool, checks the result
+// and returns the time taken by the query.
+absl::Duration QuerySlowDataSources(AttributeGroup* group, int num_datasources,
+                                    ThreadpoolInterface* threadpool) {
+  AttributeGroupQuery query(group, threadpool);
+  std::vector<Path> paths;
+  for (int i = 0; i < num_datasources; ++i) {
+    paths.push_back({PathEntry("repeated_sub", i), PathEntry("val1")});
+  }
+  EXPECT_OK(group->AcquireReadable()->RegisterQuery(&query, paths));
+  TestTop result;
+  absl::Time start = absl::Now();
+  EXPECT_OK(query.Get(&result));
+  absl::Duration duration = absl::Now() - start;
+  EXPECT_EQ(num_datasources, result.repeated_sub_size());
+  for (int i = 0; i < result.repeated_sub_size(); ++i) {
+    EXPECT_EQ(i, result.repeated_sub(i).val1());
+  }
+  return duration;
+}
+
+TEST_F(AttributeGroupQueryTest, SlowDataSourcesAreUpdatedInParallel) {
+  constexpr int kNumDataSources = 32;
+  constexpr int kNumThreads = 8;
+  const absl::Duration kDelay = absl::Milliseconds(20);
+  {
+    auto mutable_group = group_->AcquireMutable();
+    for (int i = 0; i < kNumDataSources; ++i) {
+      auto datasource = SlowDataSource::Make(i, kDelay);
+      managed_datasources_.push_back(datasource);
+      ASSERT_OK_AND_ASSIGN(auto repeated_sub,
+                           mutable_group->AddRepeatedChildGroup("repeated_sub"));
+      ASSERT_OK(repeated_sub->AcquireMutable()->AddAttribute(
+          "val1", datasource->GetAttribute()));
+    }
+  }
+
+  DummyThreadpool dummy_threadpool;
+  absl::Duration serial =
+      QuerySlowDataSources(group_.get(), kNumDataSources, &dummy_threadpool);
+  EXPECT_GE(serial, kNumDataSources * kDelay);
+  WorkStealingThreadpool threadpool(kNumThreads);
+  // Query several times to check that the threadpool can be reused.
+  for (int i = 0; i < 3; ++i) {
+    absl::Duration parallel =
+        QuerySlowDataSources(group_.get(), kNumDataSources, &threadpool);
+    LOG(INFO) << "Querying " << kNumDataSources << " slow datasources took "
+              << serial << " serially and " << parallel << " with "
+              << kNumThreads << " threads.";
+    // Ideally the parallel query is kNumThreads times faster. Leave some slack
+    // for loaded test machines.
+    EXPECT_LT(parallel, serial / 2);
+  }
+}
+
+TEST_F(AttributeGroupQueryTest, ConcurrentParallelQueries) {
+  constexpr int kNumDataSources = 16;
+  {
+    auto mutable_group = group_->AcquireMutable();
+    for (int i = 0; i < kNumDataSources; ++i) {
+      auto datasource = SlowDataSource::Make(i, absl::Milliseconds(1));
+      managed_datasources_.push_back(datasource);
+      ASSERT_OK_AND_ASSIGN(auto repeated_sub,
+                           mutable_group->AddRepeatedChildGroup("repeated_sub"));
+      ASSERT_OK(repeated_sub->AcquireMutable()->AddAttribute(
+          "val1", datasource->GetAttribute()));
+    }
+  }
+
+  // Several queries sharing the datasources and the threadpool.
+  WorkStealingThreadpool threadpool(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, &threadpool]() {
+      for (int i = 0; i < 10; ++i) {
+        QuerySlowDataSources(group_.get(), kNumDataSources, &threadpool);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+TEST(TypedAttributeTest, VersionOnlyChangesWithValue) {
+  TypedAttribute<int32> attribute(nullptr);
+  uint64 version = attribute.GetVersion();
+  attribute.AssignValue(0);
+  EXPECT_EQ(version, attribute.GetVersion());
+  attribute.AssignValue(5);
+  EXPECT_NE(version, attribute.GetVersion());
+  version = attribute.GetVersion();
+  attribute.AssignValue(5);
+  EXPECT_EQ(version, attribute.GetVersion());
+}
+
+TEST(EnumAttributeTest, VersionOnlyChangesWithValue) {
+  EnumAttribute attribute(TestTop::SubEnum_descriptor(), nullptr);
+  uint64 version = attribute.GetVersion();
+  attribute = TestTop::SUB_ZERO;
+  EXPECT_EQ(version, attribute.GetVersion());
+  attribute = TestTop::SUB_TWO;
+  EXPECT_NE(version, attribute.GetVersion());
+  version = attribute.GetVersion();
+  EXPECT_OK(attribute.AssignValue(
+      TestTop::SubEnum_descriptor()->FindValueByNumber(TestTop::SUB_TWO)));
+  EXPECT_EQ(version, attribute.GetVersion());
+}
+
+class AttributeGroupQueryChangesTest : public AttributeGroupQueryTest {
+ protected:
+  // Adds repeated_sub[i].val1 for each of the given datasources.
+  void AddRepeatedSubs(
+      const std::vector<std::shared_ptr<SlowDataSource>>& datasources) {
+    auto mutable_group = group_->AcquireMutable();
+    for (const auto& datasource : datasources) {
+      managed_datasources_.push_back(datasource);
+      ASSERT_OK_AND_ASSIGN(auto repeated_sub,
+                           mutable_group->AddRepeatedChildGroup("repeated_sub"));
+      ASSERT_OK(repeated_sub->AcquireMutable()->AddAttribute(
+          "val1", datasource->GetAttribute()));
+    }
+  }
+
+  ::util::Status RegisterRepeatedSubs(AttributeGroupQuery* query) {
+    return group_->AcquireReadable()->RegisterQuery(
+        query, {{PathEntry("repeated_sub", -1, true, true, false),
+                 PathEntry("val1")}});
+  }
+
+  DummyThreadpool threadpool_;
+};
+
+TEST_F(AttributeGroupQueryChangesTest, RefreshOnlyUpdatesQueryOnChange) {
+  auto datasource = SlowDataSource::Make(1, absl::ZeroDuration());
+  ASSERT_NO_FATAL_FAILURE(AddRepeatedSubs({datasource}));
+  AttributeGroupQuery query(group_.get(), &threadpool_);
+  ASSERT_OK(RegisterRepeatedSubs(&query));
+
+  ASSERT_OK(query.Refresh());
+  EXPECT_TRUE(query.IsUpdated());
+  query.ClearUpdated();
+  ASSERT_OK(query.Refresh());
+  EXPECT_FALSE(query.IsUpdated());
+
+  datasource->SetValue(2);
+  ASSERT_OK(query.Refresh());
+  EXPECT_TRUE(query.IsUpdated());
+  TestTop result;
+  query.GetLastResult(&result);
+  ASSERT_EQ(1, result.repeated_sub_size());
+  EXPECT_EQ(2, result.repeated_sub(0).val1());
+}
+
+TEST_F(AttributeGroupQueryChangesTest, TakeChangesReturnsChangedAttributes) {
+  auto datasource0 = SlowDataSource::Make(10, absl::ZeroDuration());
+  auto datasource1 = SlowDataSource::Make(11, absl::ZeroDuration());
+  ASSERT_NO_FATAL_FAILURE(AddRepeatedSubs({datasource0, datasource1}));
+  AttributeGroupQuery query(group_.get(), &threadpool_);
+  ASSERT_OK(RegisterRepeatedSubs(&query));
+
+  TestTop changes;
+  google::protobuf::RepeatedPtrField<PathQuery> changed_paths;
+  // Nothing is recorded before TrackChanges.
+  EXPECT_FALSE(query.TakeChanges(&changes, &changed_paths));
+  query.TrackChanges();
+  ASSERT_OK(query.Refresh());
+  // The changes since the query was created are unknown.
+  EXPECT_FALSE(query.TakeChanges(&changes, &changed_paths));
+
+  // Nothing changed.
+  ASSERT_OK(query.Refresh());
+  ASSERT_TRUE(query.TakeChanges(&changes, &changed_paths));
+  EXPECT_EQ(0, changed_paths.size());
+
+  // Only the second attribute changed. Its value is the default one, so it is
+  // only visible in the changed paths.
+  datasource1->SetValue(0);
+  ASSERT_OK(query.Refresh());
+  ASSERT_TRUE(query.TakeChanges(&changes, &changed_paths));
+  ASSERT_EQ(1, changed_paths.size());
+  ASSERT_EQ(2, changed_paths.Get(0).entries_size());
+  EXPECT_EQ("repeated_sub", changed_paths.Get(0).entries(0).name());
+  EXPECT_TRUE(changed_paths.Get(0).entries(0).indexed());
+  EXPECT_EQ(1, changed_paths.Get(0).entries(0).index());
+  EXPECT_EQ("val1", changed_paths.Get(0).entries(1).name());
+  // The indices of the whole result are kept.
+  EXPECT_EQ(2, changes.repeated_sub_size());
+
+  // The changes are only returned once.
+  changes.Clear();
+  changed_paths.Clear();
+  ASSERT_TRUE(query.TakeChanges(&changes, &changed_paths));
+  EXPECT_EQ(0, changed_paths.size());
+}
+
+TEST_F(AttributeGroupQueryChangesTest, RemovedAttributesInvalidateChanges) {
+  auto datasource0 = SlowDataSource::Make(10, absl::ZeroDuration());
+  auto datasource1 = SlowDataSource::Make(11, absl::ZeroDuration());
+  ASSERT_NO_FATAL_FAILURE(AddRepeatedSubs({datasource0, datasource1}));
+  AttributeGroupQuery query(group_.get(), &threadpool_);
+  ASSERT_OK(RegisterRepeatedSubs(&query));
+  query.TrackChanges();
+  ASSERT_OK(query.Refresh());
+  TestTop changes;
+  google::protobuf::RepeatedPtrField<PathQuery> changed_paths;
+  query.TakeChanges(&changes, &changed_paths);
+
+  ASSERT_OK(group_->AcquireMutable()->RemoveRepeatedChildGroup("repeated_sub"));
+  ASSERT_NO_FATAL_FAILURE(AddRepeatedSubs({datasource1}));
+  ASSERT_OK(query.Refresh());
+  EXPECT_FALSE(query.TakeChanges(&changes, &changed_paths));
+  // The whole result is written again.
+  TestTop result;
+  query.GetLastResult(&result);
+  ASSERT_EQ(1, result.repeated_sub_size());
+  EXPECT_EQ(11, result.repeated_sub(0).val1());
+}
+
 }  // namespace
 }  // namespace phal
 }  // namespace hal
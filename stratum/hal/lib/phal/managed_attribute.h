@@ -67,6 +67,11 @@ class ManagedAttribute {
   // Returns a failure status if the system operation to set the value fails
   // for any reason. May only be called if CanSet returns true.
   virtual ::util::Status Set(Attribute value) = 0;
+  // Returns a counter which changes every time the stored value changes. This
+  // lets queries skip the attributes whose value is the same as the last time
+  // they were read. Like GetValue, this should only be called while holding the
+  // lock of the data source.
+  virtual uint64 GetVersion() const = 0;
 };
 
 // A single attribute of a known type, to be held internally by a data source.
@@ -87,14 +92,21 @@ class TypedAttribute : public ManagedAttribute {
       return MAKE_ERROR() << "Called Set with incorrect attribute type.";
     return setter_(absl::get<T>(value));
   }
+  uint64 GetVersion() const override { return version_; }
   void AddSetter(std::function<::util::Status(T value)> setter) {
     setter_ = setter;
   }
-  void AssignValue(const T& value) { value_ = value; }
+  void AssignValue(const T& value) {
+    if (value_ == value) return;
+    value_ = value;
+    version_++;
+  }
 
  protected:
   DataSource* datasource_;
   T value_{};
+  // Incremented every time value_ changes.
+  uint64 version_ = 0;
   std::function<::util::Status(T value)> setter_;
 };
 
@@ -117,11 +129,11 @@ class EnumAttribute
                           << " to enum attribute of type "
                           << value_->type()->name();
     }
-    value_ = value;
+    TypedAttribute::AssignValue(value);
     return ::util::OkStatus();
   }
   EnumAttribute& operator=(int number) {
-    value_ = value_->type()->FindValueByNumber(number);
+    TypedAttribute::AssignValue(value_->type()->FindValueByNumber(number));
     return *this;
   }
   template <typename E>
@@ -36,6 +36,7 @@ class ManagedAttributeMock : public ManagedAttribute {
   MOCK_CONST_METHOD0(GetDataSource, DataSource*());
   MOCK_CONST_METHOD0(CanSet, bool());
   MOCK_METHOD1(Set, ::util::Status(Attribute value));
+  MOCK_CONST_METHOD0(GetVersion, uint64());
 };
 
 }  // namespace phal
@@ -16,9 +16,13 @@
 #include "stratum/hal/lib/phal/onlp/onlp_event_handler.h"
 
 #include <algorithm>
+#include <map>
 #include <utility>
+#include <vector>
 
 #include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
 #include "stratum/lib/macros.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
@@ -39,6 +43,26 @@
 // should report this as a removal event and an insertion event.
 DEFINE_int32(onlp_polling_interval_ms, 200,
              "Polling interval for checking ONLP for hardware state changes.");
+DEFINE_int32(onlp_sfp_polling_interval_ms, 0,
+             "Polling interval for SFP oids. Uses onlp_polling_interval_ms if "
+             "not positive.");
+DEFINE_int32(onlp_fan_polling_interval_ms, 1000,
+             "Polling interval for fan oids. Uses onlp_polling_interval_ms if "
+             "not positive.");
+DEFINE_int32(onlp_psu_polling_interval_ms, 1000,
+             "Polling interval for PSU oids. Uses onlp_polling_interval_ms if "
+             "not positive.");
+DEFINE_int32(onlp_thermal_polling_interval_ms, 1000,
+             "Polling interval for thermal oids. Uses onlp_polling_interval_ms "
+             "if not positive.");
+DEFINE_int32(onlp_polling_backoff_threshold, 10,
+             "Number of consecutive polls returning the same status after "
+             "which the polling interval of an oid starts to double.");
+DEFINE_int32(onlp_polling_max_backoff_factor, 4,
+             "Upper bound of the factor by which the polling interval of an "
+             "oid is stretched. 1 disables the backoff.");
+DEFINE_int32(onlp_polling_threads, 4,
+             "Number of threads reading ONLP oids in parallel.");
 
 namespace stratum {
 namespace hal {
@@ -59,6 +83,11 @@ OnlpEventCallback::~OnlpEventCallback() {
   }
 }
 
+OnlpEventHandler::OnlpEventHandler(const OnlpInterface* onlp)
+    : onlp_(onlp),
+      poll_threadpool_(
+          new WorkStealingThreadpool(FLAGS_onlp_polling_threads)) {}
+
 ::util::StatusOr<std::unique_ptr<OnlpEventHandler>> OnlpEventHandler::Make(
     const OnlpInterface* onlp) {
   std::unique_ptr<OnlpEventHandler> handler(new OnlpEventHandler(onlp));
@@ -123,7 +152,45 @@ void OnlpEventHandler::AddUpdateCallback(
   update_callback_ = std::move(callback);
 }
 
+OnlpPollingStats OnlpEventHandler::GetPollingStats() const {
+  absl::MutexLock lock(&stats_lock_);
+  return stats_;
+}
+
+absl::Duration OnlpEventHandler::GetPollingInterval(OnlpOid oid,
+                                                    int num_unchanged_polls) {
+  int interval_ms = 0;
+  switch (ONLP_OID_TYPE_GET(oid)) {
+    case ONLP_OID_TYPE_SFP:
+      interval_ms = FLAGS_onlp_sfp_polling_interval_ms;
+      break;
+    case ONLP_OID_TYPE_FAN:
+      interval_ms = FLAGS_onlp_fan_polling_interval_ms;
+      break;
+    case ONLP_OID_TYPE_PSU:
+      interval_ms = FLAGS_onlp_psu_polling_interval_ms;
+      break;
+    case ONLP_OID_TYPE_THERMAL:
+      interval_ms = FLAGS_onlp_thermal_polling_interval_ms;
+      break;
+    default:
+      break;
+  }
+  if (interval_ms <= 0) interval_ms = FLAGS_onlp_polling_interval_ms;
+
+  // Double the interval for each poll past the threshold, up to the maximum
+  // backoff factor.
+  int max_backoff = std::max(FLAGS_onlp_polling_max_backoff_factor, 1);
+  int backoff = 1;
+  for (int i = FLAGS_onlp_polling_backoff_threshold;
+       i < num_unchanged_polls && backoff < max_backoff; ++i) {
+    backoff *= 2;
+  }
+  return absl::Milliseconds(interval_ms) * std::min(backoff, max_backoff);
+}
+
 ::util::Status OnlpEventHandler::InitializePollingThread() {
+  poll_threadpool_->Start();
   absl::MutexLock lock(&monitor_lock_);
   CHECK_RETURN_IF_FALSE(!pthread_create(&monitor_loop_thread_id_, nullptr,
                                         &OnlpEventHandler::RunPollingThread,
@@ -138,17 +205,23 @@ void* OnlpEventHandler::RunPollingThread(void* onlp_event_handler_ptr) {
       static_cast<OnlpEventHandler*>(onlp_event_handler_ptr);
   absl::Time last_polling_time = absl::InfinitePast();
   while (true) {
-    // We keep the polling time as consistent as possible.
-    absl::SleepFor(
-        last_polling_time +
-        absl::Milliseconds(FLAGS_onlp_polling_interval_ms) -
-        absl::Now());
+    // We keep the polling time as consistent as possible. The thread wakes up
+    // at least once per polling interval, so that newly registered oids and
+    // shutdowns are noticed in time.
+    absl::Time next_polling_time =
+        last_polling_time + absl::Milliseconds(FLAGS_onlp_polling_interval_ms);
+    {
+      absl::MutexLock lock(&handler->monitor_lock_);
+      next_polling_time =
+          std::min(next_polling_time, handler->GetNextPollingTime());
+    }
+    absl::SleepFor(next_polling_time - absl::Now());
     last_polling_time = absl::Now();
     {
       absl::MutexLock lock(&handler->monitor_lock_);
       if (!handler->monitor_loop_running_) break;
     }
-    ::util::Status result = handler->PollOids();
+    ::util::Status result = handler->PollOids(last_polling_time, false);
     if (!result.ok()) {
       LOG(ERROR) << "Error while polling oids: " << result;
     }
@@ -156,20 +229,96 @@ void* OnlpEventHandler::RunPollingThread(void* onlp_event_handler_ptr) {
   return nullptr;
 }
 
+absl::Time OnlpEventHandler::GetNextPollingTime() {
+  absl::Time next_polling_time = absl::InfiniteFuture();
+  for (const auto& oid_and_monitor : status_monitors_) {
+    next_polling_time = std::min(next_polling_time,
+                                 oid_and_monitor.second.next_polling_time);
+  }
+  return next_polling_time;
+}
+
 ::util::Status OnlpEventHandler::PollOids() {
-  // First we find all of the oids that have been updated.
-  absl::flat_hash_map<OnlpOid, OidInfo> updated_oids;
+  return PollOids(absl::Now(), true);
+}
+
+::util::Status OnlpEventHandler::PollOids(absl::Time now, bool poll_all) {
+  absl::Time cycle_start = absl::Now();
+  // First we find all of the oids that are due, grouped by type. ONLP does not
+  // tell which bus an oid sits behind, so the type stands in for it: each group
+  // is spread over at most as many tasks as there are threads, and the tasks
+  // of the different groups run side by side.
+  std::map<uint8, std::vector<OnlpOid>> oids_by_type;
   {
     absl::MutexLock lock(&monitor_lock_);
-    for (auto& oid_and_monitor : status_monitors_) {
+    for (const auto& oid_and_monitor : status_monitors_) {
+      if (!poll_all && oid_and_monitor.second.next_polling_time > now) {
+        continue;
+      }
       OnlpOid oid = oid_and_monitor.first;
-      OidStatusMonitor& status_monitor = oid_and_monitor.second;
-      ASSIGN_OR_RETURN(OidInfo info, onlp_->GetOidInfo(oid));
-      HwState new_status = info.GetHardwareState();
-      if (new_status != status_monitor.previous_status) {
-        status_monitor.previous_status = new_status;
-        updated_oids.insert(std::make_pair(oid, info));
+      oids_by_type[ONLP_OID_TYPE_GET(oid)].push_back(oid);
+    }
+  }
+  std::vector<OnlpOid> oids;
+  std::vector<std::pair<size_t, size_t>> shards;  // [begin, end) of oids.
+  for (const auto& type_and_oids : oids_by_type) {
+    const std::vector<OnlpOid>& group = type_and_oids.second;
+    size_t num_shards =
+        std::min(group.size(),
+                 static_cast<size_t>(std::max(FLAGS_onlp_polling_threads, 1)));
+    size_t begin = oids.size();
+    oids.insert(oids.end(), group.begin(), group.end());
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards.emplace_back(begin + group.size() * i / num_shards,
+                          begin + group.size() * (i + 1) / num_shards);
+    }
+  }
+
+  // The oids are read without holding the monitor lock. Each task writes to
+  // its own slots of infos.
+  std::vector<::util::StatusOr<OidInfo>> infos(
+      oids.size(), ::util::StatusOr<OidInfo>(OidInfo()));
+  std::vector<TaskId> tasks;
+  for (const auto& shard : shards) {
+    tasks.push_back(poll_threadpool_->Schedule([this, &oids, &infos, shard]() {
+      for (size_t i = shard.first; i < shard.second; ++i) {
+        infos[i] = onlp_->GetOidInfo(oids[i]);
       }
+    }));
+  }
+  poll_threadpool_->WaitAll(tasks);
+
+  // Then we find all of the oids that have been updated.
+  ::util::Status poll_result = ::util::OkStatus();
+  absl::flat_hash_map<OnlpOid, OidInfo> updated_oids;
+  {
+    absl::MutexLock lock(&monitor_lock_);
+    for (size_t i = 0; i < oids.size(); ++i) {
+      OidStatusMonitor* status_monitor =
+          gtl::FindOrNull(status_monitors_, oids[i]);
+      // The callback may have been unregistered in the meantime.
+      if (status_monitor == nullptr) continue;
+      if (!infos[i].ok()) {
+        APPEND_STATUS_IF_ERROR(poll_result, infos[i].status());
+        status_monitor->num_unchanged_polls = 0;
+      } else {
+        const OidInfo& info = infos[i].ValueOrDie();
+        HwState new_status = info.GetHardwareState();
+        if (new_status != status_monitor->previous_status) {
+          status_monitor->previous_status = new_status;
+          status_monitor->num_unchanged_polls = 0;
+          updated_oids.insert(std::make_pair(oids[i], info));
+        } else {
+          // The count is bounded, the backoff stops growing well before.
+          status_monitor->num_unchanged_polls = std::min(
+              status_monitor->num_unchanged_polls + 1,
+              FLAGS_onlp_polling_backoff_threshold +
+                  FLAGS_onlp_polling_max_backoff_factor);
+        }
+      }
+      status_monitor->next_polling_time =
+          now + GetPollingInterval(oids[i],
+                                   status_monitor->num_unchanged_polls);
     }
   }
 
@@ -207,6 +356,27 @@ void* OnlpEventHandler::RunPollingThread(void* onlp_event_handler_ptr) {
       update_callback_(result);
     }
   }
+
+  absl::Duration cycle_duration = absl::Now() - cycle_start;
+  bool overrun =
+      cycle_duration > absl::Milliseconds(FLAGS_onlp_polling_interval_ms);
+  {
+    absl::MutexLock lock(&stats_lock_);
+    ++stats_.num_cycles;
+    if (overrun) ++stats_.num_overruns;
+    stats_.num_oid_reads += oids.size();
+    stats_.last_cycle_duration = cycle_duration;
+    stats_.max_cycle_duration =
+        std::max(stats_.max_cycle_duration, cycle_duration);
+  }
+  if (overrun) {
+    LOG_EVERY_N(WARNING, 100)
+        << "Polling " << oids.size() << " ONLP oids took " << cycle_duration
+        << ", which is longer than the polling interval of "
+        << FLAGS_onlp_polling_interval_ms << "ms.";
+  }
+
+  APPEND_STATUS_IF_ERROR(result, poll_result);
   return result;
 }
 
@@ -23,9 +23,12 @@
 
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/phal/onlp/onlp_wrapper.h"
+#include "stratum/hal/lib/phal/threadpool_interface.h"
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 
 namespace stratum {
@@ -58,6 +61,18 @@ class OnlpEventCallback {
   OnlpEventHandler* handler_;
 };
 
+// Statistics about the polling cycles of an OnlpEventHandler.
+struct OnlpPollingStats {
+  // Number of polling cycles run so far.
+  uint64 num_cycles = 0;
+  // Number of polling cycles which took longer than the polling interval.
+  uint64 num_overruns = 0;
+  // Total number of OID reads.
+  uint64 num_oid_reads = 0;
+  absl::Duration last_cycle_duration = absl::ZeroDuration();
+  absl::Duration max_cycle_duration = absl::ZeroDuration();
+};
+
 class OnlpEventHandler {
  public:
   static ::util::StatusOr<std::unique_ptr<OnlpEventHandler>> Make(
@@ -83,21 +98,41 @@ class OnlpEventHandler {
   // normal event callbacks.
   virtual void AddUpdateCallback(std::function<void(::util::Status)> callback);
 
+  // Returns the statistics of the polling cycles run so far.
+  OnlpPollingStats GetPollingStats() const LOCKS_EXCLUDED(stats_lock_);
+
  protected:
-  explicit OnlpEventHandler(const OnlpInterface* onlp) : onlp_(onlp) {}
+  explicit OnlpEventHandler(const OnlpInterface* onlp);
 
  private:
   friend class OnlpEventHandlerTest;
   struct OidStatusMonitor {
     HwState previous_status = HW_STATE_UNKNOWN;
     OnlpEventCallback* callback = nullptr;
+    // The next time this oid is due to be polled. New oids are due right away.
+    absl::Time next_polling_time = absl::InfinitePast();
+    // Number of consecutive polls which returned the previous status.
+    int num_unchanged_polls = 0;
   };
 
+  // Returns the interval at which the given oid is polled after returning the
+  // same status num_unchanged_polls times in a row. This is the interval of
+  // the oid type, stretched once the status has stopped changing.
+  static absl::Duration GetPollingInterval(OnlpOid oid,
+                                           int num_unchanged_polls);
+
   // Initializes and starts the thread that polls onlp for oid updates.
   ::util::Status InitializePollingThread();
   // Helper function for pthread_create.
   static void* RunPollingThread(void* onlp_event_handler_ptr);
+  // Returns the earliest time at which any registered oid is due.
+  absl::Time GetNextPollingTime() EXCLUSIVE_LOCKS_REQUIRED(monitor_lock_);
+  // Polls all the registered oids, whether they are due or not.
   ::util::Status PollOids();
+  // Polls the registered oids which are due at the given time (all of them if
+  // poll_all is true) and sends the callbacks for the ones whose status
+  // changed. The oids are read in parallel on poll_threadpool_.
+  ::util::Status PollOids(absl::Time now, bool poll_all);
 
   const OnlpInterface* onlp_ = nullptr;
   absl::Mutex monitor_lock_;
@@ -114,6 +149,11 @@ class OnlpEventHandler {
   OnlpEventCallback* executing_callback_ = nullptr;
   bool monitor_loop_running_ GUARDED_BY(monitor_lock_) = false;
   pthread_t monitor_loop_thread_id_;
+  // The threadpool on which the oids are read. Its threads are spawned along
+  // with the polling thread.
+  std::unique_ptr<ThreadpoolInterface> poll_threadpool_;
+  mutable absl::Mutex stats_lock_;
+  OnlpPollingStats stats_ GUARDED_BY(stats_lock_);
 };
 
 }  // namespace onlp
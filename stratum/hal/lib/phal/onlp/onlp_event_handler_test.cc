@@ -15,10 +15,13 @@
 
 #include "stratum/hal/lib/phal/onlp/onlp_event_handler.h"
 
+#include <atomic>
 #include <functional>
 #include <vector>
 
+#include "gflags/gflags.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -30,6 +33,12 @@
 #include "stratum/lib/macros.h"
 #include "stratum/lib/test_utils/matchers.h"
 
+DECLARE_int32(onlp_polling_interval_ms);
+DECLARE_int32(onlp_sfp_polling_interval_ms);
+DECLARE_int32(onlp_fan_polling_interval_ms);
+DECLARE_int32(onlp_polling_backoff_threshold);
+DECLARE_int32(onlp_polling_max_backoff_factor);
+
 namespace stratum {
 namespace hal {
 namespace phal {
@@ -47,9 +56,14 @@ using ::testing::StrictMock;
 class OnlpEventHandlerTest : public ::testing::Test {
  public:
   ::util::Status PollOids() { return handler_.PollOids(); }
+  ::util::Status PollDueOids(absl::Time now) {
+    return handler_.PollOids(now, false);
+  }
   ::util::Status RunPolling() { return handler_.InitializePollingThread(); }
+  void StartPollingThreadpool() { handler_.poll_threadpool_->Start(); }
 
  protected:
+  ::gflags::FlagSaver flag_saver_;
   StrictMock<OnlpWrapperMock> onlp_;
   OnlpEventHandler handler_{&onlp_};
 };
@@ -236,6 +250,138 @@ TEST_F(OnlpEventHandlerTest, PollingThreadSendsMultipleCallbacks) {
   ASSERT_OK(handler_.UnregisterEventCallback(&callback));
   EXPECT_EQ(callback_counter, 3);
 }
+
+TEST_F(OnlpEventHandlerTest, OidsArePolledAtTheIntervalOfTheirType) {
+  FLAGS_onlp_sfp_polling_interval_ms = 100;
+  FLAGS_onlp_fan_polling_interval_ms = 1000;
+  FLAGS_onlp_polling_max_backoff_factor = 1;
+  const OnlpOid sfp_oid = ONLP_SFP_ID_CREATE(1);
+  const OnlpOid fan_oid = ONLP_FAN_ID_CREATE(1);
+  CallbackMock sfp_callback(sfp_oid);
+  CallbackMock fan_callback(fan_oid);
+  ASSERT_OK(handler_.RegisterEventCallback(&sfp_callback));
+  ASSERT_OK(handler_.RegisterEventCallback(&fan_callback));
+  onlp_oid_hdr_t fake_oid;
+  fake_oid.status = ONLP_OID_STATUS_FLAG_PRESENT;
+  EXPECT_CALL(sfp_callback, HandleOidStatusChange(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(fan_callback, HandleOidStatusChange(_))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // New oids are due right away.
+  absl::Time start = absl::Now();
+  EXPECT_CALL(onlp_, GetOidInfo(sfp_oid)).WillOnce(Return(OidInfo(fake_oid)));
+  EXPECT_CALL(onlp_, GetOidInfo(fan_oid)).WillOnce(Return(OidInfo(fake_oid)));
+  EXPECT_OK(PollDueOids(start));
+
+  // Only the SFP is due after its interval.
+  EXPECT_OK(PollDueOids(start + absl::Milliseconds(50)));
+  EXPECT_CALL(onlp_, GetOidInfo(sfp_oid)).WillOnce(Return(OidInfo(fake_oid)));
+  EXPECT_OK(PollDueOids(start + absl::Milliseconds(100)));
+
+  EXPECT_CALL(onlp_, GetOidInfo(sfp_oid)).WillOnce(Return(OidInfo(fake_oid)));
+  EXPECT_CALL(onlp_, GetOidInfo(fan_oid)).WillOnce(Return(OidInfo(fake_oid)));
+  EXPECT_OK(PollDueOids(start + absl::Milliseconds(1000)));
+}
+
+TEST_F(OnlpEventHandlerTest, UnchangedOidsArePolledLessOften) {
+  FLAGS_onlp_sfp_polling_interval_ms = 100;
+  FLAGS_onlp_polling_backoff_threshold = 2;
+  FLAGS_onlp_polling_max_backoff_factor = 4;
+  const OnlpOid oid = ONLP_SFP_ID_CREATE(1);
+  CallbackMock callback(oid);
+  ASSERT_OK(handler_.RegisterEventCallback(&callback));
+  onlp_oid_hdr_t fake_oid;
+  fake_oid.status = ONLP_OID_STATUS_FLAG_PRESENT;
+  EXPECT_CALL(onlp_, GetOidInfo(oid))
+      .WillRepeatedly(Invoke([&](OnlpOid oid) -> ::util::StatusOr<OidInfo> {
+        return OidInfo(fake_oid);
+      }));
+  EXPECT_CALL(callback, HandleOidStatusChange(_))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  // Returns the times in [from, to] at which the oid was read, polling every
+  // 10ms.
+  absl::Time start = absl::Now();
+  auto poll = [&](int from_ms, int to_ms) {
+    std::vector<int> polls;
+    for (int t = from_ms; t <= to_ms; t += 10) {
+      uint64 num_reads = handler_.GetPollingStats().num_oid_reads;
+      EXPECT_OK(PollDueOids(start + absl::Milliseconds(t)));
+      if (handler_.GetPollingStats().num_oid_reads > num_reads) {
+        polls.push_back(t);
+      }
+    }
+    return polls;
+  };
+  // The interval doubles after the 2nd unchanged poll, up to 4 times the
+  // interval.
+  EXPECT_THAT(poll(0, 1700),
+              ::testing::ElementsAre(0, 100, 200, 300, 500, 900, 1300, 1700));
+
+  // A change resets the interval.
+  fake_oid.status = ONLP_OID_STATUS_FLAG_UNPLUGGED;
+  EXPECT_THAT(poll(1710, 2100), ::testing::ElementsAre(2100));
+  EXPECT_THAT(poll(2110, 2300), ::testing::ElementsAre(2200, 2300));
+}
+
+TEST_F(OnlpEventHandlerTest, OidsArePolledInParallel) {
+  // Each read blocks until all of them are running at the same time.
+  constexpr int kNumOids = 4;
+  StartPollingThreadpool();
+  absl::Mutex lock;
+  int num_reading = 0;
+  std::atomic<bool> all_reading(true);
+  std::vector<std::unique_ptr<CallbackMock>> callbacks;
+  onlp_oid_hdr_t fake_oid;
+  fake_oid.status = ONLP_OID_STATUS_FLAG_PRESENT;
+  for (int i = 0; i < kNumOids; ++i) {
+    OnlpOid oid = ONLP_SFP_ID_CREATE(i + 1);
+    callbacks.emplace_back(new CallbackMock(oid));
+    ASSERT_OK(handler_.RegisterEventCallback(callbacks.back().get()));
+    EXPECT_CALL(*callbacks.back(), HandleOidStatusChange(_))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(onlp_, GetOidInfo(oid))
+        .WillOnce(Invoke([&](OnlpOid oid) -> ::util::StatusOr<OidInfo> {
+          absl::MutexLock l(&lock);
+          ++num_reading;
+          auto all_started = [&num_reading]() {
+            return num_reading == kNumOids;
+          };
+          if (!lock.AwaitWithTimeout(absl::Condition(&all_started),
+                                     absl::Seconds(10))) {
+            all_reading = false;
+          }
+          return OidInfo(fake_oid);
+        }));
+  }
+  EXPECT_OK(PollOids());
+  EXPECT_TRUE(all_reading);
+}
+
+TEST_F(OnlpEventHandlerTest, PollingStatsCountOverruns) {
+  FLAGS_onlp_polling_interval_ms = 1;
+  CallbackMock callback(1234);
+  ASSERT_OK(handler_.RegisterEventCallback(&callback));
+  onlp_oid_hdr_t fake_oid;
+  fake_oid.status = ONLP_OID_STATUS_FLAG_PRESENT;
+  EXPECT_CALL(onlp_, GetOidInfo(1234))
+      .WillOnce(Invoke([&](OnlpOid oid) -> ::util::StatusOr<OidInfo> {
+        absl::SleepFor(absl::Milliseconds(10));
+        return OidInfo(fake_oid);
+      }));
+  EXPECT_CALL(callback, HandleOidStatusChange(_))
+      .WillOnce(Return(::util::OkStatus()));
+
+  EXPECT_OK(PollOids());
+  OnlpPollingStats stats = handler_.GetPollingStats();
+  EXPECT_EQ(1u, stats.num_cycles);
+  EXPECT_EQ(1u, stats.num_overruns);
+  EXPECT_EQ(1u, stats.num_oid_reads);
+  EXPECT_GE(stats.last_cycle_duration, absl::Milliseconds(10));
+  EXPECT_EQ(stats.last_cycle_duration, stats.max_cycle_duration);
+}
 }  // namespace
 }  // namespace onlp
 }  // namespace phal
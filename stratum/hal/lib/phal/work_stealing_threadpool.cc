@@ -0,0 +1,183 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+
+namespace {
+
+// The threadpool and the index of the worker running on the current thread, if
+// the thread is a worker thread.
+thread_local const WorkStealingThreadpool* current_threadpool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+WorkStealingThreadpool::WorkStealingThreadpool(int num_threads)
+    : num_threads_(std::max(num_threads, 1)),
+      num_queued_(0),
+      next_id_(0),
+      next_worker_(0),
+      started_(false),
+      shutdown_(false) {
+  for (int i = 0; i < num_threads_; ++i) {
+    workers_.push_back(absl::make_unique<Worker>());
+  }
+}
+
+WorkStealingThreadpool::~WorkStealingThreadpool() {
+  std::vector<std::thread> threads;
+  {
+    absl::MutexLock l(&lock_);
+    shutdown_ = true;
+    work_available_.SignalAll();
+    threads.swap(threads_);
+  }
+  for (auto& thread : threads) thread.join();
+  // Run whatever is left if the workers were never started.
+  Task task;
+  while (PopOrSteal(-1, &task)) Run(&task);
+}
+
+void WorkStealingThreadpool::Start() {
+  absl::MutexLock l(&lock_);
+  if (started_ || shutdown_) return;
+  started_ = true;
+  for (int i = 0; i < num_threads_; ++i) {
+    threads_.emplace_back(&WorkStealingThreadpool::WorkerLoop, this, i);
+  }
+}
+
+TaskId WorkStealingThreadpool::Schedule(std::function<void()> closure) {
+  Task task;
+  task.closure = std::move(closure);
+  int worker = CurrentWorker();
+  {
+    absl::MutexLock l(&lock_);
+    // Skip the ids of tasks still pending after the counter wrapped around.
+    do {
+      task.id = next_id_++;
+    } while (pending_.count(task.id));
+    pending_.insert(task.id);
+    if (worker < 0) {
+      worker = next_worker_;
+      next_worker_ = (next_worker_ + 1) % num_threads_;
+    }
+  }
+  TaskId id = task.id;
+  {
+    absl::MutexLock l(&workers_[worker]->lock);
+    workers_[worker]->tasks.push_back(std::move(task));
+    // Count the task before releasing its queue, so that PopOrSteal() never
+    // takes it before it is counted.
+    absl::MutexLock q(&lock_);
+    ++num_queued_;
+    work_available_.Signal();
+    // Threads blocked in WaitAll() can run the new task as well.
+    task_done_.SignalAll();
+  }
+  return id;
+}
+
+void WorkStealingThreadpool::WaitAll(const std::vector<TaskId>& tasks) {
+  int worker = CurrentWorker();
+  while (true) {
+    {
+      absl::MutexLock l(&lock_);
+      while (!AllDone(tasks) && num_queued_ == 0) task_done_.Wait(&lock_);
+      if (AllDone(tasks)) return;
+    }
+    // Help with the queued tasks instead of blocking.
+    Task task;
+    if (PopOrSteal(worker, &task)) Run(&task);
+  }
+}
+
+int WorkStealingThreadpool::CurrentWorker() const {
+  return current_threadpool == this ? current_worker : -1;
+}
+
+bool WorkStealingThreadpool::PopOrSteal(int worker, Task* task) {
+  bool found = false;
+  if (worker >= 0) {
+    Worker* own = workers_[worker].get();
+    absl::MutexLock l(&own->lock);
+    if (!own->tasks.empty()) {
+      *task = std::move(own->tasks.back());
+      own->tasks.pop_back();
+      found = true;
+    }
+  }
+  for (int i = 1; !found && i <= num_threads_; ++i) {
+    Worker* victim = workers_[(std::max(worker, 0) + i) % num_threads_].get();
+    absl::MutexLock l(&victim->lock);
+    if (!victim->tasks.empty()) {
+      *task = std::move(victim->tasks.front());
+      victim->tasks.pop_front();
+      found = true;
+    }
+  }
+  if (found) {
+    absl::MutexLock l(&lock_);
+    --num_queued_;
+  }
+
+  return found;
+}
+
+void WorkStealingThreadpool::Run(Task* task) {
+  task->closure();
+  task->closure = nullptr;
+  absl::MutexLock l(&lock_);
+  pending_.erase(task->id);
+  task_done_.SignalAll();
+}
+
+void WorkStealingThreadpool::WorkerLoop(int worker) {
+  current_threadpool = this;
+  current_worker = worker;
+  while (true) {
+    Task task;
+    if (PopOrSteal(worker, &task)) {
+      Run(&task);
+      continue;
+    }
+    absl::MutexLock l(&lock_);
+    while (num_queued_ == 0 && !shutdown_) work_available_.Wait(&lock_);
+    // Drain the queues before exiting.
+    if (num_queued_ == 0 && shutdown_) break;
+  }
+  current_threadpool = nullptr;
+  current_worker = -1;
+}
+
+bool WorkStealingThreadpool::AllDone(const std::vector<TaskId>& tasks) const {
+  for (TaskId id : tasks) {
+    if (pending_.count(id)) return false;
+  }
+  return true;
+}
+
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
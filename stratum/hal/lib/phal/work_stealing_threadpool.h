@@ -0,0 +1,129 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
+#define STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "stratum/hal/lib/phal/threadpool_interface.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+
+// A threadpool with a fixed number of worker threads, each of which owns a
+// queue of tasks. Workers run the most recently queued task of their own queue
+// first, and steal the oldest task from the queue of another worker once their
+// own queue is empty. Tasks scheduled from a worker go to the queue of that
+// worker; other tasks are spread over the queues round-robin.
+//
+// A thread blocked in WaitAll() runs queued tasks itself until the tasks it
+// waits for are done, so tasks may schedule and wait for other tasks without
+// exhausting the workers. This also means that tasks run even if Start() was
+// never called.
+class WorkStealingThreadpool : public ThreadpoolInterface {
+ public:
+  // Creates a threadpool with the given number of worker threads (at least 1).
+  // The threads are spawned by Start().
+  explicit WorkStealingThreadpool(int num_threads);
+  // Runs the remaining tasks and joins the worker threads.
+  ~WorkStealingThreadpool() override;
+
+  // Spawns the worker threads. Further calls are no-ops.
+  void Start() override LOCKS_EXCLUDED(lock_);
+  TaskId Schedule(std::function<void()> closure) override LOCKS_EXCLUDED(lock_);
+  void WaitAll(const std::vector<TaskId>& tasks) override LOCKS_EXCLUDED(lock_);
+
+  // WorkStealingThreadpool is neither copyable nor movable.
+  WorkStealingThreadpool(const WorkStealingThreadpool&) = delete;
+  WorkStealingThreadpool& operator=(const WorkStealingThreadpool&) = delete;
+
+ private:
+  struct Task {
+    TaskId id;
+    std::function<void()> closure;
+  };
+
+  // The queue of tasks owned by a worker thread.
+  struct Worker {
+    absl::Mutex lock;
+    std::deque<Task> tasks GUARDED_BY(lock);
+  };
+
+  // Returns the index of the worker running on the calling thread, or -1 if
+  // the calling thread is not a worker of this threadpool.
+  int CurrentWorker() const;
+
+  // Takes the next task to run on behalf of the given worker (-1 for threads
+  // which are not workers): the newest task of its own queue, or else the
+  // oldest task of another queue. Returns false if all the queues are empty.
+  bool PopOrSteal(int worker, Task* task) LOCKS_EXCLUDED(lock_);
+
+  // Runs the given task and marks it done.
+  void Run(Task* task) LOCKS_EXCLUDED(lock_);
+
+  // Body of the worker threads.
+  void WorkerLoop(int worker) LOCKS_EXCLUDED(lock_);
+
+  // Returns true if none of the given tasks is pending.
+  bool AllDone(const std::vector<TaskId>& tasks) const
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const int num_threads_;
+
+  // One queue per worker thread. The vector itself is never modified after
+  // construction.
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // Protects the bookkeeping of the tasks and the state of the threads.
+  // Acquired after the lock of a Worker, never before.
+  mutable absl::Mutex lock_;
+
+  // Signaled when a task is queued or when the threadpool shuts down.
+  absl::CondVar work_available_;
+
+  // Signaled when a task is done.
+  absl::CondVar task_done_;
+
+  // Ids of the tasks which were scheduled and are not done yet.
+  absl::flat_hash_set<TaskId> pending_ GUARDED_BY(lock_);
+
+  // Number of tasks sitting in the queues. A task is counted while its queue
+  // is locked for the push, and uncounted after it is popped, so this is never
+  // lower than the actual number of queued tasks.
+  int num_queued_ GUARDED_BY(lock_);
+
+  TaskId next_id_ GUARDED_BY(lock_);
+  int next_worker_ GUARDED_BY(lock_);
+  bool started_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+  std::vector<std::thread> threads_ GUARDED_BY(lock_);
+};
+
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
@@ -0,0 +1,171 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+namespace {
+
+TEST(WorkStealingThreadpoolTest, RunsAllTasks) {
+  WorkStealingThreadpool threadpool(4);
+  threadpool.Start();
+  std::atomic<int> count(0);
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < 1000; ++i) {
+    tasks.push_back(threadpool.Schedule([&count]() { ++count; }));
+  }
+  threadpool.WaitAll(tasks);
+  EXPECT_EQ(1000, count);
+}
+
+TEST(WorkStealingThreadpoolTest, RunsTasksWithoutStart) {
+  // The waiting thread runs the tasks itself.
+  WorkStealingThreadpool threadpool(2);
+  int count = 0;
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < 10; ++i) {
+    tasks.push_back(threadpool.Schedule([&count]() { ++count; }));
+  }
+  threadpool.WaitAll(tasks);
+  EXPECT_EQ(10, count);
+}
+
+TEST(WorkStealingThreadpoolTest, StartIsIdempotent) {
+  WorkStealingThreadpool threadpool(2);
+  threadpool.Start();
+  threadpool.Start();
+  bool done = false;
+  threadpool.WaitAll({threadpool.Schedule([&done]() { done = true; })});
+  EXPECT_TRUE(done);
+}
+
+TEST(WorkStealingThreadpoolTest, WaitAllIgnoresUnknownTasks) {
+  WorkStealingThreadpool threadpool(2);
+  threadpool.Start();
+  threadpool.WaitAll({});
+  threadpool.WaitAll({12345});
+}
+
+TEST(WorkStealingThreadpoolTest, RunsTasksInParallel) {
+  constexpr int kNumThreads = 4;
+  WorkStealingThreadpool threadpool(kNumThreads);
+  threadpool.Start();
+  // Each task blocks until all of them are running at the same time.
+  absl::BlockingCounter running(kNumThreads);
+  absl::Notification all_running;
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < kNumThreads; ++i) {
+    tasks.push_back(threadpool.Schedule([&running, &all_running]() {
+      running.DecrementCount();
+      all_running.WaitForNotificationWithTimeout(absl::Seconds(10));
+    }));
+  }
+  running.Wait();
+  all_running.Notify();
+  threadpool.WaitAll(tasks);
+}
+
+TEST(WorkStealingThreadpoolTest, IdleWorkersStealQueuedTasks) {
+  constexpr int kNumThreads = 4;
+  WorkStealingThreadpool threadpool(kNumThreads);
+  threadpool.Start();
+  // Tasks scheduled from a worker go to its own queue. The other workers have
+  // to steal them to run them in parallel.
+  absl::BlockingCounter running(kNumThreads);
+  absl::Notification all_running;
+  std::vector<TaskId> inner_tasks;
+  TaskId outer = threadpool.Schedule([&]() {
+    for (int i = 0; i < kNumThreads - 1; ++i) {
+      inner_tasks.push_back(threadpool.Schedule([&running, &all_running]() {
+        running.DecrementCount();
+        all_running.WaitForNotificationWithTimeout(absl::Seconds(10));
+      }));
+    }
+    running.DecrementCount();
+    all_running.WaitForNotificationWithTimeout(absl::Seconds(10));
+    threadpool.WaitAll(inner_tasks);
+  });
+  running.Wait();
+  all_running.Notify();
+  threadpool.WaitAll({outer});
+}
+
+TEST(WorkStealingThreadpoolTest, NestedWaitAllDoesNotDeadlock) {
+  // More levels of nested tasks than threads. The waiting tasks run the tasks
+  // they wait for.
+  WorkStealingThreadpool threadpool(2);
+  threadpool.Start();
+  std::atomic<int> count(0);
+  std::function<void(int)> recurse = [&](int depth) {
+    ++count;
+    if (depth == 0) return;
+    std::vector<TaskId> children;
+    for (int i = 0; i < 2; ++i) {
+      children.push_back(
+          threadpool.Schedule([&recurse, depth]() { recurse(depth - 1); }));
+    }
+    threadpool.WaitAll(children);
+  };
+  threadpool.WaitAll({threadpool.Schedule([&recurse]() { recurse(6); })});
+  EXPECT_EQ(127, count);
+}
+
+TEST(WorkStealingThreadpoolTest, ConcurrentSchedulers) {
+  constexpr int kNumSchedulers = 8;
+  constexpr int kTasksPerScheduler = 500;
+  WorkStealingThreadpool threadpool(4);
+  threadpool.Start();
+  std::atomic<int> count(0);
+  std::vector<std::thread> schedulers;
+  for (int s = 0; s < kNumSchedulers; ++s) {
+    schedulers.emplace_back([&threadpool, &count]() {
+      std::vector<TaskId> tasks;
+      for (int i = 0; i < kTasksPerScheduler; ++i) {
+        tasks.push_back(threadpool.Schedule([&count]() { ++count; }));
+      }
+      threadpool.WaitAll(tasks);
+    });
+  }
+  for (auto& scheduler : schedulers) scheduler.join();
+  EXPECT_EQ(kNumSchedulers * kTasksPerScheduler, count);
+}
+
+TEST(WorkStealingThreadpoolTest, DestructorRunsQueuedTasks) {
+  std::atomic<int> count(0);
+  {
+    WorkStealingThreadpool threadpool(2);
+    for (int i = 0; i < 10; ++i) threadpool.Schedule([&count]() { ++count; });
+  }
+  EXPECT_EQ(10, count);
+}
+
+}  // namespace
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
@@ -16,6 +16,13 @@
  */
 
 #include "stratum/lib/channel/channel.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
 #include "absl/synchronization/mutex.h"
 
 namespace stratum {
@@ -28,6 +35,7 @@ using channel_internal::SelectData;
   // Create output map;
   auto ready_flags =
       absl::make_unique<std::unordered_map<ChannelBase*, bool>>();
+  ready_flags->reserve(channels.size());
   // Create and initialize management object.
   auto select_data = std::make_shared<SelectData>();
   select_data->done = false;
@@ -57,4 +65,30 @@ using channel_internal::SelectData;
   return SelectResult(std::move(ready_flags));
 }
 
+ChannelReadyFd::~ChannelReadyFd() { close(fd_); }
+
+::util::StatusOr<std::shared_ptr<ChannelReadyFd>> ChannelReadyFd::Create() {
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Failed to create eventfd: "
+                                    << strerror(errno) << ".";
+  }
+  return std::shared_ptr<ChannelReadyFd>(new ChannelReadyFd(fd));
+}
+
+void ChannelReadyFd::Notify() {
+  // Only fails with EAGAIN if the counter is about to overflow, in which case
+  // the eventfd is readable anyway.
+  uint64_t one = 1;
+  ssize_t ret = write(fd_, &one, sizeof(one));
+  (void)ret;
+}
+
+void ChannelReadyFd::Clear() {
+  // Reading resets the counter. Fails with EAGAIN if it was already zero.
+  uint64_t count;
+  ssize_t ret = read(fd_, &count, sizeof(count));
+  (void)ret;
+}
+
 }  // namespace stratum
@@ -19,9 +19,14 @@
 #ifndef STRATUM_LIB_CHANNEL_CHANNEL_H_
 #define STRATUM_LIB_CHANNEL_CHANNEL_H_
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <iterator>
 #include <list>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include <utility>
@@ -154,6 +159,30 @@ namespace stratum {
 //     return nullptr;
 //   }
 //
+// Example ChannelReadyFd Function:
+//   // Wait for the Channels and a socket in the same epoll loop.
+//   void* ThreadFunc(void* args) {
+//     ...
+//     auto ready_fd = ChannelReadyFd::Create().ValueOrDie();
+//     T_channel->SetReadyFd(ready_fd);
+//     U_channel->SetReadyFd(ready_fd);
+//     // Add ready_fd->fd() and the socket to the epoll set.
+//     ...
+//     do {
+//       epoll_wait(epoll_fd, events, kMaxEvents, -1);
+//       ...
+//       if (/* ready_fd->fd() is readable */) {
+//         ready_fd->Clear();
+//         // Drain the Channels. Stop once a read finds a Channel empty.
+//         std::vector<T> Ts;
+//         while (T_reader->ReadBatch(&Ts, 64, absl::ZeroDuration()).ok()) {
+//           // Operate on the read data.
+//         }
+//         ...
+//       }
+//     } while (1);
+//   }
+//
 // Notes on Usage:
 //
 // 1. The Channel remains open so long as Close() has not been called. As long
@@ -164,10 +193,32 @@ namespace stratum {
 //    Reading necessarily consumes data which will not be available to other
 //    threads. Additionally, Reading from multiple threads can easily cause
 //    out-of-sender-order processing of messages.
+//
+// 3. The lock-free Channel types (see ChannelType) require it: their
+//    ChannelReaders must not be used from more than one thread at a time. The
+//    same goes for the ChannelWriters of a kSingleProducerSingleConsumer
+//    Channel.
+//
+// 4. ReadBatch() and WriteBatch() move many messages at once and wake up the
+//    other side once per batch instead of once per message. Prefer them over
+//    Read() and Write() for high-rate Channels.
+
+// The implementations of Channel<T>, selected by Channel<T>::Create().
+enum class ChannelType {
+  // A queue protected by a mutex, for any number of reader and writer threads.
+  kLocked,
+  // A lock-free ring buffer for one writer thread and one reader thread.
+  kSingleProducerSingleConsumer,
+  // A lock-free ring buffer for any number of writer threads and one reader
+  // thread.
+  kMultiProducerSingleConsumer,
+};
 
 template <typename T>
 class Channel;
 template <typename T>
+class RingBufferChannel;
+template <typename T>
 class ChannelReader;
 template <typename T>
 class ChannelWriter;
@@ -217,6 +268,43 @@ class SelectResult {
     const std::vector<channel_internal::ChannelBase*>& channels,
     absl::Duration timeout);
 
+// An eventfd (see eventfd(2)) which becomes readable when messages are written
+// into an empty Channel it is attached to, or when such a Channel is closed.
+// One ChannelReadyFd can be attached to any number of Channels (see
+// ChannelBase::SetReadyFd()), so that a thread can wait for all of them, and
+// for sockets or any other file descriptors, in a single epoll() or poll()
+// call. Unlike Select(), waiting does not allocate or register anything.
+//
+// The eventfd is only notified on the transition from empty to not empty. So
+// once it is readable, the reader has to Clear() it and then read every
+// Channel until it finds it empty (or closed) before waiting again; otherwise
+// messages left in a Channel may not wake it up.
+class ChannelReadyFd {
+ public:
+  ~ChannelReadyFd();
+
+  // Creates a new non-blocking eventfd. Returns an error if that fails.
+  static ::util::StatusOr<std::shared_ptr<ChannelReadyFd>> Create();
+
+  // The file descriptor to wait for. It is owned by the ChannelReadyFd.
+  int fd() const { return fd_; }
+
+  // Makes the eventfd readable. Called by the Channels.
+  void Notify();
+
+  // Makes the eventfd non-readable until the next Notify().
+  void Clear();
+
+  // Disallow copy and assign.
+  ChannelReadyFd(const ChannelReadyFd&) = delete;
+  ChannelReadyFd& operator=(const ChannelReadyFd&) = delete;
+
+ private:
+  explicit ChannelReadyFd(int fd) : fd_(fd) {}
+
+  const int fd_;
+};
+
 // TODO(unknown): add support for optional en/dequeue timestamping.
 template <typename T>
 class Channel : public channel_internal::ChannelBase {
@@ -227,10 +315,10 @@ class Channel : public channel_internal::ChannelBase {
  public:
   virtual ~Channel() {}
 
-  // Creates shared Channel object with given maximum queue depth.
-  static std::unique_ptr<Channel<T>> Create(size_t max_depth) {
-    return absl::WrapUnique(new Channel<T>(max_depth));
-  }
+  // Creates shared Channel object with given maximum queue depth. The
+  // lock-free types preallocate the max_depth slots of their queue.
+  static std::unique_ptr<Channel<T>> Create(
+      size_t max_depth, ChannelType type = ChannelType::kLocked);
 
   // Closes the Channel. Any blocked Read() or Write() operations immediately
   // return ERR_CANCELLED. Returns false if the Channel is already closed.
@@ -239,6 +327,12 @@ class Channel : public channel_internal::ChannelBase {
   // Returns true if the Channel has been closed.
   virtual bool IsClosed() LOCKS_EXCLUDED(queue_lock_);
 
+  // Notifies the given ChannelReadyFd whenever a write finds the queue empty
+  // and on Close(). Notifies it right away if the queue is not empty or the
+  // Channel is closed.
+  void SetReadyFd(std::shared_ptr<ChannelReadyFd> ready_fd)
+      LOCKS_EXCLUDED(queue_lock_) override;
+
   // Disallow copy and assign.
   Channel(const Channel&) = delete;
   Channel& operator=(const Channel&) = delete;
@@ -279,6 +373,21 @@ class Channel : public channel_internal::ChannelBase {
   virtual ::util::Status ReadAll(std::vector<T>* t_s)
       LOCKS_EXCLUDED(queue_lock_);
 
+  // Reads and pops up to max_n of the first elements of the queue into t_s,
+  // replacing its contents. Blocks like Read() if the queue is empty, and
+  // returns the same statuses. Does not wait for more than one element.
+  virtual ::util::Status ReadBatch(std::vector<T>* t_s, size_t max_n,
+                                   absl::Duration timeout)
+      LOCKS_EXCLUDED(queue_lock_);
+
+  // Moves the elements of t_s into the Channel, in order. Blocks like Write()
+  // whenever the queue is full, with the timeout covering the whole batch, and
+  // returns the same statuses. The elements written are erased from t_s, so on
+  // error t_s holds the ones which were not.
+  virtual ::util::Status WriteBatch(std::vector<T>* t_s,
+                                    absl::Duration timeout)
+      LOCKS_EXCLUDED(queue_lock_);
+
   // Checks whether there are any elements enqueued in the Channel. If true,
   // sets both done and ready to true and returns ERR_SUCCESS. If the Channel
   // is closed, returns ERR_CANCELLED.
@@ -307,12 +416,17 @@ class Channel : public channel_internal::ChannelBase {
   // ready flags to the given value and signaling their condition variables.
   void ClearSelectList(bool ready) EXCLUSIVE_LOCKS_REQUIRED(queue_lock_);
 
+  // Helper function used by all the writes. Notifies the ChannelReadyFd, if
+  // any, if the queue was empty before the write.
+  void NotifyReadyFd(bool was_empty) EXCLUSIVE_LOCKS_REQUIRED(queue_lock_);
+
   // Mutex to protect internal queue of the Channel and state.
   mutable absl::Mutex queue_lock_;
   std::deque<T> queue_ GUARDED_BY(queue_lock_);
   bool closed_ GUARDED_BY(queue_lock_);
   std::list<std::pair<std::shared_ptr<channel_internal::SelectData>, bool>>
       select_list_ GUARDED_BY(queue_lock_);
+  std::shared_ptr<ChannelReadyFd> ready_fd_ GUARDED_BY(queue_lock_);
 
   // Maximum queue depth.
   const size_t max_depth_;
@@ -349,6 +463,10 @@ class ChannelReader {
   virtual ::util::Status ReadAll(std::vector<T>* t_s) {
     return channel_->ReadAll(t_s);
   }
+  virtual ::util::Status ReadBatch(std::vector<T>* t_s, size_t max_n,
+                                   absl::Duration timeout) {
+    return channel_->ReadBatch(t_s, max_n, timeout);
+  }
   virtual bool IsClosed() { return channel_->IsClosed(); }
 
   // Disallow copy and assign.
@@ -394,6 +512,10 @@ class ChannelWriter {
   virtual ::util::Status TryWrite(T&& t) {
     return channel_->TryWrite(std::move(t));
   }
+  virtual ::util::Status WriteBatch(std::vector<T>* t_s,
+                                    absl::Duration timeout) {
+    return channel_->WriteBatch(t_s, timeout);
+  }
   virtual bool IsClosed() { return channel_->IsClosed(); }
 
   // Disallow copy and assign.
@@ -413,6 +535,20 @@ class ChannelWriter {
   std::shared_ptr<Channel<T>> channel_;
 };
 
+template <typename T>
+std::unique_ptr<Channel<T>> Channel<T>::Create(size_t max_depth,
+                                               ChannelType type) {
+  switch (type) {
+    case ChannelType::kSingleProducerSingleConsumer:
+      return absl::WrapUnique(new RingBufferChannel<T>(max_depth, false));
+    case ChannelType::kMultiProducerSingleConsumer:
+      return absl::WrapUnique(new RingBufferChannel<T>(max_depth, true));
+    case ChannelType::kLocked:
+      break;
+  }
+  return absl::WrapUnique(new Channel<T>(max_depth));
+}
+
 template <typename T>
 bool Channel<T>::Close() {
   absl::MutexLock l(&queue_lock_);
@@ -424,6 +560,7 @@ bool Channel<T>::Close() {
   cond_not_empty_.SignalAll();
   // Signal any Select()-ing threads..
   ClearSelectList(false);
+  if (ready_fd_) ready_fd_->Notify();
   return true;
 }
 
@@ -439,11 +576,13 @@ template <typename T>
   // Check internal state, blocking with timeout if queue is full.
   RETURN_IF_ERROR(CheckWriteStateAndBlock(timeout));
   // Enqueue message.
+  bool was_empty = queue_.empty();
   queue_.push_back(t);
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
   ClearSelectList(true);
+  NotifyReadyFd(was_empty);
   return ::util::OkStatus();
 }
 
@@ -453,11 +592,13 @@ template <typename T>
   // Check internal state, blocking with timeout if queue is full.
   RETURN_IF_ERROR(CheckWriteStateAndBlock(timeout));
   // Enqueue message.
+  bool was_empty = queue_.empty();
   queue_.push_back(std::move(t));
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
   ClearSelectList(true);
+  NotifyReadyFd(was_empty);
   return ::util::OkStatus();
 }
 
@@ -495,11 +636,13 @@ template <typename T>
   // Check internal state.
   RETURN_IF_ERROR(CheckWriteState());
   // Enqueue message.
+  bool was_empty = queue_.empty();
   queue_.push_back(t);
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
   ClearSelectList(true);
+  NotifyReadyFd(was_empty);
   return ::util::OkStatus();
 }
 
@@ -509,11 +652,13 @@ template <typename T>
   // Check internal state.
   RETURN_IF_ERROR(CheckWriteState());
   // Enqueue message.
+  bool was_empty = queue_.empty();
   queue_.push_back(std::move(t));
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
   ClearSelectList(true);
+  NotifyReadyFd(was_empty);
   return ::util::OkStatus();
 }
 
@@ -610,6 +755,86 @@ template <typename T>
   return ::util::OkStatus();
 }
 
+template <typename T>
+::util::Status Channel<T>::ReadBatch(std::vector<T>* t_s, size_t max_n,
+                                     absl::Duration timeout) {
+  absl::MutexLock l(&queue_lock_);
+  t_s->clear();
+  // Check Channel closure. If closed, will not be signaled during wait.
+  if (closed_)
+    return MAKE_ERROR(ERR_CANCELLED).without_logging() << "Channel is closed.";
+  // Wait with timeout for non-empty internal buffer. Readers draining the
+  // Channel with a zero timeout hit the empty case all the time, so it is not
+  // logged.
+  absl::Time deadline = absl::Now() + timeout;
+  while (queue_.empty()) {
+    bool expired = cond_not_empty_.WaitWithDeadline(&queue_lock_, deadline);
+    // Could have been signalled because Channel is now closed.
+    if (closed_) return MAKE_ERROR(ERR_CANCELLED).without_logging()
+        << "Channel is closed.";
+    // Could have been signalled even if timeout has expired.
+    if (expired && queue_.empty()) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+             << "Read did not succeed within timeout due to empty Channel.";
+    }
+  }
+  // Dequeue messages.
+  size_t n = std::min(max_n, queue_.size());
+  t_s->reserve(n);
+  std::move(queue_.begin(), queue_.begin() + n, std::back_inserter(*t_s));
+  queue_.erase(queue_.begin(), queue_.begin() + n);
+  // Signal the blocked ChannelWriters, as there may be room for several.
+  if (n > 1) {
+    cond_not_full_.SignalAll();
+  } else {
+    cond_not_full_.Signal();
+  }
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status Channel<T>::WriteBatch(std::vector<T>* t_s,
+                                      absl::Duration timeout) {
+  absl::MutexLock l(&queue_lock_);
+  absl::Time deadline = absl::Now() + timeout;
+  ::util::Status status = ::util::OkStatus();
+  size_t written = 0;
+  while (written < t_s->size()) {
+    // Check internal state, blocking until the deadline if queue is full.
+    status = CheckWriteStateAndBlock(deadline - absl::Now());
+    if (!status.ok()) break;
+    // Enqueue as many messages as fit.
+    bool was_empty = queue_.empty();
+    size_t n = std::min(t_s->size() - written, max_depth_ - queue_.size());
+    auto begin = t_s->begin() + written;
+    std::move(begin, begin + n, std::back_inserter(queue_));
+    written += n;
+    // Signal the blocked ChannelReaders and any Select()-ing threads once for
+    // all of them.
+    if (n > 1) {
+      cond_not_empty_.SignalAll();
+    } else {
+      cond_not_empty_.Signal();
+    }
+    ClearSelectList(true);
+    NotifyReadyFd(was_empty);
+  }
+  t_s->erase(t_s->begin(), t_s->begin() + written);
+  return status;
+}
+
+template <typename T>
+void Channel<T>::SetReadyFd(std::shared_ptr<ChannelReadyFd> ready_fd) {
+  absl::MutexLock l(&queue_lock_);
+  ready_fd_ = std::move(ready_fd);
+  if (ready_fd_ && (closed_ || !queue_.empty())) ready_fd_->Notify();
+}
+
+template <typename T>
+void Channel<T>::NotifyReadyFd(bool was_empty) {
+  if (was_empty && ready_fd_) ready_fd_->Notify();
+}
+
 template <typename T>
 void Channel<T>::SelectRegister(
     const std::shared_ptr<channel_internal::SelectData>& select_data,
@@ -630,6 +855,513 @@ void Channel<T>::SelectRegister(
   }
 }
 
+// Lock-free Channel<T> backed by a ring buffer of max_depth preallocated slots,
+// for a single ChannelReader thread and one or more ChannelWriter threads.
+// Reads and writes which neither find the queue empty nor full do not take any
+// lock. A blocking Read() or Write() announces itself in a waiter count and
+// sleeps on a condition variable, which the other side only signals when the
+// count is not zero. Select() registrations are counted the same way, so
+// writes walk the select list only while a Select() is pending.
+//
+// Each slot holds a turn number which tells whether it is free or filled for
+// a given lap around the ring: 2 * lap when free, 2 * lap + 1 when filled.
+// Writers claim a position by bumping write_pos_ (with a CAS if there may be
+// several of them), fill the slot and then publish its turn. The reader
+// consumes the slot at read_pos_ once its turn says it is filled.
+//
+// An attached ChannelReadyFd is armed by the reader when it finds the queue
+// empty, and notified by the next writer which sees it armed.
+template <typename T>
+class RingBufferChannel : public Channel<T> {
+ public:
+  ~RingBufferChannel() override;
+
+  bool Close() override LOCKS_EXCLUDED(wait_lock_);
+  bool IsClosed() override;
+  void SetReadyFd(std::shared_ptr<ChannelReadyFd> ready_fd) override
+      LOCKS_EXCLUDED(wait_lock_);
+
+ protected:
+  ::util::Status Write(const T& t, absl::Duration timeout) override
+      LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status Write(T&& t, absl::Duration timeout) override
+      LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status TryWrite(const T& t) override LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status TryWrite(T&& t) override LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status Read(T* t, absl::Duration timeout) override
+      LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status TryRead(T* t) override LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status ReadAll(std::vector<T>* t_s) override
+      LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status ReadBatch(std::vector<T>* t_s, size_t max_n,
+                           absl::Duration timeout) override
+      LOCKS_EXCLUDED(wait_lock_);
+  ::util::Status WriteBatch(std::vector<T>* t_s, absl::Duration timeout)
+      override LOCKS_EXCLUDED(wait_lock_);
+  void SelectRegister(
+      const std::shared_ptr<channel_internal::SelectData>& select_data,
+      bool* ready) override LOCKS_EXCLUDED(wait_lock_);
+
+ private:
+  struct Slot {
+    std::atomic<size_t> turn;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  // Constructed by Channel<T>::Create().
+  RingBufferChannel(size_t max_depth, bool multi_producer);
+
+  // Writes u into the next free slot. Returns false, leaving u untouched, if
+  // the queue is full.
+  template <typename U>
+  bool TryPush(U&& u);
+
+  // Returns the oldest message, or nullptr if the queue is empty. Reader only.
+  T* Front();
+
+  // Same as Front(), but arms the ChannelReadyFd, if any, when the queue is
+  // empty. Reader only.
+  T* FrontOrArmReadyFd();
+
+  // Waits until the oldest message can be read and returns it. Returns an
+  // error if the Channel is closed or the timeout expires. Reader only.
+  ::util::StatusOr<T*> WaitForFront(absl::Duration timeout)
+      LOCKS_EXCLUDED(wait_lock_);
+
+  // Destroys the oldest message and frees its slot. Reader only.
+  void PopFront();
+
+  // Helpers for both variants of Write() and TryWrite().
+  template <typename U>
+  ::util::Status WriteWithTimeout(U&& u, absl::Duration timeout)
+      LOCKS_EXCLUDED(wait_lock_);
+  template <typename U>
+  ::util::Status WriteWithoutBlocking(U&& u) LOCKS_EXCLUDED(wait_lock_);
+
+  // Writes u once a slot frees up. Returns an error if the Channel is closed
+  // or the deadline passes. Does not notify the readers.
+  template <typename U>
+  ::util::Status BlockingPush(U&& u, absl::Time deadline)
+      LOCKS_EXCLUDED(wait_lock_);
+
+  // Wakes up a blocked Read() and the pending Select()s, if any, and notifies
+  // the ChannelReadyFd if it is armed. Called after messages are written.
+  void NotifyReaders() LOCKS_EXCLUDED(wait_lock_);
+
+  // Wakes up the blocked Write()s, if any. Called after messages are read.
+  void NotifyWriters(bool all) LOCKS_EXCLUDED(wait_lock_);
+
+  // Pops each element on the select list, setting the corresponding done and
+  // ready flags to the given value and signaling their condition variables.
+  void ClearSelectList(bool ready) EXCLUSIVE_LOCKS_REQUIRED(wait_lock_);
+
+  // Number of slots, i.e. the maximum queue depth.
+  const size_t capacity_;
+
+  // If false, there is a single writer thread which does not need to CAS.
+  const bool multi_producer_;
+
+  std::unique_ptr<Slot[]> slots_;
+
+  // Positions of the next slot to write and to read. They only ever grow, the
+  // slot index is the position modulo capacity_. Kept on separate cache lines
+  // as they are written by different threads.
+  alignas(64) std::atomic<size_t> write_pos_;
+  alignas(64) std::atomic<size_t> read_pos_;
+
+  alignas(64) std::atomic<bool> closed_;
+
+  // Number of Read()s blocked on an empty queue plus pending Select()s, and
+  // number of Write()s blocked on a full queue.
+  std::atomic<int> num_waiting_readers_;
+  std::atomic<int> num_waiting_writers_;
+
+  // Whether a ChannelReadyFd is attached, and whether the next write should
+  // notify it.
+  std::atomic<bool> has_ready_fd_;
+  std::atomic<bool> ready_fd_armed_;
+
+  // Protects the select list and the condition variables. Only taken to block
+  // and to wake up blocked threads.
+  mutable absl::Mutex wait_lock_;
+  absl::CondVar cond_not_empty_;
+  absl::CondVar cond_not_full_;
+  std::list<std::pair<std::shared_ptr<channel_internal::SelectData>, bool>>
+      select_list_ GUARDED_BY(wait_lock_);
+  std::shared_ptr<ChannelReadyFd> ready_fd_ GUARDED_BY(wait_lock_);
+
+  friend class Channel<T>;
+};
+
+template <typename T>
+RingBufferChannel<T>::RingBufferChannel(size_t max_depth, bool multi_producer)
+    : Channel<T>(max_depth),
+      capacity_(max_depth),
+      multi_producer_(multi_producer),
+      slots_(new Slot[max_depth]),
+      write_pos_(0),
+      read_pos_(0),
+      closed_(false),
+      num_waiting_readers_(0),
+      num_waiting_writers_(0),
+      has_ready_fd_(false),
+      ready_fd_armed_(false) {
+  for (size_t i = 0; i < capacity_; ++i) {
+    slots_[i].turn.store(0, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+RingBufferChannel<T>::~RingBufferChannel() {
+  // Destroy the messages which were never read.
+  for (size_t i = 0; i < capacity_; ++i) {
+    if (slots_[i].turn.load(std::memory_order_relaxed) & 1) {
+      reinterpret_cast<T*>(&slots_[i].storage)->~T();
+    }
+  }
+}
+
+template <typename T>
+bool RingBufferChannel<T>::Close() {
+  absl::MutexLock l(&wait_lock_);
+  if (closed_.exchange(true)) return false;
+  // Signal all blocked ChannelWriters and ChannelReaders.
+  cond_not_full_.SignalAll();
+  cond_not_empty_.SignalAll();
+  // Signal any Select()-ing threads.
+  ClearSelectList(false);
+  if (ready_fd_) ready_fd_->Notify();
+  return true;
+}
+
+template <typename T>
+bool RingBufferChannel<T>::IsClosed() {
+  return closed_.load();
+}
+
+template <typename T>
+template <typename U>
+bool RingBufferChannel<T>::TryPush(U&& u) {
+  if (capacity_ == 0) return false;
+  size_t pos = write_pos_.load(std::memory_order_acquire);
+  while (true) {
+    Slot& slot = slots_[pos % capacity_];
+    size_t turn = 2 * (pos / capacity_);
+    if (slot.turn.load(std::memory_order_acquire) == turn) {
+      bool claimed = true;
+      if (multi_producer_) {
+        claimed = write_pos_.compare_exchange_strong(pos, pos + 1);
+      } else {
+        write_pos_.store(pos + 1, std::memory_order_relaxed);
+      }
+      if (claimed) {
+        new (&slot.storage) T(std::forward<U>(u));
+        slot.turn.store(turn + 1, std::memory_order_release);
+        return true;
+      }
+      // Another writer claimed the position, and pos was updated. Retry.
+    } else {
+      // The slot is still filled from the previous lap, unless another writer
+      // moved on in the meantime.
+      size_t prev_pos = pos;
+      pos = write_pos_.load(std::memory_order_acquire);
+      if (pos == prev_pos) return false;
+    }
+  }
+}
+
+template <typename T>
+T* RingBufferChannel<T>::Front() {
+  if (capacity_ == 0) return nullptr;
+  size_t pos = read_pos_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[pos % capacity_];
+  if (slot.turn.load(std::memory_order_acquire) != 2 * (pos / capacity_) + 1) {
+    return nullptr;
+  }
+  return reinterpret_cast<T*>(&slot.storage);
+}
+
+template <typename T>
+T* RingBufferChannel<T>::FrontOrArmReadyFd() {
+  T* front = Front();
+  if (front != nullptr || !has_ready_fd_.load(std::memory_order_relaxed)) {
+    return front;
+  }
+  // Arm before checking the queue again. A writer either sees the ready fd
+  // armed or writes a message this check sees.
+  ready_fd_armed_.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return Front();
+}
+
+template <typename T>
+::util::StatusOr<T*> RingBufferChannel<T>::WaitForFront(
+    absl::Duration timeout) {
+  if (closed_.load()) {
+    return MAKE_ERROR(ERR_CANCELLED).without_logging() << "Channel is closed.";
+  }
+  T* front = FrontOrArmReadyFd();
+  if (front != nullptr) return front;
+  absl::Time deadline = absl::Now() + timeout;
+  absl::MutexLock l(&wait_lock_);
+  // Announce the wait before checking the queue again. A writer either sees
+  // the count or writes a message this check sees.
+  num_waiting_readers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool expired = false;
+  while ((front = Front()) == nullptr) {
+    // Could have been signalled because Channel is now closed.
+    if (closed_.load()) {
+      num_waiting_readers_.fetch_sub(1);
+      return MAKE_ERROR(ERR_CANCELLED).without_logging()
+             << "Channel is closed.";
+    }
+    if (expired) {
+      num_waiting_readers_.fetch_sub(1);
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+             << "Read did not succeed within timeout due to empty Channel.";
+    }
+    expired = cond_not_empty_.WaitWithDeadline(&wait_lock_, deadline);
+  }
+  num_waiting_readers_.fetch_sub(1);
+  return front;
+}
+
+template <typename T>
+void RingBufferChannel<T>::PopFront() {
+  size_t pos = read_pos_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[pos % capacity_];
+  reinterpret_cast<T*>(&slot.storage)->~T();
+  slot.turn.store(2 * (pos / capacity_) + 2, std::memory_order_release);
+  read_pos_.store(pos + 1, std::memory_order_release);
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::Write(const T& t, absl::Duration timeout) {
+  return WriteWithTimeout(t, timeout);
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::Write(T&& t, absl::Duration timeout) {
+  return WriteWithTimeout(std::move(t), timeout);
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::TryWrite(const T& t) {
+  return WriteWithoutBlocking(t);
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::TryWrite(T&& t) {
+  return WriteWithoutBlocking(std::move(t));
+}
+
+template <typename T>
+template <typename U>
+::util::Status RingBufferChannel<T>::WriteWithTimeout(U&& u,
+                                                      absl::Duration timeout) {
+  if (closed_.load()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  // TryPush() leaves u untouched when it fails, so it can be retried.
+  if (!TryPush(std::forward<U>(u))) {
+    RETURN_IF_ERROR(BlockingPush(std::forward<U>(u), absl::Now() + timeout));
+  }
+  NotifyReaders();
+  return ::util::OkStatus();
+}
+
+template <typename T>
+template <typename U>
+::util::Status RingBufferChannel<T>::BlockingPush(U&& u, absl::Time deadline) {
+  absl::MutexLock l(&wait_lock_);
+  // Announce the wait before checking the queue again. A reader either sees
+  // the count or frees a slot this check sees.
+  num_waiting_writers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool expired = false;
+  while (true) {
+    // Could have been signalled because Channel is now closed.
+    if (closed_.load()) {
+      num_waiting_writers_.fetch_sub(1);
+      return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+    }
+    if (TryPush(std::forward<U>(u))) break;
+    if (expired) {
+      num_waiting_writers_.fetch_sub(1);
+      return MAKE_ERROR(ERR_NO_RESOURCE)
+             << "Write did not succeed within timeout due to full Channel.";
+    }
+    expired = cond_not_full_.WaitWithDeadline(&wait_lock_, deadline);
+  }
+  num_waiting_writers_.fetch_sub(1);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+template <typename U>
+::util::Status RingBufferChannel<T>::WriteWithoutBlocking(U&& u) {
+  if (closed_.load()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  if (!TryPush(std::forward<U>(u))) {
+    return MAKE_ERROR(ERR_NO_RESOURCE) << "Channel is full.";
+  }
+  NotifyReaders();
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::Read(T* t, absl::Duration timeout) {
+  ASSIGN_OR_RETURN(T* front, WaitForFront(timeout));
+  *t = std::move(*front);
+  PopFront();
+  NotifyWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::TryRead(T* t) {
+  if (closed_.load()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  T* front = FrontOrArmReadyFd();
+  if (front == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "Channel is empty.";
+  }
+  *t = std::move(*front);
+  PopFront();
+  NotifyWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::ReadAll(std::vector<T>* t_s) {
+  if (closed_.load()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  t_s->clear();
+  // Read at most one queue worth of messages, so that fast writers cannot keep
+  // the reader here forever.
+  T* front = nullptr;
+  while (t_s->size() < capacity_ && (front = FrontOrArmReadyFd()) != nullptr) {
+    t_s->push_back(std::move(*front));
+    PopFront();
+  }
+  if (!t_s->empty()) NotifyWriters(true);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::ReadBatch(std::vector<T>* t_s,
+                                               size_t max_n,
+                                               absl::Duration timeout) {
+  t_s->clear();
+  ASSIGN_OR_RETURN(T* front, WaitForFront(timeout));
+  while (t_s->size() < max_n && front != nullptr) {
+    t_s->push_back(std::move(*front));
+    PopFront();
+    if (t_s->size() < max_n) front = FrontOrArmReadyFd();
+  }
+  NotifyWriters(t_s->size() > 1);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingBufferChannel<T>::WriteBatch(std::vector<T>* t_s,
+                                                absl::Duration timeout) {
+  if (closed_.load()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  ::util::Status status = ::util::OkStatus();
+  absl::Time deadline = absl::InfinitePast();
+  size_t written = 0;
+  for (; written < t_s->size(); ++written) {
+    T& t = (*t_s)[written];
+    if (TryPush(std::move(t))) continue;
+    // The queue is full. Let the reader see what was written so far before
+    // blocking for a free slot.
+    if (written > 0) NotifyReaders();
+    if (deadline == absl::InfinitePast()) deadline = absl::Now() + timeout;
+    status = BlockingPush(std::move(t), deadline);
+    if (!status.ok()) break;
+  }
+  if (written > 0) NotifyReaders();
+  t_s->erase(t_s->begin(), t_s->begin() + written);
+  return status;
+}
+
+template <typename T>
+void RingBufferChannel<T>::SelectRegister(
+    const std::shared_ptr<channel_internal::SelectData>& select_data,
+    bool* ready) {
+  absl::MutexLock l(&wait_lock_);
+  // Check for Channel closure.
+  if (closed_.load()) return;
+  // Announce the registration before checking for messages, as Read() does.
+  num_waiting_readers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  absl::MutexLock sel_lock(&select_data->lock);
+  if (Front() == nullptr) {
+    // Only enqueue a copy of select_data if the operation is not done.
+    if (!select_data->done) {
+      select_list_.push_back(std::make_pair(select_data, ready));
+      return;
+    }
+  } else {
+    *ready = true;
+    select_data->done = true;
+  }
+  num_waiting_readers_.fetch_sub(1);
+}
+
+template <typename T>
+void RingBufferChannel<T>::SetReadyFd(
+    std::shared_ptr<ChannelReadyFd> ready_fd) {
+  absl::MutexLock l(&wait_lock_);
+  ready_fd_ = std::move(ready_fd);
+  has_ready_fd_.store(ready_fd_ != nullptr);
+  ready_fd_armed_.store(ready_fd_ != nullptr);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ready_fd_ && (closed_.load() || Front() != nullptr)) ready_fd_->Notify();
+}
+
+template <typename T>
+void RingBufferChannel<T>::NotifyReaders() {
+  // Pairs with the fence of the readers announcing themselves or arming the
+  // ChannelReadyFd.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ready_fd_armed_.load(std::memory_order_relaxed) &&
+      ready_fd_armed_.exchange(false)) {
+    absl::MutexLock l(&wait_lock_);
+    if (ready_fd_) ready_fd_->Notify();
+  }
+  if (num_waiting_readers_.load(std::memory_order_relaxed) == 0) return;
+  absl::MutexLock l(&wait_lock_);
+  cond_not_empty_.Signal();
+  ClearSelectList(true);
+}
+
+template <typename T>
+void RingBufferChannel<T>::NotifyWriters(bool all) {
+  // Pairs with the fence of the writers announcing themselves.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_waiting_writers_.load(std::memory_order_relaxed) == 0) return;
+  absl::MutexLock l(&wait_lock_);
+  if (all) {
+    cond_not_full_.SignalAll();
+  } else {
+    cond_not_full_.Signal();
+  }
+}
+
+template <typename T>
+void RingBufferChannel<T>::ClearSelectList(bool ready) {
+  while (!select_list_.empty()) {
+    auto& pair = select_list_.front();
+    {
+      // Set select done flag and Channel ready flag and signal Select()-ing
+      // thread.
+      pair.second = ready;
+      absl::MutexLock sel_lock(&pair.first->lock);
+      pair.first->done = ready;
+      pair.first->cond.Signal();
+    }
+    select_list_.pop_front();
+    num_waiting_readers_.fetch_sub(1);
+  }
+}
+
 }  // namespace stratum
 
 #endif  // STRATUM_LIB_CHANNEL_CHANNEL_H_
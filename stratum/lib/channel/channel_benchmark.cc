@@ -0,0 +1,177 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// This binary compares the Channel types (see ChannelType) in messages per
+// second and write-to-read latency percentiles. Each writer thread writes
+// timestamped messages as fast as it can, while a single reader thread reads
+// them, either one by one with Read(), in batches with Select() and ReadAll(),
+// or with WriteBatch() and ReadBatch(). The SPSC type only runs with a single
+// writer. Example:
+//   channel_benchmark --num_writers=4 --num_messages=1000000 --max_depth=1024
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/lib/channel/channel.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_int32(num_writers, 1, "Number of writer threads.");
+DEFINE_int32(num_messages, 1000000,
+             "Number of messages written by each writer thread.");
+DEFINE_int32(max_depth, 1024, "Maximum queue depth of the Channel.");
+DEFINE_bool(read_all, false,
+            "Read with Select() and ReadAll() instead of one Read() per "
+            "message.");
+DEFINE_int32(batch_size, 0,
+             "If positive, write and read up to this many messages at once "
+             "with WriteBatch() and ReadBatch().");
+
+namespace stratum {
+
+namespace {
+
+// The message carries the time at which it was written.
+struct Message {
+  int64 write_time_ns;
+};
+
+const char* ChannelTypeName(ChannelType type) {
+  switch (type) {
+    case ChannelType::kLocked:
+      return "locked";
+    case ChannelType::kSingleProducerSingleConsumer:
+      return "spsc";
+    case ChannelType::kMultiProducerSingleConsumer:
+      return "mpsc";
+  }
+  return "unknown";
+}
+
+// Returns the latency at the given percentile of the sorted latencies.
+int64 Percentile(const std::vector<int64>& sorted_latencies, double percent) {
+  if (sorted_latencies.empty()) return 0;
+  size_t index = static_cast<size_t>(sorted_latencies.size() * percent / 100);
+  return sorted_latencies[std::min(index, sorted_latencies.size() - 1)];
+}
+
+::util::Status RunBenchmark(ChannelType type) {
+  std::shared_ptr<Channel<Message>> channel =
+      Channel<Message>::Create(FLAGS_max_depth, type);
+  auto reader = ChannelReader<Message>::Create(channel);
+  CHECK_RETURN_IF_FALSE(reader != nullptr);
+  int64 num_messages =
+      static_cast<int64>(FLAGS_num_writers) * FLAGS_num_messages;
+  std::vector<int64> latencies;
+  latencies.reserve(num_messages);
+
+  absl::Time start = absl::Now();
+  std::vector<std::thread> writers;
+  for (int i = 0; i < FLAGS_num_writers; ++i) {
+    writers.emplace_back([&channel]() {
+      auto writer = ChannelWriter<Message>::Create(channel);
+      std::vector<Message> batch;
+      for (int j = 0; j < FLAGS_num_messages; ++j) {
+        Message message = {absl::GetCurrentTimeNanos()};
+        if (FLAGS_batch_size <= 0) {
+          if (!writer->Write(message, absl::InfiniteDuration()).ok()) return;
+          continue;
+        }
+        batch.push_back(message);
+        if (static_cast<int>(batch.size()) == FLAGS_batch_size ||
+            j == FLAGS_num_messages - 1) {
+          if (!writer->WriteBatch(&batch, absl::InfiniteDuration()).ok()) {
+            return;
+          }
+        }
+      }
+    });
+  }
+  ::util::Status status = ::util::OkStatus();
+  std::vector<Message> messages;
+  Message message;
+  while (static_cast<int64>(latencies.size()) < num_messages) {
+    if (FLAGS_batch_size > 0) {
+      status = reader->ReadBatch(&messages, FLAGS_batch_size,
+                                 absl::Seconds(10));
+    } else if (FLAGS_read_all) {
+      status = Select({channel.get()}, absl::Seconds(10)).status();
+      if (status.ok()) status = reader->ReadAll(&messages);
+    } else {
+      messages.clear();
+      status = reader->Read(&message, absl::Seconds(10));
+      if (status.ok()) messages.push_back(message);
+    }
+    if (!status.ok()) break;
+    int64 now = absl::GetCurrentTimeNanos();
+    for (const auto& m : messages) latencies.push_back(now - m.write_time_ns);
+  }
+  double secs = absl::ToDoubleSeconds(absl::Now() - start);
+  channel->Close();
+  for (auto& writer : writers) writer.join();
+  RETURN_IF_ERROR(status);
+
+  std::sort(latencies.begin(), latencies.end());
+  LOG(INFO) << ChannelTypeName(type) << ": " << num_messages
+            << " messages from " << FLAGS_num_writers << " writer(s) in "
+            << secs << " secs (" << (secs > 0 ? num_messages / secs : 0)
+            << " msgs/sec). Latency "
+            << "p50 " << Percentile(latencies, 50) << "ns, p99 "
+            << Percentile(latencies, 99) << "ns, p99.9 "
+            << Percentile(latencies, 99.9) << "ns, max "
+            << Percentile(latencies, 100) << "ns.";
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  InitStratumLogging();
+  CHECK_RETURN_IF_FALSE(FLAGS_num_writers > 0 && FLAGS_num_messages > 0 &&
+                        FLAGS_max_depth > 0)
+      << "--num_writers, --num_messages and --max_depth must be positive.";
+
+  RETURN_IF_ERROR(RunBenchmark(ChannelType::kLocked));
+  if (FLAGS_num_writers == 1) {
+    RETURN_IF_ERROR(RunBenchmark(ChannelType::kSingleProducerSingleConsumer));
+  }
+  RETURN_IF_ERROR(RunBenchmark(ChannelType::kMultiProducerSingleConsumer));
+
+  return ::util::OkStatus();
+}
+
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::util::Status status = stratum::Main(argc, argv);
+  if (status.ok()) {
+    return 0;
+  } else {
+    LOG(ERROR) << status;
+    return 1;
+  }
+}
@@ -24,6 +24,9 @@
 #include "absl/synchronization/mutex.h"
 
 namespace stratum {
+
+class ChannelReadyFd;
+
 namespace channel_internal {
 
 // Data used by a Channel to manage an ongoing Select operation.
@@ -44,6 +47,10 @@ class ChannelBase {
   virtual void SelectRegister(const std::shared_ptr<SelectData>& select_data,
                               bool* ready) = 0;
 
+  // Attaches the given ChannelReadyFd to this Channel, replacing the one
+  // attached before, if any. A nullptr detaches it.
+  virtual void SetReadyFd(std::shared_ptr<ChannelReadyFd> ready_fd) = 0;
+
   // Disallow copy and assign.
   ChannelBase(const ChannelBase&) = delete;
   ChannelBase& operator=(const ChannelBase&) = delete;
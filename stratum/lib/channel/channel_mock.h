@@ -36,14 +36,19 @@ class ChannelMock : public Channel<T> {
   MOCK_METHOD2_T(Read, ::util::Status(T* t, absl::Duration timeout));
   MOCK_METHOD1_T(TryRead, ::util::Status(T* t));
   MOCK_METHOD1_T(ReadAll, ::util::Status(std::vector<T>* t_s));
+  MOCK_METHOD3_T(ReadBatch, ::util::Status(std::vector<T>* t_s, size_t max_n,
+                                           absl::Duration timeout));
   MOCK_METHOD2_T(Write, ::util::Status(const T& t, absl::Duration timeout));
   MOCK_METHOD2_T(Write, ::util::Status(T&& t, absl::Duration timeout));
   MOCK_METHOD1_T(TryWrite, ::util::Status(const T& t));
   MOCK_METHOD1_T(TryWrite, ::util::Status(T&& t));
+  MOCK_METHOD2_T(WriteBatch,
+                 ::util::Status(std::vector<T>* t_s, absl::Duration timeout));
   MOCK_METHOD2_T(
       SelectRegister,
       void(const std::shared_ptr<channel_internal::SelectData>& select_data,
            bool* t_ready));
+  MOCK_METHOD1_T(SetReadyFd, void(std::shared_ptr<ChannelReadyFd> ready_fd));
 };
 
 template <typename T>
@@ -52,6 +57,8 @@ class ChannelReaderMock : public ChannelReader<T> {
   MOCK_METHOD2_T(Read, ::util::Status(T* t, absl::Duration timeout));
   MOCK_METHOD1_T(TryRead, ::util::Status(T* t));
   MOCK_METHOD1_T(ReadAll, ::util::Status(std::vector<T>* t_s));
+  MOCK_METHOD3_T(ReadBatch, ::util::Status(std::vector<T>* t_s, size_t max_n,
+                                           absl::Duration timeout));
   MOCK_METHOD0_T(IsClosed, bool());
 };
 
@@ -62,6 +69,8 @@ class ChannelWriterMock : public ChannelWriter<T> {
   MOCK_METHOD2_T(Write, ::util::Status(T&& t, absl::Duration timeout));
   MOCK_METHOD1_T(TryWrite, ::util::Status(const T& t));
   MOCK_METHOD1_T(TryWrite, ::util::Status(T&& t));
+  MOCK_METHOD2_T(WriteBatch,
+                 ::util::Status(std::vector<T>* t_s, absl::Duration timeout));
   MOCK_METHOD0_T(IsClosed, bool());
 };
 
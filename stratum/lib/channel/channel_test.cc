@@ -16,12 +16,15 @@
 
 #include "stratum/lib/channel/channel.h"
 
+#include <poll.h>
 #include <pthread.h>
 #include <unistd.h>
 
 #include <set>
 #include <thread>  // NOLINT
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/lib/test_utils/matchers.h"
@@ -617,4 +620,342 @@ TEST(ChannelTest, SelectStressTest) {
   EXPECT_EQ(src_copy, dst);
 }
 
+// Runs the basic Channel operations against each lock-free Channel type.
+class RingBufferChannelTest : public ::testing::TestWithParam<ChannelType> {};
+
+TEST_P(RingBufferChannelTest, ReadWriteClose) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(2, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  absl::Duration timeout = absl::InfiniteDuration();
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_OK(writer->Write(2, timeout));  // Should not block.
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->TryWrite(3).error_code());
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->Write(3, absl::Milliseconds(1)).error_code());
+
+  int msg;
+  EXPECT_OK(reader->TryRead(&msg));
+  EXPECT_EQ(1, msg);
+  EXPECT_OK(reader->Read(&msg, timeout));  // Should not block.
+  EXPECT_EQ(2, msg);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, reader->TryRead(&msg).error_code());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            reader->Read(&msg, absl::Milliseconds(1)).error_code());
+
+  // Wrap around the ring a few times.
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(writer->TryWrite(i));
+    EXPECT_OK(writer->TryWrite(i + 100));
+    std::vector<int> msgs;
+    EXPECT_OK(reader->ReadAll(&msgs));
+    EXPECT_EQ(std::vector<int>({i, i + 100}), msgs);
+  }
+  std::vector<int> msgs;
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_TRUE(msgs.empty());
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_TRUE(channel->Close());
+  EXPECT_FALSE(channel->Close());
+  EXPECT_TRUE(writer->IsClosed());
+  EXPECT_TRUE(reader->IsClosed());
+  EXPECT_EQ(ERR_CANCELLED, writer->TryWrite(2).error_code());
+  EXPECT_EQ(ERR_CANCELLED, writer->Write(3, timeout).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->TryRead(&msg).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->ReadAll(&msgs).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->Read(&msg, timeout).error_code());
+}
+
+TEST_P(RingBufferChannelTest, CloseWakesUpBlockedReaderAndWriter) {
+  // Channel size 0 will cause both readers and writers to block.
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(0, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  std::thread reader_thread([&reader]() {
+    int buf;
+    EXPECT_EQ(ERR_CANCELLED,
+              reader->Read(&buf, absl::InfiniteDuration()).error_code());
+  });
+  std::thread writer_thread([&writer]() {
+    EXPECT_EQ(ERR_CANCELLED,
+              writer->Write(0, absl::InfiniteDuration()).error_code());
+  });
+  usleep(10000);
+  EXPECT_TRUE(channel->Close());
+  reader_thread.join();
+  writer_thread.join();
+}
+
+TEST_P(RingBufferChannelTest, BlockingReadAndWrite) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(1, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  // The reader blocks until the message is written.
+  std::thread reader_thread([&reader]() {
+    int buf = 0;
+    EXPECT_OK(reader->Read(&buf, absl::InfiniteDuration()));
+    EXPECT_EQ(1, buf);
+  });
+  usleep(10000);
+  EXPECT_OK(writer->Write(1, absl::InfiniteDuration()));
+  reader_thread.join();
+
+  // The writer blocks until the queue has room.
+  EXPECT_OK(writer->TryWrite(2));
+  std::thread writer_thread([&writer]() {
+    EXPECT_OK(writer->Write(3, absl::InfiniteDuration()));
+  });
+  usleep(10000);
+  int buf = 0;
+  EXPECT_OK(reader->Read(&buf, absl::InfiniteDuration()));
+  EXPECT_EQ(2, buf);
+  writer_thread.join();
+  EXPECT_OK(reader->Read(&buf, absl::InfiniteDuration()));
+  EXPECT_EQ(3, buf);
+}
+
+TEST_P(RingBufferChannelTest, Select) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(2, GetParam());
+  auto writer = ChannelWriter<int>::Create(channel);
+  auto reader = ChannelReader<int>::Create(channel);
+
+  auto status_or_ready = Select({channel.get()}, absl::Milliseconds(10));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status_or_ready.status().error_code());
+
+  EXPECT_OK(writer->TryWrite(1));
+  status_or_ready = Select({channel.get()}, absl::InfiniteDuration());
+  ASSERT_TRUE(status_or_ready.ok());
+  EXPECT_TRUE(status_or_ready.ValueOrDie()(channel.get()));
+  int dummy = 0;
+  EXPECT_OK(reader->TryRead(&dummy));
+
+  // A pending Select() is woken up by a write.
+  std::thread select_thread([&channel]() {
+    EXPECT_OK(Select({channel.get()}, absl::InfiniteDuration()));
+  });
+  usleep(10000);
+  EXPECT_OK(writer->TryWrite(2));
+  select_thread.join();
+
+  EXPECT_TRUE(channel->Close());
+  status_or_ready = Select({channel.get()}, absl::InfiniteDuration());
+  EXPECT_EQ(ERR_CANCELLED, status_or_ready.status().error_code());
+}
+
+TEST_P(RingBufferChannelTest, DestroysUnreadMessages) {
+  auto message = std::make_shared<int>(1);
+  {
+    std::shared_ptr<Channel<std::shared_ptr<int>>> channel =
+        Channel<std::shared_ptr<int>>::Create(4, GetParam());
+    auto writer = ChannelWriter<std::shared_ptr<int>>::Create(channel);
+    auto reader = ChannelReader<std::shared_ptr<int>>::Create(channel);
+    EXPECT_OK(writer->TryWrite(message));
+    EXPECT_OK(writer->TryWrite(message));
+    EXPECT_OK(writer->TryWrite(message));
+    std::shared_ptr<int> read;
+    EXPECT_OK(reader->TryRead(&read));
+    read.reset();
+    EXPECT_EQ(3, message.use_count());
+  }
+  EXPECT_EQ(1, message.use_count());
+}
+
+TEST_P(RingBufferChannelTest, SingleWriterOrder) {
+  constexpr int kNumMessages = 100000;
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(4, GetParam());
+  auto writer = ChannelWriter<int>::Create(channel);
+  auto reader = ChannelReader<int>::Create(channel);
+  std::thread writer_thread([&writer]() {
+    for (int i = 0; i < kNumMessages; ++i) {
+      ASSERT_OK(writer->Write(i, absl::InfiniteDuration()));
+    }
+  });
+  for (int i = 0; i < kNumMessages; ++i) {
+    int buf = -1;
+    ASSERT_OK(reader->Read(&buf, absl::InfiniteDuration()));
+    ASSERT_EQ(i, buf);
+  }
+  writer_thread.join();
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    RingBufferChannelTestWithType, RingBufferChannelTest,
+    ::testing::Values(ChannelType::kSingleProducerSingleConsumer,
+                      ChannelType::kMultiProducerSingleConsumer));
+
+// Several writers share a kMultiProducerSingleConsumer Channel. Each writer's
+// messages arrive complete and in order.
+TEST(RingBufferChannelTest, MultipleWritersKeepTheirOrder) {
+  constexpr int kNumWriters = 4;
+  constexpr int kNumMessages = 20000;
+  std::shared_ptr<Channel<std::pair<int, int>>> channel =
+      Channel<std::pair<int, int>>::Create(
+          8, ChannelType::kMultiProducerSingleConsumer);
+  auto reader = ChannelReader<std::pair<int, int>>::Create(channel);
+  std::vector<std::thread> writer_threads;
+  for (int w = 0; w < kNumWriters; ++w) {
+    writer_threads.emplace_back([&channel, w]() {
+      auto writer = ChannelWriter<std::pair<int, int>>::Create(channel);
+      for (int i = 0; i < kNumMessages; ++i) {
+        ASSERT_OK(writer->Write(std::make_pair(w, i),
+                                absl::InfiniteDuration()));
+      }
+    });
+  }
+  std::vector<int> next(kNumWriters, 0);
+  std::vector<std::pair<int, int>> msgs;
+  int num_read = 0;
+  while (num_read < kNumWriters * kNumMessages) {
+    auto status_or_ready = Select({channel.get()}, absl::Seconds(10));
+    ASSERT_TRUE(status_or_ready.ok());
+    ASSERT_OK(reader->ReadAll(&msgs));
+    for (const auto& msg : msgs) {
+      ASSERT_EQ(next[msg.first]++, msg.second);
+    }
+    num_read += msgs.size();
+  }
+  for (auto& thread : writer_threads) thread.join();
+  EXPECT_EQ(std::vector<int>(kNumWriters, kNumMessages), next);
+}
+
+// Returns true if the fd becomes readable within the timeout.
+bool WaitForFd(int fd, int timeout_ms) {
+  struct pollfd pfd = {fd, POLLIN, 0};
+  return poll(&pfd, 1, timeout_ms) == 1;
+}
+
+// Runs the batch operations and the ChannelReadyFd against each Channel type.
+class ChannelBatchTest : public ::testing::TestWithParam<ChannelType> {};
+
+TEST_P(ChannelBatchTest, ReadBatchAndWriteBatch) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(4, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  std::vector<int> msgs = {1, 2, 3};
+  EXPECT_OK(writer->WriteBatch(&msgs, absl::InfiniteDuration()));
+  EXPECT_TRUE(msgs.empty());
+  // Only two messages fit.
+  msgs = {4, 5, 6};
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->WriteBatch(&msgs, absl::Milliseconds(1)).error_code());
+  EXPECT_EQ(std::vector<int>({5, 6}), msgs);
+
+  EXPECT_OK(reader->ReadBatch(&msgs, 3, absl::InfiniteDuration()));
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), msgs);
+  EXPECT_OK(reader->ReadBatch(&msgs, 3, absl::InfiniteDuration()));
+  EXPECT_EQ(std::vector<int>({4}), msgs);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            reader->ReadBatch(&msgs, 3, absl::ZeroDuration()).error_code());
+  EXPECT_TRUE(msgs.empty());
+
+  EXPECT_TRUE(channel->Close());
+  msgs = {7};
+  EXPECT_EQ(ERR_CANCELLED,
+            writer->WriteBatch(&msgs, absl::InfiniteDuration()).error_code());
+  EXPECT_EQ(std::vector<int>({7}), msgs);
+  EXPECT_EQ(ERR_CANCELLED,
+            reader->ReadBatch(&msgs, 3, absl::InfiniteDuration()).error_code());
+}
+
+TEST_P(ChannelBatchTest, WriteBatchLargerThanChannel) {
+  constexpr int kNumMessages = 10000;
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(16, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  std::thread writer_thread([&writer]() {
+    std::vector<int> msgs;
+    for (int i = 0; i < kNumMessages; ++i) msgs.push_back(i);
+    EXPECT_OK(writer->WriteBatch(&msgs, absl::InfiniteDuration()));
+    EXPECT_TRUE(msgs.empty());
+  });
+  std::vector<int> msgs;
+  int next = 0;
+  while (next < kNumMessages) {
+    ASSERT_OK(reader->ReadBatch(&msgs, 10, absl::InfiniteDuration()));
+    ASSERT_LE(msgs.size(), 10U);
+    for (int msg : msgs) ASSERT_EQ(next++, msg);
+  }
+  writer_thread.join();
+}
+
+TEST_P(ChannelBatchTest, ReadyFdIsNotifiedWhenChannelIsNoLongerEmpty) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(4, GetParam());
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  auto status_or_ready_fd = ChannelReadyFd::Create();
+  ASSERT_TRUE(status_or_ready_fd.ok());
+  auto ready_fd = status_or_ready_fd.ConsumeValueOrDie();
+  channel->SetReadyFd(ready_fd);
+  EXPECT_FALSE(WaitForFd(ready_fd->fd(), 0));
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_TRUE(WaitForFd(ready_fd->fd(), 0));
+  ready_fd->Clear();
+  EXPECT_FALSE(WaitForFd(ready_fd->fd(), 0));
+
+  // Draining the Channel re-arms the ready fd.
+  std::vector<int> msgs;
+  EXPECT_OK(reader->ReadBatch(&msgs, 4, absl::ZeroDuration()));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            reader->ReadBatch(&msgs, 4, absl::ZeroDuration()).error_code());
+  msgs = {2, 3};
+  EXPECT_OK(writer->WriteBatch(&msgs, absl::InfiniteDuration()));
+  EXPECT_TRUE(WaitForFd(ready_fd->fd(), 0));
+  ready_fd->Clear();
+
+  // Attaching to a Channel with messages notifies right away.
+  channel->SetReadyFd(nullptr);
+  channel->SetReadyFd(ready_fd);
+  EXPECT_TRUE(WaitForFd(ready_fd->fd(), 0));
+  ready_fd->Clear();
+
+  EXPECT_TRUE(channel->Close());
+  EXPECT_TRUE(WaitForFd(ready_fd->fd(), 0));
+}
+
+TEST_P(ChannelBatchTest, OneReadyFdForManyChannels) {
+  constexpr int kChannelCnt = 4;
+  constexpr int kNumMessages = 5000;
+  auto ready_fd = ChannelReadyFd::Create().ConsumeValueOrDie();
+  std::vector<std::shared_ptr<Channel<int>>> channels;
+  std::vector<std::unique_ptr<ChannelReader<int>>> readers;
+  std::vector<std::thread> writer_threads;
+  for (int i = 0; i < kChannelCnt; ++i) {
+    channels.push_back(Channel<int>::Create(8, GetParam()));
+    channels.back()->SetReadyFd(ready_fd);
+    readers.push_back(ChannelReader<int>::Create(channels.back()));
+    writer_threads.emplace_back([&channels, i]() {
+      auto writer = ChannelWriter<int>::Create(channels[i]);
+      for (int j = 0; j < kNumMessages; ++j) {
+        ASSERT_OK(writer->Write(j, absl::InfiniteDuration()));
+      }
+    });
+  }
+  std::vector<int> next(kChannelCnt, 0);
+  int num_read = 0;
+  std::vector<int> msgs;
+  while (num_read < kChannelCnt * kNumMessages) {
+    ASSERT_TRUE(WaitForFd(ready_fd->fd(), 10000));
+    ready_fd->Clear();
+    for (int i = 0; i < kChannelCnt; ++i) {
+      while (readers[i]->ReadBatch(&msgs, 16, absl::ZeroDuration()).ok()) {
+        for (int msg : msgs) ASSERT_EQ(next[i]++, msg);
+        num_read += msgs.size();
+      }
+    }
+  }
+  for (auto& thread : writer_threads) thread.join();
+  EXPECT_EQ(std::vector<int>(kChannelCnt, kNumMessages), next);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ChannelBatchTestWithType, ChannelBatchTest,
+    ::testing::Values(ChannelType::kLocked,
+                      ChannelType::kSingleProducerSingleConsumer,
+                      ChannelType::kMultiProducerSingleConsumer));
+
 }  // namespace stratum
@@ -48,11 +48,22 @@ ssize_t PassthroughLibcProxy::sendmsg(int sockfd, const struct msghdr* msg,
   return ::sendmsg(sockfd, msg, flags);
 }
 
+int PassthroughLibcProxy::sendmmsg(int sockfd, struct mmsghdr* msgvec,
+                                   unsigned int vlen, int flags) {
+  return ::sendmmsg(sockfd, msgvec, vlen, flags);
+}
+
 ssize_t PassthroughLibcProxy::recvmsg(int sockfd, struct msghdr* msg,
                                       int flags) {
   return ::recvmsg(sockfd, msg, flags);
 }
 
+int PassthroughLibcProxy::recvmmsg(int sockfd, struct mmsghdr* msgvec,
+                                   unsigned int vlen, int flags,
+                                   struct timespec* timeout) {
+  return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+}
+
 int PassthroughLibcProxy::epoll_create1(int flags) {
   return ::epoll_create1(flags);
 }
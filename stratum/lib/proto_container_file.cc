@@ -0,0 +1,287 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/lib/proto_container_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "stratum/glue/gtl/cleanup.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+
+namespace {
+
+constexpr char kMagic[] = {'S', 'P', 'B', 'C'};
+constexpr size_t kMagicSize = sizeof(kMagic);
+// The header CRC covers the header up to the header CRC itself.
+constexpr size_t kHeaderCrcOffset = 20;
+
+// The CRC32C lookup tables for processing 8 bytes at a time ("slicing-by-8").
+struct Crc32cTables {
+  uint32 table[8][256];
+  Crc32cTables() {
+    // The reflected Castagnoli polynomial.
+    constexpr uint32 kPolynomial = 0x82F63B78;
+    for (uint32 i = 0; i < 256; ++i) {
+      uint32 crc = i;
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+      }
+      table[0][i] = crc;
+    }
+    for (uint32 i = 0; i < 256; ++i) {
+      for (int k = 1; k < 8; ++k) {
+        table[k][i] =
+            (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+      }
+    }
+  }
+};
+
+void PutLittleEndian32(uint32 value, char* buf) {
+  for (int i = 0; i < 4; ++i) buf[i] = static_cast<char>(value >> (8 * i));
+}
+
+void PutLittleEndian64(uint64 value, char* buf) {
+  for (int i = 0; i < 8; ++i) buf[i] = static_cast<char>(value >> (8 * i));
+}
+
+uint32 GetLittleEndian32(const char* buf) {
+  uint32 value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32>(static_cast<uint8>(buf[i])) << (8 * i);
+  }
+  return value;
+}
+
+uint64 GetLittleEndian64(const char* buf) {
+  uint64 value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64>(static_cast<uint8>(buf[i])) << (8 * i);
+  }
+  return value;
+}
+
+// Writes the whole buffer to the given file descriptor.
+::util::Status WriteAll(int fd, const char* buf, size_t size,
+                        const std::string& filename) {
+  while (size > 0) {
+    ssize_t ret = write(fd, buf, size);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to write to " << filename << ": " << strerror(errno);
+    }
+    buf += ret;
+    size -= ret;
+  }
+
+  return ::util::OkStatus();
+}
+
+// Syncs the dir holding the given file, so that a rename to the file is
+// durable.
+::util::Status SyncDir(const std::string& filename) {
+  std::string dir = DirName(filename);
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to open dir " << dir << ": " << strerror(errno);
+  }
+  int ret = fsync(fd);
+  close(fd);
+  if (ret != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to sync dir " << dir << ": " << strerror(errno);
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+uint32 Crc32c(const void* data, size_t size, uint32 crc) {
+  static const Crc32cTables* tables = new Crc32cTables();
+  const uint32(*t)[256] = tables->table;
+  const uint8* p = static_cast<const uint8*>(data);
+  crc = ~crc;
+  while (size >= 8) {
+    uint32 lo = crc ^ (static_cast<uint32>(p[0]) |
+                       static_cast<uint32>(p[1]) << 8 |
+                       static_cast<uint32>(p[2]) << 16 |
+                       static_cast<uint32>(p[3]) << 24);
+    uint32 hi = static_cast<uint32>(p[4]) | static_cast<uint32>(p[5]) << 8 |
+                static_cast<uint32>(p[6]) << 16 |
+                static_cast<uint32>(p[7]) << 24;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+    size -= 8;
+  }
+  while (size-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  return ~crc;
+}
+
+::util::Status WriteProtoToContainerFile(
+    const ::google::protobuf::Message& message, const std::string& filename) {
+  std::string payload;
+  if (!message.SerializeToString(&payload)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Failed to convert proto to bin string buffer: "
+           << message.ShortDebugString();
+  }
+  char header[kProtoContainerFileHeaderSize];
+  memcpy(header, kMagic, kMagicSize);
+  PutLittleEndian32(kProtoContainerFileVersion, header + 4);
+  PutLittleEndian64(payload.size(), header + 8);
+  PutLittleEndian32(Crc32c(payload.data(), payload.size()), header + 16);
+  PutLittleEndian32(Crc32c(header, kHeaderCrcOffset),
+                    header + kHeaderCrcOffset);
+
+  // Write to a temporary file in the same dir, so that it can be renamed to
+  // the given file atomically.
+  std::string tmp_filename = filename + ".tmp.XXXXXX";
+  int fd = mkstemp(&tmp_filename[0]);
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Failed to create a temporary file for "
+                                    << filename << ": " << strerror(errno);
+  }
+  bool renamed = false;
+  auto cleaner = gtl::MakeCleanup([&fd, &renamed, &tmp_filename]() {
+    if (fd >= 0) close(fd);
+    if (!renamed) unlink(tmp_filename.c_str());
+  });
+  RETURN_IF_ERROR(WriteAll(fd, header, sizeof(header), tmp_filename));
+  RETURN_IF_ERROR(
+      WriteAll(fd, payload.data(), payload.size(), tmp_filename));
+  if (fchmod(fd, 0644) != 0 || fsync(fd) != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to sync " << tmp_filename << ": " << strerror(errno);
+  }
+  int ret = close(fd);
+  fd = -1;
+  if (ret != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to close " << tmp_filename << ": " << strerror(errno);
+  }
+  if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Failed to rename " << tmp_filename
+                                    << " to " << filename << ": "
+                                    << strerror(errno);
+  }
+  renamed = true;
+  RETURN_IF_ERROR(SyncDir(filename));
+
+  return ::util::OkStatus();
+}
+
+::util::Status ReadProtoFromContainerFile(
+    const std::string& filename, ::google::protobuf::Message* message) {
+  if (!PathExists(filename)) {
+    return MAKE_ERROR(ERR_FILE_NOT_FOUND) << filename << " not found.";
+  }
+  if (IsDir(filename)) {
+    return MAKE_ERROR(ERR_FILE_NOT_FOUND) << filename << " is a dir.";
+  }
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Error when opening " << filename << ": " << strerror(errno);
+  }
+  auto fd_closer = gtl::MakeCleanup([fd]() { close(fd); });
+  struct stat stbuf;
+  if (fstat(fd, &stbuf) != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to stat " << filename << ": " << strerror(errno);
+  }
+  size_t file_size = stbuf.st_size;
+  if (file_size < kProtoContainerFileHeaderSize) {
+    return MAKE_ERROR(ERR_DATA_LOSS)
+           << filename << " is too short to be a proto container file.";
+  }
+  void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to map " << filename << ": " << strerror(errno);
+  }
+  auto unmapper =
+      gtl::MakeCleanup([addr, file_size]() { munmap(addr, file_size); });
+  // The file is read once from start to end. The advices are values, not
+  // flags, so they are given in separate calls. They are only hints, hence
+  // failures are ignored.
+  madvise(addr, file_size, MADV_SEQUENTIAL);
+  madvise(addr, file_size, MADV_WILLNEED);
+  const char* data = static_cast<const char*>(addr);
+
+  if (memcmp(data, kMagic, kMagicSize) != 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << filename << " is not a proto container file.";
+  }
+  if (GetLittleEndian32(data + kHeaderCrcOffset) !=
+      Crc32c(data, kHeaderCrcOffset)) {
+    return MAKE_ERROR(ERR_DATA_LOSS)
+           << "Corrupted header in proto container file " << filename << ".";
+  }
+  uint32 version = GetLittleEndian32(data + 4);
+  if (version != kProtoContainerFileVersion) {
+    return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+           << "Unsupported version " << version << " of proto container file "
+           << filename << ". Supported version is "
+           << kProtoContainerFileVersion << ".";
+  }
+  uint64 payload_size = GetLittleEndian64(data + 8);
+  if (payload_size != file_size - kProtoContainerFileHeaderSize) {
+    return MAKE_ERROR(ERR_DATA_LOSS)
+           << "Proto container file " << filename << " has "
+           << file_size - kProtoContainerFileHeaderSize
+           << " bytes of payload, expected " << payload_size << ".";
+  }
+  const char* payload = data + kProtoContainerFileHeaderSize;
+  if (GetLittleEndian32(data + 16) != Crc32c(payload, payload_size)) {
+    return MAKE_ERROR(ERR_DATA_LOSS)
+           << "Checksum mismatch in proto container file " << filename << ".";
+  }
+  if (payload_size > INT_MAX ||
+      !message->ParseFromArray(payload, static_cast<int>(payload_size))) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Failed to parse the binary content of "
+                                    << filename << " to proto.";
+  }
+
+  return ::util::OkStatus();
+}
+
+bool IsProtoContainerFile(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  char magic[kMagicSize];
+  ssize_t ret = read(fd, magic, kMagicSize);
+  close(fd);
+  return ret == static_cast<ssize_t>(kMagicSize) &&
+         memcmp(magic, kMagic, kMagicSize) == 0;
+}
+
+}  // namespace stratum
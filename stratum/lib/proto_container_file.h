@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_LIB_PROTO_CONTAINER_FILE_H_
+#define STRATUM_LIB_PROTO_CONTAINER_FILE_H_
+
+#include <string>
+
+#include "google/protobuf/message.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+
+// A proto container file holds a proto message in binary format, behind a
+// small versioned header which protects it against truncation and corruption.
+// All the header fields are little-endian:
+//   offset  size  field
+//        0     4  magic, "SPBC"
+//        4     4  format version, kProtoContainerFileVersion
+//        8     8  size of the serialized message in bytes
+//       16     4  CRC32C of the serialized message
+//       20     4  CRC32C of the first 20 bytes of the header
+//       24     -  serialized message
+// Unlike a text file, the large bytes fields of the message (e.g. the P4
+// device configs) are stored as is, and no text parsing is needed to load it.
+constexpr uint32 kProtoContainerFileVersion = 1;
+constexpr size_t kProtoContainerFileHeaderSize = 24;
+
+// Writes the proto message to the given file in the container format. The
+// file is replaced atomically: the message is written to a temporary file in
+// the same dir, which is synced to disk and then renamed over the given file.
+// The file either keeps its old content or has the new one, even if the
+// process or the switch crashes in the middle.
+::util::Status WriteProtoToContainerFile(
+    const ::google::protobuf::Message& message, const std::string& filename);
+
+// Reads the proto message from the given container file. The file is mapped
+// to memory and the message is parsed from the mapping directly. Returns
+// ERR_FILE_NOT_FOUND if the file does not exist, and ERR_DATA_LOSS if it is
+// truncated or corrupted.
+::util::Status ReadProtoFromContainerFile(
+    const std::string& filename, ::google::protobuf::Message* message);
+
+// Returns true if the given file exists and starts with the magic of the
+// container format. Used to tell container files from the files saved in the
+// other formats (e.g. text).
+bool IsProtoContainerFile(const std::string& filename);
+
+// Returns the CRC32C (Castagnoli) of the given data, continuing from the given
+// CRC of the preceding data, if any.
+uint32 Crc32c(const void* data, size_t size, uint32 crc = 0);
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_PROTO_CONTAINER_FILE_H_
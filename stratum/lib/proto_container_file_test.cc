@@ -0,0 +1,150 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/lib/proto_container_file.h"
+
+#include <string>
+
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+
+using stratum::test_utils::StatusIs;
+using ::testing::_;
+using ::testing::HasSubstr;
+
+class ProtoContainerFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    expected_.set_description("Test config");
+    expected_.mutable_chassis()->set_platform(hal::PLT_GENERIC_TOMAHAWK);
+    expected_.add_nodes()->set_id(1);
+    expected_.add_nodes()->set_id(2);
+    filename_ = FLAGS_test_tmpdir + "/ProtoContainerFileTest";
+    if (PathExists(filename_)) ASSERT_OK(RemoveFile(filename_));
+  }
+
+  // Overwrites the byte at the given offset of the file.
+  void CorruptByte(size_t offset) {
+    std::string buffer;
+    ASSERT_OK(ReadFileToString(filename_, &buffer));
+    ASSERT_LT(offset, buffer.size());
+    buffer[offset] ^= 0x5A;
+    ASSERT_OK(WriteStringToFile(buffer, filename_));
+  }
+
+  hal::ChassisConfig expected_;
+  std::string filename_;
+};
+
+TEST(Crc32cTest, KnownValues) {
+  EXPECT_EQ(0u, Crc32c("", 0));
+  EXPECT_EQ(0xE3069283u, Crc32c("123456789", 9));
+  // Continuing from the CRC of a prefix gives the CRC of the whole data.
+  const std::string data = "The quick brown fox jumps over the lazy dog";
+  EXPECT_EQ(Crc32c(data.data(), data.size()),
+            Crc32c(data.data() + 10, data.size() - 10,
+                   Crc32c(data.data(), 10)));
+}
+
+TEST_F(ProtoContainerFileTest, WriteThenRead) {
+  ASSERT_OK(WriteProtoToContainerFile(expected_, filename_));
+  EXPECT_TRUE(IsProtoContainerFile(filename_));
+  hal::ChassisConfig actual;
+  ASSERT_OK(ReadProtoFromContainerFile(filename_, &actual));
+  EXPECT_TRUE(ProtoEqual(expected_, actual));
+}
+
+TEST_F(ProtoContainerFileTest, WriteReplacesExistingFile) {
+  ASSERT_OK(WriteStringToFile("some old content", filename_));
+  EXPECT_FALSE(IsProtoContainerFile(filename_));
+  ASSERT_OK(WriteProtoToContainerFile(expected_, filename_));
+  hal::ChassisConfig actual;
+  ASSERT_OK(ReadProtoFromContainerFile(filename_, &actual));
+  EXPECT_TRUE(ProtoEqual(expected_, actual));
+}
+
+TEST_F(ProtoContainerFileTest, WriteThenReadEmptyMessage) {
+  ASSERT_OK(WriteProtoToContainerFile(hal::ChassisConfig(), filename_));
+  hal::ChassisConfig actual = expected_;
+  ASSERT_OK(ReadProtoFromContainerFile(filename_, &actual));
+  EXPECT_TRUE(ProtoEqual(hal::ChassisConfig(), actual));
+}
+
+TEST_F(ProtoContainerFileTest, WriteFailsForNonExistingDir) {
+  EXPECT_THAT(WriteProtoToContainerFile(
+                  expected_, FLAGS_test_tmpdir + "/non/existing/dir/file"),
+              StatusIs(_, ERR_INTERNAL, HasSubstr("temporary file")));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForNonExistingFile) {
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_FILE_NOT_FOUND, _));
+  EXPECT_FALSE(IsProtoContainerFile(filename_));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForTextFile) {
+  ASSERT_OK(WriteProtoToTextFile(expected_, filename_));
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_INVALID_PARAM,
+                       HasSubstr("not a proto container file")));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForShortFile) {
+  ASSERT_OK(WriteStringToFile("SPBC", filename_));
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_DATA_LOSS, HasSubstr("too short")));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForTruncatedFile) {
+  ASSERT_OK(WriteProtoToContainerFile(expected_, filename_));
+  std::string buffer;
+  ASSERT_OK(ReadFileToString(filename_, &buffer));
+  buffer.resize(buffer.size() - 1);
+  ASSERT_OK(WriteStringToFile(buffer, filename_));
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_DATA_LOSS, HasSubstr("bytes of payload")));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForCorruptedHeader) {
+  ASSERT_OK(WriteProtoToContainerFile(expected_, filename_));
+  CorruptByte(8);  // payload size
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_DATA_LOSS, HasSubstr("Corrupted header")));
+}
+
+TEST_F(ProtoContainerFileTest, ReadFailsForCorruptedPayload) {
+  ASSERT_OK(WriteProtoToContainerFile(expected_, filename_));
+  CorruptByte(kProtoContainerFileHeaderSize + 3);
+  hal::ChassisConfig actual;
+  EXPECT_THAT(ReadProtoFromContainerFile(filename_, &actual),
+              StatusIs(_, ERR_DATA_LOSS, HasSubstr("Checksum mismatch")));
+}
+
+}  // namespace stratum
@@ -15,110 +15,376 @@
 
 
 #include "stratum/lib/timer_daemon.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 
+DEFINE_int32(timer_daemon_num_workers, 4,
+             "Num of worker threads executing the actions of the due timers. "
+             "If 0, the actions are executed by the timer thread itself.");
+
 namespace stratum {
 namespace hal {
 
-namespace {
-// A function that is executed by the thread created by TimerDaemon::Start().
-// It provides a timer resolution of 1ms.
-static void* Timer(void* arg) {
-  while (true) {
-    // Sleep for 1ms.
-    absl::SleepFor(absl::Milliseconds(1));
+constexpr int TimerDaemon::LatenessHistogram::kNumBounds;
+constexpr int64
+    TimerDaemon::LatenessHistogram::kBucketBoundsMs[kNumBounds];
+constexpr int TimerDaemon::TimingWheel::kNumSlotBits;
+constexpr int TimerDaemon::TimingWheel::kNumSlots;
+constexpr int TimerDaemon::TimingWheel::kNumLevels;
+constexpr int64 TimerDaemon::TimingWheel::kNoTick;
 
-    // Call the method that will process the list of timers.
-    // If the method returns 'false' it means that this thread should be
-    // terminated.
-    if (!TimerDaemon::Execute()) break;
+void TimerDaemon::LatenessHistogram::Add(absl::Duration lateness) {
+  if (lateness < absl::ZeroDuration()) lateness = absl::ZeroDuration();
+  int i = 0;
+  while (i < kNumBounds && lateness >= absl::Milliseconds(kBucketBoundsMs[i])) {
+    ++i;
   }
-  return nullptr;
+  buckets[i]++;
+  count++;
+  sum += lateness;
+  max = std::max(max, lateness);
 }
-}  // namespace
 
-bool TimerDaemon::IsStopped() {
-  absl::WriterMutexLock l(&access_lock_);
-  return !started_;
+std::string TimerDaemon::LatenessHistogram::ToString() const {
+  std::string str = absl::StrCat(
+      "count:", count, ", mean:",
+      count ? absl::FormatDuration(sum / count) : "0",
+      ", max:", absl::FormatDuration(max), ", buckets:[");
+  for (int i = 0; i < kNumBounds; ++i) {
+    absl::StrAppend(&str, "<", kBucketBoundsMs[i], "ms:", buckets[i], ", ");
+  }
+  absl::StrAppend(&str, ">=", kBucketBoundsMs[kNumBounds - 1],
+                  "ms:", buckets[kNumBounds], "]");
+
+  return str;
 }
 
-TimerDaemon::DescriptorPtr TimerDaemon::GetAction() {
-  // Once woken up check if the timer at the top of the heap is due.
-  absl::WriterMutexLock l(&access_lock_);
+TimerDaemon::LatenessHistogram TimerDaemon::Descriptor::GetLatenessHistogram()
+    const {
+  absl::MutexLock l(&stats_lock_);
+  return lateness_;
+}
+
+uint64 TimerDaemon::Descriptor::GetNumSkipped() const {
+  absl::MutexLock l(&stats_lock_);
+  return skipped_;
+}
+
+void TimerDaemon::TimingWheel::Insert(int64 expiry_tick,
+                                      const DescriptorWeakPtr& desc) {
+  ++size_;
+  Place(Entry{expiry_tick, desc});
+}
 
-  if (timers_.empty()) {
-    return nullptr;
+void TimerDaemon::TimingWheel::Place(Entry entry) {
+  int64 delta = entry.expiry_tick - current_tick_;
+  if (delta <= 0) {
+    due_.push_back(std::move(entry));
+    return;
   }
-  if (timers_.front().expired()) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    return nullptr;
+  // Timers which are due further than the wheel can hold are parked in the
+  // top level slot which is reached last.
+  const int64 max_delta = (int64{1} << (kNumSlotBits * kNumLevels)) - 1;
+  delta = std::min(delta, max_delta);
+  int level = 0;
+  while ((delta >> (kNumSlotBits * (level + 1))) != 0) ++level;
+  const int64 tick = current_tick_ + delta;
+  slots_[level][(tick >> (kNumSlotBits * level)) & (kNumSlots - 1)].push_back(
+      std::move(entry));
+}
+
+void TimerDaemon::TimingWheel::ProcessCurrentTick() {
+  // Higher levels first, so that the timers cascaded down to level 0 are
+  // processed in the same tick.
+  for (int level = kNumLevels - 1; level >= 0; --level) {
+    const int shift = kNumSlotBits * level;
+    if (current_tick_ & ((int64{1} << shift) - 1)) continue;
+    auto* slot = &slots_[level][(current_tick_ >> shift) & (kNumSlots - 1)];
+    if (slot->empty()) continue;
+    std::vector<Entry> entries;
+    entries.swap(*slot);
+    for (auto& entry : entries) {
+      if (entry.desc.expired()) {
+        --size_;  // canceled
+        continue;
+      }
+      Place(std::move(entry));
+    }
   }
-  TimerDaemon::DescriptorPtr front = DescriptorPtr(timers_.front());
-  absl::Time now = absl::Now();
-  if (front->due_time_ <= now) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    if (front->Repeat()) {
-      // Periodic timer. Insert it in the queue again.
-      front->due_time_ += front->Period();
-      timers_.push_back(front);
-      push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+}
+
+void TimerDaemon::TimingWheel::Advance(int64 tick,
+                                       std::vector<DescriptorPtr>* due) {
+  while (true) {
+    for (const auto& entry : due_) {
+      --size_;
+      DescriptorPtr desc = entry.desc.lock();
+      if (desc != nullptr) due->push_back(std::move(desc));
+    }
+    due_.clear();
+    // Jump straight to the next tick which has some work to do. All the slots
+    // in between are known to be empty.
+    int64 next = NextEventTick();
+    if (next == kNoTick || next > tick) break;
+    current_tick_ = next;
+    ProcessCurrentTick();
+  }
+  current_tick_ = std::max(current_tick_, tick);
+}
+
+int64 TimerDaemon::TimingWheel::NextEventTick() const {
+  if (!due_.empty()) return current_tick_;
+  if (size_ == 0) return kNoTick;
+  int64 next = kNoTick;
+  // Level 0 only holds timers due within the next kNumSlots ticks.
+  for (int64 i = 1; i <= kNumSlots; ++i) {
+    if (!slots_[0][(current_tick_ + i) & (kNumSlots - 1)].empty()) {
+      next = current_tick_ + i;
+      break;
+    }
+  }
+  // A slot of a higher level is cascaded the next time the wheel enters the
+  // span of that slot.
+  for (int level = 1; level < kNumLevels; ++level) {
+    const int shift = kNumSlotBits * level;
+    const int64 block = (current_tick_ >> shift) + 1;
+    for (int64 slot = 0; slot < kNumSlots; ++slot) {
+      if (slots_[level][slot].empty()) continue;
+      int64 tick = (block + ((slot - block) & (kNumSlots - 1))) << shift;
+      if (next == kNoTick || tick < next) next = tick;
+    }
+  }
+
+  return next;
+}
+
+void TimerDaemon::TimingWheel::Reset(int64 tick) {
+  for (auto& level : slots_) {
+    for (auto& slot : level) slot.clear();
+  }
+  due_.clear();
+  size_ = 0;
+  current_tick_ = tick;
+}
+
+int64 TimerDaemon::ToTick(absl::Time time) const {
+  return absl::ToInt64Milliseconds(
+      absl::Floor(time - epoch_, absl::Milliseconds(1)));
+}
+
+int64 TimerDaemon::ToExpiryTick(absl::Time time) const {
+  return absl::ToInt64Milliseconds(
+      absl::Ceil(time - epoch_, absl::Milliseconds(1)));
+}
+
+absl::Time TimerDaemon::FromTick(int64 tick) const {
+  return epoch_ + absl::Milliseconds(tick);
+}
+
+void TimerDaemon::ScheduleTimer(const DescriptorPtr& desc) {
+  desc->expiry_tick_ = ToExpiryTick(desc->due_time_);
+  timers_.Insert(desc->expiry_tick_, desc);
+  timer_cond_.Signal();
+}
+
+void TimerDaemon::GetDueActions(absl::Time now,
+                                std::vector<PendingAction>* actions) {
+  std::vector<DescriptorPtr> due;
+  timers_.Advance(ToTick(now), &due);
+  for (const auto& desc : due) {
+    absl::Time due_time = desc->due_time_;
+    // A periodic timer whose previous action has not finished yet is skipped
+    // rather than run concurrently with itself.
+    bool busy = desc->running_.exchange(true);
+    if (desc->Repeat()) {
+      // Periodic timer. Insert it in the wheel again. The periods which have
+      // already passed (e.g. if the daemon was blocked) are skipped instead of
+      // firing in a burst.
+      absl::Duration period = std::max(desc->Period(), absl::Milliseconds(1));
+      desc->due_time_ += period;
+      int64 missed = 0;
+      if (desc->due_time_ <= now) {
+        missed = (now - desc->due_time_) / period + 1;
+        desc->due_time_ += missed * period;
+      }
+      if (busy || missed) {
+        absl::MutexLock l(&desc->stats_lock_);
+        desc->skipped_ += missed + (busy ? 1 : 0);
+      }
+      ScheduleTimer(desc);
     }
-    return front;
+    if (!busy) actions->push_back(PendingAction{desc, due_time});
+  }
+}
+
+void TimerDaemon::ExecuteAction(const PendingAction& action) {
+  DescriptorPtr desc = action.desc.lock();
+  if (desc == nullptr) return;  // the timer has been canceled meanwhile
+
+  absl::Duration lateness = absl::Now() - action.due_time;
+  {
+    absl::MutexLock l(&desc->stats_lock_);
+    desc->lateness_.Add(lateness);
+  }
+  {
+    absl::MutexLock l(&stats_lock_);
+    lateness_.Add(lateness);
+    num_executed_++;
+  }
+  // Execute the timer's action!
+  ::util::Status status = desc->ExecuteAction();
+  if (!status.ok()) {
+    LOG(ERROR) << "Timer action failed: " << status.error_message();
+  } else {
+    VLOG(1) << "Timer has been triggered!";
   }
+  desc->running_ = false;
+}
+
+void TimerDaemon::DispatchActions(const std::vector<PendingAction>& actions) {
+  if (worker_tids_.empty()) {
+    for (const auto& action : actions) ExecuteAction(action);
+    return;
+  }
+  absl::MutexLock l(&queue_lock_);
+  for (const auto& action : actions) pending_actions_.push_back(action);
+  queue_cond_.SignalAll();
+}
+
+void* TimerDaemon::TimerThreadFunc(void* arg) {
+  static_cast<TimerDaemon*>(arg)->RunTimerThread();
   return nullptr;
 }
 
-bool TimerDaemon::Execute() {
-  TimerDaemon* daemon = GetInstance();
+void* TimerDaemon::WorkerThreadFunc(void* arg) {
+  static_cast<TimerDaemon*>(arg)->RunWorkerThread();
+  return nullptr;
+}
 
-  if (daemon->IsStopped()) return false;
+void TimerDaemon::RunTimerThread() {
+  while (true) {
+    std::vector<PendingAction> actions;
+    {
+      absl::MutexLock l(&access_lock_);
+      if (!started_) break;
+      GetDueActions(absl::Now(), &actions);
+      if (actions.empty()) {
+        // Nothing to do. Sleep until the wheel has some work to do or a new
+        // timer is requested.
+        int64 next = timers_.NextEventTick();
+        timer_cond_.WaitWithDeadline(
+            &access_lock_, next == TimingWheel::kNoTick ? absl::InfiniteFuture()
+                                                        : FromTick(next));
+        continue;
+      }
+    }
+    DispatchActions(actions);
+  }
+}
 
-  auto front = daemon->GetAction();
-  if (front != nullptr) {
-    // Execute the timer's action!
-    if (front->ExecuteAction() != ::util::OkStatus()) {
-      LOG(ERROR) << "something went wrong";
-    } else {
-      LOG(INFO) << "Timer has been triggered!";
+void TimerDaemon::RunWorkerThread() {
+  while (true) {
+    PendingAction action;
+    {
+      absl::MutexLock l(&queue_lock_);
+      while (workers_started_ && pending_actions_.empty()) {
+        queue_cond_.Wait(&queue_lock_);
+      }
+      if (!workers_started_) break;
+      action = std::move(pending_actions_.front());
+      pending_actions_.pop_front();
     }
+    ExecuteAction(action);
   }
+}
+
+bool TimerDaemon::Execute() {
+  TimerDaemon* daemon = GetInstance();
+
+  std::vector<PendingAction> actions;
+  {
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    if (!daemon->started_) return false;
+    daemon->GetDueActions(absl::Now(), &actions);
+  }
+  for (const auto& action : actions) daemon->ExecuteAction(action);
+
   return true;
 }
 
 ::util::Status TimerDaemon::Start() {
-  absl::WriterMutexLock l(&GetInstance()->access_lock_);
-  if (GetInstance()->started_ == true) {
+  TimerDaemon* daemon = GetInstance();
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  if (daemon->started_ == true) {
     return ::util::OkStatus();
   }
 
-  GetInstance()->started_ = true;
+  daemon->started_ = true;
+  {
+    absl::MutexLock l(&daemon->stats_lock_);
+    daemon->lateness_ = LatenessHistogram();
+    daemon->num_executed_ = 0;
+  }
+  {
+    absl::MutexLock l(&daemon->queue_lock_);
+    daemon->workers_started_ = true;
+  }
+  for (int i = 0; i < FLAGS_timer_daemon_num_workers; ++i) {
+    pthread_t tid = 0;
+    if (pthread_create(&tid, nullptr, &WorkerThreadFunc, daemon) != 0) {
+      return MAKE_ERROR(ERR_INTERNAL) << "Failed to create a timer worker.";
+    }
+    daemon->worker_tids_.push_back(tid);
+  }
 
-  if (pthread_create(&GetInstance()->tid_, nullptr, &Timer, nullptr) != 0) {
+  if (pthread_create(&daemon->tid_, nullptr, &TimerThreadFunc, daemon) != 0) {
     return MAKE_ERROR(ERR_INTERNAL) << "Failed to create the timer thread.";
   } else {
-    LOG(INFO) << "The timer daemon has been started.";
+    LOG(INFO) << "The timer daemon has been started with "
+              << daemon->worker_tids_.size() << " workers.";
     return ::util::OkStatus();
   }
 }
 
 ::util::Status TimerDaemon::Stop() {
+  TimerDaemon* daemon = GetInstance();
   {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    GetInstance()->started_ = false;
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    if (daemon->tid_ == 0) return ::util::OkStatus();  // not running
+    daemon->started_ = false;
+    daemon->timer_cond_.Signal();
   }
 
-  if (pthread_join(GetInstance()->tid_, nullptr) != 0) {
+  if (pthread_join(daemon->tid_, nullptr) != 0) {
     return MAKE_ERROR(ERR_INTERNAL) << "Failed to join the timer thread.";
-  } else {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    GetInstance()->timers_.clear();
-    GetInstance()->tid_ = 0;
-
-    LOG(INFO) << "The timer daemon has been stopped.";
-    return ::util::OkStatus();
   }
+  {
+    absl::MutexLock l(&daemon->queue_lock_);
+    daemon->workers_started_ = false;
+    daemon->pending_actions_.clear();
+    daemon->queue_cond_.SignalAll();
+  }
+  ::util::Status status = ::util::OkStatus();
+  for (pthread_t tid : daemon->worker_tids_) {
+    if (pthread_join(tid, nullptr) != 0) {
+      status = MAKE_ERROR(ERR_INTERNAL) << "Failed to join a timer worker.";
+    }
+  }
+  daemon->worker_tids_.clear();
+  {
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    daemon->timers_.Reset(daemon->ToTick(absl::Now()));
+    daemon->tid_ = 0;
+  }
+  if (status.ok()) LOG(INFO) << "The timer daemon has been stopped.";
+
+  return status;
 }
 
 ::util::Status TimerDaemon::RequestOneShotTimer(uint64 delay_ms,
@@ -147,11 +413,35 @@ bool TimerDaemon::Execute() {
   *desc = std::make_shared<Descriptor>(repeat, action);
   (*desc)->due_time_ = now + absl::Milliseconds(delay_ms);
   (*desc)->period_ = absl::Milliseconds(period_ms);
-  timers_.push_back(DescriptorWeakPtr(*desc));
-  push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+  ScheduleTimer(*desc);
 
   return ::util::OkStatus();
 }
 
+TimerDaemon::LatenessHistogram TimerDaemon::GetLatenessHistogram() {
+  TimerDaemon* daemon = GetInstance();
+  absl::MutexLock l(&daemon->stats_lock_);
+  return daemon->lateness_;
+}
+
+std::string TimerDaemon::DumpStats() {
+  TimerDaemon* daemon = GetInstance();
+  size_t num_timers = 0;
+  {
+    absl::ReaderMutexLock l(&daemon->access_lock_);
+    num_timers = daemon->timers_.size();
+  }
+  std::string msg;
+  {
+    absl::MutexLock l(&daemon->stats_lock_);
+    msg = absl::StrCat("Timer daemon stats: (timers:", num_timers,
+                       ", executed:", daemon->num_executed_, ", lateness:{",
+                       daemon->lateness_.ToString(), "})");
+  }
+  LOG(INFO) << msg;
+
+  return msg;
+}
+
 }  // namespace hal
 }  // namespace stratum
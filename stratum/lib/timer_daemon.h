@@ -20,10 +20,12 @@
 #define STRATUM_LIB_TIMER_DAEMON_H_
 
 #include <pthread.h>
-#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <functional>
-#include <vector>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
@@ -41,17 +43,52 @@ class TimerDaemon final {
  private:
   using Action = std::function<::util::Status()>;
 
+ public:
+  // Histogram of the lateness of a timer, i.e. the time between the due time
+  // of the timer and the time its action started executing. Bucket i counts
+  // the samples which are smaller than kBucketBoundsMs[i] milliseconds (and not
+  // smaller than the bound of the previous bucket). The last bucket counts all
+  // the samples which do not fit in any other bucket.
+  struct LatenessHistogram {
+    static constexpr int kNumBounds = 10;
+    static constexpr int64 kBucketBoundsMs[kNumBounds] = {
+        1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+    // Num of samples in each bucket.
+    uint64 buckets[kNumBounds + 1];
+    // Total num of samples.
+    uint64 count;
+    // Sum and max of all the samples.
+    absl::Duration sum;
+    absl::Duration max;
+    LatenessHistogram()
+        : buckets(), count(0), sum(absl::ZeroDuration()),
+          max(absl::ZeroDuration()) {}
+    // Adds a sample to the histogram. Negative samples are counted as zero.
+    void Add(absl::Duration lateness);
+    // Returns the histogram as a human-readable string.
+    std::string ToString() const;
+  };
+
+ private:
   class Descriptor {
    public:
     explicit Descriptor(const Action& action)
-        : repeat_(true), period_(absl::Seconds(1)), action_(action) {}
+        : repeat_(true), period_(absl::Seconds(1)), action_(action),
+          expiry_tick_(0), running_(false), skipped_(0) {}
     explicit Descriptor(bool repeat, const Action& action)
-        : repeat_(repeat), period_(absl::Seconds(1)), action_(action) {}
+        : repeat_(repeat), period_(absl::Seconds(1)), action_(action),
+          expiry_tick_(0), running_(false), skipped_(0) {}
     ~Descriptor() {}
     bool Repeat() { return repeat_; }
     absl::Duration Period() { return period_; }
     ::util::Status ExecuteAction() { return action_(); }
 
+    // Returns a copy of the lateness histogram of this timer.
+    LatenessHistogram GetLatenessHistogram() const LOCKS_EXCLUDED(stats_lock_);
+    // Returns the num of times a periodic timer was due while its action was
+    // still running, or while the daemon was too late to execute it.
+    uint64 GetNumSkipped() const LOCKS_EXCLUDED(stats_lock_);
+
     bool repeat_;
     absl::Time due_time_;
     absl::Duration period_;
@@ -61,55 +98,98 @@ class TimerDaemon final {
       ::util::Status error = MAKE_ERROR(ERR_INTERNAL) << "Noop timer action!";
       return error;
     };
+    // The tick of the timing wheel at which the timer is due. Only accessed by
+    // the daemon while holding its access_lock_.
+    int64 expiry_tick_;
+    // Set while the action is queued or executing, so that a periodic timer
+    // never runs concurrently with itself.
+    std::atomic<bool> running_;
+    // Mutex lock protecting the statistics of the timer.
+    mutable absl::Mutex stats_lock_;
+    LatenessHistogram lateness_ GUARDED_BY(stats_lock_);
+    uint64 skipped_ GUARDED_BY(stats_lock_);
+
+    friend class TimerDaemon;
   };
 
   using DescriptorWeakPtr = std::weak_ptr<Descriptor>;
 
-  // In order to use TimerDaemon::Descriptor as a key in heap operations a
-  // comparator functor has to be defined.
-  struct TimerDescriptorComparator {
-    bool operator()(const TimerDaemon::DescriptorWeakPtr& lhs,
-                    const TimerDaemon::DescriptorWeakPtr& rhs) const {
-      // The goal of this method is to find which timer descriptor describes a
-      // timer that should be executed earlier: lhs or rhs?
-      // If a timer is canceled then the weak pointer pointing to it will
-      // 'expire' and there is no point in keeping such pointer on the heap. As
-      // the most effective way of removing an element from a heap is to move it
-      // to the top and then delete it, expired pointers should be theated as
-      // ones that are to be executed 'now'. This approach makes them to
-      // 'bubbled up' to the top as quickly as possible and then they can be
-      // removed.
-      if (lhs.expired() && !rhs.expired()) {
-        // rhs is expired, so, it is the lowest number.
-        return true;
-      }
-      if (rhs.expired() && !lhs.expired()) {
-        // lhs is expired, so, it is the lowest number.
-        return false;
-      }
-      if (rhs.expired() && lhs.expired()) {
-        // Both are expired, so, it really does not matter what we return.
-        return false;
-      }
-      // Both elements are still valid. Compare them!
-      return std::shared_ptr<Descriptor>(lhs)->due_time_ >
-             std::shared_ptr<Descriptor>(rhs)->due_time_;
-    }
+  // A hierarchical timing wheel holding the pending timers. The time is
+  // measured in ticks of 1ms. Level 0 has one slot per tick and each slot of
+  // level L spans all the slots of level L - 1. A timer is placed in the
+  // lowest level which can hold its expiry tick and is moved down one level
+  // each time the wheel reaches the slot it is in ("cascading"). Insertion is
+  // O(1) and each timer is cascaded at most kNumLevels times, independent of
+  // the num of pending timers. Timers which are due further than the wheel can
+  // hold are kept in the last slot of the top level and re-inserted when it is
+  // reached. The wheel only holds weak pointers: canceled timers are dropped
+  // when their slot is reached. The class is not thread-safe.
+  class TimingWheel {
+   public:
+    static constexpr int kNumSlotBits = 6;
+    static constexpr int kNumSlots = 1 << kNumSlotBits;
+    static constexpr int kNumLevels = 4;
+    // Returned by NextEventTick() when the wheel is empty.
+    static constexpr int64 kNoTick = -1;
+
+    TimingWheel() : current_tick_(0), size_(0) {}
+
+    // Adds a timer due at the given tick. Timers due at or before the current
+    // tick are returned by the next call to Advance().
+    void Insert(int64 expiry_tick, const DescriptorWeakPtr& desc);
+
+    // Moves the wheel forward to 'tick' and appends all the timers due at or
+    // before 'tick' to 'due', in the order of their expiry tick. Canceled
+    // timers are dropped. Does nothing to the wheel if 'tick' is not after the
+    // current tick, except returning the timers already due.
+    void Advance(int64 tick, std::vector<std::shared_ptr<Descriptor>>* due);
+
+    // Returns the next tick at which Advance() has work to do, i.e. a timer is
+    // due or a slot of a higher level needs to be cascaded. Returns the
+    // current tick if some timers are already due, and kNoTick if the wheel is
+    // empty.
+    int64 NextEventTick() const;
+
+    // Removes all the timers and resets the wheel to 'tick'.
+    void Reset(int64 tick);
+
+    int64 current_tick() const { return current_tick_; }
+    // Returns the num of timers in the wheel, including the canceled ones not
+    // yet dropped.
+    size_t size() const { return size_; }
+
+   private:
+    struct Entry {
+      int64 expiry_tick;
+      DescriptorWeakPtr desc;
+    };
+
+    // Puts the entry in the slot matching its expiry tick.
+    void Place(Entry entry);
+    // Processes all the slots whose time has come at 'current_tick_'.
+    void ProcessCurrentTick();
+
+    int64 current_tick_;
+    size_t size_;
+    // Entries which are due at or before 'current_tick_'.
+    std::vector<Entry> due_;
+    std::vector<Entry> slots_[kNumLevels][kNumSlots];
   };
 
  public:
   using DescriptorPtr = std::shared_ptr<Descriptor>;
 
-  // Starts the timer service. Creates a thread that calls Execute() every 1ms.
+  // Starts the timer service. Creates a thread which sleeps until the next
+  // timer is due and a pool of --timer_daemon_num_workers threads which execute
+  // the actions of the due timers.
   static ::util::Status Start() LOCKS_EXCLUDED(access_lock_);
-  // Stops the timer service. Notifies the timer thread to exit and waits until
-  // it joins.
+  // Stops the timer service. Notifies the timer thread and the workers to exit
+  // and waits until they join. Pending timers are discarded.
   static ::util::Status Stop() LOCKS_EXCLUDED(access_lock_);
-  // The 'worker' of the timer service. Is called every 1ms and checks if the
-  // first timer to be executed should be executed. If so, the action is
-  // executed and then if the timer is periodic the timer is updated and
-  // re-inserted into the heap with timers. It also takes care of all expired
-  // timers.
+  // Executes the actions of all the timers which are due at this moment in the
+  // caller's thread, re-scheduling the periodic ones. Returns false if the
+  // timer service is stopped. Normally not needed as the timer thread takes
+  // care of the due timers; mostly used by tests.
   static bool Execute() LOCKS_EXCLUDED(access_lock_);
 
   // Creates a one-shot timer that will execute 'action' 'delay_ms' milliseconds
@@ -124,15 +204,61 @@ class TimerDaemon final {
                                              const Action& action,
                                              DescriptorPtr* desc);
 
+  // Returns the histogram of the lateness of all the timers executed since the
+  // timer service was started.
+  static LatenessHistogram GetLatenessHistogram() LOCKS_EXCLUDED(stats_lock_);
+
+  // Returns the statistics of the timer service as a string. It also dumps the
+  // string to stdout.
+  static std::string DumpStats()
+      LOCKS_EXCLUDED(access_lock_, stats_lock_);
+
  private:
-  TimerDaemon() : started_(false) {}
+  // An action handed over to the workers, along with the time it was due.
+  struct PendingAction {
+    DescriptorWeakPtr desc;
+    absl::Time due_time;
+  };
+
+  TimerDaemon()
+      : epoch_(absl::Now()), started_(false), workers_started_(false),
+        num_executed_(0) {}
+
+  // Functions executed by the threads created by Start(). 'arg' is the daemon.
+  static void* TimerThreadFunc(void* arg);
+  static void* WorkerThreadFunc(void* arg);
+
+  // The body of the timer thread. Sleeps until the next timer is due or a new
+  // timer is requested, then hands the due actions over to the workers.
+  void RunTimerThread() LOCKS_EXCLUDED(access_lock_);
+
+  // The body of each worker thread. Executes queued actions until the daemon
+  // is stopped.
+  void RunWorkerThread() LOCKS_EXCLUDED(queue_lock_);
+
+  // Collects the timers which are due at 'now' and re-schedules the periodic
+  // ones. Periodic timers whose previous action is still running are skipped.
+  void GetDueActions(absl::Time now, std::vector<PendingAction>* actions)
+      EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
+  // Executes the action of the given timer, unless it has been canceled, and
+  // records its lateness.
+  void ExecuteAction(const PendingAction& action) LOCKS_EXCLUDED(stats_lock_);
+
+  // Hands the given actions over to the workers, or executes them in the
+  // caller's thread if there are no workers.
+  void DispatchActions(const std::vector<PendingAction>& actions)
+      LOCKS_EXCLUDED(queue_lock_);
 
-  // If there is an action to be executed at this moment of time a non-null
-  // pointer is returned.
-  DescriptorPtr GetAction();
+  // Adds a timer to the timing wheel and wakes up the timer thread.
+  void ScheduleTimer(const DescriptorPtr& desc)
+      EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
 
-  // Returns true if the timer daemon is stopped.
-  bool IsStopped();
+  // Helpers converting between absl::Time and ticks of the timing wheel. The
+  // expiry tick of a time is rounded up, so that timers never fire early.
+  int64 ToTick(absl::Time time) const;
+  int64 ToExpiryTick(absl::Time time) const;
+  absl::Time FromTick(int64 tick) const;
 
   static TimerDaemon* GetInstance() {
     static TimerDaemon* singleton = new TimerDaemon();
@@ -144,16 +270,44 @@ class TimerDaemon final {
                               Action action, DescriptorPtr* desc)
       LOCKS_EXCLUDED(access_lock_);
 
-  // A Mutex used to guard access to the list of pointers to timer requests and
-  // the started_ flag.
+  // The time corresponding to tick 0 of the timing wheel.
+  const absl::Time epoch_;
+
+  // A Mutex used to guard access to the timing wheel and the started_ flag.
   mutable absl::Mutex access_lock_;
 
-  std::vector<DescriptorWeakPtr> timers_ GUARDED_BY(access_lock_);
+  // Signaled when a timer is requested or the daemon is stopped, to wake up
+  // the timer thread.
+  absl::CondVar timer_cond_;
+
+  TimingWheel timers_ GUARDED_BY(access_lock_);
 
   pthread_t tid_ = 0;  // will not be destroyed before the thread is joined.
 
   bool started_ GUARDED_BY(access_lock_);
 
+  // A Mutex used to guard access to the queue of actions to be executed by the
+  // workers.
+  mutable absl::Mutex queue_lock_;
+
+  // Signaled when an action is queued or the workers need to exit.
+  absl::CondVar queue_cond_;
+
+  std::deque<PendingAction> pending_actions_ GUARDED_BY(queue_lock_);
+
+  // Set while the workers are supposed to run.
+  bool workers_started_ GUARDED_BY(queue_lock_);
+
+  // The worker threads. Empty if the actions are executed by the timer thread.
+  std::vector<pthread_t> worker_tids_;
+
+  // A Mutex used to guard access to the daemon-wide statistics.
+  mutable absl::Mutex stats_lock_;
+
+  LatenessHistogram lateness_ GUARDED_BY(stats_lock_);
+
+  uint64 num_executed_ GUARDED_BY(stats_lock_);
+
   friend class TimerDaemonTest;
 };
 
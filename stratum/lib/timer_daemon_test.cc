@@ -16,13 +16,20 @@
 
 #include "stratum/lib/timer_daemon.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "stratum/glue/status/status_test_util.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 
 namespace stratum {
 namespace hal {
 
+using ::testing::HasSubstr;
+
 class TimerDaemonTest : public ::testing::Test {
  protected:
   TimerDaemonTest() {}
@@ -50,17 +57,16 @@ class TimerDaemonTest : public ::testing::Test {
 
   void TearDown() override { ASSERT_OK(TimerDaemon::Stop()); }
 
-  TimerDaemon::DescriptorPtr GetTimerDescriptorPtr(const absl::Time when) {
-    TimerDaemon::DescriptorPtr desc =
-        std::make_shared<TimerDaemon::Descriptor>(
-            /* repeat = */ false, []() { return ::util::OkStatus(); });
-    desc->due_time_ = when;
-    return desc;
+  TimerDaemon::DescriptorPtr GetTimerDescriptorPtr() {
+    return std::make_shared<TimerDaemon::Descriptor>(
+        /* repeat = */ false, []() { return ::util::OkStatus(); });
   }
 
-  TimerDaemon::DescriptorWeakPtr GetTimerDescriptorWeakPtr(
-      const TimerDaemon::DescriptorPtr &desc) {
-    return TimerDaemon::DescriptorWeakPtr(desc);
+  // Advances the wheel to 'tick' and returns the num of due timers.
+  int AdvanceWheel(int64 tick) {
+    std::vector<TimerDaemon::DescriptorPtr> due;
+    wheel_.Advance(tick, &due);
+    return due.size();
   }
 
   // A counter used to check if timers are executed in correct order. Each timer
@@ -71,60 +77,75 @@ class TimerDaemonTest : public ::testing::Test {
   // A Mutex used to guard access to the 'count_'.
   mutable absl::Mutex access_lock_;
 
-  // A comparator used internally by the TimerSevice to compare timestamps.
-  // This class is private, so, it is instantiated here to allow access by
-  // relevant tests.
-  TimerDaemon::TimerDescriptorComparator cmp_;
+  // The timing wheel used internally by the TimerDaemon. This class is
+  // private, so, it is instantiated here to allow access by relevant tests.
+  TimerDaemon::TimingWheel wheel_;
+  static constexpr int64 kNoTick = TimerDaemon::TimingWheel::kNoTick;
 };
 
-TEST_F(TimerDaemonTest, CompareSmallerBigger) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now);
-  auto desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
-
-  // 0 > 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2.reset();
-  // 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
+constexpr int64 TimerDaemonTest::kNoTick;
 
-  desc1.reset();
-  // expired 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
+TEST_F(TimerDaemonTest, WheelFiresTimersInOrder) {
+  // Timers spread over all the levels of the wheel, plus one further than the
+  // wheel can hold, inserted in reverse order.
+  const std::vector<int64> ticks = {1,      63,      64,       65,
+                                    4095,   4096,    300000,   16777215,
+                                    16777216, 50000000};
+  std::vector<TimerDaemon::DescriptorPtr> descs;
+  for (auto it = ticks.rbegin(); it != ticks.rend(); ++it) {
+    descs.push_back(GetTimerDescriptorPtr());
+    wheel_.Insert(*it, descs.back());
+  }
+  EXPECT_EQ(ticks.size(), wheel_.size());
 
-  desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 0 > 10
-  EXPECT_TRUE(cmp_(weak1, weak2));
+  for (size_t i = 0; i < ticks.size(); ++i) {
+    // Nothing fires before its tick.
+    EXPECT_EQ(0, AdvanceWheel(ticks[i] - 1)) << ticks[i];
+    EXPECT_LE(wheel_.NextEventTick(), ticks[i]);
+    std::vector<TimerDaemon::DescriptorPtr> due;
+    wheel_.Advance(ticks[i], &due);
+    ASSERT_EQ(1, due.size()) << ticks[i];
+    EXPECT_EQ(descs[ticks.size() - 1 - i], due[0]);
+  }
+  EXPECT_EQ(0, wheel_.size());
+  EXPECT_EQ(kNoTick, wheel_.NextEventTick());
 }
 
-TEST_F(TimerDaemonTest, CompareBiggerSmaller) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  auto desc2 = GetTimerDescriptorPtr(now);
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
+TEST_F(TimerDaemonTest, WheelReturnsAllDueTimersInOneJump) {
+  std::vector<TimerDaemon::DescriptorPtr> descs;
+  for (int64 tick : {5000, 10, 70, 10}) {
+    descs.push_back(GetTimerDescriptorPtr());
+    wheel_.Insert(tick, descs.back());
+  }
+  EXPECT_EQ(10, wheel_.NextEventTick());
 
-  // 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
+  std::vector<TimerDaemon::DescriptorPtr> due;
+  wheel_.Advance(100000, &due);
+  ASSERT_EQ(4, due.size());
+  // Ordered by expiry tick, then by insertion.
+  EXPECT_EQ(descs[1], due[0]);
+  EXPECT_EQ(descs[3], due[1]);
+  EXPECT_EQ(descs[2], due[2]);
+  EXPECT_EQ(descs[0], due[3]);
+  EXPECT_EQ(100000, wheel_.current_tick());
 
-  desc2.reset();
-  // 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
+  // Timers already due are returned by the next call.
+  wheel_.Insert(50, descs[0]);
+  EXPECT_EQ(100000, wheel_.NextEventTick());
+  EXPECT_EQ(1, AdvanceWheel(100000));
+}
 
+TEST_F(TimerDaemonTest, WheelDropsCanceledTimers) {
+  auto desc1 = GetTimerDescriptorPtr();
+  auto desc2 = GetTimerDescriptorPtr();
+  wheel_.Insert(10, desc1);
+  wheel_.Insert(1000, desc2);
   desc1.reset();
-  // expired 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2 = GetTimerDescriptorPtr(now);
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
+  desc2.reset();
+  EXPECT_EQ(2, wheel_.size());
+  EXPECT_EQ(0, AdvanceWheel(2000));
+  EXPECT_EQ(0, wheel_.size());
+  EXPECT_EQ(kNoTick, wheel_.NextEventTick());
 }
 
 TEST_F(TimerDaemonTest, CreateOneShot) {
@@ -165,6 +186,118 @@ TEST_F(TimerDaemonTest, CreateTwoOneShots) {
 
 TEST_F(TimerDaemonTest, CreatePeriodic) {
   // This test verifies that TimerDaemon does create periodic timer.
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestPeriodicTimer(10, 10,
+                                              [&]() {
+                                                absl::WriterMutexLock l(
+                                                    &access_lock_);
+                                                count_++;
+                                                return ::util::OkStatus();
+                                              },
+                                              &desc));
+  usleep(105000);
+  desc.reset();
+  absl::WriterMutexLock l(&access_lock_);
+  EXPECT_GE(count_, 5);
+  EXPECT_LE(count_, 10);
+}
+
+TEST_F(TimerDaemonTest, CancelOneShot) {
+  // This test verifies that dropping the descriptor cancels the timer.
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(50,
+                                             [&]() {
+                                               absl::WriterMutexLock l(
+                                                   &access_lock_);
+                                               count_++;
+                                               return ::util::OkStatus();
+                                             },
+                                             &desc));
+  desc.reset();
+  usleep(100000);
+  absl::WriterMutexLock l(&access_lock_);
+  EXPECT_EQ(0, count_);
+}
+
+TEST_F(TimerDaemonTest, SlowActionDoesNotDelayOtherTimers) {
+  // This test verifies that a slow action does not block the other timers,
+  // as the actions are executed by a pool of workers.
+  absl::Notification fast_done;
+  TimerDaemon::DescriptorPtr slow, fast;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(10,
+                                             [&]() {
+                                               fast_done.WaitForNotification();
+                                               return ::util::OkStatus();
+                                             },
+                                             &slow));
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(30,
+                                             [&]() {
+                                               fast_done.Notify();
+                                               return ::util::OkStatus();
+                                             },
+                                             &fast));
+  EXPECT_TRUE(
+      fast_done.WaitForNotificationWithTimeout(absl::Milliseconds(1000)));
+  usleep(10000);
+  EXPECT_EQ(1, fast->GetLatenessHistogram().count);
+  EXPECT_EQ(1, slow->GetLatenessHistogram().count);
+}
+
+TEST_F(TimerDaemonTest, PeriodicTimerDoesNotOverlap) {
+  // This test verifies that a periodic timer whose action takes longer than
+  // its period is skipped rather than executed concurrently with itself.
+  int running = 0, max_running = 0;
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestPeriodicTimer(1, 2,
+                                              [&]() {
+                                                {
+                                                  absl::WriterMutexLock l(
+                                                      &access_lock_);
+                                                  max_running = std::max(
+                                                      max_running, ++running);
+                                                }
+                                                usleep(10000);
+                                                absl::WriterMutexLock l(
+                                                    &access_lock_);
+                                                running--;
+                                                count_++;
+                                                return ::util::OkStatus();
+                                              },
+                                              &desc));
+  usleep(100000);
+  auto histogram = desc->GetLatenessHistogram();
+  uint64 skipped = desc->GetNumSkipped();
+  desc.reset();
+  usleep(20000);
+  absl::WriterMutexLock l(&access_lock_);
+  EXPECT_EQ(1, max_running);
+  EXPECT_GT(count_, 0);
+  EXPECT_GT(skipped, 0);
+  EXPECT_LE(histogram.count, count_);
+}
+
+TEST_F(TimerDaemonTest, LatenessHistogram) {
+  TimerDaemon::LatenessHistogram histogram;
+  histogram.Add(absl::Microseconds(-5));
+  histogram.Add(absl::Microseconds(500));
+  histogram.Add(absl::Milliseconds(3));
+  histogram.Add(absl::Seconds(5));
+  EXPECT_EQ(4, histogram.count);
+  EXPECT_EQ(2, histogram.buckets[0]);
+  EXPECT_EQ(1, histogram.buckets[2]);
+  EXPECT_EQ(1, histogram.buckets[TimerDaemon::LatenessHistogram::kNumBounds]);
+  EXPECT_EQ(absl::Seconds(5), histogram.max);
+  EXPECT_THAT(histogram.ToString(), HasSubstr("count:4"));
+  EXPECT_THAT(histogram.ToString(), HasSubstr("<1ms:2, <2ms:0, <5ms:1"));
+  EXPECT_THAT(histogram.ToString(), HasSubstr(">=1000ms:1]"));
+
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      1, []() { return ::util::OkStatus(); }, &desc));
+  usleep(50000);
+  EXPECT_EQ(1, desc->GetLatenessHistogram().count);
+  EXPECT_GE(TimerDaemon::GetLatenessHistogram().count, 1);
+  EXPECT_THAT(TimerDaemon::DumpStats(), HasSubstr("executed:"));
 }
 
 }  // namespace hal